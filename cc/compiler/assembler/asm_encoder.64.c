@@ -9,6 +9,7 @@
 #include <strings.h>
 #include <int_limits.h>
 #include <logging.h>
+#include <xxhash.h>
 
 MODULE("turnstone.compiler.assembler");
 
@@ -144,6 +145,98 @@ const asm_register_map_t asm_register_map[] = {
 
 #define ASM_REGISTER_COUNT (sizeof(asm_register_map) / sizeof(asm_register_map_t))
 
+/*! slot count of register name index, power of two, at least twice of register count */
+#define ASM_REGISTER_INDEX_SIZE 256
+
+_Static_assert(ASM_REGISTER_INDEX_SIZE >= 2 * ASM_REGISTER_COUNT, "register index is too small");
+
+/*! register index is not built */
+#define ASM_REGISTER_INDEX_STATE_NONE     0
+/*! register index is being built by another caller */
+#define ASM_REGISTER_INDEX_STATE_BUILDING 1
+/*! register index is ready */
+#define ASM_REGISTER_INDEX_STATE_READY    2
+
+static volatile uint64_t asm_register_index_state = ASM_REGISTER_INDEX_STATE_NONE;
+/*! open addressed register name hash, values are register map index + 1, 0 is empty slot */
+static uint8_t asm_register_index[ASM_REGISTER_INDEX_SIZE];
+
+static uint64_t asm_register_hash(const char_t* name) {
+    return xxhash3_64_hash(name, strlen(name)) & (ASM_REGISTER_INDEX_SIZE - 1);
+}
+
+/**
+ * @brief builds register name hash once, register map is static so it is never freed
+ */
+static void asm_register_index_build(void) {
+    uint64_t state = __atomic_load_n(&asm_register_index_state, __ATOMIC_ACQUIRE);
+
+    while(state != ASM_REGISTER_INDEX_STATE_READY) {
+        if(state == ASM_REGISTER_INDEX_STATE_NONE &&
+           __atomic_compare_exchange_n(&asm_register_index_state, &state, ASM_REGISTER_INDEX_STATE_BUILDING,
+                                       false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        asm volatile ("pause" ::: "memory");
+
+        state = __atomic_load_n(&asm_register_index_state, __ATOMIC_ACQUIRE);
+    }
+
+    if(state == ASM_REGISTER_INDEX_STATE_READY) {
+        return;
+    }
+
+    for(uint8_t i = 0; i < ASM_REGISTER_COUNT; i++) {
+        uint64_t slot = asm_register_hash(asm_register_map[i].name);
+
+        while(asm_register_index[slot]) {
+            slot = (slot + 1) & (ASM_REGISTER_INDEX_SIZE - 1);
+        }
+
+        asm_register_index[slot] = i + 1;
+    }
+
+    __atomic_store_n(&asm_register_index_state, ASM_REGISTER_INDEX_STATE_READY, __ATOMIC_RELEASE);
+}
+
+static const asm_register_map_t* asm_register_find(const char_t* name) {
+    asm_register_index_build();
+
+    uint64_t slot = asm_register_hash(name);
+
+    while(asm_register_index[slot]) {
+        const asm_register_map_t* reg = &asm_register_map[asm_register_index[slot] - 1];
+
+        if(strcmp(name, reg->name) == 0) {
+            return reg;
+        }
+
+        slot = (slot + 1) & (ASM_REGISTER_INDEX_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief reverse register lookup for listings
+ * @param[in] reg register
+ * @return register name, NULL if unknown
+ */
+static const char_t* asm_register_name(const asm_register_t* reg) {
+    for(uint8_t i = 0; i < ASM_REGISTER_COUNT; i++) {
+        const asm_register_t* r = &asm_register_map[i].reg;
+
+        if(r->register_index == reg->register_index && r->register_size == reg->register_size &&
+           r->force_rex == reg->force_rex && r->is_segment == reg->is_segment &&
+           r->is_control == reg->is_control && r->is_debug == reg->is_debug) {
+            return asm_register_map[i].name;
+        }
+    }
+
+    return NULL;
+}
+
 boolean_t asm_parse_number(const char_t* data, uint64_t* result);
 boolean_t asm_parse_instruction_param(const asm_token_t* tok, asm_instruction_param_t* param);
 boolean_t asm_parse_register_param(char_t* reg_str, uint8_t reg_idx, asm_instruction_param_t* param);
@@ -154,6 +247,69 @@ boolean_t asm_encode_modrm_sib(asm_instruction_param_t op, boolean_t* need_sib,
                                boolean_t* has_displacement, uint8_t* disp_size);
 boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* relocs);
 
+/**
+ * @brief sets displacement and its unsigned and signed sizes
+ * @param[out] param memory parameter
+ * @param[in] displacement displacement value
+ */
+static void asm_param_set_displacement(asm_instruction_param_t* param, uint64_t displacement) {
+    param->displacement = displacement;
+
+    // find size of displacement
+    int64_t signed_disp = (int64_t)displacement;
+
+    if(signed_disp >= INT8_MIN && signed_disp <= INT8_MAX) {
+        param->signed_displacement_size = 8;
+    } else if(signed_disp >= INT16_MIN && signed_disp <= INT16_MAX) {
+        param->signed_displacement_size = 16;
+    } else if(signed_disp >= INT32_MIN && signed_disp <= INT32_MAX) {
+        param->signed_displacement_size = 32;
+    } else {
+        param->signed_displacement_size = 64;
+    }
+
+    if(displacement <= UINT8_MAX) {
+        param->displacement_size = 8;
+    } else if(displacement <= UINT16_MAX) {
+        param->displacement_size = 16;
+    } else if(displacement <= UINT32_MAX) {
+        param->displacement_size = 32;
+    } else {
+        param->displacement_size = 64;
+    }
+}
+
+/**
+ * @brief sets immediate and its unsigned and signed sizes
+ * @param[out] param immediate parameter
+ * @param[in] immediate immediate value
+ */
+static void asm_param_set_immediate(asm_instruction_param_t* param, uint64_t immediate) {
+    param->immediate = immediate;
+
+    if(immediate <= UINT8_MAX) {
+        param->immediate_size = 8;
+    } else if(immediate <= UINT16_MAX) {
+        param->immediate_size = 16;
+    } else if(immediate <= UINT32_MAX) {
+        param->immediate_size = 32;
+    } else {
+        param->immediate_size = 64;
+    }
+
+    int64_t signed_immediate = (int64_t)immediate;
+
+    if(signed_immediate >= INT8_MIN && signed_immediate <= INT8_MAX) {
+        param->signed_immediate_size = 8;
+    } else if(signed_immediate >= INT16_MIN && signed_immediate <= INT16_MAX) {
+        param->signed_immediate_size = 16;
+    } else if(signed_immediate >= INT32_MIN && signed_immediate <= INT32_MAX) {
+        param->signed_immediate_size = 32;
+    } else {
+        param->signed_immediate_size = 64;
+    }
+}
+
 boolean_t asm_parse_number(const char_t* data, uint64_t* result) {
     boolean_t is_hex = false;
 
@@ -192,33 +348,14 @@ boolean_t asm_parse_memory_param(char_t* data, asm_instruction_param_t* param) {
 
         buffer_destroy(disp);
 
-        if(!asm_parse_number(disp_str, &param->displacement)) {
+        uint64_t displacement = 0;
+
+        if(!asm_parse_number(disp_str, &displacement)) {
             param->label = disp_str;
         } else {
             memory_free(disp_str);
 
-            // find size of displacement
-            int64_t signed_disp = (int64_t)param->displacement;
-
-            if(signed_disp >= INT8_MIN && signed_disp <= INT8_MAX) {
-                param->signed_displacement_size = 8;
-            } else if(signed_disp >= INT16_MIN && signed_disp <= INT16_MAX) {
-                param->signed_displacement_size = 16;
-            } else if(signed_disp >= INT32_MIN && signed_disp <= INT32_MAX) {
-                param->signed_displacement_size = 32;
-            } else {
-                param->signed_displacement_size = 64;
-            }
-
-            if(param->displacement <= UINT8_MAX) {
-                param->displacement_size = 8;
-            } else if(param->displacement <= UINT16_MAX) {
-                param->displacement_size = 16;
-            } else if(param->displacement <= UINT32_MAX) {
-                param->displacement_size = 32;
-            } else {
-                param->displacement_size = 64;
-            }
+            asm_param_set_displacement(param, displacement);
         }
     }
 
@@ -352,29 +489,7 @@ boolean_t asm_parse_immediate_param(char_t* data, asm_instruction_param_t* param
         return true;
     }
 
-    param->immediate = immediate;
-
-    if(immediate <= UINT8_MAX) {
-        param->immediate_size = 8;
-    } else if(immediate <= UINT16_MAX) {
-        param->immediate_size = 16;
-    } else if(immediate <= UINT32_MAX) {
-        param->immediate_size = 32;
-    } else {
-        param->immediate_size = 64;
-    }
-
-    int64_t signed_immediate = (int64_t)immediate;
-
-    if(signed_immediate >= INT8_MIN && signed_immediate <= INT8_MAX) {
-        param->signed_immediate_size = 8;
-    } else if(signed_immediate >= INT16_MIN && signed_immediate <= INT16_MAX) {
-        param->signed_immediate_size = 16;
-    } else if(signed_immediate >= INT32_MIN && signed_immediate <= INT32_MAX) {
-        param->signed_immediate_size = 32;
-    } else {
-        param->signed_immediate_size = 64;
-    }
+    asm_param_set_immediate(param, immediate);
 
     return true;
 }
@@ -383,12 +498,12 @@ boolean_t asm_parse_register_param(char_t* reg_str, uint8_t reg_idx, asm_instruc
 
     reg_str = strtrim_right(reg_str);
 
-    for(uint8_t i = 0; i < ASM_REGISTER_COUNT; i++) {
-        if(strcmp(reg_str, asm_register_map[i].name) == 0) {
-            PRINTLOG(COMPILER_ASSEMBLER, LOG_INFO, "Register found: %s", reg_str);
-            param->registers[reg_idx] = asm_register_map[i].reg;
-            return true;
-        }
+    const asm_register_map_t* reg = asm_register_find(reg_str);
+
+    if(reg) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_INFO, "Register found: %s", reg_str);
+        param->registers[reg_idx] = reg->reg;
+        return true;
     }
 
     PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Unknown register: -%s-", reg_str);
@@ -415,6 +530,210 @@ boolean_t asm_parse_instruction_param(const asm_token_t* tok, asm_instruction_pa
     return asm_parse_memory_param(data, param);
 }
 
+boolean_t asm_instruction_ir_set_register(asm_instruction_param_t* param, const char_t* reg_name) {
+    if(!param || !reg_name) {
+        return false;
+    }
+
+    const asm_register_map_t* reg = asm_register_find(reg_name);
+
+    if(!reg) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Unknown register: -%s-", reg_name);
+
+        return false;
+    }
+
+    memory_memclean(param, sizeof(asm_instruction_param_t));
+
+    param->type = ASM_INSTRUCTION_PARAM_TYPE_REGISTER;
+    param->registers[ASM_REGISTER_TYPE_NORMAL] = reg->reg;
+
+    return true;
+}
+
+boolean_t asm_instruction_ir_set_immediate(asm_instruction_param_t* param, uint64_t immediate, const char_t* label) {
+    if(!param) {
+        return false;
+    }
+
+    memory_memclean(param, sizeof(asm_instruction_param_t));
+
+    param->type = ASM_INSTRUCTION_PARAM_TYPE_IMMEDIATE;
+
+    if(label) {
+        param->label = strdup(label);
+
+        return param->label != NULL;
+    }
+
+    asm_param_set_immediate(param, immediate);
+
+    return true;
+}
+
+boolean_t asm_instruction_ir_set_memory(asm_instruction_param_t* param, const char_t* base_reg, const char_t* index_reg,
+                                        uint8_t scale, int64_t displacement, const char_t* label) {
+    if(!param || (!base_reg && !label && !displacement)) {
+        return false;
+    }
+
+    memory_memclean(param, sizeof(asm_instruction_param_t));
+
+    param->type = ASM_INSTRUCTION_PARAM_TYPE_MEMORY;
+
+    if(base_reg) {
+        const asm_register_map_t* reg = asm_register_find(base_reg);
+
+        if(!reg) {
+            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Unknown base register: -%s-", base_reg);
+
+            return false;
+        }
+
+        param->registers[ASM_REGISTER_TYPE_BASE] = reg->reg;
+    }
+
+    if(index_reg) {
+        const asm_register_map_t* reg = asm_register_find(index_reg);
+
+        if(!reg) {
+            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Unknown index register: -%s-", index_reg);
+
+            return false;
+        }
+
+        param->registers[ASM_REGISTER_TYPE_INDEX] = reg->reg;
+        param->scale = scale ? scale : 1;
+    }
+
+    if(label) {
+        param->label = strdup(label);
+
+        return param->label != NULL;
+    }
+
+    if(displacement) {
+        asm_param_set_displacement(param, displacement);
+    }
+
+    return true;
+}
+
+/**
+ * @brief prints one parameter in at&t syntax
+ * @param[in] param parameter
+ * @param[out] outbuf listing buffer
+ * @return 0 on success, -1 on unknown register
+ */
+static int8_t asm_instruction_ir_print_param(const asm_instruction_param_t* param, buffer_t* outbuf) {
+    if(param->type == ASM_INSTRUCTION_PARAM_TYPE_REGISTER) {
+        const char_t* name = asm_register_name(&param->registers[ASM_REGISTER_TYPE_NORMAL]);
+
+        if(!name) {
+            return -1;
+        }
+
+        buffer_printf(outbuf, "%%%s", name);
+
+        return 0;
+    }
+
+    if(param->type == ASM_INSTRUCTION_PARAM_TYPE_IMMEDIATE) {
+        if(param->label) {
+            buffer_printf(outbuf, "$%s", param->label);
+        } else {
+            buffer_printf(outbuf, "$0x%llx", param->immediate);
+        }
+
+        return 0;
+    }
+
+    if(param->label) {
+        buffer_printf(outbuf, "%s", param->label);
+    } else if(param->displacement_size) {
+        buffer_printf(outbuf, "%lli", (int64_t)param->displacement);
+    }
+
+    if(param->registers[ASM_REGISTER_TYPE_BASE].register_size) {
+        const char_t* base = asm_register_name(&param->registers[ASM_REGISTER_TYPE_BASE]);
+
+        if(!base) {
+            return -1;
+        }
+
+        buffer_printf(outbuf, "(%%%s", base);
+
+        if(param->registers[ASM_REGISTER_TYPE_INDEX].register_size) {
+            const char_t* index = asm_register_name(&param->registers[ASM_REGISTER_TYPE_INDEX]);
+
+            if(!index) {
+                return -1;
+            }
+
+            buffer_printf(outbuf, ",%%%s,%lli", index, param->scale);
+        }
+
+        buffer_printf(outbuf, ")");
+    }
+
+    return 0;
+}
+
+int8_t asm_instruction_ir_print(const asm_instruction_ir_t* ir, buffer_t* outbuf) {
+    if(!ir || !ir->mnemonic || !outbuf) {
+        return -1;
+    }
+
+    const char_t* suffix = "";
+
+    switch(ir->operand_size) {
+    case 8:
+        suffix = "b";
+        break;
+    case 16:
+        suffix = "w";
+        break;
+    case 32:
+        suffix = "l";
+        break;
+    case 64:
+        suffix = "q";
+        break;
+    default:
+        break;
+    }
+
+    buffer_printf(outbuf, "\t%s%s", ir->mnemonic, suffix);
+
+    for(uint8_t i = 0; i < ir->param_count; i++) {
+        buffer_printf(outbuf, i ? ", " : " ");
+
+        if(asm_instruction_ir_print_param(&ir->params[i], outbuf) != 0) {
+            return -1;
+        }
+    }
+
+    buffer_printf(outbuf, "\n");
+
+    return 0;
+}
+
+boolean_t asm_encode_ir(asm_encoder_ctx_t* ctx, const asm_instruction_ir_t* ir) {
+    if(!ctx || !ctx->current_section) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Instruction outside of section");
+
+        return false;
+    }
+
+    if(ctx->listing && asm_instruction_ir_print(ir, ctx->listing) != 0) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Cannot print instruction listing");
+
+        return false;
+    }
+
+    return asm_encode_ir_instruction(ir, ctx->current_section->data, ctx->current_section->relocs);
+}
+
 boolean_t asm_encode_modrm_sib(asm_instruction_param_t op, boolean_t* need_sib, uint8_t* modrm, uint8_t* sib,
                                boolean_t* need_rex, uint8_t* rex,
                                boolean_t* has_displacement, uint8_t* disp_size) {
@@ -649,6 +968,85 @@ int8_t asm_encoder_dump(asm_encoder_ctx_t* ctx, buffer_t* outbuf) {
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+asm_section_t* asm_encoder_switch_section(asm_encoder_ctx_t* ctx, const char_t* name) {
+    if(!ctx || !name) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid context");
+        return NULL;
+    }
+
+    if(ctx->listing) {
+        buffer_printf(ctx->listing, ".section %s\n", name);
+    }
+
+    // sections can be reentered, code is appended
+    if(ctx->sections && hashmap_exists(ctx->sections, name)) {
+        ctx->current_section = (asm_section_t*)hashmap_get(ctx->sections, name);
+
+        return ctx->current_section;
+    }
+
+    asm_section_t* section = memory_malloc(sizeof(asm_section_t));
+
+    if(!section) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section");
+        return NULL;
+    }
+
+    section->name = strdup(name);
+
+    int32_t section_type = -1;
+
+    for(int32_t i = 0; i < LINKER_SECTION_TYPE_NR_SECTIONS; i++) {
+        if(strstarts(section->name, linker_section_type_names[i]) == 0) {
+            section_type = i;
+            break;
+        }
+    }
+
+    if(section_type == -1) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid section type %s", section->name);
+        return NULL;
+    }
+
+    section->type = section_type;
+
+    section->data = buffer_new_with_capacity(NULL, 1024);
+
+    if(!section->data) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section data");
+        return NULL;
+    }
+
+    section->symbols = hashmap_string(16);
+
+    if(!section->symbols) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section symbols");
+        return NULL;
+    }
+
+    section->relocs = list_create_list();
+
+    if(!section->relocs) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section relocations");
+        return NULL;
+    }
+
+    if(!ctx->sections) {
+        ctx->sections = hashmap_string(16);
+
+        if(!ctx->sections) {
+            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for sections");
+            return NULL;
+        }
+    }
+
+    hashmap_put(ctx->sections, section->name, section);
+
+    ctx->current_section = section;
+
+    return section;
+}
+
 static int8_t asm_encode_directive(asm_encoder_ctx_t* ctx, iterator_t* it) {
     if(!ctx) {
         PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid context");
@@ -682,65 +1080,9 @@ static int8_t asm_encode_directive(asm_encoder_ctx_t* ctx, iterator_t* it) {
             return -1;
         }
 
-        asm_section_t* section = memory_malloc(sizeof(asm_section_t));
-
-        if(!section) {
-            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section");
-            return -1;
-        }
-
-        section->name = strdup(section_tok->token_value);
-
-        int32_t section_type = -1;
-
-        for(int32_t i = 0; i < LINKER_SECTION_TYPE_NR_SECTIONS; i++) {
-            if(strstarts(section->name, linker_section_type_names[i]) == 0) {
-                section_type = i;
-                break;
-            }
-        }
-
-        if(section_type == -1) {
-            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid section type %s", section->name);
+        if(!asm_encoder_switch_section(ctx, section_tok->token_value)) {
             return -1;
         }
-
-        section->type = section_type;
-
-        section->data = buffer_new_with_capacity(NULL, 1024);
-
-        if(!section->data) {
-            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section data");
-            return -1;
-        }
-
-        section->symbols = hashmap_string(16);
-
-        if(!section->symbols) {
-            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section symbols");
-            return -1;
-        }
-
-        section->relocs = list_create_list();
-
-        if(!section->relocs) {
-            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for section relocations");
-            return -1;
-        }
-
-        if(!ctx->sections) {
-            ctx->sections = hashmap_string(16);
-
-            if(!ctx->sections) {
-                PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for sections");
-                return -1;
-            }
-        }
-
-        hashmap_put(ctx->sections, section->name, section);
-
-        ctx->current_section = section;
-
     } else if(tok->directive_type == ASM_DIRECTIVE_TYPE_GLOBAL ||
               tok->directive_type == ASM_DIRECTIVE_TYPE_EXTERN ||
               tok->directive_type == ASM_DIRECTIVE_TYPE_LOCAL) {
@@ -947,6 +1289,46 @@ static int8_t asm_encode_directive(asm_encoder_ctx_t* ctx, iterator_t* it) {
 }
 #pragma GCC diagnostic pop
 
+boolean_t asm_encoder_define_label(asm_encoder_ctx_t* ctx, const char_t* name) {
+    if(!ctx || !ctx->current_section || !name) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Label outside of section");
+        return false;
+    }
+
+    if(ctx->listing) {
+        buffer_printf(ctx->listing, "%s:\n", name);
+    }
+
+    if(!hashmap_exists(ctx->current_section->symbols, name)) {
+        asm_symbol_t* symbol = memory_malloc(sizeof(asm_symbol_t));
+
+        if(!symbol) {
+            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for symbol %s", name);
+
+            return false;
+        }
+
+        symbol->offset = buffer_get_position(ctx->current_section->data);
+        symbol->scope = LINKER_SYMBOL_SCOPE_LOCAL;
+        symbol->type = LINKER_SYMBOL_TYPE_SYMBOL;
+        symbol->name = strdup(name);
+
+        hashmap_put(ctx->current_section->symbols, symbol->name, symbol);
+    } else {
+        asm_symbol_t* symbol = (asm_symbol_t*)hashmap_get(ctx->current_section->symbols, name);
+
+        if(symbol->type != LINKER_SYMBOL_TYPE_FUNCTION) {
+            PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Symbol %s already exists", name);
+
+            return false;
+        }
+
+        symbol->offset = buffer_get_position(ctx->current_section->data);
+    }
+
+    return true;
+}
+
 boolean_t asm_encode_instructions(asm_encoder_ctx_t* ctx) {
     if(!ctx) {
         PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid context");
@@ -973,33 +1355,10 @@ boolean_t asm_encode_instructions(asm_encoder_ctx_t* ctx) {
                 break;
             }
         } else if(tok->token_type == ASM_TOKEN_TYPE_LABEL) {
-            if(!hashmap_exists(ctx->current_section->symbols, tok->token_value)) {
-                asm_symbol_t* symbol = memory_malloc(sizeof(asm_symbol_t));
-
-                if(!symbol) {
-                    PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to allocate memory for symbol %s", tok->token_value);
-                    result = false;
-
-                    break;
-                }
-
-                symbol->offset = buffer_get_position(ctx->current_section->data);
-                symbol->scope = LINKER_SYMBOL_SCOPE_LOCAL;
-                symbol->type = LINKER_SYMBOL_TYPE_SYMBOL;
-                symbol->name = strdup(tok->token_value);
-
-                hashmap_put(ctx->current_section->symbols, symbol->name, symbol);
-            } else {
-                asm_symbol_t* symbol = (asm_symbol_t*)hashmap_get(ctx->current_section->symbols, tok->token_value);
-
-                if(symbol->type != LINKER_SYMBOL_TYPE_FUNCTION) {
-                    PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Symbol %s already exists", tok->token_value);
-                    result = false;
-
-                    break;
-                }
+            if(!asm_encoder_define_label(ctx, tok->token_value)) {
+                result = false;
 
-                symbol->offset = buffer_get_position(ctx->current_section->data);
+                break;
             }
 
             it = it->next(it);
@@ -1080,46 +1439,28 @@ void asm_encoder_destroy_relocs(list_t* relocs) {
 }
 
 boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* relocs) {
-    boolean_t result = true;
-
     const asm_token_t* tok_operand = it->get_item(it);
 
+    asm_instruction_ir_t ir = {0};
+
     char_t* mnemonic_str = strdup(tok_operand->token_value);
     uint64_t mnemonic_str_len = strlen(mnemonic_str) - 1;
-    uint8_t operand_size = 0;
-    uint8_t mem_operand_size = 0;
 
     if(strends(mnemonic_str, "b") == 0) {
-        operand_size = 8;
-        mem_operand_size = 8;
+        ir.operand_size = 8;
         mnemonic_str[mnemonic_str_len] = '\0';
     } else if(strends(mnemonic_str, "w") == 0) {
-        operand_size = 16;
-        mem_operand_size = 16;
+        ir.operand_size = 16;
         mnemonic_str[mnemonic_str_len] = '\0';
     } else if(strends(mnemonic_str, "l") == 0) {
-        operand_size = 32;
-        mem_operand_size = 32;
+        ir.operand_size = 32;
         mnemonic_str[mnemonic_str_len] = '\0';
     } else if(strends(mnemonic_str, "q") == 0) {
-        operand_size = 64;
-        mem_operand_size = 64;
+        ir.operand_size = 64;
         mnemonic_str[mnemonic_str_len] = '\0';
     }
 
-
-    const asm_instruction_mnemonic_map_t* map = asm_instruction_mnemonic_get(mnemonic_str);
-
-    if(map == NULL) {
-        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid instruction mnemonic %s", mnemonic_str);
-
-        memory_free(mnemonic_str);
-
-        return false;
-    }
-
-    asm_instruction_param_t params[4] = {0};
-    uint8_t param_count = 0;
+    ir.mnemonic = mnemonic_str;
 
     while(true) {
         it = it->next(it);
@@ -1134,7 +1475,7 @@ boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* reloc
             break;
         }
 
-        if(param_count >= 4) {
+        if(ir.param_count >= 4) {
             PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Too many parameters");
 
             memory_free(mnemonic_str);
@@ -1143,7 +1484,7 @@ boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* reloc
         }
 
 
-        if(!asm_parse_instruction_param(tok, &params[param_count])) {
+        if(!asm_parse_instruction_param(tok, &ir.params[ir.param_count])) {
             PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to parse instruction parameter op1 %s %i", tok->token_value, tok->token_type);
 
             memory_free(mnemonic_str);
@@ -1151,15 +1492,44 @@ boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* reloc
             return false;
         }
 
-        param_count++;
+        ir.param_count++;
     }
 
+    boolean_t result = asm_encode_ir_instruction(&ir, outbuf, relocs);
+
+    memory_free(mnemonic_str);
+
+    return result;
+}
+
+boolean_t asm_encode_ir_instruction(const asm_instruction_ir_t* ir, buffer_t* outbuf, list_t* relocs) {
+    boolean_t result = true;
+
+    if(ir == NULL || ir->mnemonic == NULL || ir->param_count > 4) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid instruction");
+
+        return false;
+    }
+
+    const asm_instruction_mnemonic_map_t* map = asm_instruction_mnemonic_get(ir->mnemonic);
+
+    if(map == NULL) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Invalid instruction mnemonic %s", ir->mnemonic);
+
+        return false;
+    }
+
+    const asm_instruction_param_t* params = ir->params;
+    uint8_t param_count = ir->param_count;
+    uint8_t operand_size = ir->operand_size;
+    uint8_t mem_operand_size = ir->operand_size;
+
     asm_instruction_mnemonic_t mnemonics[5] = {0};
     mnemonics[0] = map->mnemonic;
 
     uint8_t idx = 1;
 
-    if(operand_size == 0 && params[param_count - 1].type == ASM_INSTRUCTION_PARAM_TYPE_REGISTER) {
+    if(operand_size == 0 && param_count && params[param_count - 1].type == ASM_INSTRUCTION_PARAM_TYPE_REGISTER) {
         operand_size = params[param_count - 1].registers[0].register_size;
     }
 
@@ -1175,11 +1545,11 @@ boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* reloc
         mem_operand_size = map->default_mem_operand_size;
     }
 
-    if(mem_operand_size == 0 && params[param_count - 1].type == ASM_INSTRUCTION_PARAM_TYPE_MEMORY) {
+    if(mem_operand_size == 0 && param_count && params[param_count - 1].type == ASM_INSTRUCTION_PARAM_TYPE_MEMORY) {
         mem_operand_size = 64;
     }
 
-    if(mem_operand_size == 0 && params[param_count - 1].type == ASM_INSTRUCTION_PARAM_TYPE_REGISTER) {
+    if(mem_operand_size == 0 && param_count && params[param_count - 1].type == ASM_INSTRUCTION_PARAM_TYPE_REGISTER) {
         mem_operand_size = params[param_count - 1].registers[0].register_size;
     }
 
@@ -1194,8 +1564,6 @@ boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* reloc
     if(instr == NULL) {
         PRINTLOG(COMPILER_ASSEMBLER, LOG_ERROR, "Failed to find instruction");
 
-        memory_free(mnemonic_str);
-
         for(int64_t i = 0; i < param_count + 1; i++) {
             printf("mnemonic %i\n", mnemonics[i]);
         }
@@ -1203,9 +1571,6 @@ boolean_t asm_encode_instruction(iterator_t* it, buffer_t* outbuf, list_t* reloc
         return false;
     }
 
-    memory_free(mnemonic_str);
-
-
     if(instr->has_operand_size_override) {
         buffer_append_byte(outbuf, ASM_INSTRUCTION_PREFIX_OPERAND_SIZE_OVERRIDE);
     }
@@ -9,6 +9,7 @@
 #include <compiler/asm_instructions.h>
 #include <strings.h>
 #include <logging.h>
+#include <xxhash.h>
 
 MODULE("turnstone.compiler.assembler");
 
@@ -70,7 +71,119 @@ const asm_instruction_t*const asm_instructions_map[] = {
     asm_instructions_z,
 };
 
-asm_instruction_mnemonic_t asm_instruction_mnemonic_get_by_param(asm_instruction_param_t* param, uint8_t operand_size, uint8_t mem_operand_size) {
+/*! slot count of mnemonic string index, power of two, at least twice of mnemonic map */
+#define ASM_INSTRUCTION_MNEMONIC_INDEX_SIZE 256
+/*! max instruction count of all letter tables */
+#define ASM_INSTRUCTION_INDEX_MAX_COUNT     1024
+
+/*! index is not built */
+#define ASM_INSTRUCTION_INDEX_STATE_NONE     0
+/*! index is being built by another caller */
+#define ASM_INSTRUCTION_INDEX_STATE_BUILDING 1
+/*! index is ready */
+#define ASM_INSTRUCTION_INDEX_STATE_READY    2
+
+static volatile uint64_t asm_instruction_index_state = ASM_INSTRUCTION_INDEX_STATE_NONE;
+/*! open addressed mnemonic string hash, values are mnemonic map index + 1, 0 is empty slot */
+static uint16_t asm_instruction_mnemonic_index[ASM_INSTRUCTION_MNEMONIC_INDEX_SIZE];
+/*! instructions of all letter tables grouped by mnemonic, table order is kept inside a group */
+static const asm_instruction_t* asm_instruction_index[ASM_INSTRUCTION_INDEX_MAX_COUNT];
+/*! start of each mnemonic's group at asm_instruction_index, end is start of next mnemonic */
+static uint16_t asm_instruction_index_start[ASM_INSTRUCTION_MNEMONIC_COUNT + 1];
+
+static uint64_t asm_instruction_mnemonic_hash(const char_t* mnemonic_string) {
+    return xxhash3_64_hash(mnemonic_string, strlen(mnemonic_string)) & (ASM_INSTRUCTION_MNEMONIC_INDEX_SIZE - 1);
+}
+
+/**
+ * @brief builds mnemonic string hash and per mnemonic instruction groups
+ * @details tables are static, so index is built once at first lookup and never freed.
+ * @return true if index is usable
+ */
+static boolean_t asm_instruction_index_build(void) {
+    uint64_t state = __atomic_load_n(&asm_instruction_index_state, __ATOMIC_ACQUIRE);
+
+    while(state != ASM_INSTRUCTION_INDEX_STATE_READY) {
+        if(state == ASM_INSTRUCTION_INDEX_STATE_NONE &&
+           __atomic_compare_exchange_n(&asm_instruction_index_state, &state, ASM_INSTRUCTION_INDEX_STATE_BUILDING,
+                                       false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        asm volatile ("pause" ::: "memory");
+
+        state = __atomic_load_n(&asm_instruction_index_state, __ATOMIC_ACQUIRE);
+    }
+
+    if(state == ASM_INSTRUCTION_INDEX_STATE_READY) {
+        return true;
+    }
+
+    // first mnemonic string wins, as linear scan did
+    for(uint16_t i = 0; asm_instruction_mnemonic_map[i].mnemonic_string != NULL; i++) {
+        uint64_t slot = asm_instruction_mnemonic_hash(asm_instruction_mnemonic_map[i].mnemonic_string);
+        boolean_t duplicate = false;
+
+        while(asm_instruction_mnemonic_index[slot]) {
+            if(strcmp(asm_instruction_mnemonic_map[asm_instruction_mnemonic_index[slot] - 1].mnemonic_string,
+                      asm_instruction_mnemonic_map[i].mnemonic_string) == 0) {
+                duplicate = true;
+
+                break;
+            }
+
+            slot = (slot + 1) & (ASM_INSTRUCTION_MNEMONIC_INDEX_SIZE - 1);
+        }
+
+        if(!duplicate) {
+            asm_instruction_mnemonic_index[slot] = i + 1;
+        }
+    }
+
+    // counting sort of all tables by mnemonic
+    uint64_t count = 0;
+
+    for(uint32_t t = 0; t < 26; t++) {
+        for(const asm_instruction_t* instr = asm_instructions_map[t]; instr->general_mnemonic != NULL; instr++) {
+            if(instr->mnemonics[0] >= ASM_INSTRUCTION_MNEMONIC_COUNT) {
+                continue;
+            }
+
+            asm_instruction_index_start[instr->mnemonics[0] + 1]++;
+            count++;
+        }
+    }
+
+    if(count > ASM_INSTRUCTION_INDEX_MAX_COUNT) {
+        PRINTLOG(COMPILER_ASSEMBLER, LOG_FATAL, "instruction tables exceed index size %lli", count);
+
+        __atomic_store_n(&asm_instruction_index_state, ASM_INSTRUCTION_INDEX_STATE_NONE, __ATOMIC_RELEASE);
+
+        return false;
+    }
+
+    for(uint32_t m = 0; m < ASM_INSTRUCTION_MNEMONIC_COUNT; m++) {
+        asm_instruction_index_start[m + 1] += asm_instruction_index_start[m];
+    }
+
+    uint16_t fill[ASM_INSTRUCTION_MNEMONIC_COUNT];
+
+    memory_memcopy(asm_instruction_index_start, fill, sizeof(fill));
+
+    for(uint32_t t = 0; t < 26; t++) {
+        for(const asm_instruction_t* instr = asm_instructions_map[t]; instr->general_mnemonic != NULL; instr++) {
+            if(instr->mnemonics[0] < ASM_INSTRUCTION_MNEMONIC_COUNT) {
+                asm_instruction_index[fill[instr->mnemonics[0]]++] = instr;
+            }
+        }
+    }
+
+    __atomic_store_n(&asm_instruction_index_state, ASM_INSTRUCTION_INDEX_STATE_READY, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+asm_instruction_mnemonic_t asm_instruction_mnemonic_get_by_param(const asm_instruction_param_t* param, uint8_t operand_size, uint8_t mem_operand_size) {
     PRINTLOG(COMPILER_ASSEMBLER, LOG_TRACE, "param->type: %d", param->type);
 
     if(param->type == ASM_INSTRUCTION_PARAM_TYPE_IMMEDIATE) {
@@ -260,14 +373,20 @@ asm_instruction_mnemonic_t asm_instruction_mnemonic_get_by_param(asm_instruction
 }
 
 const asm_instruction_mnemonic_map_t* asm_instruction_mnemonic_get(const char_t* mnemonic_string) {
-    const asm_instruction_mnemonic_map_t* map = asm_instruction_mnemonic_map;
+    if (mnemonic_string == NULL || !asm_instruction_index_build()) {
+        return NULL;
+    }
+
+    uint64_t slot = asm_instruction_mnemonic_hash(mnemonic_string);
+
+    while (asm_instruction_mnemonic_index[slot]) {
+        const asm_instruction_mnemonic_map_t* map = &asm_instruction_mnemonic_map[asm_instruction_mnemonic_index[slot] - 1];
 
-    while (map->mnemonic_string != NULL) {
         if (strcmp(map->mnemonic_string, mnemonic_string) == 0) {
             return map;
         }
 
-        map++;
+        slot = (slot + 1) & (ASM_INSTRUCTION_MNEMONIC_INDEX_SIZE - 1);
     }
 
     return NULL;
@@ -282,59 +401,61 @@ const asm_instruction_t* asm_instruction_get(const asm_instruction_mnemonic_map_
         return NULL;
     }
 
-    uint32_t idx = map->mnemonic_string[0] - 'a';
-
-    if (idx > 25) {
+    if (map->mnemonic >= ASM_INSTRUCTION_MNEMONIC_COUNT || !asm_instruction_index_build()) {
         return NULL;
     }
 
-    const asm_instruction_t* asm_instructions = asm_instructions_map[idx];
+    // only forms of the same mnemonic can match, other table entries fail at the first mnemonic
+    const asm_instruction_t* const* asm_instructions = &asm_instruction_index[asm_instruction_index_start[map->mnemonic]];
+    uint16_t form_count = asm_instruction_index_start[map->mnemonic + 1] - asm_instruction_index_start[map->mnemonic];
+
+    for (uint16_t i = 0; i < form_count; i++) {
+        const asm_instruction_t* form = asm_instructions[i];
 
-    for (uint8_t i = 0; asm_instructions[i].general_mnemonic != NULL; i++) {
-        if(asm_instructions[i].instruction_length == instruction_length) {
+        if(form->instruction_length == instruction_length) {
             boolean_t found = true;
 
             for (uint8_t j = 0; j < instruction_length; j++) {
-                if (asm_instructions[i].mnemonics[j] != mnemonics[j]) {
+                if (form->mnemonics[j] != mnemonics[j]) {
 
-                    if(asm_instructions[i].mnemonics[j] <= ASM_INSTRUCTION_MNEMONIC_IMM_64 &&
+                    if(form->mnemonics[j] <= ASM_INSTRUCTION_MNEMONIC_IMM_64 &&
                        mnemonics[j] <= ASM_INSTRUCTION_MNEMONIC_IMM_64 &&
-                       asm_instructions[i].mnemonics[j] >= mnemonics[j]) {
+                       form->mnemonics[j] >= mnemonics[j]) {
                         continue;
                     }
 
                     if(mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_AL &&
-                       (asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_8 || asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_8)) {
+                       (form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_8 || form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_8)) {
                         continue;
                     } else if(mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_AX &&
-                              (asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_16 || asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_16)) {
+                              (form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_16 || form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_16)) {
                         continue;
                     } else if(mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_EAX &&
-                              (asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_32 || asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_32)) {
+                              (form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_32 || form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_32)) {
                         continue;
                     } else if(mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_RAX &&
-                              (asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_64 || asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_64)) {
+                              (form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_64 || form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_OR_M_64)) {
                         continue;
                     }
 
-                    if(asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_128 &&
+                    if(form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_R_128 &&
                        mnemonics[j] >= ASM_INSTRUCTION_MNEMONIC_XMM1 && mnemonics[j] <= ASM_INSTRUCTION_MNEMONIC_XMM2) {
                         continue;
                     }
 
-                    if(asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_XMM2_OR_MEM_64) {
+                    if(form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_XMM2_OR_MEM_64) {
                         if(mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_XMM2 ||
                            mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_M_64) {
                             continue;
                         }
-                    } else if(asm_instructions[i].mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_XMM2_OR_MEM_128) {
+                    } else if(form->mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_XMM2_OR_MEM_128) {
                         if(mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_XMM2 ||
                            mnemonics[j] == ASM_INSTRUCTION_MNEMONIC_M_128) {
                             continue;
                         }
                     }
 
-                    int16_t real_mnemonic_idx = asm_instructions[i].mnemonics[j] - ASM_INSTRUCTION_MNEMONIC_R_OR_M_8;
+                    int16_t real_mnemonic_idx = form->mnemonics[j] - ASM_INSTRUCTION_MNEMONIC_R_OR_M_8;
 
                     if (real_mnemonic_idx < 0 || real_mnemonic_idx > 4) {
                         found = false;
@@ -360,7 +481,7 @@ const asm_instruction_t* asm_instruction_get(const asm_instruction_mnemonic_map_
             }
 
             if (found) {
-                return &asm_instructions[i];
+                return form;
             }
         }
     }
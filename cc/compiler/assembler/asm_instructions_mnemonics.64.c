@@ -25,7 +25,7 @@ const asm_instruction_mnemonic_map_t asm_instruction_mnemonic_map[] = {
 
 
 
-    {"cli", ASM_INSTRUCTION_MNEMONIC_CPUID, 1, 1, 0, 0, 0},
+    {"cpuid", ASM_INSTRUCTION_MNEMONIC_CPUID, 1, 1, 0, 0, 0},
 
 
 
@@ -13,6 +13,152 @@
 
 MODULE("turnstone.compiler.codegen");
 
+static boolean_t compiler_is_power_of_two(int64_t value) {
+    return value > 1 && (value & (value - 1)) == 0;
+}
+
+/**
+ * @brief finds magic multiplier of signed division by a constant (hacker's delight 10-1)
+ * @param[in] divisor divisor, |divisor| >= 3 and not power of two
+ * @param[in] size operation size, 32 or 64
+ * @param[out] shift right shift of high half of product
+ * @return magic multiplier
+ */
+static int64_t compiler_find_division_magic(int64_t divisor, int64_t size, int64_t* shift) {
+    uint64_t mask = size == 64 ? -1ULL : (1ULL << size) - 1;
+    uint64_t two_w1 = 1ULL << (size - 1);
+    uint64_t ad = (divisor < 0 ? -(uint64_t)divisor : (uint64_t)divisor) & mask;
+    uint64_t t = two_w1 + (((uint64_t)divisor & mask) >> (size - 1));
+    uint64_t anc = t - 1 - t % ad;
+    uint64_t q1 = two_w1 / anc;
+    uint64_t r1 = two_w1 - q1 * anc;
+    uint64_t q2 = two_w1 / ad;
+    uint64_t r2 = two_w1 - q2 * ad;
+    uint64_t delta = 0;
+    int64_t p = size - 1;
+
+    do {
+        p++;
+
+        q1 = (2 * q1) & mask;
+        r1 = (2 * r1) & mask;
+
+        if(r1 >= anc) {
+            q1 = (q1 + 1) & mask;
+            r1 = (r1 - anc) & mask;
+        }
+
+        q2 = (2 * q2) & mask;
+        r2 = (2 * r2) & mask;
+
+        if(r2 >= ad) {
+            q2 = (q2 + 1) & mask;
+            r2 = (r2 - ad) & mask;
+        }
+
+        delta = ad - r2;
+    } while(q1 < delta || (q1 == delta && r1 == 0));
+
+    *shift = p - size;
+
+    uint64_t magic = (q2 + 1) & mask;
+
+    if(divisor < 0) {
+        magic = (-magic) & mask;
+    }
+
+    // sign extend to 64 bits
+    return size == 64 ? (int64_t)magic : (int64_t)(int32_t)magic;
+}
+
+/**
+ * @brief divides by a positive power of two with shifts, rounding toward zero as idiv
+ * @param[in] compiler compiler
+ * @param[in] node binary op node
+ * @param[in] left_at_reg dividend register, also result register
+ * @param[in] divisor divisor
+ * @param[in] size operation size
+ * @return true if code is generated
+ */
+static boolean_t compiler_execute_shift_divide(compiler_t* compiler, compiler_ast_node_t* node, int16_t left_at_reg, int64_t divisor, int64_t size) {
+    if(compiler->optimization_level < COMPILER_OPTIMIZATION_LEVEL_FULL || !compiler_is_power_of_two(divisor) || (size != 32 && size != 64)) {
+        return false;
+    }
+
+    int16_t tmp_reg = compiler_find_free_reg(compiler);
+
+    if(tmp_reg == -1) {
+        return false;
+    }
+
+    int64_t shift = __builtin_ctzll(divisor);
+    char_t reg_suffix = compiler_get_reg_suffix(size);
+    const char_t* left_reg = compiler_cast_reg_to_size(compiler_regs[left_at_reg], size);
+    const char_t* tmp = compiler_cast_reg_to_size(compiler_regs[tmp_reg], size);
+
+    // negative dividends need divisor - 1 added before shift
+    buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%%s\n", reg_suffix, left_reg, tmp);
+    buffer_printf(compiler->text_buffer, "\tsar%c $0x%llx, %%%s\n", reg_suffix, size - 1, tmp);
+    buffer_printf(compiler->text_buffer, "\tshr%c $0x%llx, %%%s\n", reg_suffix, size - shift, tmp);
+    buffer_printf(compiler->text_buffer, "\tadd%c %%%s, %%%s\n", reg_suffix, tmp, left_reg);
+    buffer_printf(compiler->text_buffer, "\tsar%c $0x%llx, %%%s\n", reg_suffix, shift, left_reg);
+
+    compiler->busy_regs[tmp_reg] = false;
+    node->used_register = left_at_reg;
+
+    return true;
+}
+
+/**
+ * @brief multiplies by 2^k with shl and by 3, 5 or 9 with lea
+ * @param[in] compiler compiler
+ * @param[in] at_reg register of non constant operand, also result register
+ * @param[in] factor constant operand
+ * @param[in] size operation size
+ * @return true if code is generated
+ */
+static boolean_t compiler_execute_shift_multiply(compiler_t* compiler, int16_t at_reg, int64_t factor, int64_t size) {
+    if(compiler->optimization_level < COMPILER_OPTIMIZATION_LEVEL_FULL || (size != 32 && size != 64)) {
+        return false;
+    }
+
+    char_t reg_suffix = compiler_get_reg_suffix(size);
+    const char_t* reg = compiler_cast_reg_to_size(compiler_regs[at_reg], size);
+
+    if(compiler_is_power_of_two(factor)) {
+        buffer_printf(compiler->text_buffer, "\tshl%c $0x%x, %%%s\n", reg_suffix, __builtin_ctzll(factor), reg);
+    } else if(factor == 3 || factor == 5 || factor == 9) {
+        buffer_printf(compiler->text_buffer, "\tlea%c (%%%s,%%%s,%lli), %%%s\n", reg_suffix, compiler_regs[at_reg], compiler_regs[at_reg], factor - 1, reg);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief computes a shift of constants as shl and shr instructions do at given width
+ * @param[in] is_left true for shl, false for logical shr
+ * @param[in] value shifted value
+ * @param[in] count shift count, masked like instruction does
+ * @param[in] size operation width in bits
+ * @return value of register after shift, sign extended from width
+ */
+static int64_t compiler_execute_const_shift(boolean_t is_left, int64_t value, int64_t count, int64_t size) {
+    int64_t width = size <= 8 ? 8 : size <= 16 ? 16 : size <= 32 ? 32 : 64;
+    uint64_t bits = width == 64 ? (uint64_t)value : (uint64_t)value & ((1ULL << width) - 1);
+
+    count &= width == 64 ? 63 : 31;
+
+    bits = is_left ? bits << count : bits >> count;
+
+    if(width == 64) {
+        return (int64_t)bits;
+    }
+
+    return (int64_t)(bits << (64 - width)) >> (64 - width);
+}
 
 int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result) {
     int64_t left = 0;
@@ -87,7 +233,9 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
 
         if(!node->is_const) {
             if(left_is_const) {
-                buffer_printf(compiler->text_buffer, "\tsub%c $0x%llx, %%%s\n", reg_suffix, left, right_reg);
+                // c - x = -x + c
+                buffer_printf(compiler->text_buffer, "\tneg%c %%%s\n", reg_suffix, right_reg);
+                buffer_printf(compiler->text_buffer, "\tadd%c $0x%llx, %%%s\n", reg_suffix, left, right_reg);
                 node->used_register = right_at_reg;
             } else if(right_is_const) {
                 buffer_printf(compiler->text_buffer, "\tsub%c $0x%llx, %%%s\n", reg_suffix, right, left_reg);
@@ -104,10 +252,16 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
 
         if(!node->is_const) {
             if(left_is_const) {
-                buffer_printf(compiler->text_buffer, "\timul%c $0x%llx, %%%s\n", reg_suffix, left, right_reg);
+                if(!compiler_execute_shift_multiply(compiler, right_at_reg, left, max_size)) {
+                    buffer_printf(compiler->text_buffer, "\timul%c $0x%llx, %%%s\n", reg_suffix, left, right_reg);
+                }
+
                 node->used_register = right_at_reg;
             } else if(right_is_const) {
-                buffer_printf(compiler->text_buffer, "\timul%c $0x%llx, %%%s\n", reg_suffix, right, left_reg);
+                if(!compiler_execute_shift_multiply(compiler, left_at_reg, right, max_size)) {
+                    buffer_printf(compiler->text_buffer, "\timul%c $0x%llx, %%%s\n", reg_suffix, right, left_reg);
+                }
+
                 node->used_register = left_at_reg;
             } else {
                 buffer_printf(compiler->text_buffer, "\timul%c %%%s, %%%s\n", reg_suffix, left_reg, right_reg);
@@ -119,7 +273,10 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
     } else if (node->token->type == COMPILER_TOKEN_TYPE_INTEGER_DIVIDE) {
         *result = left / right;
 
-        if(!node->is_const) {
+        if(!node->is_const && !left_is_const && right_is_const &&
+           compiler_execute_shift_divide(compiler, node, left_at_reg, right, max_size)) {
+            node->is_at_reg = true;
+        } else if(!node->is_const) {
             boolean_t need_swap = false;
             int16_t swap_reg = -1;
 
@@ -138,7 +295,7 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
 
             if(left_is_const) {
                 buffer_printf(compiler->text_buffer, "\tmov%c $0x%llx, %%%s\n", reg_suffix, left, compiler_cast_reg_to_size("rax", max_size));
-                buffer_printf(compiler->text_buffer, "\tcqo\n");
+                buffer_printf(compiler->text_buffer, "\t%s\n", max_size == 32 ? "cdq" : "cqo");
                 buffer_printf(compiler->text_buffer, "\tidiv%c %%%s\n", reg_suffix, right_reg);
                 node->used_register = 0;
             } else if(right_is_const) {
@@ -147,20 +304,56 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
                 int16_t const_swap_reg = compiler_find_free_reg(compiler);
                 compiler->busy_regs[3] = old_rdx_busy;
 
+                boolean_t const_swap_found = const_swap_reg != -1;
+
                 if(const_swap_reg == -1) {
                     const_swap_reg = 8;
                     buffer_printf(compiler->text_buffer, "\tpush %%%s\n", compiler_regs[right_at_reg]);
                 }
 
-                buffer_printf(compiler->text_buffer, "\tmov%c $0x%llx, %%%s\n", reg_suffix, right, compiler_cast_reg_to_size(compiler_regs[const_swap_reg], max_size));
+                int64_t abs_right = right < 0 ? -right : right;
+
+                // magic multiply needs dividend after product at rdx:rax
+                if(compiler->optimization_level >= COMPILER_OPTIMIZATION_LEVEL_FULL && const_swap_found &&
+                   left_at_reg != COMPILER_VM_REG_RAX && left_at_reg != COMPILER_VM_REG_RDX &&
+                   (max_size == 32 || max_size == 64) && abs_right > 2 && !compiler_is_power_of_two(abs_right)) {
+                    int64_t shift = 0;
+                    int64_t magic = compiler_find_division_magic(right, max_size, &shift);
+                    const char_t* rax_reg = compiler_cast_reg_to_size("rax", max_size);
+                    const char_t* rdx_reg = compiler_cast_reg_to_size("rdx", max_size);
+                    const char_t* dividend_reg = compiler_cast_reg_to_size(compiler_regs[left_at_reg], max_size);
+
+                    buffer_printf(compiler->text_buffer, "\tmov%c $0x%llx, %%%s\n", reg_suffix,
+                                  max_size == 64 ? magic : (int64_t)(uint32_t)magic,
+                                  compiler_cast_reg_to_size(compiler_regs[const_swap_reg], max_size));
+                    buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%%s\n", reg_suffix, dividend_reg, rax_reg);
+                    buffer_printf(compiler->text_buffer, "\timul%c %%%s\n", reg_suffix, compiler_cast_reg_to_size(compiler_regs[const_swap_reg], max_size));
+
+                    if(right > 0 && magic < 0) {
+                        buffer_printf(compiler->text_buffer, "\tadd%c %%%s, %%%s\n", reg_suffix, dividend_reg, rdx_reg);
+                    } else if(right < 0 && magic > 0) {
+                        buffer_printf(compiler->text_buffer, "\tsub%c %%%s, %%%s\n", reg_suffix, dividend_reg, rdx_reg);
+                    }
 
+                    if(shift) {
+                        buffer_printf(compiler->text_buffer, "\tsar%c $0x%llx, %%%s\n", reg_suffix, shift, rdx_reg);
+                    }
 
-                buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%%s\n",
-                              reg_suffix,
-                              compiler_cast_reg_to_size(compiler_regs[left_at_reg], max_size),
-                              compiler_cast_reg_to_size("rax", max_size));
-                buffer_printf(compiler->text_buffer, "\tcqo\n");
-                buffer_printf(compiler->text_buffer, "\tidiv%c %%%s\n", reg_suffix, compiler_cast_reg_to_size(compiler_regs[const_swap_reg], max_size));
+                    // quotient rounds toward zero, add one for negative results
+                    buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%%s\n", reg_suffix, rdx_reg, rax_reg);
+                    buffer_printf(compiler->text_buffer, "\tshr%c $0x%llx, %%%s\n", reg_suffix, max_size - 1, rax_reg);
+                    buffer_printf(compiler->text_buffer, "\tadd%c %%%s, %%%s\n", reg_suffix, rdx_reg, rax_reg);
+                } else {
+                    buffer_printf(compiler->text_buffer, "\tmov%c $0x%llx, %%%s\n", reg_suffix, right, compiler_cast_reg_to_size(compiler_regs[const_swap_reg], max_size));
+
+
+                    buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%%s\n",
+                                  reg_suffix,
+                                  compiler_cast_reg_to_size(compiler_regs[left_at_reg], max_size),
+                                  compiler_cast_reg_to_size("rax", max_size));
+                    buffer_printf(compiler->text_buffer, "\t%s\n", max_size == 32 ? "cdq" : "cqo");
+                    buffer_printf(compiler->text_buffer, "\tidiv%c %%%s\n", reg_suffix, compiler_cast_reg_to_size(compiler_regs[const_swap_reg], max_size));
+                }
                 compiler->busy_regs[left_at_reg] = false;
                 node->used_register = 0;
 
@@ -171,7 +364,7 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
                 }
             } else {
                 buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%rax\n", reg_suffix, compiler_cast_reg_to_size(compiler_regs[left_at_reg], max_size));
-                buffer_printf(compiler->text_buffer, "\tcqo\n");
+                buffer_printf(compiler->text_buffer, "\t%s\n", max_size == 32 ? "cdq" : "cqo");
                 buffer_printf(compiler->text_buffer, "\tidiv%c %%%s\n", reg_suffix, compiler_cast_reg_to_size(compiler_regs[right_at_reg], max_size));
                 node->used_register = 0;
                 compiler->busy_regs[left_at_reg] = false;
@@ -287,7 +480,7 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
             node->is_at_reg = true;
         }
     } else if(node->token->type == COMPILER_TOKEN_TYPE_SHL) {
-        *result = left << right;
+        *result = compiler_execute_const_shift(true, left, right, max_size);
 
         if(!node->is_const) {
             if(left_is_const) {
@@ -315,7 +508,7 @@ int8_t compiler_execute_binary_op(compiler_t* compiler, compiler_ast_node_t* nod
             node->is_at_reg = true;
         }
     }  else if(node->token->type == COMPILER_TOKEN_TYPE_SHR) {
-        *result = left >> right;
+        *result = compiler_execute_const_shift(false, left, right, max_size);
 
         if(!node->is_const) {
             if(left_is_const) {
@@ -265,7 +265,7 @@ int8_t compiler_execute_block_var(compiler_t* compiler, compiler_ast_node_t* nod
     for(size_t j = 0; j < list_size(node->children); j++) {
         compiler_symbol_t * tmp_symbol = (compiler_symbol_t*)list_get_data_at_position(node->children, j);
 
-        if(strcmp(compiler->program_name, tmp_symbol->name) != 0 && hashmap_get(compiler->current_symbol_table->symbols, tmp_symbol->name) != NULL) {
+        if(strcmp(compiler->program_name, tmp_symbol->name) != 0 && compiler_find_symbol_at_current_scope(compiler, tmp_symbol) != NULL) {
             PRINTLOG(COMPILER, LOG_ERROR, "symbol %s already defined", tmp_symbol->name);
             return -1;
         }
@@ -286,7 +286,9 @@ int8_t compiler_execute_block_var(compiler_t* compiler, compiler_ast_node_t* nod
 
         }
 
-        hashmap_put(compiler->current_symbol_table->symbols, tmp_symbol->name, tmp_symbol);
+        if(compiler_bind_symbol(compiler, tmp_symbol, false) != 0) {
+            return -1;
+        }
     }
 
     return 0;
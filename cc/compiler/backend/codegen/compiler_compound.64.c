@@ -18,22 +18,10 @@ int8_t compiler_execute_compound(compiler_t* compiler, compiler_ast_node_t* node
         return 0;
     }
 
-    compiler_symbol_table_t* symbol_table = memory_malloc(sizeof(compiler_symbol_table_t));
-
-    if (symbol_table == NULL) {
-        return -1;
-    }
-
-    symbol_table->symbols = hashmap_string(128);
-
-    if (symbol_table->symbols == NULL) {
-        memory_free(symbol_table);
+    if (compiler_enter_scope(compiler) != 0) {
         return -1;
     }
 
-    symbol_table->parent = compiler->current_symbol_table;
-    compiler->current_symbol_table = symbol_table;
-
     for(size_t i = 0; i < list_size(node->children); i++) {
         compiler_ast_node_t * tmp_node = (compiler_ast_node_t*)list_get_data_at_position(node->children, i);
 
@@ -44,7 +32,7 @@ int8_t compiler_execute_compound(compiler_t* compiler, compiler_ast_node_t* node
                 for(size_t k = 0; k < list_size(tmp_var_node->children); k++) {
                     compiler_symbol_t * tmp_symbol = (compiler_symbol_t*)list_get_data_at_position(tmp_var_node->children, k);
 
-                    if(strcmp(compiler->program_name, tmp_symbol->name) != 0 && hashmap_get(compiler->current_symbol_table->symbols, tmp_symbol->name) != NULL) {
+                    if(strcmp(compiler->program_name, tmp_symbol->name) != 0 && compiler_find_symbol_at_current_scope(compiler, tmp_symbol) != NULL) {
                         PRINTLOG(COMPILER, LOG_ERROR, "symbol %s already defined", tmp_symbol->name);
                         return -1;
                     }
@@ -121,7 +109,9 @@ int8_t compiler_execute_compound(compiler_t* compiler, compiler_ast_node_t* node
                         return -1;
                     }
 
-                    hashmap_put(compiler->current_symbol_table->symbols, tmp_symbol->name, tmp_symbol);
+                    if(compiler_bind_symbol(compiler, tmp_symbol, false) != 0) {
+                        return -1;
+                    }
                 }
 
             }
@@ -137,9 +127,19 @@ int8_t compiler_execute_compound(compiler_t* compiler, compiler_ast_node_t* node
         return -1;
     }
 
+    // first compound is program body, its statements are allocation unit
+    if(compiler->optimization_level >= COMPILER_OPTIMIZATION_LEVEL_BASIC && compiler->regalloc == NULL && compiler_regalloc_build(compiler, node) != 0) {
+        PRINTLOG(COMPILER, LOG_ERROR, "cannot allocate registers");
+        return -1;
+    }
+
     for(size_t i = 0; i < list_size(node->children); i++) {
         compiler_ast_node_t * tmp_node = (compiler_ast_node_t*)list_get_data_at_position(node->children, i);
 
+        if(compiler_regalloc_begin_statement(compiler, node, i) != 0) {
+            return -1;
+        }
+
         if(tmp_node->type != COMPILER_AST_NODE_TYPE_DECLS && compiler_execute_ast_node(compiler, tmp_node, result) != 0) {
             return -1;
         }
@@ -148,14 +148,13 @@ int8_t compiler_execute_compound(compiler_t* compiler, compiler_ast_node_t* node
             buffer_printf(compiler->text_buffer, "# free register %s\n", compiler_regs[tmp_node->used_register]);
             compiler->busy_regs[tmp_node->used_register] = false;
         }
-    }
 
-    compiler->current_symbol_table = compiler->current_symbol_table->parent;
-
-    hashmap_destroy(symbol_table->symbols);
-    memory_free(symbol_table);
+        if(compiler_regalloc_end_statement(compiler, node, i) != 0) {
+            return -1;
+        }
+    }
 
-    return 0;
+    return compiler_leave_scope(compiler);
 }
 
 
@@ -12,7 +12,55 @@
 
 MODULE("turnstone.compiler.codegen");
 
+int8_t compiler_execute_save_register(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result, const compiler_symbol_t* symbol, int16_t symbol_register);
+
+int8_t compiler_execute_save_register(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result, const compiler_symbol_t* symbol, int16_t symbol_register) {
+    buffer_printf(compiler->text_buffer, "# begin save to register %s\n", compiler_regs[symbol_register]);
+
+    node->left->computed_size = symbol->size;
+    node->left->computed_type = symbol->type;
+
+    if(node->right->type != COMPILER_AST_NODE_TYPE_NO_OP) {
+        if(compiler_execute_ast_node(compiler, node->right, result) != 0) {
+            return -1;
+        }
+
+        if(node->right->is_const) {
+            buffer_printf(compiler->text_buffer, "\tmov%c $%lli, %%%s\n",
+                          compiler_get_reg_suffix(symbol->size),
+                          *result,
+                          compiler_cast_reg_to_size(compiler_regs[symbol_register], symbol->size));
+        } else {
+            if(node->right->computed_size < symbol->size) {
+                buffer_printf(compiler->text_buffer, "\tmovsx %%%s, %%%s\n",
+                              compiler_cast_reg_to_size(compiler_regs[node->right->used_register], node->right->computed_size),
+                              compiler_cast_reg_to_size(compiler_regs[symbol_register], symbol->size));
+            } else {
+                buffer_printf(compiler->text_buffer, "\tmov%c %%%s, %%%s\n",
+                              compiler_get_reg_suffix(symbol->size),
+                              compiler_cast_reg_to_size(compiler_regs[node->right->used_register], symbol->size),
+                              compiler_cast_reg_to_size(compiler_regs[symbol_register], symbol->size));
+            }
+
+            compiler->busy_regs[node->right->used_register] = false;
+        }
+    }
+
+    buffer_printf(compiler->text_buffer, "# end save to register %s\n", compiler_regs[symbol_register]);
+
+    return 0;
+}
+
 int8_t compiler_execute_save(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result) {
+    if(node->left->type == COMPILER_AST_NODE_TYPE_VAR && node->left->right == NULL) {
+        const compiler_symbol_t* symbol = compiler_find_symbol_by_token(compiler, node->left->token);
+        int16_t symbol_register = compiler_regalloc_get_register(compiler, symbol);
+
+        if(symbol_register != -1) {
+            return compiler_execute_save_register(compiler, node, result, symbol, symbol_register);
+        }
+    }
+
     buffer_printf(compiler->text_buffer, "# begin save\n");
     buffer_printf(compiler->text_buffer, "# begin get left\n");
 
@@ -44,8 +92,6 @@ int8_t compiler_execute_save(compiler_t* compiler, compiler_ast_node_t* node, in
                           compiler_get_reg_suffix(node->left->computed_size),
                           *result,
                           compiler_regs[node->left->used_register]);
-
-            return 0;
         } else {
             if(node->right->computed_size < node->left->computed_size) {
                 buffer_printf(compiler->text_buffer, "\tmovsx %%%s, %%%s\n",
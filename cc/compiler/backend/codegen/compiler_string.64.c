@@ -61,7 +61,5 @@ int8_t compiler_execute_string_const(compiler_t* compiler, compiler_ast_node_t*
     buffer_printf(compiler->rodata_buffer, "\t.string \"%s\"\n", symbol->string_value);
     buffer_printf(compiler->rodata_buffer, "\n\n\n");
 
-    hashmap_put(compiler->main_symbol_table->symbols, symbol->name, symbol);
-
-    return 0;
+    return compiler_bind_symbol(compiler, symbol, true);
 }
@@ -36,9 +36,7 @@ int8_t compiler_execute_unary_op(compiler_t* compiler, compiler_ast_node_t* node
             buffer_printf(compiler->text_buffer, "\tneg%c %%%s\n",
                           compiler_get_reg_suffix(node->right->computed_size),
                           compiler_cast_reg_to_size(compiler_regs[node->right->used_register], node->right->computed_size));
-        } else if(node->right->is_const) {
-            *result = -*result;
-        } else {
+        } else if(!node->right->is_const) {
             PRINTLOG(COMPILER, LOG_ERROR, "unsupported");
             return -1;
         }
@@ -50,9 +48,7 @@ int8_t compiler_execute_unary_op(compiler_t* compiler, compiler_ast_node_t* node
             buffer_printf(compiler->text_buffer, "\tnot%c %%%s\n",
                           compiler_get_reg_suffix(node->right->computed_size),
                           compiler_cast_reg_to_size(compiler_regs[node->right->used_register], node->right->computed_size));
-        } else if(node->right->is_const) {
-            *result = !*result;
-        } else {
+        } else if(!node->right->is_const) {
             PRINTLOG(COMPILER, LOG_ERROR, "unsupported");
 
             return -1;
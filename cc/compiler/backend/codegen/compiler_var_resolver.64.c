@@ -41,7 +41,7 @@ int8_t compiler_var_resolver(compiler_t* compiler, compiler_ast_node_t* node, in
         return -1;
     }
 
-    symbol = compiler_find_symbol(compiler, node->token->text);
+    symbol = compiler_find_symbol_by_token(compiler, node->token);
 
     if(symbol == NULL) {
         PRINTLOG(COMPILER, LOG_ERROR, "symbol %s not found", node->token->text);
@@ -54,8 +54,13 @@ int8_t compiler_var_resolver(compiler_t* compiler, compiler_ast_node_t* node, in
     computed_custom_type_id = symbol->custom_type_id;
     boolean_t computed_is_array = symbol->is_array;
     boolean_t computed_is_scalar = false;
+    int16_t symbol_register = node->right == NULL ? compiler_regalloc_get_register(compiler, symbol) : -1;
 
-    if(!symbol->is_local) {
+    if(symbol_register != -1) {
+        // variable is kept at register, value is copied because expressions consume their registers
+        buffer_printf(compiler->text_buffer, "\tmov %%%s, %%%s\n", compiler_regs[symbol_register], compiler_regs[used_register]);
+        computed_is_scalar = true;
+    } else if(!symbol->is_local) {
         buffer_printf(compiler->text_buffer, "\tmov $%s@GOT, %%%s\n", symbol->name, compiler_regs[used_register]);
         buffer_printf(compiler->text_buffer, "\tmov (%%r15, %%%s), %%%s\n", compiler_regs[used_register], compiler_regs[used_register]);
     } else {
@@ -33,7 +33,12 @@ int8_t compiler_execute_ast_node(compiler_t* compiler, compiler_ast_node_t* node
         symbol->stack_offset = 8;
         symbol->is_local = true;
 
-        hashmap_put(compiler->current_symbol_table->symbols, symbol->name, symbol);
+        symbol->identifier_id = node->token->identifier_id;
+
+        if(compiler_bind_symbol(compiler, symbol, true) != 0) {
+            memory_free(symbol);
+            return -1;
+        }
 
         compiler->program_name = symbol->name;
         compiler->program_name_symbol = symbol;
@@ -69,6 +74,21 @@ int8_t compiler_execute_ast_node(compiler_t* compiler, compiler_ast_node_t* node
 
         buffer_printf(tmp_buffer, "\tenter $%d, $0\n", compiler->stack_size);
 
+        if(compiler->optimization_level >= COMPILER_OPTIMIZATION_LEVEL_FULL) {
+            buffer_t* optimized_buffer = compiler_peephole(compiler, compiler->text_buffer);
+
+            buffer_destroy(compiler->text_buffer);
+            compiler->text_buffer = tmp_buffer;
+
+            if(optimized_buffer == NULL) {
+                PRINTLOG(COMPILER, LOG_ERROR, "cannot optimize program %s", symbol->name);
+
+                return -1;
+            }
+
+            compiler->text_buffer = optimized_buffer;
+        }
+
         buffer_printf(tmp_buffer, "%s", buffer_get_view_at_position(compiler->text_buffer, 0, buffer_get_length(compiler->text_buffer)));
 
         buffer_destroy(compiler->text_buffer);
@@ -142,6 +162,11 @@ int8_t compiler_execute(compiler_t * compiler, int64_t* result) {
     buffer_printf(compiler->text_buffer, "\tadd %%r14, %%r15\n");
     buffer_printf(compiler->text_buffer, "\txor %%rax, %%rax\n");
 
+    if(compiler->optimization_level >= COMPILER_OPTIMIZATION_LEVEL_BASIC && compiler_optimize_ast(compiler) != 0) {
+        PRINTLOG(COMPILER, LOG_ERROR, "cannot optimize program");
+
+        return -1;
+    }
 
     int8_t res = compiler_execute_ast_node(compiler, node, result);
 
@@ -187,30 +212,20 @@ int8_t compiler_init(compiler_t * compiler, compiler_ast_t * ast) {
         return -1;
     }
 
-    compiler_symbol_table_t* symbol_table = memory_malloc(sizeof(compiler_symbol_table_t));
-
-    if (symbol_table == NULL) {
-        buffer_destroy(compiler->text_buffer);
-        buffer_destroy(compiler->data_buffer);
-        buffer_destroy(compiler->rodata_buffer);
-        buffer_destroy(compiler->bss_buffer);
-        return -1;
+    if(ast->identifiers == NULL) {
+        ast->identifiers = compiler_identifier_pool_create();
     }
 
-    symbol_table->symbols = hashmap_string(128);
+    compiler->identifiers = ast->identifiers;
 
-    if (symbol_table->symbols == NULL) {
+    if (compiler->identifiers == NULL || compiler_init_symbol_table(compiler) != 0) {
         buffer_destroy(compiler->text_buffer);
         buffer_destroy(compiler->data_buffer);
         buffer_destroy(compiler->rodata_buffer);
         buffer_destroy(compiler->bss_buffer);
-        memory_free(symbol_table);
         return -1;
     }
 
-    compiler->main_symbol_table = symbol_table;
-    compiler->current_symbol_table = symbol_table;
-
     compiler->external_symbols = hashmap_string(128);
 
     if (compiler->external_symbols == NULL) {
@@ -218,8 +233,7 @@ int8_t compiler_init(compiler_t * compiler, compiler_ast_t * ast) {
         buffer_destroy(compiler->data_buffer);
         buffer_destroy(compiler->rodata_buffer);
         buffer_destroy(compiler->bss_buffer);
-        hashmap_destroy(symbol_table->symbols);
-        memory_free(symbol_table);
+        compiler_destroy_symbol_table(compiler);
         return -1;
     }
 
@@ -231,14 +245,15 @@ int8_t compiler_init(compiler_t * compiler, compiler_ast_t * ast) {
     compiler->cond_label_stack = list_create_stack();
     compiler->loop_label_stack = list_create_stack();
 
+    compiler->optimization_level = COMPILER_OPTIMIZATION_LEVEL_BASIC;
+
     if (compiler->cond_label_stack == NULL) {
         buffer_destroy(compiler->text_buffer);
         buffer_destroy(compiler->data_buffer);
         buffer_destroy(compiler->rodata_buffer);
         buffer_destroy(compiler->bss_buffer);
-        hashmap_destroy(symbol_table->symbols);
+        compiler_destroy_symbol_table(compiler);
         hashmap_destroy(compiler->external_symbols);
-        memory_free(symbol_table);
         return -1;
     }
 
@@ -275,6 +290,8 @@ int8_t compiler_destroy(compiler_t * compiler) {
     list_destroy(compiler->cond_label_stack);
     list_destroy(compiler->loop_label_stack);
 
+    compiler_regalloc_destroy(compiler);
+
     compiler_destroy_symbol_table(compiler);
     compiler_destroy_external_symbols(compiler);
 
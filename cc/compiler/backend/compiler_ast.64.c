@@ -15,6 +15,7 @@ MODULE("turnstone.compiler");
 
 int8_t compiler_ast_init(compiler_ast_t * ast) {
     ast->root = NULL;
+    ast->identifiers = NULL;
     return 0;
 }
 
@@ -111,6 +112,11 @@ int8_t compiler_ast_destroy(compiler_ast_t * ast) {
     // travels from root to leafs and frees nodes
     // in post-order traversal
 
+    if(ast->identifiers) {
+        compiler_identifier_pool_destroy(ast->identifiers);
+        ast->identifiers = NULL;
+    }
+
     compiler_ast_node_t * node = ast->root;
 
     if (node == NULL) {
@@ -0,0 +1,114 @@
+/**
+ * @file compiler_identifiers.64.c
+ * @brief interned identifier pool
+ *
+ * lexer interns every identifier once, tokens and symbols carry the integer id. later stages index arrays by id
+ * instead of hashing names again.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <compiler/compiler.h>
+#include <logging.h>
+#include <strings.h>
+
+MODULE("turnstone.compiler");
+
+/*! initial name capacity of pool */
+#define COMPILER_IDENTIFIER_POOL_INITIAL_CAPACITY 256
+
+compiler_identifier_pool_t* compiler_identifier_pool_create(void) {
+    compiler_identifier_pool_t* pool = memory_malloc(sizeof(compiler_identifier_pool_t));
+
+    if(pool == NULL) {
+        return NULL;
+    }
+
+    pool->ids = hashmap_string(COMPILER_IDENTIFIER_POOL_INITIAL_CAPACITY);
+    pool->names = memory_malloc(sizeof(char_t*) * COMPILER_IDENTIFIER_POOL_INITIAL_CAPACITY);
+
+    if(pool->ids == NULL || pool->names == NULL) {
+        hashmap_destroy(pool->ids);
+        memory_free(pool->names);
+        memory_free(pool);
+
+        return NULL;
+    }
+
+    pool->capacity = COMPILER_IDENTIFIER_POOL_INITIAL_CAPACITY;
+    pool->count = 1; // id 0 means not interned
+
+    return pool;
+}
+
+int8_t compiler_identifier_pool_destroy(compiler_identifier_pool_t* pool) {
+    if(pool == NULL) {
+        return -1;
+    }
+
+    for(int64_t i = 1; i < pool->count; i++) {
+        memory_free(pool->names[i]);
+    }
+
+    hashmap_destroy(pool->ids);
+    memory_free(pool->names);
+    memory_free(pool);
+
+    return 0;
+}
+
+int64_t compiler_identifier_pool_find(const compiler_identifier_pool_t* pool, const char_t* name) {
+    if(pool == NULL || name == NULL) {
+        return 0;
+    }
+
+    return (int64_t)hashmap_get(pool->ids, name);
+}
+
+int64_t compiler_identifier_pool_intern(compiler_identifier_pool_t* pool, const char_t* name) {
+    int64_t id = compiler_identifier_pool_find(pool, name);
+
+    if(id != 0 || pool == NULL || name == NULL) {
+        return id;
+    }
+
+    if(pool->count == pool->capacity) {
+        char_t** names = memory_malloc(sizeof(char_t*) * pool->capacity * 2);
+
+        if(names == NULL) {
+            PRINTLOG(COMPILER, LOG_ERROR, "cannot grow identifier pool");
+
+            return 0;
+        }
+
+        memory_memcopy(pool->names, names, sizeof(char_t*) * pool->count);
+        memory_free(pool->names);
+
+        pool->names = names;
+        pool->capacity *= 2;
+    }
+
+    char_t* pooled_name = strdup(name);
+
+    if(pooled_name == NULL) {
+        return 0;
+    }
+
+    id = pool->count;
+
+    hashmap_put(pool->ids, pooled_name, (void*)id);
+
+    pool->names[id] = pooled_name;
+    pool->count++;
+
+    return id;
+}
+
+const char_t* compiler_identifier_pool_get_name(const compiler_identifier_pool_t* pool, int64_t id) {
+    if(pool == NULL || id <= 0 || id >= pool->count) {
+        return NULL;
+    }
+
+    return pool->names[id];
+}
@@ -0,0 +1,975 @@
+/**
+ * @file compiler_optimizer.64.c
+ * @brief ast level optimizations before code generation
+ *
+ * constant folding and propagation, dead branch and dead store elimination. scalar integer variables declared
+ * once are tracked by name, their known values flow through statements in program order. loops forget the
+ * variables assigned inside them, if branches keep only values both sides agree. folding follows the constant
+ * evaluation of code generation, so folded and unfolded programs compute the same values.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <compiler/compiler.h>
+#include <int_limits.h>
+#include <logging.h>
+#include <strings.h>
+#include <utils.h>
+
+MODULE("turnstone.compiler");
+
+/*! dead store elimination rounds, each round can expose new dead stores */
+#define COMPILER_OPTIMIZER_MAX_DSE_ROUNDS 8
+
+typedef struct compiler_optimizer_var_t {
+    const compiler_symbol_t* symbol; ///< declaration of variable
+    boolean_t                is_global; ///< declared at program block
+    boolean_t                is_ambiguous; ///< declared more than once, not tracked
+    int64_t                  read_count; ///< reads at expressions
+} compiler_optimizer_var_t;
+
+typedef struct compiler_optimizer_env_t {
+    boolean_t* known; ///< value of variable is known
+    int64_t*   values; ///< known values
+} compiler_optimizer_env_t;
+
+typedef struct compiler_optimizer_t {
+    compiler_t*                compiler; ///< compiler
+    const char_t*              program_name; ///< program name, its variable is result of program
+    int64_t*                   var_indexes; ///< identifier id to index + 1
+    int64_t                    identifier_count; ///< identifier count of pool, size of var_indexes
+    compiler_optimizer_var_t*  vars; ///< tracked variables
+    int64_t                    var_count; ///< tracked variable count
+    int64_t                    folded_count; ///< folded expressions
+    int64_t                    propagated_count; ///< variable reads replaced with constants
+    int64_t                    eliminated_count; ///< removed statements and branches
+} compiler_optimizer_t;
+
+static int64_t compiler_optimizer_truncate(int64_t value, int64_t size) {
+    if(size <= 0 || size >= 64) {
+        return value;
+    }
+
+    int64_t shift = 64 - size;
+
+    return (int64_t)((uint64_t)value << shift) >> shift;
+}
+
+static boolean_t compiler_optimizer_is_scalar(const compiler_symbol_t* symbol) {
+    if(symbol->type != COMPILER_SYMBOL_TYPE_INTEGER || symbol->is_array || symbol->hidden_type == COMPILER_SYMBOL_TYPE_STRING) {
+        return false;
+    }
+
+    return symbol->size == 8 || symbol->size == 16 || symbol->size == 32 || symbol->size == 64;
+}
+
+static boolean_t compiler_optimizer_is_const(const compiler_ast_node_t* node) {
+    return node && node->type == COMPILER_AST_NODE_TYPE_INTEGER_CONST && node->token;
+}
+
+static int64_t compiler_optimizer_identifier_id(const compiler_optimizer_t* opt, int64_t identifier_id, const char_t* name) {
+    if(identifier_id == 0) {
+        identifier_id = compiler_identifier_pool_find(opt->compiler->identifiers, name);
+    }
+
+    if(identifier_id <= 0 || identifier_id >= opt->identifier_count) {
+        return 0;
+    }
+
+    return identifier_id;
+}
+
+static int64_t compiler_optimizer_symbol_index(const compiler_optimizer_t* opt, const compiler_symbol_t* symbol) {
+    return opt->var_indexes[compiler_optimizer_identifier_id(opt, symbol->identifier_id, symbol->name)] - 1;
+}
+
+static int64_t compiler_optimizer_var_index(compiler_optimizer_t* opt, const compiler_ast_node_t* node) {
+    if(!node->token || node->token->type != COMPILER_TOKEN_TYPE_ID || !node->token->text) {
+        return -1;
+    }
+
+    int64_t idx = opt->var_indexes[compiler_optimizer_identifier_id(opt, node->token->identifier_id, node->token->text)] - 1;
+
+    if(idx < 0 || opt->vars[idx].is_ambiguous) {
+        return -1;
+    }
+
+    return idx;
+}
+
+static boolean_t compiler_optimizer_contains(const compiler_ast_node_t* node, compiler_ast_node_type_t type) {
+    if(!node) {
+        return false;
+    }
+
+    if(node->type == type) {
+        return true;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_DECLS) {
+        return false;
+    }
+
+    if(compiler_optimizer_contains(node->left, type) ||
+       compiler_optimizer_contains(node->right, type) ||
+       compiler_optimizer_contains(node->condition, type)) {
+        return true;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_COMPOUND || node->type == COMPILER_AST_NODE_TYPE_FUNCTION_CALL) {
+        for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+            if(compiler_optimizer_contains(list_get_data_at_position(node->children, i), type)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief estimates computed size of an expression as code generation does
+ * @param[in] opt optimizer
+ * @param[in] node expression
+ * @return size in bits, 0 if unknown
+ */
+static int64_t compiler_optimizer_size(compiler_optimizer_t* opt, const compiler_ast_node_t* node) {
+    if(!node) {
+        return 0;
+    }
+
+    if(compiler_optimizer_is_const(node)) {
+        return node->token->size;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_VAR && node->right == NULL) {
+        int64_t idx = compiler_optimizer_var_index(opt, node);
+
+        return idx == -1 ? 0 : opt->vars[idx].symbol->size;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_BINARY_OP) {
+        int64_t left_size = compiler_optimizer_size(opt, node->left);
+        int64_t right_size = compiler_optimizer_size(opt, node->right);
+
+        if(!left_size || !right_size) {
+            return 0;
+        }
+
+        return MAX(left_size, right_size);
+    }
+
+    return 0;
+}
+
+static void compiler_optimizer_free_token(compiler_ast_node_t* node) {
+    if(node->token != NULL && node->token->not_free == false) {
+        memory_free((void*)node->token->text);
+        memory_free(node->token);
+    }
+
+    node->token = NULL;
+}
+
+static void compiler_optimizer_destroy_operands(compiler_ast_node_t* node) {
+    if(node->left) {
+        compiler_ast_node_destroy(node->left);
+        node->left = NULL;
+    }
+
+    if(node->right) {
+        compiler_ast_node_destroy(node->right);
+        node->right = NULL;
+    }
+
+    if(node->condition) {
+        compiler_ast_node_destroy(node->condition);
+        node->condition = NULL;
+    }
+}
+
+static void compiler_optimizer_make_const(compiler_optimizer_t* opt, compiler_ast_node_t* node, int64_t value) {
+    UNUSED(opt);
+
+    compiler_optimizer_destroy_operands(node);
+
+    if(node->token == NULL || node->token->not_free) {
+        node->token = memory_malloc(sizeof(compiler_token_t));
+
+        if(node->token == NULL) {
+            return;
+        }
+    }
+
+    node->type = COMPILER_AST_NODE_TYPE_INTEGER_CONST;
+    node->token->type = COMPILER_TOKEN_TYPE_INTEGER_CONST;
+    node->token->value = value;
+    node->token->size = (value >= INT32_MIN && value <= INT32_MAX) ? 32 : 64;
+}
+
+static void compiler_optimizer_make_no_op(compiler_ast_node_t* node) {
+    compiler_optimizer_destroy_operands(node);
+
+    if(node->children) {
+        list_destroy_with_type(node->children, LIST_DESTROY_WITH_DATA, compiler_ast_node_destroyer);
+        node->children = NULL;
+    }
+
+    node->type = COMPILER_AST_NODE_TYPE_NO_OP;
+}
+
+/**
+ * @brief replaces node with one of its parts, other parts are destroyed
+ * @param[in] node node to replace
+ * @param[in] part left, right or condition of node
+ */
+static void compiler_optimizer_replace(compiler_ast_node_t* node, compiler_ast_node_t* part) {
+    if(node->left == part) {
+        node->left = NULL;
+    } else if(node->right == part) {
+        node->right = NULL;
+    } else if(node->condition == part) {
+        node->condition = NULL;
+    }
+
+    compiler_optimizer_destroy_operands(node);
+    compiler_optimizer_free_token(node);
+
+    if(node->children) {
+        list_destroy_with_type(node->children, LIST_DESTROY_WITH_DATA, compiler_ast_node_destroyer);
+    }
+
+    memory_memcopy(part, node, sizeof(compiler_ast_node_t));
+    memory_free(part);
+}
+
+static compiler_optimizer_env_t* compiler_optimizer_env_new(compiler_optimizer_t* opt) {
+    compiler_optimizer_env_t* env = memory_malloc(sizeof(compiler_optimizer_env_t));
+
+    if(!env) {
+        return NULL;
+    }
+
+    env->known = memory_malloc(sizeof(boolean_t) * (opt->var_count + 1));
+    env->values = memory_malloc(sizeof(int64_t) * (opt->var_count + 1));
+
+    if(!env->known || !env->values) {
+        memory_free(env->known);
+        memory_free(env->values);
+        memory_free(env);
+
+        return NULL;
+    }
+
+    return env;
+}
+
+static void compiler_optimizer_env_destroy(compiler_optimizer_env_t* env) {
+    if(env) {
+        memory_free(env->known);
+        memory_free(env->values);
+        memory_free(env);
+    }
+}
+
+static compiler_optimizer_env_t* compiler_optimizer_env_copy(compiler_optimizer_t* opt, const compiler_optimizer_env_t* src) {
+    compiler_optimizer_env_t* env = compiler_optimizer_env_new(opt);
+
+    if(env) {
+        memory_memcopy(src->known, env->known, sizeof(boolean_t) * opt->var_count);
+        memory_memcopy(src->values, env->values, sizeof(int64_t) * opt->var_count);
+    }
+
+    return env;
+}
+
+static void compiler_optimizer_kill_assigned(compiler_optimizer_t* opt, const compiler_ast_node_t* node, compiler_optimizer_env_t* env) {
+    if(!node || node->type == COMPILER_AST_NODE_TYPE_DECLS) {
+        return;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_ASSIGN && node->left && node->left->type == COMPILER_AST_NODE_TYPE_VAR) {
+        int64_t idx = compiler_optimizer_var_index(opt, node->left);
+
+        if(idx != -1) {
+            env->known[idx] = false;
+        }
+    }
+
+    compiler_optimizer_kill_assigned(opt, node->left, env);
+    compiler_optimizer_kill_assigned(opt, node->right, env);
+
+    if(node->type == COMPILER_AST_NODE_TYPE_COMPOUND) {
+        for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+            compiler_optimizer_kill_assigned(opt, list_get_data_at_position(node->children, i), env);
+        }
+    }
+}
+
+/**
+ * @brief evaluates a binary op on constants as generated code computes it
+ * @param[in] op operator
+ * @param[in] left left operand
+ * @param[in] right right operand
+ * @param[in] size operation width in bits, shifts are done at this width
+ * @param[out] result value
+ * @return true if folded
+ */
+static boolean_t compiler_optimizer_eval_binary(compiler_token_type_t op, int64_t left, int64_t right, int64_t size, int64_t* result) {
+    switch(op) {
+    case COMPILER_TOKEN_TYPE_PLUS:
+        *result = (int64_t)((uint64_t)left + (uint64_t)right);
+        return true;
+    case COMPILER_TOKEN_TYPE_MINUS:
+        *result = (int64_t)((uint64_t)left - (uint64_t)right);
+        return true;
+    case COMPILER_TOKEN_TYPE_MULTIPLY:
+        *result = (int64_t)((uint64_t)left * (uint64_t)right);
+        return true;
+    case COMPILER_TOKEN_TYPE_INTEGER_DIVIDE:
+    case COMPILER_TOKEN_TYPE_MOD:
+        if(right == 0 || (right == -1 && left == (int64_t)(1ULL << 63))) {
+            return false;
+        }
+
+        *result = op == COMPILER_TOKEN_TYPE_MOD ? left % right : left / right;
+        return true;
+    case COMPILER_TOKEN_TYPE_AND:
+        *result = left & right;
+        return true;
+    case COMPILER_TOKEN_TYPE_OR:
+        *result = left | right;
+        return true;
+    case COMPILER_TOKEN_TYPE_XOR:
+        *result = left ^ right;
+        return true;
+    case COMPILER_TOKEN_TYPE_SHL:
+    case COMPILER_TOKEN_TYPE_SHR:
+        if(size <= 0 || size > 64 || right < 0 || right >= size) {
+            return false;
+        }
+
+        // shr is logical, operand bits above width are not shifted in
+        uint64_t bits = size == 64 ? (uint64_t)left : (uint64_t)left & ((1ULL << size) - 1);
+
+        *result = compiler_optimizer_truncate(op == COMPILER_TOKEN_TYPE_SHL ? (int64_t)(bits << right) : (int64_t)(bits >> right), size);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static boolean_t compiler_optimizer_eval_relational(compiler_token_type_t op, int64_t left, int64_t right, int64_t* result) {
+    switch(op) {
+    case COMPILER_TOKEN_TYPE_EQUAL:
+        *result = left == right;
+        return true;
+    case COMPILER_TOKEN_TYPE_NOT_EQUAL:
+        *result = left != right;
+        return true;
+    case COMPILER_TOKEN_TYPE_LESS_THAN:
+        *result = left < right;
+        return true;
+    case COMPILER_TOKEN_TYPE_LESS_THAN_OR_EQUAL:
+        *result = left <= right;
+        return true;
+    case COMPILER_TOKEN_TYPE_GREATER_THAN:
+        *result = left > right;
+        return true;
+    case COMPILER_TOKEN_TYPE_GREATER_THAN_OR_EQUAL:
+        *result = left >= right;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief applies identities like x + 0 and (x + c1) + c2 to a binary op with one constant operand
+ * @param[in] opt optimizer
+ * @param[in] node binary op
+ */
+static void compiler_optimizer_simplify_binary(compiler_optimizer_t* opt, compiler_ast_node_t* node) {
+    compiler_token_type_t op = node->token->type;
+    boolean_t right_is_const = compiler_optimizer_is_const(node->right);
+    compiler_ast_node_t* expr = right_is_const ? node->left : node->right;
+    compiler_ast_node_t* cnst = right_is_const ? node->right : node->left;
+    int64_t c = cnst->token->value;
+    int64_t expr_size = compiler_optimizer_size(opt, expr);
+
+    // replacing node with expr is valid only if it keeps the width of operation
+    boolean_t same_width = expr_size != 0 && expr_size >= (int64_t)cnst->token->size;
+    boolean_t has_call = compiler_optimizer_contains(expr, COMPILER_AST_NODE_TYPE_FUNCTION_CALL);
+
+    if(same_width &&
+       ((c == 0 && (op == COMPILER_TOKEN_TYPE_PLUS || op == COMPILER_TOKEN_TYPE_OR || op == COMPILER_TOKEN_TYPE_XOR)) ||
+        (c == 0 && right_is_const && (op == COMPILER_TOKEN_TYPE_MINUS || op == COMPILER_TOKEN_TYPE_SHL || op == COMPILER_TOKEN_TYPE_SHR)) ||
+        (c == 1 && op == COMPILER_TOKEN_TYPE_MULTIPLY) ||
+        (c == 1 && right_is_const && op == COMPILER_TOKEN_TYPE_INTEGER_DIVIDE))) {
+        compiler_optimizer_replace(node, expr);
+        opt->folded_count++;
+
+        return;
+    }
+
+    if(!has_call && c == 0 && (op == COMPILER_TOKEN_TYPE_MULTIPLY || op == COMPILER_TOKEN_TYPE_AND)) {
+        compiler_optimizer_make_const(opt, node, 0);
+        opt->folded_count++;
+
+        return;
+    }
+
+    // reassociation keeps results only at full width where arithmetic wraps the same
+    if(expr_size != 64 || expr->type != COMPILER_AST_NODE_TYPE_BINARY_OP || !compiler_optimizer_is_const(expr->right)) {
+        return;
+    }
+
+    compiler_token_type_t inner_op = expr->token->type;
+    int64_t inner_c = expr->right->token->value;
+    boolean_t is_additive = (op == COMPILER_TOKEN_TYPE_PLUS || (op == COMPILER_TOKEN_TYPE_MINUS && right_is_const)) &&
+                            (inner_op == COMPILER_TOKEN_TYPE_PLUS || inner_op == COMPILER_TOKEN_TYPE_MINUS);
+    boolean_t is_multiplicative = op == COMPILER_TOKEN_TYPE_MULTIPLY && inner_op == COMPILER_TOKEN_TYPE_MULTIPLY;
+
+    if(!is_additive && !is_multiplicative) {
+        return;
+    }
+
+    int64_t combined = 0;
+
+    if(is_additive) {
+        // (e +- c1) +- c2 = e + (+-c1 +- c2)
+        int64_t outer = op == COMPILER_TOKEN_TYPE_MINUS ? -c : c;
+        int64_t inner = inner_op == COMPILER_TOKEN_TYPE_MINUS ? -inner_c : inner_c;
+        combined = (int64_t)((uint64_t)outer + (uint64_t)inner);
+    } else {
+        combined = (int64_t)((uint64_t)c * (uint64_t)inner_c);
+    }
+
+    // node becomes inner op with combined constant
+    compiler_optimizer_replace(node, expr);
+
+    if(is_additive) {
+        node->token->type = combined < 0 ? COMPILER_TOKEN_TYPE_MINUS : COMPILER_TOKEN_TYPE_PLUS;
+        combined = combined < 0 ? -combined : combined;
+    }
+
+    node->right->token->value = combined;
+    node->right->token->size = 64;
+
+    opt->folded_count++;
+}
+
+static void compiler_optimizer_fold(compiler_optimizer_t* opt, compiler_ast_node_t* node, compiler_optimizer_env_t* env);
+
+static void compiler_optimizer_fold_chain(compiler_optimizer_t* opt, compiler_ast_node_t* node, compiler_optimizer_env_t* env) {
+    for(compiler_ast_node_t* chain = node->right; chain; chain = chain->right) {
+        if(chain->type == COMPILER_AST_NODE_TYPE_ARRAY_SUBSCRIPT) {
+            compiler_optimizer_fold(opt, chain->left, env);
+        } else if(chain->type == COMPILER_AST_NODE_TYPE_FUNCTION_CALL) {
+            compiler_optimizer_fold(opt, chain, env);
+        }
+    }
+}
+
+/**
+ * @brief folds an expression with known variable values
+ * @param[in] opt optimizer
+ * @param[in] node expression, replaced in place
+ * @param[in] env known values
+ */
+static void compiler_optimizer_fold(compiler_optimizer_t* opt, compiler_ast_node_t* node, compiler_optimizer_env_t* env) {
+    if(!node) {
+        return;
+    }
+
+    switch(node->type) {
+    case COMPILER_AST_NODE_TYPE_VAR: {
+        if(node->right) {
+            compiler_optimizer_fold_chain(opt, node, env);
+
+            return;
+        }
+
+        int64_t idx = compiler_optimizer_var_index(opt, node);
+
+        if(idx == -1) {
+            return;
+        }
+
+        const compiler_optimizer_var_t* var = &opt->vars[idx];
+
+        if(var->symbol->is_const && var->is_global && var->symbol->initilized) {
+            compiler_optimizer_make_const(opt, node, compiler_optimizer_truncate(var->symbol->int_value, var->symbol->size));
+            opt->propagated_count++;
+        } else if(env->known[idx]) {
+            compiler_optimizer_make_const(opt, node, env->values[idx]);
+            opt->propagated_count++;
+        } else {
+            return;
+        }
+
+        // operations on constant keep width of variable
+        if(node->token && (int64_t)node->token->size < var->symbol->size) {
+            node->token->size = var->symbol->size;
+        }
+
+        return;
+    }
+    case COMPILER_AST_NODE_TYPE_FUNCTION_CALL:
+        for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+            compiler_optimizer_fold(opt, (compiler_ast_node_t*)list_get_data_at_position(node->children, i), env);
+        }
+
+        return;
+    case COMPILER_AST_NODE_TYPE_UNARY_OP:
+        compiler_optimizer_fold(opt, node->right, env);
+
+        if(compiler_optimizer_is_const(node->right)) {
+            int64_t value = node->right->token->value;
+
+            if(node->token->type == COMPILER_TOKEN_TYPE_MINUS) {
+                value = (int64_t)(0 - (uint64_t)value);
+            } else if(node->token->type == COMPILER_TOKEN_TYPE_NOT) {
+                value = !value;
+            }
+
+            compiler_optimizer_make_const(opt, node, value);
+            opt->folded_count++;
+        }
+
+        return;
+    case COMPILER_AST_NODE_TYPE_BINARY_OP:
+    case COMPILER_AST_NODE_TYPE_RELATIONAL_OP: {
+        compiler_optimizer_fold(opt, node->left, env);
+        compiler_optimizer_fold(opt, node->right, env);
+
+        boolean_t left_is_const = compiler_optimizer_is_const(node->left);
+        boolean_t right_is_const = compiler_optimizer_is_const(node->right);
+
+        if(left_is_const && right_is_const) {
+            int64_t value = 0;
+            boolean_t folded = node->type == COMPILER_AST_NODE_TYPE_BINARY_OP ?
+                               compiler_optimizer_eval_binary(node->token->type, node->left->token->value, node->right->token->value,
+                                                              MAX(node->left->token->size, node->right->token->size), &value) :
+                               compiler_optimizer_eval_relational(node->token->type, node->left->token->value, node->right->token->value, &value);
+
+            if(folded) {
+                compiler_optimizer_make_const(opt, node, value);
+                opt->folded_count++;
+            }
+        } else if(node->type == COMPILER_AST_NODE_TYPE_BINARY_OP && (left_is_const || right_is_const)) {
+            compiler_optimizer_simplify_binary(opt, node);
+        }
+
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static boolean_t compiler_optimizer_is_empty(const compiler_ast_node_t* node) {
+    if(!node || node->type == COMPILER_AST_NODE_TYPE_NO_OP) {
+        return true;
+    }
+
+    return node->type == COMPILER_AST_NODE_TYPE_COMPOUND && (!node->children || list_size(node->children) == 0);
+}
+
+static void compiler_optimizer_statement(compiler_optimizer_t* opt, compiler_ast_node_t* node, compiler_optimizer_env_t* env);
+
+static void compiler_optimizer_compound(compiler_optimizer_t* opt, compiler_ast_node_t* node, compiler_optimizer_env_t* env) {
+    for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+        compiler_ast_node_t* child = (compiler_ast_node_t*)list_get_data_at_position(node->children, i);
+
+        if(child->type == COMPILER_AST_NODE_TYPE_DECLS) {
+            // new locals start with unknown values
+            for(size_t j = 0; j < list_size(child->children); j++) {
+                const compiler_ast_node_t* var_node = list_get_data_at_position(child->children, j);
+
+                for(size_t k = 0; var_node->children && k < list_size(var_node->children); k++) {
+                    const compiler_symbol_t* symbol = list_get_data_at_position(var_node->children, k);
+                    int64_t idx = compiler_optimizer_symbol_index(opt, symbol);
+
+                    if(idx >= 0) {
+                        env->known[idx] = false;
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        compiler_optimizer_statement(opt, child, env);
+    }
+
+    // empty statements left by elimination are dropped
+    for(size_t i = 0; node->children && i < list_size(node->children); ) {
+        compiler_ast_node_t* child = (compiler_ast_node_t*)list_get_data_at_position(node->children, i);
+
+        if(child->type == COMPILER_AST_NODE_TYPE_NO_OP) {
+            list_delete_at_position(node->children, i);
+            compiler_ast_node_destroy(child);
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * @brief optimizes a statement, replaced in place
+ * @param[in] opt optimizer
+ * @param[in] node statement
+ * @param[in] env known values before statement, updated to values after it
+ */
+static void compiler_optimizer_statement(compiler_optimizer_t* opt, compiler_ast_node_t* node, compiler_optimizer_env_t* env) {
+    if(!node) {
+        return;
+    }
+
+    switch(node->type) {
+    case COMPILER_AST_NODE_TYPE_ASSIGN: {
+        compiler_optimizer_fold(opt, node->right, env);
+
+        if(!node->left || node->left->type != COMPILER_AST_NODE_TYPE_VAR) {
+            return;
+        }
+
+        if(node->left->right) {
+            compiler_optimizer_fold_chain(opt, node->left, env);
+
+            return;
+        }
+
+        int64_t idx = compiler_optimizer_var_index(opt, node->left);
+
+        if(idx == -1) {
+            return;
+        }
+
+        if(compiler_optimizer_is_const(node->right)) {
+            env->known[idx] = true;
+            env->values[idx] = compiler_optimizer_truncate(node->right->token->value, opt->vars[idx].symbol->size);
+        } else {
+            env->known[idx] = false;
+        }
+
+        return;
+    }
+    case COMPILER_AST_NODE_TYPE_IF: {
+        compiler_optimizer_fold(opt, node->condition, env);
+
+        if(compiler_optimizer_is_const(node->condition)) {
+            compiler_ast_node_t* taken = node->condition->token->value ? node->left : node->right;
+            compiler_ast_node_t* dropped = node->condition->token->value ? node->right : node->left;
+
+            if(compiler_optimizer_contains(dropped, COMPILER_AST_NODE_TYPE_LABEL)) {
+                break;
+            }
+
+            opt->eliminated_count++;
+
+            if(taken) {
+                compiler_optimizer_replace(node, taken);
+                compiler_optimizer_statement(opt, node, env);
+            } else {
+                compiler_optimizer_make_no_op(node);
+            }
+
+            return;
+        }
+
+        compiler_optimizer_env_t* else_env = compiler_optimizer_env_copy(opt, env);
+
+        if(!else_env) {
+            compiler_optimizer_kill_assigned(opt, node, env);
+
+            return;
+        }
+
+        compiler_optimizer_statement(opt, node->left, env);
+        compiler_optimizer_statement(opt, node->right, else_env);
+
+        // only values both branches agree on survive
+        for(int64_t i = 0; i < opt->var_count; i++) {
+            env->known[i] = env->known[i] && else_env->known[i] && env->values[i] == else_env->values[i];
+        }
+
+        compiler_optimizer_env_destroy(else_env);
+
+        if(compiler_optimizer_is_empty(node->left) && compiler_optimizer_is_empty(node->right) &&
+           !compiler_optimizer_contains(node->condition, COMPILER_AST_NODE_TYPE_FUNCTION_CALL)) {
+            compiler_optimizer_make_no_op(node);
+            opt->eliminated_count++;
+        }
+
+        return;
+    }
+    case COMPILER_AST_NODE_TYPE_WHILE:
+        // condition and body run after any iteration, values assigned in body are unknown
+        compiler_optimizer_kill_assigned(opt, node->left, env);
+        compiler_optimizer_fold(opt, node->condition, env);
+
+        if(compiler_optimizer_is_const(node->condition) && !node->condition->token->value &&
+           !compiler_optimizer_contains(node, COMPILER_AST_NODE_TYPE_LABEL)) {
+            compiler_optimizer_make_no_op(node);
+            opt->eliminated_count++;
+
+            return;
+        }
+
+        compiler_optimizer_env_t* body_env = compiler_optimizer_env_copy(opt, env);
+
+        if(body_env) {
+            compiler_optimizer_statement(opt, node->left, body_env);
+            compiler_optimizer_env_destroy(body_env);
+        }
+
+        return;
+    case COMPILER_AST_NODE_TYPE_COMPOUND:
+        compiler_optimizer_compound(opt, node, env);
+
+        return;
+    case COMPILER_AST_NODE_TYPE_VAR:
+    case COMPILER_AST_NODE_TYPE_FUNCTION_CALL:
+        compiler_optimizer_fold(opt, node, env);
+
+        return;
+    default:
+        break;
+    }
+
+    // anything else is not understood, forget values it may change
+    compiler_optimizer_kill_assigned(opt, node, env);
+}
+
+static void compiler_optimizer_count_reads(compiler_optimizer_t* opt, const compiler_ast_node_t* node, boolean_t is_store) {
+    if(!node || node->type == COMPILER_AST_NODE_TYPE_DECLS) {
+        return;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_VAR) {
+        int64_t idx = compiler_optimizer_var_index(opt, node);
+
+        if(idx != -1 && !is_store) {
+            opt->vars[idx].read_count++;
+        }
+
+        for(const compiler_ast_node_t* chain = node->right; chain; chain = chain->right) {
+            if(chain->type == COMPILER_AST_NODE_TYPE_ARRAY_SUBSCRIPT) {
+                compiler_optimizer_count_reads(opt, chain->left, false);
+            } else if(chain->type == COMPILER_AST_NODE_TYPE_FUNCTION_CALL) {
+                compiler_optimizer_count_reads(opt, chain, false);
+            }
+        }
+
+        return;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_ASSIGN) {
+        compiler_optimizer_count_reads(opt, node->left, true);
+        compiler_optimizer_count_reads(opt, node->right, false);
+
+        return;
+    }
+
+    compiler_optimizer_count_reads(opt, node->left, false);
+    compiler_optimizer_count_reads(opt, node->right, false);
+    compiler_optimizer_count_reads(opt, node->condition, false);
+
+    if(node->type == COMPILER_AST_NODE_TYPE_COMPOUND || node->type == COMPILER_AST_NODE_TYPE_FUNCTION_CALL) {
+        for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+            compiler_optimizer_count_reads(opt, list_get_data_at_position(node->children, i), false);
+        }
+    }
+}
+
+static int64_t compiler_optimizer_remove_dead_stores(compiler_optimizer_t* opt, compiler_ast_node_t* node) {
+    if(!node || node->type == COMPILER_AST_NODE_TYPE_DECLS) {
+        return 0;
+    }
+
+    int64_t removed = 0;
+
+    if(node->type == COMPILER_AST_NODE_TYPE_ASSIGN) {
+        if(node->left && node->left->type == COMPILER_AST_NODE_TYPE_VAR && node->left->right == NULL &&
+           !compiler_optimizer_contains(node->right, COMPILER_AST_NODE_TYPE_FUNCTION_CALL)) {
+            int64_t idx = compiler_optimizer_var_index(opt, node->left);
+
+            if(idx != -1 && opt->vars[idx].read_count == 0) {
+                compiler_optimizer_make_no_op(node);
+                removed++;
+            }
+        }
+
+        return removed;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_IF || node->type == COMPILER_AST_NODE_TYPE_WHILE) {
+        removed += compiler_optimizer_remove_dead_stores(opt, node->left);
+        removed += compiler_optimizer_remove_dead_stores(opt, node->right);
+
+        return removed;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_COMPOUND) {
+        for(size_t i = 0; node->children && i < list_size(node->children); ) {
+            compiler_ast_node_t* child = (compiler_ast_node_t*)list_get_data_at_position(node->children, i);
+
+            removed += compiler_optimizer_remove_dead_stores(opt, child);
+
+            if(child->type == COMPILER_AST_NODE_TYPE_NO_OP) {
+                list_delete_at_position(node->children, i);
+                compiler_ast_node_destroy(child);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    return removed;
+}
+
+static void compiler_optimizer_collect_decls(compiler_optimizer_t* opt, const compiler_ast_node_t* node, boolean_t is_global, list_t* symbols) {
+    for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+        const compiler_ast_node_t* var_node = list_get_data_at_position(node->children, i);
+
+        if(var_node->type != COMPILER_AST_NODE_TYPE_VAR) {
+            continue;
+        }
+
+        for(size_t k = 0; var_node->children && k < list_size(var_node->children); k++) {
+            const compiler_symbol_t* symbol = list_get_data_at_position(var_node->children, k);
+            int64_t idx = compiler_optimizer_symbol_index(opt, symbol);
+
+            if(idx >= 0) {
+                // redeclared names are left alone
+                compiler_optimizer_var_t* var = (compiler_optimizer_var_t*)list_get_data_at_position(symbols, idx);
+                var->is_ambiguous = true;
+
+                continue;
+            }
+
+            int64_t identifier_id = compiler_optimizer_identifier_id(opt, symbol->identifier_id, symbol->name);
+            compiler_optimizer_var_t* var = identifier_id ? memory_malloc(sizeof(compiler_optimizer_var_t)) : NULL;
+
+            if(!var) {
+                continue;
+            }
+
+            var->symbol = symbol;
+            var->is_global = is_global;
+            var->is_ambiguous = !compiler_optimizer_is_scalar(symbol) || strcmp(symbol->name, opt->program_name) == 0;
+
+            list_list_insert(symbols, var);
+            opt->var_indexes[identifier_id] = list_size(symbols);
+        }
+    }
+}
+
+static void compiler_optimizer_collect(compiler_optimizer_t* opt, const compiler_ast_node_t* node, list_t* symbols) {
+    if(!node) {
+        return;
+    }
+
+    if(node->type == COMPILER_AST_NODE_TYPE_DECLS) {
+        compiler_optimizer_collect_decls(opt, node, false, symbols);
+
+        return;
+    }
+
+    compiler_optimizer_collect(opt, node->left, symbols);
+    compiler_optimizer_collect(opt, node->right, symbols);
+
+    if(node->type == COMPILER_AST_NODE_TYPE_COMPOUND) {
+        for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+            compiler_optimizer_collect(opt, list_get_data_at_position(node->children, i), symbols);
+        }
+    }
+}
+
+int8_t compiler_optimize_ast(compiler_t* compiler) {
+    compiler_ast_node_t* program = compiler->ast->root;
+
+    if(!program || program->type != COMPILER_AST_NODE_TYPE_PROGRAM || !program->left ||
+       program->left->type != COMPILER_AST_NODE_TYPE_BLOCK || !program->left->right) {
+        return 0;
+    }
+
+    compiler_ast_node_t* block = program->left;
+    compiler_optimizer_t opt = {.compiler = compiler, .program_name = program->token->text};
+
+    // index 0 is for names not interned and stays unset
+    opt.identifier_count = compiler->identifiers->count;
+    opt.var_indexes = memory_malloc(sizeof(int64_t) * opt.identifier_count);
+    list_t* symbols = list_create_list();
+
+    if(!opt.var_indexes || !symbols) {
+        memory_free(opt.var_indexes);
+        list_destroy(symbols);
+
+        return -1;
+    }
+
+    if(block->left && block->left->type == COMPILER_AST_NODE_TYPE_DECLS) {
+        compiler_optimizer_collect_decls(&opt, block->left, true, symbols);
+    }
+
+    compiler_optimizer_collect(&opt, block->right, symbols);
+
+    opt.var_count = list_size(symbols);
+    opt.vars = memory_malloc(sizeof(compiler_optimizer_var_t) * (opt.var_count + 1));
+
+    for(int64_t i = 0; opt.vars && i < opt.var_count; i++) {
+        memory_memcopy(list_get_data_at_position(symbols, i), &opt.vars[i], sizeof(compiler_optimizer_var_t));
+    }
+
+    list_destroy_with_type(symbols, LIST_DESTROY_WITH_DATA, NULL);
+
+    compiler_optimizer_env_t* env = opt.vars ? compiler_optimizer_env_new(&opt) : NULL;
+
+    if(!env) {
+        memory_free(opt.vars);
+        memory_free(opt.var_indexes);
+
+        return -1;
+    }
+
+    // globals start with their initial values, uninitialized ones are zero at bss
+    for(int64_t i = 0; i < opt.var_count; i++) {
+        if(opt.vars[i].is_global && !opt.vars[i].is_ambiguous && !opt.vars[i].symbol->is_const) {
+            env->known[i] = true;
+            env->values[i] = compiler_optimizer_truncate(opt.vars[i].symbol->initilized ? opt.vars[i].symbol->int_value : 0,
+                                                         opt.vars[i].symbol->size);
+        }
+    }
+
+    compiler_optimizer_statement(&opt, block->right, env);
+
+    compiler_optimizer_env_destroy(env);
+
+    for(int64_t round = 0; round < COMPILER_OPTIMIZER_MAX_DSE_ROUNDS; round++) {
+        for(int64_t i = 0; i < opt.var_count; i++) {
+            opt.vars[i].read_count = 0;
+        }
+
+        compiler_optimizer_count_reads(&opt, block->right, false);
+
+        int64_t removed = compiler_optimizer_remove_dead_stores(&opt, block->right);
+
+        if(removed == 0) {
+            break;
+        }
+
+        opt.eliminated_count += removed;
+    }
+
+    PRINTLOG(COMPILER, LOG_DEBUG, "optimizer: %lli folded, %lli propagated, %lli eliminated",
+             opt.folded_count, opt.propagated_count, opt.eliminated_count);
+
+    memory_free(opt.vars);
+    memory_free(opt.var_indexes);
+
+    return 0;
+}
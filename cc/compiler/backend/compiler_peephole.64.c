@@ -0,0 +1,486 @@
+/**
+ * @file compiler_peephole.64.c
+ * @brief peephole optimizations over generated assembly of program body
+ *
+ * works on text lines as emitted by code generation. comments are transparent, labels and directives end a
+ * window. rules only look at neighbouring instructions, so they need no flow analysis except the knowledge that
+ * condition registers are free after if and while branches.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <compiler/compiler.h>
+#include <logging.h>
+#include <strings.h>
+#include <utils.h>
+
+MODULE("turnstone.compiler");
+
+/*! max operand length, longer instructions are kept as is */
+#define COMPILER_PEEPHOLE_OPERAND_MAX 64
+/*! passes over lines, each pass can expose new windows */
+#define COMPILER_PEEPHOLE_MAX_PASSES  4
+
+typedef enum compiler_peephole_line_type_t {
+    COMPILER_PEEPHOLE_LINE_TYPE_COMMENT,
+    COMPILER_PEEPHOLE_LINE_TYPE_INSTRUCTION,
+    COMPILER_PEEPHOLE_LINE_TYPE_LABEL,
+    COMPILER_PEEPHOLE_LINE_TYPE_OTHER,
+} compiler_peephole_line_type_t;
+
+typedef struct compiler_peephole_line_t {
+    const char_t*                 text; ///< line at source buffer
+    uint64_t                      length; ///< line length without new line
+    compiler_peephole_line_type_t type; ///< line type
+    boolean_t                     is_removed; ///< line is dropped
+    boolean_t                     is_modified; ///< line is printed from mnemonic and operands
+    int8_t                        operand_count; ///< -1 if instruction cannot be parsed
+    char_t                        mnemonic[16]; ///< instruction mnemonic
+    char_t                        operands[2][COMPILER_PEEPHOLE_OPERAND_MAX]; ///< instruction operands
+} compiler_peephole_line_t;
+
+static const char_t*const compiler_peephole_regs[4][16] = {
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"},
+    {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+};
+
+static const char_t*const compiler_peephole_inverse_jumps[][2] = {
+    {"sete", "jne"},
+    {"seteb", "jne"},
+    {"setne", "je"},
+    {"setnz", "jz"},
+    {"setl", "jge"},
+    {"setle", "jg"},
+    {"setg", "jle"},
+    {"setge", "jl"},
+};
+
+/**
+ * @brief finds register of a name
+ * @param[in] name register name without %
+ * @param[in] length name length
+ * @param[out] size_index 0 for 64 bit, 1 for 32 bit, 2 for 16 bit, 3 for 8 bit names
+ * @return register index, -1 if name is not a register
+ */
+static int8_t compiler_peephole_find_register(const char_t* name, uint64_t length, int8_t* size_index) {
+    for(int32_t s = 0; s < 4; s++) {
+        for(int32_t r = 0; r < 16; r++) {
+            if(strlen(compiler_peephole_regs[s][r]) == length && strncmp(compiler_peephole_regs[s][r], name, length) == 0) {
+                if(size_index) {
+                    *size_index = s;
+                }
+
+                return r;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static int8_t compiler_peephole_register(const char_t* operand, int8_t* size_index) {
+    if(operand[0] != '%') {
+        return -1;
+    }
+
+    return compiler_peephole_find_register(operand + 1, strlen(operand + 1), size_index);
+}
+
+static int8_t compiler_peephole_register64(const char_t* operand) {
+    int8_t size_index = -1;
+    int8_t reg = compiler_peephole_register(operand, &size_index);
+
+    return size_index == 0 ? reg : -1;
+}
+
+static boolean_t compiler_peephole_mentions(const char_t* operand, int8_t reg) {
+    for(const char_t* p = operand; *p; p++) {
+        if(*p != '%') {
+            continue;
+        }
+
+        uint64_t len = 0;
+
+        while(p[1 + len] && ((p[1 + len] >= 'a' && p[1 + len] <= 'z') || (p[1 + len] >= '0' && p[1 + len] <= '9'))) {
+            len++;
+        }
+
+        if(compiler_peephole_find_register(p + 1, len, NULL) == reg) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static boolean_t compiler_peephole_is(const compiler_peephole_line_t* line, const char_t* mnemonic, int8_t operand_count) {
+    return line->operand_count == operand_count && strcmp(line->mnemonic, mnemonic) == 0;
+}
+
+static boolean_t compiler_peephole_is_mov64(const compiler_peephole_line_t* line) {
+    return compiler_peephole_is(line, "mov", 2) || compiler_peephole_is(line, "movq", 2);
+}
+
+static void compiler_peephole_parse(compiler_peephole_line_t* line) {
+    if(line->length == 0 || line->text[0] == '#') {
+        line->type = COMPILER_PEEPHOLE_LINE_TYPE_COMMENT;
+
+        return;
+    }
+
+    if(line->text[0] != '\t') {
+        line->type = line->text[line->length - 1] == ':' ? COMPILER_PEEPHOLE_LINE_TYPE_LABEL : COMPILER_PEEPHOLE_LINE_TYPE_OTHER;
+
+        return;
+    }
+
+    line->type = COMPILER_PEEPHOLE_LINE_TYPE_INSTRUCTION;
+    line->operand_count = -1;
+
+    uint64_t pos = 1;
+    uint64_t len = 0;
+
+    while(pos + len < line->length && line->text[pos + len] != ' ') {
+        len++;
+    }
+
+    if(len == 0 || len >= sizeof(line->mnemonic)) {
+        return;
+    }
+
+    memory_memcopy(line->text + pos, line->mnemonic, len);
+    line->mnemonic[len] = '\0';
+    pos += len;
+
+    int32_t count = 0;
+    int64_t depth = 0;
+
+    while(pos < line->length) {
+        while(pos < line->length && line->text[pos] == ' ') {
+            pos++;
+        }
+
+        if(pos == line->length) {
+            break;
+        }
+
+        if(count == 2) {
+            return;
+        }
+
+        // commas inside memory operands do not split
+        len = 0;
+
+        while(pos + len < line->length && (depth > 0 || line->text[pos + len] != ',')) {
+            if(line->text[pos + len] == '(') {
+                depth++;
+            } else if(line->text[pos + len] == ')') {
+                depth--;
+            }
+
+            len++;
+        }
+
+        if(len >= COMPILER_PEEPHOLE_OPERAND_MAX) {
+            return;
+        }
+
+        memory_memcopy(line->text + pos, line->operands[count], len);
+        line->operands[count][len] = '\0';
+        count++;
+
+        pos += len;
+
+        if(pos < line->length) {
+            pos++; // skip comma
+        }
+    }
+
+    line->operand_count = count;
+}
+
+static int64_t compiler_peephole_next(compiler_peephole_line_t* lines, int64_t count, int64_t idx) {
+    for(int64_t i = idx + 1; i < count; i++) {
+        if(lines[i].is_removed || lines[i].type == COMPILER_PEEPHOLE_LINE_TYPE_COMMENT) {
+            continue;
+        }
+
+        return lines[i].type == COMPILER_PEEPHOLE_LINE_TYPE_INSTRUCTION ? i : -1;
+    }
+
+    return -1;
+}
+
+static int64_t compiler_peephole_prev(compiler_peephole_line_t* lines, int64_t idx) {
+    for(int64_t i = idx - 1; i >= 0; i--) {
+        if(lines[i].is_removed || lines[i].type == COMPILER_PEEPHOLE_LINE_TYPE_COMMENT) {
+            continue;
+        }
+
+        return lines[i].type == COMPILER_PEEPHOLE_LINE_TYPE_INSTRUCTION ? i : -1;
+    }
+
+    return -1;
+}
+
+static void compiler_peephole_set(compiler_peephole_line_t* line, const char_t* mnemonic, const char_t* op0, const char_t* op1) {
+    char_t tmp[2][COMPILER_PEEPHOLE_OPERAND_MAX] = {{0}};
+
+    // operands can be fields of line itself
+    strcopy(op0, tmp[0]);
+
+    if(op1) {
+        strcopy(op1, tmp[1]);
+    }
+
+    strcopy(mnemonic, line->mnemonic);
+    strcopy(tmp[0], line->operands[0]);
+    strcopy(tmp[1], line->operands[1]);
+
+    line->operand_count = op1 ? 2 : 1;
+    line->is_modified = true;
+}
+
+/**
+ * @brief replaces set, bt and jnc of an if or while condition with a conditional jump
+ *
+ * condition register is free after the branch, so the compare can also use the source of its copy.
+ *
+ * @param[in] lines lines
+ * @param[in] count line count
+ * @param[in] idx index of set instruction
+ * @return true if rewritten
+ */
+static boolean_t compiler_peephole_fuse_branch(compiler_peephole_line_t* lines, int64_t count, int64_t idx) {
+    compiler_peephole_line_t* set = &lines[idx];
+    const char_t* jump = NULL;
+
+    for(uint64_t i = 0; i < sizeof(compiler_peephole_inverse_jumps) / sizeof(compiler_peephole_inverse_jumps[0]); i++) {
+        if(compiler_peephole_is(set, compiler_peephole_inverse_jumps[i][0], 1)) {
+            jump = compiler_peephole_inverse_jumps[i][1];
+
+            break;
+        }
+    }
+
+    int8_t size_index = -1;
+    int8_t reg = jump ? compiler_peephole_register(set->operands[0], &size_index) : -1;
+
+    if(reg == -1 || size_index != 3) {
+        return false;
+    }
+
+    int64_t bt_idx = compiler_peephole_next(lines, count, idx);
+    int64_t jnc_idx = bt_idx == -1 ? -1 : compiler_peephole_next(lines, count, bt_idx);
+
+    if(jnc_idx == -1 || !compiler_peephole_is(&lines[bt_idx], "bt", 2) || strcmp(lines[bt_idx].operands[0], "$0") != 0 ||
+       compiler_peephole_register64(lines[bt_idx].operands[1]) != reg || !compiler_peephole_is(&lines[jnc_idx], "jnc", 1)) {
+        return false;
+    }
+
+    compiler_peephole_set(set, jump, lines[jnc_idx].operands[0], NULL);
+    lines[bt_idx].is_removed = true;
+    lines[jnc_idx].is_removed = true;
+
+    int64_t cmp_idx = compiler_peephole_prev(lines, idx);
+    int64_t mov_idx = cmp_idx == -1 ? -1 : compiler_peephole_prev(lines, cmp_idx);
+
+    if(mov_idx == -1) {
+        return true;
+    }
+
+    compiler_peephole_line_t* cmp = &lines[cmp_idx];
+    compiler_peephole_line_t* mov = &lines[mov_idx];
+
+    if((compiler_peephole_is(cmp, "cmp", 2) || compiler_peephole_is(cmp, "cmpq", 2)) &&
+       compiler_peephole_register64(cmp->operands[1]) == reg && !compiler_peephole_mentions(cmp->operands[0], reg) &&
+       compiler_peephole_is_mov64(mov) && compiler_peephole_register64(mov->operands[1]) == reg &&
+       compiler_peephole_register64(mov->operands[0]) != -1) {
+        compiler_peephole_set(cmp, cmp->mnemonic, cmp->operands[0], mov->operands[0]);
+        mov->is_removed = true;
+    }
+
+    return true;
+}
+
+static boolean_t compiler_peephole_apply(compiler_peephole_line_t* lines, int64_t count, int64_t idx) {
+    compiler_peephole_line_t* line = &lines[idx];
+
+    if(line->type != COMPILER_PEEPHOLE_LINE_TYPE_INSTRUCTION || line->is_removed || line->operand_count < 1) {
+        return false;
+    }
+
+    int64_t next_idx = compiler_peephole_next(lines, count, idx);
+    compiler_peephole_line_t* next = next_idx == -1 ? NULL : &lines[next_idx];
+
+    if(compiler_peephole_is_mov64(line)) {
+        int8_t src = compiler_peephole_register64(line->operands[0]);
+        int8_t dst = compiler_peephole_register64(line->operands[1]);
+
+        // mov %a, %a
+        if(src != -1 && src == dst) {
+            line->is_removed = true;
+
+            return true;
+        }
+
+        if(next == NULL || dst == -1) {
+            return false;
+        }
+
+        // mov %a, %b; mov %b, %a
+        if(src != -1 && compiler_peephole_is_mov64(next) &&
+           compiler_peephole_register64(next->operands[0]) == dst && compiler_peephole_register64(next->operands[1]) == src) {
+            next->is_removed = true;
+
+            return true;
+        }
+
+        // mov x, %a; mov y, %a when y does not read %a
+        int8_t next_size_index = -1;
+        int8_t next_dst = next->operand_count == 2 ? compiler_peephole_register(next->operands[1], &next_size_index) : -1;
+
+        if(next_dst == dst && !compiler_peephole_mentions(next->operands[0], dst) &&
+           ((compiler_peephole_is_mov64(next) && next_size_index == 0) || (compiler_peephole_is(next, "movl", 2) && next_size_index == 1))) {
+            line->is_removed = true;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    if(compiler_peephole_is(line, "push", 1) || compiler_peephole_is(line, "pushq", 1)) {
+        int8_t src = compiler_peephole_register64(line->operands[0]);
+
+        if(src == -1 || next == NULL || !(compiler_peephole_is(next, "pop", 1) || compiler_peephole_is(next, "popq", 1)) ||
+           compiler_peephole_register64(next->operands[0]) == -1) {
+            return false;
+        }
+
+        if(compiler_peephole_register64(next->operands[0]) == src) {
+            line->is_removed = true;
+        } else {
+            compiler_peephole_set(line, "mov", line->operands[0], next->operands[0]);
+        }
+
+        next->is_removed = true;
+
+        return true;
+    }
+
+    if(compiler_peephole_is(line, "jmp", 1)) {
+        // jump to following label
+        for(int64_t i = idx + 1; i < count; i++) {
+            if(lines[i].is_removed || lines[i].type == COMPILER_PEEPHOLE_LINE_TYPE_COMMENT) {
+                continue;
+            }
+
+            uint64_t label_len = strlen(line->operands[0]);
+
+            if(lines[i].type == COMPILER_PEEPHOLE_LINE_TYPE_LABEL && lines[i].length == label_len + 1 &&
+               strncmp(lines[i].text, line->operands[0], label_len) == 0) {
+                line->is_removed = true;
+
+                return true;
+            }
+
+            return false;
+        }
+
+        return false;
+    }
+
+    if(strncmp(line->mnemonic, "set", 3) == 0) {
+        return compiler_peephole_fuse_branch(lines, count, idx);
+    }
+
+    return false;
+}
+
+buffer_t* compiler_peephole(compiler_t* compiler, buffer_t* text) {
+    UNUSED(compiler);
+
+    uint64_t text_len = buffer_get_length(text);
+    const char_t* data = (const char_t*)buffer_get_view_at_position(text, 0, text_len);
+
+    if(data == NULL) {
+        return NULL;
+    }
+
+    int64_t count = 0;
+
+    for(uint64_t i = 0; i < text_len; i++) {
+        if(data[i] == '\n') {
+            count++;
+        }
+    }
+
+    if(text_len && data[text_len - 1] != '\n') {
+        count++;
+    }
+
+    compiler_peephole_line_t* lines = memory_malloc(sizeof(compiler_peephole_line_t) * (count + 1));
+
+    if(lines == NULL) {
+        return NULL;
+    }
+
+    int64_t idx = 0;
+    uint64_t start = 0;
+
+    for(uint64_t i = 0; i <= text_len && idx < count; i++) {
+        if(i == text_len || data[i] == '\n') {
+            lines[idx].text = data + start;
+            lines[idx].length = i - start;
+            compiler_peephole_parse(&lines[idx]);
+
+            idx++;
+            start = i + 1;
+        }
+    }
+
+    int64_t removed_count = 0;
+
+    for(int64_t pass = 0; pass < COMPILER_PEEPHOLE_MAX_PASSES; pass++) {
+        boolean_t changed = false;
+
+        for(int64_t i = 0; i < count; i++) {
+            changed |= compiler_peephole_apply(lines, count, i);
+        }
+
+        if(!changed) {
+            break;
+        }
+    }
+
+    buffer_t* out = buffer_new_with_capacity(NULL, text_len + 1);
+
+    if(out == NULL) {
+        memory_free(lines);
+
+        return NULL;
+    }
+
+    for(int64_t i = 0; i < count; i++) {
+        if(lines[i].is_removed) {
+            removed_count++;
+        } else if(lines[i].is_modified && lines[i].operand_count == 2) {
+            buffer_printf(out, "\t%s %s, %s\n", lines[i].mnemonic, lines[i].operands[0], lines[i].operands[1]);
+        } else if(lines[i].is_modified) {
+            buffer_printf(out, "\t%s %s\n", lines[i].mnemonic, lines[i].operands[0]);
+        } else {
+            buffer_append_bytes(out, (uint8_t*)lines[i].text, lines[i].length);
+            buffer_append_byte(out, '\n');
+        }
+    }
+
+    PRINTLOG(COMPILER, LOG_DEBUG, "peephole: %lli of %lli lines removed", removed_count, count);
+
+    memory_free(lines);
+
+    return out;
+}
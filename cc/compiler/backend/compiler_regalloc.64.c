@@ -0,0 +1,646 @@
+/**
+ * @file compiler_regalloc.64.c
+ * @brief linear scan register allocation for scalar variables
+ *
+ * program body is lowered to a linear sequence of top level statements. each reference of a scalar integer
+ * variable is recorded with its statement index and loop depth, so a variable gets a live interval of
+ * statements. intervals are widened to top level statements, hence register loads at interval start dominate
+ * every use and loops inside a statement are covered whole. intervals are assigned with linear scan, the ones
+ * crossing a call get callee saved registers, spill decisions compare use counts weighted by loop depth.
+ * expression temporaries keep using compiler_find_free_reg with the remaining registers.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <compiler/compiler.h>
+#include <logging.h>
+#include <strings.h>
+#include <utils.h>
+
+MODULE("turnstone.compiler");
+
+/*! maximum loop depth counted at spill cost, each level multiplies cost by 8 */
+#define COMPILER_REGALLOC_MAX_LOOP_DEPTH 4
+/*! registers left free for temporaries above estimated need of a statement */
+#define COMPILER_REGALLOC_SPARE_REGS     1
+
+typedef struct compiler_regalloc_interval_t {
+    const compiler_symbol_t* symbol; ///< promoted variable
+    int64_t                  start; ///< first top level statement
+    int64_t                  end; ///< last top level statement
+    int64_t                  weight; ///< spill cost, uses weighted by loop depth
+    boolean_t                is_written; ///< assigned inside interval, needs write back
+    boolean_t                is_defined_at_start; ///< first statement assigns variable, no load needed
+    boolean_t                is_eligible; ///< can be kept at register
+    boolean_t                is_live; ///< code of interval is being generated
+    int16_t                  used_register; ///< assigned register, -1 if variable stays in memory
+} compiler_regalloc_interval_t;
+
+struct compiler_regalloc_t {
+    compiler_ast_node_t*       body; ///< top level compound of program
+    const compiler_ast_node_t* current_statement; ///< top level statement being scanned
+    list_t*                    intervals; ///< intervals sorted by start
+    hashmap_t*                 intervals_by_symbol; ///< symbol to interval
+    hashmap_t*                 shadowed_names; ///< names declared at nested compounds
+    int64_t                    statement_count; ///< top level statement count
+    int64_t*                   need; ///< estimated temporary register need of statements
+    int64_t*                   occupancy; ///< promoted registers live at statements
+    boolean_t*                 has_call; ///< statement calls a function
+    int64_t                    promoted_count; ///< intervals kept at registers
+    int64_t                    spilled_count; ///< eligible intervals left at memory
+};
+
+/*! registers for intervals without calls, preferred to keep callee saved ones free */
+static const int16_t compiler_regalloc_caller_saved[] = {
+    COMPILER_VM_REG_R11,
+    COMPILER_VM_REG_R10,
+};
+
+/*! registers for intervals crossing calls */
+static const int16_t compiler_regalloc_callee_saved[] = {
+    COMPILER_VM_REG_R14,
+    COMPILER_VM_REG_R13,
+    COMPILER_VM_REG_R12,
+};
+
+static int8_t compiler_regalloc_interval_comparator(const void* data1, const void* data2) {
+    const compiler_regalloc_interval_t* i1 = data1;
+    const compiler_regalloc_interval_t* i2 = data2;
+
+    if(i1->start != i2->start) {
+        return i1->start < i2->start ? -1 : 1;
+    }
+
+    // heavier interval first at same start
+    if(i1->weight != i2->weight) {
+        return i1->weight > i2->weight ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static boolean_t compiler_regalloc_is_candidate(compiler_t* compiler, const compiler_symbol_t* symbol) {
+    if(!symbol || symbol == compiler->program_name_symbol || symbol->is_external) {
+        return false;
+    }
+
+    if(symbol->type != COMPILER_SYMBOL_TYPE_INTEGER || symbol->is_array || symbol->hidden_type == COMPILER_SYMBOL_TYPE_STRING) {
+        return false;
+    }
+
+    return symbol->size == 8 || symbol->size == 16 || symbol->size == 32 || symbol->size == 64;
+}
+
+static void compiler_regalloc_record_use(compiler_t* compiler, compiler_regalloc_t* ra, const compiler_ast_node_t* node,
+                                         int64_t statement, int64_t loop_depth, boolean_t is_write, boolean_t is_definition) {
+    if(!node->token || node->token->type != COMPILER_TOKEN_TYPE_ID) {
+        return;
+    }
+
+    const compiler_symbol_t* symbol = compiler_find_symbol_by_token(compiler, node->token);
+
+    if(!compiler_regalloc_is_candidate(compiler, symbol)) {
+        return;
+    }
+
+    compiler_regalloc_interval_t* interval = (compiler_regalloc_interval_t*)hashmap_get(ra->intervals_by_symbol, symbol);
+
+    if(!interval) {
+        interval = memory_malloc(sizeof(compiler_regalloc_interval_t));
+
+        if(!interval) {
+            return;
+        }
+
+        interval->symbol = symbol;
+        interval->start = statement;
+        interval->is_eligible = true;
+        interval->used_register = -1;
+        interval->is_defined_at_start = is_definition;
+
+        hashmap_put(ra->intervals_by_symbol, symbol, interval);
+    }
+
+    interval->end = statement;
+    interval->weight += 1LL << (3 * MIN(loop_depth, COMPILER_REGALLOC_MAX_LOOP_DEPTH));
+
+    // subscripts, fields and calls need the address
+    if(node->right) {
+        interval->is_eligible = false;
+    }
+
+    if(is_write) {
+        interval->is_written = true;
+    }
+}
+
+static int64_t compiler_regalloc_scan(compiler_t* compiler, compiler_regalloc_t* ra, const compiler_ast_node_t* node,
+                                      int64_t statement, int64_t loop_depth);
+
+static int64_t compiler_regalloc_scan_call(compiler_t* compiler, compiler_regalloc_t* ra, const compiler_ast_node_t* node,
+                                           int64_t statement, int64_t loop_depth) {
+    int64_t arg_need = 0;
+
+    for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+        int64_t n = compiler_regalloc_scan(compiler, ra, list_get_data_at_position(node->children, i), statement, loop_depth);
+        arg_need = MAX(arg_need, n + (int64_t)i);
+    }
+
+    ra->has_call[statement] = true;
+
+    // call target, return value and argument registers
+    return 2 + arg_need;
+}
+
+static int64_t compiler_regalloc_scan_var(compiler_t* compiler, compiler_regalloc_t* ra, const compiler_ast_node_t* node,
+                                          int64_t statement, int64_t loop_depth, boolean_t is_write, boolean_t is_definition) {
+    compiler_regalloc_record_use(compiler, ra, node, statement, loop_depth, is_write, is_definition);
+
+    int64_t need = 1;
+
+    // field names at chain are not symbols, only subscripts and call arguments are scanned
+    for(const compiler_ast_node_t* chain = node->right; chain; chain = chain->right) {
+        if(chain->type == COMPILER_AST_NODE_TYPE_FUNCTION_CALL) {
+            int64_t call_need = compiler_regalloc_scan_call(compiler, ra, chain, statement, loop_depth);
+            need = MAX(need, call_need);
+
+            break;
+        } else if(chain->type == COMPILER_AST_NODE_TYPE_ARRAY_SUBSCRIPT) {
+            int64_t index_need = 1 + compiler_regalloc_scan(compiler, ra, chain->left, statement, loop_depth);
+            need = MAX(need, index_need);
+        }
+    }
+
+    return need;
+}
+
+/**
+ * @brief scans an ast node, records variable references and estimates its temporary register need
+ * @param[in] compiler compiler
+ * @param[in] ra allocator
+ * @param[in] node node to scan
+ * @param[in] statement top level statement index
+ * @param[in] loop_depth loop depth of node
+ * @return estimated register need
+ */
+static int64_t compiler_regalloc_scan(compiler_t* compiler, compiler_regalloc_t* ra, const compiler_ast_node_t* node,
+                                      int64_t statement, int64_t loop_depth) {
+    if(!node) {
+        return 0;
+    }
+
+    int64_t need = 0;
+
+    switch(node->type) {
+    case COMPILER_AST_NODE_TYPE_INTEGER_CONST:
+    case COMPILER_AST_NODE_TYPE_NO_OP:
+    case COMPILER_AST_NODE_TYPE_GOTO:
+    case COMPILER_AST_NODE_TYPE_LABEL:
+        return 0;
+    case COMPILER_AST_NODE_TYPE_STRING_CONST:
+        return 1;
+    case COMPILER_AST_NODE_TYPE_VAR:
+        return compiler_regalloc_scan_var(compiler, ra, node, statement, loop_depth, false, false);
+    case COMPILER_AST_NODE_TYPE_FUNCTION_CALL:
+        return compiler_regalloc_scan_call(compiler, ra, node, statement, loop_depth);
+    case COMPILER_AST_NODE_TYPE_ASSIGN: {
+        // right side is scanned first, it is evaluated before store
+        int64_t right_need = compiler_regalloc_scan(compiler, ra, node->right, statement, loop_depth);
+        int64_t left_need = 0;
+
+        if(node->left && node->left->type == COMPILER_AST_NODE_TYPE_VAR) {
+            left_need = compiler_regalloc_scan_var(compiler, ra, node->left, statement, loop_depth, true, node == ra->current_statement);
+        }
+
+        return MAX(left_need, 1 + right_need);
+    }
+    case COMPILER_AST_NODE_TYPE_BINARY_OP:
+    case COMPILER_AST_NODE_TYPE_RELATIONAL_OP: {
+        int64_t left_need = compiler_regalloc_scan(compiler, ra, node->left, statement, loop_depth);
+        int64_t right_need = compiler_regalloc_scan(compiler, ra, node->right, statement, loop_depth);
+
+        need = MAX(left_need, right_need + 1);
+
+        // division needs rax, rdx and a divisor register
+        if(node->token && (node->token->type == COMPILER_TOKEN_TYPE_INTEGER_DIVIDE || node->token->type == COMPILER_TOKEN_TYPE_MOD)) {
+            need += 3;
+        } else if(node->token && (node->token->type == COMPILER_TOKEN_TYPE_SHL || node->token->type == COMPILER_TOKEN_TYPE_SHR)) {
+            need += 1;
+        }
+
+        return need;
+    }
+    case COMPILER_AST_NODE_TYPE_WHILE:
+        loop_depth++;
+        break;
+    case COMPILER_AST_NODE_TYPE_COMPOUND:
+        for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+            const compiler_ast_node_t* child = list_get_data_at_position(node->children, i);
+
+            if(child->type != COMPILER_AST_NODE_TYPE_DECLS) {
+                continue;
+            }
+
+            // nested declarations shadow outer names, references cannot be resolved before code generation
+            for(size_t j = 0; j < list_size(child->children); j++) {
+                const compiler_ast_node_t* var_node = list_get_data_at_position(child->children, j);
+
+                for(size_t k = 0; var_node->children && k < list_size(var_node->children); k++) {
+                    const compiler_symbol_t* symbol = list_get_data_at_position(var_node->children, k);
+                    hashmap_put(ra->shadowed_names, symbol->name, symbol);
+                }
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    const compiler_ast_node_t* parts[] = {node->condition, node->left, node->right};
+
+    for(size_t i = 0; i < ARRAY_SIZE(parts); i++) {
+        int64_t part_need = compiler_regalloc_scan(compiler, ra, parts[i], statement, loop_depth);
+        need = MAX(need, part_need);
+    }
+
+    for(size_t i = 0; node->children && i < list_size(node->children); i++) {
+        const compiler_ast_node_t* child = list_get_data_at_position(node->children, i);
+
+        if(child->type != COMPILER_AST_NODE_TYPE_DECLS) {
+            int64_t child_need = compiler_regalloc_scan(compiler, ra, child, statement, loop_depth);
+            need = MAX(need, child_need);
+        }
+    }
+
+    return need;
+}
+
+static boolean_t compiler_regalloc_fits(const compiler_regalloc_t* ra, const compiler_regalloc_interval_t* interval) {
+    for(int64_t s = interval->start; s <= interval->end; s++) {
+        if(ra->occupancy[s] + 1 + ra->need[s] > COMPILER_VM_REG_COUNT - COMPILER_REGALLOC_SPARE_REGS) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void compiler_regalloc_occupy(compiler_regalloc_t* ra, const compiler_regalloc_interval_t* interval, int64_t delta) {
+    for(int64_t s = interval->start; s <= interval->end; s++) {
+        ra->occupancy[s] += delta;
+    }
+}
+
+static boolean_t compiler_regalloc_crosses_call(const compiler_regalloc_t* ra, const compiler_regalloc_interval_t* interval) {
+    for(int64_t s = interval->start; s <= interval->end; s++) {
+        if(ra->has_call[s]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief finds a free register for interval
+ * @param[in] active intervals at registers overlapping current one
+ * @param[in] crosses_call only callee saved registers are usable
+ * @return register id, -1 if none
+ */
+static int16_t compiler_regalloc_free_register(list_t* active, boolean_t crosses_call) {
+    boolean_t used[COMPILER_VM_REG_COUNT] = {false};
+
+    for(size_t i = 0; i < list_size(active); i++) {
+        const compiler_regalloc_interval_t* a = list_get_data_at_position(active, i);
+        used[a->used_register] = true;
+    }
+
+    if(!crosses_call) {
+        for(size_t i = 0; i < ARRAY_SIZE(compiler_regalloc_caller_saved); i++) {
+            if(!used[compiler_regalloc_caller_saved[i]]) {
+                return compiler_regalloc_caller_saved[i];
+            }
+        }
+    }
+
+    for(size_t i = 0; i < ARRAY_SIZE(compiler_regalloc_callee_saved); i++) {
+        if(!used[compiler_regalloc_callee_saved[i]]) {
+            return compiler_regalloc_callee_saved[i];
+        }
+    }
+
+    return -1;
+}
+
+static boolean_t compiler_regalloc_is_callee_saved(int16_t reg) {
+    for(size_t i = 0; i < ARRAY_SIZE(compiler_regalloc_callee_saved); i++) {
+        if(compiler_regalloc_callee_saved[i] == reg) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void compiler_regalloc_linear_scan(compiler_regalloc_t* ra) {
+    list_t* active = list_create_list();
+
+    if(!active) {
+        return;
+    }
+
+    for(size_t i = 0; i < list_size(ra->intervals); i++) {
+        compiler_regalloc_interval_t* current = (compiler_regalloc_interval_t*)list_get_data_at_position(ra->intervals, i);
+
+        // expire intervals ended before current one
+        for(size_t j = 0; j < list_size(active); ) {
+            const compiler_regalloc_interval_t* a = list_get_data_at_position(active, j);
+
+            if(a->end < current->start) {
+                list_delete_at_position(active, j);
+            } else {
+                j++;
+            }
+        }
+
+        boolean_t crosses_call = compiler_regalloc_crosses_call(ra, current);
+        int16_t reg = compiler_regalloc_free_register(active, crosses_call);
+
+        if(reg != -1 && compiler_regalloc_fits(ra, current)) {
+            current->used_register = reg;
+            compiler_regalloc_occupy(ra, current, 1);
+            list_list_insert(active, current);
+            ra->promoted_count++;
+
+            continue;
+        }
+
+        // spill cheapest of active and current, active one gives its register if it is usable by current
+        compiler_regalloc_interval_t* victim = NULL;
+
+        for(size_t j = 0; j < list_size(active); j++) {
+            compiler_regalloc_interval_t* a = (compiler_regalloc_interval_t*)list_get_data_at_position(active, j);
+
+            if(crosses_call && !compiler_regalloc_is_callee_saved(a->used_register)) {
+                continue;
+            }
+
+            if(a->weight < current->weight && (!victim || a->weight < victim->weight)) {
+                victim = a;
+            }
+        }
+
+        if(victim) {
+            compiler_regalloc_occupy(ra, victim, -1);
+
+            if(reg == -1) {
+                reg = victim->used_register;
+            }
+
+            if(compiler_regalloc_fits(ra, current)) {
+                PRINTLOG(COMPILER, LOG_DEBUG, "spill %s for %s", victim->symbol->name, current->symbol->name);
+
+                list_list_delete(active, victim);
+                victim->used_register = -1;
+
+                current->used_register = reg;
+                compiler_regalloc_occupy(ra, current, 1);
+                list_list_insert(active, current);
+
+                ra->spilled_count++;
+
+                continue;
+            }
+
+            compiler_regalloc_occupy(ra, victim, 1);
+        }
+
+        ra->spilled_count++;
+    }
+
+    list_destroy(active);
+}
+
+int8_t compiler_regalloc_build(compiler_t* compiler, compiler_ast_node_t* body) {
+    if(!compiler || !body || body->type != COMPILER_AST_NODE_TYPE_COMPOUND || !body->children) {
+        return -1;
+    }
+
+    compiler_regalloc_t* ra = memory_malloc(sizeof(compiler_regalloc_t));
+
+    if(!ra) {
+        return -1;
+    }
+
+    compiler->regalloc = ra;
+
+    ra->body = body;
+    ra->statement_count = list_size(body->children);
+    ra->intervals = list_create_sortedlist(compiler_regalloc_interval_comparator);
+    ra->intervals_by_symbol = hashmap_integer(64);
+    ra->shadowed_names = hashmap_string(16);
+    ra->need = memory_malloc(sizeof(int64_t) * (ra->statement_count + 1));
+    ra->occupancy = memory_malloc(sizeof(int64_t) * (ra->statement_count + 1));
+    ra->has_call = memory_malloc(sizeof(boolean_t) * (ra->statement_count + 1));
+
+    if(!ra->intervals || !ra->intervals_by_symbol || !ra->shadowed_names || !ra->need || !ra->occupancy || !ra->has_call) {
+        PRINTLOG(COMPILER, LOG_ERROR, "cannot allocate register allocator");
+
+        return -1;
+    }
+
+    for(int64_t s = 0; s < ra->statement_count; s++) {
+        const compiler_ast_node_t* stmt = list_get_data_at_position(body->children, s);
+
+        if(stmt->type != COMPILER_AST_NODE_TYPE_DECLS) {
+            ra->current_statement = stmt;
+            ra->need[s] = compiler_regalloc_scan(compiler, ra, stmt, s, 0);
+        }
+    }
+
+    iterator_t* it = hashmap_iterator_create(ra->intervals_by_symbol);
+
+    if(!it) {
+        return -1;
+    }
+
+    while(it->end_of_iterator(it) != 0) {
+        compiler_regalloc_interval_t* interval = (compiler_regalloc_interval_t*)it->get_item(it);
+
+        if(hashmap_exists(ra->shadowed_names, interval->symbol->name)) {
+            interval->is_eligible = false;
+        }
+
+        if(interval->is_eligible) {
+            list_sortedlist_insert(ra->intervals, interval);
+        }
+
+        it = it->next(it);
+    }
+
+    it->destroy(it);
+
+    compiler_regalloc_linear_scan(ra);
+
+    PRINTLOG(COMPILER, LOG_DEBUG, "register allocation: %lli variables at registers, %lli at memory",
+             ra->promoted_count, ra->spilled_count);
+
+    return 0;
+}
+
+int8_t compiler_regalloc_destroy(compiler_t* compiler) {
+    compiler_regalloc_t* ra = compiler->regalloc;
+
+    if(!ra) {
+        return 0;
+    }
+
+    if(ra->intervals_by_symbol) {
+        iterator_t* it = hashmap_iterator_create(ra->intervals_by_symbol);
+
+        if(it) {
+            while(it->end_of_iterator(it) != 0) {
+                memory_free((void*)it->get_item(it));
+
+                it = it->next(it);
+            }
+
+            it->destroy(it);
+        }
+
+        hashmap_destroy(ra->intervals_by_symbol);
+    }
+
+    hashmap_destroy(ra->shadowed_names);
+    list_destroy(ra->intervals);
+    memory_free(ra->need);
+    memory_free(ra->occupancy);
+    memory_free(ra->has_call);
+    memory_free(ra);
+
+    compiler->regalloc = NULL;
+
+    return 0;
+}
+
+/**
+ * @brief moves variable between its register and memory
+ * @param[in] compiler compiler
+ * @param[in] interval variable interval
+ * @param[in] store true for register to memory
+ * @return 0 on success
+ */
+static int8_t compiler_regalloc_transfer(compiler_t* compiler, const compiler_regalloc_interval_t* interval, boolean_t store) {
+    const compiler_symbol_t* symbol = interval->symbol;
+    const char_t* reg = compiler_cast_reg_to_size(compiler_regs[interval->used_register], symbol->size);
+    char_t suffix = compiler_get_reg_suffix(symbol->size);
+
+    if(symbol->is_local) {
+        if(store) {
+            buffer_printf(compiler->text_buffer, "\tmov%c %%%s, -%d(%%rbp)\n", suffix, reg, symbol->stack_offset);
+        } else {
+            buffer_printf(compiler->text_buffer, "\tmov%c -%d(%%rbp), %%%s\n", suffix, symbol->stack_offset, reg);
+        }
+
+        return 0;
+    }
+
+    // loading can use the target register for address
+    int16_t addr_reg = store ? compiler_find_free_reg(compiler) : interval->used_register;
+
+    if(addr_reg == -1) {
+        PRINTLOG(COMPILER, LOG_ERROR, "no free register");
+
+        return -1;
+    }
+
+    buffer_printf(compiler->text_buffer, "\tmov $%s@GOT, %%%s\n", symbol->name, compiler_regs[addr_reg]);
+    buffer_printf(compiler->text_buffer, "\tmov (%%r15, %%%s), %%%s\n", compiler_regs[addr_reg], compiler_regs[addr_reg]);
+
+    if(store) {
+        buffer_printf(compiler->text_buffer, "\tmov%c %%%s, (%%%s)\n", suffix, reg, compiler_regs[addr_reg]);
+        compiler->busy_regs[addr_reg] = false;
+    } else {
+        buffer_printf(compiler->text_buffer, "\tmov%c (%%%s), %%%s\n", suffix, compiler_regs[addr_reg], reg);
+    }
+
+    return 0;
+}
+
+int8_t compiler_regalloc_begin_statement(compiler_t* compiler, compiler_ast_node_t* body, int64_t statement) {
+    compiler_regalloc_t* ra = compiler->regalloc;
+
+    if(!ra || ra->body != body) {
+        return 0;
+    }
+
+    for(size_t i = 0; i < list_size(ra->intervals); i++) {
+        compiler_regalloc_interval_t* interval = (compiler_regalloc_interval_t*)list_get_data_at_position(ra->intervals, i);
+
+        if(interval->start > statement) {
+            break;
+        }
+
+        if(interval->start != statement || interval->used_register == -1) {
+            continue;
+        }
+
+        buffer_printf(compiler->text_buffer, "# variable %s at register %s\n", interval->symbol->name, compiler_regs[interval->used_register]);
+
+        compiler->busy_regs[interval->used_register] = true;
+
+        if(!interval->is_defined_at_start && compiler_regalloc_transfer(compiler, interval, false) != 0) {
+            return -1;
+        }
+
+        interval->is_live = true;
+    }
+
+    return 0;
+}
+
+int8_t compiler_regalloc_end_statement(compiler_t* compiler, compiler_ast_node_t* body, int64_t statement) {
+    compiler_regalloc_t* ra = compiler->regalloc;
+
+    if(!ra || ra->body != body) {
+        return 0;
+    }
+
+    for(size_t i = 0; i < list_size(ra->intervals); i++) {
+        compiler_regalloc_interval_t* interval = (compiler_regalloc_interval_t*)list_get_data_at_position(ra->intervals, i);
+
+        if(interval->start > statement) {
+            break;
+        }
+
+        if(interval->end != statement || !interval->is_live) {
+            continue;
+        }
+
+        if(interval->is_written && compiler_regalloc_transfer(compiler, interval, true) != 0) {
+            return -1;
+        }
+
+        buffer_printf(compiler->text_buffer, "# variable %s leaves register %s\n", interval->symbol->name, compiler_regs[interval->used_register]);
+
+        compiler->busy_regs[interval->used_register] = false;
+        interval->is_live = false;
+    }
+
+    return 0;
+}
+
+int16_t compiler_regalloc_get_register(compiler_t* compiler, const compiler_symbol_t* symbol) {
+    if(!compiler->regalloc || !symbol) {
+        return -1;
+    }
+
+    const compiler_regalloc_interval_t* interval = hashmap_get(compiler->regalloc->intervals_by_symbol, symbol);
+
+    if(!interval || !interval->is_live) {
+        return -1;
+    }
+
+    return interval->used_register;
+}
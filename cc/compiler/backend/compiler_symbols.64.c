@@ -12,92 +12,304 @@
 
 MODULE("turnstone.compiler");
 
-const compiler_symbol_t* compiler_find_symbol(compiler_t* compiler, const char_t* name) {
-    compiler_symbol_table_t* symbol_table = compiler->current_symbol_table;
+/*! initial identifier capacity of scopes */
+#define COMPILER_SCOPES_INITIAL_CAPACITY 256
 
-    while(symbol_table) {
-        const compiler_symbol_t* symbol = hashmap_get(symbol_table->symbols, name);
+typedef struct compiler_symbol_binding_t {
+    const compiler_symbol_t* symbol; ///< visible symbol
+    int64_t                  depth; ///< scope depth of symbol
+} compiler_symbol_binding_t;
 
-        if(symbol != NULL) {
-            return symbol;
-        }
+typedef struct compiler_scope_entry_t {
+    int64_t                   identifier_id; ///< identifier bound at scope
+    compiler_symbol_binding_t shadowed; ///< binding hidden until scope is left
+} compiler_scope_entry_t;
 
-        symbol_table = symbol_table->parent;
+/**
+ * @brief symbols of open scopes as a flat array indexed by identifier id
+ *
+ * entering a scope pushes a marker, binding a symbol records the binding it shadows. leaving a scope restores
+ * shadowed bindings back to the marker, so lookups never walk scopes.
+ */
+struct compiler_scopes_t {
+    compiler_symbol_binding_t* bindings; ///< innermost visible symbols by identifier id
+    const compiler_symbol_t**  externals; ///< external symbols by identifier id
+    int64_t                    binding_capacity; ///< capacity of bindings and externals
+    compiler_scope_entry_t*    entries; ///< bindings of open scopes, innermost last
+    int64_t                    entry_count; ///< entry count
+    int64_t                    entry_capacity; ///< entry capacity
+    int64_t*                   markers; ///< first entry of each open scope
+    int64_t                    marker_capacity; ///< marker capacity
+    int64_t                    depth; ///< innermost scope, main scope is 0
+};
+
+static void* compiler_scopes_grow(void* data, uint64_t item_size, int64_t count, int64_t new_count) {
+    void* new_data = memory_malloc(item_size * new_count);
+
+    if(new_data == NULL) {
+        return NULL;
     }
 
-    const compiler_symbol_t* symbol = hashmap_get(compiler->external_symbols, name);
+    if(data) {
+        memory_memcopy(data, new_data, item_size * count);
+        memory_free(data);
+    }
 
-    return symbol;
+    return new_data;
 }
 
-int8_t compiler_print_symbol_table(compiler_t * compiler) {
-    compiler_symbol_table_t* symbol_table = compiler->current_symbol_table;
+static boolean_t compiler_scopes_reserve(compiler_scopes_t* scopes, int64_t identifier_id) {
+    if(identifier_id < scopes->binding_capacity) {
+        return true;
+    }
+
+    int64_t new_capacity = scopes->binding_capacity * 2;
+
+    while(new_capacity <= identifier_id) {
+        new_capacity *= 2;
+    }
+
+    compiler_symbol_binding_t* bindings = compiler_scopes_grow(scopes->bindings, sizeof(compiler_symbol_binding_t),
+                                                               scopes->binding_capacity, new_capacity);
+
+    if(bindings == NULL) {
+        return false;
+    }
+
+    scopes->bindings = bindings;
+
+    const compiler_symbol_t** externals = compiler_scopes_grow(scopes->externals, sizeof(compiler_symbol_t*),
+                                                               scopes->binding_capacity, new_capacity);
+
+    if(externals == NULL) {
+        return false;
+    }
+
+    scopes->externals = externals;
+    scopes->binding_capacity = new_capacity;
+
+    return true;
+}
+
+static int64_t compiler_symbol_identifier_id(compiler_t* compiler, compiler_symbol_t* symbol) {
+    if(symbol->identifier_id == 0) {
+        symbol->identifier_id = compiler_identifier_pool_intern(compiler->identifiers, symbol->name);
+    }
+
+    return symbol->identifier_id;
+}
+
+int8_t compiler_init_symbol_table(compiler_t* compiler) {
+    compiler_scopes_t* scopes = memory_malloc(sizeof(compiler_scopes_t));
+
+    if(scopes == NULL) {
+        return -1;
+    }
+
+    scopes->bindings = memory_malloc(sizeof(compiler_symbol_binding_t) * COMPILER_SCOPES_INITIAL_CAPACITY);
+    scopes->externals = memory_malloc(sizeof(compiler_symbol_t*) * COMPILER_SCOPES_INITIAL_CAPACITY);
+    scopes->entries = memory_malloc(sizeof(compiler_scope_entry_t) * COMPILER_SCOPES_INITIAL_CAPACITY);
+    scopes->markers = memory_malloc(sizeof(int64_t) * 16);
 
-    while(symbol_table) {
-        iterator_t* iter = hashmap_iterator_create(symbol_table->symbols);
+    if(scopes->bindings == NULL || scopes->externals == NULL || scopes->entries == NULL || scopes->markers == NULL) {
+        memory_free(scopes->bindings);
+        memory_free(scopes->externals);
+        memory_free(scopes->entries);
+        memory_free(scopes->markers);
+        memory_free(scopes);
 
-        if (iter == NULL) {
+        return -1;
+    }
+
+    scopes->binding_capacity = COMPILER_SCOPES_INITIAL_CAPACITY;
+    scopes->entry_capacity = COMPILER_SCOPES_INITIAL_CAPACITY;
+    scopes->marker_capacity = 16;
+
+    compiler->scopes = scopes;
+
+    return 0;
+}
+
+int8_t compiler_enter_scope(compiler_t* compiler) {
+    compiler_scopes_t* scopes = compiler->scopes;
+
+    if(scopes->depth + 1 == scopes->marker_capacity) {
+        int64_t* markers = compiler_scopes_grow(scopes->markers, sizeof(int64_t), scopes->marker_capacity, scopes->marker_capacity * 2);
+
+        if(markers == NULL) {
             return -1;
         }
 
-        while (iter->end_of_iterator(iter) != 0) {
-            const compiler_symbol_t* symbol = iter->get_item(iter);
+        scopes->markers = markers;
+        scopes->marker_capacity *= 2;
+    }
 
-            if (symbol == NULL) {
-                iter->destroy(iter);
-                return -1;
-            }
+    scopes->depth++;
+    scopes->markers[scopes->depth] = scopes->entry_count;
+
+    return 0;
+}
+
+int8_t compiler_leave_scope(compiler_t* compiler) {
+    compiler_scopes_t* scopes = compiler->scopes;
+
+    if(scopes->depth == 0) {
+        PRINTLOG(COMPILER, LOG_ERROR, "cannot leave main scope");
+
+        return -1;
+    }
+
+    // restore in reverse order, a name bound twice at scope gets its first shadowed binding back
+    while(scopes->entry_count > scopes->markers[scopes->depth]) {
+        scopes->entry_count--;
+
+        const compiler_scope_entry_t* entry = &scopes->entries[scopes->entry_count];
+        scopes->bindings[entry->identifier_id] = entry->shadowed;
+    }
+
+    scopes->depth--;
+
+    return 0;
+}
+
+int8_t compiler_bind_symbol(compiler_t* compiler, compiler_symbol_t* symbol, boolean_t at_main_scope) {
+    compiler_scopes_t* scopes = compiler->scopes;
+    int64_t id = compiler_symbol_identifier_id(compiler, symbol);
+
+    if(id == 0 || !compiler_scopes_reserve(scopes, id)) {
+        PRINTLOG(COMPILER, LOG_ERROR, "cannot bind symbol %s", symbol->name);
+
+        return -1;
+    }
 
-            PRINTLOG(COMPILER, LOG_INFO, "symbol %s type %d size %lli value %lli", symbol->name, symbol->type, symbol->size, symbol->int_value);
+    compiler_symbol_binding_t binding = {.symbol = symbol, .depth = at_main_scope ? 0 : scopes->depth};
 
-            iter->next(iter);
+    if(at_main_scope && scopes->depth > 0 && scopes->bindings[id].depth > 0) {
+        // name is shadowed by an open scope, main scope binding comes back when outermost shadow is left
+        for(int64_t i = scopes->markers[1]; i < scopes->entry_count; i++) {
+            if(scopes->entries[i].identifier_id == id) {
+                scopes->entries[i].shadowed = binding;
+
+                return 0;
+            }
         }
+    }
+
+    if(!at_main_scope || scopes->depth == 0) {
+        if(scopes->entry_count == scopes->entry_capacity) {
+            compiler_scope_entry_t* entries = compiler_scopes_grow(scopes->entries, sizeof(compiler_scope_entry_t),
+                                                                   scopes->entry_count, scopes->entry_capacity * 2);
+
+            if(entries == NULL) {
+                return -1;
+            }
 
-        iter->destroy(iter);
+            scopes->entries = entries;
+            scopes->entry_capacity *= 2;
+        }
 
-        symbol_table = symbol_table->parent;
+        scopes->entries[scopes->entry_count].identifier_id = id;
+        scopes->entries[scopes->entry_count].shadowed = scopes->bindings[id];
+        scopes->entry_count++;
     }
 
+    scopes->bindings[id] = binding;
+
     return 0;
 }
 
-int8_t compiler_destroy_symbol_table(compiler_t * compiler) {
-    compiler_symbol_table_t* symbol_table = compiler->current_symbol_table;
+const compiler_symbol_t* compiler_find_symbol_at_current_scope(compiler_t* compiler, compiler_symbol_t* symbol) {
+    compiler_scopes_t* scopes = compiler->scopes;
+    int64_t id = compiler_symbol_identifier_id(compiler, symbol);
+
+    if(id == 0 || id >= scopes->binding_capacity || scopes->bindings[id].depth != scopes->depth) {
+        return NULL;
+    }
+
+    return scopes->bindings[id].symbol;
+}
+
+const compiler_symbol_t* compiler_find_symbol_by_id(compiler_t* compiler, int64_t identifier_id) {
+    compiler_scopes_t* scopes = compiler->scopes;
+
+    if(identifier_id <= 0 || identifier_id >= scopes->binding_capacity) {
+        return NULL;
+    }
+
+    const compiler_symbol_t* symbol = scopes->bindings[identifier_id].symbol;
+
+    if(symbol == NULL) {
+        symbol = scopes->externals[identifier_id];
+    }
+
+    return symbol;
+}
+
+const compiler_symbol_t* compiler_find_symbol_by_token(compiler_t* compiler, const compiler_token_t* token) {
+    if(token->identifier_id) {
+        return compiler_find_symbol_by_id(compiler, token->identifier_id);
+    }
+
+    return compiler_find_symbol(compiler, token->text);
+}
+
+const compiler_symbol_t* compiler_find_symbol(compiler_t* compiler, const char_t* name) {
+    return compiler_find_symbol_by_id(compiler, compiler_identifier_pool_find(compiler->identifiers, name));
+}
+
+int8_t compiler_print_symbol_table(compiler_t * compiler) {
+    compiler_scopes_t* scopes = compiler->scopes;
+
+    for(int64_t depth = scopes->depth; depth >= 0; depth--) {
+        int64_t end = depth == scopes->depth ? scopes->entry_count : scopes->markers[depth + 1];
 
-    while(symbol_table) {
-        hashmap_destroy(symbol_table->symbols);
+        for(int64_t i = depth ? scopes->markers[depth] : 0; i < end; i++) {
+            const compiler_symbol_binding_t* binding = &scopes->bindings[scopes->entries[i].identifier_id];
 
-        compiler_symbol_table_t* parent = symbol_table->parent;
+            if(binding->depth != depth || binding->symbol == NULL) {
+                continue;
+            }
 
-        memory_free(symbol_table);
+            const compiler_symbol_t* symbol = binding->symbol;
 
-        symbol_table = parent;
+            PRINTLOG(COMPILER, LOG_INFO, "symbol %s type %d size %lli value %lli depth %lli", symbol->name, symbol->type, symbol->size, symbol->int_value, depth);
+        }
     }
 
     return 0;
 }
 
-int8_t compiler_build_stack(compiler_t* compiler) {
-    if (compiler->current_symbol_table == NULL) {
+int8_t compiler_destroy_symbol_table(compiler_t * compiler) {
+    compiler_scopes_t* scopes = compiler->scopes;
+
+    if(scopes == NULL) {
         return -1;
     }
 
-    iterator_t* iter = hashmap_iterator_create(compiler->current_symbol_table->symbols);
+    memory_free(scopes->bindings);
+    memory_free(scopes->externals);
+    memory_free(scopes->entries);
+    memory_free(scopes->markers);
+    memory_free(scopes);
 
-    if (iter == NULL) {
+    compiler->scopes = NULL;
+
+    return 0;
+}
+
+int8_t compiler_build_stack(compiler_t* compiler) {
+    compiler_scopes_t* scopes = compiler->scopes;
+
+    if (scopes == NULL) {
         return -1;
     }
 
-    while (iter->end_of_iterator(iter) != 0) {
-        const compiler_symbol_t* symbol = iter->get_item(iter);
-
-        if (symbol == NULL) {
-            iter->destroy(iter);
-            return -1;
-        }
+    for(int64_t i = scopes->depth ? scopes->markers[scopes->depth] : 0; i < scopes->entry_count; i++) {
+        const compiler_symbol_binding_t* binding = &scopes->bindings[scopes->entries[i].identifier_id];
+        const compiler_symbol_t* symbol = binding->symbol;
 
-        if(!symbol->is_local) {
-            iter->next(iter);
+        // a name bound twice at scope is initialized once
+        if (symbol == NULL || binding->depth != scopes->depth || !symbol->is_local) {
             continue;
         }
 
@@ -138,12 +350,8 @@ int8_t compiler_build_stack(compiler_t* compiler) {
             PRINTLOG(COMPILER, LOG_ERROR, "unknown symbol type %d", symbol->type);
             return -1;
         }
-
-        iter->next(iter);
     }
 
-    iter->destroy(iter);
-
     return 0;
 }
 
@@ -252,6 +460,14 @@ int8_t compiler_add_external_symbol(compiler_t* compiler, const char_t* name, co
         return -1;
     }
 
+    int64_t id = compiler_symbol_identifier_id(compiler, symbol);
+
+    if(id == 0 || !compiler_scopes_reserve(compiler->scopes, id)) {
+        return -1;
+    }
+
+    compiler->scopes->externals[id] = symbol;
+
     return 0;
 }
 #pragma GCC diagnostic pop
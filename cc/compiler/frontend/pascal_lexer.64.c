@@ -74,53 +74,55 @@ const char_t*const pascal_keywords[] = {
 };
 
 const compiler_token_t reserved_tokens[] = {
-    {COMPILER_TOKEN_TYPE_BEGIN, true, 0, 0, "begin", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_END, true, 0, 0, "end", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_PROGRAM, true, 0, 0, "program", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_VAR, true, 0, 0, "var", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_CONST, true, 0, 0, "const", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "bit", false, 1, false, false},
-    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int8", false, 8, false, false},
-    {COMPILER_TOKEN_TYPE_CHAR, true, 0, 0, "char", false, 8, false, false},
-    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int16", false, 16, false, false},
-    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int32", false, 32, false, false},
-    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int64", false, 64, false, false},
-    {COMPILER_TOKEN_TYPE_REAL, true, 0, 0, "float32", false, 32, false, false},
-    {COMPILER_TOKEN_TYPE_REAL, true, 0, 0, "float64", false, 64, false, false},
-    {COMPILER_TOKEN_TYPE_STRING, true, 0, 0, "string", true, 8, false, false},
-    {COMPILER_TOKEN_TYPE_BOOLEAN, true, 0, 0, "true", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_BOOLEAN, true, 0, 0, "false", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_NULL, true, 0, 0, "nil", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_INTEGER_DIVIDE, true, 0, 0, "div", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_PROCEDURE, true, 0, 0, "procedure", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_FUNCTION, true, 0, 0, "function", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_OR, true, 0, 0, "or", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_XOR, true, 0, 0, "xor", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_AND, true, 0, 0, "and", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_NOT, true, 0, 0, "not", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_MOD, true, 0, 0, "mod", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_SHL, true, 0, 0, "shl", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_SHR, true, 0, 0, "shr", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_IN, true, 0, 0, "in", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_IF, true, 0, 0, "if", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_THEN, true, 0, 0, "then", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_ELSE, true, 0, 0, "else", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_WHILE, true, 0, 0, "while", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_DO, true, 0, 0, "do", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_REPEAT, true, 0, 0, "repeat", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_UNTIL, true, 0, 0, "until", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_FOR, true, 0, 0, "for", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_TO, true, 0, 0, "to", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_DOWNTO, true, 0, 0, "downto", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_STEP, true, 0, 0, "step", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_CONTINUE, true, 0, 0, "continue", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_BREAK, true, 0, 0, "break", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_TYPE, true, 0, 0, "type", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_WITH, true, 0, 0, "with", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_RECORD, true, 0, 0, "record", false, 0, false, false},
-    {COMPILER_TOKEN_TYPE_PACKED, true, 0, 0, "packed", false, 0, false, false},
+    {COMPILER_TOKEN_TYPE_BEGIN, true, 0, 0, "begin", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_END, true, 0, 0, "end", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_PROGRAM, true, 0, 0, "program", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_VAR, true, 0, 0, "var", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_CONST, true, 0, 0, "const", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "bit", false, 1, false, false, 0},
+    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int8", false, 8, false, false, 0},
+    {COMPILER_TOKEN_TYPE_CHAR, true, 0, 0, "char", false, 8, false, false, 0},
+    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int16", false, 16, false, false, 0},
+    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int32", false, 32, false, false, 0},
+    {COMPILER_TOKEN_TYPE_INTEGER, true, 0, 0, "int64", false, 64, false, false, 0},
+    {COMPILER_TOKEN_TYPE_REAL, true, 0, 0, "float32", false, 32, false, false, 0},
+    {COMPILER_TOKEN_TYPE_REAL, true, 0, 0, "float64", false, 64, false, false, 0},
+    {COMPILER_TOKEN_TYPE_STRING, true, 0, 0, "string", true, 8, false, false, 0},
+    {COMPILER_TOKEN_TYPE_BOOLEAN, true, 0, 0, "true", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_BOOLEAN, true, 0, 0, "false", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_NULL, true, 0, 0, "nil", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_INTEGER_DIVIDE, true, 0, 0, "div", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_PROCEDURE, true, 0, 0, "procedure", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_FUNCTION, true, 0, 0, "function", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_OR, true, 0, 0, "or", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_XOR, true, 0, 0, "xor", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_AND, true, 0, 0, "and", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_NOT, true, 0, 0, "not", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_MOD, true, 0, 0, "mod", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_SHL, true, 0, 0, "shl", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_SHR, true, 0, 0, "shr", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_IN, true, 0, 0, "in", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_IF, true, 0, 0, "if", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_THEN, true, 0, 0, "then", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_ELSE, true, 0, 0, "else", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_WHILE, true, 0, 0, "while", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_DO, true, 0, 0, "do", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_REPEAT, true, 0, 0, "repeat", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_UNTIL, true, 0, 0, "until", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_FOR, true, 0, 0, "for", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_TO, true, 0, 0, "to", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_DOWNTO, true, 0, 0, "downto", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_STEP, true, 0, 0, "step", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_CONTINUE, true, 0, 0, "continue", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_BREAK, true, 0, 0, "break", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_TYPE, true, 0, 0, "type", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_WITH, true, 0, 0, "with", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_RECORD, true, 0, 0, "record", false, 0, false, false, 0},
+    {COMPILER_TOKEN_TYPE_PACKED, true, 0, 0, "packed", false, 0, false, false, 0},
 };
 
+#define PASCAL_RESERVED_TOKEN_COUNT (sizeof(reserved_tokens) / sizeof(compiler_token_t))
+
 int8_t compiler_token_destroy(compiler_token_t * token) {
     if (token == NULL) {
         return -1;
@@ -144,6 +146,19 @@ int8_t pascal_lexer_init(pascal_lexer_t * lexer, buffer_t * buffer) {
         return -1;
     }
 
+    lexer->identifiers = compiler_identifier_pool_create();
+
+    if (lexer->identifiers == NULL) {
+        PRINTLOG(COMPILER_PASCAL, LOG_ERROR, "cannot create identifier pool");
+
+        return -1;
+    }
+
+    // reserved words are interned first, so ids 1..count map to reserved tokens
+    for (size_t i = 0; i < PASCAL_RESERVED_TOKEN_COUNT; i++) {
+        compiler_identifier_pool_intern(lexer->identifiers, reserved_tokens[i].text);
+    }
+
     lexer->buffer = buffer;
     lexer->current_char = buffer_get_byte(lexer->buffer);
 
@@ -266,16 +281,23 @@ int8_t pascal_lexer_get_id(pascal_lexer_t * lexer, compiler_token_t ** token) {
 
     token_text = strlower(token_text);
 
-    for (size_t i = 0; i < sizeof(reserved_tokens) / sizeof(compiler_token_t); i++) {
-        if (strcmp(reserved_tokens[i].text, token_text) == 0) {
-            *token = (compiler_token_t*)&reserved_tokens[i];
+    int64_t identifier_id = compiler_identifier_pool_intern(lexer->identifiers, token_text);
 
-            memory_free((void*)token_text);
+    if (identifier_id == 0) {
+        PRINTLOG(COMPILER_PASCAL, LOG_ERROR, "cannot intern identifier %s", token_text);
 
-            return 0;
-        }
+        memory_free((void*)token_text);
+
+        return -1;
     }
 
+    if (identifier_id <= (int64_t)PASCAL_RESERVED_TOKEN_COUNT) {
+        *token = (compiler_token_t*)&reserved_tokens[identifier_id - 1];
+
+        memory_free((void*)token_text);
+
+        return 0;
+    }
 
     compiler_token_t * new_token = memory_malloc(sizeof(compiler_token_t));
 
@@ -289,6 +311,7 @@ int8_t pascal_lexer_get_id(pascal_lexer_t * lexer, compiler_token_t ** token) {
     new_token->type = COMPILER_TOKEN_TYPE_ID;
     new_token->text = token_text;
     new_token->not_free = false;
+    new_token->identifier_id = identifier_id;
 
 
     *token = new_token;
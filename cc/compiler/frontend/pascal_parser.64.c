@@ -455,6 +455,7 @@ int8_t pascal_parser_variable(pascal_parser_t * parser, compiler_ast_node_t ** n
         symbol->is_local = is_local;
         symbol->is_const = is_const;
         symbol->name = strdup(token->text);
+        symbol->identifier_id = token->identifier_id;
 
         list_queue_push(symbol_list, symbol);
 
@@ -1171,6 +1172,7 @@ int8_t pascal_parser_with_statement(pascal_parser_t * parser, compiler_ast_node_
     }
 
     const char_t* prefix_symbol = strdup(parser->current_token->text);
+    int64_t prefix_identifier_id = parser->current_token->identifier_id;
 
     if(pascal_parser_eat(parser, COMPILER_TOKEN_TYPE_ID, true) != 0) {
         PRINTLOG(COMPILER_PASCAL, LOG_ERROR, "expected id");
@@ -1216,6 +1218,7 @@ int8_t pascal_parser_with_statement(pascal_parser_t * parser, compiler_ast_node_
 
                 prefix->token->type = COMPILER_TOKEN_TYPE_ID;
                 prefix->token->text = strdup(prefix_symbol);
+                prefix->token->identifier_id = prefix_identifier_id;
 
                 prefix->right = child->left;
                 child->left = prefix;
@@ -1244,6 +1247,7 @@ int8_t pascal_parser_with_statement(pascal_parser_t * parser, compiler_ast_node_
         }
 
         prefix->token->text = prefix_symbol;
+        prefix->token->identifier_id = prefix_identifier_id;
 
         prefix->right = statement->left;
         statement->left = prefix;
@@ -1526,6 +1530,7 @@ int8_t pascal_parser_for_statement(pascal_parser_t * parser, compiler_ast_node_t
 
     for_init_var->token->type = COMPILER_TOKEN_TYPE_ID;
     for_init_var->token->text = strdup(for_assignment->left->token->text);
+    for_init_var->token->identifier_id = for_assignment->left->token->identifier_id;
 
     compiler_ast_node_t* for_step_var_left = memory_malloc(sizeof(compiler_ast_node_t));
 
@@ -1548,6 +1553,7 @@ int8_t pascal_parser_for_statement(pascal_parser_t * parser, compiler_ast_node_t
 
     for_step_var_left->token->type = COMPILER_TOKEN_TYPE_ID;
     for_step_var_left->token->text = strdup(for_assignment->left->token->text);
+    for_step_var_left->token->identifier_id = for_assignment->left->token->identifier_id;
 
     compiler_ast_node_t* for_step_var_right = memory_malloc(sizeof(compiler_ast_node_t));
 
@@ -1571,6 +1577,7 @@ int8_t pascal_parser_for_statement(pascal_parser_t * parser, compiler_ast_node_t
 
     for_step_var_right->token->type = COMPILER_TOKEN_TYPE_ID;
     for_step_var_right->token->text = strdup(for_assignment->left->token->text);
+    for_step_var_right->token->identifier_id = for_assignment->left->token->identifier_id;
 
     boolean_t is_to = false;
 
@@ -1969,6 +1976,9 @@ int8_t pascal_parser_program(pascal_parser_t * parser, compiler_ast_node_t ** no
 }
 
 int8_t pascal_parser_parse(pascal_parser_t * parser, compiler_ast_t * ast) {
+    // ast owns identifiers, so ids stay valid after lexer and parser are gone
+    ast->identifiers = parser->lexer->identifiers;
+
     return pascal_parser_program(parser, &ast->root);
 }
 
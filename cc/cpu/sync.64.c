@@ -35,8 +35,6 @@ lock_get_local_apic_id_getter_f lock_get_local_apic_id_getter = NULL;
 lock_current_task_getter_f lock_get_current_task_getter = NULL;
 lock_task_yielder_f lock_task_yielder = NULL;
 
-void future_task_wait_toggler(uint64_t task_id);
-
 static uint32_t lock_get_local_apic_id(void) {
     if(lock_get_local_apic_id_getter) {
         return lock_get_local_apic_id_getter();
@@ -145,10 +143,6 @@ void lock_acquire(lock_t* lock) {
 
 void lock_release(lock_t* lock) {
     if(lock) {
-        if(lock->for_future) {
-            // future_task_wait_toggler(lock->owner_task_id);
-        }
-
         lock->owner_task_id = 0;
         lock->owner_cpu_id = 0;
         lock->lock_value = 0;
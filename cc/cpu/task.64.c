@@ -28,6 +28,7 @@
 #include <hypervisor/hypervisor_vmx_macros.h>
 #include <strings.h>
 #include <spool.h>
+#include <future.h>
 
 MODULE("turnstone.kernel.cpu.task");
 
@@ -47,9 +48,6 @@ extern stdbuf_task_buffer_getter_f stdbufs_task_get_input_buffer;
 extern stdbuf_task_buffer_getter_f stdbufs_task_get_output_buffer;
 extern stdbuf_task_buffer_getter_f stdbufs_task_get_error_buffer;
 
-typedef void (*future_task_wait_toggler_f)(uint64_t task_id);
-extern future_task_wait_toggler_f future_task_wait_toggler_func;
-
 extern buffer_t* stdbufs_default_input_buffer;
 extern buffer_t* stdbufs_default_output_buffer;
 extern buffer_t* stdbufs_default_error_buffer;
@@ -381,7 +379,11 @@ int8_t task_init_tasking_ext(memory_heap_t* heap) {
     stdbufs_task_get_output_buffer = &task_get_output_buffer;
     stdbufs_task_get_error_buffer = &task_get_error_buffer;
 
-    future_task_wait_toggler_func = &task_toggle_wait_for_future;
+    future_task_id_getter_func = &task_get_id;
+    future_task_wait_begin_func = &task_set_future_waiting;
+    future_task_wait_end_func = &task_clear_future_waiting;
+    future_task_waker_func = &task_wake_future_waiter;
+    future_task_yielder_func = &task_yield;
 
     task_tasking_initialized = true;
     cpu_state->tasking_enabled = true;
@@ -688,6 +690,17 @@ task_t* task_find_next_task(void) {
             task_t* t = (task_t*)list_get_data_at_position(cpu_state->task_wait_queue, i);
 
             if(t->state == TASK_STATE_FUTURE_WAITING) {
+                // woken before it was parked, waker could not see waiting state
+                if(__atomic_exchange_n(&t->future_wake_pending, false, __ATOMIC_SEQ_CST)) {
+                    found_index = i;
+                    break;
+                }
+
+                if(t->wake_tick && t->wake_tick < time_timer_get_tick_count()) { // future wait timed out
+                    found_index = i;
+                    break;
+                }
+
                 continue;
             } else if(t->state == TASK_STATE_INTERRUPT_RECEIVED) {
                 found_index = i;
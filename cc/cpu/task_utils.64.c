@@ -411,22 +411,49 @@ void task_set_message_waiting(void){
     }
 }
 
-void task_toggle_wait_for_future(uint64_t tid) {
-    if(tid == 0 || tid == apic_get_local_apic_id() + 1) {
-        return;
+void task_set_future_waiting(uint64_t timeout_ms) {
+    task_t* current_task = task_get_current_task();
+
+    if(current_task) {
+        current_task->wake_tick = timeout_ms ? time_timer_get_tick_count() + timeout_ms : 0;
+        // pending wake is kept, a wake fired before marking resumes task at its next schedule
+        __atomic_store_n(&current_task->state, TASK_STATE_FUTURE_WAITING, __ATOMIC_SEQ_CST);
+    }
+}
+
+void task_clear_future_waiting(void) {
+    task_t* current_task = task_get_current_task();
+
+    if(current_task) {
+        current_task->state = TASK_STATE_RUNNING;
+        current_task->wake_tick = 0;
+        // caller saw its condition, wakes up to now are consumed
+        __atomic_store_n(&current_task->future_wake_pending, false, __ATOMIC_SEQ_CST);
     }
+}
 
+void task_wake_future_waiter(uint64_t tid) {
     task_t* task = (task_t*)hashmap_get(task_map, (void*)tid);
 
-    if(task) {
-        char_t buf[64] = {0};
-        itoa_with_buffer(buf, task->task_id);
-        video_text_print("task id: ");
-        video_text_print(buf);
-        video_text_print(" wait for future: ");
-        video_text_print(task->state == TASK_STATE_FUTURE_WAITING ? "true" : "false");
-        video_text_print("\n");
-
-        task->state = task->state == TASK_STATE_FUTURE_WAITING ? TASK_STATE_SUSPENDED : TASK_STATE_FUTURE_WAITING;
+    if(task == NULL) {
+        PRINTLOG(TASKING, LOG_ERROR, "future waiter task not found 0x%llx", tid);
+
+        return;
+    }
+
+    // recorded before state check, a waiter which is not parked yet finds it at scheduler
+    __atomic_store_n(&task->future_wake_pending, true, __ATOMIC_SEQ_CST);
+
+    task_state_t expected = TASK_STATE_FUTURE_WAITING;
+
+    // waiter is running, it is not parked yet or has already seen completion
+    if(!__atomic_compare_exchange_n(&task->state, &expected, TASK_STATE_SUSPENDED, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    task_t* current_task = task_get_current_task();
+
+    if(current_task && current_task->cpu_id != task->cpu_id) {
+        apic_send_ipi(task->cpu_id, 0xFE, false);
     }
 }
@@ -130,10 +130,10 @@ void ahci_handle_disk_isr(const ahci_hba_t* hba, uint64_t disk_id) {
         if(bit_test32(&finished_commands, i)) {
             // PRINTLOG(AHCI, LOG_TRACE, "command %i finished for disk %lli", i, disk_id);
 
-            if(disk->future_locks[i]) {
-                // PRINTLOG(AHCI, LOG_TRACE, "releasing future lock for command %i for disk %lli", i, disk_id);
-                lock_release(disk->future_locks[i]);
-                disk->future_locks[i] = NULL;
+            if(disk->futures[i]) {
+                // PRINTLOG(AHCI, LOG_TRACE, "signaling future for command %i for disk %lli", i, disk_id);
+                future_signal(disk->futures[i]);
+                disk->futures[i] = NULL;
             }
 
             bit_clear32(&disk->current_commands, i);
@@ -591,11 +591,9 @@ future_t* ahci_flush(uint64_t disk_id) {
     fis->control_or_command = 1;
     fis->command = AHCI_ATA_CMD_FLUSH_EXT;
 
-    uint64_t tid = task_get_id();
+    future_t* fut = future_create_with_heap_and_data(disk->heap, NULL);
 
-    disk->future_locks[slot] = lock_create_with_heap_for_future(disk->heap, true, tid);
-
-    future_t* fut = future_create_with_heap_and_data(disk->heap, disk->future_locks[slot], NULL);
+    disk->futures[slot] = fut;
 
     bit_set32(&disk->current_commands, slot);
 #pragma GCC diagnostic push
@@ -879,11 +877,9 @@ future_t* ahci_read(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t* buff
         port->sata_active = 1 << slot;
     }
 
-    uint64_t tid = task_get_id();
-
-    disk->future_locks[slot] = lock_create_with_heap_for_future(disk->heap, true, tid);
+    future_t* fut = future_create_with_heap_and_data(disk->heap, buffer);
 
-    future_t* fut = future_create_with_heap_and_data(disk->heap, disk->future_locks[slot], buffer);
+    disk->futures[slot] = fut;
 
 
     bit_set32(&disk->current_commands, slot);
@@ -997,11 +993,9 @@ future_t* ahci_write(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t* buf
         port->sata_active = 1 << slot;
     }
 
-    uint64_t tid = task_get_id();
-
-    disk->future_locks[slot] = lock_create_with_heap_for_future(disk->heap, true, tid);
+    future_t* fut = future_create_with_heap_and_data(disk->heap, buffer);
 
-    future_t* fut = future_create_with_heap_and_data(disk->heap, disk->future_locks[slot], buffer);
+    disk->futures[slot] = fut;
 
     bit_set32(&disk->current_commands, slot);
 
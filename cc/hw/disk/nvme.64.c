@@ -79,14 +79,14 @@ int8_t nvme_isr(interrupt_frame_ext_t* frame) {
             // TODO: handle error phase
             break;
         } else {
-            lock_t* lock = (lock_t*)hashmap_get(nvme_disk->command_lock_map, (void*)(uint64_t)cid);
-            hashmap_delete(nvme_disk->command_lock_map, (void*)(uint64_t)cid);
+            future_t* fut = (future_t*)hashmap_get(nvme_disk->command_future_map, (void*)(uint64_t)cid);
+            hashmap_delete(nvme_disk->command_future_map, (void*)(uint64_t)cid);
 
-            if(lock == NULL) {
+            if(fut == NULL) {
                 // TODO: handle error
             }
 
-            lock_release(lock);
+            future_signal(fut);
 
             nvme_disk->active_command_count--;
 
@@ -485,10 +485,10 @@ static int8_t nvme_init_disk(memory_heap_t* heap, uint64_t disk_id, const pci_de
         return -1;
     }
 
-    nvme_disk->command_lock_map = hashmap_integer(64);
+    nvme_disk->command_future_map = hashmap_integer(64);
 
-    if(nvme_disk->command_lock_map == NULL) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot allocate memory for nvme command lock map");
+    if(nvme_disk->command_future_map == NULL) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot allocate memory for nvme command future map");
         memory_free_ext(heap, nvme_disk);
 
         return -1;
@@ -815,26 +815,16 @@ future_t* nvme_read_write(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t
     nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw14 = 0;
     nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw15 = 0;
 
-    uint64_t tid = task_get_id();
-    lock_t* lock = lock_create_with_heap_for_future(nvme_disk->heap, true, tid);
-
-    if(lock == NULL) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot create lock for %s", write?"write":"read");
-
-        return NULL;
-    }
-
-    hashmap_put(nvme_disk->command_lock_map, (void*)(uint64_t)cid, lock);
-    future_t* fut = future_create(lock);
+    future_t* fut = future_create_with_heap_and_data(nvme_disk->heap, NULL);
 
     if(fut == NULL) {
-        hashmap_delete(nvme_disk->command_lock_map, (void*)(uint64_t)cid);
-        lock_destroy(lock);
         PRINTLOG(NVME, LOG_ERROR, "cannot create future for %s", write?"write":"read");
 
         return NULL;
     }
 
+    hashmap_put(nvme_disk->command_future_map, (void*)(uint64_t)cid, fut);
+
     nvme_disk->io_s_queue_tail = (nvme_disk->io_s_queue_tail + 1) % 64;
     *nvme_disk->io_submission_queue_tail_doorbell = nvme_disk->io_s_queue_tail;
 
@@ -889,26 +879,16 @@ future_t* nvme_flush(uint64_t disk_id) {
     nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw14 = 0;
     nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw15 = 0;
 
-    uint64_t tid = task_get_id();
-    lock_t* lock = lock_create_with_heap_for_future(nvme_disk->heap, true, tid);
-
-    if(lock == NULL) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot create lock for flush");
-
-        return NULL;
-    }
-
-
-    hashmap_put(nvme_disk->command_lock_map, (void*)(uint64_t)cid, lock);
-    future_t* fut = future_create_with_heap_and_data(nvme_disk->heap, lock, NULL);
+    future_t* fut = future_create_with_heap_and_data(nvme_disk->heap, NULL);
 
     if(fut == NULL) {
-        lock_destroy(lock);
         PRINTLOG(NVME, LOG_ERROR, "cannot create future for flush");
 
         return NULL;
     }
 
+    hashmap_put(nvme_disk->command_future_map, (void*)(uint64_t)cid, fut);
+
     nvme_disk->io_s_queue_tail = (nvme_disk->io_s_queue_tail + 1) % nvme_disk->io_queue_size;
     *nvme_disk->io_submission_queue_tail_doorbell = nvme_disk->io_s_queue_tail;
 
@@ -14,6 +14,8 @@
 #include <network.h>
 #include <network/network_ethernet.h>
 #include <network/network_dhcpv4.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
 #include <memory/frame.h>
 #include <memory/paging.h>
 #include <acpi.h>
@@ -65,26 +67,48 @@ static void network_igb_disable_interrupts(const network_igb_dev_t* dev) {
 }
 
 static void network_igb_enable_interrupts(const network_igb_dev_t* dev) {
-    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 0);
-    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 1);
-    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 2);
+    uint32_t vector_count = NETWORK_IGB_OTHER_VECTOR(dev) + 1;
+    uint32_t vectors = (1 << vector_count) - 1;
 
+    for(uint32_t i = 0; i < vector_count; i++) {
+        pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, i);
+    }
 
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_EIAC, 0x7); // dont use auto clear
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_EIMS, 0x7); // int 0, 1, 2
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_EIAC, vectors); // dont use auto clear
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_EIMS, vectors); // rx queues, tx and other
     network_igb_write_mmio(dev, NETWORK_IGB_REG_GPIE, 1 << 4); // enable multiple isr
     network_igb_write_mmio(dev, NETWORK_IGB_REG_IMS, 0xC00054);
     network_igb_read_mmio(dev, NETWORK_IGB_REG_ICR);
 }
 
+/*! routes a queue cause to an msix vector, a register holds rx and tx of queue n and n + 8 */
+static void network_igb_set_ivar(const network_igb_dev_t* dev, uint16_t queue, boolean_t tx, uint16_t vector) {
+    uint32_t reg = NETWORK_IGB_REG_IVAR + (queue & 7) * sizeof(uint32_t);
+    uint32_t shift = ((queue >> 3) * 16) + (tx ? 8 : 0);
+    uint32_t ivar = network_igb_read_mmio(dev, reg);
+
+    ivar &= ~(0xFFU << shift);
+    ivar |= (uint32_t)(vector | NETWORK_IGB_IVAR_VALID) << shift;
 
+    network_igb_write_mmio(dev, reg, ivar);
+}
+
+// tx queues are filled by protocol tasks, this task drains them in batches
 static int8_t network_igb_process_tx(void) {
 
     for(uint64_t dev_idx = 0; dev_idx < list_size(igb_net_devs); dev_idx++) {
         network_igb_dev_t* dev = (network_igb_dev_t*)list_get_data_at_position(igb_net_devs, dev_idx);
 
-        dev->return_queue = list_create_queue_with_heap(NULL);
-        task_add_message_queue(dev->return_queue);
+        network_tx_queue_t* return_queue = network_tx_queue_create(NULL, NETWORK_IGB_TX_QUEUE_SIZE);
+
+        if(return_queue == NULL) {
+            PRINTLOG(IGB, LOG_ERROR, "cannot create tx queue");
+
+            return -1;
+        }
+
+        network_tx_queue_set_consumer(return_queue, task_get_id(), &task_wake_future_waiter);
+        dev->return_queue = return_queue;
 
         void** args = memory_malloc(sizeof(void*) * 2);
 
@@ -98,59 +122,69 @@ static int8_t network_igb_process_tx(void) {
         task_create_task(NULL, 1 << 20, 64 << 10, &network_dhcpv4_send_discover, 2, args, "dhcp");
     }
 
+    network_packet_t* packets[NETWORK_IGB_TX_BUDGET];
+
     while(1) {
-        boolean_t packet_exists = 0;
+        boolean_t progress = false;
+        boolean_t pending = false;
 
         for(uint64_t dev_idx = 0; dev_idx < list_size(igb_net_devs); dev_idx++) {
             network_igb_dev_t* dev = (network_igb_dev_t*)list_get_data_at_position(igb_net_devs, dev_idx);
 
-            while(list_size(dev->return_queue)) {
-                const network_transmit_packet_t* packet = list_queue_pop(dev->return_queue);
+            network_igb_tx_ring_reap(&dev->tx);
 
-                if(packet) {
-                    PRINTLOG(NETWORK, LOG_TRACE, "network packet will be sended with length 0x%llx", packet->packet_len);
-                    packet_exists = 1;
+            uint32_t available = MIN(network_igb_tx_ring_free(&dev->tx), NETWORK_IGB_TX_BUDGET);
+            uint64_t count = network_tx_queue_pop_batch(dev->return_queue, packets, available);
 
-                    uint8_t* buffer = (uint8_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(dev->tx_desc[dev->tx_tail].address);
+            if(count) {
+                PRINTLOG(NETWORK, LOG_TRACE, "0x%llx network packets will be sended", count);
 
-                    memory_memcopy(packet->packet_data, buffer, packet->packet_len);
+                network_igb_tx_ring_fill(&dev->tx, packets, count);
 
-                    dev->tx_desc[dev->tx_tail].length = packet->packet_len;
-                    dev->tx_desc[dev->tx_tail].cmd = 3;
+                // one doorbell for whole batch
+                network_igb_write_mmio(dev, NETWORK_IGB_REG_TDT, dev->tx.tail);
 
-                    memory_free(packet->packet_data);
-                    memory_free((void*)packet);
+                progress = true;
+            }
 
-                    // update the tail so the hardware knows it's ready
-                    dev->tx_tail = (dev->tx_tail + 1) % NETWORK_IGB_NUM_TX_DESCRIPTORS;
-                    network_igb_write_mmio(dev, NETWORK_IGB_REG_TDT, dev->tx_tail);
+            if(network_tx_queue_size(dev->return_queue)) {
+                pending = true;
+            }
+        }
 
-                    dev->tx_count++;
+        if(progress) {
+            continue;
+        }
 
-                }
+        boolean_t can_wait = true;
 
-                PRINTLOG(NETWORK, LOG_TRACE, "tx queue size 0x%llx", list_size(dev->return_queue));
-            }
+        // descriptors are full, nic sends them meanwhile. otherwise producers wake task
+        for(uint64_t dev_idx = 0; dev_idx < list_size(igb_net_devs) && can_wait && !pending; dev_idx++) {
+            network_igb_dev_t* dev = (network_igb_dev_t*)list_get_data_at_position(igb_net_devs, dev_idx);
 
+            can_wait = network_tx_queue_prepare_wait(dev->return_queue);
         }
 
-        if(packet_exists == 0) {
-            task_set_message_waiting();
-            task_yield();
+        if(!can_wait) {
+            continue;
         }
 
+        // a push after prepare wait wakes task, if it comes before task is parked the wake stays pending at task
+        task_set_future_waiting(pending ? NETWORK_IGB_TX_REAP_WAIT_MS : 0);
+        task_yield();
+        task_clear_future_waiting();
     }
 
     return 0;
 }
 
-static int8_t network_igb_rx_init(network_igb_dev_t* dev) {
-    PRINTLOG(IGB, LOG_TRACE, "try to initialize rx queue");
+static int8_t network_igb_rx_queue_init(network_igb_dev_t* dev, network_igb_queue_t* queue, uint32_t desc_count) {
+    PRINTLOG(IGB, LOG_TRACE, "try to initialize rx queue %i", queue->index);
 
     frame_allocator_t* fa = frame_get_allocator();
 
-    // allocate a 10K buffer for the receive queue
-    uint64_t packet_buffer_size = NETWORK_IGB_RX_BUFFER_SIZE * NETWORK_IGB_NUM_RX_DESCRIPTORS;
+    // allocate a 10K buffer for each descriptor
+    uint64_t packet_buffer_size = NETWORK_IGB_RX_BUFFER_SIZE * desc_count;
     uint64_t packet_buffer_frm_cnt = (packet_buffer_size + FRAME_SIZE - 1)  / FRAME_SIZE;
 
     frame_t* rx_packet_buffer_frames;
@@ -169,11 +203,8 @@ static int8_t network_igb_rx_init(network_igb_dev_t* dev) {
 
     memory_memset((void*)rx_packet_buffer_va, 0, packet_buffer_size);
 
-    dev->rx_packet_buffer_fa = rx_packet_buffer_fa;
-    dev->rx_packet_buffer_va = rx_packet_buffer_va;
-
-    // allocate a 256 byte buffer for the receive queue headers
-    uint64_t header_buffer_size = NETWORK_IGB_RX_HEADER_SIZE * NETWORK_IGB_NUM_RX_DESCRIPTORS;
+    // allocate a 256 byte buffer for each descriptor's headers
+    uint64_t header_buffer_size = NETWORK_IGB_RX_HEADER_SIZE * desc_count;
     uint64_t header_buffer_frm_cnt = (header_buffer_size + FRAME_SIZE - 1)  / FRAME_SIZE;
 
     frame_t* rx_header_buffer_frames;
@@ -192,11 +223,8 @@ static int8_t network_igb_rx_init(network_igb_dev_t* dev) {
 
     memory_memset((void*)rx_header_buffer_va, 0, header_buffer_size);
 
-    dev->rx_header_buffer_fa = rx_header_buffer_fa;
-    dev->rx_header_buffer_va = rx_header_buffer_va;
-
-    // allocate a 16 byte buffer for the receive queue meta data
-    uint64_t queue_meta_frm_cnt = ((sizeof(network_igb_rx_desc_t) * NETWORK_IGB_NUM_RX_DESCRIPTORS)  + FRAME_SIZE - 1 ) / FRAME_SIZE;
+    // allocate 16 byte descriptors
+    uint64_t queue_meta_frm_cnt = ((sizeof(network_igb_rx_desc_t) * desc_count)  + FRAME_SIZE - 1 ) / FRAME_SIZE;
 
     frame_t* queue_meta_frames;
 
@@ -213,45 +241,98 @@ static int8_t network_igb_rx_init(network_igb_dev_t* dev) {
     uint64_t queue_meta_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_meta_frames->frame_address);
     memory_paging_add_va_for_frame(queue_meta_va, queue_meta_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
 
-    memory_memset((void*)queue_meta_va, 0, sizeof(network_igb_rx_desc_t) * NETWORK_IGB_NUM_RX_DESCRIPTORS);
+    memory_memset((void*)queue_meta_va, 0, sizeof(network_igb_rx_desc_t) * desc_count);
+
+    network_igb_rx_ring_t* ring = &queue->rx;
+
+    ring->desc = (network_igb_rx_desc_t*)queue_meta_va;
+    ring->packet_buffer_fa = rx_packet_buffer_fa;
+    ring->packet_buffer_va = rx_packet_buffer_va;
+    ring->header_buffer_fa = rx_header_buffer_fa;
+    ring->buffer_size = NETWORK_IGB_RX_BUFFER_SIZE;
+    ring->count = desc_count;
+    ring->pool = dev->rx_pool;
+    ring->network_info = (void*)dev->mac;
+
+    uint16_t q = queue->index;
 
     // this should be first
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_SRRCTL, 0x600040A); // 10K packet buffer, 256 byte header format, type 2
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_SRRCTL, q), 0x600040A); // 10K packet buffer, 256 byte header format, type 2
 
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_RDBAL, queue_meta_fa & 0xFFFFFFFF);
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_RDBAH, (queue_meta_fa >> 32) & 0xFFFFFFFF);
-    dev->rx_desc = (network_igb_rx_desc_t*)queue_meta_va;
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RDBAL, q), queue_meta_fa & 0xFFFFFFFF);
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RDBAH, q), (queue_meta_fa >> 32) & 0xFFFFFFFF);
 
     PRINTLOG(IGB, LOG_TRACE, "filling rx queue at 0x%llx", queue_meta_va);
 
-    for(int32_t i = 0; i < NETWORK_IGB_NUM_RX_DESCRIPTORS; i++ ) {
-        dev->rx_desc[i].read.pkt_addr = (rx_packet_buffer_fa + i * NETWORK_IGB_RX_BUFFER_SIZE); // | 0x1; // set the LSB to 1
-        dev->rx_desc[i].read.hdr_addr = (rx_header_buffer_fa + i * NETWORK_IGB_RX_HEADER_SIZE); // | 0x1; // set the LSB to 1
+    for(uint32_t i = 0; i < desc_count; i++ ) {
+        ring->desc[i].read.pkt_addr = (rx_packet_buffer_fa + i * NETWORK_IGB_RX_BUFFER_SIZE);
+        ring->desc[i].read.hdr_addr = (rx_header_buffer_fa + i * NETWORK_IGB_RX_HEADER_SIZE);
     }
 
-    // receive buffer length; NETWORK_IGB_NUM_RX_DESCRIPTORS 16-byte descriptors
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_RDLEN, (uint32_t)(NETWORK_IGB_NUM_RX_DESCRIPTORS * sizeof(network_igb_rx_desc_t)));
-
-    // setup head and tail pointers
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_RDH, 0);
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_RDT, NETWORK_IGB_NUM_RX_DESCRIPTORS - 1);
-    dev->rx_tail = NETWORK_IGB_NUM_RX_DESCRIPTORS - 1;
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RDLEN, q), (uint32_t)(desc_count * sizeof(network_igb_rx_desc_t)));
 
+    // last descriptor is held back, nic fills from head up to tail
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RDH, q), 0);
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RDT, q), desc_count - 1);
+    ring->next = 0;
 
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_RXDCTL, network_igb_read_mmio(dev, NETWORK_IGB_REG_RXDCTL) |
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RXDCTL, q), network_igb_read_mmio(dev, NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RXDCTL, q)) |
                            NETWORK_IGB_RXDCTL_ENABLE);
 
+    return 0;
+}
+
+static void network_igb_rss_init(network_igb_dev_t* dev) {
+    for(uint32_t i = 0; i < NETWORK_RSS_KEY_SIZE / sizeof(uint32_t); i++) {
+        const uint8_t* key = network_rss_default_key + i * sizeof(uint32_t);
+
+        network_igb_write_mmio(dev, NETWORK_IGB_REG_RSSRK + i * sizeof(uint32_t), key[0] | (key[1] << 8) | (key[2] << 16) | ((uint32_t)key[3] << 24));
+    }
+
+    network_rss_fill_reta(dev->reta, NETWORK_RSS_RETA_SIZE, dev->rx_queue_count);
+
+    // each register holds four entries
+    for(uint32_t i = 0; i < NETWORK_RSS_RETA_SIZE; i += 4) {
+        network_igb_write_mmio(dev, NETWORK_IGB_REG_RETA + i, dev->reta[i] | (dev->reta[i + 1] << 8) | (dev->reta[i + 2] << 16) | ((uint32_t)dev->reta[i + 3] << 24));
+    }
+
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_MRQC, NETWORK_IGB_MRQC_ENABLE_RSS | NETWORK_IGB_MRQC_RSS_FIELD_IPV4 |
+                           NETWORK_IGB_MRQC_RSS_FIELD_IPV4_TCP | NETWORK_IGB_MRQC_RSS_FIELD_IPV4_UDP);
+}
+
+static int8_t network_igb_rx_init(network_igb_dev_t* dev) {
+    uint32_t desc_count = NETWORK_IGB_NUM_RX_DESCRIPTORS / dev->rx_queue_count;
+
+    for(uint32_t i = 0; i < dev->rx_queue_count; i++) {
+        network_igb_queue_t* queue = &dev->rx_queues[i];
+
+        queue->dev = dev;
+        queue->index = i;
+        queue->msix_vector = i;
+
+        if(network_igb_rx_queue_init(dev, queue, desc_count) != 0) {
+            return -1;
+        }
+    }
+
+    if(dev->rx_queue_count > 1) {
+        network_igb_rss_init(dev);
+    }
+
+    // nic verifies ipv4, tcp and udp checksums, results are reported at descriptor status. rss hash replaces packet checksum at descriptor
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_RXCSUM, network_igb_read_mmio(dev, NETWORK_IGB_REG_RXCSUM) |
+                           NETWORK_IGB_RXCSUM_IPOFLD | NETWORK_IGB_RXCSUM_TUOFLD | NETWORK_IGB_RXCSUM_PCSD);
+
     // set the receieve control register (promisc ON, 8K pkt size)
     network_igb_write_mmio(dev, NETWORK_IGB_REG_RCTL, NETWORK_IGB_RCTL_LPE | NETWORK_IGB_RCTL_BAM);
 
-    PRINTLOG(IGB, LOG_TRACE, "rx queue initialized");
+    PRINTLOG(IGB, LOG_TRACE, "%i rx queues initialized", dev->rx_queue_count);
 
     return 0;
-
 }
 
 static int8_t network_igb_tx_init(network_igb_dev_t* dev) {
-    uint64_t queue_size = (8192 + 16) * NETWORK_IGB_NUM_TX_DESCRIPTORS;
+    uint64_t queue_size = (uint64_t)NETWORK_IGB_TX_BUFFER_SIZE * NETWORK_IGB_NUM_TX_DESCRIPTORS;
 
     uint64_t queue_frm_cnt = (queue_size + FRAME_SIZE - 1)  / FRAME_SIZE;
     uint64_t queue_meta_frm_cnt = ((sizeof(network_igb_rx_desc_t) * NETWORK_IGB_NUM_TX_DESCRIPTORS)  + FRAME_SIZE - 1 ) / FRAME_SIZE;
@@ -282,22 +363,30 @@ static int8_t network_igb_tx_init(network_igb_dev_t* dev) {
 
     network_igb_write_mmio(dev, NETWORK_IGB_REG_TDBAL, queue_meta_fa & 0xFFFFFFFF);
     network_igb_write_mmio(dev, NETWORK_IGB_REG_TDBAH, (queue_meta_fa >> 32) & 0xFFFFFFFF);
-    dev->tx_desc = (network_igb_tx_desc_t*)queue_meta_va;
+
+    network_igb_tx_ring_t* ring = &dev->tx;
+
+    ring->desc = (network_igb_tx_desc_t*)queue_meta_va;
+    ring->buffer_va = queue_va;
+    ring->buffer_size = NETWORK_IGB_TX_BUFFER_SIZE;
+    ring->count = NETWORK_IGB_NUM_TX_DESCRIPTORS;
 
     PRINTLOG(IGB, LOG_TRACE, "filling tx queue at 0x%llx", queue_meta_va);
 
     for(int32_t i = 0; i < NETWORK_IGB_NUM_TX_DESCRIPTORS; i++ ) {
-        dev->tx_desc[i].address = queue_fa + i * (8192 + 16);
-        dev->tx_desc[i].cmd = 0;
+        ring->desc[i].address = queue_fa + i * NETWORK_IGB_TX_BUFFER_SIZE;
+        ring->desc[i].cmd = 0;
+        ring->desc[i].status = 0;
     }
 
     // receive buffer length; NETWORK_IGB_NUM_RX_DESCRIPTORS 16-byte descriptors
     network_igb_write_mmio(dev, NETWORK_IGB_REG_TDLEN, (uint32_t)(NETWORK_IGB_NUM_TX_DESCRIPTORS * 16));
 
-    // setup head and tail pointers
+    // head equals tail, ring is empty until first batch
     network_igb_write_mmio(dev, NETWORK_IGB_REG_TDH, 0);
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_TDT, NETWORK_IGB_NUM_TX_DESCRIPTORS - 1);
-    dev->tx_tail = 0;
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_TDT, 0);
+    ring->tail = 0;
+    ring->clean = 0;
 
     network_igb_write_mmio(dev, NETWORK_IGB_REG_TXDCTL, network_igb_read_mmio(dev, NETWORK_IGB_REG_TXDCTL) |
                            NETWORK_IGB_TXDCTL_ENABLE);
@@ -314,132 +403,87 @@ extern uint64_t network_rx_task_id;
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-// This can be used stand-alone or from an interrupt handler
+static void network_igb_rx_deliver(network_packet_t* packets) {
+    boolean_t queued = false;
+
+    while(packets) {
+        network_packet_t* packet = packets;
+        packets = packet->next;
+        packet->next = NULL;
+
+        if(list_queue_push(network_received_packets, packet) == -1ULL) {
+            PRINTLOG(IGB, LOG_ERROR, "failed to queue packet");
+            network_packet_release(packet);
+        } else {
+            queued = true;
+        }
+    }
+
+    // network task is woken once for a batch
+    if(queued && network_rx_task_id) {
+        task_set_message_received(network_rx_task_id);
+    }
+}
+
+// each rx queue has a task, its interrupt is routed to cpu of task
 static int32_t network_igb_process_rx(uint64_t args_cnt, void** args) {
     if(args_cnt != 1) {
         PRINTLOG(IGB, LOG_ERROR, "invalid args count");
         return -1;
     }
 
-    network_igb_dev_t* dev = (network_igb_dev_t*)args[0];
+    network_igb_queue_t* queue = (network_igb_queue_t*)args[0];
 
-    if(!dev) {
-        PRINTLOG(IGB, LOG_ERROR, "invalid dev");
+    if(!queue || !queue->dev) {
+        PRINTLOG(IGB, LOG_ERROR, "invalid queue");
         return -1;
     }
 
+    const network_igb_dev_t* dev = queue->dev;
+    uint32_t queue_rdt = NETWORK_IGB_REG_QUEUE(NETWORK_IGB_REG_RDT, queue->index);
 
     cpu_cli();
-    pci_msix_update_lapic((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 0);
-    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 0);
+    pci_msix_update_lapic((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, queue->msix_vector);
+    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, queue->msix_vector);
     task_set_interruptible();
     cpu_sti();
 
-    while(true) {
-        boolean_t notify_network_rx = true;
+    PRINTLOG(IGB, LOG_INFO, "rx queue %i runs on cpu 0x%llx", queue->index, task_get_cpu_id());
 
+    while(true) {
         if(network_received_packets != NULL && dev->return_queue != NULL) {
+            // tx queue is created by tx task after rx tasks start
+            queue->rx.return_queue = dev->return_queue;
 
-            while(true) {
-                // advance the tail pointer
-                ((network_igb_dev_t*)dev)->rx_tail = (dev->rx_tail + 1) % NETWORK_IGB_NUM_RX_DESCRIPTORS;
-                // check if the next descriptor is ready
-                uint32_t status_error = dev->rx_desc[dev->rx_tail].wb.upper.status_error;
-                // first 20bits are status, last 12 bits are error
-                uint32_t status = status_error & 0xFFFFF;
-                uint32_t error = status_error >> 20;
-
-                PRINTLOG(IGB, LOG_TRACE, "rx status 0x%x error 0x%x", status, error);
-
-                if( !(status & 1) ) { // descriptor is not ready
-                    ((network_igb_dev_t*)dev)->rx_tail = (dev->rx_tail - 1) % NETWORK_IGB_NUM_RX_DESCRIPTORS;
-                    PRINTLOG(IGB, LOG_TRACE, "rx descriptor is not ready");
-                    break;
-                }
-
-                // we get packet address with calculated offset
-                uint8_t* pkt = (uint8_t*)(dev->rx_packet_buffer_va + dev->rx_tail * NETWORK_IGB_RX_BUFFER_SIZE);
-                uint16_t pktlen = dev->rx_desc[dev->rx_tail].wb.upper.length;
-                boolean_t dropflag = 0;
-
-                if( pktlen < 60 ) {
-                    dropflag = 1;
-                }
-
-                if(error) {
-                    PRINTLOG(IGB, LOG_WARNING, "device has rx errors 0x%x", error);
-
-                    dropflag = 1;
-                }
-
-                if( !dropflag ) {
-                    // send the packet to higher layers for parsing
-                    PRINTLOG(IGB, LOG_TRACE, "packet received with len 0x%x", pktlen);
-
-                    pkt = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(pkt);
-
-                    network_received_packet_t* packet = memory_malloc_ext(list_get_heap(network_received_packets), sizeof(network_received_packet_t), 0);
-
-                    if(packet == NULL) {
-                        PRINTLOG(IGB, LOG_ERROR, "failed to allocate packet");
-                        notify_network_rx = true;
-
-                        task_yield();
-
-                        continue;
-                    }
-
-                    packet->packet_len = pktlen;
-                    packet->return_queue = dev->return_queue;
-                    packet->network_info = (void*)dev->mac;
-                    packet->network_type = NETWORK_TYPE_ETHERNET;
-
-                    packet->packet_data = memory_malloc_ext(list_get_heap(network_received_packets), pktlen, 0);
-
-                    if(packet->packet_data == NULL) {
-                        PRINTLOG(IGB, LOG_ERROR, "failed to allocate packet");
-                        memory_free_ext(list_get_heap(network_received_packets), packet);
-                        notify_network_rx = true;
-
-                        task_yield();
-
-                        continue;
-                    }
-
-                    memory_memcopy(pkt, packet->packet_data, pktlen);
-
-                    if(list_queue_push(network_received_packets, packet) == -1ULL) {
-                        PRINTLOG(IGB, LOG_ERROR, "failed to queue packet");
-                        memory_free_ext(list_get_heap(network_received_packets), packet->packet_data);
-                        memory_free_ext(list_get_heap(network_received_packets), packet);
-                    } else {
-                        PRINTLOG(IGB, LOG_TRACE, "packet queued");
-
-                        if(notify_network_rx && network_rx_task_id) {
-                            task_set_message_received(network_rx_task_id);
-                            PRINTLOG(IGB, LOG_TRACE, "cleared message waiting for rx task 0x%llx", network_rx_task_id);
-                            notify_network_rx = false;
-                        }
-                    }
+            network_packet_t* packets = NULL;
+            uint32_t cleaned = network_igb_rx_ring_poll(&queue->rx, NETWORK_IGB_RX_BUDGET, &packets);
 
+            if(cleaned) {
+                network_igb_write_mmio(dev, queue_rdt, network_igb_rx_ring_tail(&queue->rx));
+                network_igb_rx_deliver(packets);
+            }
 
-                }
+            uint8_t actions = network_igb_moderation_update(&queue->moderation, cleaned, NETWORK_IGB_RX_BUDGET);
 
-                // restore the descriptor's packet and header addresses
-                dev->rx_desc[dev->rx_tail].read.pkt_addr = dev->rx_packet_buffer_fa + dev->rx_tail * NETWORK_IGB_RX_BUFFER_SIZE;
-                dev->rx_desc[dev->rx_tail].read.hdr_addr = dev->rx_header_buffer_fa + dev->rx_tail * NETWORK_IGB_RX_HEADER_SIZE;
+            if(actions & NETWORK_IGB_MODERATION_MASK) {
+                network_igb_write_mmio(dev, NETWORK_IGB_REG_EIMC, 1 << queue->msix_vector);
+            }
 
-                // update RX counts and the tail pointer
-                ((network_igb_dev_t*)dev)->rx_count++;
+            if(actions & NETWORK_IGB_MODERATION_ITR) {
+                network_igb_write_mmio(dev, NETWORK_IGB_REG_EITR + queue->msix_vector * sizeof(uint32_t),
+                                       (queue->moderation.itr << 2) & NETWORK_IGB_EITR_INTERVAL_MASK);
+            }
 
-                // write the tail to the device
-                network_igb_write_mmio(dev, NETWORK_IGB_REG_RDT, dev->rx_tail);
-                PRINTLOG(IGB, LOG_TRACE, "rx tail 0x%x", dev->rx_tail);
+            if(actions & NETWORK_IGB_MODERATION_UNMASK) {
+                network_igb_write_mmio(dev, NETWORK_IGB_REG_EIMS, 1 << queue->msix_vector);
             }
 
-            PRINTLOG(IGB, LOG_TRACE, "rx queue size 0x%llx", list_size(network_received_packets));
-            pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 0);
+            if(queue->moderation.polling) {
+                // poll mode, task runs again without waiting an interrupt
+                task_yield();
 
+                continue;
+            }
         }
 
         task_set_message_waiting();
@@ -476,7 +520,7 @@ static int8_t network_igb_other_isr(interrupt_frame_ext_t* frame)  {
     video_text_print(" isr 0x");
     video_text_print(buffer2);
 
-    boolean_t is_other = eicr & (1 << 2);
+    boolean_t is_other = eicr & (1 << NETWORK_IGB_OTHER_VECTOR(dev));
 
     if(!is_other) {
         video_text_print(" not other");
@@ -488,11 +532,11 @@ static int8_t network_igb_other_isr(interrupt_frame_ext_t* frame)  {
     // never clear 0. and 7. bit set them 0 on isr
     isr &= ~(1 << 0);
     isr &= ~(1 << 7);
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_EICR, 1 << 2);
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_EICR, 1 << NETWORK_IGB_OTHER_VECTOR(dev));
     network_igb_write_mmio(dev, NETWORK_IGB_REG_ICR, isr);
 
 
-    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 2);
+    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, NETWORK_IGB_OTHER_VECTOR(dev));
 
     apic_eoi();
     return 0;
@@ -522,7 +566,7 @@ static int8_t network_igb_tx_isr(interrupt_frame_ext_t* frame)  {
     video_text_print(" isr 0x");
     video_text_print(buffer2);
 
-    boolean_t is_tx = eicr & (1 << 1);
+    boolean_t is_tx = eicr & (1 << NETWORK_IGB_TX_VECTOR(dev));
 
     if(!is_tx) {
         video_text_print(" not tx");
@@ -531,69 +575,48 @@ static int8_t network_igb_tx_isr(interrupt_frame_ext_t* frame)  {
     video_text_print("\n");
 
     // clearing the pending interrupts
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_EICR, 1 << 1);
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_EICR, 1 << NETWORK_IGB_TX_VECTOR(dev));
     network_igb_write_mmio(dev, NETWORK_IGB_REG_ICR, 1 << 0); // clear tx isr
 
 
-    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 1);
+    pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, NETWORK_IGB_TX_VECTOR(dev));
 
     apic_eoi();
     return 0;
 }
 
 static int8_t network_igb_rx_isr(interrupt_frame_ext_t* frame)  {
-    UNUSED(frame);
-
-    const network_igb_dev_t* dev = NULL;
-
     uint8_t rx_isr = frame->interrupt_number - INTERRUPT_IRQ_BASE;
+    const network_igb_dev_t* dev = NULL;
+    const network_igb_queue_t* queue = NULL;
 
-    for(uint64_t i = 0; i < list_size(igb_net_devs); i++) {
+    for(uint64_t i = 0; i < list_size(igb_net_devs) && !queue; i++) {
         dev = list_get_data_at_position(igb_net_devs, i);
 
-        if(dev->rx_isr == rx_isr) {
-            break;
-        }
-    }
+        for(uint32_t q = 0; q < dev->rx_queue_count; q++) {
+            if(dev->rx_queues[q].isr == rx_isr) {
+                queue = &dev->rx_queues[q];
 
-    if(!dev) {
-        video_text_print("no dev\n");
-        return -1;
+                break;
+            }
+        }
     }
 
-    uint32_t eicr = network_igb_read_mmio(dev, NETWORK_IGB_REG_EICR);
-    uint32_t isr = network_igb_read_mmio(dev, NETWORK_IGB_REG_ICR);
-
-    char_t buffer1[64] = {0};
-    char_t buffer2[64] = {0};
-
-    utoh_with_buffer(buffer1, eicr);
-    utoh_with_buffer(buffer2, isr);
-
-    boolean_t is_rx = eicr & (1 << 0);
-
-    video_text_print("rx isr eicr 0x");
-    video_text_print(buffer1);
-    video_text_print(" isr 0x");
-    video_text_print(buffer2);
+    if(!queue) {
+        PRINTLOG(IGB, LOG_ERROR, "no rx queue for interrupt 0x%x", rx_isr);
+        apic_eoi();
 
-    if(!is_rx) {
-        video_text_print(" not rx");
+        return -1;
     }
 
-    video_text_print("\n");
-
-    if(dev->rx_task_id) {
-        task_set_interrupt_received(dev->rx_task_id);
+    if(queue->task_id) {
+        task_set_interrupt_received(queue->task_id);
     }
 
     // clearing the pending interrupts
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_EICR, 1 << 0);
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_EICR, 1 << queue->msix_vector);
     network_igb_write_mmio(dev, NETWORK_IGB_REG_ICR, 1 << 7); // clear rx isr
 
-
-    // pci_msix_clear_pending_bit((pci_generic_device_t*)dev->pci_netdev->pci_header, dev->msix_cap, 0);
-
     apic_eoi();
 
     return 0;
@@ -623,10 +646,6 @@ int8_t network_igb_init(const pci_dev_t* pci_netdev) {
 
     dev->pci_netdev = pci_netdev; // pci structure
 
-    dev->rx_count = 0;
-    dev->tx_count = 0;
-    dev->packets_dropped = 0;
-
     pci_generic_device_t* pci_dev = (pci_generic_device_t*)pci_header;
 
 
@@ -743,6 +762,36 @@ int8_t network_igb_init(const pci_dev_t* pci_netdev) {
         network_igb_write_mmio(dev, NETWORK_IGB_REG_MTA + i * 4, 0);
     }
 
+    dev->rx_pool = network_packet_pool_create(NULL, NETWORK_IGB_RX_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    if(dev->rx_pool == NULL) {
+        PRINTLOG(IGB, LOG_ERROR, "cannot create rx packet pool");
+        memory_free(dev);
+
+        return -1;
+    }
+
+    // a queue per cpu, tx and other causes take two more vectors, rss needs power of two queues
+    uint32_t queue_limit = MIN(apic_get_ap_count() + 1, NETWORK_IGB_MAX_RX_QUEUES);
+    uint32_t vector_count = dev->msix_cap->table_size + 1;
+
+    if(vector_count < 3) {
+        PRINTLOG(IGB, LOG_ERROR, "not enough msix vectors %i", vector_count);
+        memory_free(dev);
+
+        return -1;
+    }
+
+    queue_limit = MIN(queue_limit, vector_count - 2);
+
+    dev->rx_queue_count = 1;
+
+    while(dev->rx_queue_count * 2 <= queue_limit) {
+        dev->rx_queue_count *= 2;
+    }
+
+    PRINTLOG(IGB, LOG_INFO, "using %i rx queues", dev->rx_queue_count);
+
     // start the RX/TX processes
     if(network_igb_rx_init(dev) != 0) {
         PRINTLOG(IGB, LOG_ERROR, "cannot initialize rx queue");
@@ -758,13 +807,21 @@ int8_t network_igb_init(const pci_dev_t* pci_netdev) {
         return -1;
     }
 
+#if NETWORK_IGB_TX_CHECKSUM_OFFLOAD
+    network_info_set_tx_checksum_offload(&dev->mac, true);
+#endif
+
     // register the interrupt handler
-    dev->rx_isr = pci_msix_set_isr(pci_dev, dev->msix_cap, 0, &network_igb_rx_isr);
-    dev->tx_isr = pci_msix_set_isr(pci_dev, dev->msix_cap, 1, &network_igb_tx_isr);
-    dev->other_isr = pci_msix_set_isr(pci_dev, dev->msix_cap, 2, &network_igb_other_isr);
+    for(uint32_t q = 0; q < dev->rx_queue_count; q++) {
+        dev->rx_queues[q].isr = pci_msix_set_isr(pci_dev, dev->msix_cap, dev->rx_queues[q].msix_vector, &network_igb_rx_isr);
+        network_igb_set_ivar(dev, q, false, dev->rx_queues[q].msix_vector);
+    }
+
+    dev->tx_isr = pci_msix_set_isr(pci_dev, dev->msix_cap, NETWORK_IGB_TX_VECTOR(dev), &network_igb_tx_isr);
+    dev->other_isr = pci_msix_set_isr(pci_dev, dev->msix_cap, NETWORK_IGB_OTHER_VECTOR(dev), &network_igb_other_isr);
 
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_IVAR, 0x8180);
-    network_igb_write_mmio(dev, NETWORK_IGB_REG_IVAR_MISC, 0x8200);
+    network_igb_set_ivar(dev, 0, true, NETWORK_IGB_TX_VECTOR(dev));
+    network_igb_write_mmio(dev, NETWORK_IGB_REG_IVAR_MISC, (NETWORK_IGB_OTHER_VECTOR(dev) | NETWORK_IGB_IVAR_VALID) << 8);
 
     network_igb_write_mmio(dev, NETWORK_IGB_REG_VLAN_ETHER_TYPE, 0x8100);
 
@@ -780,19 +837,20 @@ int8_t network_igb_init(const pci_dev_t* pci_netdev) {
 
     network_igb_write_mmio(dev, NETWORK_IGB_REG_RCTL, network_igb_read_mmio(dev, NETWORK_IGB_REG_RCTL) | NETWORK_IGB_RCTL_EN);
 
-    void** rx_args = memory_malloc(sizeof(void*) * 1);
+    // task scheduler places each rx task on least loaded cpu, task binds its vector to that cpu
+    for(uint32_t q = 0; q < dev->rx_queue_count; q++) {
+        void** rx_args = memory_malloc(sizeof(void*) * 1);
 
-    if(rx_args == NULL) {
-        PRINTLOG(IGB, LOG_ERROR, "cannot allocate memory for rx task args");
-
-        return -1;
-    }
+        if(rx_args == NULL) {
+            PRINTLOG(IGB, LOG_ERROR, "cannot allocate memory for rx task args");
 
-    rx_args[0] = (void*)dev;
+            return -1;
+        }
 
-    uint64_t rx_task_id = task_create_task(NULL, 2 << 20, 64 << 10, &network_igb_process_rx, 1, rx_args, "igb rx");
-    dev->rx_task_id = rx_task_id;
+        rx_args[0] = (void*)&dev->rx_queues[q];
 
+        dev->rx_queues[q].task_id = task_create_task(NULL, 2 << 20, 64 << 10, &network_igb_process_rx, 1, rx_args, "igb rx");
+    }
 
     task_create_task(NULL, 2 << 20, 64 << 10, &network_igb_process_tx, 0, NULL, "igb tx");
 
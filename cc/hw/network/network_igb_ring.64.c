@@ -0,0 +1,233 @@
+/**
+ * @file network_igb_ring.64.c
+ * @brief igb rx and tx ring batching and interrupt moderation.
+ *
+ * Ring logic only touches descriptors and buffers, register writes are left to driver. A poll cleans up to
+ * budget descriptors and driver moves tail once for all of them, tx fills a batch the same way and reaps
+ * sent descriptors in bulk.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <driver/network_igb.h>
+#include <network/network_checksum.h>
+#include <memory.h>
+#include <logging.h>
+#include <utils.h>
+
+MODULE("turnstone.kernel.hw.network.igb");
+
+/*! smallest frame nic delivers, shorter frames are runts */
+#define NETWORK_IGB_RX_MIN_FRAME_SIZE 60
+
+uint32_t network_igb_rx_ring_poll(network_igb_rx_ring_t* ring, uint32_t budget, network_packet_t** packets) {
+    network_packet_t* head = NULL;
+    network_packet_t** tail = &head;
+    uint32_t mask = ring->count - 1;
+    uint32_t cleaned = 0;
+
+    while(cleaned < budget) {
+        uint32_t idx = ring->next;
+        volatile network_igb_rx_desc_t* desc = &ring->desc[idx];
+        // first 20 bits are status, last 12 bits are error
+        uint32_t status_error = desc->wb.upper.status_error;
+        uint32_t status = status_error & 0xFFFFF;
+        uint32_t error = status_error >> 20;
+
+        if(!(status & NETWORK_IGB_RXD_STATUS_DD)) {
+            break;
+        }
+
+        // descriptor fields are read after done bit
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        uint16_t length = desc->wb.upper.length;
+
+        if(error) {
+            PRINTLOG(IGB, LOG_TRACE, "rx descriptor 0x%x has errors 0x%x", idx, error);
+            ring->errors++;
+        } else if(length < NETWORK_IGB_RX_MIN_FRAME_SIZE || length > ring->buffer_size) {
+            ring->dropped++;
+        } else {
+            // frame is copied once from dma buffer into a pool packet, layers above work on it in place
+            network_packet_t* packet = network_packet_alloc(ring->pool, length);
+            uint8_t* data = network_packet_put(packet, length);
+
+            if(data == NULL) {
+                network_packet_release(packet);
+                ring->dropped++;
+            } else {
+                memory_memcopy((uint8_t*)(ring->packet_buffer_va + (uint64_t)idx * ring->buffer_size), data, length);
+
+                packet->return_queue = ring->return_queue;
+                packet->network_info = ring->network_info;
+                packet->network_type = NETWORK_TYPE_ETHERNET;
+
+                // frames with checksum errors are dropped above, so checked means verified
+                if(status & NETWORK_IGB_RXD_STATUS_IPCS) {
+                    packet->checksum_flags |= NETWORK_PACKET_CHECKSUM_IPV4_VERIFIED;
+                }
+
+                if(status & NETWORK_IGB_RXD_STATUS_L4I) {
+                    packet->checksum_flags |= NETWORK_PACKET_CHECKSUM_L4_VERIFIED;
+                }
+
+                *tail = packet;
+                tail = &packet->next;
+                ring->packets++;
+            }
+        }
+
+        // refill also clears done bit, write back overlaps read addresses
+        desc->read.pkt_addr = ring->packet_buffer_fa + (uint64_t)idx * ring->buffer_size;
+        desc->read.hdr_addr = ring->header_buffer_fa + (uint64_t)idx * NETWORK_IGB_RX_HEADER_SIZE;
+
+        ring->next = (idx + 1) & mask;
+        cleaned++;
+    }
+
+    if(cleaned) {
+        // refilled descriptors are visible before tail moves
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        ring->polls++;
+    }
+
+    *packets = head;
+
+    return cleaned;
+}
+
+uint32_t network_igb_rx_ring_tail(const network_igb_rx_ring_t* ring) {
+    return (ring->next - 1) & (ring->count - 1);
+}
+
+uint8_t network_igb_moderation_update(network_igb_moderation_t* moderation, uint32_t cleaned, uint32_t budget) {
+    uint8_t actions = 0;
+
+    if(moderation->polling) {
+        if(cleaned * 4 < budget) {
+            moderation->light_polls++;
+        } else {
+            moderation->light_polls = 0;
+        }
+
+        if(moderation->light_polls >= NETWORK_IGB_POLL_EXIT_POLLS) {
+            moderation->polling = false;
+            moderation->light_polls = 0;
+            actions |= NETWORK_IGB_MODERATION_UNMASK;
+        }
+    } else if(cleaned >= budget) {
+        // ring fills faster than interrupts are served
+        moderation->polling = true;
+        moderation->light_polls = 0;
+
+        return NETWORK_IGB_MODERATION_MASK;
+    }
+
+    if(moderation->polling) {
+        return actions;
+    }
+
+    uint32_t itr = NETWORK_IGB_ITR_BULK;
+
+    if(cleaned <= 4) {
+        itr = NETWORK_IGB_ITR_LOWEST_LATENCY;
+    } else if(cleaned * 2 <= budget) {
+        itr = NETWORK_IGB_ITR_LOW_LATENCY;
+    }
+
+    if(itr != moderation->itr) {
+        moderation->itr = itr;
+        actions |= NETWORK_IGB_MODERATION_ITR;
+    }
+
+    return actions;
+}
+
+uint32_t network_igb_tx_ring_reap(network_igb_tx_ring_t* ring) {
+    uint32_t mask = ring->count - 1;
+    uint32_t reaped = 0;
+
+    // every descriptor reports status, nic completes them in order
+    while(ring->clean != ring->tail && (ring->desc[ring->clean].status & NETWORK_IGB_TXD_STATUS_DD)) {
+        ring->desc[ring->clean].status = 0;
+        ring->clean = (ring->clean + 1) & mask;
+        reaped++;
+    }
+
+    if(reaped) {
+        // buffers are rewritten after nic has read them
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        ring->reaped += reaped;
+    }
+
+    return reaped;
+}
+
+uint32_t network_igb_tx_ring_free(const network_igb_tx_ring_t* ring) {
+    return ring->count - 1 - ((ring->tail - ring->clean) & (ring->count - 1));
+}
+
+uint32_t network_igb_tx_ring_fill(network_igb_tx_ring_t* ring, network_packet_t** packets, uint32_t count) {
+    uint32_t mask = ring->count - 1;
+    uint32_t available = network_igb_tx_ring_free(ring);
+    uint32_t consumed = 0;
+    uint32_t filled = 0;
+
+    for(; consumed < count; consumed++) {
+        network_packet_t* packet = packets[consumed];
+
+        if(packet->length > ring->buffer_size) {
+            PRINTLOG(IGB, LOG_ERROR, "tx packet length 0x%x exceeds buffer", packet->length);
+            network_packet_release(packet);
+            ring->dropped++;
+
+            continue;
+        }
+
+        if(filled == available) {
+            break;
+        }
+
+        uint32_t idx = ring->tail;
+        volatile network_igb_tx_desc_t* desc = &ring->desc[idx];
+        uint8_t cmd = NETWORK_IGB_TXD_CMD_EOP | NETWORK_IGB_TXD_CMD_IFCS | NETWORK_IGB_TXD_CMD_RS;
+        uint8_t css = 0;
+        uint8_t cso = 0;
+
+        if(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_OFFLOAD) {
+#if NETWORK_IGB_TX_CHECKSUM_OFFLOAD
+            // nic sums from css to end of frame and stores result at cso
+            css = packet->checksum_start - packet->offset;
+            cso = css + packet->checksum_field;
+            cmd |= NETWORK_IGB_TXD_CMD_IC;
+#else
+            network_checksum_complete_offload(packet);
+#endif
+        }
+
+        memory_memcopy(network_packet_data(packet), (uint8_t*)(ring->buffer_va + (uint64_t)idx * ring->buffer_size), packet->length);
+
+        // descriptors are reused, checksum fields are always rewritten
+        desc->length = packet->length;
+        desc->css = css;
+        desc->cso = cso;
+        desc->status = 0;
+        desc->cmd = cmd;
+
+        network_packet_release(packet);
+
+        ring->tail = (idx + 1) & mask;
+        filled++;
+    }
+
+    if(filled) {
+        // descriptors are visible before tail moves
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        ring->packets += filled;
+        ring->batches++;
+    }
+
+    return consumed;
+}
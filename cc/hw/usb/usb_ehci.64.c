@@ -808,8 +808,8 @@ int8_t usb_ehci_bulk_transfer(usb_controller_t* usb_controller, usb_transfer_t*
     PRINTLOG(USB, LOG_TRACE, "EHCI qh 0x%p qtd 0x%p", qh, qtd);
 
     if(transfer->need_future) {
-        qh->transfer_lock = lock_create_for_future(task_get_id());
-        transfer->transfer_future = future_create(qh->transfer_lock);
+        transfer->transfer_future = future_create();
+        qh->transfer_future = transfer->transfer_future;
     }
 
     return 0;
@@ -1567,13 +1567,13 @@ int8_t usb_ehci_asynclist_lookup_task(int32_t argc, void** argv) {
                         transfer->endpoint->toggle ^= 1;
                     }
 
-                    lock_t* transfer_lock = qh->transfer_lock;
+                    future_t* transfer_future = qh->transfer_future;
 
                     usb_ehci_unlink_qh(usb_controller, metadata->qh_asynclist_head, qh);
                     usb_ehci_free_qh(usb_controller, qh);
 
                     if(transfer->need_future) {
-                        lock_release(transfer_lock);
+                        future_signal(transfer_future);
                     }
 
                     if(transfer->transfer_callback) {
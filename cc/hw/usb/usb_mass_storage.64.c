@@ -9,6 +9,7 @@
 #include <driver/usb.h>
 #include <logging.h>
 #include <driver/scsi.h>
+#include <cpu/sync.h>
 #include <future.h>
 #include <random.h>
 #include <time/timer.h>
@@ -0,0 +1,239 @@
+/**
+ * @file aho_corasick.64.c
+ * @brief aho-corasick multi pattern matcher implementation.
+ *
+ * bytes which appear in patterns get their own class, all other bytes share class 0, so a state's
+ * transition row is class count wide instead of 256. failure links are folded into the transition
+ * table at build, search is one lookup per byte without backtracking. each state keeps its own
+ * pattern and the nearest suffix state with a pattern, so overlapping matches are reported by
+ * walking that chain.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <aho_corasick.h>
+
+MODULE("turnstone.lib");
+
+/*! no pattern ends at state */
+#define AHO_CORASICK_NO_PATTERN -1ULL
+
+struct aho_corasick_t {
+    memory_heap_t* heap; ///< heap of automaton
+    uint64_t       class_count; ///< byte class count, class 0 is bytes not in patterns
+    uint64_t       state_count; ///< state count, state 0 is root
+    uint8_t        classes[256]; ///< byte to class map
+    uint32_t*      transitions; ///< state_count x class_count next states
+    uint64_t*      patterns; ///< pattern ending at state or AHO_CORASICK_NO_PATTERN
+    uint32_t*      next_matches; ///< nearest proper suffix state with pattern, 0 if none
+    uint64_t*      pattern_lens; ///< pattern lengths by id
+};
+
+aho_corasick_t* aho_corasick_create_with_heap(memory_heap_t* heap, const uint8_t* const* patterns, const uint64_t* pattern_lens, uint64_t pattern_count) {
+    if(patterns == NULL || pattern_lens == NULL || pattern_count == 0) {
+        return NULL;
+    }
+
+    heap = memory_get_heap(heap);
+
+    aho_corasick_t* ac = memory_malloc_ext(heap, sizeof(aho_corasick_t), 0);
+
+    if(ac == NULL) {
+        return NULL;
+    }
+
+    ac->heap = heap;
+    ac->class_count = 1;
+
+    uint64_t max_states = 1;
+
+    for(uint64_t i = 0; i < pattern_count; i++) {
+        if(patterns[i] == NULL || pattern_lens[i] == 0) {
+            memory_free_ext(heap, ac);
+
+            return NULL;
+        }
+
+        max_states += pattern_lens[i];
+
+        for(uint64_t j = 0; j < pattern_lens[i]; j++) {
+            uint8_t b = patterns[i][j];
+
+            if(ac->classes[b] == 0) {
+                if(ac->class_count == 256) {
+                    // every other byte value has its own class, last one keeps class 0 alone
+                    continue;
+                }
+
+                ac->classes[b] = ac->class_count++;
+            }
+        }
+    }
+
+    if(max_states > 0xFFFFFFFFULL) {
+        memory_free_ext(heap, ac);
+
+        return NULL;
+    }
+
+    uint64_t cc = ac->class_count;
+
+    ac->transitions = memory_malloc_ext(heap, max_states * cc * sizeof(uint32_t), 0);
+    ac->patterns = memory_malloc_ext(heap, max_states * sizeof(uint64_t), 0);
+    ac->next_matches = memory_malloc_ext(heap, max_states * sizeof(uint32_t), 0);
+    ac->pattern_lens = memory_malloc_ext(heap, pattern_count * sizeof(uint64_t), 0);
+
+    uint32_t* fails = memory_malloc_ext(heap, max_states * sizeof(uint32_t), 0);
+    uint32_t* queue = memory_malloc_ext(heap, max_states * sizeof(uint32_t), 0);
+
+    if(ac->transitions == NULL || ac->patterns == NULL || ac->next_matches == NULL || ac->pattern_lens == NULL ||
+       fails == NULL || queue == NULL) {
+        memory_free_ext(heap, fails);
+        memory_free_ext(heap, queue);
+        aho_corasick_destroy(ac);
+
+        return NULL;
+    }
+
+    for(uint64_t s = 0; s < max_states; s++) {
+        ac->patterns[s] = AHO_CORASICK_NO_PATTERN;
+    }
+
+    // trie, a zero transition is missing since root is nobody's child
+    uint64_t state_count = 1;
+
+    for(uint64_t i = 0; i < pattern_count; i++) {
+        uint64_t s = 0;
+
+        ac->pattern_lens[i] = pattern_lens[i];
+
+        for(uint64_t j = 0; j < pattern_lens[i]; j++) {
+            uint32_t* next = &ac->transitions[s * cc + ac->classes[patterns[i][j]]];
+
+            if(*next == 0) {
+                *next = state_count++;
+            }
+
+            s = *next;
+        }
+
+        if(ac->patterns[s] == AHO_CORASICK_NO_PATTERN) {
+            ac->patterns[s] = i;
+        }
+    }
+
+    ac->state_count = state_count;
+
+    // breadth first, a state's failure row is complete before the state is visited
+    uint64_t q_head = 0;
+    uint64_t q_tail = 0;
+
+    for(uint64_t c = 0; c < cc; c++) {
+        uint32_t t = ac->transitions[c];
+
+        if(t) {
+            fails[t] = 0;
+            queue[q_tail++] = t;
+        }
+    }
+
+    while(q_head < q_tail) {
+        uint32_t s = queue[q_head++];
+        uint32_t* row = &ac->transitions[s * cc];
+        const uint32_t* fail_row = &ac->transitions[fails[s] * cc];
+
+        for(uint64_t c = 0; c < cc; c++) {
+            uint32_t t = row[c];
+
+            if(t) {
+                uint32_t f = fail_row[c];
+
+                fails[t] = f;
+                ac->next_matches[t] = ac->patterns[f] != AHO_CORASICK_NO_PATTERN ? f : ac->next_matches[f];
+                queue[q_tail++] = t;
+            } else {
+                row[c] = fail_row[c];
+            }
+        }
+    }
+
+    memory_free_ext(heap, fails);
+    memory_free_ext(heap, queue);
+
+    return ac;
+}
+
+int64_t aho_corasick_search(const aho_corasick_t* ac, const uint8_t* data, uint64_t data_len, aho_corasick_match_f callback, void* arg) {
+    if(ac == NULL || (data == NULL && data_len)) {
+        return -1;
+    }
+
+    const uint32_t* transitions = ac->transitions;
+    uint64_t cc = ac->class_count;
+    uint64_t s = 0;
+    int64_t match_count = 0;
+
+    for(uint64_t i = 0; i < data_len; i++) {
+        s = transitions[s * cc + ac->classes[data[i]]];
+
+        uint64_t m = ac->patterns[s] != AHO_CORASICK_NO_PATTERN ? s : ac->next_matches[s];
+
+        while(m) {
+            uint64_t pattern_id = ac->patterns[m];
+
+            match_count++;
+
+            if(callback && callback(pattern_id, i + 1 - ac->pattern_lens[pattern_id], i + 1, arg) != 0) {
+                return match_count;
+            }
+
+            m = ac->next_matches[m];
+        }
+    }
+
+    return match_count;
+}
+
+int64_t aho_corasick_find_first(const aho_corasick_t* ac, const uint8_t* data, uint64_t data_len, uint64_t* pattern_id) {
+    if(ac == NULL || (data == NULL && data_len)) {
+        return -1;
+    }
+
+    const uint32_t* transitions = ac->transitions;
+    uint64_t cc = ac->class_count;
+    uint64_t s = 0;
+
+    for(uint64_t i = 0; i < data_len; i++) {
+        s = transitions[s * cc + ac->classes[data[i]]];
+
+        // state's own pattern is the longest one ending here
+        uint64_t m = ac->patterns[s] != AHO_CORASICK_NO_PATTERN ? s : ac->next_matches[s];
+
+        if(m) {
+            uint64_t id = ac->patterns[m];
+
+            if(pattern_id) {
+                *pattern_id = id;
+            }
+
+            return i + 1 - ac->pattern_lens[id];
+        }
+    }
+
+    return -1;
+}
+
+int8_t aho_corasick_destroy(aho_corasick_t* ac) {
+    if(ac == NULL) {
+        return -1;
+    }
+
+    memory_free_ext(ac->heap, ac->transitions);
+    memory_free_ext(ac->heap, ac->patterns);
+    memory_free_ext(ac->heap, ac->next_matches);
+    memory_free_ext(ac->heap, ac->pattern_lens);
+    memory_free_ext(ac->heap, ac);
+
+    return 0;
+}
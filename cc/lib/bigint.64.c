@@ -16,615 +16,786 @@
 
 MODULE("turnstone.lib");
 
-typedef struct bigint_item_t bigint_item_t;
+/*! each limb is 64 bits, limbs are stored least significant first in one contiguous array */
+#define BIGINT_LIMB_BITS 64
 
-/*! each value is 48 bits */
-#define BIGINT_ITEM_BITS       48
-#define BIGINT_ITEM_HEX_DIGITS 12
+/*! bigint_not complements the magnitude in 48-bit words, the word size of the former linked limb layout */
+#define BIGINT_NOT_WORD_BITS 48
 
-#define BIGINT_ITEM_MAX   0x0000FFFFFFFFFFFFUL
-#define BIGINT_ITEM_MSB   0x0000800000000000UL
-#define BIGINT_ITEM_CARRY 0x0001000000000000UL
+/*! minimum limb count allocated for a non zero value */
+#define BIGINT_MIN_CAPACITY 4
 
-typedef struct bigint_item_t {
-    uint64_t       value;
-    bigint_item_t* next;
-    bigint_item_t* prev;
-} bigint_item_t;
+/*! operand limb count where karatsuba starts to beat schoolbook multiplication */
+#define BIGINT_KARATSUBA_THRESHOLD 32
 
+/*! largest montgomery window table, 2^5 powers for fixed and 2^5 odd powers for sliding windows */
+#define BIGINT_MONTGOMERY_TABLE_ENTRIES 32
+
+/*! small primes used for trial division before miller-rabin */
+static const uint64_t bigint_small_primes[] = {
+    3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
+    101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211,
+    223, 227, 229, 233, 239, 241, 251,
+};
+
+/**
+ * @brief sign-magnitude big integer
+ * @details invariant: size is zero iff sign is zero, and limbs[size - 1] is never zero.
+ */
 struct bigint_t {
-    bigint_item_t* lsb;
-    bigint_item_t* msb;
-    int32_t        sign;
-    boolean_t      neged_with_sign;
+    uint64_t* limbs; ///< magnitude limbs, least significant first
+    uint64_t  size; ///< used limb count
+    uint64_t  capacity; ///< allocated limb count
+    int32_t   sign; ///< -1, 0 or 1
 };
 
+typedef enum bigint_bitwise_op_t {
+    BIGINT_BITWISE_OP_AND,
+    BIGINT_BITWISE_OP_OR,
+    BIGINT_BITWISE_OP_XOR,
+} bigint_bitwise_op_t;
 
-bigint_t* bigint_create(void) {
-    bigint_t* bigint = (bigint_t*)memory_malloc(sizeof(bigint_t));
 
-    if (bigint) {
-        bigint->lsb = NULL;
-        bigint->msb = NULL;
-        bigint->sign = 0;
-    }
+/*
+ * limb array primitives. they work on raw magnitudes and never allocate
+ * unless noted. output may alias the first input where stated.
+ */
 
-    return bigint;
+static inline uint64_t bigint_limbs_div_128_64(uint64_t hi, uint64_t lo, uint64_t d, uint64_t* rem) {
+    uint64_t q;
+    uint64_t r;
+
+    // hi < d is guaranteed by callers, so the quotient fits 64 bits
+    __asm__ ("divq %4" : "=a" (q), "=d" (r) : "a" (lo), "d" (hi), "rm" (d));
+
+    *rem = r;
+
+    return q;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
-static void bigint_destroy_items(bigint_t* bigint) {
-    if(!bigint) {
-        return;
+static int8_t bigint_limbs_cmp(const uint64_t* a, uint64_t an, const uint64_t* b, uint64_t bn) {
+    if (an != bn) {
+        return an < bn ? -1 : 1;
     }
 
-    bigint_item_t* item = bigint->lsb;
-
-    while (item) {
-        bigint_item_t* next = item->next;
-        memory_free(item);
-        item = next;
+    while (an--) {
+        if (a[an] != b[an]) {
+            return a[an] < b[an] ? -1 : 1;
+        }
     }
 
-    bigint->lsb = NULL;
-    bigint->msb = NULL;
-    bigint->sign = 0;
-    bigint->neged_with_sign = false;
+    return 0;
 }
-#pragma GCC diagnostic pop
 
-void bigint_destroy(bigint_t* bigint) {
-    bigint_destroy_items(bigint);
+// r = a + b, an >= bn, r may alias a or b, returns carry
+static uint64_t bigint_limbs_add(uint64_t* r, const uint64_t* a, uint64_t an, const uint64_t* b, uint64_t bn) {
+    uint64_t carry = 0;
+    uint64_t i = 0;
 
-    memory_free(bigint);
+    for (; i < bn; i++) {
+        uint128_t sum = (uint128_t)a[i] + b[i] + carry;
+        r[i] = (uint64_t)sum;
+        carry = (uint64_t)(sum >> 64);
+    }
+
+    for (; i < an; i++) {
+        uint64_t sum = a[i] + carry;
+        carry = sum < carry;
+        r[i] = sum;
+    }
+
+    return carry;
 }
 
-static uint64_t bigint_item_count(const bigint_t* bigint) {
-    uint64_t count = 0;
-    bigint_item_t* item = bigint->lsb;
+// r = a - b, an >= bn and a >= b, r may alias a or b, returns borrow
+static uint64_t bigint_limbs_sub(uint64_t* r, const uint64_t* a, uint64_t an, const uint64_t* b, uint64_t bn) {
+    uint64_t borrow = 0;
+    uint64_t i = 0;
+
+    for (; i < bn; i++) {
+        uint128_t diff = (uint128_t)a[i] - b[i] - borrow;
+        r[i] = (uint64_t)diff;
+        borrow = (uint64_t)(diff >> 64) & 1;
+    }
 
-    while (item) {
-        count++;
-        item = item->next;
+    for (; i < an; i++) {
+        uint64_t ai = a[i];
+        r[i] = ai - borrow;
+        borrow = ai < borrow;
     }
 
-    return count;
+    return borrow;
 }
 
-int8_t bigint_set_int64(bigint_t* bigint, int64_t value) {
-    if(!bigint) {
-        return -1;
+// r = a * m, r may alias a, returns high limb
+static uint64_t bigint_limbs_mul_1(uint64_t* r, const uint64_t* a, uint64_t n, uint64_t m) {
+    uint64_t carry = 0;
+
+    for (uint64_t i = 0; i < n; i++) {
+        uint128_t t = (uint128_t)a[i] * m + carry;
+        r[i] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
     }
 
-    bigint_item_t* item;
-    uint64_t uvalue;
-    boolean_t need_next = false;
-    uint64_t next_value = 0;
+    return carry;
+}
 
-    bigint_destroy_items(bigint);
+// r += a * m, returns high limb
+static uint64_t bigint_limbs_addmul_1(uint64_t* r, const uint64_t* a, uint64_t n, uint64_t m) {
+    uint64_t carry = 0;
 
-    if(value == 0) {
-        return 0;
+    for (uint64_t i = 0; i < n; i++) {
+        uint128_t t = (uint128_t)a[i] * m + r[i] + carry;
+        r[i] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
     }
 
-    if (value < 0) {
-        bigint->sign = -1;
-        uvalue = -value;
-    } else {
-        bigint->sign = 1;
-        uvalue = value;
-    }
+    return carry;
+}
 
-    if (uvalue > BIGINT_ITEM_MAX) {
-        need_next = true;
-        next_value = uvalue >> BIGINT_ITEM_BITS;
-        uvalue &= BIGINT_ITEM_MAX;
-    }
+// r -= a * m, returns borrow limb
+static uint64_t bigint_limbs_submul_1(uint64_t* r, const uint64_t* a, uint64_t n, uint64_t m) {
+    uint64_t borrow = 0;
 
-    item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    for (uint64_t i = 0; i < n; i++) {
+        uint128_t t = (uint128_t)a[i] * m + borrow;
+        uint64_t lo = (uint64_t)t;
+        uint64_t ri = r[i];
 
-    if (!item) {
-        return -1;
+        borrow = (uint64_t)(t >> 64) + (ri < lo);
+        r[i] = ri - lo;
     }
 
-    item->value = uvalue;
-    item->next = NULL;
+    return borrow;
+}
 
-    if (need_next) {
-        bigint_item_t* next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+// r = a * b schoolbook, r has an + bn limbs and must not alias inputs
+static void bigint_limbs_mul_basecase(uint64_t* r, const uint64_t* a, uint64_t an, const uint64_t* b, uint64_t bn) {
+    r[an] = bigint_limbs_mul_1(r, a, an, b[0]);
 
-        if (!next) {
-            memory_free(item);
-            return -1;
-        }
+    for (uint64_t j = 1; j < bn; j++) {
+        r[an + j] = bigint_limbs_addmul_1(r + j, a, an, b[j]);
+    }
+}
 
-        next->value = next_value;
-        next->prev = item;
-        next->next = NULL;
+// r = a * a schoolbook, computes each cross product once, r has 2n limbs and must not alias a
+static void bigint_limbs_sqr_basecase(uint64_t* r, const uint64_t* a, uint64_t n) {
+    memory_memclean(r, 2 * n * sizeof(uint64_t));
 
-        item->next = next;
+    for (uint64_t i = 0; i + 1 < n; i++) {
+        r[i + n] = bigint_limbs_addmul_1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
     }
 
-    bigint->lsb = item;
+    uint64_t top = 0;
 
-    if (need_next) {
-        bigint->msb = item->next;
-    } else {
-        bigint->msb = item;
+    for (uint64_t i = 0; i < 2 * n; i++) {
+        uint64_t next_top = r[i] >> 63;
+        r[i] = (r[i] << 1) | top;
+        top = next_top;
     }
 
-    return 0;
+    uint64_t carry = 0;
+
+    for (uint64_t i = 0; i < n; i++) {
+        uint128_t sq = (uint128_t)a[i] * a[i];
+        uint128_t t = (uint128_t)r[2 * i] + (uint64_t)sq + carry;
+        r[2 * i] = (uint64_t)t;
+        t = (uint128_t)r[2 * i + 1] + (uint64_t)(sq >> 64) + (uint64_t)(t >> 64);
+        r[2 * i + 1] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+    }
 }
 
-int8_t bigint_set_uint64(bigint_t* bigint, uint64_t value) {
-    bigint_item_t* item;
-    boolean_t need_next = false;
-    uint64_t next_value = 0;
+static uint64_t bigint_limbs_karatsuba_scratch_size(uint64_t n) {
+    uint64_t size = 0;
 
-    bigint_destroy_items(bigint);
+    while (n >= BIGINT_KARATSUBA_THRESHOLD) {
+        uint64_t hi = n - n / 2;
 
-    if (value == 0) {
-        return 0;
+        size += 4 * (hi + 1);
+        n = hi + 1;
     }
 
-    bigint->sign = 1;
+    return size;
+}
 
-    if (value > BIGINT_ITEM_MAX) {
-        need_next = true;
-        next_value = value >> BIGINT_ITEM_BITS;
-        value &= BIGINT_ITEM_MAX;
-    }
+/*
+ * r = a * b for two n limb operands, r has 2n limbs. a == b selects squaring.
+ * a = a1 * B^lo + a0, b = b1 * B^lo + b0
+ * a * b = z2 * B^2lo + ((a0 + a1)(b0 + b1) - z2 - z0) * B^lo + z0
+ */
+static void bigint_limbs_mul_n(uint64_t* r, const uint64_t* a, const uint64_t* b, uint64_t n, uint64_t* scratch) {
+    boolean_t square = a == b;
 
-    item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    if (n < BIGINT_KARATSUBA_THRESHOLD) {
+        if (square) {
+            bigint_limbs_sqr_basecase(r, a, n);
+        } else {
+            bigint_limbs_mul_basecase(r, a, n, b, n);
+        }
 
-    if (!item) {
-        return -1;
+        return;
     }
 
-    item->value = value;
-    item->next = NULL;
+    uint64_t lo = n / 2;
+    uint64_t hi = n - lo;
 
-    if (need_next) {
-        bigint_item_t* next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    // z0 and z2 go straight into r, their scratch is released before the middle term
+    bigint_limbs_mul_n(r, a, b, lo, scratch);
+    bigint_limbs_mul_n(r + 2 * lo, a + lo, b + lo, hi, scratch);
 
-        if (!next) {
-            memory_free(item);
-            return -1;
-        }
+    uint64_t* sa = scratch;
+    uint64_t* sb = scratch + hi + 1;
+    uint64_t* z1 = scratch + 2 * (hi + 1);
+    uint64_t* next = z1 + 2 * (hi + 1);
 
-        next->value = next_value;
-        next->next = NULL;
-        next->prev = item;
+    sa[hi] = bigint_limbs_add(sa, a + lo, hi, a, lo);
 
-        item->next = next;
+    if (square) {
+        sb = sa;
+    } else {
+        sb[hi] = bigint_limbs_add(sb, b + lo, hi, b, lo);
     }
 
-    bigint->lsb = item;
+    bigint_limbs_mul_n(z1, sa, sb, hi + 1, next);
 
-    if (need_next) {
-        bigint->msb = item->next;
-    } else {
-        bigint->msb = item;
-    }
+    uint64_t z1_size = 2 * (hi + 1);
 
-    return 0;
-}
+    bigint_limbs_sub(z1, z1, z1_size, r, 2 * lo);
+    bigint_limbs_sub(z1, z1, z1_size, r + 2 * lo, 2 * hi);
 
-bigint_t* bigint_one(void) {
-    bigint_t* bigint = bigint_create();
+    uint64_t tail = 2 * n - lo;
 
-    if (bigint) {
-        bigint_set_int64(bigint, 1);
+    while (z1_size > tail) { // a0 * b1 + a1 * b0 fits, the extra limbs are zero
+        z1_size--;
     }
 
-    return bigint;
+    bigint_limbs_add(r + lo, r + lo, tail, z1, z1_size);
 }
 
-bigint_t* bigint_two(void) {
-    bigint_t* bigint = bigint_create();
+// r = a * b, r has an + bn limbs and must not alias inputs
+static int8_t bigint_limbs_mul(uint64_t* r, const uint64_t* a, uint64_t an, const uint64_t* b, uint64_t bn) {
+    if (an < bn) {
+        const uint64_t* t = a;
+        a = b;
+        b = t;
 
-    if (bigint) {
-        bigint_set_int64(bigint, 2);
+        uint64_t tn = an;
+        an = bn;
+        bn = tn;
     }
 
-    return bigint;
-}
+    if (bn < BIGINT_KARATSUBA_THRESHOLD) {
+        if (a == b && an == bn) {
+            bigint_limbs_sqr_basecase(r, a, an);
+        } else {
+            bigint_limbs_mul_basecase(r, a, an, b, bn);
+        }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-int8_t bigint_set_bigint(bigint_t* bigint, const bigint_t* src) {
-    if(!bigint || !src) {
+        return 0;
+    }
+
+    uint64_t kara_size = bigint_limbs_karatsuba_scratch_size(bn);
+    uint64_t scratch_size = kara_size + ((an == bn) ? 0 : 2 * bn);
+    uint64_t* scratch = memory_malloc(scratch_size * sizeof(uint64_t));
+
+    if (!scratch) {
         return -1;
     }
 
-    bigint_item_t* item = src->lsb;
-    bigint_item_t* dest_item = bigint->lsb;
-    bigint_item_t* prev = NULL;
-    bigint_item_t* first = NULL;
-    bigint_item_t* next = NULL;
+    if (an == bn) {
+        bigint_limbs_mul_n(r, a, b, bn, scratch);
+        memory_free(scratch);
 
-    bigint->sign = src->sign;
-    bigint->neged_with_sign = src->neged_with_sign;
+        return 0;
+    }
 
-    while(dest_item && item) { // fill the existing items
-        dest_item->value = item->value;
+    // unbalanced operands: multiply b by bn sized chunks of a and accumulate
+    uint64_t* tmp = scratch + kara_size;
+    uint64_t offset = 0;
 
-        prev = dest_item;
+    memory_memclean(r, (an + bn) * sizeof(uint64_t));
 
-        dest_item = dest_item->next;
-        item = item->next;
-    }
+    while (an - offset >= bn) {
+        bigint_limbs_mul_n(tmp, a + offset, b, bn, scratch);
+        bigint_limbs_add(r + offset, r + offset, an + bn - offset, tmp, 2 * bn);
 
-    if(!item && !dest_item) {
-        // nothing to do
-        return 0;
+        offset += bn;
     }
 
-    if(!item && dest_item) {
-        bigint->msb = prev;
+    if (offset < an) {
+        uint64_t rest = an - offset;
+
+        if (bigint_limbs_mul(tmp, b, bn, a + offset, rest) == -1) {
+            memory_free(scratch);
 
-        if(bigint->msb) {
-            bigint->msb->next = NULL;
+            return -1;
         }
 
-        // remove the rest of the items from dest
-        while(dest_item) {
-            next = dest_item->next;
-            memory_free(dest_item);
-            dest_item = next;
+        bigint_limbs_add(r + offset, r + offset, rest + bn, tmp, rest + bn);
+    }
+
+    memory_free(scratch);
+
+    return 0;
+}
+
+/*
+ * q = a / b, r = a % b with knuth's algorithm d. b[bn - 1] must not be zero and an >= bn.
+ * q has an - bn + 1 limbs, r has bn limbs, r may be NULL. outputs must not alias inputs.
+ */
+static int8_t bigint_limbs_divmod(uint64_t* q, uint64_t* r, const uint64_t* a, uint64_t an, const uint64_t* b, uint64_t bn) {
+    if (bn == 1) {
+        uint64_t rem = 0;
+
+        for (uint64_t i = an; i-- > 0;) {
+            q[i] = bigint_limbs_div_128_64(rem, a[i], b[0], &rem);
         }
 
-        if(!bigint->msb) {
-            bigint->lsb = NULL;
-            bigint->sign = 0;
+        if (r) {
+            r[0] = rem;
         }
 
         return 0;
     }
 
-    // there are two cases fisrt dest is already empty or dest is not empty
-    // prev is the last item in dest if it is null then dest is empty
-    // so we need to set first as new item, otherwise first is the lsb of dest
+    uint64_t* un = memory_malloc((an + 1 + bn) * sizeof(uint64_t));
 
-    if(prev) {
-        first = bigint->lsb;
+    if (!un) {
+        return -1;
     }
 
-    while(item) {
-        next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    uint64_t* vn = un + an + 1;
 
-        if(!next) {
-            return -1;
+    // normalize so the top divisor limb has its msb set
+    uint64_t shift = 63 - bit_most_significant(b[bn - 1]);
+
+    if (shift) {
+        for (uint64_t i = bn - 1; i > 0; i--) {
+            vn[i] = (b[i] << shift) | (b[i - 1] >> (64 - shift));
         }
 
-        next->value = item->value;
-        next->prev = prev;
-        next->next = NULL;
+        vn[0] = b[0] << shift;
 
-        if(prev) {
-            prev->next = next;
-        } else {
-            first = next;
+        un[an] = a[an - 1] >> (64 - shift);
+
+        for (uint64_t i = an - 1; i > 0; i--) {
+            un[i] = (a[i] << shift) | (a[i - 1] >> (64 - shift));
         }
 
-        prev = next;
-        item = item->next;
+        un[0] = a[0] << shift;
+    } else {
+        memory_memcopy(b, vn, bn * sizeof(uint64_t));
+        memory_memcopy(a, un, an * sizeof(uint64_t));
+        un[an] = 0;
     }
 
-    bigint->lsb = first;
-    bigint->msb = prev;
+    uint64_t vtop = vn[bn - 1];
+    uint64_t vnext = vn[bn - 2];
 
+    for (uint64_t j = an - bn + 1; j-- > 0;) {
+        uint64_t ujn = un[j + bn];
+        uint64_t ujn1 = un[j + bn - 1];
+        uint64_t qhat;
+        uint64_t rhat;
+        boolean_t rhat_overflow = false;
 
-    return 0;
-}
-#pragma GCC diagnostic pop
+        if (ujn >= vtop) {
+            qhat = 0xFFFFFFFFFFFFFFFFULL;
+            rhat = ujn1 + vtop;
+            rhat_overflow = rhat < ujn1;
+        } else {
+            qhat = bigint_limbs_div_128_64(ujn, ujn1, vtop, &rhat);
+        }
 
-bigint_t* bigint_clone(const bigint_t* src) {
-    if(!src) {
-        return NULL;
-    }
+        while (!rhat_overflow && (uint128_t)qhat * vnext > (((uint128_t)rhat << 64) | un[j + bn - 2])) {
+            qhat--;
+            rhat += vtop;
+            rhat_overflow = rhat < vtop;
+        }
 
-    bigint_t* bigint = bigint_create();
+        uint64_t borrow = bigint_limbs_submul_1(un + j, vn, bn, qhat);
 
-    if (bigint) {
-        if (bigint_set_bigint(bigint, src) == -1) {
-            bigint_destroy(bigint);
-            bigint = NULL;
-        }
-    }
+        un[j + bn] = ujn - borrow;
 
-    return bigint;
-}
+        if (ujn < borrow) { // qhat was one too large, add back
+            qhat--;
+            un[j + bn] += bigint_limbs_add(un + j, un + j, bn, vn, bn);
+        }
 
-int8_t bigint_set_str(bigint_t* bigint, const char_t* str) {
-    if (!str || !bigint) {
-        return -1;
+        q[j] = qhat;
     }
 
-    int32_t sign = 1;
+    if (r) {
+        if (shift) {
+            for (uint64_t i = 0; i < bn - 1; i++) {
+                r[i] = (un[i] >> shift) | (un[i + 1] << (64 - shift));
+            }
 
-    if (*str == '-') {
-        sign = -1;
-        str++;
+            r[bn - 1] = un[bn - 1] >> shift;
+        } else {
+            memory_memcopy(un, r, bn * sizeof(uint64_t));
+        }
     }
 
-    while (*str && *str == '0') {
-        str++;
-    }
+    memory_free(un);
+
+    return 0;
+}
 
-    uint32_t len = strlen(str);
 
-    if (len == 0) {
-        bigint->sign = 0;
+/*
+ * bigint storage helpers
+ */
 
+static int8_t bigint_reserve(bigint_t* bigint, uint64_t count) {
+    if (bigint->capacity >= count) {
         return 0;
     }
 
+    uint64_t capacity = MAX(count, bigint->capacity * 2);
 
-    bigint_destroy_items(bigint);
+    capacity = MAX(capacity, BIGINT_MIN_CAPACITY);
 
-    bigint->sign = sign;
-
-    int32_t parts = len / BIGINT_ITEM_HEX_DIGITS;
+    uint64_t* limbs = memory_malloc(capacity * sizeof(uint64_t));
 
-    if (len % BIGINT_ITEM_HEX_DIGITS) {
-        parts++;
+    if (!limbs) {
+        return -1;
     }
 
-    int32_t first_len = len % BIGINT_ITEM_HEX_DIGITS;
-
-    if (first_len == 0) {
-        first_len = BIGINT_ITEM_HEX_DIGITS;
+    if (bigint->size) {
+        memory_memcopy(bigint->limbs, limbs, bigint->size * sizeof(uint64_t));
     }
 
-    bigint_item_t* next = NULL;
+    memory_free(bigint->limbs);
 
-    for (int32_t i = 0; i < parts; i++) {
-        int32_t part_len = (i == 0) ? first_len : BIGINT_ITEM_HEX_DIGITS;
+    bigint->limbs = limbs;
+    bigint->capacity = capacity;
 
-        uint64_t value = 0;
+    return 0;
+}
 
-        for (int32_t j = 0; j < part_len; j++) {
-            value <<= 4;
+static void bigint_normalize(bigint_t* bigint) {
+    while (bigint->size && bigint->limbs[bigint->size - 1] == 0) {
+        bigint->size--;
+    }
 
-            if (str[j] >= '0' && str[+j] <= '9') {
-                value += str[j] - '0';
-            } else if (str[j] >= 'A' && str[j] <= 'F') {
-                value += str[j] - 'A' + 10;
-            } else if (str[j] >= 'a' && str[j] <= 'f') {
-                value += str[j] - 'a' + 10;
-            } else {
-                return -1;
-            }
-        }
+    if (bigint->size == 0) {
+        bigint->sign = 0;
+    }
+}
 
-        str += part_len;
+static void bigint_swap(bigint_t* a, bigint_t* b) {
+    bigint_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
 
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+static int8_t bigint_set_limb(bigint_t* bigint, uint64_t value, int32_t sign) {
+    if (value == 0) {
+        bigint->size = 0;
+        bigint->sign = 0;
 
-        if (!item) {
-            return -1;
-        }
+        return 0;
+    }
+
+    if (bigint_reserve(bigint, 1) == -1) {
+        return -1;
+    }
 
-        item->value = value;
-        item->next = next;
+    bigint->limbs[0] = value;
+    bigint->size = 1;
+    bigint->sign = sign;
 
-        if (next) {
-            next->prev = item;
-        }
+    return 0;
+}
 
-        next = item;
+// adds one to the magnitude, keeps sign
+static int8_t bigint_inc_magnitude(bigint_t* bigint) {
+    if (bigint_reserve(bigint, bigint->size + 1) == -1) {
+        return -1;
+    }
 
-        if (i == 0) {
-            bigint->msb = item;
+    for (uint64_t i = 0; i < bigint->size; i++) {
+        if (++bigint->limbs[i] != 0) {
+            return 0;
         }
     }
 
-    bigint->lsb = next;
+    bigint->limbs[bigint->size++] = 1;
 
     return 0;
 }
 
-static int8_t bigint_inc_with_overflow(bigint_t* bigint) {
-    if (bigint->sign == 0) {
-        bigint->sign = 1;
-        bigint->lsb = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+// result = a + b_sign * |b|
+static int8_t bigint_add_signed(bigint_t* result, const bigint_t* a, const bigint_t* b, int32_t b_sign) {
+    if (b_sign == 0 || b->sign == 0) {
+        return bigint_set_bigint(result, a);
+    }
 
-        if (!bigint->lsb) {
+    if (a->sign == 0) {
+        if (bigint_set_bigint(result, b) == -1) {
             return -1;
         }
 
-        bigint->lsb->value = 1;
-        bigint->lsb->next = NULL;
-        bigint->lsb->prev = NULL;
-        bigint->msb = bigint->lsb;
+        result->sign = b_sign;
 
         return 0;
     }
 
-    bigint_item_t* item = bigint->lsb;
-    uint64_t carry = 1;
+    const bigint_t* big = a;
+    const bigint_t* small = b;
+    int32_t big_sign = a->sign;
 
-    while (item) {
-        item->value += carry;
-
-        carry = item->value >> BIGINT_ITEM_BITS;
+    if (a->sign == b_sign) {
+        if (a->size < b->size) {
+            big = b;
+            small = a;
+        }
 
-        item->value &= BIGINT_ITEM_MAX;
+        uint64_t big_size = big->size;
+        uint64_t small_size = small->size;
 
-        if (carry == 0) {
-            break;
+        // result may be a or b, so fetch limbs after growing
+        if (bigint_reserve(result, big_size + 1) == -1) {
+            return -1;
         }
 
-        item = item->next;
-    }
-
+        uint64_t carry = bigint_limbs_add(result->limbs, big->limbs, big_size, small->limbs, small_size);
 
-    return 0;
-}
+        result->limbs[big_size] = carry;
+        result->size = big_size + carry;
+        result->sign = a->sign;
 
-static int8_t bigint_remove_leading_zeros(bigint_t* bigint) {
-    bigint_item_t* item = bigint->msb;
+        return 0;
+    }
 
-    while (item && item->value == 0) {
-        bigint_item_t* prev = item->prev;
+    int8_t cmp = bigint_limbs_cmp(a->limbs, a->size, b->limbs, b->size);
 
-        if (prev) {
-            prev->next = NULL;
-        }
+    if (cmp == 0) {
+        result->size = 0;
+        result->sign = 0;
 
-        memory_free(item);
+        return 0;
+    }
 
-        item = prev;
+    if (cmp < 0) {
+        big = b;
+        small = a;
+        big_sign = b_sign;
     }
 
-    bigint->msb = item;
+    uint64_t big_size = big->size;
+    uint64_t small_size = small->size;
 
-    if (!item) {
-        bigint->sign = 0;
-        bigint->lsb = NULL;
-        bigint->neged_with_sign = false;
+    if (bigint_reserve(result, big_size) == -1) {
+        return -1;
     }
 
-    if(bigint->sign == -1 && bigint->neged_with_sign) {
-        item = bigint->msb;
+    bigint_limbs_sub(result->limbs, big->limbs, big_size, small->limbs, small_size);
 
-        while (item && item->value == BIGINT_ITEM_MAX && item != bigint->lsb) {
-            bigint_item_t* prev = item->prev;
+    result->size = big_size;
+    result->sign = big_sign;
 
-            if (prev) {
-                prev->next = NULL;
-            }
+    bigint_normalize(result);
 
-            memory_free(item);
+    return 0;
+}
 
-            item = prev;
-        }
 
-        if (!item) {
-            bigint->sign = 0;
-            bigint->neged_with_sign = false;
-            bigint->lsb = NULL;
+bigint_t* bigint_create(void) {
+    bigint_t* bigint = (bigint_t*)memory_malloc(sizeof(bigint_t));
 
-            return 0;
-        }
+    if (bigint) {
+        bigint->limbs = NULL;
+        bigint->size = 0;
+        bigint->capacity = 0;
+        bigint->sign = 0;
+    }
 
-        if(item == bigint->lsb) {
-            item->next = NULL;
-            item->prev = NULL;
-        }
+    return bigint;
+}
 
-        bigint->msb = item;
+void bigint_destroy(bigint_t* bigint) {
+    if (!bigint) {
+        return;
     }
 
-    return 0;
+    memory_free(bigint->limbs);
+    memory_free(bigint);
 }
 
-static int8_t bigint_neg_with_sign_inplace(bigint_t* a, boolean_t force) {
-    if(a->sign == 0) {
-        return 0;
+int8_t bigint_set_int64(bigint_t* bigint, int64_t value) {
+    if (!bigint) {
+        return -1;
     }
 
-    if(!force && a->sign > 0) { // prevent positive to negative
-        return 0;
+    if (value < 0) {
+        return bigint_set_limb(bigint, 0 - (uint64_t)value, -1);
     }
 
-    if(!force && a->neged_with_sign && a->sign < 0) { // already neged
-        return 0;
-    }
+    return bigint_set_limb(bigint, value, 1);
+}
 
-    if(bigint_not(a, a) == -1) {
+int8_t bigint_set_uint64(bigint_t* bigint, uint64_t value) {
+    if (!bigint) {
         return -1;
     }
 
-    if(bigint_inc_with_overflow(a) == -1) {
-        return -1;
-    }
+    return bigint_set_limb(bigint, value, 1);
+}
 
-    a->neged_with_sign = !a->neged_with_sign;
+bigint_t* bigint_one(void) {
+    bigint_t* bigint = bigint_create();
 
-    return 0;
-}
+    if (bigint && bigint_set_uint64(bigint, 1) == -1) {
+        bigint_destroy(bigint);
 
-static int8_t bigint_neg_with_sign(bigint_t* result, const bigint_t* a, boolean_t force) {
-    if (result == a) {
-        return bigint_neg_with_sign_inplace(result, force);
+        return NULL;
     }
 
-    if (a->sign == 0) {
-        result->sign = 0;
+    return bigint;
+}
 
-        return 0;
+bigint_t* bigint_two(void) {
+    bigint_t* bigint = bigint_create();
+
+    if (bigint && bigint_set_uint64(bigint, 2) == -1) {
+        bigint_destroy(bigint);
+
+        return NULL;
     }
 
-    if(!force && a->sign > 0) { // prevent positive to negative
-        return 0;
+    return bigint;
+}
+
+int8_t bigint_set_bigint(bigint_t* bigint, const bigint_t* src) {
+    if (!bigint || !src) {
+        return -1;
     }
 
-    if(!force && a->neged_with_sign && a->sign < 0) { // already neged
+    if (bigint == src) {
         return 0;
     }
 
-    if (bigint_set_bigint(result, a) == -1) {
+    bigint->size = 0; // nothing to preserve while growing
+
+    if (bigint_reserve(bigint, src->size) == -1) {
         return -1;
     }
 
-    if(bigint_not(result, result) == -1) {
-        return -1;
+    if (src->size) {
+        memory_memcopy(src->limbs, bigint->limbs, src->size * sizeof(uint64_t));
     }
 
-    if(bigint_inc_with_overflow(result) == -1) {
-        return -1;
-    }
-
-    result->neged_with_sign = !result->neged_with_sign;
+    bigint->size = src->size;
+    bigint->sign = src->sign;
 
     return 0;
 }
 
-const char_t* bigint_to_str(const bigint_t* bigint) {
-    if (!bigint) {
+bigint_t* bigint_clone(const bigint_t* src) {
+    if (!src) {
         return NULL;
     }
 
-    if (!bigint->msb) {
-        return strdup("0");
+    bigint_t* bigint = bigint_create();
+
+    if (bigint && bigint_set_bigint(bigint, src) == -1) {
+        bigint_destroy(bigint);
+
+        return NULL;
     }
 
-    if(bigint->sign == 0) {
-        return strdup("0");
+    return bigint;
+}
+
+int8_t bigint_set_str(bigint_t* bigint, const char_t* str) {
+    if (!str || !bigint) {
+        return -1;
+    }
+
+    int32_t sign = 1;
+
+    if (*str == '-') {
+        sign = -1;
+        str++;
+    }
+
+    while (*str == '0') {
+        str++;
     }
 
+    uint64_t len = strlen(str);
 
-    buffer_t* buffer = buffer_new_with_capacity(NULL, 64);
-    bigint_item_t* item = bigint->msb; // msb is at msb
+    bigint->size = 0;
+    bigint->sign = 0;
 
-    if (bigint->sign < 0) {
-        buffer_append_byte(buffer, '-');
+    if (len == 0) {
+        return 0;
+    }
+
+    uint64_t count = (len + 15) / 16;
+
+    if (bigint_reserve(bigint, count) == -1) {
+        return -1;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t end = len - i * 16;
+        uint64_t start = (end > 16) ? end - 16 : 0;
+        uint64_t value = 0;
+
+        for (uint64_t j = start; j < end; j++) {
+            char_t c = str[j];
+
+            value <<= 4;
 
-        if(bigint->neged_with_sign) {
-            bigint_neg_with_sign_inplace((bigint_t*)bigint, true);
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else {
+                return -1;
+            }
         }
 
+        bigint->limbs[i] = value;
     }
 
-    while (item && item->value == 0) {
-        item = item->prev;
+    bigint->size = count;
+    bigint->sign = sign;
+
+    return 0;
+}
+
+const char_t* bigint_to_str(const bigint_t* bigint) {
+    if (!bigint) {
+        return NULL;
     }
 
-    if(!item) {
-        buffer_destroy(buffer);
+    if (bigint->sign == 0) {
         return strdup("0");
     }
 
-    buffer_printf(buffer, "%llx", item->value); // first item max 48 bits so 12 hex digits and no leading zeros at the beginning
+    buffer_t* buffer = buffer_new_with_capacity(NULL, bigint->size * 16 + 2);
+
+    if (!buffer) {
+        return NULL;
+    }
+
+    if (bigint->sign < 0) {
+        buffer_append_byte(buffer, '-');
+    }
+
+    uint64_t i = bigint->size - 1;
 
-    item = item->prev;
+    buffer_printf(buffer, "%llx", bigint->limbs[i]); // top limb without leading zeros
 
-    while (item) {
-        buffer_printf(buffer, "%012llx", item->value); // each item max 48 bits so 12 hex digits
-        item = item->prev;
+    while (i--) {
+        buffer_printf(buffer, "%016llx", bigint->limbs[i]);
     }
 
     buffer_append_byte(buffer, '\0');
@@ -651,15 +822,11 @@ boolean_t bigint_is_negative(const bigint_t* a) {
 }
 
 boolean_t bigint_is_odd(const bigint_t* a) {
-    if (!a) {
-        return false;
-    }
-
-    if (a->sign == 0) {
+    if (!a || a->sign == 0) {
         return false;
     }
 
-    return a->lsb->value & 1;
+    return a->limbs[0] & 1;
 }
 
 boolean_t bigint_is_even(const bigint_t* a) {
@@ -671,11 +838,7 @@ boolean_t bigint_is_even(const bigint_t* a) {
         return true;
     }
 
-    if(!a->lsb) {
-        return false;
-    }
-
-    return (a->lsb->value & 1) == 0;
+    return (a->limbs[0] & 1) == 0;
 }
 
 boolean_t bigint_is_int64(const bigint_t* a, int64_t value) {
@@ -683,47 +846,17 @@ boolean_t bigint_is_int64(const bigint_t* a, int64_t value) {
         return false;
     }
 
-    if (a->sign == 0) {
-        return value == 0;
-    }
-
-    if (a->sign < 0) {
-        if (value > 0) {
-            return false;
-        }
-    }
-
-    if(a->sign > 0) {
-        if(value < 0) {
-            return false;
-        }
-    }
-
-    uint64_t uvalue = (value < 0) ? -value : value;
-    uint64_t low = uvalue & BIGINT_ITEM_MAX;
-    uint64_t high = uvalue >> BIGINT_ITEM_BITS;
-
-    uint64_t item_count = bigint_item_count(a);
-
-    if(item_count == 0) {
-        return false;
-    }
-
-    if (a->lsb->value != low) {
-        return false;
-    }
-
-    if (high == 0) {
-        return item_count == 1;
+    if (value == 0) {
+        return a->sign == 0;
     }
 
-    if (item_count != 2) {
+    if (a->size != 1 || (a->sign < 0) != (value < 0)) {
         return false;
     }
 
-    bigint_item_t* item = a->lsb->next;
+    uint64_t uvalue = (value < 0) ? 0 - (uint64_t)value : (uint64_t)value;
 
-    return item->value == high;
+    return a->limbs[0] == uvalue;
 }
 
 boolean_t bigint_is_uint64(const bigint_t* a, uint64_t value) {
@@ -731,2398 +864,1237 @@ boolean_t bigint_is_uint64(const bigint_t* a, uint64_t value) {
         return false;
     }
 
-    if (a->sign == 0) {
-        return value == 0;
+    if (value == 0) {
+        return a->sign == 0;
     }
 
-    uint64_t low = value & BIGINT_ITEM_MAX;
-    uint64_t high = value >> BIGINT_ITEM_BITS;
-
-    uint64_t bit_count = bigint_bit_length(a);
-
-    if(bit_count > 63) {
-        return false;
-    }
+    return a->sign > 0 && a->size == 1 && a->limbs[0] == value;
+}
 
-    if (a->lsb->value != low) {
-        return false;
+int8_t bigint_neg(bigint_t* result, const bigint_t* a) {
+    if(!result || !a) {
+        return -1;
     }
 
-    if (high == 0) {
-        return bit_count <= 47;
+    if (bigint_set_bigint(result, a) == -1) {
+        return -1;
     }
 
-    bigint_item_t* item = a->lsb->next;
+    result->sign = -result->sign;
 
-    return item->value == high;
+    return 0;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-static int8_t bigint_sign_extend(bigint_t* bigint, uint64_t item_count) {
-    if(!bigint) {
+/*
+ * and, or and xor behave as if both operands were infinite two's complement values.
+ * negative magnitudes are converted limb by limb while streaming, so result may alias a or b.
+ */
+static int8_t bigint_bitwise(bigint_t* result, const bigint_t* a, const bigint_t* b, bigint_bitwise_op_t op) {
+    if(!result || !a || !b) {
         return -1;
     }
 
-    uint64_t count = bigint_item_count(bigint);
+    boolean_t a_neg = a->sign < 0;
+    boolean_t b_neg = b->sign < 0;
+    boolean_t r_neg;
 
-    if (count >= item_count) {
-        return 0;
+    switch (op) {
+    case BIGINT_BITWISE_OP_AND:
+        r_neg = a_neg && b_neg;
+        break;
+    case BIGINT_BITWISE_OP_OR:
+        r_neg = a_neg || b_neg;
+        break;
+    default:
+        r_neg = a_neg != b_neg;
+        break;
     }
 
-    if(bigint->sign < 0 && !bigint->neged_with_sign && bigint_neg_with_sign_inplace(bigint, false) == -1) {
+    uint64_t an = a->size;
+    uint64_t bn = b->size;
+    uint64_t n = MAX(an, bn);
+
+    if (bigint_reserve(result, n + 1) == -1) {
         return -1;
     }
 
-    item_count -= count; // how many items to add
+    const uint64_t* al = a->limbs;
+    const uint64_t* bl = b->limbs;
+    uint64_t* rl = result->limbs;
 
-    for (uint64_t i = 0; i < item_count; i++) {
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    uint64_t a_borrow = a_neg;
+    uint64_t b_borrow = b_neg;
+    uint64_t r_carry = r_neg;
 
-        if (!item) {
-            return -1;
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t x = (i < an) ? al[i] : 0;
+        uint64_t y = (i < bn) ? bl[i] : 0;
+
+        if (a_neg) {
+            uint64_t t = x - a_borrow;
+            a_borrow = x < a_borrow;
+            x = ~t;
         }
 
-        item->value = (bigint->sign < 0) ? BIGINT_ITEM_MAX : 0;
-        item->next = NULL;
+        if (b_neg) {
+            uint64_t t = y - b_borrow;
+            b_borrow = y < b_borrow;
+            y = ~t;
+        }
 
-        if(bigint->msb) {
-            item->prev = bigint->msb;
+        uint64_t z;
 
-            bigint->msb->next = item;
-            bigint->msb = item;
-        } else {
-            bigint->lsb = item;
-            bigint->msb = item;
+        switch (op) {
+        case BIGINT_BITWISE_OP_AND:
+            z = x & y;
+            break;
+        case BIGINT_BITWISE_OP_OR:
+            z = x | y;
+            break;
+        default:
+            z = x ^ y;
+            break;
+        }
+
+        if (r_neg) {
+            z = ~z + r_carry;
+            r_carry = r_carry && z == 0;
         }
 
+        rl[i] = z;
     }
 
+    rl[n] = r_neg ? r_carry : 0;
+
+    result->size = n + 1;
+    result->sign = r_neg ? -1 : 1;
+
+    bigint_normalize(result);
+
     return 0;
 }
-#pragma GCC diagnostic pop
 
-int8_t bigint_neg(bigint_t* result, const bigint_t* a) {
+int8_t bigint_and(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    return bigint_bitwise(result, a, b, BIGINT_BITWISE_OP_AND);
+}
+
+int8_t bigint_or(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    return bigint_bitwise(result, a, b, BIGINT_BITWISE_OP_OR);
+}
+
+int8_t bigint_xor(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    return bigint_bitwise(result, a, b, BIGINT_BITWISE_OP_XOR);
+}
+
+int8_t bigint_not(bigint_t* result, const bigint_t* a) {
     if(!result || !a) {
         return -1;
     }
 
-    if(a->sign < 0 && a->neged_with_sign){
-        if(bigint_neg_with_sign_inplace((bigint_t*)a, true) == -1) {
-            return -1;
-        }
+    if (bigint_set_bigint(result, a) == -1) {
+        return -1;
     }
 
-    if (result == a) {
-        result->sign = -result->sign; // just change the sign
-
+    if (result->sign == 0) {
         return 0;
     }
 
-    // bigint_destroy_items(result);
+    uint64_t bits = bigint_bit_length(result);
 
-    if (a->sign == 0) {
-        return 0;
-    }
+    bits = (bits + BIGINT_NOT_WORD_BITS - 1) / BIGINT_NOT_WORD_BITS * BIGINT_NOT_WORD_BITS;
 
+    uint64_t count = (bits + BIGINT_LIMB_BITS - 1) / BIGINT_LIMB_BITS;
 
-    if (bigint_set_bigint(result, a) == -1) {
+    if (bigint_reserve(result, count) == -1) {
         return -1;
     }
 
-    result->sign = -result->sign;
+    for (uint64_t i = result->size; i < count; i++) {
+        result->limbs[i] = 0;
+    }
 
-    return 0;
-}
+    for (uint64_t i = 0; i < count; i++) {
+        result->limbs[i] = ~result->limbs[i];
+    }
 
-int8_t bigint_and(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
-        return -1;
+    if (bits % BIGINT_LIMB_BITS) {
+        result->limbs[count - 1] &= (1ULL << (bits % BIGINT_LIMB_BITS)) - 1;
     }
 
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
+    result->size = count;
 
-    if (result == a) {
-        result = bigint_create();
+    bigint_normalize(result);
 
-        if (!result) {
-            return -1;
-        }
+    return 0;
+}
+
+int8_t bigint_shl_one(bigint_t* a) {
+    return bigint_shl(a, a, 1);
+}
+
+int8_t bigint_shr_one(bigint_t* a) {
+    return bigint_shr(a, a, 1);
+}
 
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
+int8_t bigint_shl(bigint_t* result, const bigint_t* a, int64_t shift) {
+    if(!result || !a) {
+        return -1;
     }
 
-    if (a->sign == 0 || b->sign == 0) {
-        result->sign = 0;
+    if (shift < 0) {
+        return bigint_shr(result, a, -shift);
+    }
 
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
+    if (a->sign == 0) {
+        result->size = 0;
+        result->sign = 0;
 
         return 0;
     }
 
-    if (a->sign < 0 && b->sign < 0) {
-        result->sign = -1;
-    } else {
-        result->sign = 1;
-    }
+    uint64_t limb_shift = shift / BIGINT_LIMB_BITS;
+    uint64_t bit_shift = shift % BIGINT_LIMB_BITS;
+    uint64_t an = a->size;
+    int32_t sign = a->sign;
 
-    bigint_t* tmp_a = (bigint_t*)a;
-    bigint_t* tmp_b = (bigint_t*)b;
+    if (bigint_reserve(result, an + limb_shift + 1) == -1) {
+        return -1;
+    }
 
-    if (a->sign < 0) {
-        if(bigint_neg_with_sign_inplace(tmp_a, false) == -1) {
-            if(orig_result_is_a) {
-                bigint_destroy(result);
-            }
+    // walk from the top so result may alias a
+    const uint64_t* al = a->limbs;
+    uint64_t* rl = result->limbs;
 
-            return -1;
+    if (bit_shift == 0) {
+        for (uint64_t i = an; i-- > 0;) {
+            rl[i + limb_shift] = al[i];
         }
-    }
 
-    if (b->sign < 0) {
-        if(bigint_neg_with_sign_inplace(tmp_b, false) == -1) {
-            if(orig_result_is_a) {
-                bigint_destroy(result);
-            }
+        rl[an + limb_shift] = 0;
+    } else {
+        rl[an + limb_shift] = al[an - 1] >> (BIGINT_LIMB_BITS - bit_shift);
 
-            return -1;
+        for (uint64_t i = an - 1; i > 0; i--) {
+            rl[i + limb_shift] = (al[i] << bit_shift) | (al[i - 1] >> (BIGINT_LIMB_BITS - bit_shift));
         }
+
+        rl[limb_shift] = al[0] << bit_shift;
     }
 
-    uint64_t item_count = MAX(bigint_item_count(tmp_a), bigint_item_count(tmp_b));
+    for (uint64_t i = 0; i < limb_shift; i++) {
+        rl[i] = 0;
+    }
 
-    if (bigint_sign_extend(tmp_a, item_count) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    result->size = an + limb_shift + 1;
+    result->sign = sign;
 
-        return -1;
-    }
+    bigint_normalize(result);
 
-    if (bigint_sign_extend(tmp_b, item_count) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    return 0;
+}
 
+// rounds toward negative infinity like an arithmetic shift of the two's complement value
+int8_t bigint_shr(bigint_t* result, const bigint_t* a, int64_t shift) {
+    if(!result || !a) {
         return -1;
     }
 
-    bigint_item_t* item_a = tmp_a->lsb;
-    bigint_item_t* item_b = tmp_b->lsb;
-    bigint_item_t* prev = NULL;
-
-    while (item_a && item_b) {
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    if (shift < 0) {
+        return bigint_shl(result, a, -shift);
+    }
 
-        if (!item) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
+    uint64_t limb_shift = shift / BIGINT_LIMB_BITS;
+    uint64_t bit_shift = shift % BIGINT_LIMB_BITS;
+    uint64_t an = a->size;
+    int32_t sign = a->sign;
 
-            return -1;
+    if (sign == 0 || limb_shift >= an) {
+        if (sign < 0) {
+            return bigint_set_int64(result, -1);
         }
 
-        item->value = item_a->value & item_b->value;
+        result->size = 0;
+        result->sign = 0;
+
+        return 0;
+    }
 
-        item->prev = prev;
+    boolean_t lost_bits = false;
 
-        if (prev) {
-            prev->next = item;
+    if (sign < 0) {
+        for (uint64_t i = 0; i < limb_shift && !lost_bits; i++) {
+            lost_bits = a->limbs[i] != 0;
         }
 
-        if(!result->lsb) {
-            result->lsb = item;
+        if (bit_shift && (a->limbs[limb_shift] & ((1ULL << bit_shift) - 1))) {
+            lost_bits = true;
         }
-
-        prev = item;
-
-        item_a = item_a->next;
-        item_b = item_b->next;
     }
 
-    result->msb = prev;
+    uint64_t rn = an - limb_shift;
 
-    if(result->sign < 0) {
-        result->neged_with_sign = true;
+    if (bigint_reserve(result, rn + 1) == -1) {
+        return -1;
     }
 
-    if (bigint_remove_leading_zeros(result) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
+    // walk from the bottom so result may alias a
+    const uint64_t* al = a->limbs;
+    uint64_t* rl = result->limbs;
+
+    if (bit_shift == 0) {
+        for (uint64_t i = 0; i < rn; i++) {
+            rl[i] = al[i + limb_shift];
+        }
+    } else {
+        for (uint64_t i = 0; i + 1 < rn; i++) {
+            rl[i] = (al[i + limb_shift] >> bit_shift) | (al[i + limb_shift + 1] << (BIGINT_LIMB_BITS - bit_shift));
         }
 
-        return -1;
+        rl[rn - 1] = al[an - 1] >> bit_shift;
     }
 
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
+    result->size = rn;
+    result->sign = sign;
+
+    bigint_normalize(result);
+
+    if (lost_bits) {
+        result->sign = -1;
+
+        return bigint_inc_magnitude(result);
     }
 
     return 0;
 }
 
-static int8_t bigint_or_inplace(bigint_t* result, const bigint_t* a) {
-    if (result->sign == 0) {
-        return bigint_set_bigint(result, a);
+int8_t bigint_set_bit(bigint_t* bigint, uint64_t bit, boolean_t value) {
+    if(!bigint) {
+        return -1;
     }
 
-    if (a->sign == 0) {
-        return bigint_set_bigint(result, a);
-    }
+    uint64_t index = bit / BIGINT_LIMB_BITS;
+    uint64_t mask = 1ULL << (bit % BIGINT_LIMB_BITS);
 
-    if (result->sign < 0) {
-        if(bigint_neg_with_sign(result, result, false) == -1) {
-            return -1;
+    if (!value) {
+        if (index < bigint->size) {
+            bigint->limbs[index] &= ~mask;
+            bigint_normalize(bigint);
         }
-    }
 
-    if (result->sign > 0 && a->sign > 0) {
-        result->sign = 1;
-    } else {
-        result->sign = -1;
+        return 0;
     }
 
-    bigint_t* tmp_a = (bigint_t*)a;
-
-    if (a->sign < 0) {
-        if(bigint_neg_with_sign(tmp_a, tmp_a, false) == -1) {
+    if (index >= bigint->size) {
+        if (bigint_reserve(bigint, index + 1) == -1) {
             return -1;
         }
-    }
 
-    uint64_t item_count_a = bigint_item_count(a);
-
-    uint64_t item_count = MAX(bigint_item_count(result), item_count_a);
-
-    if (bigint_sign_extend(result, item_count) == -1) {
-        return -1;
-    }
+        for (uint64_t i = bigint->size; i <= index; i++) {
+            bigint->limbs[i] = 0;
+        }
 
-    if (bigint_sign_extend(tmp_a, item_count) == -1) {
-        return -1;
+        bigint->size = index + 1;
     }
 
+    bigint->limbs[index] |= mask;
 
-    bigint_item_t* item_a = tmp_a->lsb;
-    bigint_item_t* item_result = result->lsb;
+    if (bigint->sign == 0) {
+        bigint->sign = 1;
+    }
 
-    while (item_a && item_result) {
-        item_result->value |= item_a->value;
+    return 0;
+}
 
-        item_a = item_a->next;
-        item_result = item_result->next;
+int8_t bigint_get_bit(const bigint_t* bigint, uint64_t bit, boolean_t* value) {
+    if(!bigint || !value) {
+        return -1;
     }
 
-    if(result->sign < 0) {
-        result->neged_with_sign = true;
-    }
+    uint64_t index = bit / BIGINT_LIMB_BITS;
 
-    if (bigint_remove_leading_zeros(result) == -1) {
-        return -1;
+    if (index >= bigint->size) {
+        *value = false;
+    } else {
+        *value = (bigint->limbs[index] >> (bit % BIGINT_LIMB_BITS)) & 1;
     }
 
     return 0;
 }
 
-int8_t bigint_or(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
+int8_t bigint_flip_bit(bigint_t* bigint, uint64_t bit) {
+    boolean_t value = false;
+
+    if (bigint_get_bit(bigint, bit, &value) == -1) {
         return -1;
     }
 
-    if (result == a) {
-        return bigint_or_inplace(result, b);
-    }
+    return bigint_set_bit(bigint, bit, !value);
+}
 
-    bigint_destroy_items(result);
+int8_t bigint_clear_bit(bigint_t* bigint, uint64_t bit) {
+    return bigint_set_bit(bigint, bit, false);
+}
 
-    if (a->sign == 0) {
-        return bigint_set_bigint(result, b);
+int8_t bigint_sub(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) {
+        return -1;
     }
 
-    if (b->sign == 0) {
-        return bigint_set_bigint(result, a);
+    return bigint_add_signed(result, a, b, -b->sign);
+}
+
+int8_t bigint_add(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) {
+        return -1;
     }
 
-    if (a->sign > 0 && b->sign > 0) {
-        result->sign = 1;
-    } else {
-        result->sign = -1;
+    return bigint_add_signed(result, a, b, b->sign);
+}
+
+uint64_t bigint_bit_length(const bigint_t* bigint) {
+    if(!bigint || bigint->size == 0) {
+        return 0;
     }
 
-    bigint_t* tmp_a = (bigint_t*)a;
-    bigint_t* tmp_b = (bigint_t*)b;
+    return (bigint->size - 1) * BIGINT_LIMB_BITS + bit_most_significant(bigint->limbs[bigint->size - 1]) + 1;
+}
 
-    if (tmp_a->sign < 0) {
-        if(bigint_neg_with_sign(tmp_a, tmp_a, false) == -1) {
-            return -1;
-        }
+int8_t bigint_cmp(const bigint_t* a, const bigint_t* b) {
+    if(!a || !b) {
+        return -1;
     }
 
-    if (tmp_b->sign < 0) {
-        if(bigint_neg_with_sign(tmp_b, tmp_b, false) == -1) {
-            return -1;
-        }
+    if (a->sign != b->sign) {
+        return a->sign < b->sign ? -1 : 1;
+    }
+
+    if (a->sign == 0) {
+        return 0;
     }
 
-    uint64_t item_count = MAX(bigint_item_count(tmp_a), bigint_item_count(tmp_b));
+    int8_t cmp = bigint_limbs_cmp(a->limbs, a->size, b->limbs, b->size);
+
+    return a->sign < 0 ? -cmp : cmp;
+}
 
-    if (bigint_sign_extend(tmp_a, item_count) == -1) {
+int8_t bigint_mul(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) {
         return -1;
     }
 
-    if (bigint_sign_extend(tmp_b, item_count) == -1) {
-        return -1;
+    if (a->sign == 0 || b->sign == 0) {
+        result->size = 0;
+        result->sign = 0;
+
+        return 0;
     }
 
-    bigint_item_t* item_a = tmp_a->lsb;
-    bigint_item_t* item_b = tmp_b->lsb;
-    bigint_item_t* prev = NULL;
+    uint64_t n = a->size + b->size;
+    int32_t sign = a->sign * b->sign;
 
-    while (item_a && item_b) {
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    if (result != a && result != b) {
+        result->size = 0;
 
-        if (!item) {
+        if (bigint_reserve(result, n) == -1) {
             return -1;
         }
 
-        item->value = item_a->value | item_b->value;
-
-        item->prev = prev;
-
-        if (prev) {
-            prev->next = item;
+        if (bigint_limbs_mul(result->limbs, a->limbs, a->size, b->limbs, b->size) == -1) {
+            return -1;
         }
+    } else {
+        // product can not overlap its operands, build it aside and adopt the array
+        uint64_t capacity = MAX(n, BIGINT_MIN_CAPACITY);
+        uint64_t* limbs = memory_malloc(capacity * sizeof(uint64_t));
 
-        if(!result->lsb) {
-            result->lsb = item;
+        if (!limbs) {
+            return -1;
         }
 
-        prev = item;
+        if (bigint_limbs_mul(limbs, a->limbs, a->size, b->limbs, b->size) == -1) {
+            memory_free(limbs);
 
-        item_a = item_a->next;
-        item_b = item_b->next;
-    }
+            return -1;
+        }
 
-    result->msb = prev;
+        memory_free(result->limbs);
 
-    if(result->sign < 0) {
-        result->neged_with_sign = true;
+        result->limbs = limbs;
+        result->capacity = capacity;
     }
 
-    if (bigint_remove_leading_zeros(result) == -1) {
-        return -1;
-    }
+    result->size = n;
+    result->sign = sign;
+
+    bigint_normalize(result);
 
     return 0;
 }
 
-int8_t bigint_xor(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+int8_t bigint_pow(bigint_t* result, const bigint_t* a, const bigint_t* b) {
     if(!result || !a || !b) {
         return -1;
     }
 
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
-
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
-
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
+    if ((a->sign == 0 && b->sign == 0) || b->sign < 0) {
+        return -1;
     }
 
     if (a->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+        result->size = 0;
+        result->sign = 0;
 
-        return bigint_set_bigint(orig_result, b);
+        return 0;
     }
 
-    if (b->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
+    bigint_t* acc = bigint_one();
+    bigint_t* tmp = bigint_create();
 
-            return 0; // result is already a
-        }
+    if (!acc || !tmp) {
+        bigint_destroy(acc);
+        bigint_destroy(tmp);
 
-        return bigint_set_bigint(orig_result, a);
+        return -1;
     }
 
-    if (a->sign < 0 && b->sign < 0) {
-        result->sign = 1;
-    } else if (a->sign > 0 && b->sign > 0) {
-        result->sign = 1;
-    } else {
-        result->sign = -1;
-    }
+    // left to right square and multiply, tmp keeps its limbs between steps
+    for (uint64_t bit = bigint_bit_length(b); bit-- > 0;) {
+        boolean_t set = false;
 
-    bigint_t* tmp_a = (bigint_t*)a;
-    bigint_t* tmp_b = (bigint_t*)b;
+        if (bigint_mul(tmp, acc, acc) == -1) {
+            goto error;
+        }
 
-    if (tmp_a->sign < 0) {
-        if(bigint_neg_with_sign(tmp_a, tmp_a, false) == -1) {
-            if(orig_result_is_a) {
-                bigint_destroy(result);
-            }
+        bigint_swap(acc, tmp);
 
-            return -1;
-        }
-    }
+        bigint_get_bit(b, bit, &set);
 
-    if (tmp_b->sign < 0) {
-        if(bigint_neg_with_sign(tmp_b, tmp_b, false) == -1) {
-            if(orig_result_is_a) {
-                bigint_destroy(result);
+        if (set) {
+            if (bigint_mul(tmp, acc, a) == -1) {
+                goto error;
             }
 
-            return -1;
+            bigint_swap(acc, tmp);
         }
     }
 
-    uint64_t item_count = MAX(bigint_item_count(tmp_a), bigint_item_count(tmp_b));
+    bigint_swap(result, acc);
 
-    if (bigint_sign_extend(tmp_a, item_count) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    bigint_destroy(acc);
+    bigint_destroy(tmp);
 
-        return -1;
-    }
+    return 0;
 
-    if (bigint_sign_extend(tmp_b, item_count) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+error:
+    bigint_destroy(acc);
+    bigint_destroy(tmp);
+
+    return -1;
+}
 
+int8_t bigint_mul_mod(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c) {
+    if(!result || !a || !b || !c) {
         return -1;
     }
 
-    bigint_item_t* item_a = tmp_a->lsb;
-    bigint_item_t* item_b = tmp_b->lsb;
-    bigint_item_t* prev = NULL;
+    if (c->sign == 0) {
+        return -1;
+    }
 
-    while (item_a && item_b) {
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    bigint_t* tmp = bigint_create();
 
-        if (!item) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
+    if (!tmp) {
+        return -1;
+    }
 
-            return -1;
-        }
+    int8_t res = bigint_mul(tmp, a, b);
 
-        item->value = item_a->value ^ item_b->value;
+    if (res == 0) {
+        res = bigint_mod(result, tmp, c);
+    }
 
-        item->prev = prev;
+    bigint_destroy(tmp);
 
-        if (prev) {
-            prev->next = item;
-        }
+    return res;
+}
 
-        if(!result->lsb) {
-            result->lsb = item;
-        }
+/*
+ * montgomery arithmetic for odd moduli. values inside the context are kept as
+ * fixed size k limb arrays so squaring, reduction and table scans do not depend
+ * on operand values.
+ */
 
-        prev = item;
+struct bigint_montgomery_t {
+    bigint_t* modulus; ///< |modulus|, odd and greater than one
+    uint64_t  size; ///< k, modulus limb count
+    uint64_t  n0inv; ///< -modulus^-1 mod 2^64
+    uint64_t* r2; ///< R^2 mod n, R = 2^(64k)
+    uint64_t* one; ///< R mod n, one in montgomery form
+    uint64_t* product; ///< 2k + 2 limbs for products before reduction
+    uint64_t* scratch; ///< karatsuba scratch for k limb products
+};
 
-        item_a = item_a->next;
-        item_b = item_b->next;
-    }
+// t has 2k limbs and is destroyed, r = t * R^-1 mod n with k limbs
+static void bigint_montgomery_reduce(const bigint_montgomery_t* ctx, uint64_t* r, uint64_t* t) {
+    uint64_t k = ctx->size;
+    const uint64_t* n = ctx->modulus->limbs;
+    uint64_t hi_carry = 0;
 
-    result->msb = prev;
+    for (uint64_t i = 0; i < k; i++) {
+        uint64_t m = t[i] * ctx->n0inv;
+        uint64_t c = bigint_limbs_addmul_1(t + i, n, k, m);
+        uint128_t s = (uint128_t)t[i + k] + c + hi_carry;
 
-    if(result->sign < 0) {
-        result->neged_with_sign = true;
+        t[i + k] = (uint64_t)s;
+        hi_carry = (uint64_t)(s >> 64);
     }
 
-    if (bigint_remove_leading_zeros(result) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
+    // t / R < 2n, subtract n when it does not borrow or the value passed R, select without branching
+    // the low half of t is all zeros now and holds the difference
+    uint64_t* hi = t + k;
+    uint64_t borrow = bigint_limbs_sub(t, hi, k, n, k);
+    uint64_t mask = 0 - (hi_carry | (borrow ^ 1));
 
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
+    for (uint64_t i = 0; i < k; i++) {
+        r[i] = (t[i] & mask) | (hi[i] & ~mask);
     }
+}
 
-    return 0;
+// r = a * b * R^-1 mod n, all k limbs, r may alias a or b
+static void bigint_montgomery_mul(const bigint_montgomery_t* ctx, uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    bigint_limbs_mul_n(ctx->product, a, b, ctx->size, ctx->scratch);
+    bigint_montgomery_reduce(ctx, r, ctx->product);
 }
 
-static int8_t bigint_not_inplace(bigint_t* a) {
-    if(!a) {
-        return -1;
+bigint_montgomery_t* bigint_montgomery_create(const bigint_t* modulus) {
+    if (!modulus || !bigint_is_odd(modulus) || (modulus->size == 1 && modulus->limbs[0] == 1)) {
+        return NULL;
     }
 
-    if (a->sign == 0) {
-        return 0;
-    }
+    bigint_montgomery_t* ctx = memory_malloc(sizeof(bigint_montgomery_t));
 
-    bigint_item_t* item = a->lsb;
+    if (!ctx) {
+        return NULL;
+    }
 
-    while (item) {
-        item->value = ~item->value;
-        item->value &= BIGINT_ITEM_MAX;
+    uint64_t k = modulus->size;
 
-        item = item->next;
-    }
+    ctx->size = k;
+    ctx->modulus = bigint_clone(modulus);
 
-    return 0;
-}
+    // r2, one, product and one 2k+1 limb power of R share a single allocation with the scratch
+    uint64_t scratch_size = bigint_limbs_karatsuba_scratch_size(k);
+    uint64_t* limbs = memory_malloc((k + k + (2 * k + 2) + (2 * k + 1) + scratch_size) * sizeof(uint64_t));
 
-int8_t bigint_not(bigint_t* result, const bigint_t* a) {
-    if(!result || !a) {
-        return -1;
-    }
+    if (!ctx->modulus || !limbs) {
+        bigint_destroy(ctx->modulus);
+        memory_free(limbs);
+        memory_free(ctx);
 
-    if(result == a) {
-        return bigint_not_inplace(result);
+        return NULL;
     }
 
-    bigint_destroy_items(result);
+    ctx->modulus->sign = 1;
+    ctx->r2 = limbs;
+    ctx->one = ctx->r2 + k;
+    ctx->product = ctx->one + k;
 
-    result->sign = a->sign;
+    uint64_t* power = ctx->product + 2 * k + 2;
 
-    bigint_item_t* item = a->lsb;
-    bigint_item_t* prev = NULL;
+    ctx->scratch = power + 2 * k + 1;
 
-    while (item) {
-        bigint_item_t* next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    // newton iteration, an odd n0 is its own inverse modulo 8 and each step doubles the correct bits
+    uint64_t n0 = modulus->limbs[0];
+    uint64_t inv = n0;
 
-        next->value = ~item->value;
-
-        next->value &= BIGINT_ITEM_MAX;
+    for (int32_t i = 0; i < 5; i++) {
+        inv *= 2 - n0 * inv;
+    }
 
-        next->prev = prev;
+    ctx->n0inv = 0 - inv;
 
-        if (prev) {
-            prev->next = next;
-        } else {
-            result->lsb = next;
-        }
+    // quotients of the power divisions land in product, at most k + 2 limbs
+    memory_memclean(power, (2 * k + 1) * sizeof(uint64_t));
+    power[k] = 1;
 
-        prev = next;
+    if (bigint_limbs_divmod(ctx->product, ctx->one, power, k + 1, modulus->limbs, k) == -1) {
+        bigint_montgomery_destroy(ctx);
 
-        item = item->next;
+        return NULL;
     }
 
-    result->msb = prev;
+    power[k] = 0;
+    power[2 * k] = 1;
 
-    return 0;
-}
+    if (bigint_limbs_divmod(ctx->product, ctx->r2, power, 2 * k + 1, modulus->limbs, k) == -1) {
+        bigint_montgomery_destroy(ctx);
 
-int8_t bigint_shl_one(bigint_t* a) {
-    if(!a) {
-        return -1;
+        return NULL;
     }
 
-    if(a->sign == 0) {
-        return 0;
-    }
+    return ctx;
+}
 
-    bigint_item_t* item = a->lsb;
-    uint64_t carry = 0;
+void bigint_montgomery_destroy(bigint_montgomery_t* ctx) {
+    if (!ctx) {
+        return;
+    }
 
-    while (item) {
-        uint64_t next_carry = item->value >> (BIGINT_ITEM_BITS - 1);
+    bigint_destroy(ctx->modulus);
+    memory_free(ctx->r2);
+    memory_free(ctx);
+}
 
-        item->value <<= 1;
-        item->value |= carry;
+// dst = value mod n in montgomery form, k limbs
+static int8_t bigint_montgomery_to(const bigint_montgomery_t* ctx, uint64_t* dst, const bigint_t* value) {
+    bigint_t* reduced = bigint_create();
 
-        carry = next_carry;
+    if (!reduced) {
+        return -1;
+    }
 
-        item->value &= BIGINT_ITEM_MAX;
+    if (bigint_mod(reduced, value, ctx->modulus) == -1) {
+        bigint_destroy(reduced);
 
-        item = item->next;
+        return -1;
     }
 
-    if (carry) {
-        bigint_item_t* next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-        if (!next) {
-            return -1;
-        }
+    memory_memclean(dst, ctx->size * sizeof(uint64_t));
 
-        if(a->sign < 0 && a->neged_with_sign) {
-            next->value = BIGINT_ITEM_MAX;
-        } else {
-            next->value = carry;
-        }
+    if (reduced->size) {
+        memory_memcopy(reduced->limbs, dst, reduced->size * sizeof(uint64_t));
+    }
 
-        next->next = NULL;
-        next->prev = a->msb;
+    bigint_destroy(reduced);
 
-        a->msb->next = next;
-        a->msb = next;
-    }
+    bigint_montgomery_mul(ctx, dst, dst, ctx->r2);
 
     return 0;
 }
 
-int8_t bigint_shr_one(bigint_t* a) {
-    if(!a) {
-        return -1;
-    }
-
-    if(a->sign == 0) {
-        return 0;
-    }
+// result = src out of montgomery form
+static int8_t bigint_montgomery_from(const bigint_montgomery_t* ctx, bigint_t* result, const uint64_t* src) {
+    uint64_t k = ctx->size;
 
-    bigint_item_t* item = a->msb;
-    uint64_t carry = (a->sign < 0 && a->neged_with_sign) ? BIGINT_ITEM_MSB : 0;
+    memory_memcopy(src, ctx->product, k * sizeof(uint64_t));
+    memory_memclean(ctx->product + k, k * sizeof(uint64_t));
 
-    while (item) {
-        uint64_t next_carry = item->value & 1;
+    result->size = 0;
 
-        item->value = carry | (item->value >> 1);
+    if (bigint_reserve(result, k) == -1) {
+        return -1;
+    }
 
-        carry = next_carry << (BIGINT_ITEM_BITS - 1);
+    bigint_montgomery_reduce(ctx, result->limbs, ctx->product);
 
-        item = item->prev;
-    }
+    result->size = k;
+    result->sign = 1;
 
-    bigint_remove_leading_zeros(a);
+    bigint_normalize(result);
 
     return 0;
 }
 
-int8_t bigint_shl(bigint_t* result, const bigint_t* a, int64_t shift) {
-    if(!result || !a) {
+int8_t bigint_montgomery_mul_mod(bigint_montgomery_t* ctx, bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    if (!ctx || !result || !a || !b) {
         return -1;
     }
 
-    if (a->sign == 0) {
-        return 0;
-    }
+    uint64_t k = ctx->size;
+    uint64_t* limbs = memory_malloc(2 * k * sizeof(uint64_t));
 
-    if (shift < 0) {
-        return bigint_shr(result, a, -shift);
+    if (!limbs) {
+        return -1;
     }
 
-    result->sign = a->sign;
-    result->neged_with_sign = a->neged_with_sign;
-
-    int64_t item_shift = shift / BIGINT_ITEM_BITS;
-    int64_t bit_shift = shift % BIGINT_ITEM_BITS;
+    uint64_t* am = limbs;
+    uint64_t* bm = limbs + k;
 
-    uint64_t result_bit_count = bigint_bit_length(a) + bit_shift + 1;
+    if (bigint_montgomery_to(ctx, am, a) == -1 || bigint_montgomery_to(ctx, bm, b) == -1) {
+        memory_free(limbs);
 
-    uint64_t result_item_count = result_bit_count / BIGINT_ITEM_BITS;
-
-    if (result_bit_count % BIGINT_ITEM_BITS) {
-        result_item_count++;
-    }
-
-    if (bigint_sign_extend(result, result_item_count) == -1) {
         return -1;
     }
 
-    uint64_t carry = 0;
+    bigint_montgomery_mul(ctx, am, am, bm);
 
-    bigint_item_t* item = a->lsb;
-    bigint_item_t* item_result = result->lsb;
+    int8_t res = bigint_montgomery_from(ctx, result, am);
 
-    while (item) {
-        uint64_t next_carry = item->value >> (BIGINT_ITEM_BITS - bit_shift);
+    memory_free(limbs);
 
-        item_result->value = (item->value << bit_shift) | carry;
-        item_result->value &= BIGINT_ITEM_MAX;
+    return res;
+}
 
-        carry = next_carry;
+// reads count (<= 64) exponent bits starting at bit, bits past the top read as zero
+static uint64_t bigint_montgomery_exponent_bits(const bigint_t* exponent, uint64_t bit, uint64_t count) {
+    uint64_t index = bit / BIGINT_LIMB_BITS;
+    uint64_t offset = bit % BIGINT_LIMB_BITS;
 
-        item = item->next;
-        item_result = item_result->next;
+    if (index >= exponent->size) {
+        return 0;
     }
 
-    if (carry) {
-        if(!item_result) {
-            item_result = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+    uint64_t value = exponent->limbs[index] >> offset;
 
-            if (!item_result) {
-                return -1;
-            }
+    if (offset && index + 1 < exponent->size) {
+        value |= exponent->limbs[index + 1] << (BIGINT_LIMB_BITS - offset);
+    }
 
-            item_result->next = NULL;
-            item_result->prev = result->msb;
+    if (count < BIGINT_LIMB_BITS) {
+        value &= (1ULL << count) - 1;
+    }
 
-            result->msb->next = item_result;
-            result->msb = item_result;
-        }
+    return value;
+}
 
-        if(result->sign < 0 && result->neged_with_sign) {
-            uint64_t msb_bit_pos = bit_most_significant(carry);
-            uint64_t mask = (BIGINT_ITEM_MAX - (BIGINT_ITEM_MAX >> (BIGINT_ITEM_BITS - msb_bit_pos)));
-            item_result->value = carry | mask;
-        } else {
-            item_result->value = carry;
-        }
+// acc = base^exponent, every window does the same squarings and one multiply by a table entry picked with a full scan
+static void bigint_montgomery_pow_fixed_window(const bigint_montgomery_t* ctx, uint64_t* acc, uint64_t* table, uint64_t* entry,
+                                               const bigint_t* exponent) {
+    uint64_t k = ctx->size;
+    uint64_t window = (exponent->size * BIGINT_LIMB_BITS > 512) ? 5 : 4;
+    uint64_t entries = 1ULL << window;
 
-        item_result = item_result->next;
+    // table[i] = base^i, table[1] is filled by the caller
+    memory_memcopy(ctx->one, table, k * sizeof(uint64_t));
+
+    for (uint64_t i = 2; i < entries; i++) {
+        bigint_montgomery_mul(ctx, table + i * k, table + (i - 1) * k, table + k);
     }
 
-    while (item_result) {
-        item_result->value = 0;
+    memory_memcopy(ctx->one, acc, k * sizeof(uint64_t));
 
-        item_result = item_result->next;
-    }
+    // only the exponent limb count decides the loop length, never its value
+    uint64_t bits = exponent->size * BIGINT_LIMB_BITS;
+    uint64_t windows = (bits + window - 1) / window;
 
-    if (item_shift) {
-        bigint_item_t* prev = result->lsb;
+    for (uint64_t w = windows; w-- > 0;) {
+        for (uint64_t i = 0; i < window; i++) {
+            bigint_montgomery_mul(ctx, acc, acc, acc);
+        }
 
-        for (int64_t i = 0; i < item_shift; i++) {
-            bigint_item_t* next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+        uint64_t digit = bigint_montgomery_exponent_bits(exponent, w * window, window);
 
-            next->value = 0;
+        memory_memclean(entry, k * sizeof(uint64_t));
 
-            prev->prev = next;
-            next->next = prev;
+        for (uint64_t i = 0; i < entries; i++) {
+            uint64_t diff = i ^ digit;
+            uint64_t mask = ((diff | (0 - diff)) >> 63) - 1;
 
-            prev = next;
+            for (uint64_t j = 0; j < k; j++) {
+                entry[j] |= table[i * k + j] & mask;
+            }
         }
 
-        result->lsb = prev;
+        bigint_montgomery_mul(ctx, acc, acc, entry);
     }
-
-    return 0;
 }
 
-int8_t bigint_shr(bigint_t* result, const bigint_t* a, int64_t shift) {
-    if(!result || !a) {
-        return -1;
-    }
-
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
+// acc = base^exponent, skips zero runs and multiplies by odd powers only
+static void bigint_montgomery_pow_sliding_window(const bigint_montgomery_t* ctx, uint64_t* acc, uint64_t* table, uint64_t* entry,
+                                                 const bigint_t* exponent) {
+    uint64_t k = ctx->size;
+    uint64_t bits = bigint_bit_length(exponent);
+    uint64_t window = (bits > 671) ? 6 : (bits > 239) ? 5 : (bits > 79) ? 4 : (bits > 23) ? 3 : 1;
+    uint64_t entries = 1ULL << (window - 1);
 
-    if (result == a) {
-        result = bigint_create();
+    // table[i] = base^(2i + 1), table[0] is filled by the caller
+    if (entries > 1) {
+        bigint_montgomery_mul(ctx, entry, table, table);
 
-        if (!result) {
-            return -1;
+        for (uint64_t i = 1; i < entries; i++) {
+            bigint_montgomery_mul(ctx, table + i * k, table + (i - 1) * k, entry);
         }
-
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
     }
 
-    if (a->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    boolean_t started = false;
+    int64_t bit = bits - 1;
 
-        return 0;
-    }
+    while (bit >= 0) {
+        if (!bigint_montgomery_exponent_bits(exponent, bit, 1)) {
+            if (started) {
+                bigint_montgomery_mul(ctx, acc, acc, acc);
+            }
 
-    if (shift < 0) {
-        return bigint_shl(result, a, -shift);
-    }
+            bit--;
 
-    result->sign = a->sign;
-    result->neged_with_sign = a->neged_with_sign;
+            continue;
+        }
 
-    int64_t item_shift = shift / BIGINT_ITEM_BITS;
-    int64_t bit_shift = shift % BIGINT_ITEM_BITS;
+        // longest window ending in a set bit
+        int64_t low = MAX(bit - (int64_t)window + 1, 0);
 
-    bigint_item_t* item = a->msb;
-    bigint_item_t* prev = NULL;
-    // if a is negative and neged with sign then
-    // carry's left bit_shift bits are 1
-    uint64_t carry = (a->sign < 0 && a->neged_with_sign) ? (BIGINT_ITEM_MAX - (BIGINT_ITEM_MAX >> bit_shift)) : 0;
+        while (!bigint_montgomery_exponent_bits(exponent, low, 1)) {
+            low++;
+        }
 
-    while (item) {
-        bigint_item_t* next = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
+        uint64_t digit = bigint_montgomery_exponent_bits(exponent, low, bit - low + 1);
 
-        if (!next) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
+        if (started) {
+            for (int64_t i = low; i <= bit; i++) {
+                bigint_montgomery_mul(ctx, acc, acc, acc);
             }
 
-            return -1;
+            bigint_montgomery_mul(ctx, acc, acc, table + (digit >> 1) * k);
+        } else {
+            memory_memcopy(table + (digit >> 1) * k, acc, k * sizeof(uint64_t));
+            started = true;
         }
 
-        next->value = carry | item->value >> bit_shift;
+        bit = low - 1;
+    }
 
-        carry = item->value << (BIGINT_ITEM_BITS - bit_shift);
-        carry &= BIGINT_ITEM_MAX;
+    if (!started) {
+        memory_memcopy(ctx->one, acc, k * sizeof(uint64_t));
+    }
+}
 
-        if (prev) {
-            prev->prev = next;
-        } else {
-            result->msb = next;
-        }
+int8_t bigint_montgomery_pow(bigint_montgomery_t* ctx, bigint_t* result, const bigint_t* base, const bigint_t* exponent,
+                             bigint_montgomery_pow_mode_t mode) {
+    if (!ctx || !result || !base || !exponent) {
+        return -1;
+    }
 
-        next->next = prev;
+    if (exponent->sign < 0) {
+        return -1;
+    }
 
-        prev = next;
+    uint64_t k = ctx->size;
+    uint64_t* limbs = memory_malloc((BIGINT_MONTGOMERY_TABLE_ENTRIES + 2) * k * sizeof(uint64_t));
 
-        item = item->prev;
+    if (!limbs) {
+        return -1;
     }
 
-    result->lsb = prev;
+    uint64_t* acc = limbs;
+    uint64_t* entry = acc + k;
+    uint64_t* table = entry + k;
+    uint64_t* base_mont = (mode == BIGINT_MONTGOMERY_POW_MODE_FIXED_WINDOW) ? table + k : table;
 
-    if (item_shift) {
-        // remove the first item_shift items
-        prev = result->lsb;
+    if (bigint_montgomery_to(ctx, base_mont, base) == -1) {
+        memory_free(limbs);
 
-        for (int64_t i = 0; i < item_shift; i++) {
-            if (!prev) {
-                break;
-            }
+        return -1;
+    }
 
-            bigint_item_t* next = prev->next;
+    if (mode == BIGINT_MONTGOMERY_POW_MODE_FIXED_WINDOW) {
+        bigint_montgomery_pow_fixed_window(ctx, acc, table, entry, exponent);
+    } else {
+        bigint_montgomery_pow_sliding_window(ctx, acc, table, entry, exponent);
+    }
 
-            memory_free(prev);
+    int8_t res = bigint_montgomery_from(ctx, result, acc);
 
-            prev = next;
-        }
+    memory_free(limbs);
 
-        result->lsb = prev;
+    return res;
+}
 
-        if (prev) {
-            prev->prev = NULL;
-        }
+int8_t bigint_pow_mod(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c) {
+    if(!result || !a || !b || !c) {
+        return -1;
     }
 
-    if (result->lsb == NULL) {
-        result->msb = NULL;
+    if ((a->sign == 0 && b->sign == 0) || b->sign < 0 || c->sign == 0) {
+        return -1;
     }
 
-    if (bigint_remove_leading_zeros(result) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    if (a->sign == 0) {
+        result->size = 0;
+        result->sign = 0;
 
-        return -1;
+        return 0;
     }
 
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
+    if (b->sign == 0) {
+        return bigint_set_uint64(result, 1);
     }
 
-    return 0;
-}
-
-int8_t bigint_set_bit(bigint_t* bigint, uint64_t bit, boolean_t value) {
-    if(!bigint) {
-        return -1;
-    }
-
-    if (bigint->sign == 0) {
-        if (value) {
-            bigint->sign = 1;
-            bigint->lsb = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-            if (!bigint->lsb) {
-                return -1;
-            }
-
-            bigint->lsb->value = 0;
-            bigint->lsb->next = NULL;
-            bigint->lsb->prev = NULL;
-            bigint->msb = bigint->lsb;
-        } else {
-            return 0;
-        }
-    }
-
-    bigint_item_t* item = bigint->lsb;
-    uint64_t item_bit = bit % BIGINT_ITEM_BITS;
-
-    for (uint64_t i = 0; i < bit / BIGINT_ITEM_BITS; i++) {
-        if (!item) {
-            item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-            if (!item) {
-                return -1;
-            }
-
-            item->value = 0;
-            item->next = NULL;
-            item->prev = bigint->msb;
-
-            bigint->msb->next = item;
-            bigint->msb = item;
-        }
-
-        item = item->next;
-    }
-
-    if (!item) {
-        item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-        if (!item) {
-            return -1;
-        }
-
-        item->value = 0;
-        item->next = NULL;
-        item->prev = bigint->msb;
-
-        bigint->msb->next = item;
-        bigint->msb = item;
-    }
-
-    if (value) {
-        item->value |= 1ULL << item_bit;
-    } else {
-        item->value &= ~(1ULL << item_bit);
-    }
-
-    return 0;
-}
-
-int8_t bigint_get_bit(const bigint_t* bigint, uint64_t bit, boolean_t* value) {
-    if(!bigint || !value) {
-        return -1;
-    }
-
-    if (bigint->sign == 0) {
-        *value = false;
-        return 0;
-    }
-
-    bigint_item_t* item = bigint->lsb;
-    uint64_t item_bit = bit % BIGINT_ITEM_BITS;
-
-    for (uint64_t i = 0; i < bit / BIGINT_ITEM_BITS; i++) {
-        if (!item) {
-            *value = false;
-            return 0;
-        }
-
-        item = item->next;
-    }
-
-    if (!item) {
-        *value = false;
-        return 0;
-    }
-
-    *value = (item->value >> item_bit) & 1;
-
-    return 0;
-}
-
-int8_t bigint_flip_bit(bigint_t* bigint, uint64_t bit) {
-    if(!bigint) {
-        return -1;
-    }
-
-    if (bigint->sign == 0) {
-        bigint->sign = 1;
-        bigint->lsb = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-        if (!bigint->lsb) {
-            return -1;
-        }
-
-        bigint->lsb->value = 0;
-        bigint->lsb->next = NULL;
-        bigint->lsb->prev = NULL;
-        bigint->msb = bigint->lsb;
-    }
-
-    bigint_item_t* item = bigint->lsb;
-    uint64_t item_bit = bit % BIGINT_ITEM_BITS;
-
-    for (uint64_t i = 0; i < bit / BIGINT_ITEM_BITS; i++) {
-        if (!item) {
-            item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-            if (!item) {
-                return -1;
-            }
-
-            item->value = 0;
-            item->next = NULL;
-            item->prev = bigint->msb;
-
-            bigint->msb->next = item;
-            bigint->msb = item;
-        }
-
-        item = item->next;
-    }
-
-    if (!item) {
-        item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-        if (!item) {
-            return -1;
-        }
-
-        item->value = 0;
-        item->next = NULL;
-        item->prev = bigint->msb;
-
-        bigint->msb->next = item;
-        bigint->msb = item;
-    }
-
-    item->value ^= 1ULL << item_bit;
-
-    return 0;
-}
-
-int8_t bigint_clear_bit(bigint_t* bigint, uint64_t bit) {
-    if(!bigint) {
-        return -1;
-    }
-
-    if (bigint->sign == 0) {
-        return 0;
-    }
-
-    bigint_item_t* item = bigint->lsb;
-    uint64_t item_bit = bit % BIGINT_ITEM_BITS;
-
-    for (uint64_t i = 0; i < bit / BIGINT_ITEM_BITS; i++) {
-        if (!item) {
-            return 0;
-        }
-
-        item = item->next;
-    }
-
-    if (!item) {
-        return 0;
-    }
-
-    item->value &= ~(1ULL << item_bit);
-
-    return 0;
-}
-
-int8_t bigint_sub(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
-        return -1;
-    }
-
-    if (a->sign == 0) {
-        return bigint_neg(result, b);
-    }
-
-    if(b->sign == 0) {
-        if(a == result) {
-            return 0;
-        }
-
-        return bigint_set_bigint(result, a);
-    }
-
-    uint64_t a_item_count = bigint_item_count(a);
-    uint64_t b_item_count = bigint_item_count(b);
-
-    uint64_t result_item_count = MAX(a_item_count, b_item_count);
-
-    bigint_t* tmp_a = (bigint_t*)a;
-    bigint_t* tmp_b = (bigint_t*)b;
-
-    if (tmp_a->sign < 0) {
-        if(bigint_neg_with_sign(tmp_a, tmp_a, false) == -1) {
-            return -1;
-        }
-    }
-
-    if (tmp_b->sign < 0) {
-        if(bigint_neg_with_sign(tmp_b, tmp_b, false) == -1) {
-            return -1;
-        }
-    }
-
-    if (bigint_sign_extend(tmp_a, result_item_count) == -1) {
-        return -1;
-    }
-
-    if (bigint_sign_extend(tmp_b, result_item_count) == -1) {
-        return -1;
-    }
-
-    if(a != result) {
-        if (bigint_sign_extend(result, result_item_count) == -1) {
-            return -1;
-        }
-    }
-
-    bigint_item_t* item_a = tmp_a->lsb;
-    bigint_item_t* item_b = tmp_b->lsb;
-    bigint_item_t* item_result = result->lsb;
-
-    uint64_t borrow = 0;
-
-    while (item_a && item_b) {
-        uint64_t a_value = item_a->value;
-        uint64_t b_value = item_b->value;
-        boolean_t next_borrow = false;
-
-        if (borrow) {
-            if (a_value == 0) {
-                a_value = BIGINT_ITEM_MAX;
-                next_borrow = true;
-            } else {
-                a_value--;
-            }
-        }
-
-        if (a_value < b_value) {
-            borrow = 1;
-            a_value += BIGINT_ITEM_MAX + 1;
-        } else if (!next_borrow) {
-            borrow = 0;
-        }
-
-        item_result->value = a_value - b_value;
-        item_result->value &= BIGINT_ITEM_MAX;
-
-        item_a = item_a->next;
-        item_b = item_b->next;
-        item_result = item_result->next;
-    }
-
-    if(item_result) {
-        printf("do we hit?\n");
-        bigint_item_t* tmp = item_result;
-
-        while(tmp) {
-            tmp->value = 0;
-            tmp = tmp->next;
-        }
-    }
-
-    if (borrow) {
-        result->sign = -1;
-        result->neged_with_sign = true;
-    } else {
-        result->sign = 1;
-    }
-
-    if (bigint_remove_leading_zeros(result) == -1) {
-        return -1;
-    }
-
-    return 0;
-}
-
-int8_t bigint_add(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
-        return -1;
-    }
-
-    if (a->sign == 0) {
-        return bigint_set_bigint(result, b);
-    }
-
-    if (b->sign == 0) {
-        if (result == a) {
-            return 0;
-        }
-
-        return bigint_set_bigint(result, a);
-    }
-
-    bigint_t* tmp_a = (bigint_t*)a;
-    bigint_t* tmp_b = (bigint_t*)b;
-
-    if (tmp_a->sign < 0) {
-        if(bigint_neg_with_sign(tmp_a, tmp_a, false) == -1) {
-            return -1;
-        }
-    }
-
-    if (tmp_b->sign < 0) {
-        if(bigint_neg_with_sign(tmp_b, tmp_b, false) == -1) {
-            return -1;
-        }
-    }
-
-    int32_t sign = 1;
-
-    if (a->sign < 0 && b->sign < 0) {
-        sign = -1;
-    } else if(a->sign < 0 || b->sign < 0) { // one of them is negative
-        sign = -2; // -2 means we need to check the carry
-    }
-
-    uint64_t item_count = MAX(bigint_item_count(tmp_a), bigint_item_count(tmp_b)) + 1;
-
-    if(result != a) {
-        if (bigint_sign_extend(result, item_count) == -1) {
-            return -1;
-        }
-
-        result->sign = 1;
-    }
-
-    if (bigint_sign_extend(tmp_a, item_count) == -1) {
-        return -1;
-    }
-
-    if (bigint_sign_extend(tmp_b, item_count) == -1) {
-        return -1;
-    }
-
-    bigint_item_t* item_result = result->lsb;
-    bigint_item_t* item_a = tmp_a->lsb;
-    bigint_item_t* item_b = tmp_b->lsb;
-    bigint_item_t* prev = NULL;
-    uint64_t carry = 0;
-
-    while (item_a && item_b) {
-        item_result->value = item_a->value + item_b->value + carry;
-        carry = item_result->value >> BIGINT_ITEM_BITS;
-        item_result->value &= BIGINT_ITEM_MAX;
-
-
-        prev = item_result;
-
-        item_a = item_a->next;
-        item_b = item_b->next;
-        item_result = item_result->next;
-    }
-
-    if(item_result) {
-        bigint_item_t* tmp = item_result;
-
-        while(tmp) {
-            tmp->value = 0;
-            tmp = tmp->next;
-        }
-    }
-
-    if (carry) {
-        if(sign == -2) {
-            result->sign = 1;
-            result->neged_with_sign = false;
-        } else {
-            if(sign == 1) {
-                printf("do we hit?\n");
-                bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-                if (!item) {
-                    return -1;
-                }
-
-                item->value = carry;
-
-                if (prev) {
-                    prev->next = item;
-                } else {
-                    result->lsb = item;
-                }
-
-                item->prev = prev;
-
-                prev = item;
-
-                result->msb = prev;
-            }
-
-            if(sign == -1) {
-                result->sign = -1;
-                result->neged_with_sign = true;
-            }
-
-            result->sign = sign;
-        }
-    } else if(sign != -2) {
-        result->sign = sign;
-    } else {
-        result->sign = -1;
-        result->neged_with_sign = true;
-    }
-
-    if (bigint_remove_leading_zeros(result) == -1) {
-        return -1;
-    }
-
-    return 0;
-}
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
-uint64_t bigint_bit_length(const bigint_t* bigint) {
-    if(!bigint) {
-        return 0;
-    }
-
-    if (bigint->sign == 0) {
-        return 0;
-    }
-
-    if(bigint->lsb == NULL) {
-        return 0;
-    }
-
-
-    bigint_item_t* item = bigint->msb;
-
-    while(item && item->value == 0) {
-        item = item->prev;
-    }
-
-    if(!item) {
-        return 0;
-    }
-
-    uint64_t length = bit_most_significant(item->value);
-
-    item = item->prev;
-
-    while (item) {
-        length += BIGINT_ITEM_BITS;
-
-        item = item->prev;
-    }
-
-    return length;
-
-}
-#pragma GCC diagnostic pop
-
-int8_t bigint_cmp(const bigint_t* a, const bigint_t* b) {
-    if(!a || !b) {
-        return -1;
-    }
-
-    if (a->sign < b->sign) {
-        return -1;
-    }
-
-    if (a->sign > b->sign) {
-        return 1;
-    }
-
-    if (a->sign == 0) {
-        return 0;
-    }
-
-    if(a->sign < 0 && a->neged_with_sign) {
-        if(bigint_neg_with_sign_inplace((bigint_t*)a, true) == -1) {
-            return -1;
-        }
-    }
-
-    if(b->sign < 0 && b->neged_with_sign) {
-        if(bigint_neg_with_sign_inplace((bigint_t*)b, true) == -1) {
-            return -1;
-        }
-    }
-
-    uint64_t a_length = bigint_bit_length(a);
-    uint64_t b_length = bigint_bit_length(b);
-
-    if (a_length < b_length) {
-        return -a->sign;
-    }
-
-    if (a_length > b_length) {
-        return a->sign;
-    }
-
-    bigint_item_t* item_a = a->msb;
-
-    while(item_a && item_a->value == 0) { // remove leading zeros
-        item_a = item_a->prev;
-    }
-
-    bigint_item_t* item_b = b->msb;
-
-    while(item_b && item_b->value == 0) { // remove leading zeros
-        item_b = item_b->prev;
-    }
-
-    while (item_a && item_b) {
-        if (item_a->value < item_b->value) {
-            return -a->sign;
-        }
-
-        if (item_a->value > item_b->value) {
-            return a->sign;
-        }
-
-        item_a = item_a->prev;
-        item_b = item_b->prev;
-    }
-
-    return 0;
-}
-
-int8_t bigint_mul(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
-        return -1;
-    }
-
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
-
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
-
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
-    }
-
-    if (a->sign == 0 || b->sign == 0) {
-        result->sign = 0;
-
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
-
-        return 0;
-    }
-
-    if(a->sign < 0 && a->neged_with_sign) {
-        if(bigint_neg_with_sign_inplace((bigint_t*)a, true) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            return -1;
-        }
-    }
-
-    if(b->sign < 0 && b->neged_with_sign) {
-        if(bigint_neg_with_sign_inplace((bigint_t*)b, true) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            return -1;
-        }
-    }
-
-    bigint_item_t* item_a = a->msb;
-    bigint_item_t* item_b = b->lsb;
-
-    bigint_t* row_result = bigint_create();
-
-    if (!row_result) {
-        return -1;
-    }
-
-    if(bigint_sign_extend(row_result, bigint_item_count(b) + 1) == -1) {
-        bigint_destroy(row_result);
-
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
-
-    row_result->sign = 1;
-
-    while (item_a) {
-        bigint_item_t* item = row_result->lsb;
-        uint128_t carry = 0;
-
-        while (item_b) {
-            uint128_t value = (uint128_t)item_a->value * (uint128_t)item_b->value + carry;
-
-            item->value = value & BIGINT_ITEM_MAX;
-
-            carry = value >> BIGINT_ITEM_BITS;
-
-            item = item->next;
-
-            item_b = item_b->next;
-
-        } // while (item_b)
-
-        if (carry) {
-            item->value = carry;
-        } else {
-            item->value = 0;
-        }
-
-        while(item->next) {
-            item = item->next;
-            item->value = 0;
-        }
-
-        item_a = item_a->prev;
-        item_b = b->lsb;
-
-        if(bigint_shl(result, result, BIGINT_ITEM_BITS) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(row_result);
-            return -1;
-        }
-
-        if(bigint_add(result, result, row_result) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(row_result);
-            return -1;
-        }
-    }
-
-    bigint_destroy(row_result);
-
-    result->sign = a->sign * b->sign;
-    result->neged_with_sign = false;
-
-    // bigint_remove_leading_zeros(result);
-
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
-    }
-
-    return 0;
-}
-
-int8_t bigint_pow(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
-        return -1;
-    }
-
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
-
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
-
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
-    }
-
-    if(a->sign == 0 && b->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
-
-    if (a->sign == 0) {
-        result->sign = 0;
-
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
-
-        return 0;
-    }
-
-    if (b->sign == 0) {
-        result->sign = 1;
-        bigint_set_int64(result, 1);
-
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
-
-        return 0;
-    }
-
-    if (b->sign < 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
-
-    bigint_t* base = bigint_clone(a);
-
-    if (!base) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        return -1;
-    }
-
-    bigint_t* exp = bigint_clone(b);
-
-    if (!exp) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        bigint_destroy(exp);
-        return -1;
-    }
-
-    if (bigint_set_uint64(result, 1) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        bigint_destroy(exp);
-        return -1;
-    }
-
-    while (exp->sign > 0) {
-        if(bigint_is_odd(exp)) {
-            if (bigint_mul(result, result, base) == -1) {
-                if (orig_result_is_a) {
-                    bigint_destroy(result);
-                }
-
-                bigint_destroy(base);
-                bigint_destroy(exp);
-                return -1;
-            }
-        }
-
-        if (bigint_mul(base, base, base) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(base);
-            bigint_destroy(exp);
-            return -1;
-        }
-
-        if(bigint_shr_one(exp) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(base);
-            bigint_destroy(exp);
-            return -1;
-        }
-    }
-
-    bigint_destroy(base);
-    bigint_destroy(exp);
-
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
-    }
-
-    return 0;
-}
-
-int8_t bigint_mul_mod(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c) {
-    if(!result || !a || !b || !c) {
-        return -1;
-    }
-
-    if (c->sign == 0) {
-        return -1;
-    }
-
-
-    if(a->sign == 0 || b->sign == 0) {
-        if(a == result) {
-            return 0;
-        }
-
-        bigint_destroy_items(result);
-
-        return 0;
-    }
-
-    if (bigint_mul(result, a, b) == -1) {
-        return -1;
-    }
-
-    if (bigint_mod(result, result, c) == -1) {
-        return -1;
-    }
-
-    return 0;
-}
-
-int8_t bigint_pow_mod(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c) {
-    if(!result || !a || !b || !c) {
-        return -1;
-    }
-
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
-
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
-
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
-    }
-
-    if(a->sign == 0 && b->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
-
-    if (a->sign == 0) {
-        result->sign = 0;
-
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
-
-        return 0;
-    }
-
-    if (b->sign == 0) {
-        result->sign = 1;
-        bigint_set_int64(result, 1);
-
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
-
-        return 0;
-    }
-
-    if (b->sign < 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
-
-    bigint_t* base = bigint_clone(a);
-
-    if (!base) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        return -1;
-    }
-
-    if (bigint_mod(base, base, c) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        return -1;
-    }
-
-    bigint_t* exp = bigint_clone(b);
-
-    if (!exp) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        bigint_destroy(exp);
-        return -1;
-    }
-
-    if (bigint_set_uint64(result, 1) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        bigint_destroy(base);
-        bigint_destroy(exp);
-        return -1;
-    }
-
-    while (exp->sign > 0) {
-        if(bigint_is_odd(exp)) {
-            if (bigint_mul_mod(result, result, base, c) == -1) {
-                if (orig_result_is_a) {
-                    bigint_destroy(result);
-                }
-
-                bigint_destroy(base);
-                bigint_destroy(exp);
-                return -1;
-            }
-        }
-
-        if (bigint_mul_mod(base, base, base, c) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(base);
-            bigint_destroy(exp);
-            return -1;
-        }
-
-        if(bigint_shr_one(exp) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(base);
-            bigint_destroy(exp);
-            return -1;
-        }
-
-    }
-
-    bigint_destroy(base);
-    bigint_destroy(exp);
-
-    bigint_remove_leading_zeros(result);
-
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
-    }
-
-    return 0;
-}
-
-int8_t bigint_div_with_remainder(bigint_t* result, bigint_t* remainder, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) { // remainder can be NULL
-        return -1;
-    }
-
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
-
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
-
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
-    }
-
-    if (b->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
-    }
-
-    if (a->sign == 0) {
-        result->sign = 0;
-
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, result);
-            bigint_destroy(result);
-        }
-
-        return 0;
-    }
-
-    if(orig_result_is_a) {
-        bigint_destroy(result);
-        result = NULL;
-    }
-
-    if (b->sign == 1 && a->sign == 1) {
-        return bigint_div_unsigned(orig_result, remainder, a, b);
-    }
-
-    if (b->sign == -1 && a->sign == -1) {
-
-        bigint_t* neg_a = bigint_create();
+    if (bigint_is_odd(c) && !(c->size == 1 && c->limbs[0] == 1)) {
+        boolean_t c_negative = c->sign < 0;
+        bigint_montgomery_t* ctx = bigint_montgomery_create(c);
 
-        if(a->neged_with_sign && bigint_neg_with_sign_inplace((bigint_t*)a, true) == -1) {
-            bigint_destroy(neg_a);
+        if (!ctx) {
             return -1;
         }
 
-        if (bigint_neg(neg_a, a) == -1) {
-            bigint_destroy(neg_a);
-            return -1;
-        }
-
-        bigint_t* neg_b = bigint_create();
-
-        if(b->neged_with_sign && bigint_neg_with_sign_inplace((bigint_t*)b, true) == -1) {
-            bigint_destroy(neg_a);
-            bigint_destroy(neg_b);
-            return -1;
-        }
-
-        if (bigint_neg(neg_b, b) == -1) {
-            bigint_destroy(neg_a);
-            bigint_destroy(neg_b);
-            return -1;
-        }
-
-        int8_t ret = bigint_div_unsigned(orig_result, remainder, neg_a, neg_b);
-
-        orig_result->sign = 1;
-        orig_result->neged_with_sign = false;
-
-        bigint_destroy(neg_a);
-        bigint_destroy(neg_b);
-
-        return ret;
-    }
-
-    bigint_t* neg_a = bigint_create();
-
-    if(a->sign != -1) {
-        if (bigint_set_bigint(neg_a, a) == -1) {
-            bigint_destroy(neg_a);
-            return -1;
-        }
-
-        neg_a->sign = 1;
-    } else {
-        if(a->neged_with_sign && bigint_neg_with_sign_inplace((bigint_t*)a, true) == -1) {
-            bigint_destroy(neg_a);
-            return -1;
-        }
-
-        if (bigint_neg(neg_a, a) == -1) {
-            bigint_destroy(neg_a);
-            return -1;
-        }
-    }
-
-    bigint_t* neg_b = bigint_create();
-
-    if(b->sign != -1) {
-        if (bigint_set_bigint(neg_b, b) == -1) {
-            bigint_destroy(neg_a);
-            bigint_destroy(neg_b);
-            return -1;
-        }
-
-        neg_b->sign = 1;
-    } else {
-        if(b->neged_with_sign && bigint_neg_with_sign_inplace((bigint_t*)b, true) == -1) {
-            bigint_destroy(neg_a);
-            bigint_destroy(neg_b);
-            return -1;
-        }
+        int8_t res = bigint_montgomery_pow(ctx, result, a, b, BIGINT_MONTGOMERY_POW_MODE_SLIDING_WINDOW);
 
-        if (bigint_neg(neg_b, b) == -1) {
-            bigint_destroy(neg_a);
-            bigint_destroy(neg_b);
-            return -1;
+        // montgomery works on |c|, floored modulo takes the sign of c
+        if (res == 0 && c_negative && result->sign != 0) {
+            res = bigint_sub(result, result, ctx->modulus);
         }
-    }
-
-    int8_t ret = bigint_div_unsigned(orig_result, remainder, neg_a, neg_b);
-
-    if (ret == -1) {
-        bigint_destroy(neg_a);
-        bigint_destroy(neg_b);
-        return -1;
-    }
-
-    bigint_t* one = bigint_one();
-
-    if(!one) {
-        bigint_destroy(neg_a);
-        bigint_destroy(neg_b);
-        return -1;
-    }
-
-    if(bigint_add(orig_result, orig_result, one) == -1) {
-        bigint_destroy(neg_a);
-        bigint_destroy(neg_b);
-        bigint_destroy(one);
-        return -1;
-    }
 
-    bigint_destroy(one);
-
-    orig_result->sign = -1;
-
-    bigint_destroy(neg_a);
-    bigint_destroy(neg_b);
-
-    return ret;
-}
-
-int8_t bigint_div_unsigned(bigint_t* result, bigint_t* remainder, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) { // remainder can be NULL
-        return -1;
-    }
-
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
-
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
+        bigint_montgomery_destroy(ctx);
 
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
+        return res;
     }
 
-    if (b->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    bigint_t* base = bigint_create();
+    bigint_t* acc = bigint_one();
+    bigint_t* tmp = bigint_create();
 
-        return -1;
+    if (!base || !acc || !tmp) {
+        goto error;
     }
 
-    if (a->sign == 0 && b->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
-
-        return -1;
+    if (bigint_mod(base, a, c) == -1) {
+        goto error;
     }
 
-    if (a->sign == 0) {
-        if (orig_result_is_a) {
-            bigint_destroy_items(orig_result);
-            bigint_destroy(result);
+    for (uint64_t bit = bigint_bit_length(b); bit-- > 0;) {
+        boolean_t set = false;
+
+        if (bigint_mul(tmp, acc, acc) == -1 || bigint_mod(acc, tmp, c) == -1) {
+            goto error;
         }
 
-        return 0;
+        bigint_get_bit(b, bit, &set);
+
+        if (set && (bigint_mul(tmp, acc, base) == -1 || bigint_mod(acc, tmp, c) == -1)) {
+            goto error;
+        }
     }
 
-    uint64_t a_length = bigint_bit_length(a);
-    uint64_t b_length = bigint_bit_length(b);
+    bigint_swap(result, acc);
 
-    int64_t max_bit_length = MAX(a_length, b_length);
+    bigint_destroy(base);
+    bigint_destroy(acc);
+    bigint_destroy(tmp);
 
-    bigint_t* quotient = result; // for readability
+    return 0;
 
-    bigint_t* tmp_remainder = bigint_create();
+error:
+    bigint_destroy(base);
+    bigint_destroy(acc);
+    bigint_destroy(tmp);
 
-    if(!tmp_remainder) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    return -1;
+}
 
+// quotient = |a| / |b|, remainder = |a| % |b|, both non negative. outputs may alias inputs.
+static int8_t bigint_divmod_magnitude(bigint_t* quotient, bigint_t* remainder, const bigint_t* a, const bigint_t* b) {
+    if (b->sign == 0) {
         return -1;
     }
 
-    for(int64_t i = max_bit_length; i > -1; i--) {
-        if(bigint_shl_one(tmp_remainder) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
+    if (bigint_limbs_cmp(a->limbs, a->size, b->limbs, b->size) < 0) {
+        if (remainder) {
+            if (bigint_set_bigint(remainder, a) == -1) {
+                return -1;
             }
 
-            bigint_destroy(tmp_remainder);
-            return -1;
+            remainder->sign = remainder->size ? 1 : 0;
         }
 
-        boolean_t bit = false;
-
-        if(bigint_get_bit(a, i, &bit) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
+        quotient->size = 0;
+        quotient->sign = 0;
 
-            bigint_destroy(tmp_remainder);
-            return -1;
-        }
+        return 0;
+    }
 
-        if(bit) {
-            if(bigint_set_bit(tmp_remainder, 0, true) == -1) {
-                if (orig_result_is_a) {
-                    bigint_destroy(result);
-                }
+    uint64_t qn = a->size - b->size + 1;
+    uint64_t rn = b->size;
+    uint64_t q_capacity = MAX(qn, BIGINT_MIN_CAPACITY);
+    uint64_t r_capacity = MAX(rn, BIGINT_MIN_CAPACITY);
 
-                bigint_destroy(tmp_remainder);
-                return -1;
-            }
-        }
+    uint64_t* q = memory_malloc(q_capacity * sizeof(uint64_t));
+    uint64_t* r = remainder ? memory_malloc(r_capacity * sizeof(uint64_t)) : NULL;
 
-        if(bigint_cmp(tmp_remainder, b) != -1) {
-            if(bigint_sub(tmp_remainder, tmp_remainder, b) == -1) {
-                if (orig_result_is_a) {
-                    bigint_destroy(result);
-                }
+    if (!q || (remainder && !r)) {
+        memory_free(q);
+        memory_free(r);
 
-                bigint_destroy(tmp_remainder);
-                return -1;
-            }
+        return -1;
+    }
 
-            if(bigint_set_bit(quotient, i, true) == -1) {
-                if (orig_result_is_a) {
-                    bigint_destroy(result);
-                }
+    if (bigint_limbs_divmod(q, r, a->limbs, a->size, b->limbs, b->size) == -1) {
+        memory_free(q);
+        memory_free(r);
 
-                bigint_destroy(tmp_remainder);
-                return -1;
-            }
-        }
+        return -1;
     }
 
-    if(remainder) {
-        bigint_remove_leading_zeros(tmp_remainder);
-        bigint_set_bigint(remainder, tmp_remainder);
-    }
+    memory_free(quotient->limbs);
 
-    bigint_destroy(tmp_remainder);
+    quotient->limbs = q;
+    quotient->capacity = q_capacity;
+    quotient->size = qn;
+    quotient->sign = 1;
 
-    bigint_remove_leading_zeros(result);
+    bigint_normalize(quotient);
 
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
+    if (remainder) {
+        memory_free(remainder->limbs);
+
+        remainder->limbs = r;
+        remainder->capacity = r_capacity;
+        remainder->size = rn;
+        remainder->sign = 1;
+
+        bigint_normalize(remainder);
     }
 
     return 0;
 }
 
-int8_t bigint_div(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    return bigint_div_with_remainder(result, NULL, a, b);
-}
-
-int8_t bigint_mod(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
+// floored division: quotient rounds toward negative infinity, remainder takes the sign of b
+int8_t bigint_div_with_remainder(bigint_t* result, bigint_t* remainder, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) { // remainder can be NULL
         return -1;
     }
 
-    bigint_t* tmp_result = bigint_create();
-    bigint_t* tmp_remainder = bigint_create();
-
-    if (!tmp_result || !tmp_remainder) {
-        bigint_destroy(tmp_result);
-        bigint_destroy(tmp_remainder);
+    if (b->sign == 0) {
         return -1;
     }
 
-    if (bigint_div_with_remainder(tmp_result, tmp_remainder, a, b) == -1) {
-        bigint_destroy(tmp_result);
-        bigint_destroy(tmp_remainder);
-        return -1;
-    }
+    int32_t a_sign = a->sign;
+    int32_t b_sign = b->sign;
 
-    if(a->sign > 0 && b->sign > 0) {
-        // do nothing
-    } else if(a->sign < 0 && b->sign < 0) {
-        if (tmp_remainder->sign < 0 && tmp_remainder->neged_with_sign) {
-            bigint_neg_with_sign_inplace((bigint_t*)tmp_remainder, true);
-        }
+    bigint_t* quotient = bigint_create();
+    bigint_t* rem = bigint_create();
 
-        tmp_remainder->sign = -1;
-        tmp_remainder->neged_with_sign = false;
-    } else if(a->sign < 0) {
-        if(bigint_sub(tmp_remainder, tmp_remainder, b) == -1) {
-            bigint_destroy(tmp_result);
-            bigint_destroy(tmp_remainder);
-            return -1;
-        }
+    if (!quotient || !rem) {
+        goto error;
+    }
 
-        if(bigint_neg_with_sign_inplace((bigint_t*)tmp_remainder, true) == -1) {
-            bigint_destroy(tmp_result);
-            bigint_destroy(tmp_remainder);
-            return -1;
-        }
+    if (bigint_divmod_magnitude(quotient, rem, a, b) == -1) {
+        goto error;
+    }
 
-        tmp_remainder->sign = 1;
-    } else {
-        if(bigint_add(tmp_remainder, tmp_remainder, b) == -1) {
-            bigint_destroy(tmp_result);
-            bigint_destroy(tmp_remainder);
-            return -1;
+    if (a_sign != b_sign && rem->sign != 0) {
+        // |b| - rem, b is untouched until the outputs are swapped in
+        if (bigint_inc_magnitude(quotient) == -1 || bigint_add_signed(rem, rem, b, -1) == -1) {
+            goto error;
         }
 
-        tmp_remainder->sign = -1;
+        quotient->sign = 1;
+    }
+
+    if (quotient->size) {
+        quotient->sign = a_sign * b_sign;
     }
 
-    bigint_destroy(tmp_result);
+    if (rem->size) {
+        rem->sign = b_sign;
+    }
 
-    bigint_remove_leading_zeros(tmp_remainder);
+    bigint_swap(result, quotient);
 
-    if (bigint_set_bigint(result, tmp_remainder) == -1) {
-        bigint_destroy(tmp_remainder);
-        return -1;
+    if (remainder) {
+        bigint_swap(remainder, rem);
     }
 
-    bigint_destroy(tmp_remainder);
+    bigint_destroy(quotient);
+    bigint_destroy(rem);
 
     return 0;
+
+error:
+    bigint_destroy(quotient);
+    bigint_destroy(rem);
+
+    return -1;
 }
 
-int8_t bigint_gcd(bigint_t* result, const bigint_t* a, const bigint_t* b) {
-    if(!result || !a || !b) {
+int8_t bigint_div_unsigned(bigint_t* result, bigint_t* remainder, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) { // remainder can be NULL
         return -1;
     }
 
-    bigint_t* orig_result = result;
-    boolean_t orig_result_is_a = false;
+    bigint_t* quotient = bigint_create();
+    bigint_t* rem = remainder ? bigint_create() : NULL;
 
-    if (result == a) {
-        result = bigint_create();
-
-        if (!result) {
-            return -1;
-        }
+    if (!quotient || (remainder && !rem)) {
+        bigint_destroy(quotient);
+        bigint_destroy(rem);
 
-        orig_result_is_a = true;
-    }else {
-        bigint_destroy_items(result);
+        return -1;
     }
 
-    int8_t cmp = bigint_cmp(a, b);
-    boolean_t a_is_smaller = false;
-
-    if (cmp == 0) {
-        if (orig_result_is_a) {
-            bigint_set_bigint(orig_result, a);
-            bigint_destroy(result);
-        }
+    if (bigint_divmod_magnitude(quotient, rem, a, b) == -1) {
+        bigint_destroy(quotient);
+        bigint_destroy(rem);
 
-        return 0;
-    } else if (cmp == -1) {
-        a_is_smaller = true;
+        return -1;
     }
 
-    bigint_t* tmp_a = bigint_clone(a);
-
-    if (!tmp_a) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    bigint_swap(result, quotient);
 
-        return -1;
+    if (remainder) {
+        bigint_swap(remainder, rem);
     }
 
-    bigint_t* tmp_b = bigint_clone(b);
+    bigint_destroy(quotient);
+    bigint_destroy(rem);
 
-    if (!tmp_b) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    return 0;
+}
+
+int8_t bigint_div(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    return bigint_div_with_remainder(result, NULL, a, b);
+}
 
-        bigint_destroy(tmp_a);
+int8_t bigint_mod(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) {
         return -1;
     }
 
-    bigint_t* tmp = bigint_create();
-
-    if (!tmp) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    bigint_t* quotient = bigint_create();
 
-        bigint_destroy(tmp_a);
-        bigint_destroy(tmp_b);
+    if (!quotient) {
         return -1;
     }
 
-    if(!a_is_smaller) {
-        bigint_t* swap = tmp_a;
-        tmp_a = tmp_b;
-        tmp_b = swap;
-    }
-
-    while (tmp_a->sign != 0) {
-        if (bigint_mod(tmp, tmp_b, tmp_a) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
-
-            bigint_destroy(tmp_a);
-            bigint_destroy(tmp_b);
-            bigint_destroy(tmp);
-            return -1;
-        }
+    int8_t res = bigint_div_with_remainder(quotient, result, a, b);
 
-        if (bigint_set_bigint(tmp_b, tmp_a) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
+    bigint_destroy(quotient);
 
-            bigint_destroy(tmp_a);
-            bigint_destroy(tmp_b);
-            bigint_destroy(tmp);
-            return -1;
-        }
+    return res;
+}
 
-        if (bigint_set_bigint(tmp_a, tmp) == -1) {
-            if (orig_result_is_a) {
-                bigint_destroy(result);
-            }
+int8_t bigint_gcd(bigint_t* result, const bigint_t* a, const bigint_t* b) {
+    if(!result || !a || !b) {
+        return -1;
+    }
 
-            bigint_destroy(tmp_a);
-            bigint_destroy(tmp_b);
-            bigint_destroy(tmp);
-            return -1;
-        }
+    bigint_t* x = bigint_clone(a);
+    bigint_t* y = bigint_clone(b);
+    bigint_t* quotient = bigint_create();
+    bigint_t* tmp = bigint_create();
 
+    if (!x || !y || !quotient || !tmp) {
+        goto error;
     }
 
-    if (bigint_set_bigint(result, tmp_b) == -1) {
-        if (orig_result_is_a) {
-            bigint_destroy(result);
-        }
+    x->sign = x->size ? 1 : 0;
+    y->sign = y->size ? 1 : 0;
 
-        bigint_destroy(tmp_a);
-        bigint_destroy(tmp_b);
-        bigint_destroy(tmp);
-        return -1;
-    }
+    while (y->sign != 0) {
+        if (bigint_divmod_magnitude(quotient, tmp, x, y) == -1) {
+            goto error;
+        }
 
-    if(result->sign == -1) {
-        result->sign = 1;
+        // x, y = y, x mod y
+        bigint_swap(x, y);
+        bigint_swap(y, tmp);
     }
 
-    bigint_remove_leading_zeros(result);
+    bigint_swap(result, x);
 
-    bigint_destroy(tmp_a);
-    bigint_destroy(tmp_b);
+    bigint_destroy(x);
+    bigint_destroy(y);
+    bigint_destroy(quotient);
     bigint_destroy(tmp);
 
-    if (orig_result_is_a) {
-        bigint_set_bigint(orig_result, result);
-        bigint_destroy(result);
-    }
-
     return 0;
+
+error:
+    bigint_destroy(x);
+    bigint_destroy(y);
+    bigint_destroy(quotient);
+    bigint_destroy(tmp);
+
+    return -1;
 }
 
 static bigint_t* bigint_random_internal(uint64_t bits, boolean_t force_msb) {
@@ -3136,80 +2108,31 @@ static bigint_t* bigint_random_internal(uint64_t bits, boolean_t force_msb) {
         return result;
     }
 
-    uint64_t item_count = bits / BIGINT_ITEM_BITS;
-    uint64_t remaining_bits = bits % BIGINT_ITEM_BITS;
+    uint64_t count = (bits + BIGINT_LIMB_BITS - 1) / BIGINT_LIMB_BITS;
+    uint64_t top_bits = bits % BIGINT_LIMB_BITS;
 
-    if(item_count == 0 && remaining_bits == 0) {
+    if (bigint_reserve(result, count) == -1) {
         bigint_destroy(result);
+
         return NULL;
     }
 
-    bigint_item_t* prev = NULL;
-
-    for (uint64_t i = 0; i < item_count; i++) {
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-        if (!item) {
-            bigint_destroy(result);
-            return NULL;
-        }
-
-        item->value = rand64();
-        item->value &= BIGINT_ITEM_MAX;
-        item->next = NULL;
-        item->prev = prev;
-
-        if (prev) {
-            prev->next = item;
-        } else {
-            result->lsb = item;
-        }
-
-        prev = item;
+    for (uint64_t i = 0; i < count; i++) {
+        result->limbs[i] = rand64();
     }
 
-    if (remaining_bits) {
-        bigint_item_t* item = (bigint_item_t*)memory_malloc(sizeof(bigint_item_t));
-
-        if (!item) {
-            bigint_destroy(result);
-            return NULL;
-        }
-
-        item->value = rand64();
-        item->value &= (1ULL << remaining_bits) - 1;
-        item->next = NULL;
-        item->prev = prev;
-
-        if (prev) {
-            prev->next = item;
-        } else {
-            result->lsb = item;
-        }
-
-        prev = item;
+    if (top_bits) {
+        result->limbs[count - 1] &= (1ULL << top_bits) - 1;
     }
 
-    if(!prev) { // never happens
-        bigint_destroy(result);
-        return NULL;
+    if (force_msb) {
+        result->limbs[count - 1] |= 1ULL << ((bits - 1) % BIGINT_LIMB_BITS);
     }
 
-    result->msb = prev;
-
+    result->size = count;
     result->sign = 1;
 
-    if(!force_msb) {
-        return result;
-    }
-
-    // ensure the most significant bit is set
-    if (remaining_bits) {
-        result->msb->value |= 1ULL << (remaining_bits - 1);
-    } else {
-        result->msb->value |= 1ULL << (BIGINT_ITEM_BITS - 1);
-    }
-
+    bigint_normalize(result);
 
     return result;
 }
@@ -3229,42 +2152,44 @@ bigint_t* bigint_random_range(const bigint_t* min, const bigint_t* max) {
         return NULL;
     }
 
-    if (bigint_sub(range, max, min) == -1) {
+    if (bigint_sub(range, max, min) == -1 || range->sign < 0) {
         bigint_destroy(range);
-        return NULL;
-    }
-
-    bigint_t* result = bigint_create();
 
-    if (!result) {
-        bigint_destroy(range);
         return NULL;
     }
 
     uint64_t bits_upper = bigint_bit_length(range);
 
-    uint64_t bits_random = rand64() % bits_upper;
+    bigint_destroy(range);
 
+    if (bits_upper == 0) {
+        return bigint_clone(min);
+    }
 
-    bigint_t* tmp = bigint_random_internal(bits_random, false);
+    // fewer bits than the range so min + tmp never passes max
+    bigint_t* tmp = bigint_random_internal(rand64() % bits_upper, false);
 
     if (!tmp) {
-        bigint_destroy(range);
-        bigint_destroy(result);
         return NULL;
     }
 
-    if (bigint_add(result, min, tmp) == -1) {
-        bigint_destroy(range);
-        bigint_destroy(result);
+    if (bigint_add(tmp, min, tmp) == -1) {
         bigint_destroy(tmp);
+
         return NULL;
     }
 
-    bigint_destroy(range);
-    bigint_destroy(tmp);
+    return tmp;
+}
 
-    return result;
+static uint64_t bigint_mod_limb(const bigint_t* a, uint64_t d) {
+    uint64_t rem = 0;
+
+    for (uint64_t i = a->size; i-- > 0;) {
+        bigint_limbs_div_128_64(rem, a->limbs[i], d, &rem);
+    }
+
+    return rem;
 }
 
 static boolean_t bigint_is_prime_miller_rabin(const bigint_t* a, uint64_t try) {
@@ -3272,232 +2197,111 @@ static boolean_t bigint_is_prime_miller_rabin(const bigint_t* a, uint64_t try) {
         return false;
     }
 
-    if(a->sign <= 0) {
+    if(a->sign <= 0 || bigint_is_uint64(a, 1)) {
         return false;
     }
 
-    if(bigint_is_uint64(a, 2) || bigint_is_uint64(a, 3)) {
+    if(bigint_is_uint64(a, 2)) {
         return true;
     }
 
-    if(bigint_is_uint64(a, 1)) {
-        return false;
-    }
-
     if(bigint_is_even(a)) {
         return false;
     }
 
-    bigint_t* one = bigint_one();
-    bigint_t* two = bigint_two();
-
-    if(!one || !two) {
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
-    }
-
-    bigint_t* n_minus_1 = bigint_clone(a);
-
-    if (!n_minus_1) {
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
-    }
-
-    if (bigint_sub(n_minus_1, n_minus_1, one) == -1) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
-    }
-
-    bigint_t* d = bigint_clone(n_minus_1);
-
-    if (!d) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
-    }
-
-    bigint_t* r = bigint_create();
-
-    if (!r) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(d);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
-    }
-
-    while (bigint_is_even(d)) {
-        if(bigint_add(r, r, one) == -1) {
-            bigint_destroy(n_minus_1);
-            bigint_destroy(d);
-            bigint_destroy(r);
-            bigint_destroy(one);
-            bigint_destroy(two);
-            return false;
+    for (uint64_t i = 0; i < sizeof(bigint_small_primes) / sizeof(bigint_small_primes[0]); i++) {
+        if (bigint_is_uint64(a, bigint_small_primes[i])) {
+            return true;
         }
 
-        if (bigint_shr_one(d) == -1) {
-            bigint_destroy(n_minus_1);
-            bigint_destroy(d);
-            bigint_destroy(r);
-            bigint_destroy(one);
-            bigint_destroy(two);
+        if (bigint_mod_limb(a, bigint_small_primes[i]) == 0) {
             return false;
         }
-
-        if(d->sign == 0) {
-            break;
-        }
-    }
-
-    if(bigint_sub(r, r, one) == -1) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(d);
-        bigint_destroy(r);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
     }
 
-    bigint_t* r_minus_1 = r; // for readability
+    boolean_t result = false;
 
+    bigint_t* one = bigint_one();
+    bigint_t* two = bigint_two();
+    bigint_t* n_minus_1 = bigint_create();
+    bigint_t* n_minus_2 = bigint_create();
+    bigint_t* d = bigint_create();
     bigint_t* x = bigint_create();
+    bigint_t* test_random = NULL;
+    bigint_montgomery_t* ctx = bigint_montgomery_create(a); // a is odd and above the small primes here
 
-    if (!x) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(d);
-        bigint_destroy(r);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
+    if (!one || !two || !n_minus_1 || !n_minus_2 || !d || !x || !ctx) {
+        goto cleanup;
     }
 
-    bigint_t* a_minus_2 = bigint_clone(a);
-
-    if (!a_minus_2) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(d);
-        bigint_destroy(r);
-        bigint_destroy(x);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
+    if (bigint_sub(n_minus_1, a, one) == -1 || bigint_sub(n_minus_2, a, two) == -1) {
+        goto cleanup;
     }
 
-    if (bigint_sub(a_minus_2, a_minus_2, two) == -1) {
-        bigint_destroy(n_minus_1);
-        bigint_destroy(d);
-        bigint_destroy(r);
-        bigint_destroy(x);
-        bigint_destroy(a_minus_2);
-        bigint_destroy(one);
-        bigint_destroy(two);
-        return false;
+    // n - 1 = d * 2^r
+    uint64_t r = 0;
+
+    while (!((n_minus_1->limbs[r / BIGINT_LIMB_BITS] >> (r % BIGINT_LIMB_BITS)) & 1)) {
+        r++;
     }
 
-    // const char * str = NULL;
+    if (bigint_shr(d, n_minus_1, r) == -1) {
+        goto cleanup;
+    }
 
     for (uint64_t i = 0; i < try; i++) {
-        bigint_t* test_random = bigint_random_range(two, a_minus_2);
+        test_random = bigint_random_range(two, n_minus_2);
+
         if (!test_random) {
-            bigint_destroy(n_minus_1);
-            bigint_destroy(d);
-            bigint_destroy(r);
-            bigint_destroy(x);
-            bigint_destroy(a_minus_2);
-            bigint_destroy(one);
-            bigint_destroy(two);
-            return false;
+            goto cleanup;
         }
 
-        if (bigint_pow_mod(x, test_random, d, a) == -1) {
-            bigint_destroy(n_minus_1);
-            bigint_destroy(d);
-            bigint_destroy(r);
-            bigint_destroy(x);
-            bigint_destroy(test_random);
-            bigint_destroy(a_minus_2);
-            bigint_destroy(one);
-            bigint_destroy(two);
-            return false;
+        if (bigint_montgomery_pow(ctx, x, test_random, d, BIGINT_MONTGOMERY_POW_MODE_SLIDING_WINDOW) == -1) {
+            goto cleanup;
         }
 
-        if (!bigint_is_uint64(x, 1) && bigint_cmp(x, n_minus_1) != 0) {
-            bigint_t* j = bigint_create();
-
-            if (!j) {
-                bigint_destroy(n_minus_1);
-                bigint_destroy(d);
-                bigint_destroy(r);
-                bigint_destroy(x);
-                bigint_destroy(test_random);
-                bigint_destroy(a_minus_2);
-                bigint_destroy(one);
-                bigint_destroy(two);
-                return false;
-            }
+        bigint_destroy(test_random);
+        test_random = NULL;
 
-            while(bigint_cmp(j, r_minus_1) == -1 && bigint_cmp(x, n_minus_1) != 0) {
-                if (bigint_pow_mod(x, x, two, a) == -1) {
-                    bigint_destroy(n_minus_1);
-                    bigint_destroy(d);
-                    bigint_destroy(r);
-                    bigint_destroy(x);
-                    bigint_destroy(test_random);
-                    bigint_destroy(a_minus_2);
-                    bigint_destroy(j);
-                    bigint_destroy(one);
-                    bigint_destroy(two);
-                    return false;
-                }
-
-                if (bigint_is_uint64(x, 1)) {
-                    bigint_destroy(test_random);
-                    bigint_destroy(n_minus_1);
-                    bigint_destroy(d);
-                    bigint_destroy(r);
-                    bigint_destroy(x);
-                    bigint_destroy(a_minus_2);
-                    bigint_destroy(one);
-                    bigint_destroy(two);
-                    return false;
-                }
-
-                bigint_add(j, j, one);
+        if (bigint_is_uint64(x, 1) || bigint_cmp(x, n_minus_1) == 0) {
+            continue;
+        }
+
+        boolean_t witness = true;
+
+        for (uint64_t j = 1; j < r; j++) {
+            if (bigint_montgomery_mul_mod(ctx, x, x, x) == -1) {
+                goto cleanup;
             }
 
-            bigint_destroy(j);
+            if (bigint_cmp(x, n_minus_1) == 0) {
+                witness = false;
+                break;
+            }
 
-            if (bigint_cmp(x, n_minus_1) != 0) {
-                bigint_destroy(test_random);
-                bigint_destroy(n_minus_1);
-                bigint_destroy(d);
-                bigint_destroy(r);
-                bigint_destroy(x);
-                bigint_destroy(a_minus_2);
-                bigint_destroy(one);
-                bigint_destroy(two);
-                return false;
+            if (bigint_is_uint64(x, 1)) {
+                break;
             }
         }
 
-        bigint_destroy(test_random);
+        if (witness) {
+            goto cleanup;
+        }
     }
 
+    result = true;
+
+cleanup:
+    bigint_destroy(one);
+    bigint_destroy(two);
     bigint_destroy(n_minus_1);
+    bigint_destroy(n_minus_2);
     bigint_destroy(d);
-    bigint_destroy(r);
     bigint_destroy(x);
-    bigint_destroy(a_minus_2);
-    bigint_destroy(one);
-    bigint_destroy(two);
+    bigint_destroy(test_random);
+    bigint_montgomery_destroy(ctx);
 
-    return true;
+    return result;
 }
 
 boolean_t bigint_is_prime(const bigint_t* a) {
@@ -3513,7 +2317,7 @@ bigint_t* bigint_random_prime(uint64_t bits) {
         return NULL;
     }
 
-    bigint_t* two = bigint_one();
+    bigint_t* two = bigint_two();
 
     if (!two) {
         return NULL;
@@ -3524,31 +2328,29 @@ bigint_t* bigint_random_prime(uint64_t bits) {
 
         if (!result) {
             bigint_destroy(two);
+
             return NULL;
         }
 
-        result->lsb->value |= 1;
+        result->limbs[0] |= 1;
 
         for (uint64_t i = 0; i < 100; i++) {
             if (bigint_is_prime(result)) {
                 bigint_destroy(two);
+
                 return result;
             }
 
             if(bigint_add(result, result, two) == -1) {
                 bigint_destroy(result);
                 bigint_destroy(two);
+
                 return NULL;
             }
-
         }
 
         bigint_destroy(result);
     }
 
-    bigint_destroy(two);
-
     return NULL;
 }
-
-
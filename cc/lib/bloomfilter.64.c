@@ -2,6 +2,10 @@
  * @file bloomfilter.64.c
  * @brief bloom filter implementation
  *
+ * filters are split block bloom filters: a key selects one 64 byte block with multiply-shift
+ * and sets one bit in each of its eight 64-bit words, so a lookup touches a single cache line.
+ * the older double hashing layout is kept as version 1 for reading existing sstables.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  **/
@@ -14,17 +18,47 @@
 
 MODULE("turnstone.lib");
 
+/*! legacy double hashing filter, bits spread over whole array */
+#define BLOOMFILTER_VERSION_DOUBLE_HASHING 1
+/*! split block filter, all bits of a key inside one block */
+#define BLOOMFILTER_VERSION_SPLIT_BLOCK    2
+
+/*! block size in bytes, one cache line */
+#define BLOOMFILTER_BLOCK_SIZE  64
+/*! bits per block */
+#define BLOOMFILTER_BLOCK_BITS  (BLOOMFILTER_BLOCK_SIZE * 8)
+/*! words per block, one bit is set at each word */
+#define BLOOMFILTER_BLOCK_WORDS (BLOOMFILTER_BLOCK_SIZE / sizeof(uint64_t))
+
+/*! serialized field count of version 1 */
+#define BLOOMFILTER_V1_FIELD_COUNT 7
+/*! serialized field count of version 2 */
+#define BLOOMFILTER_V2_FIELD_COUNT 6
+
+/*! one block as vector */
+typedef uint64_t bloomfilter_block_t __attribute__((vector_size(BLOOMFILTER_BLOCK_SIZE)));
+/*! per word 32-bit hash lanes */
+typedef uint32_t bloomfilter_lanes_t __attribute__((vector_size(BLOOMFILTER_BLOCK_WORDS * sizeof(uint32_t))));
+
+/*! odd multipliers for deriving word bit positions, from parquet split block bloom filter */
+static const bloomfilter_lanes_t bloomfilter_salts = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
 /**
  * @struct bloomfilter_t
  * @brief bloom filter struct
  */
 typedef struct bloomfilter_t {
+    uint64_t  version; ///< filter layout version
     uint64_t  entry_count; ///< entry count at filter
     float64_t bpe; ///< bit per entry
     float64_t error; ///< error rate for false positive
     uint64_t  hash_count; ///< how much hashing
     uint64_t  hash_seed; ///< xxhash seed
     uint64_t  bit_count; ///< bit count at array
+    uint64_t  block_count; ///< block count, power of two, only for split block filters
     uint64_t* bits; ///bit array
 }bloomfilter_t;
 
@@ -38,8 +72,77 @@ typedef struct bloomfilter_t {
  */
 boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add);
 
+/*! poisson terms below this weight relative to mode are ignored */
+#define BLOOMFILTER_POISSON_EPSILON 1e-12
+/*! upper limit of block count search */
+#define BLOOMFILTER_MAX_BLOCK_COUNT (1ULL << 40)
+
+/**
+ * @brief computes integer power with squaring
+ * @param[in] base base
+ * @param[in] exponent exponent
+ * @return base ^ exponent
+ */
+static float64_t bloomfilter_power(float64_t base, uint64_t exponent) {
+    float64_t res = 1.0;
+
+    while(exponent) {
+        if(exponent & 1) {
+            res *= base;
+        }
+
+        base *= base;
+        exponent >>= 1;
+    }
+
+    return res;
+}
+
+/**
+ * @brief analytic false positive rate of a split block filter
+ * @details key count of a block is poisson distributed with mean keys_per_block, a lookup matches a block of j keys
+ * with (1 - (1 - 1/64)^j)^8. terms are summed from mode to both sides with recurrences, so no exp of large
+ * negative values is needed.
+ * @param[in] keys_per_block mean key count of a block
+ * @return false positive rate
+ */
+static float64_t bloomfilter_split_block_error(float64_t keys_per_block) {
+    const float64_t miss = 1.0 - 1.0 / (BLOOMFILTER_BLOCK_BITS / BLOOMFILTER_BLOCK_WORDS);
+    uint64_t mode = (uint64_t)keys_per_block;
+    float64_t mode_miss = bloomfilter_power(miss, mode);
+
+    float64_t weight_sum = 0;
+    float64_t error_sum = 0;
+
+    // mode and above
+    float64_t weight = 1.0;
+    float64_t miss_k = mode_miss;
+
+    for(uint64_t k = mode; weight > BLOOMFILTER_POISSON_EPSILON; k++) {
+        weight_sum += weight;
+        error_sum += weight * bloomfilter_power(1.0 - miss_k, BLOOMFILTER_BLOCK_WORDS);
+
+        weight *= keys_per_block / (float64_t)(k + 1);
+        miss_k *= miss;
+    }
+
+    // below mode
+    weight = 1.0;
+    miss_k = mode_miss;
+
+    for(uint64_t k = mode; k > 0 && weight > BLOOMFILTER_POISSON_EPSILON; k--) {
+        weight *= (float64_t)k / keys_per_block;
+        miss_k /= miss;
+
+        weight_sum += weight;
+        error_sum += weight * bloomfilter_power(1.0 - miss_k, BLOOMFILTER_BLOCK_WORDS);
+    }
+
+    return error_sum / weight_sum;
+}
+
 bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error) {
-    if(!entry_count || (error < 0 || error >= 1)) {
+    if(!entry_count || (error <= 0 || error >= 1)) {
         return NULL;
     }
 
@@ -49,20 +152,33 @@ bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error) {
         return res;
     }
 
+    res->version = BLOOMFILTER_VERSION_SPLIT_BLOCK;
     res->entry_count = entry_count;
     res->error = error;
-    res->bpe = -math_log(error) / math_power(LN2, 2);
-    res->hash_count = math_ceil(LN2 * res->bpe);
+    res->bpe = math_log(1.0 / error) / (LN2 * LN2); // classic estimate, start of block count search. log of values below one does not converge well
+    res->hash_count = BLOOMFILTER_BLOCK_WORDS;
 
     res->hash_seed = rand();
 
 
     float64_t dec = entry_count;
-    res->bit_count = (uint64_t)(dec * res->bpe);
+    uint64_t min_bits = (uint64_t)(dec * res->bpe);
 
-    uint64_t bc = (res->bit_count + 63) / 64;
+    res->block_count = 1;
 
-    res->bits = memory_malloc(bc * sizeof(uint64_t));
+    while(res->block_count * BLOOMFILTER_BLOCK_BITS < min_bits) {
+        res->block_count <<= 1;
+    }
+
+    // keys of a block share its bits, so split blocks need more bits than classic estimate
+    while(res->block_count < BLOOMFILTER_MAX_BLOCK_COUNT &&
+          bloomfilter_split_block_error(dec / (float64_t)res->block_count) > error) {
+        res->block_count <<= 1;
+    }
+
+    res->bit_count = res->block_count * BLOOMFILTER_BLOCK_BITS;
+
+    res->bits = memory_malloc_aligned(res->block_count * BLOOMFILTER_BLOCK_SIZE, BLOOMFILTER_BLOCK_SIZE);
 
     if(!res->bits) {
         memory_free(res);
@@ -83,17 +199,14 @@ boolean_t bloomfilter_destroy(bloomfilter_t* bf) {
     return true;
 }
 
-boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add) {
-    if(!bf || !data) {
-        return false;
-    }
-
-    if(data->type != DATA_TYPE_INT8_ARRAY || !data->length) {
-        return false;
-    }
-
-    uint64_t hits = 0;
-
+/**
+ * @brief checks or adds given value to the legacy double hashing bloom filter
+ * @param[in] bf bloom filter
+ * @param[in] data data to add
+ * @param[in] add if true then add or check only
+ * @return check result
+ */
+static boolean_t bloomfilter_double_hashing_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add) {
     uint64_t a = xxhash64_hash_with_seed((uint8_t*)data->value, data->length, bf->hash_seed);
     uint64_t b = xxhash64_hash_with_seed((uint8_t*)data->value, data->length, a);
 
@@ -104,19 +217,67 @@ boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t ad
         boolean_t check = bit_test(bf->bits + (x / 64), x % 64);
         if(add) {
             bit_set(bf->bits + (x / 64), x % 64);
-            hits++;
-        } else if(check) {
-            hits++;
-        } else {
+        } else if(!check) {
             return false;
         }
     }
 
-    if(hits == bf->hash_count) {
+    return true;
+}
+
+/**
+ * @brief checks or adds given value to the split block bloom filter
+ * @param[in] bf bloom filter
+ * @param[in] data data to add
+ * @param[in] add if true then add or check only
+ * @return check result
+ */
+static boolean_t bloomfilter_split_block_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add) {
+    uint64_t h = xxhash3_64_hash_with_seed((uint8_t*)data->value, data->length, bf->hash_seed);
+
+    // multiply-shift range reduction of upper half selects the block
+    uint64_t block_idx = ((h >> 32) * bf->block_count) >> 32;
+    bloomfilter_block_t* block = (bloomfilter_block_t*)(bf->bits + block_idx * BLOOMFILTER_BLOCK_WORDS);
+
+    // lower half times salts, top six bits of each lane is bit index inside its word
+    bloomfilter_lanes_t key = {0};
+    key += (uint32_t)h;
+    bloomfilter_lanes_t pos = (key * bloomfilter_salts) >> 26;
+
+    bloomfilter_block_t one = {0};
+    one += 1;
+    bloomfilter_block_t mask = one << __builtin_convertvector(pos, bloomfilter_block_t);
+
+    if(add) {
+        *block |= mask;
+
         return true;
     }
 
-    return false;
+    bloomfilter_block_t missing = mask & ~*block;
+    uint64_t any = 0;
+
+    for(uint64_t i = 0; i < BLOOMFILTER_BLOCK_WORDS; i++) {
+        any |= missing[i];
+    }
+
+    return any == 0;
+}
+
+boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add) {
+    if(!bf || !data) {
+        return false;
+    }
+
+    if(data->type != DATA_TYPE_INT8_ARRAY || !data->length) {
+        return false;
+    }
+
+    if(bf->version == BLOOMFILTER_VERSION_SPLIT_BLOCK) {
+        return bloomfilter_split_block_check_or_add(bf, data, add);
+    }
+
+    return bloomfilter_double_hashing_check_or_add(bf, data, add);
 }
 
 
@@ -133,9 +294,13 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf) {
         return NULL;
     }
 
+    if(bf->version != BLOOMFILTER_VERSION_SPLIT_BLOCK) {
+        return NULL; // legacy filters are read only
+    }
+
     data_t d = {0};
     d.type = DATA_TYPE_DATA;
-    d.length = 7;
+    d.length = BLOOMFILTER_V2_FIELD_COUNT;
 
     data_t* fields = memory_malloc(sizeof(data_t) * d.length);
 
@@ -144,32 +309,25 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf) {
     }
 
     fields[0].type = DATA_TYPE_INT64;
-    fields[0].value = (void*)bf->entry_count;
+    fields[0].value = (void*)bf->version;
 
-    uint64_t tmp = 0;
-    memory_memcopy(&bf->bpe, &tmp, sizeof(uint64_t));
-    fields[1].type = DATA_TYPE_FLOAT64;
-    fields[1].value = (void*)tmp;
+    fields[1].type = DATA_TYPE_INT64;
+    fields[1].value = (void*)bf->entry_count;
 
-    tmp = 0;
+    uint64_t tmp = 0;
     memory_memcopy(&bf->error, &tmp, sizeof(uint64_t));
     fields[2].type = DATA_TYPE_FLOAT64;
     fields[2].value = (void*)tmp;
 
     fields[3].type = DATA_TYPE_INT64;
-    fields[3].value = (void*)bf->hash_count;
-
+    fields[3].value = (void*)bf->hash_seed;
 
     fields[4].type = DATA_TYPE_INT64;
-    fields[4].value = (void*)bf->hash_seed;
+    fields[4].value = (void*)bf->block_count;
 
-
-    fields[5].type = DATA_TYPE_INT64;
-    fields[5].value = (void*)bf->bit_count;
-
-    fields[6].type = DATA_TYPE_INT64_ARRAY;
-    fields[6].value = bf->bits;
-    fields[6].length = (bf->bit_count + 63) / 64;
+    fields[5].type = DATA_TYPE_INT64_ARRAY;
+    fields[5].value = bf->bits;
+    fields[5].length = bf->block_count * BLOOMFILTER_BLOCK_WORDS;
 
     d.value = fields;
 
@@ -180,42 +338,102 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf) {
     return res;
 }
 
-bloomfilter_t* bloomfilter_deserialize(data_t* data) {
-    if(!data) {
+/**
+ * @brief builds legacy double hashing filter from deserialized fields
+ * @param[in] fields deserialized fields, bit array ownership is taken
+ * @return bloom filter
+ */
+static bloomfilter_t* bloomfilter_deserialize_v1(data_t* fields) {
+    bloomfilter_t* res = memory_malloc(sizeof(bloomfilter_t));
+
+    if(!res) {
         return NULL;
     }
 
-    if(data->type != DATA_TYPE_INT8_ARRAY || !data->length) {
+    res->version = BLOOMFILTER_VERSION_DOUBLE_HASHING;
+    res->entry_count = (uint64_t)fields[0].value;
+    uint64_t tmp = (uint64_t)fields[1].value;
+    memory_memcopy(&tmp, &res->bpe, sizeof(uint64_t));
+    tmp = (uint64_t)fields[2].value;
+    memory_memcopy(&tmp, &res->error, sizeof(uint64_t));
+    res->hash_count = (uint64_t)fields[3].value;
+    res->hash_seed = (uint64_t)fields[4].value;
+    res->bit_count = (uint64_t)fields[5].value;
+    res->bits = (uint64_t*)fields[6].value;
+
+    return res;
+}
+
+/**
+ * @brief builds split block filter from deserialized fields
+ * @param[in] fields deserialized fields, bit array is copied into aligned memory
+ * @return bloom filter
+ */
+static bloomfilter_t* bloomfilter_deserialize_v2(data_t* fields) {
+    uint64_t block_count = (uint64_t)fields[4].value;
+
+    if(!block_count || (block_count & (block_count - 1)) ||
+       fields[5].type != DATA_TYPE_INT64_ARRAY || fields[5].length != block_count * BLOOMFILTER_BLOCK_WORDS) {
         return NULL;
     }
 
-    data_t* bf_data = data_bson_deserialize(data);
+    bloomfilter_t* res = memory_malloc(sizeof(bloomfilter_t));
 
-    if(!bf_data) {
+    if(!res) {
         return NULL;
     }
 
-    if(bf_data->length != 7 || bf_data->value == NULL) {
-        data_free(bf_data);
+    res->bits = memory_malloc_aligned(block_count * BLOOMFILTER_BLOCK_SIZE, BLOOMFILTER_BLOCK_SIZE);
+
+    if(!res->bits) {
+        memory_free(res);
 
         return NULL;
     }
 
-    data_t* fields = (data_t*)bf_data->value;
+    memory_memcopy(fields[5].value, res->bits, block_count * BLOOMFILTER_BLOCK_SIZE);
 
-    uint64_t entry_count = (uint64_t)fields[0].value;
-    float64_t bpe = 0;
-    uint64_t tmp = (uint64_t)fields[1].value;
-    memory_memcopy(&tmp, &bpe, sizeof(uint64_t));
-    float64_t error = 0;
-    tmp = (uint64_t)fields[2].value;
-    memory_memcopy(&tmp, &error, sizeof(uint64_t));
-    uint64_t hash_count = (uint64_t)fields[3].value;
-    uint64_t hash_seed = (uint64_t)fields[4].value;
-    uint64_t bit_count = (uint64_t)fields[5].value;
-    uint64_t* bits = (uint64_t*)fields[6].value;
+    res->version = BLOOMFILTER_VERSION_SPLIT_BLOCK;
+    res->entry_count = (uint64_t)fields[1].value;
+    uint64_t tmp = (uint64_t)fields[2].value;
+    memory_memcopy(&tmp, &res->error, sizeof(uint64_t));
+    res->bpe = math_log(1.0 / res->error) / (LN2 * LN2);
+    res->hash_count = BLOOMFILTER_BLOCK_WORDS;
+    res->hash_seed = (uint64_t)fields[3].value;
+    res->block_count = block_count;
+    res->bit_count = block_count * BLOOMFILTER_BLOCK_BITS;
 
-    bloomfilter_t* res = memory_malloc(sizeof(bloomfilter_t));
+    memory_free(fields[5].value);
+
+    return res;
+}
+
+bloomfilter_t* bloomfilter_deserialize(data_t* data) {
+    if(!data) {
+        return NULL;
+    }
+
+    if(data->type != DATA_TYPE_INT8_ARRAY || !data->length) {
+        return NULL;
+    }
+
+    data_t* bf_data = data_bson_deserialize(data);
+
+    if(!bf_data) {
+        return NULL;
+    }
+
+    data_t* fields = (data_t*)bf_data->value;
+    bloomfilter_t* res = NULL;
+
+    if(fields == NULL) {
+        res = NULL;
+    } else if(bf_data->length == BLOOMFILTER_V1_FIELD_COUNT) {
+        res = bloomfilter_deserialize_v1(fields);
+    } else if(bf_data->length == BLOOMFILTER_V2_FIELD_COUNT &&
+              (uint64_t)fields[0].value == BLOOMFILTER_VERSION_SPLIT_BLOCK) {
+        res = bloomfilter_deserialize_v2(fields);
+    }
 
     if(!res) {
         data_free(bf_data);
@@ -223,14 +441,6 @@ bloomfilter_t* bloomfilter_deserialize(data_t* data) {
         return NULL;
     }
 
-    res->entry_count = entry_count;
-    res->bpe = bpe;
-    res->error = error;
-    res->hash_count = hash_count;
-    res->hash_seed = hash_seed;
-    res->bit_count = bit_count;
-    res->bits = bits;
-
     memory_free(fields);
     memory_free(bf_data);
 
@@ -2,6 +2,9 @@
  * @file bplustree.64.c
  * @brief b+ tree implementation
  *
+ * nodes are single cache line aligned allocations holding key, prefix and value arrays,
+ * searched with binary search. leafs are linked for iteration.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
@@ -13,23 +16,26 @@
 
 MODULE("turnstone.lib");
 
+/*! node allocation alignment, one cache line */
+#define BPLUSTREE_NODE_ALIGNMENT 0x40
+
 /**
  * @struct bplustree_node_internal_t
  * @brief internal tree node
  *
- * keys are sorted list.
- * both datas and childs are can not be setted at same time.
- *
- * TODO: make datas and childs as union an insert node type enum
+ * keys are sorted array with key_count entries. leafs store datas (or buckets for non unique
+ * trees) at values, internal nodes store key_count + 1 childs at values. key i of an internal
+ * node is less than or equal to every key at child i + 1 and greater than every key at child i.
  */
 typedef struct bplustree_node_internal_t {
-    list_t*                           keys; ///< keys at node (it is a sorted list)
-    struct bplustree_node_internal_t* next; ///< next node at tree same tree depth
-    struct bplustree_node_internal_t* previous; ///< previous node at tree same tree depth
     struct bplustree_node_internal_t* parent; ///< parent node
-    list_t*                           datas; ///< data values if it is leaf node
-    list_t*                           childs; ///< child nodes if it is internal node
-    boolean_t                         data_as_bucket; ///< if true data is bucket
+    struct bplustree_node_internal_t* next; ///< next leaf node
+    struct bplustree_node_internal_t* previous; ///< previous leaf node
+    uint64_t                          key_count; ///< key count at node
+    boolean_t                         is_leaf; ///< if true values are datas else childs
+    uint64_t*                         prefixes; ///< inline key prefixes if tree has key prefix function
+    const void**                      keys; ///< keys at node
+    void**                            values; ///< datas if it is leaf node, childs if internal node
 }bplustree_node_internal_t; ///< short hand for struct
 
 /**
@@ -39,11 +45,13 @@ typedef struct bplustree_node_internal_t {
 typedef struct bplustree_internal_t {
     bplustree_node_internal_t* root; ///< root node
     uint64_t                   max_key_count; ///< maximum key count for each node
+    uint64_t                   min_key_count; ///< minimum key count for each non root node
     boolean_t                  unique; ///< if key present replace data
     uint64_t                   size; ///< element count
     index_key_comparator_f     comparator_for_identify_unique_subpart; ///< key comparator
     bplustree_key_destroyer_f  key_destroyer; ///< key destroyer
     bplustree_key_cloner_f     key_cloner; ///< key cloner
+    bplustree_key_prefix_f     key_prefix; ///< order preserving key prefix function
 } bplustree_internal_t; ///< short hand for struct
 
 /**
@@ -55,6 +63,7 @@ typedef struct bplustree_iterator_internal_t {
     const bplustree_node_internal_t* current_node; ///< the current leaf node
     size_t                           current_index; ///< index at first leaf node
     size_t                           current_bucket_index; ///< index at bucket
+    boolean_t                        data_as_bucket; ///< if true data is bucket
     int8_t                           end_of_iter; ///< end of iter flag
     index_key_search_criteria_t      criteria; ///< search criteria
     const void*                      key1; ///< search key for all type
@@ -75,28 +84,6 @@ iterator_t* bplustree_search(index_t* idx, const void* key1, const void* key2, c
 /*! b+ tree size implementation.*/
 uint64_t bplustree_size(index_t* idx);
 
-/**
- * @brief splits node into two half with min key constraint.
- * @param[in]  idx         b+ tree index
- * @param[in]  node        source node
- * @param[out]  ptr_par_key the middle key of partition (right node min key)
- * @return             new node (right one)
- */
-bplustree_node_internal_t* bplustree_split_node(index_t* idx, bplustree_node_internal_t* node, void** ptr_par_key);
-
-/**
- * @brief finds left leaf min key
- * @param[in] node node to start search
- * @return min key.
- */
-const void* bplustree_get_min_key(index_t* idx, const bplustree_node_internal_t* node);
-/**
- * @brief toss root, so level of tree become smaller.
- * @param[in]  idx b+ tree index
- * @return    0 if succeed.
- */
-int8_t bplustree_toss_root(index_t* idx);
-
 /**
  * @brief creates b+ tree iterator
  * @param[in]  idx source of b+ tree
@@ -177,6 +164,22 @@ int8_t bplustree_set_key_cloner(index_t* idx, bplustree_key_cloner_f cloner) {
     return 0;
 }
 
+int8_t bplustree_set_key_prefix(index_t* idx, bplustree_key_prefix_f key_prefix) {
+    if(idx == NULL || idx->metadata == NULL || key_prefix == NULL) {
+        return -1;
+    }
+
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+
+    if(tree->root != NULL) { // nodes are sized at creation, prefix arrays can not be added later
+        return -1;
+    }
+
+    tree->key_prefix = key_prefix;
+
+    return 0;
+}
+
 index_t* bplustree_create_index_with_heap_and_unique(memory_heap_t* heap, uint64_t max_key_count,
                                                      index_key_comparator_f comparator, boolean_t unique){
     if(max_key_count < 2) {
@@ -193,6 +196,7 @@ index_t* bplustree_create_index_with_heap_and_unique(memory_heap_t* heap, uint64
 
     tree->root = NULL;
     tree->max_key_count = max_key_count;
+    tree->min_key_count = max_key_count / 2;
     tree->unique = unique;
 
     index_t* idx = memory_malloc_ext(heap, sizeof(index_t), 0x0);
@@ -216,518 +220,656 @@ index_t* bplustree_create_index_with_heap_and_unique(memory_heap_t* heap, uint64
     return idx;
 }
 
-int8_t bplustree_destroy_index(index_t* idx){
-    if(idx == NULL || idx->metadata == NULL) {
-        return -1;
-    }
-
+/**
+ * @brief allocates a node with its arrays in one cache line aligned block
+ * @param[in] idx b+ tree index
+ * @param[in] is_leaf leaf flag
+ * @return new node or NULL
+ */
+static bplustree_node_internal_t* bplustree_node_create(index_t* idx, boolean_t is_leaf) {
     bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-    list_destroy_type_t destroy_type = tree->key_destroyer == NULL ? LIST_DESTROY_WITHOUT_DATA : LIST_DESTROY_WITH_DATA;
+    // one extra key slot and two extra value slots hold the overflow before split
+    uint64_t header_size = (sizeof(bplustree_node_internal_t) + 7) & ~7ULL;
+    uint64_t keys_size = sizeof(void*) * (tree->max_key_count + 1);
+    uint64_t values_size = sizeof(void*) * (tree->max_key_count + 2);
+    uint64_t prefixes_size = tree->key_prefix ? sizeof(uint64_t) * (tree->max_key_count + 1) : 0;
 
-    if(tree->root != NULL) {
-        const bplustree_node_internal_t* node = tree->root;
-        const bplustree_node_internal_t* tmp_node;
-
-        while(node != NULL) {
-            if(node->childs != NULL) {
-                if(list_size(node->childs) > 0) {
-                    node = list_get_data_at_position(node->childs, 0);
-                } else {
-                    list_destroy_with_type(node->keys, destroy_type, tree->key_destroyer);
-                    list_destroy(node->childs);
-                    tmp_node = node->parent;
-
-                    if(tmp_node != NULL) {
-                        list_delete_at_position(tmp_node->childs, 0);
-                    }
-
-                    memory_free_ext(idx->heap, (void*)node);
-                    node = tmp_node;
-                }
-            } else {
-                list_destroy_with_type(node->keys, destroy_type, tree->key_destroyer);
+    uint8_t* block = memory_malloc_ext(idx->heap, header_size + keys_size + values_size + prefixes_size, BPLUSTREE_NODE_ALIGNMENT);
 
-                if(!tree->unique) {
-                    iterator_t* iterator = list_iterator_create(node->datas);
+    if(block == NULL) {
+        return NULL;
+    }
 
-                    while(iterator->end_of_iterator(iterator) != 0) {
-                        list_t* bucket = (list_t*)iterator->get_item(iterator);
+    bplustree_node_internal_t* node = (bplustree_node_internal_t*)block;
 
-                        list_destroy(bucket);
+    node->is_leaf = is_leaf;
+    node->keys = (const void**)(block + header_size);
+    node->values = (void**)(block + header_size + keys_size);
 
-                        iterator = iterator->next(iterator);
-                    }
+    if(tree->key_prefix) {
+        node->prefixes = (uint64_t*)(block + header_size + keys_size + values_size);
+    }
 
-                    iterator->destroy(iterator);
-                }
+    return node;
+}
+
+/**
+ * @brief clones key if tree has a key cloner
+ * @param[in] idx b+ tree index
+ * @param[in] key key to clone
+ * @param[out] cloned_key cloned key or key itself
+ * @return 0 if succeed
+ */
+static int8_t bplustree_clone_key(index_t* idx, const void* key, const void** cloned_key) {
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-                list_destroy(node->datas);
+    if(tree->key_cloner == NULL) {
+        *cloned_key = key;
 
-                tmp_node = node->parent;
+        return 0;
+    }
 
-                if(tmp_node != NULL) {
-                    list_delete_at_position(tmp_node->childs, 0);
-                }
+    void* tmp = NULL;
 
-                memory_free_ext(idx->heap, (void*)node);
-                node = tmp_node;
-            }
-        }
+    if(tree->key_cloner(idx->heap, key, &tmp) != 0) {
+        return -1;
     }
 
-    memory_free_ext(idx->heap, tree);
-    memory_free_ext(idx->heap, idx);
+    *cloned_key = tmp;
 
     return 0;
 }
 
-bplustree_node_internal_t* bplustree_split_node(index_t* idx, bplustree_node_internal_t* node, void** ptr_par_key) {
+/**
+ * @brief destroys key if tree has a key destroyer
+ * @details separators are owned only when tree clones keys, otherwise they alias leaf keys.
+ * @param[in] idx b+ tree index
+ * @param[in] key key to destroy
+ * @param[in] is_separator true if key is an internal node key
+ */
+static void bplustree_destroy_key(index_t* idx, const void* key, boolean_t is_separator) {
     bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
-    bplustree_node_internal_t* new_node = memory_malloc_ext(idx->heap, sizeof(bplustree_node_internal_t), 0x0);
 
-    if(new_node == NULL) {
-        return NULL;
+    if(tree->key_destroyer && (!is_separator || tree->key_cloner)) {
+        tree->key_destroyer(idx->heap, (void*)key);
     }
+}
 
-    new_node->keys = list_create_sortedlist_with_heap(idx->heap, idx->comparator);
+/**
+ * @brief frees node keys, buckets and the node itself, childs are not touched
+ * @param[in] idx b+ tree index
+ * @param[in] node node to free
+ */
+static void bplustree_node_free(index_t* idx, bplustree_node_internal_t* node) {
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-    if(node->childs != NULL) { // not leaf node, needs childs
-        new_node->childs = list_create_list_with_heap(idx->heap);
-    } else { // leaf node needs datas
-        new_node->datas = list_create_list_with_heap(idx->heap);
+    for(uint64_t i = 0; i < node->key_count; i++) {
+        bplustree_destroy_key(idx, node->keys[i], !node->is_leaf);
 
-        if(!tree->unique) {
-            new_node->data_as_bucket = true;
+        if(node->is_leaf && !tree->unique) {
+            list_destroy((list_t*)node->values[i]);
         }
     }
 
-    int64_t div_pos = tree->max_key_count / 2;
+    memory_free_ext(idx->heap, node);
+}
 
-    if((tree->max_key_count % 2 ) != 0) {
-        div_pos++;
+/**
+ * @brief frees a subtree
+ * @param[in] idx b+ tree index
+ * @param[in] node subtree root
+ */
+static void bplustree_node_free_subtree(index_t* idx, bplustree_node_internal_t* node) {
+    if(!node->is_leaf) {
+        for(uint64_t i = 0; i <= node->key_count; i++) {
+            bplustree_node_free_subtree(idx, node->values[i]);
+        }
     }
 
-    int64_t child_pos = 1, child_idx = 0;
-    int64_t data_pos = 0, data_idx = 0;
-    const void* par_key = NULL;
+    bplustree_node_free(idx, node);
+}
 
-    iterator_t* iter = list_iterator_create(node->keys);
+int8_t bplustree_destroy_index(index_t* idx){
+    if(idx == NULL || idx->metadata == NULL) {
+        return -1;
+    }
 
-    while(iter->end_of_iterator(iter) != 0) {
-        if(div_pos == 0) {
-            const void* cur = iter->delete_item(iter);
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-            if(par_key == NULL) { // if we dont have partition key, we may need to clone it
-                if(node->childs == NULL) { // if we are at leaf node, we may need to clone it
-                    if(tree->key_cloner != NULL) { // if we have cloner, we need to clone it
-                        void* cloned_key = NULL;
+    if(tree->root != NULL) {
+        bplustree_node_free_subtree(idx, tree->root);
+    }
 
-                        if(tree->key_cloner(idx->heap, cur, &cloned_key) != 0) {
-                            memory_free_ext(idx->heap, new_node);
+    memory_free_ext(idx->heap, tree);
+    memory_free_ext(idx->heap, idx);
 
-                            return NULL;
-                        }
+    return 0;
+}
 
-                        par_key = cloned_key;
-                    } else { // if we are at internal node, we dont need to clone it
-                        par_key = cur;
-                    }
-                } else {
-                    par_key = cur;
-                }
+/**
+ * @brief computes search prefix of a key
+ * @param[in] tree b+ tree
+ * @param[in] key key
+ * @return prefix or 0 when tree has no prefix function
+ */
+static inline uint64_t bplustree_key_prefix(const bplustree_internal_t* tree, const void* key) {
+    return tree->key_prefix ? tree->key_prefix(key) : 0;
+}
 
-                if(node->childs == NULL) {
-                    list_sortedlist_insert(new_node->keys, cur); // par key is only inserted at leaf nodes
-                }
-            } else {
-                list_sortedlist_insert(new_node->keys, cur);
-            }
+/**
+ * @brief compares key at node position with search key, inline prefixes first
+ * @param[in] idx b+ tree index
+ * @param[in] node node
+ * @param[in] pos key position at node
+ * @param[in] key search key
+ * @param[in] prefix search key prefix
+ * @return comparator result of node key against search key
+ */
+static inline int8_t bplustree_node_compare(const index_t* idx, const bplustree_node_internal_t* node, uint64_t pos,
+                                            const void* key, uint64_t prefix) {
+    if(node->prefixes) {
+        if(node->prefixes[pos] < prefix) {
+            return -1;
+        }
 
-            if(node->childs != NULL) { // split childs too
-                bplustree_node_internal_t* tmp_child = (bplustree_node_internal_t*)list_delete_at_position(node->childs, child_pos);
+        if(node->prefixes[pos] > prefix) {
+            return 1;
+        }
+    }
 
-                if(tmp_child != NULL) {
-                    list_insert_at_position(new_node->childs, tmp_child, child_idx);
-                    tmp_child->parent = new_node;
-                }
+    return idx->comparator(node->keys[pos], key);
+}
 
-                child_idx++;
-            }
+/**
+ * @brief finds first key position which is not less than key
+ * @param[in] idx b+ tree index
+ * @param[in] node node to search
+ * @param[in] key search key
+ * @param[in] prefix search key prefix
+ * @return position between 0 and key count
+ */
+static uint64_t bplustree_node_lower_bound(const index_t* idx, const bplustree_node_internal_t* node, const void* key, uint64_t prefix) {
+    uint64_t low = 0;
+    uint64_t high = node->key_count;
 
-            if(node->childs == NULL) {
-                const void* tmp_data = list_delete_at_position(node->datas, data_pos);
-                list_insert_at_position(new_node->datas, tmp_data, data_idx);
-                data_idx++;
-            }
+    while(low < high) {
+        uint64_t mid = (low + high) / 2;
+
+        if(bplustree_node_compare(idx, node, mid, key, prefix) < 0) {
+            low = mid + 1;
         } else {
-            child_pos++;
-            data_pos++;
-            div_pos--;
+            high = mid;
         }
-
-        iter = iter->next(iter);
     }
 
-    iter->destroy(iter);
+    return low;
+}
 
-    new_node->previous = node;
-    new_node->next = node->next;
+/**
+ * @brief finds first key position which is greater than key
+ * @param[in] idx b+ tree index
+ * @param[in] node node to search
+ * @param[in] key search key
+ * @param[in] prefix search key prefix
+ * @return position between 0 and key count
+ */
+static uint64_t bplustree_node_upper_bound(const index_t* idx, const bplustree_node_internal_t* node, const void* key, uint64_t prefix) {
+    uint64_t low = 0;
+    uint64_t high = node->key_count;
 
-    if(node->next != NULL) {
-        node->next->previous = new_node;
+    while(low < high) {
+        uint64_t mid = (low + high) / 2;
+
+        if(bplustree_node_compare(idx, node, mid, key, prefix) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
     }
 
-    node->next = new_node;
+    return low;
+}
+
+/**
+ * @brief descends from root to the leaf which may contain key
+ * @param[in] idx b+ tree index
+ * @param[in] key search key
+ * @param[in] prefix search key prefix
+ * @return leaf node or NULL if tree is empty
+ */
+static bplustree_node_internal_t* bplustree_find_leaf(const index_t* idx, const void* key, uint64_t prefix) {
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+    bplustree_node_internal_t* node = tree->root;
+
+    while(node != NULL && !node->is_leaf) {
+        node = node->values[bplustree_node_upper_bound(idx, node, key, prefix)];
+    }
 
-    new_node->parent = node->parent; // set new nodes parent
-    *ptr_par_key = (void*)par_key;
-    return new_node;
+    return node;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-int8_t bplustree_insert(index_t* idx, const void* key, const void* data, void** removed_data){
-    if(idx == NULL) {
-        return -1;
+/**
+ * @brief inserts key and value into node arrays
+ * @param[in] tree b+ tree
+ * @param[in] node node
+ * @param[in] key_pos key position
+ * @param[in] key key
+ * @param[in] value_pos value position
+ * @param[in] value value
+ */
+static void bplustree_node_insert_at(const bplustree_internal_t* tree, bplustree_node_internal_t* node,
+                                     uint64_t key_pos, const void* key, uint64_t value_pos, void* value) {
+    uint64_t value_count = node->is_leaf ? node->key_count : node->key_count + 1;
+
+    for(uint64_t i = node->key_count; i > key_pos; i--) {
+        node->keys[i] = node->keys[i - 1];
     }
 
-    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
-    if(tree->root == NULL) {
-        tree->root = memory_malloc_ext(idx->heap, sizeof(bplustree_node_internal_t), 0x0);
+    node->keys[key_pos] = key;
 
-        if(tree->root == NULL) {
-            return -1;
+    if(node->prefixes) {
+        for(uint64_t i = node->key_count; i > key_pos; i--) {
+            node->prefixes[i] = node->prefixes[i - 1];
         }
 
+        node->prefixes[key_pos] = bplustree_key_prefix(tree, key);
+    }
 
-        tree->root->keys = list_create_sortedlist_with_heap(idx->heap, idx->comparator);
+    for(uint64_t i = value_count; i > value_pos; i--) {
+        node->values[i] = node->values[i - 1];
+    }
 
-        if(tree->root->keys == NULL) {
-            memory_free_ext(idx->heap, tree->root);
+    node->values[value_pos] = value;
+    node->key_count++;
+}
 
-            return -1;
-        }
+/**
+ * @brief removes key and value from node arrays
+ * @param[in] node node
+ * @param[in] key_pos key position
+ * @param[in] value_pos value position
+ */
+static void bplustree_node_remove_at(bplustree_node_internal_t* node, uint64_t key_pos, uint64_t value_pos) {
+    uint64_t value_count = node->is_leaf ? node->key_count : node->key_count + 1;
 
-        if(tree->key_cloner) {
-            void* cloned_key = NULL;
+    for(uint64_t i = key_pos + 1; i < node->key_count; i++) {
+        node->keys[i - 1] = node->keys[i];
+    }
 
-            if(tree->key_cloner(idx->heap, key, &cloned_key) != 0) {
-                memory_free_ext(idx->heap, tree->root->keys);
-                memory_free_ext(idx->heap, tree->root);
+    if(node->prefixes) {
+        for(uint64_t i = key_pos + 1; i < node->key_count; i++) {
+            node->prefixes[i - 1] = node->prefixes[i];
+        }
+    }
 
-                return -1;
-            }
+    for(uint64_t i = value_pos + 1; i < value_count; i++) {
+        node->values[i - 1] = node->values[i];
+    }
 
-            key = cloned_key;
-        }
+    node->key_count--;
+}
 
-        list_sortedlist_insert(tree->root->keys, key);
+/**
+ * @brief moves keys and values from source starting at positions to the end of destination
+ * @param[in] dst destination node
+ * @param[in] dst_value_count value count already at destination
+ * @param[in] src source node
+ * @param[in] key_pos first source key
+ * @param[in] value_pos first source value
+ * @param[in] value_count moved value count
+ */
+static void bplustree_node_move_tail(bplustree_node_internal_t* dst, uint64_t dst_value_count, bplustree_node_internal_t* src,
+                                     uint64_t key_pos, uint64_t value_pos, uint64_t value_count) {
+    uint64_t key_count = src->key_count - key_pos;
 
+    memory_memcopy(src->keys + key_pos, dst->keys + dst->key_count, sizeof(void*) * key_count);
 
-        tree->root->datas = list_create_list_with_heap(idx->heap);
+    if(dst->prefixes) {
+        memory_memcopy(src->prefixes + key_pos, dst->prefixes + dst->key_count, sizeof(uint64_t) * key_count);
+    }
 
-        if(tree->root->datas == NULL) {
-            memory_free_ext(idx->heap, tree->root->keys);
-            memory_free_ext(idx->heap, tree->root);
+    memory_memcopy(src->values + value_pos, dst->values + dst_value_count, sizeof(void*) * value_count);
 
-            return -1;
+    if(!dst->is_leaf) {
+        for(uint64_t i = 0; i < value_count; i++) {
+            ((bplustree_node_internal_t*)dst->values[dst_value_count + i])->parent = dst;
         }
+    }
 
-        tree->size++;
-
-        if(tree->unique) {
-            list_insert_at_position(tree->root->datas, data, 0);
-        } else {
-            list_t* bucket = list_create_sortedlist_with_heap(idx->heap, tree->comparator_for_identify_unique_subpart);
+    dst->key_count += key_count;
+    src->key_count = key_pos;
+}
 
-            if(!bucket) {
-                memory_free_ext(idx->heap, tree->root->keys);
-                memory_free_ext(idx->heap, tree->root->datas);
-                memory_free_ext(idx->heap, tree->root);
+/**
+ * @brief finds child position at parent
+ * @param[in] parent parent node
+ * @param[in] child child node
+ * @return position
+ */
+static uint64_t bplustree_child_position(const bplustree_node_internal_t* parent, const bplustree_node_internal_t* child) {
+    uint64_t pos = 0;
 
-                return -1;
-            }
+    while(pos < parent->key_count && parent->values[pos] != child) {
+        pos++;
+    }
 
-            list_insert_at_position(bucket, data, 0);
-            list_insert_at_position(tree->root->datas, bucket, 0);
-            tree->root->data_as_bucket = true;
-        }
+    return pos;
+}
 
-    } else {
-        bplustree_node_internal_t* node = tree->root;
-        int8_t inserted = 0;
+/**
+ * @brief splits full nodes upwards starting from a leaf
+ * @param[in] idx b+ tree index
+ * @param[in] node overflowed leaf node
+ * @return 0 if succeed
+ */
+static int8_t bplustree_split(index_t* idx, bplustree_node_internal_t* node) {
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-        while(inserted == 0) {
-            if(node->childs == NULL) { // leaf node
-                size_t position;
-                boolean_t key_found = false;
+    while(node->key_count > tree->max_key_count) {
+        bplustree_node_internal_t* new_node = bplustree_node_create(idx, node->is_leaf);
 
-                if(list_get_position(node->keys, key, &position) == 0) {
-                    key_found = true;
-                }
+        if(new_node == NULL) {
+            return -1;
+        }
 
-                if(tree->unique && key_found) {
-                    if(removed_data) {
-                        *removed_data = (void*)list_get_data_at_position(node->datas, position);
-                    }
+        const void* par_key = NULL;
 
-                    list_delete_at_position(node->datas, position);
-                    tree->size--;
-                }
+        if(node->is_leaf) {
+            // left keeps the larger half, right min key is copied up
+            uint64_t div_pos = (node->key_count + 1) / 2;
 
-                size_t key_pos = 0;
+            if(bplustree_clone_key(idx, node->keys[div_pos], &par_key) != 0) {
+                memory_free_ext(idx->heap, new_node);
 
-                if(!key_found) {
-                    if(tree->key_cloner) {
-                        void* cloned_key = NULL;
+                return -1;
+            }
 
-                        if(tree->key_cloner(idx->heap, key, &cloned_key) != 0) {
-                            return -1;
-                        }
+            bplustree_node_move_tail(new_node, 0, node, div_pos, div_pos, node->key_count - div_pos);
 
-                        key = cloned_key;
-                    }
+            new_node->previous = node;
+            new_node->next = node->next;
 
-                    key_pos = list_sortedlist_insert(node->keys, key);
-                } else {
-                    key_pos = position;
-                }
+            if(node->next != NULL) {
+                node->next->previous = new_node;
+            }
 
-                if(tree->unique) {
-                    list_insert_at_position(node->datas, data, key_pos);
-                } else {
-                    if(key_found) {
-                        list_t* bucket = (list_t*)list_get_data_at_position(node->datas, key_pos);
+            node->next = new_node;
+        } else {
+            // middle key moves up, its right child becomes first child of new node
+            uint64_t div_pos = node->key_count / 2;
 
-                        if(bucket == NULL) {
-                            return -1;
-                        }
+            par_key = node->keys[div_pos];
+            bplustree_node_move_tail(new_node, 0, node, div_pos + 1, div_pos + 1, node->key_count - div_pos);
+            node->key_count = div_pos;
+        }
 
-                        if(tree->comparator_for_identify_unique_subpart) {
-                            size_t bucket_key_pos;
+        bplustree_node_internal_t* parent = node->parent;
 
-                            if(list_get_position(bucket, data, &bucket_key_pos) == 0) {
-                                void* local_removed_data = (void*)list_get_data_at_position(bucket, bucket_key_pos);
+        if(parent == NULL) { // root node
+            parent = bplustree_node_create(idx, false);
 
-                                if(removed_data) {
-                                    *removed_data = local_removed_data;
-                                }
+            if(parent == NULL) {
+                return -1;
+            }
 
-                                list_delete_at_position(bucket, bucket_key_pos);
+            parent->values[0] = node;
+            node->parent = parent;
+            tree->root = parent;
+        }
 
-                                tree->size--;
-                            }
-                        }
+        new_node->parent = parent;
 
-                        list_sortedlist_insert(bucket, data);
-                    } else {
-                        list_t* bucket = list_create_sortedlist_with_heap(idx->heap, tree->comparator_for_identify_unique_subpart);
+        uint64_t pos = bplustree_child_position(parent, node);
 
-                        list_insert_at_position(bucket, data, 0);
-                        list_insert_at_position(node->datas, bucket, key_pos);
-                    }
+        bplustree_node_insert_at(tree, parent, pos, par_key, pos + 1, new_node);
 
-                    node->data_as_bucket = true;
-                }
+        node = parent;
+    }
 
-                tree->size++;
+    return 0;
+}
 
-                void* par_key;
-                bplustree_node_internal_t* new_node;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+int8_t bplustree_insert(index_t* idx, const void* key, const void* data, void** removed_data){
+    if(idx == NULL) {
+        return -1;
+    }
 
-                while(list_size(node->keys) > tree->max_key_count) { // node is full split it
-                    new_node = bplustree_split_node(idx, (bplustree_node_internal_t*)node, &par_key);
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-                    if(new_node == NULL) {
-                        return -1;
-                    }
+    if(tree->root == NULL) {
+        tree->root = bplustree_node_create(idx, true);
 
-                    if(node->parent == NULL) { // root node
-                        node->parent = memory_malloc_ext(idx->heap, sizeof(bplustree_node_internal_t), 0x0);
+        if(tree->root == NULL) {
+            return -1;
+        }
+    }
 
-                        if(node->parent == NULL) {
-                            memory_free_ext(idx->heap, new_node);
+    uint64_t prefix = bplustree_key_prefix(tree, key);
+    bplustree_node_internal_t* node = bplustree_find_leaf(idx, key, prefix);
+    uint64_t pos = bplustree_node_lower_bound(idx, node, key, prefix);
+    boolean_t key_found = pos < node->key_count && bplustree_node_compare(idx, node, pos, key, prefix) == 0;
 
-                            return -1;
-                        }
+    if(key_found) {
+        if(tree->unique) {
+            if(removed_data) {
+                *removed_data = node->values[pos];
+            }
 
-                        new_node->parent = node->parent;
-                        node->parent->keys = list_create_sortedlist_with_heap(idx->heap, idx->comparator);
+            node->values[pos] = (void*)data;
 
-                        if(node->parent->keys == NULL) {
-                            memory_free_ext(idx->heap, new_node);
-                            memory_free_ext(idx->heap, node->parent);
-                            node->parent = NULL;
+            return 0;
+        }
 
-                            return -1;
-                        }
+        list_t* bucket = (list_t*)node->values[pos];
 
-                        key_pos = list_sortedlist_insert(node->parent->keys, par_key);
-                        node->parent->childs = list_create_list_with_heap(idx->heap);
+        if(tree->comparator_for_identify_unique_subpart) {
+            size_t bucket_key_pos;
 
-                        if(node->parent->keys == NULL) {
-                            memory_free_ext(idx->heap, (void*)new_node);
-                            memory_free_ext(idx->heap, node->parent->keys);
-                            memory_free_ext(idx->heap, (void*)node->parent);
-                            node->parent = NULL;
+            if(list_get_position(bucket, data, &bucket_key_pos) == 0) {
+                void* local_removed_data = (void*)list_get_data_at_position(bucket, bucket_key_pos);
 
-                            return -1;
-                        }
+                if(removed_data) {
+                    *removed_data = local_removed_data;
+                }
 
-                        list_insert_at_position(node->parent->childs, node, 0);
-                        list_insert_at_position(node->parent->childs, new_node, 1);
-                        tree->root = node->parent;
+                list_delete_at_position(bucket, bucket_key_pos);
 
-                        break; // end of upward propogation
-                    } else {
-                        key_pos = list_sortedlist_insert(node->parent->keys, par_key);
+                tree->size--;
+            }
+        }
 
-                        if(list_insert_at_position(node->parent->childs, new_node, key_pos + 1) != key_pos + 1) {
-                            return -2;
-                        }
+        list_sortedlist_insert(bucket, data);
+        tree->size++;
 
-                        node = node->parent;
-                    }
-                }
+        return 0;
+    }
 
-                inserted = 1;
-            } else { // internal node
-                size_t pos = 0;
-                iterator_t* iter = list_iterator_create(node->keys);
+    void* value = (void*)data;
 
-                while(iter->end_of_iterator(iter) != 0) {
-                    const void* cur = iter->get_item(iter);
+    if(!tree->unique) {
+        list_t* bucket = list_create_sortedlist_with_heap(idx->heap, tree->comparator_for_identify_unique_subpart);
 
-                    if(idx->comparator(cur, key) <= 0) {
-                        pos++;
-                    } else {
-                        break;
-                    }
+        if(bucket == NULL) {
+            return -1;
+        }
 
-                    iter = iter->next(iter);
-                }
+        list_insert_at_position(bucket, data, 0);
+        value = bucket;
+    }
 
-                iter->destroy(iter);
-                node = (bplustree_node_internal_t*)list_get_data_at_position(node->childs, pos);
+    const void* stored_key = NULL;
 
-                if( node == NULL) {
-                    return -2; // child pos always exits.
-                }
-            }
+    if(bplustree_clone_key(idx, key, &stored_key) != 0) {
+        if(!tree->unique) {
+            list_destroy(value);
         }
+
+        return -1;
     }
 
-    return 0;
+    bplustree_node_insert_at(tree, node, pos, stored_key, pos, value);
+    tree->size++;
+
+    return bplustree_split(idx, node);
 }
 #pragma GCC diagnostic pop
 
-const void* bplustree_get_min_key(index_t* idx, const bplustree_node_internal_t* node) {
-    if(node == NULL) {
-        return NULL;
+/**
+ * @brief finds subtree minimum key
+ * @param[in] node subtree root
+ * @return min key
+ */
+static const void* bplustree_node_min_key(const bplustree_node_internal_t* node) {
+    while(!node->is_leaf) {
+        node = node->values[0];
     }
 
-    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
-
-    while(node->childs != NULL) {
-        node = list_get_data_at_position(node->childs, 0);
-    }
+    return node->keys[0];
+}
 
-    const void* key = list_get_data_at_position(node->keys, 0);
+/**
+ * @brief replaces separator equal to a deleted key with min key of its right subtree
+ * @details without key cloner separators alias leaf keys, so they must not outlive them.
+ * @param[in] idx b+ tree index
+ * @param[in] key deleted key
+ * @param[in] prefix deleted key prefix
+ */
+static void bplustree_refresh_separator(index_t* idx, const void* key, uint64_t prefix) {
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+    bplustree_node_internal_t* node = tree->root;
 
-    if(tree->key_cloner) {
-        void* cloned_key = NULL;
+    while(node != NULL && !node->is_leaf) {
+        uint64_t pos = bplustree_node_upper_bound(idx, node, key, prefix);
 
-        if(tree->key_cloner(idx->heap, key, &cloned_key) != 0) {
+        if(pos > 0 && bplustree_node_compare(idx, node, pos - 1, key, prefix) == 0) {
+            node->keys[pos - 1] = bplustree_node_min_key(node->values[pos]);
 
-            return NULL;
+            if(node->prefixes) {
+                node->prefixes[pos - 1] = bplustree_key_prefix(tree, node->keys[pos - 1]);
+            }
         }
 
-        key = cloned_key;
+        node = node->values[pos];
     }
-
-    return key;
 }
 
-int8_t bplustree_toss_root(index_t* idx) {
+/**
+ * @brief fixes underflowed nodes upwards by borrowing from or merging with siblings
+ * @param[in] idx b+ tree index
+ * @param[in] node node which lost a key
+ */
+static void bplustree_rebalance(index_t* idx, bplustree_node_internal_t* node) {
     bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
-    const bplustree_node_internal_t* root = tree->root;
-
-    list_destroy_type_t destroy_type = tree->key_destroyer == NULL?LIST_DESTROY_WITHOUT_DATA:LIST_DESTROY_WITH_DATA;
 
-    if(root->childs != NULL) {
-        if(list_size(root->keys) <= 1) {
-            bplustree_node_internal_t* left_child = (bplustree_node_internal_t*)list_get_data_at_position(root->childs, 0);
-            bplustree_node_internal_t* right_child = (bplustree_node_internal_t*)list_get_data_at_position(root->childs, 1);
+    while(node->parent != NULL && node->key_count < tree->min_key_count) {
+        bplustree_node_internal_t* parent = node->parent;
+        uint64_t pos = bplustree_child_position(parent, node);
+        bplustree_node_internal_t* left = pos > 0 ? parent->values[pos - 1] : NULL;
+        bplustree_node_internal_t* right = pos < parent->key_count ? parent->values[pos + 1] : NULL;
 
-            if(right_child != NULL) {
+        if(left != NULL && left->key_count > tree->min_key_count) { // borrow from left
+            if(node->is_leaf) {
+                const void* sep_key = NULL;
 
-                size_t key_size = list_size(left_child->keys) + list_size(right_child->keys);
-                if(left_child->childs != NULL) {
-                    key_size += list_size(root->keys);
+                if(bplustree_clone_key(idx, left->keys[left->key_count - 1], &sep_key) != 0) {
+                    return;
                 }
-                if(key_size > tree->max_key_count) {
-                    return 0;
-                }
-
 
+                bplustree_node_insert_at(tree, node, 0, left->keys[left->key_count - 1], 0, left->values[left->key_count - 1]);
+                bplustree_node_remove_at(left, left->key_count - 1, left->key_count - 1);
 
-                list_delete_at_position(root->childs, 0);
-                list_delete_at_position(root->childs, 0);
-                const void* root_key = list_delete_at_position(root->keys, 0);
+                bplustree_destroy_key(idx, parent->keys[pos - 1], true);
+                parent->keys[pos - 1] = sep_key;
+            } else {
+                bplustree_node_internal_t* child = left->values[left->key_count];
 
+                bplustree_node_insert_at(tree, node, 0, parent->keys[pos - 1], 0, child);
+                child->parent = node;
+                parent->keys[pos - 1] = left->keys[left->key_count - 1];
+                left->key_count--;
+            }
 
-                if(root_key != NULL && left_child->childs != NULL) {
-                    list_insert_at(left_child->keys, root_key, LIST_INSERT_AT_TAIL, 0);
-                }
+            if(parent->prefixes) {
+                parent->prefixes[pos - 1] = bplustree_key_prefix(tree, parent->keys[pos - 1]);
+            }
 
-                const void* tmp;
-                while(list_size(right_child->keys) > 0) {
-                    tmp = list_delete_at_position(right_child->keys, 0);
-                    list_insert_at(left_child->keys, tmp, LIST_INSERT_AT_TAIL, 0);
-                }
+            return;
+        }
 
+        if(right != NULL && right->key_count > tree->min_key_count) { // borrow from right
+            if(node->is_leaf) {
+                const void* sep_key = NULL;
 
-                if(left_child->childs == NULL) {
-                    while(list_size(right_child->datas) > 0) {
-                        tmp = list_delete_at_position(right_child->datas, 0);
-                        list_insert_at(left_child->datas, tmp, LIST_INSERT_AT_TAIL, 0);
-                    }
-                } else {
-                    while(list_size(right_child->childs) > 0) {
-                        tmp = list_delete_at_position(right_child->childs, 0);
-                        list_insert_at(left_child->childs, tmp, LIST_INSERT_AT_TAIL, 0);
-                        ((bplustree_node_internal_t*)tmp)->parent = left_child;
-                    }
+                if(bplustree_clone_key(idx, right->keys[1], &sep_key) != 0) {
+                    return;
                 }
 
-                list_destroy_with_type(right_child->keys, destroy_type, tree->key_destroyer);
+                bplustree_node_insert_at(tree, node, node->key_count, right->keys[0], node->key_count, right->values[0]);
+                bplustree_node_remove_at(right, 0, 0);
 
-                if(left_child->childs == NULL) {
-                    list_destroy(right_child->datas);
-                } else {
-                    list_destroy(right_child->childs);
-                }
+                bplustree_destroy_key(idx, parent->keys[pos], true);
+                parent->keys[pos] = sep_key;
+            } else {
+                bplustree_node_internal_t* child = right->values[0];
 
-                memory_free_ext(idx->heap, (void*)right_child);
+                bplustree_node_insert_at(tree, node, node->key_count, parent->keys[pos], node->key_count + 1, child);
+                child->parent = node;
+                parent->keys[pos] = right->keys[0];
+                bplustree_node_remove_at(right, 0, 0);
+            }
 
+            if(parent->prefixes) {
+                parent->prefixes[pos] = bplustree_key_prefix(tree, parent->keys[pos]);
             }
 
-            list_destroy_with_type(root->keys, destroy_type, tree->key_destroyer);
-            list_destroy(root->childs);
-            memory_free_ext(idx->heap, (void*)root);
+            return;
+        }
+
+        // merge right one into left one, separator is removed from parent
+        uint64_t sep_pos = left != NULL ? pos - 1 : pos;
+
+        if(left == NULL) {
+            left = node;
+        } else {
+            right = node;
+        }
+
+        if(right == NULL) { // only child of parent, can only happen at malformed trees
+            return;
+        }
+
+        if(left->is_leaf) {
+            bplustree_destroy_key(idx, parent->keys[sep_pos], true);
+            bplustree_node_move_tail(left, left->key_count, right, 0, 0, right->key_count);
 
-            left_child->next = NULL;
-            left_child->parent = NULL;
+            left->next = right->next;
 
-            tree->root = left_child;
+            if(right->next != NULL) {
+                right->next->previous = left;
+            }
+        } else {
+            bplustree_node_insert_at(tree, left, left->key_count, parent->keys[sep_pos], left->key_count + 1, right->values[0]);
+            ((bplustree_node_internal_t*)right->values[0])->parent = left;
+            bplustree_node_move_tail(left, left->key_count + 1, right, 0, 1, right->key_count);
         }
+
+        right->key_count = 0;
+        memory_free_ext(idx->heap, right);
+        bplustree_node_remove_at(parent, sep_pos, sep_pos + 1);
+
+        node = parent;
+    }
+
+    if(node->parent == NULL && !node->is_leaf && node->key_count == 0) { // toss root
+        tree->root = node->values[0];
+        tree->root->parent = NULL;
+        memory_free_ext(idx->heap, node);
     }
-    return 0;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 int8_t bplustree_delete(index_t* idx, const void* key, void** deleted_data){
     if(idx == NULL) {
         return -1;
@@ -736,492 +878,333 @@ int8_t bplustree_delete(index_t* idx, const void* key, void** deleted_data){
     bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
     if(tree->root == NULL) {
-        return NULL;
+        return -1;
     }
 
-    list_destroy_type_t destroy_type = tree->key_destroyer == NULL ? LIST_DESTROY_WITHOUT_DATA : LIST_DESTROY_WITH_DATA;
-
-    size_t min_keys = (tree->max_key_count + 1) / 2;
+    uint64_t prefix = bplustree_key_prefix(tree, key);
+    bplustree_node_internal_t* node = bplustree_find_leaf(idx, key, prefix);
+    uint64_t pos = bplustree_node_lower_bound(idx, node, key, prefix);
 
-    if(((tree->max_key_count + 1) % 2 ) != 0) {
-        min_keys++;
+    if(pos == node->key_count || bplustree_node_compare(idx, node, pos, key, prefix) != 0) {
+        return -1;
     }
 
-    min_keys--;
-    bplustree_node_internal_t* node = tree->root;
-    list_t* path = list_create_stack_with_heap(idx->heap);
+    if(tree->unique) {
+        if(deleted_data) {
+            *deleted_data = node->values[pos];
+        }
 
-    if(path == NULL) {
-        return -1;
-    }
+        tree->size--;
+    } else {
+        list_t* bucket = (list_t*)node->values[pos];
 
-    boolean_t found = false;
-    size_t delete_item_count = 0;
+        if(tree->comparator_for_identify_unique_subpart) {
+            // key also identifies the item inside bucket
+            size_t position_at_bucket = 0;
 
-    while(node != NULL) {
-        size_t* position = memory_malloc_ext(idx->heap, sizeof(size_t), 0x0);
+            if(list_get_position(bucket, key, &position_at_bucket) != 0) {
+                return -1;
+            }
 
-        if(position == NULL) {
-            list_destroy(path);
+            void* tmp = (void*)list_delete_at_position(bucket, position_at_bucket);
 
-            return -1;
-        }
+            if(deleted_data) {
+                *deleted_data = tmp;
+            }
 
-        *position = 0;
+            tree->size--;
 
-        if(node->childs != NULL) { // internal node
-            const void* cur = NULL;
-            iterator_t* iter = list_iterator_create(node->keys);
+            if(list_size(bucket) > 0) {
+                return 0;
+            }
+        } else {
+            if(deleted_data) {
+                *deleted_data = (void*)list_get_data_at_position(bucket, 0);
+            }
 
-            while(iter->end_of_iterator(iter) != 0) {
-                cur = iter->get_item(iter);
+            tree->size -= list_size(bucket);
+        }
 
-                if(idx->comparator(cur, key) <= 0) {
-                    (*position)++;
-                } else {
-                    break;
-                }
+        list_destroy(bucket);
+    }
 
-                iter = iter->next(iter);
-            }
+    const void* old_key = node->keys[pos];
 
-            iter->destroy(iter);
-            node = (bplustree_node_internal_t*)list_get_data_at_position(node->childs, *position);
-            list_stack_push(path, position);
-        } else { // leaf node
-            if(list_get_position(node->keys, key, position) != 0) {
-                memory_free_ext(idx->heap, position);
+    bplustree_node_remove_at(node, pos, pos);
 
-                break;
-            } else {
-                list_stack_push(path, position);
+    if(node == tree->root && node->key_count == 0) {
+        memory_free_ext(idx->heap, node);
+        tree->root = NULL;
+    } else {
+        bplustree_rebalance(idx, node);
 
-                if(tree->unique) {
-                    if(deleted_data) {
-                        *deleted_data = (void*)list_get_data_at_position(node->datas, *position);
-                    }
+        if(tree->key_cloner == NULL) {
+            bplustree_refresh_separator(idx, key, prefix);
+        }
+    }
 
-                    delete_item_count = 1;
+    bplustree_destroy_key(idx, old_key, false);
 
-                    found = true;
+    return 0;
+}
 
-                    break;
-                } else {
-                    if(tree->comparator_for_identify_unique_subpart) {
-                        size_t position_at_bucket = 0;
+const void* bplustree_find(index_t* idx, const void* key) {
+    if(idx == NULL || idx->metadata == NULL) {
+        return NULL;
+    }
 
-                        if(list_get_position(node->datas, key, &position_at_bucket) != 0) {
-                            memory_free_ext(idx->heap, position);
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+    uint64_t prefix = bplustree_key_prefix(tree, key);
+    const bplustree_node_internal_t* node = bplustree_find_leaf(idx, key, prefix);
 
-                            found = false;
+    if(node == NULL) {
+        return NULL;
+    }
 
-                            break;
-                        } else {
-                            void* tmp = (void*)list_get_data_at_position(node->datas, position_at_bucket);
+    uint64_t pos = bplustree_node_lower_bound(idx, node, key, prefix);
 
-                            if(deleted_data) {
-                                *deleted_data = tmp;
-                            }
+    if(pos == node->key_count || bplustree_node_compare(idx, node, pos, key, prefix) != 0) {
+        return NULL;
+    }
 
-                            list_delete_at_position(node->datas, position_at_bucket);
+    return node->values[pos];
+}
 
-                            if(list_size(node->datas) == 0) {
-                                found = true;
-                                delete_item_count = 1;
+boolean_t bplustree_contains(index_t* idx, const void* key){
+    if(idx == NULL || idx->metadata == NULL) {
+        return false;
+    }
 
-                                break;
-                            }
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+    uint64_t prefix = bplustree_key_prefix(tree, key);
+    const bplustree_node_internal_t* node = bplustree_find_leaf(idx, key, prefix);
 
-                            tree->size--;
+    if(node == NULL) {
+        return false;
+    }
 
-                            list_destroy_with_data(path);
+    uint64_t pos = bplustree_node_lower_bound(idx, node, key, prefix);
 
-                            return 0;
-                        }
+    return pos < node->key_count && bplustree_node_compare(idx, node, pos, key, prefix) == 0;
+}
 
-                    } else {
-                        void* tmp = (void*)list_get_data_at_position(node->datas, *position);
+/**
+ * @brief creates one bulk load level above given nodes
+ * @param[in] idx b+ tree index
+ * @param[in] childs nodes of lower level
+ * @param[in] child_count lower level node count
+ * @param[out] parents created nodes
+ * @return created node count, 0 if failed
+ */
+static uint64_t bplustree_bulk_load_level(index_t* idx, bplustree_node_internal_t** childs, uint64_t child_count, bplustree_node_internal_t** parents) {
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+    uint64_t fanout = tree->max_key_count + 1;
+    uint64_t parent_count = (child_count + fanout - 1) / fanout;
+    uint64_t child_idx = 0;
+
+    for(uint64_t p = 0; p < parent_count; p++) {
+        // spread childs evenly so the last node also satisfies min key count
+        uint64_t take = child_count / parent_count + (p < child_count % parent_count ? 1 : 0);
+        bplustree_node_internal_t* parent = bplustree_node_create(idx, false);
+
+        if(parent == NULL) {
+            for(uint64_t i = 0; i < p; i++) {
+                bplustree_node_free(idx, parents[i]);
+            }
 
-                        if(deleted_data) {
-                            *deleted_data = tmp;
-                        }
+            return 0;
+        }
 
-                        delete_item_count = list_size(tmp);
+        parents[p] = parent;
+        parent->values[0] = childs[child_idx];
+        childs[child_idx]->parent = parent;
+        child_idx++;
 
-                        found = 0;
+        for(uint64_t i = 1; i < take; i++, child_idx++) {
+            const void* sep_key = NULL;
 
-                        break;
-                    }
+            if(bplustree_clone_key(idx, bplustree_node_min_key(childs[child_idx]), &sep_key) != 0) {
+                for(uint64_t j = 0; j <= p; j++) {
+                    bplustree_node_free(idx, parents[j]);
                 }
+
+                return 0;
             }
+
+            bplustree_node_insert_at(tree, parent, parent->key_count, sep_key, parent->key_count + 1, childs[child_idx]);
+            childs[child_idx]->parent = parent;
         }
     }
 
-    int8_t deleted = 0;
+    return parent_count;
+}
 
-    if(found) {
-        size_t* position_at_node;
-        size_t key_position;
-        size_t parent_key_position;
-        const void* tmp_key = NULL;
-        position_at_node = (size_t*)list_get_data_at_position(path, 0);
-        list_delete_at_position(node->datas, *position_at_node); // remove data
+int8_t bplustree_bulk_load(index_t* idx, const void* const* keys, const void* const* datas, uint64_t count) {
+    if(idx == NULL || idx->metadata == NULL || (count && (keys == NULL || datas == NULL))) {
+        return -1;
+    }
 
-        while (list_size(path) > 0) {
-            position_at_node = (size_t*)list_stack_pop(path);
+    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
 
-            if(node->childs != NULL) {
-                if(*position_at_node == 0) {
-                    key_position = 0;
-                } else {
-                    key_position = (*position_at_node) - 1;
-                }
-            } else {
-                key_position = *position_at_node;
-            }
+    if(tree->root != NULL) {
+        return -1;
+    }
 
-            tmp_key = list_get_data_at_position(node->keys, key_position);
+    if(count == 0) {
+        return 0;
+    }
 
-            if(tmp_key != NULL && idx->comparator(key, tmp_key) == 0) {
-                void * old_key = (void*)list_delete_at_position(node->keys, key_position);
+    uint64_t distinct_count = 1;
 
-                if(tree->key_destroyer) {
-                    tree->key_destroyer(idx->heap, old_key);
-                }
+    for(uint64_t i = 1; i < count; i++) {
+        int8_t c_res = idx->comparator(keys[i - 1], keys[i]);
 
-                if(node->childs != NULL) {
-                    tmp_key = bplustree_get_min_key(idx, list_get_data_at_position(node->childs, *position_at_node));
+        if(c_res > 0 || (c_res == 0 && tree->unique)) {
+            return -1;
+        }
 
-                    if(tmp_key != NULL) {
-                        list_insert_at_position(node->keys, tmp_key, key_position);
-                    }
-                }
-            }
+        if(c_res != 0) {
+            distinct_count++;
+        }
+    }
 
-            if(tmp_key == NULL && node->parent == NULL) {
-                bplustree_toss_root(idx);
-                memory_free_ext(idx->heap, position_at_node);
+    uint64_t leaf_count = (distinct_count + tree->max_key_count - 1) / tree->max_key_count;
+    bplustree_node_internal_t** nodes = memory_malloc_ext(idx->heap, sizeof(bplustree_node_internal_t*) * leaf_count * 2, 0x0);
 
-                break;
-            }
+    if(nodes == NULL) {
+        return -1;
+    }
 
-            if(node->parent != NULL && // not at parent
-               (list_size(node->keys) < min_keys // not satisfies key count
-                || (node->childs != NULL && list_size(node->childs) < (min_keys + 1)) // not satisfies children count
-               )) {
-
-                list_insert_delete_at_t delete_from = LIST_DELETE_AT_FINDBY, insert_at = LIST_INSERT_AT_ANYWHERE;
-                size_t* position_at_parent = (size_t*)list_get_data_at_position(path, 0);
-                bplustree_node_internal_t* left_node = NULL;
-                bplustree_node_internal_t* right_node = NULL;
-                int8_t left_ok = -1, right_ok = -1;
-                int8_t merge_with = 1;
-
-                if(*position_at_parent != 0) { // first check left node
-                    left_node = (bplustree_node_internal_t*)list_get_data_at_position(node->parent->childs, (*position_at_parent) - 1);
-
-                    if(list_size(left_node->keys) > min_keys) { // left node has enough
-                        delete_from = LIST_DELETE_AT_TAIL;
-                        insert_at = LIST_INSERT_AT_HEAD;
-                        left_ok = 0;
-                    } else {
-                        merge_with = -1;
-                    }
-
-                    parent_key_position = (*position_at_parent) - 1;
-                } else {
-                    parent_key_position = 0;
-                }
+    bplustree_node_internal_t** parents = nodes + leaf_count;
+    bplustree_node_internal_t* prev = NULL;
+    uint64_t item = 0;
+
+    for(uint64_t l = 0; l < leaf_count; l++) {
+        uint64_t take = distinct_count / leaf_count + (l < distinct_count % leaf_count ? 1 : 0);
+        bplustree_node_internal_t* leaf = bplustree_node_create(idx, true);
+
+        if(leaf == NULL) {
+            goto error;
+        }
+
+        nodes[l] = leaf;
+        leaf->previous = prev;
+
+        if(prev != NULL) {
+            prev->next = leaf;
+        }
 
+        prev = leaf;
 
-                if(left_ok != 0) { // left node failed. check right_node
-                    right_node = (bplustree_node_internal_t*)list_get_data_at_position(node->parent->childs, (*position_at_parent) + 1);
+        for(uint64_t k = 0; k < take; k++) {
+            const void* stored_key = NULL;
+            void* value = (void*)datas[item];
 
-                    if(right_node != NULL && list_size(right_node->keys) > min_keys) {
-                        delete_from = LIST_DELETE_AT_HEAD;
-                        insert_at = LIST_INSERT_AT_TAIL;
-                        right_ok = 0;
-                    }
+            if(!tree->unique) {
+                list_t* bucket = list_create_sortedlist_with_heap(idx->heap, tree->comparator_for_identify_unique_subpart);
+
+                if(bucket == NULL) {
+                    goto error;
                 }
 
-                if( left_ok != 0 && right_ok != 0) {
-                    // merge
-
-                    bplustree_node_internal_t* src;
-                    if(merge_with == -1 ) {
-                        src = left_node;
-                        delete_from = LIST_DELETE_AT_TAIL;
-                        insert_at = LIST_INSERT_AT_HEAD;
-                    } else {
-                        src = right_node;
-                        delete_from = LIST_DELETE_AT_HEAD;
-                        insert_at = LIST_INSERT_AT_TAIL;
-                    }
+                list_sortedlist_insert(bucket, datas[item]);
+
+                while(item + 1 < count && idx->comparator(keys[item], keys[item + 1]) == 0) {
+                    item++;
+                    list_sortedlist_insert(bucket, datas[item]);
+                }
 
-                    if(src == NULL) {
-                        break;
-                    }
+                value = bucket;
+            }
 
-                    const void* tmp_etc;
-
-                    if(node->childs == NULL) { // leaf merge
-                        while(list_size(src->keys) > 0) {
-                            tmp_etc = list_delete_at(src->keys, NULL, delete_from, 0);
-                            list_insert_at(node->keys, tmp_etc, insert_at, 0);
-                            tmp_etc = list_delete_at(src->datas, NULL, delete_from, 0);
-                            list_insert_at(node->datas, tmp_etc, insert_at, 0);
-                        }
-
-                        if(merge_with == -1) {
-                            void* old_key = (void*)list_delete_at_position(node->parent->keys, (*position_at_parent) - 1);
-
-                            if(tree->key_destroyer) {
-                                tree->key_destroyer(idx->heap, old_key);
-                            }
-
-                            list_delete_at_position(node->parent->childs, (*position_at_parent) - 1);
-
-                            if(src->previous != NULL) {
-                                src->previous->next = node;
-                            }
-
-                            node->previous = src->previous;
-                            position_at_parent = (size_t*)list_stack_pop(path);
-                            (*position_at_parent)--;
-                            list_stack_push(path, position_at_parent);
-                        } else {
-                            void* old_key = (void*)list_delete_at_position(node->parent->keys, *position_at_parent);
-
-                            if(tree->key_destroyer) {
-                                tree->key_destroyer(idx->heap, old_key);
-                            }
-
-                            list_delete_at_position(node->parent->childs, (*position_at_parent) + 1);
-                            node->next = src->next;
-
-                            if(src->next != NULL) {
-                                src->next->previous = node;
-                            }
-                        }
-                    } else { // internal merge
-
-                        if(merge_with == -1) {
-                            tmp_etc = list_get_data_at_position(node->keys, 0);
-                        } else {
-                            tmp_etc = list_get_data_at_position(node->keys, list_size(node->keys) - 1);
-                        }
-
-                        tmp_key = list_delete_at_position(node->parent->keys, parent_key_position);
-                        uint8_t allow_get_parent_key = 0;
-
-                        if(idx->comparator(key, tmp_key) == 0) { // not the key which is now deleting
-                            allow_get_parent_key = 1;
-                        }
-
-                        if(tmp_etc != NULL && idx->comparator(tmp_etc, tmp_key) == 0) {
-                            allow_get_parent_key = 1;
-                        }
-
-                        if(allow_get_parent_key == 0) {
-                            list_insert_at(node->keys, tmp_key, insert_at, 0);
-                        }
-
-
-                        size_t child_count = list_size(node->childs) + list_size(src->childs);
-                        size_t key_count = list_size(node->keys) + list_size(src->keys);
-
-                        if(child_count - key_count == 2) {
-                            const bplustree_node_internal_t* tmp_key_search_node;
-
-                            if(merge_with == -1) {
-                                tmp_key_search_node = list_get_data_at_position(node->childs, 0);
-                            } else {
-                                tmp_key_search_node = list_get_data_at_position(node->childs, 0);
-                            }
-
-                            tmp_key = bplustree_get_min_key(idx, tmp_key_search_node);
-                            list_insert_at(node->keys, tmp_key, insert_at, 0);
-                        }
-
-                        while(list_size(src->keys) > 0) {
-                            tmp_etc = list_delete_at(src->keys, NULL, delete_from, 0);
-                            list_insert_at(node->keys, tmp_etc, insert_at, 0);
-                        }
-
-                        while(list_size(src->childs) > 0) {
-                            tmp_etc = list_delete_at(src->childs, NULL, delete_from, 0);
-                            list_insert_at(node->childs, tmp_etc, insert_at, 0);
-                            ((bplustree_node_internal_t*)tmp_etc)->parent = node;
-                        }
-
-
-                        if(merge_with == -1) {
-                            list_delete_at_position(node->parent->childs, (*position_at_parent) - 1);
-
-                            if(src->previous != NULL) {
-                                src->previous->next = node;
-                            }
-
-                            node->previous = src->previous;
-                            position_at_parent = (size_t*)list_stack_pop(path);
-                            (*position_at_parent)--;
-                            list_stack_push(path, position_at_parent);
-                        } else {
-                            list_delete_at_position(node->parent->childs, (*position_at_parent) + 1);
-                            node->next = src->next;
-
-                            if(src->next != NULL) {
-                                src->next->previous = node;
-                            }
-                        }
-                    }
-
-                    list_destroy_with_type(src->keys, destroy_type, tree->key_destroyer);
-
-                    if(src->childs == NULL) {
-                        list_destroy(src->datas);
-                    } else {
-                        list_destroy(src->childs);
-                    }
-
-                    memory_free_ext(idx->heap, (void*)src);
-                } else {
-                    // borrow
-
-                    bplustree_node_internal_t* src;
-
-                    if(left_ok == 0) {
-                        src = left_node;
-                    } else {
-                        src = right_node;
-                    }
-
-                    const void* tmp_etc;
-
-                    if(node->childs == NULL) {
-                        tmp_etc = list_delete_at(src->keys, NULL, delete_from, 0);
-                        list_insert_at(node->keys, tmp_etc, insert_at, 0);
-                        tmp_etc = list_delete_at(src->datas, NULL, delete_from, 0);
-                        list_insert_at(node->datas, tmp_etc, insert_at, 0);
-                    } else {
-                        void* old_key = (void*)list_delete_at(src->keys, NULL, delete_from, 0);
-
-                        if(tree->key_destroyer) {
-                            tree->key_destroyer(idx->heap, old_key);
-                        }
-
-                        tmp_etc = list_delete_at(src->childs, NULL, delete_from, 0);
-                        list_insert_at(node->childs, tmp_etc, insert_at, 0);
-                        ((bplustree_node_internal_t*)tmp_etc)->parent = node;
-                        const bplustree_node_internal_t* tmp_key_child;
-
-                        if(left_ok == 0) {
-                            tmp_key_child = list_get_data_at_position(node->childs, 1);
-                            tmp_key =  bplustree_get_min_key(idx, tmp_key_child);
-                            list_insert_at(node->keys, tmp_key, LIST_INSERT_AT_HEAD, 0);
-                        } else {
-                            tmp_key_child = tmp_etc;
-                            tmp_key =  bplustree_get_min_key(idx, tmp_key_child);
-                            list_insert_at(node->keys, tmp_key, LIST_INSERT_AT_TAIL, 0);
-                        }
-                    }
-
-                    if(left_ok == 0) {
-                        tmp_key = bplustree_get_min_key(idx, node);
-                        void* old_key = (void*)list_delete_at_position(node->parent->keys, parent_key_position);
-
-                        if(tree->key_destroyer) {
-                            tree->key_destroyer(idx->heap, old_key);
-                        }
-
-                        list_insert_at_position(node->parent->keys, tmp_key, parent_key_position);
-                    } else {
-                        tmp_key = bplustree_get_min_key(idx, right_node);
-                        size_t tmp_pos = (*position_at_parent) == 0 ? 0 : parent_key_position + 1;
-                        void* old_key = (void*)list_delete_at_position(node->parent->keys, tmp_pos);
-
-                        if(tree->key_destroyer) {
-                            tree->key_destroyer(idx->heap, old_key);
-                        }
-
-                        list_insert_at_position(node->parent->keys, tmp_key, tmp_pos);
-                    }
+            if(bplustree_clone_key(idx, keys[item], &stored_key) != 0) {
+                if(!tree->unique) {
+                    list_destroy(value);
                 }
+
+                goto error;
             }
 
-            memory_free_ext(idx->heap, position_at_node); // we done with key, so free it
-            node = node->parent; // go parent
-        }
+            leaf->keys[leaf->key_count] = stored_key;
 
-        bplustree_toss_root(idx);
+            if(leaf->prefixes) {
+                leaf->prefixes[leaf->key_count] = bplustree_key_prefix(tree, stored_key);
+            }
 
-        if(list_size(tree->root->keys) == 0) {
-            list_destroy_with_type(tree->root->keys, destroy_type, tree->key_destroyer);
-            list_destroy(tree->root->datas);
-            memory_free_ext(idx->heap, (void*)tree->root);
-            tree->root = NULL;
+            leaf->values[leaf->key_count] = value;
+            leaf->key_count++;
+            item++;
         }
-    } else {
-        deleted = -1;
-    }
-
-    if(deleted == 0) {
-        tree->size -= delete_item_count;
     }
 
-    list_destroy_with_data(path);
-    return deleted;
-}
-#pragma GCC diagnostic pop
+    uint64_t node_count = leaf_count;
 
-const void* bplustree_find(index_t* idx, const void* key) {
-    if(idx == NULL) {
-        return NULL;
-    }
+    while(node_count > 1) {
+        uint64_t parent_count = bplustree_bulk_load_level(idx, nodes, node_count, parents);
 
-    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
+        if(parent_count == 0) {
+            for(uint64_t i = 0; i < node_count; i++) {
+                bplustree_node_free_subtree(idx, nodes[i]);
+            }
 
-    if(tree == NULL) {
-        return NULL;
-    }
+            memory_free_ext(idx->heap, nodes);
 
-    const bplustree_node_internal_t* node = tree->root;
+            return -1;
+        }
 
-    if(node == NULL) {
-        return NULL;
+        memory_memcopy(parents, nodes, sizeof(bplustree_node_internal_t*) * parent_count);
+        node_count = parent_count;
     }
 
-    while(node != NULL) {
-        if(node->childs != NULL) { // internal node
-            const void* cur = NULL;
-            uint64_t position = 0;
+    tree->root = nodes[0];
+    tree->size = count;
+    memory_free_ext(idx->heap, nodes);
 
-            size_t key_count = list_size(node->keys);
+    return 0;
 
-            for(size_t i = 0; i < key_count; i++) {
-                cur = list_get_data_at_position(node->keys, i);
+error:
+    for(uint64_t l = 0; l < leaf_count && nodes[l] != NULL; l++) {
+        bplustree_node_free(idx, nodes[l]);
+    }
 
-                if(idx->comparator(cur, key) <= 0) {
-                    position++;
-                } else {
-                    break;
-                }
+    memory_free_ext(idx->heap, nodes);
 
-            }
+    return -1;
+}
 
-            node = (bplustree_node_internal_t*)list_get_data_at_position(node->childs, position);
-        } else { // leaf node
-            uint64_t position = 0;
+/**
+ * @brief checks iterator current key against search criteria upper bound, ends iteration if exceeded
+ * @param[in] iter iterator
+ */
+static void bplustree_iterator_check_criteria(bplustree_iterator_internal_t* iter) {
+    if(iter->current_node == NULL) {
+        iter->end_of_iter = 0;
 
-            if(list_get_position(node->keys, key, &position) != 0) {
-                return NULL;
-            }
+        return;
+    }
 
-            return list_get_data_at_position(node->datas, position);
-        }
+    const void* key_at_pos = iter->current_node->keys[iter->current_index];
+    boolean_t end = false;
+
+    switch(iter->criteria) {
+    case INDEXER_KEY_COMPARATOR_CRITERIA_LESS:
+        end = iter->comparator(key_at_pos, iter->key1) >= 0;
+        break;
+    case INDEXER_KEY_COMPARATOR_CRITERIA_LESSOREQUAL:
+    case INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL:
+        end = iter->comparator(key_at_pos, iter->key1) > 0;
+        break;
+    case INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN:
+        end = iter->comparator(key_at_pos, iter->key2) > 0;
+        break;
+    default:
+        break;
     }
 
-    return NULL;
+    if(end) {
+        iter->current_node = NULL;
+        iter->end_of_iter = 0;
+    }
 }
 
 iterator_t* bplustree_search(index_t* idx, const void* key1, const void* key2, const index_key_search_criteria_t criteria){
@@ -1246,113 +1229,42 @@ iterator_t* bplustree_search(index_t* idx, const void* key1, const void* key2, c
     iter->key1 = key1;
     iter->key2 = key2;
     iter->comparator = idx->comparator;
+    iter->data_as_bucket = !tree->unique;
 
-    const bplustree_node_internal_t* node = tree->root;
-
-    if(node != NULL) {
-        while(1 == 1) {
-            if(node->childs == NULL) {
-                iter->current_node = node;
-                iter->current_index = 0;
-
-                if(criteria >= INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL) {
-                    size_t key_count = list_size(iter->current_node->keys);
-
-                    iterator_t* k_iter = list_iterator_create(iter->current_node->keys);
-
-                    while(k_iter->end_of_iterator(k_iter) != 0) {
-                        const void* key_at_pos = k_iter->get_item(k_iter);
-
-                        int8_t c_res = iter->comparator(key1, key_at_pos);
-
-                        if(criteria == INDEXER_KEY_COMPARATOR_CRITERIA_GREATER) {
-                            if(c_res < 0) {
-                                iter->end_of_iter = 1;
-                                break;
-                            }
-
-                        } else {
-                            if(c_res == 0) {
-                                iter->end_of_iter = 1;
-                                break;
-                            } else if(c_res < 0)  {
-                                iter->current_node = NULL;
-                                iter->current_index = 0;
-                                iter->end_of_iter = 0;
-                                break;
-                            }
-                        }
-
-                        iter->current_index++;
-
-                        if(iter->current_index == key_count) {
-                            iter->current_index = 0;
-                            iter->current_node =  iter->current_node->next;
-
-                            if(iter->current_node == NULL) {
-                                iter->current_index = 0;
-                                iter->end_of_iter = 0;
-                                break;
-                            }
-
-                            k_iter->destroy(k_iter);
-                            k_iter = list_iterator_create(iter->current_node->keys);
-
-                            key_count = list_size(iter->current_node->keys);
-                        } else {
-                            k_iter = k_iter->next(k_iter);
-                        }
-                    }
-
-                    k_iter->destroy(k_iter);
-
-                } else {
-                    iter->end_of_iter = 1;
-                }
-
-                break;
-            } else { // internal node
-
-                if(criteria < INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL) {
-                    node = list_get_data_at_position(node->childs, 0);
-                } else {
-                    size_t key_count = list_size(node->keys);
-
-                    iterator_t* k_iter = list_iterator_create(node->keys);
-                    size_t i = 0;
-
-                    while(k_iter->end_of_iterator(k_iter) != 0) { // search at leaf keys
-                        const void* key_at_pos = k_iter->get_item(k_iter);
-
-                        int8_t c_res = iter->comparator(key1, key_at_pos);
+    if(tree->root != NULL) {
+        const bplustree_node_internal_t* node = tree->root;
+        uint64_t pos = 0;
 
-                        if(c_res < 0 || (!tree->unique && c_res == 0)) {
-                            node = list_get_data_at_position(node->childs, i);
-                            break; // break search at internal node
-                        }
+        if(criteria < INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL) {
+            while(!node->is_leaf) {
+                node = node->values[0];
+            }
+        } else {
+            uint64_t prefix = bplustree_key_prefix(tree, key1);
 
-                        if(i + 1 != key_count) {
-                            key_at_pos = list_get_data_at_position(node->keys, i + 1);
+            node = bplustree_find_leaf(idx, key1, prefix);
 
-                            c_res = iter->comparator(key1, key_at_pos);
+            if(criteria == INDEXER_KEY_COMPARATOR_CRITERIA_GREATER) {
+                pos = bplustree_node_upper_bound(idx, node, key1, prefix);
+            } else {
+                pos = bplustree_node_lower_bound(idx, node, key1, prefix);
+            }
 
-                            if(c_res < 0 || (!tree->unique && c_res == 0)) {
-                                node = list_get_data_at_position(node->childs, i);
-                                break; // break search at internal node
-                            }
-                        } else {
-                            node = list_get_data_at_position(node->childs, i + 1);
-                        }
+            if(pos == node->key_count) { // all keys at leaf are less, start of next leaf is the first match
+                node = node->next;
+                pos = 0;
+            }
+        }
 
-                        i++;
-                        k_iter = k_iter->next(k_iter);
-                    }
+        iter->current_node = node;
+        iter->current_index = pos;
+        iter->end_of_iter = 1;
 
-                    k_iter->destroy(k_iter);
-                }
-            } // end of internal node
+        if(criteria == INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL && node != NULL && iter->comparator(node->keys[pos], key1) != 0) {
+            iter->current_node = NULL;
         }
 
+        bplustree_iterator_check_criteria(iter);
     } else {
         iter->end_of_iter = 0;
     }
@@ -1396,11 +1308,14 @@ int8_t bplustree_iterator_end_of_index(iterator_t* iterator) {
 iterator_t* bplustree_iterator_next(iterator_t* iterator){
     bplustree_iterator_internal_t* iter = (bplustree_iterator_internal_t*)iterator->metadata;
 
+    if(iter->end_of_iter == 0) {
+        return iterator;
+    }
 
-    if(iter->current_node->data_as_bucket) {
+    if(iter->data_as_bucket) {
         iter->current_bucket_index++;
 
-        list_t* bucket = (list_t*)list_get_data_at_position(iter->current_node->datas, iter->current_index);
+        list_t* bucket = (list_t*)iter->current_node->values[iter->current_index];
 
         if(list_size(bucket) > iter->current_bucket_index) {
             return iterator;
@@ -1411,30 +1326,15 @@ iterator_t* bplustree_iterator_next(iterator_t* iterator){
 
     iter->current_index++;
 
-    if(list_size(iter->current_node->keys) == iter->current_index) {
-        if(iter->current_node->next != NULL) {
-            iter->current_node = iter->current_node->next;
-            iter->current_index = 0;
-            iter->current_bucket_index = 0;
-        } else {
-            iter->current_node = NULL;
-            iter->end_of_iter = 0;
-        }
+    if(iter->current_node->key_count == iter->current_index) {
+        iter->current_node = iter->current_node->next;
+        iter->current_index = 0;
     }
 
-    if(iter->current_node != NULL && iter->criteria != INDEXER_KEY_COMPARATOR_CRITERIA_NULL) {
-        const void* key_at_pos = list_get_data_at_position(iter->current_node->keys, iter->current_index);
-
-        if(iter->criteria == INDEXER_KEY_COMPARATOR_CRITERIA_LESS && iter->comparator(key_at_pos, iter->key1) >= 0) {
-            iter->current_node = NULL;
-            iter->end_of_iter = 0;
-        } else if((iter->criteria == INDEXER_KEY_COMPARATOR_CRITERIA_LESSOREQUAL || iter->criteria == INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL) && iter->comparator(key_at_pos, iter->key1) > 0) {
-            iter->current_node = NULL;
-            iter->end_of_iter = 0;
-        } else if(iter->criteria == INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN && iter->comparator(key_at_pos, iter->key2) > 0) {
-            iter->current_node = NULL;
-            iter->end_of_iter = 0;
-        }
+    if(iter->criteria != INDEXER_KEY_COMPARATOR_CRITERIA_NULL) {
+        bplustree_iterator_check_criteria(iter);
+    } else if(iter->current_node == NULL) {
+        iter->end_of_iter = 0;
     }
 
     return iterator;
@@ -1447,7 +1347,7 @@ const void* bplustree_iterator_get_key(iterator_t* iterator) {
         return NULL;
     }
 
-    return list_get_data_at_position(iter->current_node->keys, iter->current_index);
+    return iter->current_node->keys[iter->current_index];
 }
 
 const void* bplustree_iterator_get_data(iterator_t* iterator) {
@@ -1457,13 +1357,13 @@ const void* bplustree_iterator_get_data(iterator_t* iterator) {
         return NULL;
     }
 
-    if(iter->current_node->data_as_bucket) {
-        list_t* bucket = (list_t*)list_get_data_at_position(iter->current_node->datas, iter->current_index);
+    if(iter->data_as_bucket) {
+        list_t* bucket = (list_t*)iter->current_node->values[iter->current_index];
 
         return list_get_data_at_position(bucket, iter->current_bucket_index);
     }
 
-    return list_get_data_at_position(iter->current_node->datas, iter->current_index);
+    return iter->current_node->values[iter->current_index];
 }
 
 uint64_t bplustree_size(index_t* idx) {
@@ -1475,47 +1375,3 @@ uint64_t bplustree_size(index_t* idx) {
 
     return tree->size;
 }
-
-boolean_t bplustree_contains(index_t* idx, const void* key){
-    if(idx == NULL) {
-        return false;
-    }
-
-    bplustree_internal_t* tree = (bplustree_internal_t*)idx->metadata;
-
-    if(tree->root == NULL) {
-        return false;
-    }
-
-    bplustree_node_internal_t* node = tree->root;
-
-    while(node != NULL) {
-        if(node->childs != NULL) { // internal node
-            const void* cur = NULL;
-            uint64_t position = 0;
-
-            size_t key_count = list_size(node->keys);
-
-            for(size_t i = 0; i < key_count; i++) {
-                cur = list_get_data_at_position(node->keys, i);
-
-                if(idx->comparator(cur, key) <= 0) {
-                    position++;
-                } else {
-                    break;
-                }
-
-            }
-
-            node = (bplustree_node_internal_t*)list_get_data_at_position(node->childs, position);
-        } else { // leaf node
-            if(list_contains(node->keys, key) != 0) {
-                return false;
-            }
-
-            return true;
-        }
-    }
-
-    return false;
-}
@@ -0,0 +1,162 @@
+/**
+ * @file byte_search.64.c
+ * @brief vectorized byte and substring search implementation.
+ *
+ * substring search compares a vector of candidate starts with the first pattern byte and the
+ * vector at pattern length - 1 further with the last pattern byte. only positions where both match
+ * are verified byte by byte, so ordinary text rarely leaves the vector loop.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <byte_search.h>
+
+MODULE("turnstone.lib");
+
+/*
+ * We build with -nostdinc so intrinsic headers are not available, vector extensions and
+ * the pmovmskb builtins behind _mm_movemask_epi8/_mm256_movemask_epi8 are used instead.
+ * Without any vector unit the scalar loops are used.
+ */
+#if defined(__AVX2__)
+/*! scan vector width in bytes */
+#define BYTE_SEARCH_VECTOR_SIZE 32
+/*! one bit per byte lane (vpmovmskb) */
+#define BYTE_SEARCH_MOVEMASK(v) ((uint32_t)__builtin_ia32_pmovmskb256((byte_search_char_vector_t)(v)))
+#elif defined(__SSE2__)
+/*! scan vector width in bytes */
+#define BYTE_SEARCH_VECTOR_SIZE 16
+/*! one bit per byte lane (pmovmskb) */
+#define BYTE_SEARCH_MOVEMASK(v) ((uint32_t)__builtin_ia32_pmovmskb128((byte_search_char_vector_t)(v)))
+#endif
+
+#ifdef BYTE_SEARCH_VECTOR_SIZE
+/*! byte vector */
+typedef uint8_t byte_search_vector_t __attribute__((vector_size(BYTE_SEARCH_VECTOR_SIZE)));
+/*! unaligned byte vector for loads */
+typedef uint8_t byte_search_unaligned_vector_t __attribute__((vector_size(BYTE_SEARCH_VECTOR_SIZE), aligned(1)));
+/*! char vector expected by movemask builtins */
+typedef char byte_search_char_vector_t __attribute__((vector_size(BYTE_SEARCH_VECTOR_SIZE)));
+#endif
+
+int64_t byte_search_first(const uint8_t* data, const int64_t data_len, uint8_t value) {
+    if(data == NULL) {
+        return -1;
+    }
+
+    int64_t i = 0;
+
+#ifdef BYTE_SEARCH_VECTOR_SIZE
+    byte_search_vector_t needle = (byte_search_vector_t){0} + value;
+
+    while(i + BYTE_SEARCH_VECTOR_SIZE <= data_len) {
+        uint32_t m = BYTE_SEARCH_MOVEMASK(*(const byte_search_unaligned_vector_t*)(data + i) == needle);
+
+        if(m) {
+            return i + __builtin_ctz(m);
+        }
+
+        i += BYTE_SEARCH_VECTOR_SIZE;
+    }
+#endif
+
+    for(; i < data_len; i++) {
+        if(data[i] == value) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int64_t byte_search_last(const uint8_t* data, const int64_t data_len, uint8_t value) {
+    if(data == NULL) {
+        return -1;
+    }
+
+    int64_t i = data_len;
+
+#ifdef BYTE_SEARCH_VECTOR_SIZE
+    byte_search_vector_t needle = (byte_search_vector_t){0} + value;
+
+    while(i >= BYTE_SEARCH_VECTOR_SIZE) {
+        i -= BYTE_SEARCH_VECTOR_SIZE;
+
+        uint32_t m = BYTE_SEARCH_MOVEMASK(*(const byte_search_unaligned_vector_t*)(data + i) == needle);
+
+        if(m) {
+            return i + 31 - __builtin_clz(m);
+        }
+    }
+#endif
+
+    while(i > 0) {
+        i--;
+
+        if(data[i] == value) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static inline boolean_t byte_search_equals(const uint8_t* a, const uint8_t* b, int64_t len) {
+    for(int64_t i = 0; i < len; i++) {
+        if(a[i] != b[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int64_t byte_search(const uint8_t* data, const int64_t data_len, const uint8_t* pattern, const int64_t pattern_len) {
+    if(data == NULL || pattern == NULL || pattern_len > data_len) {
+        return -1;
+    }
+
+    if(pattern_len == 0) {
+        return 0;
+    }
+
+    if(pattern_len == 1) {
+        return byte_search_first(data, data_len, pattern[0]);
+    }
+
+    int64_t last = pattern_len - 1;
+    int64_t i = 0;
+
+#ifdef BYTE_SEARCH_VECTOR_SIZE
+    byte_search_vector_t first_byte = (byte_search_vector_t){0} + pattern[0];
+    byte_search_vector_t last_byte = (byte_search_vector_t){0} + pattern[last];
+
+    while(i + last + BYTE_SEARCH_VECTOR_SIZE <= data_len) {
+        byte_search_vector_t block_first = *(const byte_search_unaligned_vector_t*)(data + i);
+        byte_search_vector_t block_last = *(const byte_search_unaligned_vector_t*)(data + i + last);
+
+        uint32_t m = BYTE_SEARCH_MOVEMASK((block_first == first_byte) & (block_last == last_byte));
+
+        while(m) {
+            int64_t pos = i + __builtin_ctz(m);
+
+            if(byte_search_equals(data + pos + 1, pattern + 1, last - 1)) {
+                return pos;
+            }
+
+            m &= m - 1;
+        }
+
+        i += BYTE_SEARCH_VECTOR_SIZE;
+    }
+#endif
+
+    for(; i + last < data_len; i++) {
+        if(data[i] == pattern[0] && data[i + last] == pattern[last] && byte_search_equals(data + i + 1, pattern + 1, last - 1)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
@@ -17,166 +17,236 @@ MODULE("turnstone.lib");
 int8_t  data_bson_serialize_with_buffer(buffer_t* buf, data_t* data, uint64_t* sub_len);
 data_t* data_bson_deserialize_with_processed(data_t* data, uint64_t* processed);
 
-data_t* data_bson_serialize(data_t* data) {
-    buffer_t* buf = buffer_new();
+/*
+ * Every node is laid out as: total node size (uint64), type (uint8), name node (a full node, or a zero
+ * uint64 when there is no name), element count (uint64, only for strings, data lists and arrays) and
+ * the value bytes. Scalars store only their own width. Multi byte fields are little endian and unaligned.
+ */
 
-    if(buf == NULL) {
-        return NULL;
-    }
+/*! unaligned 16-bit field */
+typedef uint16_t data_bson_unaligned_uint16_t __attribute__((aligned(1)));
+/*! unaligned 32-bit field */
+typedef uint32_t data_bson_unaligned_uint32_t __attribute__((aligned(1)));
+/*! unaligned 64-bit field */
+typedef uint64_t data_bson_unaligned_uint64_t __attribute__((aligned(1)));
 
-    uint64_t len = 0;
+/**
+ * @brief returns byte width of a scalar or of one element of a string or an array
+ * @param[in] type data type
+ * @return width, 0 for null and data lists, -1 for unknown types
+ */
+static int8_t data_bson_type_unit(data_type_t type) {
+    switch(type) {
+    case DATA_TYPE_NULL:
+    case DATA_TYPE_DATA:
+        return 0;
+    case DATA_TYPE_BOOLEAN:
+    case DATA_TYPE_CHAR:
+    case DATA_TYPE_INT8:
+    case DATA_TYPE_STRING:
+    case DATA_TYPE_INT8_ARRAY:
+        return sizeof(uint8_t);
+    case DATA_TYPE_INT16:
+    case DATA_TYPE_INT16_ARRAY:
+        return sizeof(uint16_t);
+    case DATA_TYPE_INT32:
+    case DATA_TYPE_INT32_ARRAY:
+        return sizeof(uint32_t);
+    case DATA_TYPE_FLOAT32:
+    case DATA_TYPE_FLOAT32_ARRAY:
+        return sizeof(float32_t);
+    case DATA_TYPE_INT64:
+    case DATA_TYPE_INT64_ARRAY:
+        return sizeof(uint64_t);
+    case DATA_TYPE_FLOAT64:
+    case DATA_TYPE_FLOAT64_ARRAY:
+        return sizeof(float64_t);
+    default:
+        return -1;
+    }
+}
 
-    if(data_bson_serialize_with_buffer(buf, data, &len) == -1) {
-        buffer_destroy(buf);
-        return NULL;
+/**
+ * @brief first pass of serializer: computes exact serialized size and validates types
+ * @param[in] data data to serialize, NULL is an empty node
+ * @return size, -1ULL if data contains an unknown type
+ */
+static uint64_t data_bson_size(const data_t* data) {
+    if(data == NULL) {
+        return sizeof(uint64_t);
     }
 
-    uint64_t obuflen = 0;
-    uint8_t* obuf = buffer_get_all_bytes_and_destroy(buf, &obuflen);
+    int8_t unit = data_bson_type_unit(data->type);
 
-    if(!obuflen || !obuf) {
-        return NULL;
+    if(unit == -1) {
+        return -1ULL;
     }
 
-    if(len != obuflen) {
-        return NULL;
+    uint64_t size = data_bson_size(data->name);
+
+    if(size == -1ULL) {
+        return -1ULL;
     }
 
-    data_t* res = memory_malloc(sizeof(data_t));
+    size += sizeof(uint64_t) + sizeof(uint8_t);
 
-    if(!res) {
-        memory_free(obuf);
+    if(data->type < DATA_TYPE_STRING) {
+        return size + unit;
+    }
 
-        return NULL;
+    size += sizeof(uint64_t);
+
+    if(data->type == DATA_TYPE_STRING) {
+        return size + (data->value ? strlen(data->value) : 0);
     }
 
-    res->type = DATA_TYPE_INT8_ARRAY;
-    res->length = obuflen;
-    res->value = obuf;
+    if(data->type == DATA_TYPE_DATA) {
+        const data_t* datas = data->value;
 
-    return res;
-}
+        for(uint64_t i = 0; i < data->length; i++) {
+            uint64_t item_size = data_bson_size(datas + i);
 
-int8_t data_bson_serialize_with_buffer(buffer_t* buf, data_t* data, uint64_t* sub_len) {
-    uint64_t len = 0;
+            if(item_size == -1ULL) {
+                return -1ULL;
+            }
+
+            size += item_size;
+        }
 
-    uint64_t len_pos = buffer_get_position(buf);
+        return size;
+    }
 
-    buffer_append_bytes(buf, (uint8_t*)&len, sizeof(uint64_t));
-    len += sizeof(uint64_t);
+    return size + data->length * unit;
+}
+
+/**
+ * @brief second pass of serializer: writes node into memory sized by @ref data_bson_size
+ * @param[in] data data to serialize, types are already validated
+ * @param[out] out destination
+ * @return written byte count
+ */
+static uint64_t data_bson_write(const data_t* data, uint8_t* out) {
+    uint64_t pos = sizeof(uint64_t);
 
     if(data == NULL) {
-        *sub_len = len; // len
-        return 0;
+        *(data_bson_unaligned_uint64_t*)out = 0;
+
+        return pos;
     }
 
+    out[pos++] = data->type;
+    pos += data_bson_write(data->name, out + pos);
 
-    buffer_append_bytes(buf, (uint8_t*)&data->type, sizeof(uint8_t));
-    len += sizeof(uint8_t);
+    int8_t unit = data_bson_type_unit(data->type);
+    uint64_t value = (uint64_t)data->value;
 
-    uint64_t name_len = 0;
+    if(data->type < DATA_TYPE_STRING) {
+        switch(unit) {
+        case 1:
+            out[pos] = value;
+            break;
+        case 2:
+            *(data_bson_unaligned_uint16_t*)(out + pos) = value;
+            break;
+        case 4:
+            *(data_bson_unaligned_uint32_t*)(out + pos) = value;
+            break;
+        case 8:
+            *(data_bson_unaligned_uint64_t*)(out + pos) = value;
+            break;
+        default:
+            break;
+        }
 
-    if(data_bson_serialize_with_buffer(buf, data->name, &name_len) == -1) {
-        return -1;
-    }
+        pos += unit;
+    } else if(data->type == DATA_TYPE_DATA) {
+        const data_t* datas = data->value;
 
-    len += name_len;
+        *(data_bson_unaligned_uint64_t*)(out + pos) = data->length;
+        pos += sizeof(uint64_t);
 
-    if(data->type >= DATA_TYPE_STRING) {
-        uint64_t type_len = data->length;
+        for(uint64_t i = 0; i < data->length; i++) {
+            pos += data_bson_write(datas + i, out + pos);
+        }
+    } else {
+        uint64_t count = data->length;
 
         if(data->type == DATA_TYPE_STRING) {
-            type_len = strlen((char_t*)data->value);
+            count = data->value ? strlen(data->value) : 0;
         }
 
-        buffer_append_bytes(buf, (uint8_t*)&type_len, sizeof(uint64_t));
-        len += sizeof(uint64_t);
+        *(data_bson_unaligned_uint64_t*)(out + pos) = count;
+        pos += sizeof(uint64_t);
+
+        if(count) {
+            memory_memcopy(data->value, out + pos, count * unit);
+            pos += count * unit;
+        }
     }
 
-    switch (data->type) {
-    case DATA_TYPE_NULL:
-        break;
-    case DATA_TYPE_BOOLEAN:
-    case DATA_TYPE_CHAR:
-    case DATA_TYPE_INT8:
-        buffer_append_bytes(buf, (uint8_t*)&data->value, sizeof(uint8_t));
-        len += sizeof(uint8_t);
-        break;
-    case DATA_TYPE_INT16:
-        buffer_append_bytes(buf, (uint8_t*)&data->value, sizeof(uint16_t));
-        len += sizeof(uint16_t);
-        break;
-    case DATA_TYPE_INT32:
-        buffer_append_bytes(buf, (uint8_t*)&data->value, sizeof(uint32_t));
-        len += sizeof(uint32_t);
-        break;
-    case DATA_TYPE_INT64:
-        buffer_append_bytes(buf, (uint8_t*)&data->value, sizeof(uint64_t));
-        len += sizeof(uint64_t);
-        break;
-    case DATA_TYPE_FLOAT32:
-        buffer_append_bytes(buf, (uint8_t*)&data->value, sizeof(float32_t));
-        len += sizeof(float32_t);
-        break;
-    case DATA_TYPE_FLOAT64:
-        buffer_append_bytes(buf, (uint8_t*)&data->value, sizeof(float64_t));
-        len += sizeof(float64_t);
-        break;
-    case DATA_TYPE_STRING:
-        buffer_append_bytes(buf, (uint8_t*)data->value, strlen((char_t*)data->value));
-        len += strlen((char_t*)data->value);
-        break;
-    case DATA_TYPE_DATA: {
-        data_t* datas = (data_t*)data->value;
+    *(data_bson_unaligned_uint64_t*)out = pos;
 
-        for(uint64_t i = 0; i < data->length; i++) {
-            uint64_t item_len = 0;
+    return pos;
+}
 
-            if(data_bson_serialize_with_buffer(buf, &datas[i], &item_len) == -1) {
-                return -1;
-            }
+data_t* data_bson_serialize(data_t* data) {
+    uint64_t size = data_bson_size(data);
 
-            len += item_len;
-        }
+    if(size == -1ULL) {
+        return NULL;
     }
-    break;
-    case DATA_TYPE_INT8_ARRAY:
-        buffer_append_bytes(buf, (uint8_t*)data->value, data->length * sizeof(uint8_t));
-        len += data->length * sizeof(uint8_t);
-        break;
-    case DATA_TYPE_INT16_ARRAY:
-        buffer_append_bytes(buf, (uint8_t*)data->value, data->length * sizeof(uint16_t));
-        len += data->length * sizeof(uint16_t);
-        break;
-    case DATA_TYPE_INT32_ARRAY:
-        buffer_append_bytes(buf, (uint8_t*)data->value, data->length * sizeof(uint32_t));
-        len += data->length * sizeof(uint32_t);
-        break;
-    case DATA_TYPE_INT64_ARRAY:
-        buffer_append_bytes(buf, (uint8_t*)data->value, data->length * sizeof(uint64_t));
-        len += data->length * sizeof(uint64_t);
-        break;
-    case DATA_TYPE_FLOAT32_ARRAY:
-        buffer_append_bytes(buf, (uint8_t*)data->value, data->length * sizeof(float32_t));
-        len += data->length * sizeof(float32_t);
-        break;
-    case DATA_TYPE_FLOAT64_ARRAY:
-        buffer_append_bytes(buf, (uint8_t*)data->value, data->length * sizeof(float64_t));
-        len += data->length * sizeof(float64_t);
-        break;
-    default:
+
+    uint8_t* obuf = memory_malloc(size);
+
+    if(!obuf) {
+        return NULL;
+    }
+
+    if(data_bson_write(data, obuf) != size) {
+        memory_free(obuf);
+
+        return NULL;
+    }
+
+    data_t* res = memory_malloc(sizeof(data_t));
+
+    if(!res) {
+        memory_free(obuf);
+
+        return NULL;
+    }
+
+    res->type = DATA_TYPE_INT8_ARRAY;
+    res->length = size;
+    res->value = obuf;
+
+    return res;
+}
+
+int8_t data_bson_serialize_with_buffer(buffer_t* buf, data_t* data, uint64_t* sub_len) {
+    uint64_t size = data_bson_size(data);
+
+    if(size == -1ULL) {
         return -1;
     }
 
-    uint64_t pos = buffer_get_position(buf);
+    uint8_t* obuf = memory_malloc(size);
 
-    buffer_seek(buf, len_pos, BUFFER_SEEK_DIRECTION_START);
-    buffer_append_bytes(buf, (uint8_t*)&len, sizeof(uint64_t));
-    buffer_seek(buf, pos, BUFFER_SEEK_DIRECTION_START);
+    if(!obuf) {
+        return -1;
+    }
 
-    *sub_len = len;
+    data_bson_write(data, obuf);
 
-    return 0;
+    int8_t res = buffer_append_bytes(buf, obuf, size) ? 0 : -1;
+
+    memory_free(obuf);
+
+    if(sub_len) {
+        *sub_len = size;
+    }
+
+    return res;
 }
 
 data_t* data_bson_deserialize(data_t* data) {
@@ -432,33 +502,328 @@ catch_error:
     return NULL;
 }
 
-void data_free(data_t* data) {
+/**
+ * @brief parses node header into view
+ * @param[in] node node start
+ * @param[in] avail bytes available from node start
+ * @param[out] view view
+ * @return 0 on success, -1 if node is malformed or empty
+ */
+static int8_t data_bson_view_parse(const uint8_t* node, uint64_t avail, data_bson_view_t* view) {
+    if(avail < sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint64_t)) {
+        return -1;
+    }
+
+    uint64_t size = *(const data_bson_unaligned_uint64_t*)node;
+
+    if(size < sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint64_t) || size > avail) {
+        return -1;
+    }
+
+    data_type_t type = node[sizeof(uint64_t)];
+    int8_t unit = data_bson_type_unit(type);
+
+    if(unit == -1) {
+        return -1;
+    }
+
+    uint64_t pos = sizeof(uint64_t) + sizeof(uint8_t);
+    uint64_t name_size = *(const data_bson_unaligned_uint64_t*)(node + pos);
+
+    view->name = NULL;
+
+    if(name_size) {
+        if(name_size > size - pos) {
+            return -1;
+        }
+
+        view->name = node + pos;
+        pos += name_size;
+    } else {
+        pos += sizeof(uint64_t);
+    }
+
+    uint64_t length = unit;
+
+    if(type >= DATA_TYPE_STRING) {
+        if(size - pos < sizeof(uint64_t)) {
+            return -1;
+        }
+
+        length = *(const data_bson_unaligned_uint64_t*)(node + pos);
+        pos += sizeof(uint64_t);
+
+        if(unit && length > (size - pos) / unit) {
+            return -1;
+        }
+    } else if(size - pos < (uint64_t)unit) {
+        return -1;
+    }
+
+    view->node = node;
+    view->node_size = size;
+    view->type = type;
+    view->length = length;
+    view->value = node + pos;
+    view->value_size = size - pos;
+
+    return 0;
+}
+
+int8_t data_bson_view_init(data_bson_view_t* view, const data_t* bson) {
+    if(!view || !bson || bson->type != DATA_TYPE_INT8_ARRAY || !bson->value) {
+        return -1;
+    }
+
+    return data_bson_view_parse(bson->value, bson->length, view);
+}
+
+int8_t data_bson_view_get_name(const data_bson_view_t* view, data_bson_view_t* name) {
+    if(!view || !name || !view->name) {
+        return -1;
+    }
+
+    return data_bson_view_parse(view->name, view->value - view->name, name);
+}
+
+int8_t data_bson_view_first_child(const data_bson_view_t* parent, data_bson_view_t* child) {
+    if(!parent || !child || parent->type != DATA_TYPE_DATA || !parent->length) {
+        return -1;
+    }
+
+    return data_bson_view_parse(parent->value, parent->value_size, child);
+}
+
+int8_t data_bson_view_next_child(const data_bson_view_t* parent, data_bson_view_t* child) {
+    if(!parent || !child) {
+        return -1;
+    }
+
+    const uint8_t* next = child->node + child->node_size;
+    const uint8_t* end = parent->value + parent->value_size;
+
+    if(next >= end) {
+        return -1;
+    }
+
+    return data_bson_view_parse(next, end - next, child);
+}
+
+int8_t data_bson_view_get_child(const data_bson_view_t* parent, uint64_t index, data_bson_view_t* child) {
+    if(!parent || index >= parent->length) {
+        return -1;
+    }
+
+    int8_t res = data_bson_view_first_child(parent, child);
+
+    for(uint64_t i = 0; i < index && res == 0; i++) {
+        res = data_bson_view_next_child(parent, child);
+    }
+
+    return res;
+}
+
+/**
+ * @brief checks if view is named with given string
+ * @param[in] view view
+ * @param[in] name name bytes
+ * @param[in] name_len name length
+ * @return true if names are equal
+ */
+static boolean_t data_bson_view_name_equals(const data_bson_view_t* view, const char_t* name, uint64_t name_len) {
+    data_bson_view_t v_name;
+
+    if(data_bson_view_get_name(view, &v_name) != 0 || v_name.type != DATA_TYPE_STRING || v_name.length != name_len) {
+        return false;
+    }
+
+    return memory_memcompare(v_name.value, name, name_len) == 0;
+}
+
+/**
+ * @brief finds child by name bytes
+ * @param[in] parent data list view
+ * @param[in] name name bytes
+ * @param[in] name_len name length
+ * @param[out] child found child
+ * @return 0 if found
+ */
+static int8_t data_bson_view_find_n(const data_bson_view_t* parent, const char_t* name, uint64_t name_len, data_bson_view_t* child) {
+    int8_t res = data_bson_view_first_child(parent, child);
+
+    while(res == 0) {
+        if(data_bson_view_name_equals(child, name, name_len)) {
+            return 0;
+        }
+
+        res = data_bson_view_next_child(parent, child);
+    }
+
+    return -1;
+}
+
+int8_t data_bson_view_find(const data_bson_view_t* parent, const char_t* name, data_bson_view_t* child) {
+    if(!name) {
+        return -1;
+    }
+
+    return data_bson_view_find_n(parent, name, strlen(name), child);
+}
+
+int8_t data_bson_view_find_by_id(const data_bson_view_t* parent, uint64_t id, data_bson_view_t* child) {
+    int8_t res = data_bson_view_first_child(parent, child);
+
+    while(res == 0) {
+        data_bson_view_t v_name;
+        uint64_t v_id = 0;
+
+        if(data_bson_view_get_name(child, &v_name) == 0 && data_bson_view_get_integer(&v_name, &v_id) == 0 && v_id == id) {
+            return 0;
+        }
+
+        res = data_bson_view_next_child(parent, child);
+    }
+
+    return -1;
+}
+
+int8_t data_bson_view_get_path(const data_bson_view_t* root, const char_t* path, data_bson_view_t* out) {
+    if(!root || !path || !out) {
+        return -1;
+    }
+
+    data_bson_view_t current = *root;
+
+    while(*path) {
+        const char_t* dot = path;
+
+        while(*dot && *dot != '.') {
+            dot++;
+        }
+
+        if(data_bson_view_find_n(&current, path, dot - path, out) != 0) {
+            return -1;
+        }
+
+        current = *out;
+        path = *dot ? dot + 1 : dot;
+    }
+
+    *out = current;
+
+    return 0;
+}
+
+int8_t data_bson_view_get_integer(const data_bson_view_t* view, uint64_t* out) {
+    if(!view || !out) {
+        return -1;
+    }
+
+    switch(view->type) {
+    case DATA_TYPE_BOOLEAN:
+    case DATA_TYPE_CHAR:
+    case DATA_TYPE_INT8:
+        *out = *view->value;
+        return 0;
+    case DATA_TYPE_INT16:
+        *out = *(const data_bson_unaligned_uint16_t*)view->value;
+        return 0;
+    case DATA_TYPE_INT32:
+        *out = *(const data_bson_unaligned_uint32_t*)view->value;
+        return 0;
+    case DATA_TYPE_INT64:
+        *out = *(const data_bson_unaligned_uint64_t*)view->value;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+int8_t data_bson_view_get_float(const data_bson_view_t* view, float64_t* out) {
+    if(!view || !out) {
+        return -1;
+    }
+
+    if(view->type == DATA_TYPE_FLOAT32) {
+        float32_t f = 0;
+        memory_memcopy(view->value, &f, sizeof(float32_t));
+        *out = f;
+
+        return 0;
+    }
+
+    if(view->type == DATA_TYPE_FLOAT64) {
+        memory_memcopy(view->value, out, sizeof(float64_t));
+
+        return 0;
+    }
+
+    return -1;
+}
+
+int8_t data_bson_view_get_string(const data_bson_view_t* view, const char_t** str, uint64_t* length) {
+    if(!view || !str || view->type != DATA_TYPE_STRING) {
+        return -1;
+    }
+
+    *str = (const char_t*)view->value;
+
+    if(length) {
+        *length = view->length;
+    }
+
+    return 0;
+}
+
+int8_t data_bson_view_get_array(const data_bson_view_t* view, const void** items, uint64_t* count) {
+    if(!view || !items || view->type <= DATA_TYPE_DATA) {
+        return -1;
+    }
+
+    *items = view->value;
+
+    if(count) {
+        *count = view->length;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief frees name and value of data, data itself is not freed
+ * @param[in] data data whose contents will be freed
+ * @param[in] free_strings if false string values are borrowed and not freed
+ */
+static void data_free_contents(data_t* data, boolean_t free_strings) {
     if(data->name) {
-        data_free(data->name);
+        data_free_ext(data->name, free_strings);
     }
 
-    if(data->type >= DATA_TYPE_STRING) {
-        if(data->type == DATA_TYPE_DATA && data->value) {
-            data_t* ds = data->value;
+    if(data->type == DATA_TYPE_DATA) {
+        data_t* ds = data->value;
+
+        if(ds) {
             for(uint64_t i = 0; i < data->length; i++) {
-                if(ds[i].name) {
-                    data_free(ds[i].name);
-                }
-
-                if(ds[i].type >= DATA_TYPE_STRING) {
-                    if(ds[i].type == DATA_TYPE_DATA) {
-                        data_free(ds[i].value);
-                    } else {
-                        memory_free(ds[i].value);
-                    }
-                }
+                data_free_contents(ds + i, free_strings);
             }
 
             memory_free(ds);
-        } else {
-            memory_free(data->value);
         }
+    } else if(data->type >= DATA_TYPE_STRING && (free_strings || data->type != DATA_TYPE_STRING)) {
+        memory_free(data->value);
+    }
+}
+
+void data_free_ext(data_t* data, boolean_t free_strings) {
+    if(data == NULL) {
+        return;
     }
 
+    data_free_contents(data, free_strings);
+
     memory_free(data);
 }
+
+void data_free(data_t* data) {
+    data_free_ext(data, true);
+}
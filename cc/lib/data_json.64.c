@@ -51,17 +51,86 @@ data_t* data_json_serialize(data_t* data) {
     return res;
 }
 
-static int8_t data_json_escape_string(buffer_t * buf, char_t* str) {
+/*
+ * Byte class scans. We build with -nostdinc so intrinsic headers are not available,
+ * vector extensions and the pmovmskb builtins behind _mm_movemask_epi8/_mm256_movemask_epi8 are used instead.
+ * Without any vector unit the scalar loops are used.
+ */
+#if defined(__AVX2__)
+/*! scan vector width in bytes */
+#define DATA_JSON_VECTOR_SIZE 32
+/*! one bit per byte lane (vpmovmskb) */
+#define DATA_JSON_MOVEMASK(v) ((uint32_t)__builtin_ia32_pmovmskb256((data_json_char_vector_t)(v)))
+#elif defined(__SSE2__)
+/*! scan vector width in bytes */
+#define DATA_JSON_VECTOR_SIZE 16
+/*! one bit per byte lane (pmovmskb) */
+#define DATA_JSON_MOVEMASK(v) ((uint32_t)__builtin_ia32_pmovmskb128((data_json_char_vector_t)(v)))
+#endif
+
+#ifdef DATA_JSON_VECTOR_SIZE
+/*! byte vector */
+typedef uint8_t data_json_vector_t __attribute__((vector_size(DATA_JSON_VECTOR_SIZE)));
+/*! unaligned byte vector for loads */
+typedef uint8_t data_json_unaligned_vector_t __attribute__((vector_size(DATA_JSON_VECTOR_SIZE), aligned(1)));
+/*! char vector expected by movemask builtins */
+typedef char data_json_char_vector_t __attribute__((vector_size(DATA_JSON_VECTOR_SIZE)));
+#endif
+
+/**
+ * @brief finds length of leading bytes which can be written without escaping
+ * @param[in] str string
+ * @param[in] len string length
+ * @return length of run, stops at control characters, quote, backslash and del
+ */
+static uint64_t data_json_escape_free_run(const uint8_t* str, uint64_t len) {
+    uint64_t i = 0;
+
+#ifdef DATA_JSON_VECTOR_SIZE
+    while(i + DATA_JSON_VECTOR_SIZE <= len) {
+        data_json_vector_t v = *(const data_json_unaligned_vector_t*)(str + i);
+        uint32_t m = DATA_JSON_MOVEMASK((v < 0x20) | (v == '"') | (v == '\\') | (v == 0x7F));
+
+        if(m) {
+            return i + __builtin_ctz(m);
+        }
+
+        i += DATA_JSON_VECTOR_SIZE;
+    }
+#endif
+
+    while(i < len && str[i] >= 0x20 && str[i] != '"' && str[i] != '\\' && str[i] != 0x7F) {
+        i++;
+    }
+
+    return i;
+}
+
+static int8_t data_json_escape_string(buffer_t * buf, const char_t* str) {
     if(str == NULL) {
         return 0;
     }
 
-    // we need to escape the string
-    // encode \r \n \t \b \f \v \0 etc. also need to escape " and \ characters
-    // encode non-printable characters as \u00xx
+    // runs of printable characters are appended at once, \r \n \t \b \f " and \ get short escapes,
+    // other control characters are written as \u00xx. utf-8 bytes are valid json and kept as is.
+
+    const uint8_t* s = (const uint8_t*)str;
+    uint64_t len = strlen(str);
+    uint64_t i = 0;
 
-    for(uint64_t i = 0; i < strlen(str); i++) {
-        switch (str[i]) {
+    while(i < len) {
+        uint64_t run = data_json_escape_free_run(s + i, len - i);
+
+        if(run) {
+            buffer_append_bytes(buf, (uint8_t*)s + i, run);
+            i += run;
+
+            if(i == len) {
+                break;
+            }
+        }
+
+        switch (s[i]) {
         case '\r':
             buffer_append_bytes(buf, (uint8_t*)"\\r", 2);
             break;
@@ -77,12 +146,6 @@ static int8_t data_json_escape_string(buffer_t * buf, char_t* str) {
         case '\f':
             buffer_append_bytes(buf, (uint8_t*)"\\f", 2);
             break;
-        case '\v':
-            buffer_append_bytes(buf, (uint8_t*)"\\v", 2);
-            break;
-        case '\0':
-            buffer_append_bytes(buf, (uint8_t*)"\\0", 2);
-            break;
         case '"':
             buffer_append_bytes(buf, (uint8_t*)"\\\"", 2);
             break;
@@ -90,13 +153,11 @@ static int8_t data_json_escape_string(buffer_t * buf, char_t* str) {
             buffer_append_bytes(buf, (uint8_t*)"\\\\", 2);
             break;
         default:
-            if(str[i] < 32 || str[i] > 126) {
-                buffer_printf(buf, "\\u%04x", str[i]);
-            } else {
-                buffer_append_bytes(buf, (uint8_t*)&str[i], 1);
-            }
+            buffer_printf(buf, "\\u%04x", s[i]);
             break;
         }
+
+        i++;
     }
 
 
@@ -241,7 +302,1305 @@ int8_t data_json_serialize_with_buffer(buffer_t* buf, data_t* data) {
     return 0;
 }
 
-data_t* data_json_deserialize(data_t* data) {
-    UNUSED(data);
-    return NULL;
+/*! stage 1 block size, one bit per byte at masks */
+#define DATA_JSON_BLOCK_SIZE 64
+
+/**
+ * @struct data_json_scanner_t
+ * @brief stage 1 state carried between blocks
+ */
+typedef struct data_json_scanner_t {
+    uint64_t prev_escaped; ///< first byte of next block is escaped
+    uint64_t prev_in_string; ///< all ones if previous block ended inside a string
+    uint64_t prev_scalar; ///< last byte of previous block was a scalar byte
+} data_json_scanner_t; ///< short hand for struct
+
+/**
+ * @struct data_json_indexes_t
+ * @brief structural character positions produced by stage 1
+ */
+typedef struct data_json_indexes_t {
+    uint32_t* items; ///< positions
+    uint64_t  count; ///< position count
+    uint64_t  capacity; ///< allocated position count
+} data_json_indexes_t; ///< short hand for struct
+
+/**
+ * @struct data_json_parser_t
+ * @brief stage 2 state
+ */
+typedef struct data_json_parser_t {
+    uint8_t*        input; ///< json text
+    uint64_t        length; ///< json text length
+    const uint32_t* indexes; ///< structural positions of document
+    uint64_t        index_count; ///< structural position count
+    uint64_t        position; ///< next structural position
+    uint64_t        depth; ///< current nesting
+    boolean_t       in_situ; ///< strings are borrowed from input
+    data_t*         stack; ///< items of open objects and arrays, closed ones get exact sized copies
+    uint64_t        stack_count; ///< item count at stack
+    uint64_t        stack_capacity; ///< allocated item count of stack
+} data_json_parser_t; ///< short hand for struct
+
+/**
+ * @struct data_json_stream_t
+ * @brief incremental parser state
+ */
+struct data_json_stream_t {
+    uint8_t*            buffer; ///< unconsumed input
+    uint64_t            length; ///< unconsumed input length
+    uint64_t            capacity; ///< buffer capacity
+    uint64_t            scanned; ///< input length processed by stage 1, tail shorter than a block waits
+    data_json_scanner_t scanner; ///< stage 1 state at scanned
+    data_json_indexes_t indexes; ///< structural positions of scanned input
+    uint64_t            consumed; ///< input length consumed by returned documents
+    uint64_t            doc_start; ///< first structural position of next document
+    uint64_t            walk_position; ///< structural positions before it are depth counted
+    uint64_t            walk_depth; ///< nesting at walk position
+    boolean_t           error; ///< malformed input seen
+};
+
+static int8_t data_json_parse_value(data_json_parser_t* parser, data_t* out);
+
+/**
+ * @brief computes per byte class masks of a block
+ * @param[in] block 64 bytes
+ * @param[out] quote quote mask
+ * @param[out] backslash backslash mask
+ * @param[out] op structural operator mask
+ * @param[out] ws whitespace mask
+ */
+static inline void data_json_block_masks(const uint8_t* block, uint64_t* quote, uint64_t* backslash, uint64_t* op, uint64_t* ws) {
+    uint64_t q = 0, b = 0, o = 0, w = 0;
+
+#ifdef DATA_JSON_VECTOR_SIZE
+    for(uint64_t i = 0; i < DATA_JSON_BLOCK_SIZE; i += DATA_JSON_VECTOR_SIZE) {
+        data_json_vector_t v = *(const data_json_unaligned_vector_t*)(block + i);
+
+        q |= (uint64_t)DATA_JSON_MOVEMASK(v == '"') << i;
+        b |= (uint64_t)DATA_JSON_MOVEMASK(v == '\\') << i;
+        o |= (uint64_t)DATA_JSON_MOVEMASK((v == '{') | (v == '}') | (v == '[') | (v == ']') | (v == ':') | (v == ',')) << i;
+        w |= (uint64_t)DATA_JSON_MOVEMASK((v == ' ') | (v == '\t') | (v == '\n') | (v == '\r')) << i;
+    }
+#else
+    for(uint64_t i = 0; i < DATA_JSON_BLOCK_SIZE; i++) {
+        uint64_t bit = 1ULL << i;
+
+        switch(block[i]) {
+        case '"':
+            q |= bit;
+            break;
+        case '\\':
+            b |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            o |= bit;
+            break;
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            w |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+#endif
+
+    *quote = q;
+    *backslash = b;
+    *op = o;
+    *ws = w;
+}
+
+/**
+ * @brief stage 1 of a block: finds structural characters and scalar starts outside of strings
+ * @param[in,out] scanner state carried between blocks
+ * @param[in] block 64 bytes
+ * @return structural mask
+ */
+static uint64_t data_json_scan_block(data_json_scanner_t* scanner, const uint8_t* block) {
+    uint64_t quote, backslash, op, ws;
+
+    data_json_block_masks(block, &quote, &backslash, &op, &ws);
+
+    // a character is escaped when an odd length backslash run precedes it
+    uint64_t escaped;
+
+    if(!backslash) {
+        escaped = scanner->prev_escaped;
+        scanner->prev_escaped = 0;
+    } else {
+        const uint64_t even_bits = 0x5555555555555555ULL;
+
+        backslash &= ~scanner->prev_escaped;
+        uint64_t follows_escape = (backslash << 1) | scanner->prev_escaped;
+        uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+        uint64_t sequences_starting_on_even_bits = 0;
+        scanner->prev_escaped = __builtin_add_overflow(odd_sequence_starts, backslash, &sequences_starting_on_even_bits);
+        uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+        escaped = (even_bits ^ invert_mask) & follows_escape;
+    }
+
+    quote &= ~escaped;
+
+    // prefix xor of quotes marks string interiors including opening quotes
+    uint64_t in_string = quote;
+    in_string ^= in_string << 1;
+    in_string ^= in_string << 2;
+    in_string ^= in_string << 4;
+    in_string ^= in_string << 8;
+    in_string ^= in_string << 16;
+    in_string ^= in_string << 32;
+    in_string ^= scanner->prev_in_string;
+    scanner->prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+    // scalars (literals, numbers and opening quotes) start where previous byte is not a scalar byte
+    uint64_t scalar = ~(op | ws);
+    uint64_t nonquote_scalar = scalar & ~quote;
+    uint64_t follows_nonquote_scalar = (nonquote_scalar << 1) | scanner->prev_scalar;
+    scanner->prev_scalar = nonquote_scalar >> 63;
+    uint64_t scalar_start = scalar & ~follows_nonquote_scalar;
+
+    uint64_t string_tail = in_string ^ quote;
+
+    return (op | scalar_start) & ~string_tail;
+}
+
+/**
+ * @brief appends positions of a block mask
+ * @param[in] indexes position list
+ * @param[in] mask structural mask
+ * @param[in] base position of block
+ * @return 0 on success
+ */
+static int8_t data_json_indexes_append(data_json_indexes_t* indexes, uint64_t mask, uint64_t base) {
+    if(indexes->count + DATA_JSON_BLOCK_SIZE > indexes->capacity) {
+        uint64_t new_capacity = indexes->capacity ? indexes->capacity * 2 : 256;
+        uint32_t* new_items = memory_malloc(sizeof(uint32_t) * new_capacity);
+
+        if(!new_items) {
+            return -1;
+        }
+
+        memory_memcopy(indexes->items, new_items, sizeof(uint32_t) * indexes->count);
+        memory_free(indexes->items);
+
+        indexes->items = new_items;
+        indexes->capacity = new_capacity;
+    }
+
+    while(mask) {
+        indexes->items[indexes->count++] = base + __builtin_ctzll(mask);
+        mask &= mask - 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief runs stage 1 over input range
+ * @param[in,out] scanner state
+ * @param[in] input json text
+ * @param[in] start first position, block aligned relative to scanning start
+ * @param[in] end end position
+ * @param[in] indexes output positions
+ * @param[in] pad_tail if true the final partial block is scanned padded with spaces
+ * @return position after last scanned full block, -1ULL on error
+ */
+static uint64_t data_json_scan(data_json_scanner_t* scanner, const uint8_t* input, uint64_t start, uint64_t end,
+                               data_json_indexes_t* indexes, boolean_t pad_tail) {
+    uint64_t pos = start;
+
+    while(pos + DATA_JSON_BLOCK_SIZE <= end) {
+        if(data_json_indexes_append(indexes, data_json_scan_block(scanner, input + pos), pos) != 0) {
+            return -1ULL;
+        }
+
+        pos += DATA_JSON_BLOCK_SIZE;
+    }
+
+    if(pad_tail && pos < end) {
+        uint8_t tail[DATA_JSON_BLOCK_SIZE];
+
+        memory_memset(tail, ' ', DATA_JSON_BLOCK_SIZE);
+        memory_memcopy(input + pos, tail, end - pos);
+
+        if(data_json_indexes_append(indexes, data_json_scan_block(scanner, tail), pos) != 0) {
+            return -1ULL;
+        }
+    }
+
+    return pos;
+}
+
+/**
+ * @brief finds length of leading bytes of a string without quote or backslash
+ * @param[in] str string body
+ * @param[in] len remaining length
+ * @return run length
+ */
+static uint64_t data_json_plain_run(const uint8_t* str, uint64_t len) {
+    uint64_t i = 0;
+
+#ifdef DATA_JSON_VECTOR_SIZE
+    while(i + DATA_JSON_VECTOR_SIZE <= len) {
+        data_json_vector_t v = *(const data_json_unaligned_vector_t*)(str + i);
+        uint32_t m = DATA_JSON_MOVEMASK((v == '"') | (v == '\\'));
+
+        if(m) {
+            return i + __builtin_ctz(m);
+        }
+
+        i += DATA_JSON_VECTOR_SIZE;
+    }
+#endif
+
+    while(i < len && str[i] != '"' && str[i] != '\\') {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * @brief parses four hex digits
+ * @param[in] str digits
+ * @return value or -1 if malformed
+ */
+static int32_t data_json_parse_hex4(const uint8_t* str) {
+    int32_t res = 0;
+
+    for(uint8_t i = 0; i < 4; i++) {
+        uint8_t c = str[i];
+
+        res <<= 4;
+
+        if(c >= '0' && c <= '9') {
+            res |= c - '0';
+        } else if(c >= 'a' && c <= 'f') {
+            res |= c - 'a' + 10;
+        } else if(c >= 'A' && c <= 'F') {
+            res |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief parses string starting at opening quote
+ * @details strings without escapes are borrowed at in situ mode and copied otherwise.
+ * escaped strings are unescaped into place at in situ mode, the result is never longer than the source.
+ * @param[in] parser parser
+ * @param[in] quote_pos opening quote position
+ * @param[out] out null terminated string
+ * @param[out] out_len string length
+ * @return 0 on success
+ */
+static int8_t data_json_parse_string(data_json_parser_t* parser, uint64_t quote_pos, char_t** out, uint64_t* out_len) {
+    uint8_t* input = parser->input;
+    uint64_t start = quote_pos + 1;
+    uint64_t i = start + data_json_plain_run(input + start, parser->length - start);
+
+    if(i >= parser->length) {
+        return -1;
+    }
+
+    if(input[i] == '"') {
+        uint64_t len = i - start;
+
+        if(parser->in_situ) {
+            input[i] = '\0';
+            *out = (char_t*)input + start;
+        } else {
+            *out = memory_malloc(len + 1);
+
+            if(!*out) {
+                return -1;
+            }
+
+            memory_memcopy(input + start, *out, len);
+        }
+
+        *out_len = len;
+
+        return 0;
+    }
+
+    uint64_t end = i;
+
+    while(end < parser->length && input[end] != '"') {
+        end += input[end] == '\\' ? 2 : 1;
+    }
+
+    if(end >= parser->length) {
+        return -1;
+    }
+
+    uint8_t* dst = NULL;
+
+    if(parser->in_situ) {
+        dst = input + start;
+    } else {
+        dst = memory_malloc(end - start + 1);
+
+        if(!dst) {
+            return -1;
+        }
+
+        memory_memcopy(input + start, dst, i - start);
+    }
+
+    uint64_t w = i - start;
+    uint64_t r = i;
+
+    while(r < end) {
+        uint8_t c = input[r++];
+
+        if(c != '\\') {
+            dst[w++] = c;
+            continue;
+        }
+
+        c = input[r++];
+
+        switch(c) {
+        case '"':
+        case '\\':
+        case '/':
+            dst[w++] = c;
+            break;
+        case 'b':
+            dst[w++] = '\b';
+            break;
+        case 'f':
+            dst[w++] = '\f';
+            break;
+        case 'n':
+            dst[w++] = '\n';
+            break;
+        case 'r':
+            dst[w++] = '\r';
+            break;
+        case 't':
+            dst[w++] = '\t';
+            break;
+        case 'v': // older serializer output
+            dst[w++] = '\v';
+            break;
+        case 'u': {
+            int32_t cp = r + 4 <= end ? data_json_parse_hex4(input + r) : -1;
+            r += 4;
+
+            if(cp >= 0xD800 && cp <= 0xDBFF) {
+                int32_t low = -1;
+
+                if(r + 6 <= end && input[r] == '\\' && input[r + 1] == 'u') {
+                    low = data_json_parse_hex4(input + r + 2);
+                    r += 6;
+                }
+
+                if(low < 0xDC00 || low > 0xDFFF) {
+                    goto catch_error;
+                }
+
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            } else if(cp >= 0xDC00 && cp <= 0xDFFF) {
+                goto catch_error;
+            }
+
+            if(cp <= 0) { // null can not live inside a c string
+                goto catch_error;
+            }
+
+            if(cp < 0x80) {
+                dst[w++] = cp;
+            } else if(cp < 0x800) {
+                dst[w++] = 0xC0 | (cp >> 6);
+                dst[w++] = 0x80 | (cp & 0x3F);
+            } else if(cp < 0x10000) {
+                dst[w++] = 0xE0 | (cp >> 12);
+                dst[w++] = 0x80 | ((cp >> 6) & 0x3F);
+                dst[w++] = 0x80 | (cp & 0x3F);
+            } else {
+                dst[w++] = 0xF0 | (cp >> 18);
+                dst[w++] = 0x80 | ((cp >> 12) & 0x3F);
+                dst[w++] = 0x80 | ((cp >> 6) & 0x3F);
+                dst[w++] = 0x80 | (cp & 0x3F);
+            }
+        }
+        break;
+        default:
+            goto catch_error;
+        }
+    }
+
+    dst[w] = '\0';
+
+    *out = (char_t*)dst;
+    *out_len = w;
+
+    return 0;
+
+catch_error:
+    if(!parser->in_situ) {
+        memory_free(dst);
+    }
+
+    return -1;
+}
+
+/**
+ * @brief checks byte can follow a literal or number
+ * @param[in] parser parser
+ * @param[in] pos byte position
+ * @return true if scalar ends at position
+ */
+static boolean_t data_json_is_scalar_end(data_json_parser_t* parser, uint64_t pos) {
+    if(pos >= parser->length) {
+        return true;
+    }
+
+    switch(parser->input[pos]) {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+    case ',':
+    case ':':
+    case '}':
+    case ']':
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*! exactly representable powers of ten */
+static const float64_t data_json_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * @brief parses number, integers without fraction and exponent are DATA_TYPE_INT64 others are DATA_TYPE_FLOAT64
+ * @param[in] parser parser
+ * @param[in] pos first byte of number
+ * @param[out] out number data
+ * @return 0 on success
+ */
+static int8_t data_json_parse_number(data_json_parser_t* parser, uint64_t pos, data_t* out) {
+    const uint8_t* s = parser->input + pos;
+    uint64_t rem = parser->length - pos;
+    uint64_t i = 0;
+    boolean_t neg = false;
+    boolean_t is_float = false;
+    uint64_t mantissa = 0;
+    int64_t exp10 = 0;
+
+    if(s[i] == '-') {
+        neg = true;
+        i++;
+    }
+
+    if(i >= rem || s[i] < '0' || s[i] > '9') {
+        return -1;
+    }
+
+    while(i < rem && s[i] >= '0' && s[i] <= '9') {
+        uint64_t d = s[i] - '0';
+
+        if(mantissa <= (-1ULL - d) / 10) {
+            mantissa = mantissa * 10 + d;
+        } else {
+            exp10++;
+            is_float = true;
+        }
+
+        i++;
+    }
+
+    if(i < rem && s[i] == '.') {
+        i++;
+        is_float = true;
+
+        if(i >= rem || s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+
+        while(i < rem && s[i] >= '0' && s[i] <= '9') {
+            uint64_t d = s[i] - '0';
+
+            if(mantissa <= (-1ULL - d) / 10) {
+                mantissa = mantissa * 10 + d;
+                exp10--;
+            }
+
+            i++;
+        }
+    }
+
+    if(i < rem && (s[i] == 'e' || s[i] == 'E')) {
+        i++;
+        is_float = true;
+
+        boolean_t exp_neg = false;
+
+        if(i < rem && (s[i] == '-' || s[i] == '+')) {
+            exp_neg = s[i] == '-';
+            i++;
+        }
+
+        if(i >= rem || s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+
+        int64_t e = 0;
+
+        while(i < rem && s[i] >= '0' && s[i] <= '9') {
+            if(e < 100000) {
+                e = e * 10 + (s[i] - '0');
+            }
+
+            i++;
+        }
+
+        exp10 += exp_neg ? -e : e;
+    }
+
+    if(!data_json_is_scalar_end(parser, pos + i)) {
+        return -1;
+    }
+
+    if(!is_float && neg && mantissa > (1ULL << 63)) {
+        is_float = true;
+    }
+
+    if(!is_float) {
+        out->type = DATA_TYPE_INT64;
+        out->value = (void*)(neg ? (uint64_t)(-(int64_t)mantissa) : mantissa);
+
+        return 0;
+    }
+
+    float64_t f = (float64_t)mantissa;
+
+    while(exp10 > 22) {
+        f *= data_json_pow10[22];
+        exp10 -= 22;
+    }
+
+    while(exp10 < -22) {
+        f /= data_json_pow10[22];
+        exp10 += 22;
+    }
+
+    if(exp10 > 0) {
+        f *= data_json_pow10[exp10];
+    } else if(exp10 < 0) {
+        f /= data_json_pow10[-exp10];
+    }
+
+    if(neg) {
+        f = -f;
+    }
+
+    uint64_t tmp = 0;
+    memory_memcopy(&f, &tmp, sizeof(uint64_t));
+
+    out->type = DATA_TYPE_FLOAT64;
+    out->value = (void*)tmp;
+
+    return 0;
+}
+
+/**
+ * @brief pushes item to parser stack
+ * @param[in] parser parser
+ * @param[in] item item, copied
+ * @return 0 on success
+ */
+static int8_t data_json_stack_push(data_json_parser_t* parser, const data_t* item) {
+    if(parser->stack_count == parser->stack_capacity) {
+        uint64_t new_capacity = parser->stack_capacity ? parser->stack_capacity * 2 : 64;
+        data_t* new_stack = memory_malloc(sizeof(data_t) * new_capacity);
+
+        if(!new_stack) {
+            return -1;
+        }
+
+        memory_memcopy(parser->stack, new_stack, sizeof(data_t) * parser->stack_count);
+        memory_free(parser->stack);
+
+        parser->stack = new_stack;
+        parser->stack_capacity = new_capacity;
+    }
+
+    memory_memcopy(item, parser->stack + parser->stack_count, sizeof(data_t));
+    parser->stack_count++;
+
+    return 0;
+}
+
+/**
+ * @brief frees contents of a parsed value
+ * @param[in] parser parser
+ * @param[in] value value whose contents will be freed
+ */
+static void data_json_free_contents(data_json_parser_t* parser, const data_t* value) {
+    data_t* tmp = memory_malloc(sizeof(data_t));
+
+    if(!tmp) {
+        return;
+    }
+
+    memory_memcopy(value, tmp, sizeof(data_t));
+
+    data_free_ext(tmp, !parser->in_situ);
+}
+
+/**
+ * @brief frees stack items above base and their contents
+ * @param[in] parser parser
+ * @param[in] base stack count at container start
+ */
+static void data_json_stack_free(data_json_parser_t* parser, uint64_t base) {
+    for(uint64_t i = base; i < parser->stack_count; i++) {
+        data_json_free_contents(parser, parser->stack + i);
+    }
+
+    parser->stack_count = base;
+}
+
+/**
+ * @brief moves stack items above base into an exact sized array
+ * @param[in] parser parser
+ * @param[in] base stack count at container start
+ * @param[out] items array, NULL if there is no item
+ * @return 0 on success
+ */
+static int8_t data_json_stack_pop(data_json_parser_t* parser, uint64_t base, data_t** items) {
+    uint64_t count = parser->stack_count - base;
+
+    *items = NULL;
+
+    if(!count) {
+        return 0;
+    }
+
+    *items = memory_malloc(sizeof(data_t) * count);
+
+    if(!*items) {
+        data_json_stack_free(parser, base);
+
+        return -1;
+    }
+
+    memory_memcopy(parser->stack + base, *items, sizeof(data_t) * count);
+    parser->stack_count = base;
+
+    return 0;
+}
+
+/**
+ * @brief returns next structural character and consumes it
+ * @param[in] parser parser
+ * @param[out] pos position of character, can be NULL
+ * @return character or -1 at end of document
+ */
+static int16_t data_json_next(data_json_parser_t* parser, uint64_t* pos) {
+    if(parser->position >= parser->index_count) {
+        return -1;
+    }
+
+    uint64_t p = parser->indexes[parser->position++];
+
+    if(pos) {
+        *pos = p;
+    }
+
+    return parser->input[p];
+}
+
+/**
+ * @brief returns next structural character without consuming it
+ * @param[in] parser parser
+ * @return character or -1 at end of document
+ */
+static int16_t data_json_peek(data_json_parser_t* parser) {
+    if(parser->position >= parser->index_count) {
+        return -1;
+    }
+
+    return parser->input[parser->indexes[parser->position]];
+}
+
+/**
+ * @brief parses object after opening brace, members become named items of DATA_TYPE_DATA
+ * @param[in] parser parser
+ * @param[out] out object data
+ * @return 0 on success
+ */
+static int8_t data_json_parse_object(data_json_parser_t* parser, data_t* out) {
+    uint64_t base = parser->stack_count;
+
+    if(data_json_peek(parser) == '}') {
+        parser->position++;
+    } else {
+        while(true) {
+            uint64_t pos = 0;
+
+            if(data_json_next(parser, &pos) != '"') {
+                goto catch_error;
+            }
+
+            char_t* key = NULL;
+            uint64_t key_len = 0;
+
+            if(data_json_parse_string(parser, pos, &key, &key_len) != 0) {
+                goto catch_error;
+            }
+
+            data_t* name = memory_malloc(sizeof(data_t));
+
+            if(!name) {
+                if(!parser->in_situ) {
+                    memory_free(key);
+                }
+
+                goto catch_error;
+            }
+
+            name->type = DATA_TYPE_STRING;
+            name->length = key_len;
+            name->value = key;
+
+            data_t child = {0};
+
+            if(data_json_next(parser, NULL) != ':' || data_json_parse_value(parser, &child) != 0) {
+                data_free_ext(name, !parser->in_situ);
+
+                goto catch_error;
+            }
+
+            child.name = name;
+
+            if(data_json_stack_push(parser, &child) != 0) {
+                data_json_free_contents(parser, &child);
+
+                goto catch_error;
+            }
+
+            int16_t c = data_json_next(parser, NULL);
+
+            if(c == '}') {
+                break;
+            }
+
+            if(c != ',') {
+                goto catch_error;
+            }
+        }
+    }
+
+    data_t* items = NULL;
+    uint64_t count = parser->stack_count - base;
+
+    if(data_json_stack_pop(parser, base, &items) != 0) {
+        return -1;
+    }
+
+    out->type = DATA_TYPE_DATA;
+    out->length = count;
+    out->value = items;
+
+    return 0;
+
+catch_error:
+    data_json_stack_free(parser, base);
+
+    return -1;
+}
+
+/**
+ * @brief parses array after opening bracket
+ * @details number arrays become DATA_TYPE_INT64_ARRAY or DATA_TYPE_FLOAT64_ARRAY, arrays of single member objects
+ * become DATA_TYPE_DATA of those members as the serializer writes them, others become DATA_TYPE_DATA of unnamed items.
+ * @param[in] parser parser
+ * @param[out] out array data
+ * @return 0 on success
+ */
+static int8_t data_json_parse_array(data_json_parser_t* parser, data_t* out) {
+    uint64_t base = parser->stack_count;
+
+    if(data_json_peek(parser) == ']') {
+        parser->position++;
+
+        out->type = DATA_TYPE_INT64_ARRAY;
+        out->length = 0;
+        out->value = NULL;
+
+        return 0;
+    }
+
+    while(true) {
+        data_t child = {0};
+
+        if(data_json_parse_value(parser, &child) != 0) {
+            goto catch_error;
+        }
+
+        if(data_json_stack_push(parser, &child) != 0) {
+            data_json_free_contents(parser, &child);
+
+            goto catch_error;
+        }
+
+        int16_t c = data_json_next(parser, NULL);
+
+        if(c == ']') {
+            break;
+        }
+
+        if(c != ',') {
+            goto catch_error;
+        }
+    }
+
+    uint64_t count = parser->stack_count - base;
+    data_t* children = parser->stack + base;
+    boolean_t numbers = true;
+    boolean_t floats = false;
+    boolean_t members = true;
+
+    for(uint64_t i = 0; i < count; i++) {
+        data_t* child = children + i;
+
+        if(child->type == DATA_TYPE_FLOAT64) {
+            floats = true;
+        } else if(child->type != DATA_TYPE_INT64) {
+            numbers = false;
+        }
+
+        if(child->type != DATA_TYPE_DATA || child->length != 1 || ((data_t*)child->value)->name == NULL) {
+            members = false;
+        }
+    }
+
+    if(numbers) {
+        uint64_t* values = memory_malloc(sizeof(uint64_t) * count);
+
+        if(!values) {
+            goto catch_error;
+        }
+
+        for(uint64_t i = 0; i < count; i++) {
+            uint64_t v = (uint64_t)children[i].value;
+
+            if(floats && children[i].type == DATA_TYPE_INT64) {
+                float64_t f = (float64_t)(int64_t)v;
+                memory_memcopy(&f, &v, sizeof(uint64_t));
+            }
+
+            values[i] = v;
+        }
+
+        out->type = floats ? DATA_TYPE_FLOAT64_ARRAY : DATA_TYPE_INT64_ARRAY;
+        out->length = count;
+        out->value = values;
+
+        parser->stack_count = base;
+
+        return 0;
+    }
+
+    if(members) {
+        for(uint64_t i = 0; i < count; i++) {
+            data_t* wrapper = children[i].value;
+
+            memory_memcopy(wrapper, children + i, sizeof(data_t));
+            memory_free(wrapper);
+        }
+    }
+
+    data_t* items = NULL;
+
+    if(data_json_stack_pop(parser, base, &items) != 0) {
+        return -1;
+    }
+
+    out->type = DATA_TYPE_DATA;
+    out->length = count;
+    out->value = items;
+
+    return 0;
+
+catch_error:
+    data_json_stack_free(parser, base);
+
+    return -1;
+}
+
+/**
+ * @brief parses value at next structural position
+ * @param[in] parser parser
+ * @param[out] out value, name is not set
+ * @return 0 on success
+ */
+static int8_t data_json_parse_value(data_json_parser_t* parser, data_t* out) {
+    uint64_t pos = 0;
+    int16_t c = data_json_next(parser, &pos);
+    int8_t res = -1;
+
+    switch(c) {
+    case '{':
+    case '[':
+        if(parser->depth >= DATA_JSON_MAX_DEPTH) {
+            return -1;
+        }
+
+        parser->depth++;
+        res = c == '{' ? data_json_parse_object(parser, out) : data_json_parse_array(parser, out);
+        parser->depth--;
+
+        return res;
+    case '"': {
+        char_t* str = NULL;
+        uint64_t len = 0;
+
+        if(data_json_parse_string(parser, pos, &str, &len) != 0) {
+            return -1;
+        }
+
+        out->type = DATA_TYPE_STRING;
+        out->length = len;
+        out->value = str;
+
+        return 0;
+    }
+    case 't':
+    case 'f':
+    case 'n': {
+        const char_t* literal = c == 't' ? "true" : (c == 'f' ? "false" : "null");
+        uint64_t len = strlen(literal);
+
+        if(parser->length - pos < len || memory_memcompare(parser->input + pos, literal, len) != 0 ||
+           !data_json_is_scalar_end(parser, pos + len)) {
+            return -1;
+        }
+
+        out->type = c == 'n' ? DATA_TYPE_NULL : DATA_TYPE_BOOLEAN;
+        out->value = (void*)(uint64_t)(c == 't');
+
+        return 0;
+    }
+    default:
+        if(c == '-' || (c >= '0' && c <= '9')) {
+            return data_json_parse_number(parser, pos, out);
+        }
+
+        return -1;
+    }
+}
+
+/**
+ * @brief stage 2 of a single document
+ * @details a top level object with a single member is the named data of that member, as serializer writes one.
+ * @param[in] input json text
+ * @param[in] length json text length
+ * @param[in] indexes structural positions of the document
+ * @param[in] index_count structural position count
+ * @param[in] in_situ borrow strings from input
+ * @return document
+ */
+static data_t* data_json_parse_document(uint8_t* input, uint64_t length, const uint32_t* indexes, uint64_t index_count, boolean_t in_situ) {
+    data_json_parser_t parser = {0};
+    parser.input = input;
+    parser.length = length;
+    parser.indexes = indexes;
+    parser.index_count = index_count;
+    parser.in_situ = in_situ;
+
+    data_t value = {0};
+    int8_t parse_res = data_json_parse_value(&parser, &value);
+
+    memory_free(parser.stack);
+
+    if(parse_res != 0) {
+        return NULL;
+    }
+
+    if(parser.position != parser.index_count) {
+        data_json_free_contents(&parser, &value);
+
+        return NULL;
+    }
+
+    data_t* res = memory_malloc(sizeof(data_t));
+
+    if(!res) {
+        data_json_free_contents(&parser, &value);
+
+        return NULL;
+    }
+
+    if(input[indexes[0]] == '{' && value.length == 1) {
+        memory_memcopy(value.value, res, sizeof(data_t));
+        memory_free(value.value);
+    } else {
+        memory_memcopy(&value, res, sizeof(data_t));
+    }
+
+    return res;
+}
+
+/**
+ * @brief deserializes whole json text
+ * @param[in] data json as DATA_TYPE_INT8_ARRAY
+ * @param[in] in_situ borrow strings from input
+ * @return deserialized data
+ */
+static data_t* data_json_deserialize_ext(data_t* data, boolean_t in_situ) {
+    if(data == NULL || data->type != DATA_TYPE_INT8_ARRAY || data->value == NULL || data->length == 0) {
+        return NULL;
+    }
+
+    if(data->length >= (1ULL << 32)) {
+        return NULL;
+    }
+
+    data_json_scanner_t scanner = {0};
+    data_json_indexes_t indexes = {0};
+
+    if(data_json_scan(&scanner, data->value, 0, data->length, &indexes, true) == -1ULL || !indexes.count) {
+        memory_free(indexes.items);
+
+        return NULL;
+    }
+
+    data_t* res = data_json_parse_document(data->value, data->length, indexes.items, indexes.count, in_situ);
+
+    memory_free(indexes.items);
+
+    return res;
+}
+
+data_t* data_json_deserialize(data_t* data) {
+    return data_json_deserialize_ext(data, false);
+}
+
+data_t* data_json_deserialize_in_situ(data_t* data) {
+    return data_json_deserialize_ext(data, true);
+}
+
+data_json_stream_t* data_json_stream_new(void) {
+    return memory_malloc(sizeof(data_json_stream_t));
+}
+
+int8_t data_json_stream_destroy(data_json_stream_t* stream) {
+    if(!stream) {
+        return -1;
+    }
+
+    memory_free(stream->buffer);
+    memory_free(stream->indexes.items);
+    memory_free(stream);
+
+    return 0;
+}
+
+boolean_t data_json_stream_has_error(data_json_stream_t* stream) {
+    return stream == NULL || stream->error;
+}
+
+int8_t data_json_stream_feed(data_json_stream_t* stream, const uint8_t* chunk, uint64_t length) {
+    if(!stream || (!chunk && length)) {
+        return -1;
+    }
+
+    if(stream->length + length >= (1ULL << 32)) {
+        return -1;
+    }
+
+    if(stream->length + length > stream->capacity) {
+        uint64_t new_capacity = stream->capacity ? stream->capacity : 4096;
+
+        while(new_capacity < stream->length + length) {
+            new_capacity *= 2;
+        }
+
+        uint8_t* new_buffer = memory_malloc(new_capacity);
+
+        if(!new_buffer) {
+            return -1;
+        }
+
+        memory_memcopy(stream->buffer, new_buffer, stream->length);
+        memory_free(stream->buffer);
+
+        stream->buffer = new_buffer;
+        stream->capacity = new_capacity;
+    }
+
+    memory_memcopy(chunk, stream->buffer + stream->length, length);
+    stream->length += length;
+
+    return 0;
+}
+
+/**
+ * @brief counts depth over structural positions until a document closes
+ * @param[in] stream parser
+ * @param[in,out] walk_position first position to visit
+ * @param[in,out] walk_depth nesting at walk position
+ * @param[in] count position count
+ * @return true if a document closes, walk position is after closing position
+ */
+static boolean_t data_json_stream_walk(data_json_stream_t* stream, uint64_t* walk_position, uint64_t* walk_depth, uint64_t count) {
+    while(*walk_position < count) {
+        uint8_t c = stream->buffer[stream->indexes.items[*walk_position]];
+
+        (*walk_position)++;
+
+        if(c == '{' || c == '[') {
+            (*walk_depth)++;
+        } else if(c == '}' || c == ']') {
+            if(*walk_depth == 0) {
+                stream->error = true;
+
+                return false;
+            }
+
+            (*walk_depth)--;
+        } else if(*walk_depth == 0) { // top level scalars are ambiguous at chunk boundaries
+            stream->error = true;
+
+            return false;
+        }
+
+        if(*walk_depth == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief drops consumed input and positions when they are at least half of buffer
+ * @details shift never passes scanned input, stage 1 state stays block aligned.
+ * @param[in] stream parser
+ */
+static void data_json_stream_compact(data_json_stream_t* stream) {
+    uint64_t shift = MIN(stream->consumed, stream->scanned);
+
+    if(shift * 2 < stream->length) {
+        return;
+    }
+
+    memory_memcopy(stream->buffer + shift, stream->buffer, stream->length - shift);
+    stream->length -= shift;
+    stream->scanned -= shift;
+    stream->consumed -= shift;
+
+    uint64_t remaining = stream->indexes.count - stream->doc_start;
+
+    for(uint64_t i = 0; i < remaining; i++) {
+        stream->indexes.items[i] = stream->indexes.items[stream->doc_start + i] - shift;
+    }
+
+    stream->indexes.count = remaining;
+    stream->walk_position -= stream->doc_start;
+    stream->doc_start = 0;
+}
+
+data_t* data_json_stream_next(data_json_stream_t* stream) {
+    if(!stream || stream->error) {
+        return NULL;
+    }
+
+    uint64_t scanned = data_json_scan(&stream->scanner, stream->buffer, stream->scanned, stream->length, &stream->indexes, false);
+
+    if(scanned == -1ULL) {
+        stream->error = true;
+
+        return NULL;
+    }
+
+    stream->scanned = scanned;
+
+    // positions of a document which was closed at a provisional tail are committed now, skip them
+    while(stream->doc_start < stream->indexes.count && stream->indexes.items[stream->doc_start] < stream->consumed) {
+        stream->doc_start++;
+    }
+
+    if(stream->walk_position < stream->doc_start) {
+        stream->walk_position = stream->doc_start;
+    }
+
+    uint64_t committed = stream->indexes.count;
+    uint64_t doc_start = stream->doc_start;
+    uint64_t walk_position = stream->walk_position;
+    uint64_t walk_depth = stream->walk_depth;
+    boolean_t found = data_json_stream_walk(stream, &walk_position, &walk_depth, committed);
+
+    if(!found && !stream->error) {
+        stream->walk_position = walk_position;
+        stream->walk_depth = walk_depth;
+
+        if(stream->scanned < stream->length) {
+            // tail shorter than a block is scanned with a copy of state, its positions are dropped afterwards
+            data_json_scanner_t tail_scanner = stream->scanner;
+
+            if(data_json_scan(&tail_scanner, stream->buffer, stream->scanned, stream->length, &stream->indexes, true) == -1ULL) {
+                stream->error = true;
+
+                return NULL;
+            }
+
+            // a document may already have been returned from the same tail
+            while(walk_depth == 0 && walk_position < stream->indexes.count &&
+                  stream->indexes.items[walk_position] < stream->consumed) {
+                walk_position++;
+                doc_start++;
+            }
+
+            found = data_json_stream_walk(stream, &walk_position, &walk_depth, stream->indexes.count);
+        }
+    }
+
+    if(!found) {
+        stream->indexes.count = committed;
+
+        return NULL;
+    }
+
+    uint64_t doc_end = walk_position;
+    data_t* res = data_json_parse_document(stream->buffer, stream->length,
+                                           stream->indexes.items + doc_start, doc_end - doc_start, false);
+
+    stream->consumed = stream->indexes.items[doc_end - 1] + 1;
+    stream->indexes.count = committed;
+    stream->doc_start = MIN(doc_end, committed);
+    stream->walk_position = stream->doc_start;
+    stream->walk_depth = 0;
+
+    if(!res) {
+        stream->error = true;
+
+        return NULL;
+    }
+
+    data_json_stream_compact(stream);
+
+    return res;
 }
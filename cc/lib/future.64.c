@@ -2,33 +2,42 @@
  * @file future.64.c
  * @brief Future implementation for 64-bit systems.
  *
+ * completion is a state bit set once with an atomic or. waiters publish their task id at the future,
+ * park themselves at the scheduler with task hooks, recheck the state and yield. producers set the state
+ * bit, then read the waiter id and wake it, so either the waiter sees the completion or the producer sees
+ * the waiter. without task hooks (early boot, tests) waiters poll.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
 
 #include <future.h>
-#include <cpu/task.h>
+#include <time.h>
 
 MODULE("turnstone.lib.future");
 
+/*! future is signaled */
+#define FUTURE_STATE_COMPLETED    1
+/*! future has a continuation */
+#define FUTURE_STATE_CALLBACK_SET 2
+
 typedef struct future_t {
-    memory_heap_t* heap;
-    lock_t*        lock;
-    void*          data;
+    memory_heap_t*    heap; ///< heap of future
+    void*             data; ///< consumer data
+    volatile uint64_t state; ///< FUTURE_STATE_* bits
+    volatile uint64_t references; ///< producer and consumer references
+    volatile uint64_t waiter_task_id; ///< task waiting for future, 0 if none
+    future_callback_f callback; ///< continuation
+    void*             callback_arg; ///< continuation argument
 } future_t;
 
-typedef void (*future_task_wait_toggler_f)(uint64_t task_id);
-future_task_wait_toggler_f future_task_wait_toggler_func = NULL;
-
-void future_task_wait_toggler(uint64_t task_id);
-
-void future_task_wait_toggler(uint64_t task_id) {
-    if(future_task_wait_toggler_func) {
-        future_task_wait_toggler_func(task_id);
-    }
-}
+future_task_id_getter_f future_task_id_getter_func = NULL;
+future_task_wait_begin_f future_task_wait_begin_func = NULL;
+future_task_wait_end_f future_task_wait_end_func = NULL;
+future_task_waker_f future_task_waker_func = NULL;
+future_task_yielder_f future_task_yielder_func = NULL;
 
-future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data) {
+future_t* future_create_with_heap_and_data(memory_heap_t* heap, void* data) {
     future_t* fi = memory_malloc_ext(heap, sizeof(future_t), 0);
 
     if(fi == NULL) {
@@ -36,26 +45,188 @@ future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, vo
     }
 
     fi->heap = heap;
-    fi->lock = lock;
     fi->data = data;
+    fi->references = 2;
 
     return fi;
 }
 
-void* future_get_data_and_destroy(future_t* future) {
-    future_t* fi = (future_t*)future;
+static void future_release(future_t* future) {
+    if(__atomic_sub_fetch(&future->references, 1, __ATOMIC_ACQ_REL) == 0) {
+        memory_free_ext(future->heap, future);
+    }
+}
 
-    if(fi == NULL) {
-        return NULL;
+int8_t future_signal(future_t* future) {
+    if(future == NULL) {
+        return -1;
+    }
+
+    uint64_t old_state = __atomic_fetch_or(&future->state, FUTURE_STATE_COMPLETED, __ATOMIC_SEQ_CST);
+
+    if(old_state & FUTURE_STATE_COMPLETED) {
+        return -1;
+    }
+
+    if(old_state & FUTURE_STATE_CALLBACK_SET) {
+        future->callback(future->data, future->callback_arg);
+    }
+
+    uint64_t waiter_task_id = __atomic_load_n(&future->waiter_task_id, __ATOMIC_SEQ_CST);
+
+    if(waiter_task_id && future_task_waker_func) {
+        future_task_waker_func(waiter_task_id);
+    }
+
+    future_release(future);
+
+    return 0;
+}
+
+boolean_t future_is_completed(future_t* future) {
+    if(future == NULL) {
+        return false;
+    }
+
+    return (__atomic_load_n(&future->state, __ATOMIC_SEQ_CST) & FUTURE_STATE_COMPLETED) != 0;
+}
+
+int8_t future_set_callback(future_t* future, future_callback_f callback, void* arg) {
+    if(future == NULL || callback == NULL || future->callback) {
+        return -1;
+    }
+
+    future->callback = callback;
+    future->callback_arg = arg;
+
+    uint64_t old_state = __atomic_fetch_or(&future->state, FUTURE_STATE_CALLBACK_SET, __ATOMIC_SEQ_CST);
+
+    // producer signaled before it could see the callback
+    if(old_state & FUTURE_STATE_COMPLETED) {
+        callback(future->data, arg);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief checks future set
+ * @param[in] futures future set
+ * @param[in] count future count
+ * @param[in] all wait for all or any
+ * @return index of completed future for any, 0 for all, -1 if not completed yet
+ */
+static int64_t future_check_set(future_t** futures, uint64_t count, boolean_t all) {
+    for(uint64_t i = 0; i < count; i++) {
+        boolean_t completed = future_is_completed(futures[i]);
+
+        if(!all && completed) {
+            return i;
+        }
+
+        if(all && !completed) {
+            return -1;
+        }
+    }
+
+    return all ? 0 : -1;
+}
+
+static int64_t future_wait_set(future_t** futures, uint64_t count, boolean_t all, uint64_t timeout_ms) {
+    if(futures == NULL || count == 0) {
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(futures[i] == NULL) {
+            return -1;
+        }
+    }
+
+    int64_t res = future_check_set(futures, count, all);
+
+    if(res != -1) {
+        return res;
+    }
+
+    uint64_t deadline = timeout_ms ? (uint64_t)time_ns(NULL) + timeout_ms * 1000000ULL : 0;
+    uint64_t task_id = future_task_id_getter_func ? future_task_id_getter_func() : 0;
+    boolean_t can_park = task_id && future_task_wait_begin_func && future_task_wait_end_func && future_task_yielder_func;
+
+    if(can_park) {
+        for(uint64_t i = 0; i < count; i++) {
+            __atomic_store_n(&futures[i]->waiter_task_id, task_id, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    while(true) {
+        uint64_t remaining_ms = 0;
+
+        if(deadline) {
+            uint64_t now = time_ns(NULL);
+
+            if(now >= deadline) {
+                res = future_check_set(futures, count, all);
+
+                break;
+            }
+
+            remaining_ms = (deadline - now + 999999ULL) / 1000000ULL;
+        }
+
+        if(can_park) {
+            future_task_wait_begin_func(remaining_ms);
+        }
+
+        // a producer signaling after this check sees our task id and wakes us, its wake stays pending at task if we are preempted before yield
+        res = future_check_set(futures, count, all);
+
+        if(res != -1) {
+            if(can_park) {
+                future_task_wait_end_func();
+            }
+
+            break;
+        }
+
+        if(can_park) {
+            future_task_yielder_func();
+        } else {
+            asm volatile ("pause" ::: "memory");
+        }
+    }
+
+    if(can_park) {
+        for(uint64_t i = 0; i < count; i++) {
+            __atomic_store_n(&futures[i]->waiter_task_id, 0, __ATOMIC_SEQ_CST);
+        }
     }
 
-    lock_acquire(fi->lock);
+    return res;
+}
+
+int8_t future_wait(future_t* future, uint64_t timeout_ms) {
+    return future_wait_set(&future, 1, true, timeout_ms) == 0 ? 0 : -1;
+}
+
+int64_t future_wait_any(future_t** futures, uint64_t count, uint64_t timeout_ms) {
+    return future_wait_set(futures, count, false, timeout_ms);
+}
+
+int8_t future_wait_all(future_t** futures, uint64_t count, uint64_t timeout_ms) {
+    return future_wait_set(futures, count, true, timeout_ms) == 0 ? 0 : -1;
+}
+
+void* future_get_data_and_destroy(future_t* future) {
+    if(future == NULL) {
+        return NULL;
+    }
 
-    void* data = fi->data;
+    future_wait(future, FUTURE_WAIT_FOREVER);
 
-    lock_destroy(fi->lock);
+    void* data = future->data;
 
-    memory_free_ext(fi->heap, fi);
+    future_release(future);
 
     return data;
 }
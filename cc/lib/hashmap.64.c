@@ -68,7 +68,7 @@ int8_t hashmap_default_kc(const void* item1, const void* item2);
 /**
  * @brief string key generator
  * @param[in] key key
- * @return key hash xxhash64
+ * @return key hash xxh3 64-bit
  */
 uint64_t hashmap_string_kg(const void * key);
 
@@ -87,7 +87,7 @@ uint64_t hashmap_default_kg(const void* key) {
 uint64_t hashmap_string_kg(const void * key) {
     char_t* str_key = (char_t*)key;
 
-    return xxhash64_hash(str_key, strlen(str_key));
+    return xxhash3_64_hash(str_key, strlen(str_key));
 }
 
 int8_t hashmap_default_kc(const void* item1, const void* item2) {
@@ -2,6 +2,9 @@
  * @file list_array.64.c
  * @brief array list types implementations
  *
+ * items are kept at a power of two sized ring buffer, so both ends are O(1) and
+ * positional access is a mask away. capacity doubles when full.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
@@ -11,9 +14,12 @@
 #include <cpu/sync.h>
 #include <strings.h>
 #include <logging.h>
+#include <utils.h>
 
 MODULE("turnstone.lib.list.array");
 
+/*! initial ring capacity, must be power of two */
+#define ARRAYLIST_INITIAL_CAPACITY 8
 
 typedef struct list_item_t {
     const void* data; ///< the data inside list item
@@ -27,12 +33,21 @@ typedef struct list_t {
     list_data_comparator_f equality_comparator; ///< if the list is sorted, this is comparator function for data
     size_t                 item_count; ///< item count at the list, for fast access.
     indexer_t*             indexer; ///< if the list is indexed, this is the indexer
-    size_t                 capacity; ///< the capacity of the list
-    size_t                 head; ///< the head of the list
-    size_t                 tail; ///< the tail of the list
+    size_t                 capacity; ///< the capacity of the list, power of two
+    size_t                 head; ///< ring index of the first item
     list_item_t*           items; ///< the items of the list
 }list_t; ///< short hand for struct
 
+/**
+ * @struct arraylist_iterator_internal_t
+ * @brief iterator struct
+ */
+typedef struct arraylist_iterator_internal_t {
+    list_t* list; ///< owner list
+    size_t  current_position; ///< logical position of current item
+    uint8_t current_deleted; ///< if current item is deleted it is to be 1.
+} arraylist_iterator_internal_t; ///<short hand for struct
+
 
 list_t* arraylist_create_with_type(memory_heap_t* heap, list_type_t type,
                                    list_data_comparator_f comparator, indexer_t* indexer);
@@ -45,10 +60,73 @@ int8_t      arraylist_get_position(list_t* list, const void* data, size_t* posit
 list_t*     arraylist_duplicate_list_with_heap(memory_heap_t* heap, list_t* list);
 iterator_t* arraylist_iterator_create(list_t* list);
 
+/**
+ * @brief destroys the iterator
+ * @param[in]  iterator to destroy.
+ * @return  0 if succeed.
+ */
+int8_t arraylist_iterator_destroy(iterator_t* iterator);
+
+/**
+ * @brief iterates next item of list.
+ * @param[in]  iterator the iterator
+ * @return          itself
+ */
+iterator_t* arraylist_iterator_next(iterator_t* iterator);
+
+/**
+ * @brief checks if iterator is at end of the list
+ * @param[in]  iterator the iterator
+ * @return  0 if the iterator is at the end of list.
+ */
+int8_t arraylist_iterator_end_of_list(iterator_t* iterator);
+
+/**
+ * @brief returns data at current item
+ * @param[in]  iterator the iterator
+ * @return data
+ */
+const void* arraylist_iterator_get_item(iterator_t* iterator);
+
+/**
+ * @brief deletes current item.
+ * @param[in]  iterator the iterator
+ * @return deleted item
+ */
+const void* arraylist_iterator_delete_item(iterator_t* iterator);
+
+/**
+ * @brief converts logical position to ring index
+ * @param[in] list the list
+ * @param[in] position logical position
+ * @return ring index
+ */
+static inline size_t arraylist_ring_index(const list_t* list, size_t position) {
+    return (list->head + position) & (list->capacity - 1);
+}
+
+/**
+ * @brief rounds capacity up to power of two
+ * @param[in] capacity requested capacity
+ * @return power of two capacity
+ */
+static size_t arraylist_round_capacity(size_t capacity) {
+    size_t res = ARRAYLIST_INITIAL_CAPACITY;
+
+    while(res < capacity) {
+        res <<= 1;
+    }
+
+    return res;
+}
 
 list_t* arraylist_create_with_type(memory_heap_t* heap, list_type_t type,
                                    list_data_comparator_f comparator, indexer_t* indexer) {
 
+    if(type & LIST_TYPE_INDEXEDLIST) { // indexer keeps item addresses, they move at arrays
+        return NULL;
+    }
+
     heap = memory_get_heap(heap); // get rid of the null heap, so heap is always stable.
 
     list_t* list = memory_malloc_ext(heap, sizeof(list_t), 0x0);
@@ -61,9 +139,7 @@ list_t* arraylist_create_with_type(memory_heap_t* heap, list_type_t type,
     list->type = type;
     list->comparator = comparator;
     list->indexer = indexer;
-    list->capacity = 128;
-    list->head = list->capacity - 1;
-    list->tail = list->capacity - 1;
+    list->capacity = ARRAYLIST_INITIAL_CAPACITY;
     list->items = memory_malloc_ext(heap, sizeof(list_item_t) * list->capacity, 0x0);
 
     if(list->items == NULL) {
@@ -71,52 +147,65 @@ list_t* arraylist_create_with_type(memory_heap_t* heap, list_type_t type,
         return NULL;
     }
 
-    if(type & LIST_TYPE_SORTEDLIST) {
-        if(comparator == NULL) {
-            list->comparator = list_default_data_comparator;
-        }
+    if(list->comparator == NULL) {
+        list->comparator = list_default_data_comparator;
     }
 
+    list->lock = lock_create_with_heap(list->heap);
+
     return list;
 }
 
+/**
+ * @brief moves items into a new ring of given capacity starting at index 0
+ * @param[in] list the list
+ * @param[in] capacity new power of two capacity
+ * @return 0 if succeed
+ */
+static int8_t arraylist_resize(list_t* list, size_t capacity) {
+    list_item_t* new_items = memory_malloc_ext(list->heap, sizeof(list_item_t) * capacity, 0x0);
+
+    if(new_items == NULL) {
+        return -1;
+    }
+
+    // ring is at most two runs, copy them in order
+    size_t first_run = MIN(list->item_count, list->capacity - list->head);
+
+    memory_memcopy(list->items + list->head, new_items, sizeof(list_item_t) * first_run);
+    memory_memcopy(list->items, new_items + first_run, sizeof(list_item_t) * (list->item_count - first_run));
+
+    memory_free_ext(list->heap, list->items);
+
+    list->items = new_items;
+    list->capacity = capacity;
+    list->head = 0;
+
+    return 0;
+}
+
 int8_t arraylist_set_capacity(list_t* list, size_t capacity) {
     if(list == NULL) {
         return -1;
     }
 
-    if(capacity < list->capacity || capacity == 0) {
+    if(capacity < list->item_count || capacity == 0) {
         return -1;
     }
 
-    list_item_t* new_items = memory_malloc_ext(list->heap, sizeof(list_item_t) * capacity, 0x0);
+    capacity = arraylist_round_capacity(capacity);
 
-    if(new_items == NULL) {
-        return -1;
+    if(capacity == list->capacity) {
+        return 0;
     }
 
-
     lock_acquire(list->lock);
 
-    list_item_t* old_items = list->items; // save the old items
-
-    size_t idx = list->head;
-
-    for(size_t i = 0; i < list->item_count; i++) {
-        new_items[i].data = list->items[idx].data;
-        idx = (idx + 1) % list->capacity;
-    }
-
-    list->items = new_items;
-    list->capacity = capacity;
-    list->head = 0;
-    list->tail = list->item_count;
+    int8_t res = arraylist_resize(list, capacity);
 
     lock_release(list->lock);
 
-    memory_free_ext(list->heap, old_items);
-
-    return 0;
+    return res;
 }
 
 uint8_t arraylist_destroy_with_type(list_t* list, list_destroy_type_t type, list_item_destroyer_callback_f destroyer) {
@@ -124,18 +213,19 @@ uint8_t arraylist_destroy_with_type(list_t* list, list_destroy_type_t type, list
         return -1;
     }
 
-    if(type & LIST_DESTROY_WITH_DATA) {
-        for(size_t i = 0; i < list->capacity; i++) {
-            if(list->items[i].data != NULL) {
-                if(destroyer != NULL) {
-                    destroyer(list->heap, (void*)list->items[i].data);
-                } else {
-                    memory_free_ext(list->heap, (void*)list->items[i].data);
-                }
+    if(type == LIST_DESTROY_WITH_DATA) {
+        for(size_t i = 0; i < list->item_count; i++) {
+            void* data = (void*)list->items[arraylist_ring_index(list, i)].data;
+
+            if(destroyer != NULL) {
+                destroyer(list->heap, data);
+            } else {
+                memory_free_ext(list->heap, data);
             }
         }
     }
 
+    lock_destroy(list->lock);
     memory_free_ext(list->heap, list->items);
     memory_free_ext(list->heap, list);
 
@@ -151,41 +241,187 @@ const void* arraylist_get_data_at_position(list_t* list, size_t position) {
         return NULL;
     }
 
-    position = (list->head + position) % list->capacity;
+    return list->items[arraylist_ring_index(list, position)].data;
+}
 
-    return list->items[position].data;
+/**
+ * @brief finds first position whose item is not less than data
+ * @param[in] list sorted list
+ * @param[in] data data to search
+ * @return position between 0 and item count
+ */
+static size_t arraylist_lower_bound(const list_t* list, const void* data) {
+    size_t low = 0;
+    size_t high = list->item_count;
+
+    while(low < high) {
+        size_t mid = (low + high) / 2;
+
+        if(list->comparator(data, list->items[arraylist_ring_index(list, mid)].data) > 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
 }
 
-int8_t arraylist_get_position(list_t* list, const void* data, size_t* position) {
-    if(list == NULL || data == NULL || position == NULL) {
+/**
+ * @brief finds position of data, sorted lists without equality comparator are binary searched
+ * @param[in] list the list
+ * @param[in] data data to search
+ * @param[out] position found position, or insertion position for sorted lists
+ * @return 0 if found
+ */
+static int8_t arraylist_find(const list_t* list, const void* data, size_t* position) {
+    if((list->type & LIST_TYPE_SORTEDLIST) && !list->equality_comparator) {
+        size_t pos = arraylist_lower_bound(list, data);
+
+        *position = pos;
+
+        if(pos < list->item_count && list->comparator(data, list->items[arraylist_ring_index(list, pos)].data) == 0) {
+            return 0;
+        }
+
         return -1;
     }
 
-    size_t idx = list->head;
+    list_data_comparator_f cmp = list->equality_comparator ? list->equality_comparator : list->comparator;
 
     for(size_t i = 0; i < list->item_count; i++) {
-        if(list->comparator(data, list->items[idx].data) == 0) {
-            *position = idx;
+        if(cmp(data, list->items[arraylist_ring_index(list, i)].data) == 0) {
+            *position = i;
+
             return 0;
         }
-
-        idx = (idx + 1) % list->capacity;
     }
 
+    *position = list->item_count;
+
     return -1;
 }
 
-size_t arraylist_insert_at(list_t* list, const void* data, list_insert_delete_at_t where, size_t position) {
+int8_t arraylist_get_position(list_t* list, const void* data, size_t* position) {
     if(list == NULL) {
         return -1;
     }
 
-    UNUSED(data);
-    UNUSED(where);
-    UNUSED(position);
-    NOTIMPLEMENTEDLOG(KERNEL);
+    size_t pos = 0;
+    int8_t res = arraylist_find(list, data, &pos);
 
-    return -1;
+    if(position) {
+        *position = res == 0 ? pos : 0;
+    }
+
+    return res;
+}
+
+/**
+ * @brief opens a gap at position by shifting the shorter side
+ * @param[in] list the list, must have a free slot
+ * @param[in] position gap position
+ */
+static void arraylist_open_gap(list_t* list, size_t position) {
+    size_t mask = list->capacity - 1;
+
+    if(position < list->item_count / 2) {
+        list->head = (list->head - 1) & mask;
+
+        for(size_t i = 0; i < position; i++) {
+            list->items[arraylist_ring_index(list, i)] = list->items[arraylist_ring_index(list, i + 1)];
+        }
+    } else {
+        for(size_t i = list->item_count; i > position; i--) {
+            list->items[arraylist_ring_index(list, i)] = list->items[arraylist_ring_index(list, i - 1)];
+        }
+    }
+}
+
+/**
+ * @brief closes the gap at position by shifting the shorter side
+ * @param[in] list the list, item count is not updated
+ * @param[in] position removed position
+ */
+static void arraylist_close_gap(list_t* list, size_t position) {
+    size_t mask = list->capacity - 1;
+
+    if(position < list->item_count / 2) {
+        for(size_t i = position; i > 0; i--) {
+            list->items[arraylist_ring_index(list, i)] = list->items[arraylist_ring_index(list, i - 1)];
+        }
+
+        list->head = (list->head + 1) & mask;
+    } else {
+        for(size_t i = position + 1; i < list->item_count; i++) {
+            list->items[arraylist_ring_index(list, i - 1)] = list->items[arraylist_ring_index(list, i)];
+        }
+    }
+}
+
+size_t arraylist_insert_at(list_t* list, const void* data, list_insert_delete_at_t where, size_t position) {
+    if(list == NULL) {
+        return -1ULL;
+    }
+
+    lock_acquire(list->lock);
+
+    if(list->item_count == list->capacity && arraylist_resize(list, list->capacity * 2) != 0) {
+        lock_release(list->lock);
+
+        return -1ULL;
+    }
+
+    size_t result;
+
+    switch(where) {
+    case LIST_INSERT_AT_HEAD:
+        list->head = (list->head - 1) & (list->capacity - 1);
+        result = 0;
+        break;
+    case LIST_INSERT_AT_TAIL:
+        result = list->item_count;
+        break;
+    case LIST_INSERT_AT_SORTED:
+        result = arraylist_lower_bound(list, data);
+        arraylist_open_gap(list, result);
+        break;
+    case LIST_INSERT_AT_POSITION:
+        result = MIN(position, list->item_count);
+        arraylist_open_gap(list, result);
+        break;
+    default:
+        lock_release(list->lock);
+
+        return -1ULL;
+    }
+
+    list->items[arraylist_ring_index(list, result)].data = data;
+    list->item_count++;
+
+    lock_release(list->lock);
+
+    return result;
+}
+
+/**
+ * @brief removes item at position without locking
+ * @param[in] list the list
+ * @param[in] position position to remove
+ * @return removed data
+ */
+static const void* arraylist_remove_at(list_t* list, size_t position) {
+    const void* result = list->items[arraylist_ring_index(list, position)].data;
+
+    if(position == 0) {
+        list->head = (list->head + 1) & (list->capacity - 1);
+    } else if(position != list->item_count - 1) {
+        arraylist_close_gap(list, position);
+    }
+
+    list->item_count--;
+
+    return result;
 }
 
 const void* arraylist_delete_at(list_t* list, const void* data, list_insert_delete_at_t where, size_t position) {
@@ -193,12 +429,40 @@ const void* arraylist_delete_at(list_t* list, const void* data, list_insert_dele
         return NULL;
     }
 
-    UNUSED(data);
-    UNUSED(where);
-    UNUSED(position);
-    NOTIMPLEMENTEDLOG(KERNEL);
+    if(data == NULL && where == LIST_DELETE_AT_FINDBY) {
+        return NULL;
+    }
 
-    return NULL;
+    lock_acquire(list->lock);
+
+    const void* result = NULL;
+
+    if(list->item_count != 0) {
+        switch(where) {
+        case LIST_DELETE_AT_HEAD:
+            result = arraylist_remove_at(list, 0);
+            break;
+        case LIST_DELETE_AT_TAIL:
+            result = arraylist_remove_at(list, list->item_count - 1);
+            break;
+        case LIST_DELETE_AT_POSITION:
+            if(position < list->item_count) {
+                result = arraylist_remove_at(list, position);
+            }
+            break;
+        case LIST_DELETE_AT_FINDBY:
+            if(arraylist_find(list, data, &position) == 0) {
+                result = arraylist_remove_at(list, position);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    lock_release(list->lock);
+
+    return result;
 }
 
 list_t* arraylist_duplicate_list_with_heap(memory_heap_t* heap, list_t* list) {
@@ -206,11 +470,44 @@ list_t* arraylist_duplicate_list_with_heap(memory_heap_t* heap, list_t* list) {
         return NULL;
     }
 
-    UNUSED(heap);
-    UNUSED(list);
-    NOTIMPLEMENTEDLOG(KERNEL);
+    if(heap == NULL) {
+        heap = list->heap;
+    }
+
+    list_t* new_list = memory_malloc_ext(heap, sizeof(list_t), 0x0);
+
+    if(new_list == NULL) {
+        return NULL;
+    }
+
+    lock_acquire(list->lock);
+
+    new_list->items = memory_malloc_ext(heap, sizeof(list_item_t) * list->capacity, 0x0);
+
+    if(new_list->items == NULL) {
+        lock_release(list->lock);
+        memory_free_ext(heap, new_list);
+
+        return NULL;
+    }
+
+    new_list->heap = heap;
+    new_list->type = list->type;
+    new_list->comparator = list->comparator;
+    new_list->equality_comparator = list->equality_comparator;
+    new_list->indexer = list->indexer;
+    new_list->capacity = list->capacity;
+    new_list->item_count = list->item_count;
+
+    for(size_t i = 0; i < list->item_count; i++) {
+        new_list->items[i] = list->items[arraylist_ring_index(list, i)];
+    }
+
+    lock_release(list->lock);
 
-    return NULL;
+    new_list->lock = lock_create_with_heap(heap);
+
+    return new_list;
 }
 
 iterator_t* arraylist_iterator_create(list_t* list) {
@@ -218,9 +515,99 @@ iterator_t* arraylist_iterator_create(list_t* list) {
         return NULL;
     }
 
-    UNUSED(list);
+    lock_acquire(list->lock);
+
+    iterator_t* iterator = memory_malloc_ext(list->heap, sizeof(iterator_t), 0x0);
+
+    if(iterator == NULL) {
+        lock_release(list->lock);
+
+        return NULL;
+    }
+
+    arraylist_iterator_internal_t* iter = memory_malloc_ext(list->heap, sizeof(arraylist_iterator_internal_t), 0x0);
+
+    if(iter == NULL) {
+        memory_free_ext(list->heap, iterator);
+        lock_release(list->lock);
+
+        return NULL;
+    }
+
+    iter->list = list;
+    iterator->metadata = iter;
+    iterator->destroy = &arraylist_iterator_destroy;
+    iterator->next = &arraylist_iterator_next;
+    iterator->end_of_iterator = &arraylist_iterator_end_of_list;
+    iterator->get_item = &arraylist_iterator_get_item;
+    iterator->delete_item = &arraylist_iterator_delete_item;
+    iterator->get_extra_data = NULL;
+
+    return iterator;
+}
+
+int8_t arraylist_iterator_destroy(iterator_t* iterator) {
+    if(iterator == NULL) {
+        return -1;
+    }
+
+    arraylist_iterator_internal_t* iter = (arraylist_iterator_internal_t*)iterator->metadata;
+
+    if(iter == NULL) {
+        return -1;
+    }
+
+    memory_heap_t* heap = iter->list->heap;
+
+    lock_release(iter->list->lock);
+
+    memory_free_ext(heap, iter);
+    memory_free_ext(heap, iterator);
+
+    return 0;
+}
+
+iterator_t* arraylist_iterator_next(iterator_t* iterator) {
+    if(iterator == NULL) {
+        return NULL;
+    }
+
+    arraylist_iterator_internal_t* iter = (arraylist_iterator_internal_t*)iterator->metadata;
+
+    if(iter->current_deleted == 1) {
+        iter->current_deleted = 0;
+    } else if(iter->current_position < iter->list->item_count) {
+        iter->current_position++;
+    }
+
+    return iterator;
+}
+
+int8_t arraylist_iterator_end_of_list(iterator_t* iterator) {
+    arraylist_iterator_internal_t* iter = (arraylist_iterator_internal_t*)iterator->metadata;
+
+    return iter->current_position < iter->list->item_count ? 1 : 0;
+}
+
+const void* arraylist_iterator_get_item(iterator_t* iterator) {
+    arraylist_iterator_internal_t* iter = (arraylist_iterator_internal_t*)iterator->metadata;
+
+    return arraylist_get_data_at_position(iter->list, iter->current_position);
+}
+
+const void* arraylist_iterator_delete_item(iterator_t* iterator) {
+    if(iterator == NULL) {
+        return NULL;
+    }
+
+    arraylist_iterator_internal_t* iter = (arraylist_iterator_internal_t*)iterator->metadata;
+
+    if(iter->current_position >= iter->list->item_count) {
+        return NULL;
+    }
 
-    NOTIMPLEMENTEDLOG(KERNEL);
+    // next item slides into current position, so next() must not advance
+    iter->current_deleted = 1;
 
-    return NULL;
+    return arraylist_remove_at(iter->list, iter->current_position);
 }
@@ -10,6 +10,7 @@
 #include <logging.h>
 #include <windowmanager.h>
 #include <strings.h>
+#include <spool.h>
 
 MODULE("turnstone.lib.logging");
 
@@ -122,6 +123,10 @@ void logging_printlog(uint64_t module, uint64_t level, const char_t* file_name,
         using_tmp_printf_buffer = true;
     }
 
+#if ___KERNELBUILD == 1
+    uint64_t line_start = buffer_get_length(buffer_error);
+#endif
+
     if(LOG_LOCATION) {
         buffer_printf(buffer_error, "%s:%lli:", file_name, line_no);
     }
@@ -137,6 +142,13 @@ void logging_printlog(uint64_t module, uint64_t level, const char_t* file_name,
 
     buffer_printf(buffer_error, "\n");
 
+#if ___KERNELBUILD == 1
+    uint64_t line_length = buffer_get_length(buffer_error) - line_start;
+
+    // bounded copy of log line which outlives flushes and buffer resets
+    spool_write(logging_module_names[module], buffer_get_view_at_position(buffer_error, line_start, line_length), line_length);
+#endif
+
     if(!windowmanager_is_initialized()) {
         stdbufs_flush_buffer(buffer_error);
     }
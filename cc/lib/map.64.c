@@ -31,13 +31,13 @@ uint64_t map_default_key_extractor(const void* key) {
 uint64_t map_string_key_extractor(const void* key) {
     const char_t* str = key;
 
-    return xxhash64_hash(str, strlen(str));
+    return xxhash3_64_hash(str, strlen(str));
 }
 
 uint64_t map_data_key_extractor(const void* key_size) {
     data_t* d = (data_t*)key_size;
 
-    return xxhash64_hash(d->value, d->length);
+    return xxhash3_64_hash(d->value, d->length);
 }
 
 int8_t map_key_comparator(const void* data1, const void* data2){
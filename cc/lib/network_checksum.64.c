@@ -0,0 +1,254 @@
+/**
+ * @file network_checksum.64.c
+ * @brief Internet checksum implementation.
+ *
+ * 64 bit words are summed with end around carry counted separately, so a ones complement sum of 8 bytes
+ * costs one add and one carry add. Folding a 64 bit sum to 16 bits keeps its value modulo 0xFFFF, so the
+ * result equals summing 16 bit words one by one.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_checksum.h>
+#include <network/network_info.h>
+#include <map.h>
+#include <utils.h>
+
+MODULE("turnstone.lib.network");
+
+/*! unaligned 64 bit load */
+typedef uint64_t network_checksum_unaligned_u64_t __attribute__((aligned(1)));
+/*! unaligned 32 bit load */
+typedef uint32_t network_checksum_unaligned_u32_t __attribute__((aligned(1)));
+/*! unaligned 16 bit load */
+typedef uint16_t network_checksum_unaligned_u16_t __attribute__((aligned(1)));
+
+/*
+ * We build with -nostdinc so intrinsic headers are not available, vector extensions are used instead.
+ * Each 32 bit lane sums high and low halves of its word, lanes are flushed before they can overflow.
+ */
+#if defined(__AVX2__)
+/*! buffers shorter than this are summed with scalar loop */
+#define NETWORK_CHECKSUM_VECTOR_THRESHOLD 256
+/*! vector width in bytes */
+#define NETWORK_CHECKSUM_VECTOR_SIZE 32
+/*! iterations before lanes are flushed, each adds at most 0x1FFFE to a lane */
+#define NETWORK_CHECKSUM_VECTOR_FLUSH 16384
+
+/*! 32 bit lanes */
+typedef uint32_t network_checksum_vector_t __attribute__((vector_size(NETWORK_CHECKSUM_VECTOR_SIZE)));
+/*! unaligned 32 bit lanes for loads and stores */
+typedef uint32_t network_checksum_unaligned_vector_t __attribute__((vector_size(NETWORK_CHECKSUM_VECTOR_SIZE), aligned(1)));
+#endif
+
+uint16_t network_checksum_fold(uint64_t sum) {
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return sum;
+}
+
+#ifdef NETWORK_CHECKSUM_VECTOR_SIZE
+static uint64_t network_checksum_vector_reduce(network_checksum_vector_t acc) {
+    uint64_t sum = 0;
+
+    for(uint32_t i = 0; i < NETWORK_CHECKSUM_VECTOR_SIZE / sizeof(uint32_t); i++) {
+        sum += acc[i];
+    }
+
+    return sum;
+}
+#endif
+
+/*! sums 8 byte words, returns unfolded sum and count of processed bytes at processed */
+static uint64_t network_checksum_words(const uint8_t* src, uint8_t* dst, uint64_t len, uint64_t* processed) {
+    uint64_t sum = 0;
+    uint64_t i = 0;
+
+#ifdef NETWORK_CHECKSUM_VECTOR_SIZE
+    if(len >= NETWORK_CHECKSUM_VECTOR_THRESHOLD) {
+        const network_checksum_vector_t mask = (network_checksum_vector_t){0} + 0xFFFF;
+
+        while(i + NETWORK_CHECKSUM_VECTOR_SIZE * 2 <= len) {
+            network_checksum_vector_t acc0 = {0};
+            network_checksum_vector_t acc1 = {0};
+
+            for(uint32_t n = 0; n < NETWORK_CHECKSUM_VECTOR_FLUSH && i + NETWORK_CHECKSUM_VECTOR_SIZE * 2 <= len; n++) {
+                network_checksum_vector_t v0 = *(const network_checksum_unaligned_vector_t*)(src + i);
+                network_checksum_vector_t v1 = *(const network_checksum_unaligned_vector_t*)(src + i + NETWORK_CHECKSUM_VECTOR_SIZE);
+
+                if(dst) {
+                    *(network_checksum_unaligned_vector_t*)(dst + i) = v0;
+                    *(network_checksum_unaligned_vector_t*)(dst + i + NETWORK_CHECKSUM_VECTOR_SIZE) = v1;
+                }
+
+                acc0 += (v0 & mask) + (v0 >> 16);
+                acc1 += (v1 & mask) + (v1 >> 16);
+
+                i += NETWORK_CHECKSUM_VECTOR_SIZE * 2;
+            }
+
+            sum += network_checksum_vector_reduce(acc0) + network_checksum_vector_reduce(acc1);
+        }
+    }
+#endif
+
+    // two accumulators hide carry latency
+    uint64_t sum0 = 0;
+    uint64_t sum1 = 0;
+    uint64_t carry = 0;
+
+    for(; i + 16 <= len; i += 16) {
+        uint64_t v0 = *(const network_checksum_unaligned_u64_t*)(src + i);
+        uint64_t v1 = *(const network_checksum_unaligned_u64_t*)(src + i + 8);
+
+        if(dst) {
+            *(network_checksum_unaligned_u64_t*)(dst + i) = v0;
+            *(network_checksum_unaligned_u64_t*)(dst + i + 8) = v1;
+        }
+
+        carry += __builtin_add_overflow(sum0, v0, &sum0);
+        carry += __builtin_add_overflow(sum1, v1, &sum1);
+    }
+
+    sum = network_checksum_fold(sum) + (uint64_t)network_checksum_fold(sum0) + network_checksum_fold(sum1) + carry;
+
+    *processed = i;
+
+    return sum;
+}
+
+static uint64_t network_checksum_tail(const uint8_t* src, uint8_t* dst, uint64_t len) {
+    uint64_t sum = 0;
+    uint64_t i = 0;
+
+    for(; i + 4 <= len; i += 4) {
+        uint32_t v = *(const network_checksum_unaligned_u32_t*)(src + i);
+
+        if(dst) {
+            *(network_checksum_unaligned_u32_t*)(dst + i) = v;
+        }
+
+        sum += v;
+    }
+
+    if(i + 2 <= len) {
+        uint16_t v = *(const network_checksum_unaligned_u16_t*)(src + i);
+
+        if(dst) {
+            *(network_checksum_unaligned_u16_t*)(dst + i) = v;
+        }
+
+        sum += v;
+        i += 2;
+    }
+
+    if(i < len) {
+        // odd byte is the first byte of a word padded with zero
+        if(dst) {
+            dst[i] = src[i];
+        }
+
+        sum += src[i];
+    }
+
+    return sum;
+}
+
+uint16_t network_checksum_partial(const void* data, uint64_t len, uint16_t sum) {
+    if(data == NULL) {
+        return sum;
+    }
+
+    uint64_t processed = 0;
+    uint64_t res = network_checksum_words(data, NULL, len, &processed);
+
+    res += network_checksum_tail((const uint8_t*)data + processed, NULL, len - processed);
+
+    return network_checksum_fold(res + sum);
+}
+
+uint16_t network_checksum_copy(const void* src, void* dst, uint64_t len, uint16_t sum) {
+    if(src == NULL || dst == NULL) {
+        return sum;
+    }
+
+    uint64_t processed = 0;
+    uint64_t res = network_checksum_words(src, dst, len, &processed);
+
+    res += network_checksum_tail((const uint8_t*)src + processed, (uint8_t*)dst + processed, len - processed);
+
+    return network_checksum_fold(res + sum);
+}
+
+uint16_t network_checksum_combine(uint16_t sum, uint16_t block_sum, uint64_t offset) {
+    if(offset & 1) {
+        block_sum = BYTE_SWAP16(block_sum);
+    }
+
+    return network_checksum_fold((uint32_t)sum + block_sum);
+}
+
+uint16_t network_checksum(const void* data, uint64_t len) {
+    return ~network_checksum_partial(data, len, 0);
+}
+
+uint16_t network_checksum_pseudo_header(network_ipv4_address_t sip, network_ipv4_address_t dip, uint8_t protocol, uint16_t len) {
+    uint64_t sum = (uint64_t)sip.as_dword + dip.as_dword;
+
+    sum += BYTE_SWAP16((uint16_t)protocol);
+    sum += BYTE_SWAP16(len);
+
+    return network_checksum_fold(sum);
+}
+
+uint16_t network_checksum_update16(uint16_t checksum, uint16_t old_value, uint16_t new_value) {
+    // HC' = ~(~HC + ~m + m')
+    uint32_t sum = (uint16_t)~checksum;
+
+    sum += (uint16_t)~old_value;
+    sum += new_value;
+
+    return ~network_checksum_fold(sum);
+}
+
+uint16_t network_checksum_update32(uint16_t checksum, uint32_t old_value, uint32_t new_value) {
+    checksum = network_checksum_update16(checksum, old_value & 0xFFFF, new_value & 0xFFFF);
+
+    return network_checksum_update16(checksum, old_value >> 16, new_value >> 16);
+}
+
+void network_checksum_complete_offload(network_packet_t* packet) {
+    if(packet == NULL || !(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_OFFLOAD)) {
+        return;
+    }
+
+    uint8_t* l4 = packet->buffer + packet->checksum_start;
+    uint64_t len = packet->buffer + packet->offset + packet->length - l4;
+    network_checksum_unaligned_u16_t* field = (network_checksum_unaligned_u16_t*)(l4 + packet->checksum_field);
+
+    // field holds pseudo header sum, it is summed with segment
+    uint16_t csum = network_checksum(l4, len);
+
+    if(csum == 0 && packet->checksum_field == 6) {
+        // zero means no checksum for udp
+        csum = 0xFFFF;
+    }
+
+    *field = csum;
+
+    packet->checksum_flags &= ~NETWORK_PACKET_CHECKSUM_L4_OFFLOAD;
+}
+
+boolean_t network_checksum_tx_offload_enabled(const void* network_info) {
+    if(network_info == NULL || network_info_map == NULL) {
+        return false;
+    }
+
+    const network_info_t* ni = map_get(network_info_map, network_info);
+
+    return ni && ni->tx_checksum_offload;
+}
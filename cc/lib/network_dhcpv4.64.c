@@ -98,6 +98,46 @@ network_dhcpv4_t* network_dhcpv4_create_request_packet(network_info_t* ni, uint3
     return dhcp_discover;
 }
 
+int8_t network_dhcpv4_send_packet(network_info_t* ni, network_ipv4_address_t sip, const network_dhcpv4_t* dhcp_packet, uint16_t dhcp_packet_len) {
+    network_packet_t* packet = network_packet_alloc(NULL, sizeof(network_udpv4_header_t) + dhcp_packet_len);
+    uint8_t* packet_data = network_packet_put(packet, dhcp_packet_len);
+
+    if(packet_data == NULL) {
+        network_packet_release(packet);
+
+        return -1;
+    }
+
+    memory_memcopy(dhcp_packet, packet_data, dhcp_packet_len);
+
+    packet->network_info = ni->mac;
+
+    if(network_udpv4_push_header(packet, sip, NETWORK_IPV4_GLOBAL_BROADCAST_IP, NETWORK_DHCPV4_SOURCE_PORT, NETWORK_DHCPV4_DESTINATION_PORT) != 0) {
+        network_packet_release(packet);
+
+        return -1;
+    }
+
+    packet = network_ipv4_output(packet, sip, NETWORK_IPV4_GLOBAL_BROADCAST_IP, NETWORK_IPV4_PROTOCOL_UDPV4);
+
+    for(network_packet_t* fragment = packet; fragment; fragment = fragment->next) {
+        if(network_ethernet_push_header(fragment, BROADCAST_MAC, ni->mac, NETWORK_PROTOCOL_IPV4) != 0) {
+            network_packet_release_chain(packet);
+
+            return -1;
+        }
+    }
+
+    if(network_tx_queue_push(ni->return_queue, packet) != 0) {
+        PRINTLOG(NETWORK, LOG_TRACE, "tx queue is full, dhcp packet is dropped");
+        network_packet_release_chain(packet);
+
+        return -1;
+    }
+
+    return 0;
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 uint8_t* network_dhcpv4_process_packet(network_dhcpv4_t* recv_dhcpv4_packet, void* network_info, uint16_t* return_packet_len) {
@@ -158,73 +198,16 @@ uint8_t* network_dhcpv4_process_packet(network_dhcpv4_t* recv_dhcpv4_packet, voi
             return NULL;
         }
 
-        network_udpv4_header_t* udp = network_udpv4_create_packet_from_data(NETWORK_DHCPV4_SOURCE_PORT, NETWORK_DHCPV4_DESTINATION_PORT, dhcp_packet_len, (uint8_t*)dhcp_packet);
+        int8_t send_res = network_dhcpv4_send_packet(ni, NETWORK_IPV4_ZERO_IP, dhcp_packet, dhcp_packet_len);
 
         memory_free(dhcp_packet);
 
-        if(udp == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "udp packet is null");
+        if(send_res != 0) {
+            PRINTLOG(NETWORK, LOG_ERROR, "dhcp request cannot be queued");
 
             return NULL;
         }
 
-        list_t* l_ip = network_ipv4_create_packet_from_udp_packet(NETWORK_IPV4_ZERO_IP, NETWORK_IPV4_GLOBAL_BROADCAST_IP, udp);
-
-        if(l_ip == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "ip packet is null");
-
-            return NULL;
-        }
-
-        network_transmit_packet_t* t_ip = (network_transmit_packet_t*)list_queue_pop(l_ip);
-
-        list_destroy(l_ip);
-
-        if(t_ip == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "ip packet is null");
-
-            return NULL;
-        }
-
-        network_ipv4_header_t* ip = (network_ipv4_header_t*)t_ip->packet_data;
-
-        memory_free(t_ip);
-
-        uint16_t tl = BYTE_SWAP16(ip->total_length);
-
-        uint8_t* eth = network_ethernet_create_packet(BROADCAST_MAC, network_info, NETWORK_PROTOCOL_IPV4, tl, (uint8_t*)ip);
-
-        network_transmit_packet_t* res = memory_malloc_ext(list_get_heap(ni->return_queue), sizeof(network_transmit_packet_t), 0);
-
-        if(res == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "network transmit packet is null, re trying...");
-
-            memory_free(eth);
-
-            return NULL;
-        }
-
-        res->packet_len = sizeof(network_ethernet_t) + tl;
-
-        uint8_t* packet_data = memory_malloc_ext(list_get_heap(ni->return_queue), res->packet_len, 0);
-
-        if(packet_data == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "packet data allocation failed, re trying...");
-
-            memory_free(eth);
-            memory_free_ext(list_get_heap(ni->return_queue), res);
-
-            return NULL;
-        }
-
-        memory_memcopy(eth, packet_data, res->packet_len);
-
-        memory_free(eth);
-
-        res->packet_data = packet_data;
-
-        list_queue_push(ni->return_queue, res);
-
         PRINTLOG(NETWORK, LOG_TRACE, "dhcp request is send");
     } else if(type == NETWORK_DHCPV4_OPCODE_ACK) {
         PRINTLOG(NETWORK, LOG_TRACE, "dhcp type is ack");
@@ -7,6 +7,7 @@
  */
 
 #include <network/network_icmpv4.h>
+#include <network/network_checksum.h>
 #include <utils.h>
 #include <memory.h>
 #include <logging.h>
@@ -18,25 +19,39 @@ MODULE("turnstone.lib.network");
 network_icmpv4_ping_header_t* network_create_ping_packet(boolean_t is_reply, uint16_t identifier, uint16_t sequence, uint16_t data_len, uint8_t* data, uint16_t* packet_len);
 
 
-uint8_t* network_icmpv4_process_packet(network_icmpv4_header_t* recv_icmpv4_packet, void* network_info, uint16_t* return_packet_len) {
-    if(return_packet_len == NULL) {
+network_packet_t* network_icmpv4_process_packet(network_packet_t* packet) {
+    if(packet->length < sizeof(network_icmpv4_header_t)) {
+        network_packet_release(packet);
+
         return NULL;
     }
 
+    network_icmpv4_header_t* recv_icmpv4_packet = (network_icmpv4_header_t*)network_packet_data(packet);
+
+    if(network_checksum(recv_icmpv4_packet, packet->length) != 0) {
+        PRINTLOG(NETWORK, LOG_TRACE, "icmpv4 packet checksum failed");
+        network_packet_release(packet);
+
+        return NULL;
+    }
 
     if(recv_icmpv4_packet->type == NETWORK_ICMP_ECHO_REQUEST && recv_icmpv4_packet->code == NETWORK_ICMP_ECHO_CODE) {
-        uint8_t* data = (uint8_t*)recv_icmpv4_packet;
-        data += sizeof(network_icmpv4_header_t);
-        uint16_t ping_data_len = *((uint16_t*)network_info);
+        // echo reply carries request's identifier, sequence and data, so request becomes reply in place
+        // only type changes, checksum is updated without summing data
+        uint16_t old_type_code = recv_icmpv4_packet->type | (recv_icmpv4_packet->code << 8);
+
+        recv_icmpv4_packet->type = NETWORK_ICMP_ECHO_REPLY;
 
-        network_icmpv4_ping_header_t* ping = network_create_ping_packet(1, recv_icmpv4_packet->identifier, recv_icmpv4_packet->sequence, ping_data_len, data, return_packet_len);
+        uint16_t new_type_code = recv_icmpv4_packet->type | (recv_icmpv4_packet->code << 8);
 
+        recv_icmpv4_packet->checksum = network_checksum_update16(recv_icmpv4_packet->checksum, old_type_code, new_type_code);
 
-        return (uint8_t*)ping;
+        return packet;
     } else {
         PRINTLOG(NETWORK, LOG_TRACE, "unimplemented icmp type 0x%02x code 0x%02x", recv_icmpv4_packet->type, recv_icmpv4_packet->code);
     }
 
+    network_packet_release(packet);
 
     return NULL;
 }
@@ -73,25 +88,8 @@ network_icmpv4_ping_header_t* network_create_ping_packet(boolean_t is_reply, uin
         pp->timestamp_usec = BYTE_SWAP32(usec);
     }
 
-    uint8_t* pp_data = (uint8_t*)pp;
-
-    memory_memcopy(data, pp_data + data_offset, data_len);
-
-    uint16_t* pp_data_16 = (uint16_t*)pp_data;
-
-    uint32_t csum = 0;
-
-    for(uint16_t i = 0; i < plen / 2; i++) {
-        csum += pp_data_16[i];
-
-        uint32_t carry = csum >> 16;
-        csum &= 0xFFFF;
-        csum += carry;
-    }
-
-    int16_t res = csum;
-
-    pp->header.checksum = ~res;
+    pp->header.checksum = 0;
+    pp->header.checksum = ~network_checksum_copy(data, (uint8_t*)pp + data_offset, data_len, network_checksum_partial(pp, data_offset, 0));
 
     if(packet_len) {
         *packet_len = plen;
@@ -0,0 +1,567 @@
+/**
+ * @file network_ipv4_fragment.64.c
+ * @brief IPv4 fragment reassembly implementation.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_ipv4_fragment.h>
+#include <memory.h>
+#include <logging.h>
+#include <utils.h>
+
+MODULE("turnstone.lib.network");
+
+#define NETWORK_IPV4_FRAGMENT_NONE      0xFFFF
+#define NETWORK_IPV4_FRAGMENT_HASH_SIZE 128
+/*! last byte of the open hole before last fragment arrives */
+#define NETWORK_IPV4_FRAGMENT_INFINITY  0xFFFFFFFF
+
+/*! missing byte range, bounds are inclusive */
+typedef struct network_ipv4_fragment_hole_t {
+    uint32_t first;
+    uint32_t last;
+} network_ipv4_fragment_hole_t;
+
+typedef struct network_ipv4_fragment_datagram_t {
+    boolean_t                    in_use;
+    network_ipv4_address_t       source_ip;
+    network_ipv4_address_t       destination_ip;
+    uint16_t                     identification;
+    uint8_t                      protocol;
+    uint8_t                      hole_count;
+    uint8_t                      fragment_count;
+    uint16_t                     hash_next; ///< next datagram of bucket, or of free list
+    uint16_t                     wheel_prev;
+    uint16_t                     wheel_next;
+    uint64_t                     deadline;
+    uint32_t                     total_length; ///< 0 until last fragment arrives
+    uint32_t                     received_end; ///< end of furthest received byte
+    uint64_t                     memory; ///< bytes held by fragments
+    network_ipv4_fragment_hole_t holes[NETWORK_IPV4_FRAGMENT_MAX_HOLES];
+    network_packet_t*            fragments[NETWORK_IPV4_FRAGMENT_MAX_FRAGMENTS]; ///< arrival order
+    uint16_t                     offsets[NETWORK_IPV4_FRAGMENT_MAX_FRAGMENTS];
+} network_ipv4_fragment_datagram_t;
+
+typedef struct network_ipv4_fragment_table_t {
+    network_ipv4_fragment_datagram_t datagrams[NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS];
+    uint16_t                         buckets[NETWORK_IPV4_FRAGMENT_HASH_SIZE];
+    uint16_t                         wheel_heads[NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS];
+    uint16_t                         wheel_tails[NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS];
+    uint16_t                         free_head;
+    uint64_t                         wheel_tick; ///< last processed tick, its slot is checked again
+} network_ipv4_fragment_table_t;
+
+static network_ipv4_fragment_table_t* network_ipv4_fragment_table = NULL;
+
+static network_ipv4_fragment_config_t network_ipv4_fragment_config = {
+    .timeout_ms = NETWORK_IPV4_FRAGMENT_TIMEOUT_MS,
+    .memory_budget = NETWORK_IPV4_FRAGMENT_MEMORY_BUDGET,
+    .overlap_policy = NETWORK_IPV4_FRAGMENT_OVERLAP_DROP,
+};
+
+static network_ipv4_fragment_stats_t network_ipv4_fragment_stats = {0};
+
+static uint16_t network_ipv4_fragment_hash(const network_ipv4_header_t* header) {
+    uint32_t h = header->source_ip.as_dword * 0x9E3779B1U;
+
+    h ^= header->destination_ip.as_dword;
+    h ^= ((uint32_t)header->identification << 8) | header->protocol;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6DU;
+    h ^= h >> 12;
+
+    return h & (NETWORK_IPV4_FRAGMENT_HASH_SIZE - 1);
+}
+
+static uint16_t network_ipv4_fragment_find(const network_ipv4_header_t* header) {
+    uint16_t idx = network_ipv4_fragment_table->buckets[network_ipv4_fragment_hash(header)];
+
+    while(idx != NETWORK_IPV4_FRAGMENT_NONE) {
+        const network_ipv4_fragment_datagram_t* datagram = &network_ipv4_fragment_table->datagrams[idx];
+
+        if(datagram->identification == header->identification && datagram->protocol == header->protocol &&
+           network_ipv4_is_address_eq(datagram->source_ip, header->source_ip) &&
+           network_ipv4_is_address_eq(datagram->destination_ip, header->destination_ip)) {
+            return idx;
+        }
+
+        idx = datagram->hash_next;
+    }
+
+    return NETWORK_IPV4_FRAGMENT_NONE;
+}
+
+static void network_ipv4_fragment_wheel_link(uint16_t idx) {
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+    network_ipv4_fragment_datagram_t* datagram = &table->datagrams[idx];
+    uint64_t slot = (datagram->deadline / NETWORK_IPV4_FRAGMENT_WHEEL_TICK_MS) % NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS;
+
+    // same timeout for all, so a slot stays sorted by deadline
+    datagram->wheel_next = NETWORK_IPV4_FRAGMENT_NONE;
+    datagram->wheel_prev = table->wheel_tails[slot];
+
+    if(table->wheel_tails[slot] != NETWORK_IPV4_FRAGMENT_NONE) {
+        table->datagrams[table->wheel_tails[slot]].wheel_next = idx;
+    } else {
+        table->wheel_heads[slot] = idx;
+    }
+
+    table->wheel_tails[slot] = idx;
+}
+
+static void network_ipv4_fragment_wheel_unlink(uint16_t idx) {
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+    network_ipv4_fragment_datagram_t* datagram = &table->datagrams[idx];
+    uint64_t slot = (datagram->deadline / NETWORK_IPV4_FRAGMENT_WHEEL_TICK_MS) % NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS;
+
+    if(datagram->wheel_prev != NETWORK_IPV4_FRAGMENT_NONE) {
+        table->datagrams[datagram->wheel_prev].wheel_next = datagram->wheel_next;
+    } else {
+        table->wheel_heads[slot] = datagram->wheel_next;
+    }
+
+    if(datagram->wheel_next != NETWORK_IPV4_FRAGMENT_NONE) {
+        table->datagrams[datagram->wheel_next].wheel_prev = datagram->wheel_prev;
+    } else {
+        table->wheel_tails[slot] = datagram->wheel_prev;
+    }
+}
+
+static void network_ipv4_fragment_hash_unlink(uint16_t idx) {
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+    network_ipv4_fragment_datagram_t* datagram = &table->datagrams[idx];
+    network_ipv4_header_t key = {0};
+
+    key.source_ip = datagram->source_ip;
+    key.destination_ip = datagram->destination_ip;
+    key.identification = datagram->identification;
+    key.protocol = datagram->protocol;
+
+    uint16_t* link = &table->buckets[network_ipv4_fragment_hash(&key)];
+
+    while(*link != idx) {
+        link = &table->datagrams[*link].hash_next;
+    }
+
+    *link = datagram->hash_next;
+}
+
+/*! releases fragments of datagram and returns its slot to free list */
+static void network_ipv4_fragment_discard(uint16_t idx) {
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+    network_ipv4_fragment_datagram_t* datagram = &table->datagrams[idx];
+
+    for(uint8_t i = 0; i < datagram->fragment_count; i++) {
+        network_packet_release(datagram->fragments[i]);
+    }
+
+    network_ipv4_fragment_wheel_unlink(idx);
+    network_ipv4_fragment_hash_unlink(idx);
+
+    network_ipv4_fragment_stats.memory_used -= datagram->memory;
+    network_ipv4_fragment_stats.datagrams--;
+
+    datagram->in_use = false;
+    datagram->fragment_count = 0;
+    datagram->hash_next = table->free_head;
+    table->free_head = idx;
+}
+
+static uint16_t network_ipv4_fragment_oldest(uint16_t exclude) {
+    uint16_t oldest = NETWORK_IPV4_FRAGMENT_NONE;
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS; i++) {
+        const network_ipv4_fragment_datagram_t* datagram = &network_ipv4_fragment_table->datagrams[i];
+
+        if(!datagram->in_use || i == exclude) {
+            continue;
+        }
+
+        if(oldest == NETWORK_IPV4_FRAGMENT_NONE || datagram->deadline < network_ipv4_fragment_table->datagrams[oldest].deadline) {
+            oldest = i;
+        }
+    }
+
+    return oldest;
+}
+
+static uint16_t network_ipv4_fragment_create(const network_ipv4_header_t* header, uint64_t now) {
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+
+    if(table->free_head == NETWORK_IPV4_FRAGMENT_NONE) {
+        uint16_t victim = network_ipv4_fragment_oldest(NETWORK_IPV4_FRAGMENT_NONE);
+
+        PRINTLOG(NETWORK, LOG_TRACE, "fragment table is full, evicting datagram 0x%x", table->datagrams[victim].identification);
+
+        network_ipv4_fragment_discard(victim);
+        network_ipv4_fragment_stats.evicted++;
+    }
+
+    uint16_t idx = table->free_head;
+    network_ipv4_fragment_datagram_t* datagram = &table->datagrams[idx];
+    uint16_t bucket = network_ipv4_fragment_hash(header);
+
+    table->free_head = datagram->hash_next;
+
+    datagram->in_use = true;
+    datagram->source_ip = header->source_ip;
+    datagram->destination_ip = header->destination_ip;
+    datagram->identification = header->identification;
+    datagram->protocol = header->protocol;
+    datagram->deadline = now + network_ipv4_fragment_config.timeout_ms;
+    datagram->total_length = 0;
+    datagram->received_end = 0;
+    datagram->memory = 0;
+    datagram->fragment_count = 0;
+    datagram->hole_count = 1;
+    datagram->holes[0].first = 0;
+    datagram->holes[0].last = NETWORK_IPV4_FRAGMENT_INFINITY;
+
+    datagram->hash_next = table->buckets[bucket];
+    table->buckets[bucket] = idx;
+
+    network_ipv4_fragment_wheel_link(idx);
+
+    network_ipv4_fragment_stats.datagrams++;
+
+    return idx;
+}
+
+static network_packet_t* network_ipv4_fragment_build(uint16_t idx, const network_packet_t* last_fragment) {
+    network_ipv4_fragment_datagram_t* datagram = &network_ipv4_fragment_table->datagrams[idx];
+
+    // reassembled datagram may be larger than pool buffers
+    network_packet_t* packet = network_packet_alloc(NULL, datagram->total_length);
+    uint8_t* data = network_packet_put(packet, datagram->total_length);
+
+    if(data == NULL) {
+        network_packet_release(packet);
+        network_ipv4_fragment_discard(idx);
+
+        return NULL;
+    }
+
+    packet->network_type = last_fragment->network_type;
+    packet->network_info = last_fragment->network_info;
+    packet->return_queue = last_fragment->return_queue;
+    memory_memcopy(last_fragment->source_mac, packet->source_mac, sizeof(network_mac_address_t));
+
+    // overlapping bytes are written by the fragment which should win
+    boolean_t last_wins = network_ipv4_fragment_config.overlap_policy == NETWORK_IPV4_FRAGMENT_OVERLAP_LAST;
+
+    for(uint8_t i = 0; i < datagram->fragment_count; i++) {
+        uint8_t f = last_wins ? i : datagram->fragment_count - 1 - i;
+        const network_packet_t* fragment = datagram->fragments[f];
+
+        memory_memcopy(network_packet_data(fragment), data + datagram->offsets[f], fragment->length);
+    }
+
+    network_ipv4_fragment_discard(idx);
+    network_ipv4_fragment_stats.reassembled++;
+
+    return packet;
+}
+
+int8_t network_ipv4_fragment_init(const network_ipv4_fragment_config_t* config) {
+    if(network_ipv4_fragment_table == NULL) {
+        network_ipv4_fragment_table = memory_malloc(sizeof(network_ipv4_fragment_table_t));
+
+        if(network_ipv4_fragment_table == NULL) {
+            return -1;
+        }
+    } else {
+        for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS; i++) {
+            if(network_ipv4_fragment_table->datagrams[i].in_use) {
+                network_ipv4_fragment_discard(i);
+            }
+        }
+    }
+
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+
+    memory_memclean(table, sizeof(network_ipv4_fragment_table_t));
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS; i++) {
+        table->datagrams[i].hash_next = i + 1 < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS ? i + 1 : NETWORK_IPV4_FRAGMENT_NONE;
+    }
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_HASH_SIZE; i++) {
+        table->buckets[i] = NETWORK_IPV4_FRAGMENT_NONE;
+    }
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS; i++) {
+        table->wheel_heads[i] = NETWORK_IPV4_FRAGMENT_NONE;
+        table->wheel_tails[i] = NETWORK_IPV4_FRAGMENT_NONE;
+    }
+
+    table->free_head = 0;
+
+    memory_memclean(&network_ipv4_fragment_stats, sizeof(network_ipv4_fragment_stats_t));
+
+    network_ipv4_fragment_config.timeout_ms = NETWORK_IPV4_FRAGMENT_TIMEOUT_MS;
+    network_ipv4_fragment_config.memory_budget = NETWORK_IPV4_FRAGMENT_MEMORY_BUDGET;
+    network_ipv4_fragment_config.overlap_policy = NETWORK_IPV4_FRAGMENT_OVERLAP_DROP;
+
+    if(config) {
+        if(config->timeout_ms) {
+            network_ipv4_fragment_config.timeout_ms = config->timeout_ms;
+        }
+
+        if(config->memory_budget) {
+            network_ipv4_fragment_config.memory_budget = config->memory_budget;
+        }
+
+        network_ipv4_fragment_config.overlap_policy = config->overlap_policy;
+    }
+
+    return 0;
+}
+
+void network_ipv4_fragment_destroy(void) {
+    if(network_ipv4_fragment_table == NULL) {
+        return;
+    }
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS; i++) {
+        if(network_ipv4_fragment_table->datagrams[i].in_use) {
+            network_ipv4_fragment_discard(i);
+        }
+    }
+
+    memory_free(network_ipv4_fragment_table);
+    network_ipv4_fragment_table = NULL;
+
+    network_ipv4_fragment_config.timeout_ms = NETWORK_IPV4_FRAGMENT_TIMEOUT_MS;
+    network_ipv4_fragment_config.memory_budget = NETWORK_IPV4_FRAGMENT_MEMORY_BUDGET;
+    network_ipv4_fragment_config.overlap_policy = NETWORK_IPV4_FRAGMENT_OVERLAP_DROP;
+}
+
+void network_ipv4_fragment_process_timers(uint64_t now) {
+    network_ipv4_fragment_table_t* table = network_ipv4_fragment_table;
+
+    if(table == NULL || network_ipv4_fragment_stats.datagrams == 0) {
+        if(table) {
+            table->wheel_tick = now / NETWORK_IPV4_FRAGMENT_WHEEL_TICK_MS;
+        }
+
+        return;
+    }
+
+    uint64_t tick = now / NETWORK_IPV4_FRAGMENT_WHEEL_TICK_MS;
+
+    if(tick < table->wheel_tick) {
+        return;
+    }
+
+    uint64_t steps = tick - table->wheel_tick + 1;
+
+    if(steps > NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS) {
+        steps = NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS;
+    }
+
+    for(uint64_t s = 0; s < steps; s++) {
+        uint64_t slot = (tick - s) % NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS;
+        uint16_t idx = table->wheel_heads[slot];
+
+        // entries of later wheel rounds stay at slot
+        while(idx != NETWORK_IPV4_FRAGMENT_NONE) {
+            uint16_t next = table->datagrams[idx].wheel_next;
+
+            if(table->datagrams[idx].deadline <= now) {
+                PRINTLOG(NETWORK, LOG_TRACE, "reassembly of datagram 0x%x timed out", table->datagrams[idx].identification);
+
+                network_ipv4_fragment_discard(idx);
+                network_ipv4_fragment_stats.timed_out++;
+            }
+
+            idx = next;
+        }
+    }
+
+    table->wheel_tick = tick;
+}
+
+void network_ipv4_fragment_get_stats(network_ipv4_fragment_stats_t* stats) {
+    if(stats) {
+        memory_memcopy(&network_ipv4_fragment_stats, stats, sizeof(network_ipv4_fragment_stats_t));
+    }
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+network_packet_t* network_ipv4_fragment_input(network_packet_t* packet, const network_ipv4_header_t* header, uint64_t now) {
+    if(packet == NULL || header == NULL) {
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    if(network_ipv4_fragment_table == NULL && network_ipv4_fragment_init(NULL) != 0) {
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    network_ipv4_fragment_process_timers(now);
+
+    network_ipv4_fragment_stats.fragments++;
+
+    uint32_t offset = (uint32_t)header->flags_fragment_offset.fields.fragment_offset << 3;
+    uint32_t len = packet->length;
+    uint32_t end = offset + len;
+    boolean_t more_fragments = (header->flags_fragment_offset.fields.flags & NETWORK_IPV4_FLAG_MORE_FRAGMENTS) != 0;
+
+    // all fragments except last carry multiple of 8 bytes, datagram fits to total length field
+    if(len == 0 || (more_fragments && (len & 7)) || end > 0xFFFFU - header->header_length * 4U) {
+        PRINTLOG(NETWORK, LOG_TRACE, "malformed fragment offset %i len %i", offset, len);
+        network_ipv4_fragment_stats.malformed++;
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    uint16_t idx = network_ipv4_fragment_find(header);
+
+    if(idx == NETWORK_IPV4_FRAGMENT_NONE) {
+        idx = network_ipv4_fragment_create(header, now);
+    }
+
+    network_ipv4_fragment_datagram_t* datagram = &network_ipv4_fragment_table->datagrams[idx];
+
+    if((datagram->total_length && end > datagram->total_length) ||
+       (!more_fragments && ((datagram->total_length && datagram->total_length != end) || datagram->received_end > end))) {
+        PRINTLOG(NETWORK, LOG_TRACE, "fragment of datagram 0x%x disagrees with its length", header->identification);
+        network_ipv4_fragment_stats.malformed++;
+        network_ipv4_fragment_discard(idx);
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    uint32_t fresh = 0;
+
+    for(uint8_t i = 0; i < datagram->hole_count; i++) {
+        uint32_t first = MAX(offset, datagram->holes[i].first);
+        uint32_t last = MIN(end - 1, datagram->holes[i].last);
+
+        if(first <= last) {
+            fresh += last - first + 1;
+        }
+    }
+
+    // last fragment gives total length even if it brings no new byte, it closes trailing hole
+    boolean_t closes_tail = !more_fragments && datagram->total_length == 0;
+
+    if(fresh != len) {
+        for(uint8_t i = 0; i < datagram->fragment_count && !closes_tail; i++) {
+            if(datagram->offsets[i] == offset && datagram->fragments[i]->length == len) {
+                // network duplicated it, same bytes
+                network_ipv4_fragment_stats.duplicates++;
+                network_packet_release(packet);
+
+                return NULL;
+            }
+        }
+
+        network_ipv4_fragment_stats.overlaps++;
+
+        if(network_ipv4_fragment_config.overlap_policy == NETWORK_IPV4_FRAGMENT_OVERLAP_DROP) {
+            PRINTLOG(NETWORK, LOG_TRACE, "overlapping fragment, datagram 0x%x is dropped", header->identification);
+            network_ipv4_fragment_discard(idx);
+            network_packet_release(packet);
+
+            return NULL;
+        }
+
+        if(fresh == 0 && !closes_tail && network_ipv4_fragment_config.overlap_policy == NETWORK_IPV4_FRAGMENT_OVERLAP_FIRST) {
+            network_packet_release(packet);
+
+            return NULL;
+        }
+    }
+
+    // rfc 815, fragment splits each hole it touches into the parts before and after it
+    network_ipv4_fragment_hole_t holes[NETWORK_IPV4_FRAGMENT_MAX_HOLES * 2];
+    uint8_t hole_count = 0;
+
+    for(uint8_t i = 0; i < datagram->hole_count; i++) {
+        const network_ipv4_fragment_hole_t* hole = &datagram->holes[i];
+
+        if(offset > hole->last || end - 1 < hole->first) {
+            // holes after end of last fragment are out of datagram
+            if(more_fragments || hole->first < end) {
+                holes[hole_count++] = *hole;
+            }
+
+            continue;
+        }
+
+        if(offset > hole->first) {
+            holes[hole_count].first = hole->first;
+            holes[hole_count++].last = offset - 1;
+        }
+
+        if(end - 1 < hole->last && more_fragments) {
+            holes[hole_count].first = end;
+            holes[hole_count++].last = hole->last;
+        }
+    }
+
+    if(hole_count > NETWORK_IPV4_FRAGMENT_MAX_HOLES || datagram->fragment_count == NETWORK_IPV4_FRAGMENT_MAX_FRAGMENTS) {
+        PRINTLOG(NETWORK, LOG_TRACE, "datagram 0x%x has too many holes or fragments", header->identification);
+        network_ipv4_fragment_stats.malformed++;
+        network_ipv4_fragment_discard(idx);
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    uint64_t cost = packet->capacity + sizeof(network_packet_t);
+
+    while(network_ipv4_fragment_stats.memory_used + cost > network_ipv4_fragment_config.memory_budget) {
+        uint16_t victim = network_ipv4_fragment_oldest(idx);
+
+        if(victim == NETWORK_IPV4_FRAGMENT_NONE) {
+            // datagram alone does not fit
+            victim = idx;
+        }
+
+        PRINTLOG(NETWORK, LOG_TRACE, "fragment memory is full, evicting datagram 0x%x", network_ipv4_fragment_table->datagrams[victim].identification);
+
+        network_ipv4_fragment_discard(victim);
+        network_ipv4_fragment_stats.evicted++;
+
+        if(victim == idx) {
+            network_packet_release(packet);
+
+            return NULL;
+        }
+    }
+
+    memory_memcopy(holes, datagram->holes, sizeof(network_ipv4_fragment_hole_t) * hole_count);
+    datagram->hole_count = hole_count;
+
+    datagram->fragments[datagram->fragment_count] = packet;
+    datagram->offsets[datagram->fragment_count] = offset;
+    datagram->fragment_count++;
+
+    datagram->memory += cost;
+    network_ipv4_fragment_stats.memory_used += cost;
+
+    if(end > datagram->received_end) {
+        datagram->received_end = end;
+    }
+
+    if(!more_fragments) {
+        datagram->total_length = end;
+    }
+
+    if(datagram->hole_count) {
+        return NULL;
+    }
+
+    return network_ipv4_fragment_build(idx, packet);
+}
+#pragma GCC diagnostic pop
@@ -0,0 +1,261 @@
+/**
+ * @file network_packet.64.c
+ * @brief network packet buffer and pool implementation.
+ *
+ * pool packets and buffers are carved from two allocations at creation. free packets form a treiber
+ * stack linked by indexes, head keeps a change tag at upper half against aba, so nic tasks allocate and
+ * protocol or tx tasks release concurrently without locks.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_packet.h>
+#include <memory.h>
+#include <logging.h>
+#include <utils.h>
+
+MODULE("turnstone.lib.network");
+
+/*! free list end marker */
+#define NETWORK_PACKET_POOL_FREE_LIST_END 0xFFFFFFFFULL
+
+struct network_packet_pool_t {
+    memory_heap_t*    heap; ///< heap of pool allocations
+    uint64_t          count; ///< packet count
+    uint32_t          buffer_size; ///< buffer size of each packet
+    network_packet_t* packets; ///< packet headers
+    uint8_t*          buffers; ///< packet buffers
+    uint32_t*         next_free; ///< next free packet index of each packet
+    volatile uint64_t free_count; ///< free packet count
+    volatile uint64_t free_head __attribute__((aligned(64))); ///< tag << 32 | first free packet index
+} __attribute__((aligned(64)));
+
+network_packet_pool_t* network_packet_pool_create(memory_heap_t* heap, uint64_t count, uint32_t buffer_size) {
+    if(count == 0 || count >= NETWORK_PACKET_POOL_FREE_LIST_END || buffer_size <= NETWORK_PACKET_HEADROOM) {
+        return NULL;
+    }
+
+    network_packet_pool_t* pool = memory_malloc_ext(heap, sizeof(network_packet_pool_t), 64);
+
+    if(pool == NULL) {
+        return NULL;
+    }
+
+    pool->heap = heap;
+    pool->count = count;
+    pool->buffer_size = buffer_size;
+    pool->packets = memory_malloc_ext(heap, sizeof(network_packet_t) * count, 0);
+    pool->buffers = memory_malloc_ext(heap, (uint64_t)buffer_size * count, 64);
+    pool->next_free = memory_malloc_ext(heap, sizeof(uint32_t) * count, 0);
+
+    if(pool->packets == NULL || pool->buffers == NULL || pool->next_free == NULL) {
+        memory_free_ext(heap, pool->packets);
+        memory_free_ext(heap, pool->buffers);
+        memory_free_ext(heap, pool->next_free);
+        memory_free_ext(heap, pool);
+
+        return NULL;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        network_packet_t* packet = &pool->packets[i];
+
+        packet->pool = pool;
+        packet->buffer = pool->buffers + i * buffer_size;
+        packet->capacity = buffer_size;
+
+        pool->next_free[i] = (i + 1 == count)?NETWORK_PACKET_POOL_FREE_LIST_END:(i + 1);
+    }
+
+    pool->free_count = count;
+    pool->free_head = 0;
+
+    PRINTLOG(NETWORK, LOG_TRACE, "packet pool with 0x%llx packets of 0x%x bytes created", count, buffer_size);
+
+    return pool;
+}
+
+int8_t network_packet_pool_destroy(network_packet_pool_t* pool) {
+    if(pool == NULL) {
+        return -1;
+    }
+
+    if(pool->free_count != pool->count) {
+        PRINTLOG(NETWORK, LOG_WARNING, "packet pool destroyed with 0x%llx packets in use", pool->count - pool->free_count);
+    }
+
+    memory_heap_t* heap = pool->heap;
+
+    memory_free_ext(heap, pool->packets);
+    memory_free_ext(heap, pool->buffers);
+    memory_free_ext(heap, pool->next_free);
+    memory_free_ext(heap, pool);
+
+    return 0;
+}
+
+uint64_t network_packet_pool_get_free_count(network_packet_pool_t* pool) {
+    if(pool == NULL) {
+        return 0;
+    }
+
+    return __atomic_load_n(&pool->free_count, __ATOMIC_RELAXED);
+}
+
+static network_packet_t* network_packet_pool_pop(network_packet_pool_t* pool) {
+    uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+
+    while(true) {
+        uint64_t idx = head & NETWORK_PACKET_POOL_FREE_LIST_END;
+
+        if(idx == NETWORK_PACKET_POOL_FREE_LIST_END) {
+            return NULL;
+        }
+
+        uint64_t next = __atomic_load_n(&pool->next_free[idx], __ATOMIC_RELAXED);
+        uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+
+        if(__atomic_compare_exchange_n(&pool->free_head, &head, new_head, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_sub_fetch(&pool->free_count, 1, __ATOMIC_RELAXED);
+
+            return &pool->packets[idx];
+        }
+    }
+}
+
+static void network_packet_pool_push(network_packet_pool_t* pool, network_packet_t* packet) {
+    uint64_t idx = packet - pool->packets;
+    uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+
+    while(true) {
+        __atomic_store_n(&pool->next_free[idx], (uint32_t)(head & NETWORK_PACKET_POOL_FREE_LIST_END), __ATOMIC_RELAXED);
+
+        uint64_t new_head = (((head >> 32) + 1) << 32) | idx;
+
+        if(__atomic_compare_exchange_n(&pool->free_head, &head, new_head, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            __atomic_add_fetch(&pool->free_count, 1, __ATOMIC_RELAXED);
+
+            return;
+        }
+    }
+}
+
+network_packet_t* network_packet_alloc(network_packet_pool_t* pool, uint32_t size) {
+    network_packet_t* packet = NULL;
+
+    if(pool != NULL && size <= pool->buffer_size - NETWORK_PACKET_HEADROOM) {
+        packet = network_packet_pool_pop(pool);
+
+        if(packet == NULL) {
+            PRINTLOG(NETWORK, LOG_TRACE, "packet pool is exhausted");
+
+            return NULL;
+        }
+    } else {
+        uint32_t capacity = NETWORK_PACKET_HEADROOM + size;
+
+        packet = memory_malloc(sizeof(network_packet_t) + capacity);
+
+        if(packet == NULL) {
+            return NULL;
+        }
+
+        packet->buffer = (uint8_t*)(packet + 1);
+        packet->capacity = capacity;
+    }
+
+    packet->next = NULL;
+    packet->offset = NETWORK_PACKET_HEADROOM;
+    packet->length = 0;
+    packet->ref_count = 1;
+    packet->network_type = NETWORK_TYPE_ETHERNET;
+    packet->network_info = NULL;
+    packet->return_queue = NULL;
+    packet->checksum_flags = 0;
+
+    return packet;
+}
+
+network_packet_t* network_packet_ref(network_packet_t* packet) {
+    if(packet != NULL) {
+        __atomic_add_fetch(&packet->ref_count, 1, __ATOMIC_RELAXED);
+    }
+
+    return packet;
+}
+
+int8_t network_packet_release(network_packet_t* packet) {
+    if(packet == NULL) {
+        return -1;
+    }
+
+    if(__atomic_sub_fetch(&packet->ref_count, 1, __ATOMIC_ACQ_REL) != 0) {
+        return 0;
+    }
+
+    if(packet->pool != NULL) {
+        network_packet_pool_push(packet->pool, packet);
+    } else {
+        memory_free(packet);
+    }
+
+    return 0;
+}
+
+int8_t network_packet_release_chain(network_packet_t* packet) {
+    while(packet != NULL) {
+        network_packet_t* next = packet->next;
+
+        packet->next = NULL;
+        network_packet_release(packet);
+
+        packet = next;
+    }
+
+    return 0;
+}
+
+uint8_t* network_packet_push(network_packet_t* packet, uint32_t len) {
+    if(packet == NULL || packet->offset < len) {
+        return NULL;
+    }
+
+    packet->offset -= len;
+    packet->length += len;
+
+    return packet->buffer + packet->offset;
+}
+
+uint8_t* network_packet_pull(network_packet_t* packet, uint32_t len) {
+    if(packet == NULL || packet->length < len) {
+        return NULL;
+    }
+
+    packet->offset += len;
+    packet->length -= len;
+
+    return packet->buffer + packet->offset;
+}
+
+uint8_t* network_packet_put(network_packet_t* packet, uint32_t len) {
+    if(packet == NULL || network_packet_tailroom(packet) < len) {
+        return NULL;
+    }
+
+    uint8_t* tail = packet->buffer + packet->offset + packet->length;
+
+    packet->length += len;
+
+    return tail;
+}
+
+int8_t network_packet_trim(network_packet_t* packet, uint32_t len) {
+    if(packet == NULL || packet->length < len) {
+        return -1;
+    }
+
+    packet->length = len;
+
+    return 0;
+}
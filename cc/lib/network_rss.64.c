@@ -0,0 +1,112 @@
+/**
+ * @file network_rss.64.c
+ * @brief Receive side scaling implementation.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_rss.h>
+#include <network/network_ethernet.h>
+#include <network/network_ipv4.h>
+#include <memory.h>
+#include <utils.h>
+
+MODULE("turnstone.lib.network");
+
+const uint8_t network_rss_default_key[NETWORK_RSS_KEY_SIZE] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+uint32_t network_rss_toeplitz(const uint8_t* key, const uint8_t* input, uint32_t len) {
+    uint32_t hash = 0;
+    // upper half is the 32 bit key window of current input bit, lower half holds next key byte
+    uint64_t window = ((uint64_t)key[0] << 32) | ((uint64_t)key[1] << 24) | ((uint64_t)key[2] << 16) |
+                      ((uint64_t)key[3] << 8) | key[4];
+
+    for(uint32_t i = 0; i < len; i++) {
+        uint8_t byte = input[i];
+
+        for(int32_t bit = 7; bit >= 0; bit--) {
+            if(byte & (1 << bit)) {
+                hash ^= window >> 8;
+            }
+
+            window <<= 1;
+        }
+
+        // next key byte slides in after eight shifts
+        window = (window & ~0xFFULL) | key[i + 5];
+    }
+
+    return hash;
+}
+
+uint32_t network_rss_hash_ipv4(const uint8_t* key, network_ipv4_address_t sip, network_ipv4_address_t dip,
+                               uint16_t sport, uint16_t dport, boolean_t with_ports) {
+    uint8_t input[12];
+
+    memory_memcopy(sip.as_bytes, input, sizeof(network_ipv4_address_t));
+    memory_memcopy(dip.as_bytes, input + 4, sizeof(network_ipv4_address_t));
+
+    if(!with_ports) {
+        return network_rss_toeplitz(key, input, 8);
+    }
+
+    input[8] = sport >> 8;
+    input[9] = sport & 0xFF;
+    input[10] = dport >> 8;
+    input[11] = dport & 0xFF;
+
+    return network_rss_toeplitz(key, input, sizeof(input));
+}
+
+uint32_t network_rss_hash_frame(const uint8_t* key, const uint8_t* frame, uint32_t len) {
+    if(len < sizeof(network_ethernet_t) + sizeof(network_ipv4_header_t)) {
+        return 0;
+    }
+
+    // bytes are read directly, header bitfields are in network order
+    if(frame[12] != (NETWORK_ETHERNET_TYPE_IPV4 >> 8) || frame[13] != (NETWORK_ETHERNET_TYPE_IPV4 & 0xFF)) {
+        return 0;
+    }
+
+    const uint8_t* ip = frame + sizeof(network_ethernet_t);
+    uint32_t header_length = (ip[0] & 0xF) * 4;
+    network_ipv4_address_t sip;
+    network_ipv4_address_t dip;
+
+    memory_memcopy(ip + 12, sip.as_bytes, sizeof(network_ipv4_address_t));
+    memory_memcopy(ip + 16, dip.as_bytes, sizeof(network_ipv4_address_t));
+
+    // fragments have no ports except the first one, all fragments hash with addresses only
+    boolean_t fragment = (ip[6] & 0x3F) || ip[7];
+    boolean_t with_ports = !fragment && (ip[9] == NETWORK_IPV4_PROTOCOL_TCPV4 || ip[9] == NETWORK_IPV4_PROTOCOL_UDPV4) &&
+                           sizeof(network_ethernet_t) + header_length + 4 <= len;
+
+    if(!with_ports) {
+        return network_rss_hash_ipv4(key, sip, dip, 0, 0, false);
+    }
+
+    const uint8_t* l4 = ip + header_length;
+
+    return network_rss_hash_ipv4(key, sip, dip, (l4[0] << 8) | l4[1], (l4[2] << 8) | l4[3], true);
+}
+
+void network_rss_fill_reta(uint8_t* reta, uint32_t reta_size, uint32_t queue_count) {
+    if(queue_count == 0) {
+        queue_count = 1;
+    }
+
+    for(uint32_t i = 0; i < reta_size; i++) {
+        reta[i] = i % queue_count;
+    }
+}
+
+uint8_t network_rss_queue(const uint8_t* reta, uint32_t reta_size, uint32_t hash) {
+    return reta[hash & (reta_size - 1)];
+}
@@ -0,0 +1,679 @@
+/**
+ * @file network_socket.64.c
+ * @brief Network socket implementation.
+ *
+ * stream sockets own a tcp listener or connection, their state is guarded by tcp lock. tcp notifies owner
+ * sockets after each event and when it frees a connection. datagram sockets keep copies of received
+ * datagrams, their state and port table are guarded by socket lock. a waiting task is woken by the
+ * notification of any socket it polls.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_socket.h>
+#include <network/network_info.h>
+#include <network/network_ipv4.h>
+#include <network/network_udpv4.h>
+#include <network/network_ethernet.h>
+#include <cpu/sync.h>
+#include <hashmap.h>
+#include <memory.h>
+#include <logging.h>
+#include <time.h>
+#include <utils.h>
+
+MODULE("turnstone.lib.network");
+
+/*! received datagram, payload follows it */
+typedef struct network_socket_datagram_t {
+    network_socket_address_t from;
+    uint16_t                 length;
+    uint8_t                  data[];
+} network_socket_datagram_t;
+
+struct network_socket_t {
+    network_socket_type_t       type;
+    network_ipv4_address_t      local_ip;
+    uint16_t                    local_port;
+    boolean_t                   bound;
+    boolean_t                   connected; ///< stream socket got a connection by connect or accept
+    boolean_t                   detached; ///< tcp freed connection after reset or timeout
+    network_tcpv4_listener_t*   listener;
+    network_tcpv4_connection_t* connection;
+    network_socket_address_t    peer; ///< default destination of datagram socket
+    boolean_t                   has_peer;
+    list_t*                     datagrams;
+    volatile uint64_t           waiter_task_id;
+};
+
+static lock_t* network_socket_lock = NULL;
+static hashmap_t* network_socket_udp_ports = NULL;
+static uint16_t network_socket_next_tcp_port = NETWORK_SOCKET_EPHEMERAL_PORT_START;
+static uint16_t network_socket_next_udp_port = NETWORK_SOCKET_EPHEMERAL_PORT_START;
+
+static void network_socket_wake(network_socket_t* socket) {
+    uint64_t waiter_task_id = __atomic_load_n(&socket->waiter_task_id, __ATOMIC_SEQ_CST);
+
+    if(waiter_task_id && future_task_waker_func) {
+        future_task_waker_func(waiter_task_id);
+    }
+}
+
+static void network_socket_tcp_notify(void* owner, boolean_t detached) {
+    network_socket_t* socket = owner;
+
+    if(detached) {
+        socket->connection = NULL;
+        socket->detached = true;
+    }
+
+    network_socket_wake(socket);
+}
+
+static boolean_t network_socket_udp_receive(network_packet_t* packet, network_ipv4_address_t dip, network_ipv4_address_t sip, uint16_t dport, uint16_t sport) {
+    lock_acquire(network_socket_lock);
+
+    network_socket_t* socket = (network_socket_t*)hashmap_get(network_socket_udp_ports, (void*)(uint64_t)dport);
+
+    if(socket == NULL || (socket->local_ip.as_dword && socket->local_ip.as_dword != dip.as_dword)) {
+        lock_release(network_socket_lock);
+
+        return false;
+    }
+
+    if(list_size(socket->datagrams) >= NETWORK_SOCKET_UDP_QUEUE_LIMIT) {
+        lock_release(network_socket_lock);
+        network_packet_release(packet);
+
+        PRINTLOG(NETWORK, LOG_TRACE, "datagram queue of port %i is full", dport);
+
+        return true;
+    }
+
+    // payload is copied, pool packets return to nic at once
+    network_socket_datagram_t* datagram = memory_malloc(sizeof(network_socket_datagram_t) + packet->length);
+
+    if(datagram) {
+        datagram->from.ip = sip;
+        datagram->from.port = sport;
+        datagram->from.route.network_info = packet->network_info;
+        datagram->from.route.return_queue = packet->return_queue;
+        datagram->from.route.pool = packet->pool;
+        memory_memcopy(packet->source_mac, datagram->from.route.next_hop_mac, sizeof(network_mac_address_t));
+        datagram->length = packet->length;
+        memory_memcopy(network_packet_data(packet), datagram->data, packet->length);
+
+        if(list_queue_push(socket->datagrams, datagram) == -1ULL) {
+            memory_free(datagram);
+        } else {
+            network_socket_wake(socket);
+        }
+    }
+
+    lock_release(network_socket_lock);
+
+    network_packet_release(packet);
+
+    return true;
+}
+
+int8_t network_socket_init(void) {
+    if(network_socket_lock == NULL) {
+        network_socket_lock = lock_create();
+    }
+
+    if(network_socket_udp_ports == NULL) {
+        network_socket_udp_ports = hashmap_integer(128);
+    }
+
+    if(network_socket_lock == NULL || network_socket_udp_ports == NULL || network_tcpv4_init() != 0) {
+        return -1;
+    }
+
+    network_tcpv4_set_notify(&network_socket_tcp_notify);
+    network_udpv4_set_receiver(&network_socket_udp_receive);
+
+    return 0;
+}
+
+void network_socket_destroy(void) {
+    network_tcpv4_set_notify(NULL);
+    network_udpv4_set_receiver(NULL);
+
+    hashmap_destroy(network_socket_udp_ports);
+    network_socket_udp_ports = NULL;
+
+    lock_destroy(network_socket_lock);
+    network_socket_lock = NULL;
+}
+
+network_socket_t* network_socket_create(network_socket_type_t type) {
+    network_socket_t* socket = memory_malloc(sizeof(network_socket_t));
+
+    if(socket == NULL) {
+        return NULL;
+    }
+
+    socket->type = type;
+
+    if(type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        socket->datagrams = list_create_queue();
+
+        if(socket->datagrams == NULL) {
+            memory_free(socket);
+
+            return NULL;
+        }
+    }
+
+    return socket;
+}
+
+static uint16_t network_socket_tcp_ephemeral_port(network_ipv4_address_t ip) {
+    for(uint32_t i = 0; i < 0x10000 - NETWORK_SOCKET_EPHEMERAL_PORT_START; i++) {
+        uint16_t port = network_socket_next_tcp_port++;
+
+        if(network_socket_next_tcp_port == 0) {
+            network_socket_next_tcp_port = NETWORK_SOCKET_EPHEMERAL_PORT_START;
+        }
+
+        if(network_tcpv4_listener_get(ip, port) == NULL) {
+            return port;
+        }
+    }
+
+    return 0;
+}
+
+static uint16_t network_socket_udp_ephemeral_port(void) {
+    for(uint32_t i = 0; i < 0x10000 - NETWORK_SOCKET_EPHEMERAL_PORT_START; i++) {
+        uint16_t port = network_socket_next_udp_port++;
+
+        if(network_socket_next_udp_port == 0) {
+            network_socket_next_udp_port = NETWORK_SOCKET_EPHEMERAL_PORT_START;
+        }
+
+        if(hashmap_get(network_socket_udp_ports, (void*)(uint64_t)port) == NULL) {
+            return port;
+        }
+    }
+
+    return 0;
+}
+
+static int8_t network_socket_udp_bind(network_socket_t* socket, network_ipv4_address_t ip, uint16_t port) {
+    lock_acquire(network_socket_lock);
+
+    if(port == 0) {
+        port = network_socket_udp_ephemeral_port();
+    }
+
+    if(port == 0 || hashmap_get(network_socket_udp_ports, (void*)(uint64_t)port) != NULL) {
+        lock_release(network_socket_lock);
+
+        return -1;
+    }
+
+    hashmap_put(network_socket_udp_ports, (void*)(uint64_t)port, socket);
+
+    socket->local_ip = ip;
+    socket->local_port = port;
+    socket->bound = true;
+
+    lock_release(network_socket_lock);
+
+    return 0;
+}
+
+int8_t network_socket_bind(network_socket_t* socket, network_ipv4_address_t ip, uint16_t port) {
+    if(socket == NULL || socket->bound) {
+        return -1;
+    }
+
+    if(socket->type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        return network_socket_udp_bind(socket, ip, port);
+    }
+
+    network_tcpv4_lock();
+
+    if(port == 0) {
+        port = network_socket_tcp_ephemeral_port(ip);
+    }
+
+    const network_tcpv4_listener_t* listener = network_tcpv4_listener_get(ip, port);
+
+    if(port == 0 || (listener && network_ipv4_is_address_eq(listener->local_ip, ip))) {
+        network_tcpv4_unlock();
+
+        return -1;
+    }
+
+    socket->local_ip = ip;
+    socket->local_port = port;
+    socket->bound = true;
+
+    network_tcpv4_unlock();
+
+    return 0;
+}
+
+int8_t network_socket_listen(network_socket_t* socket, uint32_t backlog) {
+    if(socket == NULL || socket->type != NETWORK_SOCKET_TYPE_STREAM || !socket->bound || socket->connected || socket->listener) {
+        return -1;
+    }
+
+    network_tcpv4_lock();
+
+    socket->listener = network_tcpv4_listen(socket->local_ip, socket->local_port, backlog);
+
+    if(socket->listener) {
+        socket->listener->owner = socket;
+    }
+
+    network_tcpv4_unlock();
+
+    return socket->listener ? 0 : -1;
+}
+
+network_socket_t* network_socket_accept(network_socket_t* socket) {
+    if(socket == NULL || socket->listener == NULL) {
+        return NULL;
+    }
+
+    network_socket_t* accepted = network_socket_create(NETWORK_SOCKET_TYPE_STREAM);
+
+    if(accepted == NULL) {
+        return NULL;
+    }
+
+    network_tcpv4_lock();
+
+    // owner is set before tcp can free connection
+    network_tcpv4_connection_t* connection = network_tcpv4_accept(socket->listener);
+
+    if(connection) {
+        connection->owner = accepted;
+        accepted->connection = connection;
+        accepted->connected = true;
+        accepted->bound = true;
+        accepted->local_ip = connection->local_ip;
+        accepted->local_port = connection->local_port;
+        accepted->peer.ip = connection->remote_ip;
+        accepted->peer.port = connection->remote_port;
+    }
+
+    network_tcpv4_unlock();
+
+    if(connection == NULL) {
+        memory_free(accepted);
+
+        return NULL;
+    }
+
+    return accepted;
+}
+
+static network_ipv4_address_t network_socket_source_ip(const network_socket_t* socket, const network_socket_route_t* route) {
+    network_ipv4_address_t ip = socket->local_ip;
+
+    if(ip.as_dword == 0 && network_info_map && route->network_info) {
+        const network_info_t* ni = map_get(network_info_map, route->network_info);
+
+        if(ni && ni->is_ipv4_address_set) {
+            ip = ni->ipv4_address;
+        }
+    }
+
+    return ip;
+}
+
+int8_t network_socket_connect(network_socket_t* socket, const network_socket_address_t* address) {
+    if(socket == NULL || address == NULL) {
+        return -1;
+    }
+
+    if(socket->type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        if(!socket->bound && network_socket_udp_bind(socket, socket->local_ip, 0) != 0) {
+            return -1;
+        }
+
+        socket->peer = *address;
+        socket->has_peer = true;
+
+        return 0;
+    }
+
+    if(socket->connected || socket->listener) {
+        return -1;
+    }
+
+    network_ipv4_address_t local_ip = network_socket_source_ip(socket, &address->route);
+
+    if(local_ip.as_dword == 0) {
+        return -1;
+    }
+
+    network_tcpv4_lock();
+
+    uint16_t local_port = socket->bound ? socket->local_port : network_socket_tcp_ephemeral_port(local_ip);
+    network_tcpv4_connection_t* connection = NULL;
+
+    if(local_port) {
+        connection = network_tcpv4_connect(address->route.network_info, address->route.return_queue, (uint8_t*)address->route.next_hop_mac,
+                                           address->route.pool, local_ip, local_port, address->ip, address->port);
+    }
+
+    if(connection) {
+        connection->owner = socket;
+        socket->connection = connection;
+        socket->connected = true;
+        socket->bound = true;
+        socket->local_ip = local_ip;
+        socket->local_port = local_port;
+        socket->peer = *address;
+    }
+
+    network_tcpv4_unlock();
+
+    return connection ? 0 : -1;
+}
+
+int64_t network_socket_send(network_socket_t* socket, const void* data, uint64_t len) {
+    if(socket == NULL || data == NULL) {
+        return -1;
+    }
+
+    if(socket->type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        if(!socket->has_peer) {
+            return -1;
+        }
+
+        return network_socket_sendto(socket, data, len, &socket->peer);
+    }
+
+    network_tcpv4_lock();
+
+    int64_t res = -1;
+
+    if(socket->connection) {
+        res = network_tcpv4_send(socket->connection, data, len);
+    }
+
+    network_tcpv4_unlock();
+
+    return res;
+}
+
+int64_t network_socket_recv(network_socket_t* socket, void* data, uint64_t len) {
+    if(socket == NULL || data == NULL) {
+        return -1;
+    }
+
+    if(socket->type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        int64_t res = network_socket_recvfrom(socket, data, len, NULL);
+
+        return res == -1 ? 0 : res;
+    }
+
+    network_tcpv4_lock();
+
+    int64_t res = -1;
+
+    if(socket->connection) {
+        res = network_tcpv4_recv(socket->connection, data, len);
+    }
+
+    network_tcpv4_unlock();
+
+    return res;
+}
+
+int64_t network_socket_sendto(network_socket_t* socket, const void* data, uint64_t len, const network_socket_address_t* address) {
+    if(socket == NULL || socket->type != NETWORK_SOCKET_TYPE_DATAGRAM || address == NULL || len > NETWORK_SOCKET_UDP_MAX_PAYLOAD) {
+        return -1;
+    }
+
+    if(address->route.network_info == NULL || address->route.return_queue == NULL) {
+        return -1;
+    }
+
+    if(!socket->bound && network_socket_udp_bind(socket, socket->local_ip, 0) != 0) {
+        return -1;
+    }
+
+    network_ipv4_address_t sip = network_socket_source_ip(socket, &address->route);
+    network_packet_t* packet = network_packet_alloc(address->route.pool, sizeof(network_udpv4_header_t) + len);
+
+    if(packet == NULL) {
+        return -1;
+    }
+
+    uint8_t* payload = network_packet_put(packet, len);
+
+    memory_memcopy(data, payload, len);
+
+    packet->network_info = address->route.network_info;
+
+    if(network_udpv4_push_header(packet, sip, address->ip, socket->local_port, address->port) != 0) {
+        network_packet_release(packet);
+
+        return -1;
+    }
+
+    network_packet_t* packets = network_ipv4_output(packet, sip, address->ip, NETWORK_IPV4_PROTOCOL_UDPV4);
+
+    for(packet = packets; packet; packet = packet->next) {
+        if(network_ethernet_push_header(packet, (uint8_t*)address->route.next_hop_mac, address->route.network_info, NETWORK_ETHERNET_TYPE_IPV4) != 0) {
+            network_packet_release_chain(packets);
+
+            return -1;
+        }
+    }
+
+    // fragments of a datagram are queued together, a full queue is reported to caller
+    if(network_tx_queue_push(address->route.return_queue, packets) != 0) {
+        network_packet_release_chain(packets);
+
+        return -1;
+    }
+
+    return len;
+}
+
+int64_t network_socket_recvfrom(network_socket_t* socket, void* data, uint64_t len, network_socket_address_t* address) {
+    if(socket == NULL || socket->type != NETWORK_SOCKET_TYPE_DATAGRAM || data == NULL) {
+        return -1;
+    }
+
+    lock_acquire(network_socket_lock);
+
+    network_socket_datagram_t* datagram = (network_socket_datagram_t*)list_queue_pop(socket->datagrams);
+
+    lock_release(network_socket_lock);
+
+    if(datagram == NULL) {
+        return -1;
+    }
+
+    if(len > datagram->length) {
+        len = datagram->length;
+    }
+
+    memory_memcopy(datagram->data, data, len);
+
+    if(address) {
+        *address = datagram->from;
+    }
+
+    memory_free(datagram);
+
+    return len;
+}
+
+int8_t network_socket_close(network_socket_t* socket) {
+    if(socket == NULL) {
+        return -1;
+    }
+
+    if(socket->type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        lock_acquire(network_socket_lock);
+
+        if(socket->bound) {
+            hashmap_delete(network_socket_udp_ports, (void*)(uint64_t)socket->local_port);
+        }
+
+        lock_release(network_socket_lock);
+
+        while(list_size(socket->datagrams)) {
+            memory_free((void*)list_queue_pop(socket->datagrams));
+        }
+
+        list_destroy(socket->datagrams);
+    } else {
+        network_tcpv4_lock();
+
+        if(socket->listener) {
+            network_tcpv4_unlisten(socket->listener);
+        }
+
+        if(socket->connection) {
+            socket->connection->owner = NULL;
+            network_tcpv4_close(socket->connection);
+        }
+
+        network_tcpv4_unlock();
+    }
+
+    memory_free(socket);
+
+    return 0;
+}
+
+static uint32_t network_socket_ready_events(network_socket_t* socket) {
+    uint32_t events = 0;
+
+    if(socket->type == NETWORK_SOCKET_TYPE_DATAGRAM) {
+        events = NETWORK_SOCKET_EVENT_WRITABLE;
+
+        if(list_size(socket->datagrams)) {
+            events |= NETWORK_SOCKET_EVENT_READABLE;
+        }
+
+        return events;
+    }
+
+    network_tcpv4_lock();
+
+    const network_tcpv4_connection_t* connection = socket->connection;
+
+    if(socket->listener) {
+        if(socket->listener->accept_head) {
+            events |= NETWORK_SOCKET_EVENT_READABLE;
+        }
+    } else if(connection) {
+        if(connection->recv_buffer.length || connection->fin_received) {
+            events |= NETWORK_SOCKET_EVENT_READABLE;
+        }
+
+        if(connection->fin_received) {
+            events |= NETWORK_SOCKET_EVENT_HUP;
+        }
+
+        if((connection->state == NETWORK_TCP_CONNECTION_STATE_ESTABLISHED || connection->state == NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT) &&
+           !connection->fin_queued && connection->send_buffer.length < connection->send_buffer.capacity) {
+            events |= NETWORK_SOCKET_EVENT_WRITABLE;
+        }
+    } else if(socket->detached) {
+        events |= NETWORK_SOCKET_EVENT_READABLE | NETWORK_SOCKET_EVENT_HUP | NETWORK_SOCKET_EVENT_ERROR;
+    }
+
+    network_tcpv4_unlock();
+
+    return events;
+}
+
+static int64_t network_socket_poll_check(network_socket_poll_t* fds, uint64_t count) {
+    int64_t ready = 0;
+
+    for(uint64_t i = 0; i < count; i++) {
+        uint32_t mask = fds[i].events | NETWORK_SOCKET_EVENT_HUP | NETWORK_SOCKET_EVENT_ERROR;
+
+        fds[i].revents = network_socket_ready_events(fds[i].socket) & mask;
+
+        if(fds[i].revents) {
+            ready++;
+        }
+    }
+
+    return ready;
+}
+
+int64_t network_socket_poll(network_socket_poll_t* fds, uint64_t count, uint64_t timeout_ms) {
+    if(fds == NULL || count == 0) {
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(fds[i].socket == NULL) {
+            return -1;
+        }
+    }
+
+    int64_t ready = network_socket_poll_check(fds, count);
+
+    if(ready || timeout_ms == 0) {
+        return ready;
+    }
+
+    uint64_t deadline = timeout_ms == NETWORK_SOCKET_POLL_FOREVER ? 0 : (uint64_t)time_ns(NULL) + timeout_ms * 1000000ULL;
+    uint64_t task_id = future_task_id_getter_func ? future_task_id_getter_func() : 0;
+    boolean_t can_park = task_id && future_task_wait_begin_func && future_task_wait_end_func && future_task_yielder_func;
+
+    if(can_park) {
+        for(uint64_t i = 0; i < count; i++) {
+            __atomic_store_n(&fds[i].socket->waiter_task_id, task_id, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    /*
+     * check runs while task is running, it takes tcp lock which can yield. a notification after check leaves its
+     * wake pending at task even if task is not parked yet, so parking after check does not lose it.
+     */
+    while(true) {
+        ready = network_socket_poll_check(fds, count);
+
+        if(ready) {
+            break;
+        }
+
+        uint64_t remaining_ms = 0;
+
+        if(deadline) {
+            uint64_t now = time_ns(NULL);
+
+            if(now >= deadline) {
+                break;
+            }
+
+            remaining_ms = (deadline - now + 999999ULL) / 1000000ULL;
+        }
+
+        if(can_park) {
+            future_task_wait_begin_func(remaining_ms);
+            future_task_yielder_func();
+        } else {
+            asm volatile ("pause" ::: "memory");
+        }
+    }
+
+    if(can_park) {
+        future_task_wait_end_func();
+
+        for(uint64_t i = 0; i < count; i++) {
+            __atomic_store_n(&fds[i].socket->waiter_task_id, 0, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    return ready;
+}
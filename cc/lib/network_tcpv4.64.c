@@ -2,62 +2,127 @@
  * @file network_tcpv4.64.c
  * @brief TCPv4 protocol implementation.
  *
+ * connections keep byte rings for send and receive sides. send ring starts at snd_una, so retransmissions
+ * read from it. out of order segments keep their packets until holes before them are filled, and they are
+ * reported to peer with sack blocks. sender keeps a sack scoreboard, loss recovery retransmits holes of it
+ * while pipe (rfc 6675) is under congestion window. rto follows rfc 6298 with karn's algorithm.
+ *
+ * network task and application tasks share state under tcp lock. segments answering a packet return to
+ * ipv4 layer, timer and application driven segments are pushed into return queue of connection's nic.
+ * listeners queue established passive connections until accept, sockets owning connections and listeners
+ * are notified after each event.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
 
 #include <network/network_tcpv4.h>
 #include <network/network_ipv4.h>
+#include <network/network_ethernet.h>
+#include <network/network_checksum.h>
 #include <utils.h>
 #include <memory.h>
 #include <logging.h>
 #include <time.h>
-#include <logging.h>
 #include <hashmap.h>
 #include <random.h>
 #include <strings.h>
+#include <cpu/sync.h>
 
 MODULE("turnstone.lib.network");
 
+#define NETWORK_TCPV4_SEQ_LT(a, b)  ((int32_t)((a) - (b)) < 0)
+#define NETWORK_TCPV4_SEQ_LEQ(a, b) ((int32_t)((a) - (b)) <= 0)
+#define NETWORK_TCPV4_SEQ_GT(a, b)  ((int32_t)((a) - (b)) > 0)
+#define NETWORK_TCPV4_SEQ_GEQ(a, b) ((int32_t)((a) - (b)) >= 0)
+
+#define NETWORK_TCPV4_OPTION_END            0
+#define NETWORK_TCPV4_OPTION_NOP            1
+#define NETWORK_TCPV4_OPTION_MSS            2
+#define NETWORK_TCPV4_OPTION_WINDOW_SCALE   3
+#define NETWORK_TCPV4_OPTION_SACK_PERMITTED 4
+#define NETWORK_TCPV4_OPTION_SACK           5
+
+/*! sack blocks sent in one segment, with nops they fill 28 bytes of options */
+#define NETWORK_TCPV4_SACK_BLOCKS_PER_SEGMENT 3
+/*! syn options: mss, nop + window scale, nop + nop + sack permitted */
+#define NETWORK_TCPV4_SYN_OPTIONS_LENGTH      12
+
+typedef struct network_tcpv4_options_t {
+    uint16_t                   mss;
+    uint8_t                    window_scale;
+    boolean_t                  window_scale_present;
+    boolean_t                  sack_permitted;
+    uint8_t                    sack_count;
+    network_tcpv4_sack_block_t sack[4];
+} network_tcpv4_options_t;
+
+/*! segments produced while handling an event */
+typedef struct network_tcpv4_segments_t {
+    network_packet_t* head;
+    network_packet_t* tail;
+} network_tcpv4_segments_t;
+
 hashmap_t* network_tcpv4_listener_ip_map = NULL;
 
-network_tcpv4_listener_t*   network_tcpv4_listener_get(network_ipv4_address_t ip, uint16_t port);
-void                        network_tcpv4_listener_add(network_ipv4_address_t ip, uint16_t port);
-network_tcpv4_connection_t* network_tcpv4_connection_get(network_ipv4_address_t local_ip, uint16_t local_port, network_ipv4_address_t remote_ip, uint16_t remote_port);
-void                        network_tcpv4_connection_add(network_tcpv4_connection_t* connection);
-void                        network_tcpv4_connection_del(network_tcpv4_connection_t* connection);
+static uint64_t network_tcpv4_default_clock(void);
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-network_tcpv4_listener_t* network_tcpv4_listener_get(network_ipv4_address_t ip, uint16_t port) {
-    if(network_tcpv4_listener_ip_map == NULL) {
-        network_tcpv4_listener_ip_map = hashmap_integer(128);
-    }
+static network_tcpv4_clock_f network_tcpv4_clock = &network_tcpv4_default_clock;
 
-    uint64_t key = ((uint64_t)ip.as_dword << 16) | port;
+static network_tcpv4_notify_f network_tcpv4_notify = NULL;
 
-    network_tcpv4_listener_t* listener = (network_tcpv4_listener_t*)hashmap_get(network_tcpv4_listener_ip_map, (void*)key);
+static lock_t* network_tcpv4_state_lock = NULL;
+static uint64_t network_tcpv4_state_lock_depth = 0; ///< nesting count of owner, only owner changes it
 
-    if(listener == NULL && (port == 7 || port == 80)) { // create dummy listener for echo and http service
-        listener = memory_malloc(sizeof(network_tcpv4_listener_t));
+void                      network_tcpv4_connection_add(network_tcpv4_connection_t* connection);
+void                      network_tcpv4_connection_del(network_tcpv4_connection_t* connection);
 
-        if(listener == NULL) {
-            return NULL;
-        }
+static uint64_t network_tcpv4_default_clock(void) {
+    return time_ns(NULL) / 1000000ULL;
+}
+
+void network_tcpv4_set_clock(network_tcpv4_clock_f clock) {
+    if(clock == NULL) {
+        clock = &network_tcpv4_default_clock;
+    }
+
+    network_tcpv4_clock = clock;
+}
+
+int8_t network_tcpv4_init(void) {
+    if(network_tcpv4_state_lock == NULL) {
+        network_tcpv4_state_lock = lock_create();
+    }
 
-        listener->local_ip = ip;
-        listener->local_port = port;
-        listener->connections = hashmap_integer(128);
+    return network_tcpv4_state_lock == NULL ? -1 : 0;
+}
 
-        hashmap_put(network_tcpv4_listener_ip_map, (void*)key, listener);
+void network_tcpv4_lock(void) {
+    // re-entry of owner returns at once without counting, so depth is kept here
+    lock_acquire(network_tcpv4_state_lock);
+    network_tcpv4_state_lock_depth++;
+}
 
-        return listener;
+void network_tcpv4_unlock(void) {
+    // unlock of a nested call keeps critical section of its caller
+    if(--network_tcpv4_state_lock_depth == 0) {
+        lock_release(network_tcpv4_state_lock);
     }
+}
 
-    return listener;
+void network_tcpv4_set_notify(network_tcpv4_notify_f notify) {
+    network_tcpv4_notify = notify;
+}
+
+static void network_tcpv4_notify_owner(void* owner, boolean_t detached) {
+    if(owner && network_tcpv4_notify) {
+        network_tcpv4_notify(owner, detached);
+    }
 }
 
-void network_tcpv4_listener_add(network_ipv4_address_t ip, uint16_t port) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+static network_tcpv4_listener_t* network_tcpv4_listener_create(network_ipv4_address_t ip, uint16_t port, boolean_t listening) {
     if(network_tcpv4_listener_ip_map == NULL) {
         network_tcpv4_listener_ip_map = hashmap_integer(128);
     }
@@ -67,566 +132,2025 @@ void network_tcpv4_listener_add(network_ipv4_address_t ip, uint16_t port) {
     network_tcpv4_listener_t* listener = memory_malloc(sizeof(network_tcpv4_listener_t));
 
     if(listener == NULL) {
-        return;
+        return NULL;
     }
 
     listener->local_ip = ip;
     listener->local_port = port;
+    listener->listening = listening;
+    listener->backlog = NETWORK_TCPV4_DEFAULT_BACKLOG;
     listener->connections = hashmap_integer(128);
 
     hashmap_put(network_tcpv4_listener_ip_map, (void*)key, listener);
-}
 
-network_tcpv4_connection_t* network_tcpv4_connection_get(network_ipv4_address_t local_ip, uint16_t local_port, network_ipv4_address_t remote_ip, uint16_t remote_port) {
-    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(local_ip, local_port);
+    return listener;
+}
 
-    if(listener == NULL) {
-        return NULL;
+network_tcpv4_listener_t* network_tcpv4_listener_get(network_ipv4_address_t ip, uint16_t port) {
+    if(network_tcpv4_listener_ip_map == NULL) {
+        network_tcpv4_listener_ip_map = hashmap_integer(128);
     }
 
-    uint64_t key = ((uint64_t)remote_ip.as_dword << 16) | remote_port;
-
-    network_tcpv4_connection_t* connection = (network_tcpv4_connection_t*)hashmap_get(listener->connections, (void*)key);
-
-    return connection;
-}
+    uint64_t key = ((uint64_t)ip.as_dword << 16) | port;
 
-void network_tcpv4_connection_add(network_tcpv4_connection_t* connection) {
-    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(connection->local_ip, connection->local_port);
+    network_tcpv4_listener_t* listener = (network_tcpv4_listener_t*)hashmap_get(network_tcpv4_listener_ip_map, (void*)key);
 
-    if(listener == NULL) {
-        return;
+    if(listener == NULL && ip.as_dword) {
+        // listener bound to all addresses
+        listener = (network_tcpv4_listener_t*)hashmap_get(network_tcpv4_listener_ip_map, (void*)(uint64_t)port);
     }
 
-    uint64_t key = ((uint64_t)connection->remote_ip.as_dword << 16) | connection->remote_port;
-
-    hashmap_put(listener->connections, (void*)key, connection);
+    return listener;
 }
 
-void network_tcpv4_connection_del(network_tcpv4_connection_t* connection) {
-    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(connection->local_ip, connection->local_port);
+network_tcpv4_listener_t* network_tcpv4_listen(network_ipv4_address_t ip, uint16_t port, uint32_t backlog) {
+    network_tcpv4_lock();
+
+    uint64_t key = ((uint64_t)ip.as_dword << 16) | port;
+    network_tcpv4_listener_t* listener = NULL;
+
+    if(network_tcpv4_listener_ip_map) {
+        listener = (network_tcpv4_listener_t*)hashmap_get(network_tcpv4_listener_ip_map, (void*)key);
+    }
 
     if(listener == NULL) {
-        return;
+        listener = network_tcpv4_listener_create(ip, port, true);
+    } else if(listener->listening) {
+        listener = NULL;
+    } else {
+        listener->listening = true;
     }
 
-    uint64_t key = ((uint64_t)connection->remote_ip.as_dword << 16) | connection->remote_port;
+    if(listener) {
+        listener->backlog = backlog ? backlog : NETWORK_TCPV4_DEFAULT_BACKLOG;
+    }
 
-    hashmap_delete(listener->connections, (void*)key);
+    network_tcpv4_unlock();
 
-    memory_free(connection);
+    return listener;
 }
+#pragma GCC diagnostic pop
 
-static uint16_t network_tcpv4_generate_checksum(network_tcpv4_header_t* tcpv4_packet, uint16_t packet_len) {
-    uint32_t sum = 0;
+network_tcpv4_connection_t* network_tcpv4_accept(network_tcpv4_listener_t* listener) {
+    if(listener == NULL) {
+        return NULL;
+    }
 
-    sum += BYTE_SWAP16(NETWORK_IPV4_PROTOCOL_TCPV4);
-    sum += BYTE_SWAP16(packet_len);
+    network_tcpv4_lock();
 
-    uint8_t* packet = (uint8_t*)tcpv4_packet;
+    network_tcpv4_connection_t* connection = listener->accept_head;
 
-    boolean_t single_byte = packet_len & 1;
-    uint16_t tmp_len = packet_len - single_byte;
+    if(connection) {
+        listener->accept_head = connection->accept_next;
 
-    for(uint16_t i = 0; i < tmp_len; i += 2) {
-        sum += (packet[i + 1] << 8) | packet[i];
-    }
+        if(listener->accept_head == NULL) {
+            listener->accept_tail = NULL;
+        }
 
-    if(single_byte) {
-        sum += packet[packet_len - 1];
+        connection->accept_next = NULL;
+        connection->unaccepted = false;
+        listener->unaccepted_count--;
     }
 
-    while(sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
+    network_tcpv4_unlock();
 
-    return sum;
+    return connection;
 }
 
-
-static network_tcpv4_header_t* network_tcpv4_create_reset_packet(uint16_t dest_port, uint16_t source_port, uint32_t sequence_number, uint32_t acknowledgement_number) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t));
-
-    if(res == NULL) {
-        return NULL;
+static void network_tcpv4_accept_queue_push(network_tcpv4_listener_t* listener, network_tcpv4_connection_t* connection) {
+    if(listener->accept_tail) {
+        listener->accept_tail->accept_next = connection;
+    } else {
+        listener->accept_head = connection;
     }
 
-    res->source_port = BYTE_SWAP16(source_port);
-    res->destination_port = BYTE_SWAP16(dest_port);
-    res->sequence_number = BYTE_SWAP32(sequence_number);
-    res->acknowledgement_number = BYTE_SWAP32(acknowledgement_number);
-    res->header_length = 5;
-    res->rst = 1;
-    res->ack = 1;
-
-    res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t));
+    listener->accept_tail = connection;
 
-    return res;
+    network_tcpv4_notify_owner(listener->owner, false);
 }
 
-static network_tcpv4_header_t* network_tcpv4_create_syn_ack_packet_from_connection(network_tcpv4_connection_t* connection) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t));
+static void network_tcpv4_accept_queue_remove(network_tcpv4_listener_t* listener, network_tcpv4_connection_t* connection) {
+    network_tcpv4_connection_t* previous = NULL;
+    network_tcpv4_connection_t* item = listener->accept_head;
 
-    if(res == NULL) {
-        return NULL;
+    while(item && item != connection) {
+        previous = item;
+        item = item->accept_next;
     }
 
-    res->source_port = BYTE_SWAP16(connection->local_port);
-    res->destination_port = BYTE_SWAP16(connection->remote_port);
-    res->sequence_number = BYTE_SWAP32(connection->local_sequence_number);
-    res->acknowledgement_number = BYTE_SWAP32(connection->remote_sequence_number);
-    res->window_size = BYTE_SWAP16(connection->window_size);
-    res->header_length = 5;
-    res->syn = 1;
-    res->ack = 1;
+    if(item == NULL) {
+        return;
+    }
 
-    res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t));
+    if(previous) {
+        previous->accept_next = item->accept_next;
+    } else {
+        listener->accept_head = item->accept_next;
+    }
+
+    if(listener->accept_tail == item) {
+        listener->accept_tail = previous;
+    }
 
-    return res;
+    item->accept_next = NULL;
 }
 
-static network_tcpv4_header_t* network_tcpv4_create_ack_packet_from_connection(network_tcpv4_connection_t* connection) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t));
+network_tcpv4_connection_t* network_tcpv4_connection_get(network_ipv4_address_t local_ip, uint16_t local_port, network_ipv4_address_t remote_ip, uint16_t remote_port) {
+    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(local_ip, local_port);
 
-    if(res == NULL) {
+    if(listener == NULL) {
         return NULL;
     }
 
-    res->source_port = BYTE_SWAP16(connection->local_port);
-    res->destination_port = BYTE_SWAP16(connection->remote_port);
-    res->sequence_number = BYTE_SWAP32(connection->local_sequence_number);
-    res->acknowledgement_number = BYTE_SWAP32(connection->remote_sequence_number);
-    res->window_size = BYTE_SWAP16(connection->window_size);
-    res->header_length = 5;
-    res->ack = 1;
+    uint64_t key = ((uint64_t)remote_ip.as_dword << 16) | remote_port;
 
-    res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t));
+    network_tcpv4_connection_t* connection = (network_tcpv4_connection_t*)hashmap_get(listener->connections, (void*)key);
 
-    return res;
+    return connection;
 }
 
-static network_tcpv4_header_t* network_tcpv4_create_psh_ack_packet_from_connection(network_tcpv4_connection_t* connection, uint8_t* data, uint16_t data_len) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t) + data_len);
+void network_tcpv4_connection_add(network_tcpv4_connection_t* connection) {
+    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(connection->local_ip, connection->local_port);
 
-    if(res == NULL) {
-        return NULL;
+    if(listener == NULL) {
+        return;
     }
 
-    res->source_port = BYTE_SWAP16(connection->local_port);
-    res->destination_port = BYTE_SWAP16(connection->remote_port);
-    res->sequence_number = BYTE_SWAP32(connection->local_sequence_number);
-    res->acknowledgement_number = BYTE_SWAP32(connection->remote_sequence_number);
-    res->window_size = BYTE_SWAP16(connection->window_size);
-    res->header_length = 5;
-    res->ack = 1;
-    res->psh = 1;
+    uint64_t key = ((uint64_t)connection->remote_ip.as_dword << 16) | connection->remote_port;
 
-    uint8_t* t_res = (uint8_t*)res;
-    t_res += sizeof(network_tcpv4_header_t);
+    hashmap_put(listener->connections, (void*)key, connection);
+}
 
-    memory_memcopy(data, t_res, data_len);
+static void network_tcpv4_connection_free(network_tcpv4_connection_t* connection) {
+    network_tcpv4_segment_t* segment = connection->ooo_segments;
 
-    res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t) + data_len);
+    while(segment) {
+        network_tcpv4_segment_t* next = segment->next;
 
-    return res;
-}
+        network_packet_release(segment->packet);
+        memory_free(segment);
 
-static int8_t network_tcpv4_dump_packet(network_ipv4_address_t        dip,
-                                        network_ipv4_address_t        sip,
-                                        const network_tcpv4_header_t* recv_tcpv4_packet,
-                                        uint16_t                      packet_len) {
-    uint16_t header_length = recv_tcpv4_packet->header_length * 4;
-    uint16_t data_length = packet_len - header_length;
+        segment = next;
+    }
 
-    uint16_t source_port = recv_tcpv4_packet->source_port;
-    source_port = BYTE_SWAP16(source_port);
+    memory_free(connection->send_buffer.data);
+    memory_free(connection->recv_buffer.data);
+    memory_free(connection);
+}
 
-    uint16_t dest_port = recv_tcpv4_packet->destination_port;
-    dest_port = BYTE_SWAP16(dest_port);
+static void network_tcpv4_listener_release_if_unused(network_tcpv4_listener_t* listener) {
+    if(listener->listening || hashmap_size(listener->connections)) {
+        return;
+    }
 
+    // entry of active opened or closed listener's connections is not needed anymore
+    uint64_t key = ((uint64_t)listener->local_ip.as_dword << 16) | listener->local_port;
 
-    uint32_t seq_num = recv_tcpv4_packet->sequence_number;
-    seq_num = BYTE_SWAP32(seq_num);
+    hashmap_delete(network_tcpv4_listener_ip_map, (void*)key);
+    hashmap_destroy(listener->connections);
+    memory_free(listener);
+}
 
+void network_tcpv4_connection_del(network_tcpv4_connection_t* connection) {
+    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(connection->local_ip, connection->local_port);
 
-    uint32_t ack_num = recv_tcpv4_packet->acknowledgement_number;
-    ack_num = BYTE_SWAP32(ack_num);
+    if(listener != NULL) {
+        uint64_t key = ((uint64_t)connection->remote_ip.as_dword << 16) | connection->remote_port;
 
+        hashmap_delete(listener->connections, (void*)key);
 
-    uint16_t window_size = recv_tcpv4_packet->window_size;
-    window_size = BYTE_SWAP16(window_size);
+        if(connection->unaccepted) {
+            network_tcpv4_accept_queue_remove(listener, connection);
+            listener->unaccepted_count--;
+        }
 
-    PRINTLOG(NETWORK, LOG_TRACE, "Source IP: %i.%i.%i.%i Destination IP: %i.%i.%i.%i",
-             dip.as_bytes[0], dip.as_bytes[1], dip.as_bytes[2], dip.as_bytes[3],
-             sip.as_bytes[0], sip.as_bytes[1], sip.as_bytes[2], sip.as_bytes[3]);
-    PRINTLOG(NETWORK, LOG_TRACE, "Source port: %i Destination port: %i", source_port, dest_port);
-    PRINTLOG(NETWORK, LOG_TRACE, "Sequence number: %i Acknowledgement number: %i", seq_num, ack_num);
-    PRINTLOG(NETWORK, LOG_TRACE, "Window size: %i", window_size);
-    PRINTLOG(NETWORK, LOG_TRACE, "Data length: %i", data_length);
+        network_tcpv4_listener_release_if_unused(listener);
+    }
 
+    PRINTLOG(NETWORK, LOG_TRACE, "connection to port %i deleted", connection->remote_port);
 
-    if(recv_tcpv4_packet->syn) {
-        PRINTLOG(NETWORK, LOG_TRACE, "SYN flag set");
-    }
+    network_tcpv4_notify_owner(connection->owner, true);
 
-    if(recv_tcpv4_packet->fin) {
-        PRINTLOG(NETWORK, LOG_TRACE, "FIN flag set");
-    }
+    network_tcpv4_connection_free(connection);
+}
 
-    if(recv_tcpv4_packet->ack) {
-        PRINTLOG(NETWORK, LOG_TRACE, "ACK flag set");
+void network_tcpv4_destroy_all(void) {
+    if(network_tcpv4_listener_ip_map == NULL) {
+        return;
     }
 
-    if(recv_tcpv4_packet->rst) {
-        PRINTLOG(NETWORK, LOG_TRACE, "RST flag set");
-    }
+    iterator_t* iter = hashmap_iterator_create(network_tcpv4_listener_ip_map);
 
-    if(recv_tcpv4_packet->psh) {
-        PRINTLOG(NETWORK, LOG_TRACE, "PSH flag set");
-    }
+    while(iter->end_of_iterator(iter) != 0) {
+        network_tcpv4_listener_t* listener = (network_tcpv4_listener_t*)iter->get_item(iter);
+        iterator_t* conn_iter = hashmap_iterator_create(listener->connections);
 
-    if(header_length > sizeof(network_tcpv4_header_t)) {
-        PRINTLOG(NETWORK, LOG_TRACE, "Options present");
+        while(conn_iter->end_of_iterator(conn_iter) != 0) {
+            network_tcpv4_connection_free((network_tcpv4_connection_t*)conn_iter->get_item(conn_iter));
 
-        uint16_t options_length = header_length - sizeof(network_tcpv4_header_t);
+            conn_iter = conn_iter->next(conn_iter);
+        }
 
-        uint8_t* options = (uint8_t*)recv_tcpv4_packet;
-        options += sizeof(network_tcpv4_header_t);
+        conn_iter->destroy(conn_iter);
 
-        PRINTLOG(NETWORK, LOG_TRACE, "Options length: %i", options_length);
+        hashmap_destroy(listener->connections);
+        memory_free(listener);
 
-        uint16_t i = 0;
+        iter = iter->next(iter);
+    }
 
-        while(i < options_length) {
-            PRINTLOG(NETWORK, LOG_TRACE, "Option %i: %i", i, options[i]);
+    iter->destroy(iter);
 
-            if(options[i] == 0) {
-                break;
-            } else if(options[i] == 1) {
-                PRINTLOG(NETWORK, LOG_TRACE, "NOP option");
-                i++;
-            } else if(options[i] == 2) {
-                PRINTLOG(NETWORK, LOG_TRACE, "MSS option");
-
-                if(options[i + 1] == 4) {
-                    uint16_t mss = (options[i + 2] << 8) | options[i + 3];
-                    PRINTLOG(NETWORK, LOG_TRACE, "MSS: %i", mss);
-                } else {
-                    PRINTLOG(NETWORK, LOG_TRACE, "Invalid MSS option length");
-
-                    return -1;
-                }
+    hashmap_destroy(network_tcpv4_listener_ip_map);
+    network_tcpv4_listener_ip_map = NULL;
+}
 
-                i += 4;
-            } else if(options[i] == 3) {
-                PRINTLOG(NETWORK, LOG_TRACE, "Window scale option");
+static int8_t network_tcpv4_buffer_init(network_tcpv4_buffer_t* buffer, uint32_t capacity) {
+    buffer->data = memory_malloc(capacity);
 
-                if(options[i + 1] == 3) {
-                    uint8_t window_scale = options[i + 2];
-                    PRINTLOG(NETWORK, LOG_TRACE, "Window scale: %i", window_scale);
-                } else {
-                    PRINTLOG(NETWORK, LOG_TRACE, "Invalid window scale option length");
+    if(buffer->data == NULL) {
+        return -1;
+    }
 
-                    return NULL;
-                }
+    buffer->capacity = capacity;
+    buffer->start = 0;
+    buffer->length = 0;
 
-                i += 3;
-            } else if(options[i] == 4) {
-                PRINTLOG(NETWORK, LOG_TRACE, "SACK permitted option");
+    return 0;
+}
 
-                if(options[i + 1] == 2) {
-                    PRINTLOG(NETWORK, LOG_TRACE, "SACK permitted option length is valid");
-                } else {
-                    PRINTLOG(NETWORK, LOG_TRACE, "Invalid SACK permitted option length");
+static uint32_t network_tcpv4_buffer_free_space(const network_tcpv4_buffer_t* buffer) {
+    return buffer->capacity - buffer->length;
+}
 
-                    return -1;
-                }
+static uint32_t network_tcpv4_buffer_write(network_tcpv4_buffer_t* buffer, const uint8_t* data, uint32_t len) {
+    uint32_t free_space = network_tcpv4_buffer_free_space(buffer);
 
-                i += 2;
-            } else if(options[i] == 5) {
-                PRINTLOG(NETWORK, LOG_TRACE, "SACK option");
+    if(len > free_space) {
+        len = free_space;
+    }
 
-                if(options[i + 1] > 2) {
-                    uint8_t sack_length = options[i + 1];
-                    PRINTLOG(NETWORK, LOG_TRACE, "SACK length: %i", sack_length);
+    uint32_t pos = (buffer->start + buffer->length) & (buffer->capacity - 1);
+    uint32_t first = buffer->capacity - pos;
 
-                    uint8_t* sack = &options[i + 2];
+    if(first > len) {
+        first = len;
+    }
 
-                    for(uint8_t j = 0; j < sack_length - 2; j += 8) {
-                        uint32_t left_edge = (sack[j] << 24) | (sack[j + 1] << 16) | (sack[j + 2] << 8) | sack[j + 3];
-                        uint32_t right_edge = (sack[j + 4] << 24) | (sack[j + 5] << 16) | (sack[j + 6] << 8) | sack[j + 7];
+    memory_memcopy(data, buffer->data + pos, first);
+    memory_memcopy(data + first, buffer->data, len - first);
 
-                        PRINTLOG(NETWORK, LOG_TRACE, "SACK block %i: %i-%i", j / 8, left_edge, right_edge);
-                    }
+    buffer->length += len;
 
-                    i += sack_length;
-                } else {
-                    PRINTLOG(NETWORK, LOG_TRACE, "Invalid SACK option length");
+    return len;
+}
 
-                    return -1;
-                }
+static void network_tcpv4_buffer_peek(const network_tcpv4_buffer_t* buffer, uint32_t offset, uint8_t* data, uint32_t len) {
+    uint32_t pos = (buffer->start + offset) & (buffer->capacity - 1);
+    uint32_t first = buffer->capacity - pos;
 
-                i += options[i + 1];
-            } else if(options[i] == 8) {
-                PRINTLOG(NETWORK, LOG_TRACE, "Timestamp option");
+    if(first > len) {
+        first = len;
+    }
 
-                if(options[i + 1] == 10) {
-                    uint32_t timestamp = (options[i + 2] << 24) | (options[i + 3] << 16) | (options[i + 4] << 8) | options[i + 5];
-                    uint32_t echo_reply = (options[i + 6] << 24) | (options[i + 7] << 16) | (options[i + 8] << 8) | options[i + 9];
+    memory_memcopy(buffer->data + pos, data, first);
+    memory_memcopy(buffer->data, data + first, len - first);
+}
 
-                    PRINTLOG(NETWORK, LOG_TRACE, "Timestamp: %i Echo reply: %i", timestamp, echo_reply);
-                } else {
-                    PRINTLOG(NETWORK, LOG_TRACE, "Invalid timestamp option length");
+static void network_tcpv4_buffer_drop(network_tcpv4_buffer_t* buffer, uint32_t len) {
+    if(len > buffer->length) {
+        len = buffer->length;
+    }
 
-                    return -1;
-                }
+    buffer->start = (buffer->start + len) & (buffer->capacity - 1);
+    buffer->length -= len;
+}
 
-                i += 10;
-            } else {
-                PRINTLOG(NETWORK, LOG_TRACE, "Invalid/Unsupported option: %i", options[i]);
+/*! copies bytes of send buffer and returns their partial checksum */
+static uint16_t network_tcpv4_buffer_peek_checksum(const network_tcpv4_buffer_t* buffer, uint32_t offset, uint8_t* data, uint32_t len) {
+    uint32_t pos = (buffer->start + offset) & (buffer->capacity - 1);
+    uint32_t first = buffer->capacity - pos;
 
-                return -1;
-            }
-        }
+    if(first > len) {
+        first = len;
     }
 
-    return 0;
+    uint16_t sum = network_checksum_copy(buffer->data + pos, data, first, 0);
+    uint16_t wrapped = network_checksum_copy(buffer->data, data + first, len - first, 0);
+
+    return network_checksum_combine(sum, wrapped, first);
 }
 
-static uint8_t* network_tcpv4_process_syn_packet(network_ipv4_address_t dip,
-                                                 network_ipv4_address_t sip,
-                                                 uint16_t               dest_port,
-                                                 uint16_t               source_port,
-                                                 uint32_t               ack_num,
-                                                 uint32_t               seq_num,
-                                                 uint16_t               window_size,
-                                                 uint16_t*              return_packet_len) {
+static uint16_t network_tcpv4_generate_checksum(network_tcpv4_header_t* tcpv4_packet, uint16_t packet_len, network_ipv4_address_t sip, network_ipv4_address_t dip) {
+    uint16_t sum = network_checksum_pseudo_header(sip, dip, NETWORK_IPV4_PROTOCOL_TCPV4, packet_len);
 
-    network_tcpv4_listener_t* listener = network_tcpv4_listener_get(dip, dest_port);
+    return ~network_checksum_partial(tcpv4_packet, packet_len, sum);
+}
 
-    if(listener == NULL) {
-        return NULL;
-    }
+/*! fills checksum of an outgoing segment, payload_sum is partial sum of bytes after header and options */
+static void network_tcpv4_set_checksum(network_tcpv4_connection_t* connection, network_packet_t* packet, network_tcpv4_header_t* res,
+                                       uint16_t header_len, uint16_t payload_sum) {
+    uint16_t sum = network_checksum_pseudo_header(connection->local_ip, connection->remote_ip, NETWORK_IPV4_PROTOCOL_TCPV4, packet->length);
 
-    network_tcpv4_header_t* res = NULL;
+    if(network_checksum_tx_offload_enabled(connection->network_info)) {
+        // nic sums segment over pseudo header sum
+        res->checksum = sum;
+        packet->checksum_flags |= NETWORK_PACKET_CHECKSUM_L4_OFFLOAD;
+        packet->checksum_start = packet->offset;
+        packet->checksum_field = offsetof_field(network_tcpv4_header_t, checksum);
 
-    network_tcpv4_connection_t* connection = network_tcpv4_connection_get(dip, dest_port, sip, source_port);
+        return;
+    }
 
-    if(connection) {
-        // SYN received on an existing connection
-        // send RST
-        res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
+    sum = network_checksum_partial(res, header_len, sum);
+    sum = network_checksum_combine(sum, payload_sum, header_len);
 
-        if(res != NULL) {
-            *return_packet_len = sizeof(network_tcpv4_header_t);
-            PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+    res->checksum = ~sum;
+}
 
-            return (uint8_t*)res;
-        }
+static void network_tcpv4_segments_append(network_tcpv4_segments_t* segments, network_packet_t* packet) {
+    if(packet == NULL) {
+        return;
+    }
 
-        return NULL;
+    if(segments->tail) {
+        segments->tail->next = packet;
+    } else {
+        segments->head = packet;
     }
 
-    // new connection
-    connection = memory_malloc(sizeof(network_tcpv4_connection_t));
+    segments->tail = packet;
+}
 
-    if(connection == NULL) {
+static network_packet_t* network_tcpv4_create_segment(network_packet_pool_t* pool, uint16_t data_len, network_tcpv4_header_t** res) {
+    network_packet_t* packet = network_packet_alloc(pool, sizeof(network_tcpv4_header_t) + data_len);
+
+    if(packet == NULL) {
         return NULL;
     }
 
-    connection->local_ip = dip;
-    connection->local_port = dest_port;
-    connection->remote_ip = sip;
-    connection->remote_port = source_port;
-    connection->state = NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED;
+    *res = (network_tcpv4_header_t*)network_packet_put(packet, sizeof(network_tcpv4_header_t) + data_len);
 
-    connection->local_sequence_number = rand();
-    connection->remote_sequence_number = seq_num + 1;
+    // pool buffers are recycled without clearing
+    memory_memclean(*res, sizeof(network_tcpv4_header_t));
 
-    connection->local_acknowledgement_number = ack_num;
-    connection->remote_acknowledgement_number = 0;
+    return packet;
+}
 
-    connection->window_size = window_size;
+static network_packet_t* network_tcpv4_create_reset_packet(network_packet_pool_t*        pool,
+                                                           network_ipv4_address_t        sip,
+                                                           network_ipv4_address_t        dip,
+                                                           const network_tcpv4_header_t* recv_tcpv4_packet,
+                                                           uint32_t                      segment_length) {
+    network_tcpv4_header_t* res = NULL;
+    network_packet_t* packet = network_tcpv4_create_segment(pool, 0, &res);
 
-    network_tcpv4_connection_add(connection);
+    if(packet == NULL) {
+        return NULL;
+    }
 
-    res = network_tcpv4_create_syn_ack_packet_from_connection(connection);
+    res->source_port = recv_tcpv4_packet->destination_port;
+    res->destination_port = recv_tcpv4_packet->source_port;
+    res->header_length = 5;
+    res->rst = 1;
 
-    if(res != NULL) {
-        *return_packet_len = sizeof(network_tcpv4_header_t);
-        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+    if(recv_tcpv4_packet->ack) {
+        res->sequence_number = recv_tcpv4_packet->acknowledgement_number;
+    } else {
+        uint32_t ack_num = BYTE_SWAP32(recv_tcpv4_packet->sequence_number) + segment_length;
 
-        return (uint8_t*)res;
+        res->acknowledgement_number = BYTE_SWAP32(ack_num);
+        res->ack = 1;
     }
 
-    return NULL;
+    res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t), sip, dip);
+
+    return packet;
 }
 
-static uint8_t* network_tcpv4_process_fin_packet(network_tcpv4_connection_t* connection, uint32_t seq_num, uint16_t* return_packet_len) {
-    // connection closed
-    PRINTLOG(NETWORK, LOG_TRACE, "Connection closed");
+static int8_t network_tcpv4_parse_options(const network_tcpv4_header_t* recv_tcpv4_packet, network_tcpv4_options_t* options) {
+    uint16_t options_length = recv_tcpv4_packet->header_length * 4 - sizeof(network_tcpv4_header_t);
+    const uint8_t* opt = (const uint8_t*)(recv_tcpv4_packet + 1);
+    uint16_t i = 0;
 
-    if(connection->state == NETWORK_TCP_CONNECTION_STATE_ESTABLISHED) {
-        connection->local_sequence_number = connection->remote_acknowledgement_number;
-        connection->remote_sequence_number = seq_num + 1;
+    while(i < options_length) {
+        uint8_t kind = opt[i];
 
-        connection->state = NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT;
+        if(kind == NETWORK_TCPV4_OPTION_END) {
+            break;
+        }
 
-        network_tcpv4_header_t* res = NULL;
+        if(kind == NETWORK_TCPV4_OPTION_NOP) {
+            i++;
 
-        res = network_tcpv4_create_ack_packet_from_connection(connection);
+            continue;
+        }
 
-        if(res != NULL) {
-            *return_packet_len = sizeof(network_tcpv4_header_t);
-            PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+        if(i + 1 >= options_length || opt[i + 1] < 2 || i + opt[i + 1] > options_length) {
+            PRINTLOG(NETWORK, LOG_TRACE, "invalid tcp option length");
 
-            return (uint8_t*)res;
+            return -1;
         }
+
+        uint8_t len = opt[i + 1];
+
+        if(kind == NETWORK_TCPV4_OPTION_MSS && len == 4) {
+            options->mss = (opt[i + 2] << 8) | opt[i + 3];
+        } else if(kind == NETWORK_TCPV4_OPTION_WINDOW_SCALE && len == 3) {
+            options->window_scale = MIN(opt[i + 2], 14);
+            options->window_scale_present = true;
+        } else if(kind == NETWORK_TCPV4_OPTION_SACK_PERMITTED && len == 2) {
+            options->sack_permitted = true;
+        } else if(kind == NETWORK_TCPV4_OPTION_SACK && len >= 10) {
+            for(uint8_t j = 2; j + 8 <= len && options->sack_count < 4; j += 8) {
+                const uint8_t* sack = &opt[i + j];
+
+                options->sack[options->sack_count].start = (sack[0] << 24) | (sack[1] << 16) | (sack[2] << 8) | sack[3];
+                options->sack[options->sack_count].end = (sack[4] << 24) | (sack[5] << 16) | (sack[6] << 8) | sack[7];
+                options->sack_count++;
+            }
+        } // timestamps and unknown options are skipped
+
+        i += len;
     }
 
-    return NULL;
+    return 0;
+}
 
+static void network_tcpv4_dump_packet(network_ipv4_address_t        dip,
+                                      network_ipv4_address_t        sip,
+                                      const network_tcpv4_header_t* recv_tcpv4_packet,
+                                      uint16_t                      packet_len) {
+    PRINTLOG(NETWORK, LOG_TRACE, "%i.%i.%i.%i:%i -> %i.%i.%i.%i:%i seq 0x%x ack 0x%x win %i len %i flags %c%c%c%c%c",
+             sip.as_bytes[0], sip.as_bytes[1], sip.as_bytes[2], sip.as_bytes[3], (uint16_t)BYTE_SWAP16(recv_tcpv4_packet->source_port),
+             dip.as_bytes[0], dip.as_bytes[1], dip.as_bytes[2], dip.as_bytes[3], (uint16_t)BYTE_SWAP16(recv_tcpv4_packet->destination_port),
+             (uint32_t)BYTE_SWAP32(recv_tcpv4_packet->sequence_number), (uint32_t)BYTE_SWAP32(recv_tcpv4_packet->acknowledgement_number),
+             (uint16_t)BYTE_SWAP16(recv_tcpv4_packet->window_size), packet_len - recv_tcpv4_packet->header_length * 4,
+             recv_tcpv4_packet->syn?'S':'.', recv_tcpv4_packet->ack?'A':'.', recv_tcpv4_packet->psh?'P':'.',
+             recv_tcpv4_packet->fin?'F':'.', recv_tcpv4_packet->rst?'R':'.');
 }
 
-uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_tcpv4_header_t* recv_tcpv4_packet, void* network_info, uint16_t packet_len, uint16_t* return_packet_len) {
-    UNUSED(network_info);
-    UNUSED(return_packet_len);
+static uint32_t network_tcpv4_receive_window(network_tcpv4_connection_t* connection) {
+    uint32_t window = network_tcpv4_buffer_free_space(&connection->recv_buffer);
 
-    if (recv_tcpv4_packet == NULL || return_packet_len == NULL) {
-        PRINTLOG(NETWORK, LOG_ERROR, "recv_tcpv4_packet/return_packet_len is NULL");
-        return NULL;
+    // advertised right edge never moves back
+    if(NETWORK_TCPV4_SEQ_LT(connection->rcv_nxt + window, connection->rcv_adv)) {
+        window = connection->rcv_adv - connection->rcv_nxt;
     }
 
-    PRINTLOG(NETWORK, LOG_TRACE, "Processing TCPv4 packet");
-
-    if(network_tcpv4_dump_packet(dip, sip, recv_tcpv4_packet, packet_len) < 0) {
-        return NULL;
+    if(window > (0xFFFFU << connection->rcv_wscale)) {
+        window = 0xFFFFU << connection->rcv_wscale;
     }
 
-    uint16_t header_length = recv_tcpv4_packet->header_length * 4;
-    uint16_t data_length = packet_len - header_length;
+    return window;
+}
 
-    uint16_t source_port = recv_tcpv4_packet->source_port;
-    source_port = BYTE_SWAP16(source_port);
+static uint8_t network_tcpv4_build_sack_option(network_tcpv4_connection_t* connection, uint8_t* opt) {
+    network_tcpv4_sack_block_t blocks[NETWORK_TCPV4_SACK_BLOCKS_PER_SEGMENT] = {0};
+    uint8_t count = 0;
+    network_tcpv4_segment_t* segment = connection->ooo_segments;
 
-    uint16_t dest_port = recv_tcpv4_packet->destination_port;
-    dest_port = BYTE_SWAP16(dest_port);
+    // first block covers latest segment (rfc 2018), others follow in sequence order
+    while(segment) {
+        network_tcpv4_sack_block_t block = {.start = segment->sequence, .end = segment->sequence + segment->length};
 
-    uint32_t seq_num = recv_tcpv4_packet->sequence_number;
-    seq_num = BYTE_SWAP32(seq_num);
+        segment = segment->next;
 
+        while(segment && NETWORK_TCPV4_SEQ_LEQ(segment->sequence, block.end)) {
+            if(NETWORK_TCPV4_SEQ_GT(segment->sequence + segment->length, block.end)) {
+                block.end = segment->sequence + segment->length;
+            }
 
-    uint32_t ack_num = recv_tcpv4_packet->acknowledgement_number;
-    ack_num = BYTE_SWAP32(ack_num);
+            segment = segment->next;
+        }
 
-    uint16_t window_size = recv_tcpv4_packet->window_size;
-    window_size = BYTE_SWAP16(window_size);
+        boolean_t latest = NETWORK_TCPV4_SEQ_GEQ(connection->ooo_last_sequence, block.start) &&
+                           NETWORK_TCPV4_SEQ_LT(connection->ooo_last_sequence, block.end);
 
+        if(latest) {
+            for(uint8_t i = MIN(count, NETWORK_TCPV4_SACK_BLOCKS_PER_SEGMENT - 1); i > 0; i--) {
+                blocks[i] = blocks[i - 1];
+            }
 
-    if(recv_tcpv4_packet->syn) {
-        return network_tcpv4_process_syn_packet(dip, sip, dest_port, source_port, ack_num, seq_num, window_size, return_packet_len);
+            blocks[0] = block;
+
+            if(count < NETWORK_TCPV4_SACK_BLOCKS_PER_SEGMENT) {
+                count++;
+            }
+        } else if(count < NETWORK_TCPV4_SACK_BLOCKS_PER_SEGMENT) {
+            blocks[count++] = block;
+        }
     }
 
-    network_tcpv4_header_t* res = NULL;
+    if(count == 0) {
+        return 0;
+    }
 
-    network_tcpv4_connection_t* connection = network_tcpv4_connection_get(dip, dest_port, sip, source_port);
+    opt[0] = NETWORK_TCPV4_OPTION_NOP;
+    opt[1] = NETWORK_TCPV4_OPTION_NOP;
+    opt[2] = NETWORK_TCPV4_OPTION_SACK;
+    opt[3] = 2 + count * 8;
 
-    if(!connection) {
-        // send RST
-        res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
+    for(uint8_t i = 0; i < count; i++) {
+        uint32_t start = BYTE_SWAP32(blocks[i].start);
+        uint32_t end = BYTE_SWAP32(blocks[i].end);
+
+        memory_memcopy(&start, opt + 4 + i * 8, sizeof(uint32_t));
+        memory_memcopy(&end, opt + 8 + i * 8, sizeof(uint32_t));
+    }
 
-        if(res != NULL) {
-            *return_packet_len = sizeof(network_tcpv4_header_t);
-            PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+    return 4 + count * 8;
+}
 
-            return (uint8_t*)res;
+static network_packet_t* network_tcpv4_build_segment(network_tcpv4_connection_t* connection,
+                                                     uint32_t                    seq,
+                                                     uint32_t                    data_len,
+                                                     boolean_t                   syn,
+                                                     boolean_t                   fin) {
+    uint8_t options[NETWORK_TCPV4_SYN_OPTIONS_LENGTH + 28] = {0};
+    uint8_t options_len = 0;
+
+    if(syn) {
+        options[0] = NETWORK_TCPV4_OPTION_MSS;
+        options[1] = 4;
+        options[2] = NETWORK_TCPV4_MSS >> 8;
+        options[3] = NETWORK_TCPV4_MSS & 0xFF;
+        options_len = 4;
+
+        if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_SENT || connection->rcv_wscale) {
+            options[4] = NETWORK_TCPV4_OPTION_NOP;
+            options[5] = NETWORK_TCPV4_OPTION_WINDOW_SCALE;
+            options[6] = 3;
+            options[7] = NETWORK_TCPV4_WINDOW_SCALE;
+            options_len = 8;
         }
 
-        return NULL;
+        if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_SENT || connection->sack_permitted) {
+            options[options_len++] = NETWORK_TCPV4_OPTION_NOP;
+            options[options_len++] = NETWORK_TCPV4_OPTION_NOP;
+            options[options_len++] = NETWORK_TCPV4_OPTION_SACK_PERMITTED;
+            options[options_len++] = 2;
+        }
+    } else if(connection->sack_permitted && connection->ooo_segments) {
+        options_len = network_tcpv4_build_sack_option(connection, options);
     }
 
-    if(recv_tcpv4_packet->rst) {
-        // connection reset
-        PRINTLOG(NETWORK, LOG_TRACE, "Connection reset");
-
-        network_tcpv4_connection_del(connection);
+    network_tcpv4_header_t* res = NULL;
+    network_packet_t* packet = network_tcpv4_create_segment(connection->pool, options_len + data_len, &res);
 
+    if(packet == NULL) {
         return NULL;
     }
 
-    if(recv_tcpv4_packet->fin) {
-        return network_tcpv4_process_fin_packet(connection, seq_num, return_packet_len);
-    }
+    uint8_t* payload = (uint8_t*)(res + 1);
 
-    if(connection->state == NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT) {
-        network_tcpv4_connection_del(connection);
+    memory_memcopy(options, payload, options_len);
+    payload += options_len;
 
-        return NULL;
-    }
+    uint16_t payload_sum = 0;
 
-    if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED) {
-        if(ack_num != connection->local_sequence_number + 1) {
-            // send RST
-            res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
+    if(data_len) {
+        payload_sum = network_tcpv4_buffer_peek_checksum(&connection->send_buffer, seq - connection->snd_una, payload, data_len);
+    }
 
-            if(res != NULL) {
-                *return_packet_len = sizeof(network_tcpv4_header_t);
-                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+    res->source_port = BYTE_SWAP16(connection->local_port);
+    res->destination_port = BYTE_SWAP16(connection->remote_port);
+    res->sequence_number = BYTE_SWAP32(seq);
+    res->header_length = (sizeof(network_tcpv4_header_t) + options_len) / 4;
+    res->syn = syn;
+    res->fin = fin;
+    res->psh = data_len && seq + data_len == connection->snd_una + connection->send_buffer.length;
+
+    uint32_t window = network_tcpv4_receive_window(connection);
+
+    if(syn) {
+        // window of syn segments is never scaled
+        window = MIN(window, 0xFFFFU);
+        res->window_size = BYTE_SWAP16(window);
+    } else {
+        res->window_size = BYTE_SWAP16(window >> connection->rcv_wscale);
+        window = (window >> connection->rcv_wscale) << connection->rcv_wscale;
+    }
 
-                return (uint8_t*)res;
-            }
+    if(connection->state != NETWORK_TCP_CONNECTION_STATE_SYN_SENT) {
+        res->ack = 1;
+        res->acknowledgement_number = BYTE_SWAP32(connection->rcv_nxt);
 
-            return NULL;
+        if(NETWORK_TCPV4_SEQ_GT(connection->rcv_nxt + window, connection->rcv_adv)) {
+            connection->rcv_adv = connection->rcv_nxt + window;
         }
 
-        connection->state = NETWORK_TCP_CONNECTION_STATE_ESTABLISHED;
+        // every segment carries ack, pending ack is sent with it
+        connection->ack_pending = 0;
+        connection->ack_now = false;
+        connection->delack_deadline = 0;
     }
 
-    connection->remote_sequence_number = seq_num;
-    connection->remote_acknowledgement_number = ack_num;
+    network_tcpv4_set_checksum(connection, packet, res, sizeof(network_tcpv4_header_t) + options_len, payload_sum);
 
-    if(!recv_tcpv4_packet->psh) {
-        return NULL;
+    return packet;
+}
+
+static void network_tcpv4_transmit(network_tcpv4_connection_t* connection, network_packet_t* segments) {
+    if(segments == NULL) {
+        return;
     }
 
-    // data received
-    PRINTLOG(NETWORK, LOG_TRACE, "Data received");
+    if(connection->network_info == NULL || connection->return_queue == NULL) {
+        network_packet_release_chain(segments);
 
-    uint8_t* data = (uint8_t*)recv_tcpv4_packet;
-    data += header_length;
+        return;
+    }
 
-    PRINTLOG(NETWORK, LOG_INFO, "Data(%i): %s", data_length, data);
+    network_packet_t* packets = network_ipv4_output(segments, connection->local_ip, connection->remote_ip, NETWORK_IPV4_PROTOCOL_TCPV4);
+    network_packet_t* frames = NULL;
+    network_packet_t** frames_tail = &frames;
 
-    // send ACK
+    while(packets) {
+        network_packet_t* packet = packets;
+        packets = packet->next;
+        packet->next = NULL;
 
-    connection->local_sequence_number = connection->remote_acknowledgement_number;
-    connection->remote_sequence_number = connection->remote_sequence_number + data_length;
+        if(network_ethernet_push_header(packet, connection->remote_mac, connection->network_info, NETWORK_ETHERNET_TYPE_IPV4) != 0) {
+            network_packet_release(packet);
 
-    uint16_t extra_data_length = 0;
+            continue;
+        }
 
-    if(dest_port == 7) {
-        res = network_tcpv4_create_psh_ack_packet_from_connection(connection, data, data_length);
-        extra_data_length = data_length;
-    } else if(dest_port == 80) {
-        const char* http_response = "HTTP/1.1 200 OK\r\n" \
-                                    "Content-Type: text/plain\r\n" \
-                                    "Content-Length: 13\r\n" \
-                                    "X-Operating-System: Turnstone OS\r\n" \
-                                    "\r\n" \
-                                    "Hello World!\n";
-        extra_data_length = strlen(http_response);
-        res = network_tcpv4_create_psh_ack_packet_from_connection(connection, (uint8_t*)http_response, strlen(http_response));
-    } else {
-        res = network_tcpv4_create_ack_packet_from_connection(connection);
+        *frames_tail = packet;
+        frames_tail = &packet->next;
+    }
+
+    // segments of a call are queued at once, a full queue drops them and retransmission sends them later
+    if(frames && network_tx_queue_push(connection->return_queue, frames) != 0) {
+        PRINTLOG(NETWORK, LOG_TRACE, "tx queue is full, segments are dropped");
+        network_packet_release_chain(frames);
+    }
+}
+
+static void network_tcpv4_update_rtt(network_tcpv4_connection_t* connection, uint32_t rtt) {
+    if(rtt == 0) {
+        rtt = 1;
     }
 
-    if(res != NULL) {
-        *return_packet_len = sizeof(network_tcpv4_header_t) + extra_data_length;
-        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+    if(connection->srtt_x8 == 0) {
+        connection->srtt_x8 = rtt << 3;
+        connection->rttvar_x4 = rtt << 1;
+    } else {
+        int32_t delta = rtt - (connection->srtt_x8 >> 3);
+
+        connection->srtt_x8 += delta;
+
+        if(delta < 0) {
+            delta = -delta;
+        }
 
-        return (uint8_t*)res;
+        delta -= connection->rttvar_x4 >> 2;
+        connection->rttvar_x4 += delta;
     }
 
-    return NULL;
+    uint32_t rto = (connection->srtt_x8 >> 3) + MAX(NETWORK_TCPV4_TIMER_INTERVAL_MS, connection->rttvar_x4);
+
+    connection->rto = MIN(MAX(rto, NETWORK_TCPV4_MIN_RTO_MS), NETWORK_TCPV4_MAX_RTO_MS);
+}
+
+static uint32_t network_tcpv4_sacked_bytes(const network_tcpv4_connection_t* connection, uint32_t from, uint32_t to) {
+    uint32_t sacked = 0;
+
+    for(uint32_t i = 0; i < connection->sack_count; i++) {
+        uint32_t start = connection->sack_scoreboard[i].start;
+        uint32_t end = connection->sack_scoreboard[i].end;
+
+        if(NETWORK_TCPV4_SEQ_LT(start, from)) {
+            start = from;
+        }
+
+        if(NETWORK_TCPV4_SEQ_GT(end, to)) {
+            end = to;
+        }
+
+        if(NETWORK_TCPV4_SEQ_LT(start, end)) {
+            sacked += end - start;
+        }
+    }
+
+    return sacked;
+}
+
+static uint32_t network_tcpv4_pipe(const network_tcpv4_connection_t* connection) {
+    uint32_t flight = connection->snd_nxt - connection->snd_una;
+
+    if(!connection->in_recovery) {
+        return flight;
+    }
+
+    uint32_t sacked = network_tcpv4_sacked_bytes(connection, connection->snd_una, connection->snd_nxt);
+    uint32_t lost = 0;
+    uint32_t from = connection->rexmit_high;
+
+    if(NETWORK_TCPV4_SEQ_LT(from, connection->snd_una)) {
+        from = connection->snd_una;
+    }
+
+    // unsacked bytes before lost_high and not retransmitted yet have left the network
+    if(NETWORK_TCPV4_SEQ_LT(from, connection->lost_high)) {
+        lost = connection->lost_high - from - network_tcpv4_sacked_bytes(connection, from, connection->lost_high);
+    }
+
+    uint32_t pipe = flight - sacked - lost;
+
+    if(!connection->sack_permitted) {
+        // without sack each duplicate ack reports a segment leaving the network
+        uint32_t left = connection->dupacks * connection->mss;
+
+        pipe = pipe > left?pipe - left:0;
+    }
+
+    return pipe;
+}
+
+static boolean_t network_tcpv4_next_hole(const network_tcpv4_connection_t* connection, uint32_t* seq, uint32_t* len) {
+    uint32_t start = connection->rexmit_high;
+
+    if(NETWORK_TCPV4_SEQ_LT(start, connection->snd_una)) {
+        start = connection->snd_una;
+    }
+
+    uint32_t end = connection->lost_high;
+
+    for(uint32_t i = 0; i < connection->sack_count; i++) {
+        const network_tcpv4_sack_block_t* block = &connection->sack_scoreboard[i];
+
+        if(NETWORK_TCPV4_SEQ_LEQ(block->end, start)) {
+            continue;
+        }
+
+        if(NETWORK_TCPV4_SEQ_LEQ(block->start, start)) {
+            start = block->end;
+
+            continue;
+        }
+
+        if(NETWORK_TCPV4_SEQ_LT(block->start, end)) {
+            end = block->start;
+        }
+
+        break;
+    }
+
+    if(NETWORK_TCPV4_SEQ_GEQ(start, end)) {
+        return false;
+    }
+
+    *seq = start;
+    *len = MIN(end - start, connection->mss);
+
+    return true;
+}
+
+static void network_tcpv4_arm_rto(network_tcpv4_connection_t* connection, uint64_t now) {
+    uint64_t rto = (uint64_t)connection->rto << MIN(connection->retries, 8U);
+
+    connection->rto_deadline = now + MIN(rto, (uint64_t)NETWORK_TCPV4_MAX_RTO_MS);
+}
+
+/**
+ * @brief sends retransmissions and new data allowed by congestion and peer windows, then a pending ack
+ */
+static void network_tcpv4_output(network_tcpv4_connection_t* connection, uint64_t now, network_tcpv4_segments_t* segments) {
+    if(connection->state != NETWORK_TCP_CONNECTION_STATE_ESTABLISHED &&
+       connection->state != NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT &&
+       connection->state != NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_1 &&
+       connection->state != NETWORK_TCP_CONNECTION_STATE_CLOSING &&
+       connection->state != NETWORK_TCP_CONNECTION_STATE_LAST_ACK) {
+        if(connection->ack_now && connection->state != NETWORK_TCP_CONNECTION_STATE_SYN_SENT) {
+            network_tcpv4_segments_append(segments, network_tcpv4_build_segment(connection, connection->snd_nxt, 0, false, false));
+        }
+
+        return;
+    }
+
+    uint32_t data_end = connection->snd_una + connection->send_buffer.length;
+
+    while(true) {
+        uint32_t pipe = network_tcpv4_pipe(connection);
+
+        if(pipe >= connection->cwnd) {
+            break;
+        }
+
+        uint32_t budget = connection->cwnd - pipe;
+        uint32_t seq = 0;
+        uint32_t len = 0;
+
+        if(connection->in_recovery && network_tcpv4_next_hole(connection, &seq, &len)) {
+            boolean_t fin = false;
+
+            if(connection->fin_sent && NETWORK_TCPV4_SEQ_GEQ(seq + len, connection->fin_sequence + 1)) {
+                len = connection->fin_sequence - seq;
+                fin = true;
+            }
+
+            network_packet_t* packet = network_tcpv4_build_segment(connection, seq, len, false, fin);
+
+            if(packet == NULL) {
+                break;
+            }
+
+            network_tcpv4_segments_append(segments, packet);
+
+            connection->rexmit_high = seq + len + (fin?1:0);
+            connection->stat_retransmits++;
+            // karn, retransmitted segments are not timed
+            connection->rtt_active = false;
+
+            continue;
+        }
+
+        if(connection->fin_sent) {
+            break;
+        }
+
+        uint32_t unsent = data_end - connection->snd_nxt;
+        uint32_t window_end = connection->snd_una + connection->snd_wnd;
+        uint32_t usable = NETWORK_TCPV4_SEQ_GT(window_end, connection->snd_nxt)?window_end - connection->snd_nxt:0;
+
+        len = MIN(MIN(unsent, usable), connection->mss);
+
+        if(unsent && len == 0) {
+            if(connection->snd_nxt == connection->snd_una && connection->rto_deadline == 0) {
+                // zero window, persist timer probes it
+                network_tcpv4_arm_rto(connection, now);
+            }
+
+            break;
+        }
+
+        if(len < unsent && len < connection->mss && (len > budget || connection->snd_nxt != connection->snd_una)) {
+            // sender side silly window avoidance
+            break;
+        }
+
+        if(len > budget && connection->snd_nxt != connection->snd_una) {
+            break;
+        }
+
+        if(len < connection->mss && connection->snd_nxt != connection->snd_una && !connection->fin_queued) {
+            // nagle, small segments wait for outstanding data
+            break;
+        }
+
+        boolean_t fin = connection->fin_queued && connection->snd_nxt + len == data_end;
+
+        if(len == 0 && !fin) {
+            break;
+        }
+
+        network_packet_t* packet = network_tcpv4_build_segment(connection, connection->snd_nxt, len, false, fin);
+
+        if(packet == NULL) {
+            break;
+        }
+
+        network_tcpv4_segments_append(segments, packet);
+
+        if(!connection->rtt_active && len) {
+            connection->rtt_active = true;
+            connection->rtt_sequence = connection->snd_nxt;
+            connection->rtt_start = now;
+        }
+
+        connection->snd_nxt += len;
+        connection->stat_bytes_sent += len;
+
+        if(fin) {
+            connection->fin_sent = true;
+            connection->fin_sequence = connection->snd_nxt;
+            connection->snd_nxt++;
+        }
+
+        if(connection->rto_deadline == 0) {
+            network_tcpv4_arm_rto(connection, now);
+        }
+    }
+
+    if(connection->ack_now) {
+        network_tcpv4_segments_append(segments, network_tcpv4_build_segment(connection, connection->snd_nxt, 0, false, false));
+    }
+}
+
+static void network_tcpv4_sack_update(network_tcpv4_connection_t* connection, const network_tcpv4_options_t* options) {
+    for(uint8_t i = 0; i < options->sack_count; i++) {
+        network_tcpv4_sack_block_t block = options->sack[i];
+
+        if(NETWORK_TCPV4_SEQ_LEQ(block.end, connection->snd_una) || NETWORK_TCPV4_SEQ_GT(block.end, connection->snd_nxt) ||
+           NETWORK_TCPV4_SEQ_GEQ(block.start, block.end)) {
+            continue;
+        }
+
+        if(NETWORK_TCPV4_SEQ_LT(block.start, connection->snd_una)) {
+            block.start = connection->snd_una;
+        }
+
+        // insert sorted and merge overlapping blocks
+        uint32_t pos = 0;
+
+        while(pos < connection->sack_count && NETWORK_TCPV4_SEQ_LT(connection->sack_scoreboard[pos].start, block.start)) {
+            pos++;
+        }
+
+        if(connection->sack_count == NETWORK_TCPV4_SACK_SCOREBOARD_SIZE) {
+            if(pos == NETWORK_TCPV4_SACK_SCOREBOARD_SIZE) {
+                continue;
+            }
+
+            // highest block is forgotten, it is reported again by peer
+            connection->sack_count--;
+        }
+
+        for(uint32_t j = connection->sack_count; j > pos; j--) {
+            connection->sack_scoreboard[j] = connection->sack_scoreboard[j - 1];
+        }
+
+        connection->sack_scoreboard[pos] = block;
+        connection->sack_count++;
+
+        uint32_t out = 0;
+
+        for(uint32_t j = 1; j < connection->sack_count; j++) {
+            network_tcpv4_sack_block_t* last = &connection->sack_scoreboard[out];
+            const network_tcpv4_sack_block_t* cur = &connection->sack_scoreboard[j];
+
+            if(NETWORK_TCPV4_SEQ_LEQ(cur->start, last->end)) {
+                if(NETWORK_TCPV4_SEQ_GT(cur->end, last->end)) {
+                    last->end = cur->end;
+                }
+            } else {
+                connection->sack_scoreboard[++out] = *cur;
+            }
+        }
+
+        connection->sack_count = out + 1;
+    }
+
+    if(connection->in_recovery && connection->sack_count) {
+        uint32_t high = connection->sack_scoreboard[connection->sack_count - 1].end;
+
+        if(NETWORK_TCPV4_SEQ_GT(high, connection->lost_high)) {
+            connection->lost_high = high;
+        }
+    }
+}
+
+static void network_tcpv4_sack_drop_acked(network_tcpv4_connection_t* connection) {
+    uint32_t out = 0;
+
+    for(uint32_t i = 0; i < connection->sack_count; i++) {
+        network_tcpv4_sack_block_t block = connection->sack_scoreboard[i];
+
+        if(NETWORK_TCPV4_SEQ_LEQ(block.end, connection->snd_una)) {
+            continue;
+        }
+
+        if(NETWORK_TCPV4_SEQ_LT(block.start, connection->snd_una)) {
+            block.start = connection->snd_una;
+        }
+
+        connection->sack_scoreboard[out++] = block;
+    }
+
+    connection->sack_count = out;
+}
+
+static void network_tcpv4_enter_recovery(network_tcpv4_connection_t* connection, uint64_t now) {
+    network_tcpv4_congestion_on_loss(connection, now);
+
+    connection->in_recovery = true;
+    connection->timeout_recovery = false;
+    connection->recover = connection->snd_nxt;
+    connection->rexmit_high = connection->snd_una;
+    connection->lost_high = connection->snd_una + connection->mss;
+
+    if(connection->sack_count && NETWORK_TCPV4_SEQ_GT(connection->sack_scoreboard[connection->sack_count - 1].end, connection->lost_high)) {
+        connection->lost_high = connection->sack_scoreboard[connection->sack_count - 1].end;
+    }
+
+    if(NETWORK_TCPV4_SEQ_GT(connection->lost_high, connection->snd_nxt)) {
+        connection->lost_high = connection->snd_nxt;
+    }
+
+    connection->stat_fast_recoveries++;
+
+    PRINTLOG(NETWORK, LOG_TRACE, "fast recovery starts at 0x%x", connection->snd_una);
+}
+
+/**
+ * @brief processes acknowledgement field, window update and sack blocks of a segment
+ * @return -1 if ack is for unsent data and segment should be answered with an ack
+ */
+static int8_t network_tcpv4_process_ack(network_tcpv4_connection_t*   connection,
+                                        const network_tcpv4_header_t* recv_tcpv4_packet,
+                                        const network_tcpv4_options_t* options,
+                                        uint32_t                      data_length,
+                                        uint64_t                      now) {
+    uint32_t seq = BYTE_SWAP32(recv_tcpv4_packet->sequence_number);
+    uint32_t ack = BYTE_SWAP32(recv_tcpv4_packet->acknowledgement_number);
+    uint32_t window = (uint32_t)BYTE_SWAP16(recv_tcpv4_packet->window_size) << connection->snd_wscale;
+
+    if(NETWORK_TCPV4_SEQ_GT(ack, connection->snd_nxt)) {
+        return -1;
+    }
+
+    boolean_t window_changed = false;
+
+    if(NETWORK_TCPV4_SEQ_LT(connection->snd_wl1, seq) ||
+       (connection->snd_wl1 == seq && NETWORK_TCPV4_SEQ_LEQ(connection->snd_wl2, ack))) {
+        window_changed = connection->snd_wnd != window;
+        connection->snd_wnd = window;
+        connection->snd_wl1 = seq;
+        connection->snd_wl2 = ack;
+    }
+
+    if(connection->sack_permitted && options->sack_count) {
+        network_tcpv4_sack_update(connection, options);
+    }
+
+    if(NETWORK_TCPV4_SEQ_GT(ack, connection->snd_una)) {
+        uint32_t acked = ack - connection->snd_una;
+
+        if(connection->fin_sent && NETWORK_TCPV4_SEQ_GT(ack, connection->fin_sequence)) {
+            // fin has no byte at send buffer
+            network_tcpv4_buffer_drop(&connection->send_buffer, acked - 1);
+        } else {
+            network_tcpv4_buffer_drop(&connection->send_buffer, acked);
+        }
+
+        connection->snd_una = ack;
+        connection->retries = 0;
+
+        if(connection->rtt_active && NETWORK_TCPV4_SEQ_GT(ack, connection->rtt_sequence)) {
+            network_tcpv4_update_rtt(connection, now - connection->rtt_start);
+            connection->rtt_active = false;
+        }
+
+        network_tcpv4_sack_drop_acked(connection);
+
+        if(connection->in_recovery) {
+            if(NETWORK_TCPV4_SEQ_GEQ(ack, connection->recover)) {
+                if(!connection->timeout_recovery) {
+                    connection->cwnd = connection->ssthresh;
+                }
+
+                connection->in_recovery = false;
+                connection->timeout_recovery = false;
+            } else if(connection->timeout_recovery) {
+                network_tcpv4_congestion_on_ack(connection, acked, now);
+            } else if(NETWORK_TCPV4_SEQ_LT(connection->lost_high, connection->snd_una + connection->mss)) {
+                // partial ack, next segment is lost too (rfc 6582)
+                connection->lost_high = MIN(connection->snd_una + connection->mss, connection->snd_nxt);
+            }
+        } else {
+            network_tcpv4_congestion_on_ack(connection, acked, now);
+        }
+
+        connection->dupacks = 0;
+
+        if(connection->snd_una == connection->snd_nxt) {
+            connection->rto_deadline = 0;
+        } else {
+            network_tcpv4_arm_rto(connection, now);
+        }
+
+        return 0;
+    }
+
+    if(ack == connection->snd_una && data_length == 0 && !recv_tcpv4_packet->fin && !window_changed &&
+       connection->snd_nxt != connection->snd_una) {
+        connection->dupacks++;
+
+        if(!connection->in_recovery && NETWORK_TCPV4_SEQ_GT(ack, connection->recover)) {
+            boolean_t lost = connection->dupacks >= NETWORK_TCPV4_DUPACK_THRESHOLD;
+
+            if(connection->sack_permitted &&
+               network_tcpv4_sacked_bytes(connection, connection->snd_una, connection->snd_nxt) > (NETWORK_TCPV4_DUPACK_THRESHOLD - 1) * connection->mss) {
+                lost = true;
+            }
+
+            if(lost) {
+                network_tcpv4_enter_recovery(connection, now);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void network_tcpv4_consume_fin(network_tcpv4_connection_t* connection, uint64_t now) {
+    connection->rcv_nxt++;
+    connection->fin_received = true;
+    connection->ack_now = true;
+
+    switch(connection->state) {
+    case NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED:
+    case NETWORK_TCP_CONNECTION_STATE_ESTABLISHED:
+        connection->state = NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT;
+        break;
+    case NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_1:
+        connection->state = NETWORK_TCP_CONNECTION_STATE_CLOSING;
+        break;
+    case NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_2:
+        connection->state = NETWORK_TCP_CONNECTION_STATE_TIME_WAIT;
+        connection->close_deadline = now + NETWORK_TCPV4_TIME_WAIT_MS;
+        break;
+    default:
+        break;
+    }
+
+    PRINTLOG(NETWORK, LOG_TRACE, "fin received, state %i", connection->state);
+}
+
+static void network_tcpv4_drain_ooo(network_tcpv4_connection_t* connection, uint64_t now) {
+    while(connection->ooo_segments && NETWORK_TCPV4_SEQ_LEQ(connection->ooo_segments->sequence, connection->rcv_nxt)) {
+        network_tcpv4_segment_t* segment = connection->ooo_segments;
+        connection->ooo_segments = segment->next;
+
+        uint32_t end = segment->sequence + segment->length;
+
+        if(NETWORK_TCPV4_SEQ_GT(end, connection->rcv_nxt)) {
+            uint32_t skip = connection->rcv_nxt - segment->sequence;
+            uint32_t len = end - connection->rcv_nxt;
+            uint32_t written = network_tcpv4_buffer_write(&connection->recv_buffer, network_packet_data(segment->packet) + skip, len);
+
+            connection->rcv_nxt += written;
+            connection->stat_bytes_received += written;
+        }
+
+        if(segment->fin && connection->rcv_nxt == end && !connection->fin_received) {
+            network_tcpv4_consume_fin(connection, now);
+        }
+
+        network_packet_release(segment->packet);
+        memory_free(segment);
+    }
+}
+
+static void network_tcpv4_queue_ooo(network_tcpv4_connection_t* connection, network_packet_t* packet, uint32_t seq, uint32_t len, boolean_t fin) {
+    network_tcpv4_segment_t** pos = &connection->ooo_segments;
+
+    while(*pos && NETWORK_TCPV4_SEQ_LT((*pos)->sequence, seq)) {
+        pos = &(*pos)->next;
+    }
+
+    if(*pos && (*pos)->sequence == seq && (*pos)->length >= len) {
+        // duplicate
+        connection->ooo_last_sequence = seq;
+
+        return;
+    }
+
+    network_tcpv4_segment_t* segment = memory_malloc(sizeof(network_tcpv4_segment_t));
+
+    if(segment == NULL) {
+        return;
+    }
+
+    segment->sequence = seq;
+    segment->length = len;
+    segment->fin = fin;
+    segment->packet = network_packet_ref(packet);
+    segment->next = *pos;
+
+    *pos = segment;
+
+    connection->ooo_last_sequence = seq;
+}
+
+/**
+ * @brief puts payload of a segment into receive ring or out of order queue
+ * @details packet data should start at payload
+ */
+static void network_tcpv4_receive_data(network_tcpv4_connection_t* connection, network_packet_t* packet, uint32_t seq, boolean_t fin, uint64_t now) {
+    uint8_t* data = network_packet_data(packet);
+    uint32_t len = packet->length;
+
+    if(NETWORK_TCPV4_SEQ_LT(seq, connection->rcv_nxt)) {
+        uint32_t skip = connection->rcv_nxt - seq;
+
+        if(skip > len) {
+            return;
+        }
+
+        data += skip;
+        len -= skip;
+        seq = connection->rcv_nxt;
+        network_packet_pull(packet, skip);
+    }
+
+    uint32_t window = network_tcpv4_buffer_free_space(&connection->recv_buffer);
+
+    if(seq - connection->rcv_nxt + len > window) {
+        // bytes beyond window are dropped, peer sends them again
+        uint32_t allowed = seq - connection->rcv_nxt < window?window - (seq - connection->rcv_nxt):0;
+
+        len = allowed;
+        fin = false;
+        network_packet_trim(packet, len);
+    }
+
+    if(seq != connection->rcv_nxt) {
+        if(len || fin) {
+            network_tcpv4_queue_ooo(connection, packet, seq, len, fin);
+        }
+
+        // out of order segments are acked immediately to trigger fast retransmit
+        connection->ack_now = true;
+
+        return;
+    }
+
+    if(len) {
+        uint32_t written = network_tcpv4_buffer_write(&connection->recv_buffer, data, len);
+
+        connection->rcv_nxt += written;
+        connection->stat_bytes_received += written;
+        connection->ack_pending++;
+    }
+
+    if(fin) {
+        network_tcpv4_consume_fin(connection, now);
+    }
+
+    if(connection->ooo_segments) {
+        // a hole is filled
+        network_tcpv4_drain_ooo(connection, now);
+        connection->ack_now = true;
+    }
+
+    if(connection->ack_pending >= 2) {
+        connection->ack_now = true;
+    } else if(connection->ack_pending && connection->delack_deadline == 0) {
+        connection->delack_deadline = now + NETWORK_TCPV4_DELAYED_ACK_MS;
+    }
+}
+
+static void network_tcpv4_apply_syn_options(network_tcpv4_connection_t* connection, const network_tcpv4_options_t* options) {
+    connection->mss = NETWORK_TCPV4_DEFAULT_MSS;
+
+    if(options->mss) {
+        connection->mss = MIN(options->mss, NETWORK_TCPV4_MSS);
+    }
+
+    if(options->window_scale_present) {
+        connection->snd_wscale = options->window_scale;
+        connection->rcv_wscale = NETWORK_TCPV4_WINDOW_SCALE;
+    } else {
+        connection->snd_wscale = 0;
+        connection->rcv_wscale = 0;
+    }
+
+    connection->sack_permitted = options->sack_permitted;
+
+    if(connection->sack_permitted) {
+        // room for sack blocks keeps segments in mtu
+        connection->mss -= 4 + NETWORK_TCPV4_SACK_BLOCKS_PER_SEGMENT * 8;
+    }
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+static network_tcpv4_connection_t* network_tcpv4_connection_create(network_ipv4_address_t local_ip,
+                                                                   uint16_t               local_port,
+                                                                   network_ipv4_address_t remote_ip,
+                                                                   uint16_t               remote_port) {
+    network_tcpv4_connection_t* connection = memory_malloc(sizeof(network_tcpv4_connection_t));
+
+    if(connection == NULL) {
+        return NULL;
+    }
+
+    if(network_tcpv4_buffer_init(&connection->send_buffer, NETWORK_TCPV4_BUFFER_SIZE) != 0 ||
+       network_tcpv4_buffer_init(&connection->recv_buffer, NETWORK_TCPV4_BUFFER_SIZE) != 0) {
+        network_tcpv4_connection_free(connection);
+
+        return NULL;
+    }
+
+    connection->local_ip = local_ip;
+    connection->local_port = local_port;
+    connection->remote_ip = remote_ip;
+    connection->remote_port = remote_port;
+    connection->iss = rand();
+    connection->snd_una = connection->iss;
+    connection->snd_nxt = connection->iss + 1;
+    connection->recover = connection->iss;
+    connection->mss = NETWORK_TCPV4_DEFAULT_MSS;
+    connection->rcv_wscale = NETWORK_TCPV4_WINDOW_SCALE;
+    connection->rto = NETWORK_TCPV4_INITIAL_RTO_MS;
+    connection->congestion_control = NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC;
+
+    network_tcpv4_congestion_init(connection);
+
+    return connection;
+}
+#pragma GCC diagnostic pop
+
+static network_packet_t* network_tcpv4_process_syn_packet(network_packet_t*              packet,
+                                                          network_tcpv4_listener_t*      listener,
+                                                          network_ipv4_address_t         dip,
+                                                          network_ipv4_address_t         sip,
+                                                          const network_tcpv4_header_t*  recv_tcpv4_packet,
+                                                          const network_tcpv4_options_t* options,
+                                                          uint64_t                       now) {
+    network_tcpv4_connection_t* connection = network_tcpv4_connection_create(dip, BYTE_SWAP16(recv_tcpv4_packet->destination_port),
+                                                                             sip, BYTE_SWAP16(recv_tcpv4_packet->source_port));
+
+    if(connection == NULL) {
+        return NULL;
+    }
+
+    connection->state = NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED;
+    connection->unaccepted = true;
+    listener->unaccepted_count++;
+    connection->network_info = packet->network_info;
+    connection->return_queue = packet->return_queue;
+    connection->pool = packet->pool;
+    memory_memcopy(packet->source_mac, connection->remote_mac, sizeof(network_mac_address_t));
+
+    connection->irs = BYTE_SWAP32(recv_tcpv4_packet->sequence_number);
+    connection->rcv_nxt = connection->irs + 1;
+    connection->snd_wnd = BYTE_SWAP16(recv_tcpv4_packet->window_size);
+    connection->snd_wl1 = connection->irs;
+
+    network_tcpv4_apply_syn_options(connection, options);
+    network_tcpv4_congestion_init(connection);
+
+    network_tcpv4_connection_add(connection);
+
+    connection->rtt_start = now;
+    network_tcpv4_arm_rto(connection, now);
+
+    return network_tcpv4_build_segment(connection, connection->iss, 0, true, false);
+}
+
+static network_packet_t* network_tcpv4_process_syn_sent(network_tcpv4_connection_t*    connection,
+                                                        const network_tcpv4_header_t*  recv_tcpv4_packet,
+                                                        const network_tcpv4_options_t* options,
+                                                        uint64_t                       now) {
+    uint32_t seq = BYTE_SWAP32(recv_tcpv4_packet->sequence_number);
+    uint32_t ack = BYTE_SWAP32(recv_tcpv4_packet->acknowledgement_number);
+
+    if(recv_tcpv4_packet->ack && ack != connection->iss + 1) {
+        if(recv_tcpv4_packet->rst) {
+            return NULL;
+        }
+
+        return network_tcpv4_create_reset_packet(connection->pool, connection->local_ip, connection->remote_ip, recv_tcpv4_packet, 0);
+    }
+
+    if(recv_tcpv4_packet->rst) {
+        if(recv_tcpv4_packet->ack) {
+            PRINTLOG(NETWORK, LOG_TRACE, "connection refused");
+            connection->state = NETWORK_TCP_CONNECTION_STATE_CLOSED;
+        }
+
+        return NULL;
+    }
+
+    if(!recv_tcpv4_packet->syn) {
+        return NULL;
+    }
+
+    connection->irs = seq;
+    connection->rcv_nxt = seq + 1;
+
+    network_tcpv4_apply_syn_options(connection, options);
+    network_tcpv4_congestion_init(connection);
+
+    network_tcpv4_segments_t segments = {0};
+
+    if(recv_tcpv4_packet->ack) {
+        connection->snd_una = ack;
+        connection->snd_wnd = (uint32_t)BYTE_SWAP16(recv_tcpv4_packet->window_size) << connection->snd_wscale;
+        connection->snd_wl1 = seq;
+        connection->snd_wl2 = ack;
+        connection->state = NETWORK_TCP_CONNECTION_STATE_ESTABLISHED;
+        connection->rto_deadline = 0;
+
+        if(connection->retries == 0) {
+            network_tcpv4_update_rtt(connection, now - connection->rtt_start);
+        }
+
+        connection->retries = 0;
+        connection->ack_now = true;
+
+        network_tcpv4_output(connection, now, &segments);
+
+        PRINTLOG(NETWORK, LOG_TRACE, "connection established to port %i", connection->remote_port);
+    } else {
+        // simultaneous open
+        connection->state = NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED;
+        network_tcpv4_segments_append(&segments, network_tcpv4_build_segment(connection, connection->iss, 0, true, false));
+    }
+
+    return segments.head;
+}
+
+static boolean_t network_tcpv4_is_acceptable(const network_tcpv4_connection_t* connection, uint32_t seq, uint32_t segment_length) {
+    uint32_t window = connection->rcv_adv - connection->rcv_nxt;
+
+    if(NETWORK_TCPV4_SEQ_LT(connection->rcv_adv, connection->rcv_nxt)) {
+        window = 0;
+    }
+
+    boolean_t start_in = NETWORK_TCPV4_SEQ_GEQ(seq, connection->rcv_nxt) && NETWORK_TCPV4_SEQ_LT(seq, connection->rcv_nxt + window);
+
+    if(segment_length == 0) {
+        return window == 0?seq == connection->rcv_nxt:(start_in || seq == connection->rcv_nxt);
+    }
+
+    if(window == 0) {
+        return false;
+    }
+
+    uint32_t last = seq + segment_length - 1;
+
+    return start_in || (NETWORK_TCPV4_SEQ_GEQ(last, connection->rcv_nxt) && NETWORK_TCPV4_SEQ_LT(last, connection->rcv_nxt + window));
+}
+
+/**
+ * @brief segment arrival at synchronized states (rfc 9293 3.10.7.4)
+ */
+static void network_tcpv4_process_segment(network_tcpv4_connection_t*    connection,
+                                          network_packet_t*              packet,
+                                          const network_tcpv4_header_t*  recv_tcpv4_packet,
+                                          const network_tcpv4_options_t* options,
+                                          uint64_t                       now,
+                                          network_tcpv4_segments_t*      segments) {
+    uint32_t seq = BYTE_SWAP32(recv_tcpv4_packet->sequence_number);
+    uint32_t data_length = packet->length;
+    uint32_t segment_length = data_length + recv_tcpv4_packet->syn + recv_tcpv4_packet->fin;
+
+    if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED && recv_tcpv4_packet->syn && !recv_tcpv4_packet->ack && seq == connection->irs) {
+        // our syn ack is lost
+        network_tcpv4_segments_append(segments, network_tcpv4_build_segment(connection, connection->iss, 0, true, false));
+
+        return;
+    }
+
+    if(!network_tcpv4_is_acceptable(connection, seq, segment_length)) {
+        if(!recv_tcpv4_packet->rst) {
+            connection->ack_now = true;
+        }
+
+        return;
+    }
+
+    if(recv_tcpv4_packet->rst) {
+        // blind reset mitigation (rfc 5961 3.2), real peer answers challenge ack with an exact reset
+        if(seq != connection->rcv_nxt) {
+            connection->ack_now = true;
+
+            return;
+        }
+
+        PRINTLOG(NETWORK, LOG_TRACE, "connection reset");
+        connection->state = NETWORK_TCP_CONNECTION_STATE_CLOSED;
+
+        return;
+    }
+
+    if(recv_tcpv4_packet->syn) {
+        // challenge ack (rfc 5961)
+        connection->ack_now = true;
+
+        return;
+    }
+
+    if(!recv_tcpv4_packet->ack) {
+        return;
+    }
+
+    uint32_t ack = BYTE_SWAP32(recv_tcpv4_packet->acknowledgement_number);
+
+    if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED) {
+        if(NETWORK_TCPV4_SEQ_LEQ(ack, connection->snd_una) || NETWORK_TCPV4_SEQ_GT(ack, connection->snd_nxt)) {
+            network_tcpv4_segments_append(segments, network_tcpv4_create_reset_packet(connection->pool, connection->local_ip, connection->remote_ip,
+                                                                                     recv_tcpv4_packet, segment_length));
+
+            return;
+        }
+
+        // syn is acknowledged, it has no byte at send buffer
+        connection->snd_una++;
+        connection->snd_wnd = (uint32_t)BYTE_SWAP16(recv_tcpv4_packet->window_size) << connection->snd_wscale;
+        connection->snd_wl1 = seq;
+        connection->snd_wl2 = ack;
+        connection->state = NETWORK_TCP_CONNECTION_STATE_ESTABLISHED;
+        connection->rto_deadline = 0;
+
+        if(connection->retries == 0) {
+            network_tcpv4_update_rtt(connection, now - connection->rtt_start);
+        }
+
+        connection->retries = 0;
+
+        PRINTLOG(NETWORK, LOG_TRACE, "connection established from port %i", connection->remote_port);
+
+        if(connection->unaccepted) {
+            network_tcpv4_listener_t* listener = network_tcpv4_listener_get(connection->local_ip, connection->local_port);
+
+            if(listener) {
+                network_tcpv4_accept_queue_push(listener, connection);
+            }
+        }
+    }
+
+    if(network_tcpv4_process_ack(connection, recv_tcpv4_packet, options, data_length, now) != 0) {
+        connection->ack_now = true;
+
+        return;
+    }
+
+    boolean_t fin_acked = connection->fin_sent && NETWORK_TCPV4_SEQ_GT(connection->snd_una, connection->fin_sequence);
+
+    if(fin_acked) {
+        if(connection->state == NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_1) {
+            connection->state = NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_2;
+        } else if(connection->state == NETWORK_TCP_CONNECTION_STATE_CLOSING) {
+            connection->state = NETWORK_TCP_CONNECTION_STATE_TIME_WAIT;
+            connection->close_deadline = now + NETWORK_TCPV4_TIME_WAIT_MS;
+        } else if(connection->state == NETWORK_TCP_CONNECTION_STATE_LAST_ACK) {
+            connection->state = NETWORK_TCP_CONNECTION_STATE_CLOSED;
+
+            return;
+        }
+    }
+
+    if(connection->state == NETWORK_TCP_CONNECTION_STATE_ESTABLISHED ||
+       connection->state == NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_1 ||
+       connection->state == NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_2) {
+        if(data_length || recv_tcpv4_packet->fin) {
+            network_tcpv4_receive_data(connection, packet, seq, recv_tcpv4_packet->fin, now);
+        }
+    } else if(recv_tcpv4_packet->fin || data_length) {
+        // retransmitted fin or data after fin
+        connection->ack_now = true;
+
+        if(connection->state == NETWORK_TCP_CONNECTION_STATE_TIME_WAIT) {
+            connection->close_deadline = now + NETWORK_TCPV4_TIME_WAIT_MS;
+        }
+    }
+}
+
+network_packet_t* network_tcpv4_process_packet(network_packet_t* packet, network_ipv4_address_t dip, network_ipv4_address_t sip) {
+    if (packet == NULL) {
+        PRINTLOG(NETWORK, LOG_ERROR, "packet is NULL");
+        return NULL;
+    }
+
+    network_tcpv4_header_t* recv_tcpv4_packet = (network_tcpv4_header_t*)network_packet_data(packet);
+    uint16_t packet_len = packet->length;
+    network_tcpv4_options_t options = {0};
+
+    if(packet_len < sizeof(network_tcpv4_header_t) ||
+       recv_tcpv4_packet->header_length < 5 ||
+       recv_tcpv4_packet->header_length * 4 > packet_len ||
+       (!(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_VERIFIED) &&
+        network_tcpv4_generate_checksum(recv_tcpv4_packet, packet_len, sip, dip) != 0) ||
+       network_tcpv4_parse_options(recv_tcpv4_packet, &options) != 0) {
+        PRINTLOG(NETWORK, LOG_TRACE, "tcp segment is malformed");
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    network_tcpv4_dump_packet(dip, sip, recv_tcpv4_packet, packet_len);
+
+    uint64_t now = network_tcpv4_clock();
+    uint16_t source_port = BYTE_SWAP16(recv_tcpv4_packet->source_port);
+    uint16_t dest_port = BYTE_SWAP16(recv_tcpv4_packet->destination_port);
+    uint32_t data_length = packet_len - recv_tcpv4_packet->header_length * 4;
+    network_tcpv4_segments_t segments = {0};
+
+    // header stays at headroom, data of packet is payload from now on
+    network_packet_pull(packet, recv_tcpv4_packet->header_length * 4);
+
+    network_tcpv4_lock();
+
+    network_tcpv4_connection_t* connection = network_tcpv4_connection_get(dip, dest_port, sip, source_port);
+
+    if(connection == NULL) {
+        network_tcpv4_listener_t* listener = network_tcpv4_listener_get(dip, dest_port);
+
+        if(listener && listener->listening && recv_tcpv4_packet->syn && !recv_tcpv4_packet->ack && !recv_tcpv4_packet->rst) {
+            if(listener->unaccepted_count < listener->backlog) {
+                network_tcpv4_segments_append(&segments, network_tcpv4_process_syn_packet(packet, listener, dip, sip, recv_tcpv4_packet, &options, now));
+            } else {
+                // full backlog drops syn silently, peer retransmits it
+                PRINTLOG(NETWORK, LOG_TRACE, "backlog of port %i is full", dest_port);
+            }
+        } else if(!recv_tcpv4_packet->rst) {
+            uint32_t segment_length = data_length + recv_tcpv4_packet->syn + recv_tcpv4_packet->fin;
+
+            network_tcpv4_segments_append(&segments, network_tcpv4_create_reset_packet(packet->pool, dip, sip, recv_tcpv4_packet, segment_length));
+        }
+
+        network_tcpv4_unlock();
+
+        network_packet_release(packet);
+
+        return segments.head;
+    }
+
+    if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_SENT) {
+        network_tcpv4_segments_append(&segments, network_tcpv4_process_syn_sent(connection, recv_tcpv4_packet, &options, now));
+    } else {
+        network_tcpv4_process_segment(connection, packet, recv_tcpv4_packet, &options, now, &segments);
+    }
+
+    network_packet_release(packet);
+
+    if(connection->state == NETWORK_TCP_CONNECTION_STATE_CLOSED) {
+        network_tcpv4_connection_del(connection);
+    } else {
+        network_tcpv4_output(connection, now, &segments);
+        network_tcpv4_notify_owner(connection->owner, false);
+    }
+
+    network_tcpv4_unlock();
+
+    return segments.head;
+}
+
+static void network_tcpv4_retransmit_timeout(network_tcpv4_connection_t* connection, uint64_t now, network_tcpv4_segments_t* segments) {
+    if(connection->snd_una == connection->snd_nxt || connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_SENT ||
+       connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED) {
+        uint32_t unsent = connection->snd_una + connection->send_buffer.length - connection->snd_nxt;
+
+        if(connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_SENT || connection->state == NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED) {
+            network_tcpv4_segments_append(segments, network_tcpv4_build_segment(connection, connection->iss, 0, true, false));
+        } else if(unsent && connection->snd_wnd == 0) {
+            // persist probe, an old sequence makes peer answer with its window
+            network_tcpv4_segments_append(segments, network_tcpv4_build_segment(connection, connection->snd_una - 1, 0, false, false));
+        } else {
+            connection->rto_deadline = 0;
+
+            return;
+        }
+
+        connection->retries++;
+        network_tcpv4_arm_rto(connection, now);
+
+        return;
+    }
+
+    connection->retries++;
+    connection->stat_timeouts++;
+
+    network_tcpv4_congestion_on_timeout(connection, now);
+
+    // everything in flight is lost, sack information may be reneged
+    connection->in_recovery = true;
+    connection->timeout_recovery = true;
+    connection->recover = connection->snd_nxt;
+    connection->rexmit_high = connection->snd_una;
+    connection->lost_high = connection->snd_nxt;
+    connection->sack_count = 0;
+    connection->dupacks = 0;
+    connection->rtt_active = false;
+
+    PRINTLOG(NETWORK, LOG_TRACE, "retransmission timeout at 0x%x, retry %i", connection->snd_una, connection->retries);
+
+    network_tcpv4_arm_rto(connection, now);
+    network_tcpv4_output(connection, now, segments);
+}
+
+static boolean_t network_tcpv4_connection_timers(network_tcpv4_connection_t* connection, uint64_t now) {
+    network_tcpv4_segments_t segments = {0};
+
+    if(connection->state == NETWORK_TCP_CONNECTION_STATE_TIME_WAIT) {
+        return now < connection->close_deadline;
+    }
+
+    if(connection->rto_deadline && now >= connection->rto_deadline) {
+        if(connection->retries >= NETWORK_TCPV4_MAX_RETRIES) {
+            PRINTLOG(NETWORK, LOG_TRACE, "connection to port %i timed out", connection->remote_port);
+
+            return false;
+        }
+
+        network_tcpv4_retransmit_timeout(connection, now, &segments);
+    }
+
+    if(connection->delack_deadline && now >= connection->delack_deadline) {
+        connection->ack_now = true;
+    }
+
+    if(connection->ack_now) {
+        network_tcpv4_output(connection, now, &segments);
+    }
+
+    network_tcpv4_transmit(connection, segments.head);
+
+    return true;
+}
+
+void network_tcpv4_process_timers(void) {
+    static uint64_t last_run = 0;
+
+    network_tcpv4_lock();
+
+    uint64_t now = network_tcpv4_clock();
+
+    if(network_tcpv4_listener_ip_map == NULL || now == last_run) {
+        network_tcpv4_unlock();
+
+        return;
+    }
+
+    last_run = now;
+
+    list_t* expired = NULL;
+    iterator_t* iter = hashmap_iterator_create(network_tcpv4_listener_ip_map);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        const network_tcpv4_listener_t* listener = iter->get_item(iter);
+        iterator_t* conn_iter = hashmap_iterator_create(listener->connections);
+
+        while(conn_iter->end_of_iterator(conn_iter) != 0) {
+            network_tcpv4_connection_t* connection = (network_tcpv4_connection_t*)conn_iter->get_item(conn_iter);
+
+            if(!network_tcpv4_connection_timers(connection, now)) {
+                if(expired == NULL) {
+                    expired = list_create_queue();
+                }
+
+                list_queue_push(expired, connection);
+            }
+
+            conn_iter = conn_iter->next(conn_iter);
+        }
+
+        conn_iter->destroy(conn_iter);
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(expired) {
+        // maps are not modified while iterating
+        while(list_size(expired)) {
+            network_tcpv4_connection_del((network_tcpv4_connection_t*)list_queue_pop(expired));
+        }
+
+        list_destroy(expired);
+    }
+
+    network_tcpv4_unlock();
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+network_tcpv4_connection_t* network_tcpv4_connect(void*                  network_info,
+                                                  network_tx_queue_t*    return_queue,
+                                                  network_mac_address_t  remote_mac,
+                                                  network_packet_pool_t* pool,
+                                                  network_ipv4_address_t local_ip,
+                                                  uint16_t               local_port,
+                                                  network_ipv4_address_t remote_ip,
+                                                  uint16_t               remote_port) {
+    network_tcpv4_lock();
+
+    if(network_tcpv4_connection_get(local_ip, local_port, remote_ip, remote_port) != NULL) {
+        network_tcpv4_unlock();
+
+        return NULL;
+    }
+
+    if(network_tcpv4_listener_get(local_ip, local_port) == NULL && network_tcpv4_listener_create(local_ip, local_port, false) == NULL) {
+        network_tcpv4_unlock();
+
+        return NULL;
+    }
+
+    network_tcpv4_connection_t* connection = network_tcpv4_connection_create(local_ip, local_port, remote_ip, remote_port);
+
+    if(connection == NULL) {
+        network_tcpv4_unlock();
+
+        return NULL;
+    }
+
+    uint64_t now = network_tcpv4_clock();
+
+    connection->state = NETWORK_TCP_CONNECTION_STATE_SYN_SENT;
+    connection->network_info = network_info;
+    connection->return_queue = return_queue;
+    connection->pool = pool;
+    memory_memcopy(remote_mac, connection->remote_mac, sizeof(network_mac_address_t));
+    connection->rtt_start = now;
+
+    network_tcpv4_connection_add(connection);
+
+    network_tcpv4_arm_rto(connection, now);
+    network_tcpv4_transmit(connection, network_tcpv4_build_segment(connection, connection->iss, 0, true, false));
+
+    network_tcpv4_unlock();
+
+    return connection;
+}
+#pragma GCC diagnostic pop
+
+int64_t network_tcpv4_send(network_tcpv4_connection_t* connection, const uint8_t* data, uint64_t len) {
+    if(connection == NULL || data == NULL) {
+        return -1;
+    }
+
+    network_tcpv4_lock();
+
+    if(connection->fin_queued || connection->state == NETWORK_TCP_CONNECTION_STATE_CLOSED) {
+        network_tcpv4_unlock();
+
+        return -1;
+    }
+
+    if(len > 0xFFFFFFFFULL) {
+        len = 0xFFFFFFFFULL;
+    }
+
+    uint32_t written = network_tcpv4_buffer_write(&connection->send_buffer, data, len);
+
+    if(written && (connection->state == NETWORK_TCP_CONNECTION_STATE_ESTABLISHED || connection->state == NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT)) {
+        network_tcpv4_segments_t segments = {0};
+
+        network_tcpv4_output(connection, network_tcpv4_clock(), &segments);
+        network_tcpv4_transmit(connection, segments.head);
+    }
+
+    network_tcpv4_unlock();
+
+    return written;
+}
+
+int64_t network_tcpv4_recv(network_tcpv4_connection_t* connection, uint8_t* data, uint64_t len) {
+    if(connection == NULL || data == NULL) {
+        return -1;
+    }
+
+    network_tcpv4_lock();
+
+    uint32_t available = connection->recv_buffer.length;
+
+    if(available == 0) {
+        network_tcpv4_unlock();
+
+        return connection->fin_received?-1:0;
+    }
+
+    if(len < available) {
+        available = len;
+    }
+
+    uint32_t old_window = connection->rcv_adv - connection->rcv_nxt;
+
+    network_tcpv4_buffer_peek(&connection->recv_buffer, 0, data, available);
+    network_tcpv4_buffer_drop(&connection->recv_buffer, available);
+
+    uint32_t new_window = network_tcpv4_receive_window(connection);
+
+    // receiver side silly window avoidance, update is sent when window opens by a meaningful amount
+    if(!connection->fin_received && new_window > old_window && new_window - old_window >= MIN(2U * connection->mss, connection->recv_buffer.capacity / 2)) {
+        network_tcpv4_segments_t segments = {0};
+
+        connection->ack_now = true;
+        network_tcpv4_output(connection, network_tcpv4_clock(), &segments);
+        network_tcpv4_transmit(connection, segments.head);
+    }
+
+    network_tcpv4_unlock();
+
+    return available;
+}
+
+int8_t network_tcpv4_close(network_tcpv4_connection_t* connection) {
+    if(connection == NULL) {
+        return -1;
+    }
+
+    network_tcpv4_lock();
+
+    switch(connection->state) {
+    case NETWORK_TCP_CONNECTION_STATE_SYN_SENT:
+        network_tcpv4_connection_del(connection);
+        network_tcpv4_unlock();
+        return 0;
+    case NETWORK_TCP_CONNECTION_STATE_SYN_RECEIVED:
+    case NETWORK_TCP_CONNECTION_STATE_ESTABLISHED:
+        connection->state = NETWORK_TCP_CONNECTION_STATE_FIN_WAIT_1;
+        break;
+    case NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT:
+        connection->state = NETWORK_TCP_CONNECTION_STATE_LAST_ACK;
+        break;
+    default:
+        network_tcpv4_unlock();
+        return -1;
+    }
+
+    connection->fin_queued = true;
+
+    network_tcpv4_segments_t segments = {0};
+
+    network_tcpv4_output(connection, network_tcpv4_clock(), &segments);
+    network_tcpv4_transmit(connection, segments.head);
+
+    network_tcpv4_unlock();
+
+    return 0;
+}
+
+void network_tcpv4_abort(network_tcpv4_connection_t* connection) {
+    if(connection == NULL) {
+        return;
+    }
+
+    network_tcpv4_lock();
+
+    if(connection->state != NETWORK_TCP_CONNECTION_STATE_SYN_SENT && connection->state != NETWORK_TCP_CONNECTION_STATE_TIME_WAIT) {
+        network_packet_t* packet = network_tcpv4_build_segment(connection, connection->snd_nxt, 0, false, false);
+
+        if(packet) {
+            network_tcpv4_header_t* res = (network_tcpv4_header_t*)network_packet_data(packet);
+
+            // flags share a word with header length, only that word changes
+            uint16_t* flags_word = (uint16_t*)((uint8_t*)res + offsetof_field(network_tcpv4_header_t, window_size) - sizeof(uint16_t));
+            uint16_t old_flags = *flags_word;
+
+            res->rst = 1;
+
+            if(!(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_OFFLOAD)) {
+                res->checksum = network_checksum_update16(res->checksum, old_flags, *flags_word);
+            }
+
+            network_tcpv4_transmit(connection, packet);
+        }
+    }
+
+    connection->owner = NULL;
+
+    network_tcpv4_connection_del(connection);
+
+    network_tcpv4_unlock();
+}
+
+void network_tcpv4_unlisten(network_tcpv4_listener_t* listener) {
+    if(listener == NULL) {
+        return;
+    }
+
+    network_tcpv4_lock();
+
+    listener->listening = false;
+    listener->owner = NULL;
+
+    list_t* unaccepted = NULL;
+    iterator_t* iter = hashmap_iterator_create(listener->connections);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        network_tcpv4_connection_t* connection = (network_tcpv4_connection_t*)iter->get_item(iter);
+
+        if(connection->unaccepted) {
+            if(unaccepted == NULL) {
+                unaccepted = list_create_queue();
+            }
+
+            list_queue_push(unaccepted, connection);
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(unaccepted) {
+        // last abort frees listener if there is no accepted connection
+        while(list_size(unaccepted)) {
+            network_tcpv4_abort((network_tcpv4_connection_t*)list_queue_pop(unaccepted));
+        }
+
+        list_destroy(unaccepted);
+    } else {
+        network_tcpv4_listener_release_if_unused(listener);
+    }
+
+    network_tcpv4_unlock();
+}
+
+void network_tcpv4_set_congestion_control(network_tcpv4_connection_t* connection, network_tcpv4_congestion_control_t congestion_control) {
+    if(connection == NULL) {
+        return;
+    }
+
+    connection->congestion_control = congestion_control;
+    connection->cubic.epoch_start = 0;
 }
-#pragma GCC diagnostic pop
@@ -0,0 +1,202 @@
+/**
+ * @file network_tcpv4_congestion.64.c
+ * @brief TCPv4 congestion control, NewReno (rfc 5681, rfc 6582) and CUBIC (rfc 9438).
+ *
+ * windows are in bytes. slow start is shared, algorithms differ at congestion avoidance and at reduction.
+ * cubic function is evaluated with integer arithmetic, time is in milliseconds.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_tcpv4.h>
+#include <logging.h>
+
+MODULE("turnstone.lib.network");
+
+/*! cubic multiplicative decrease factor 0.7 as per mille */
+#define NETWORK_TCPV4_CUBIC_BETA        700
+/*! reno friendly additive increase 3 * (1 - beta) / (1 + beta) as per mille */
+#define NETWORK_TCPV4_CUBIC_ALPHA       529
+/*! cubic time distance limit, keeps cube of it in 64 bits */
+#define NETWORK_TCPV4_CUBIC_MAX_TIME_MS 100000LL
+
+static uint64_t network_tcpv4_cubic_root(uint64_t x) {
+    uint64_t y = 0;
+
+    for(int32_t s = 63; s >= 0; s -= 3) {
+        y += y;
+
+        uint64_t b = 3 * y * (y + 1) + 1;
+
+        if((x >> s) >= b) {
+            x -= b << s;
+            y++;
+        }
+    }
+
+    return y;
+}
+
+static uint32_t network_tcpv4_flight_size(const network_tcpv4_connection_t* connection) {
+    return connection->snd_nxt - connection->snd_una;
+}
+
+void network_tcpv4_congestion_init(network_tcpv4_connection_t* connection) {
+    connection->cwnd = NETWORK_TCPV4_INITIAL_WINDOW_SEGMENTS * connection->mss;
+    connection->ssthresh = 0xFFFFFFFF;
+    connection->ca_acked = 0;
+    connection->cubic.epoch_start = 0;
+    connection->cubic.w_max = 0;
+    connection->cubic.w_last_max = 0;
+}
+
+static void network_tcpv4_newreno_on_ack(network_tcpv4_connection_t* connection, uint32_t acked) {
+    // appropriate byte counting, a window is added once per window of acked bytes
+    connection->ca_acked += acked;
+
+    if(connection->ca_acked >= connection->cwnd) {
+        connection->ca_acked -= connection->cwnd;
+        connection->cwnd += connection->mss;
+    }
+}
+
+static void network_tcpv4_cubic_on_ack(network_tcpv4_connection_t* connection, uint32_t acked, uint64_t now) {
+    network_tcpv4_cubic_t* cubic = &connection->cubic;
+    uint32_t mss = connection->mss;
+
+    if(cubic->epoch_start == 0) {
+        cubic->epoch_start = now;
+        cubic->w_est = connection->cwnd;
+
+        if(connection->cwnd < cubic->w_max) {
+            // K = cbrt((w_max - cwnd) / C) with C 0.4 segments per second cube
+            uint64_t distance = cubic->w_max - connection->cwnd;
+
+            cubic->k_ms = network_tcpv4_cubic_root(distance * 2500000000ULL / mss);
+            cubic->origin = cubic->w_max;
+        } else {
+            cubic->k_ms = 0;
+            cubic->origin = connection->cwnd;
+        }
+    }
+
+    uint64_t rtt = connection->srtt_x8 >> 3;
+
+    if(rtt == 0) {
+        rtt = NETWORK_TCPV4_MIN_RTO_MS;
+    }
+
+    // target is window after one rtt
+    int64_t t = now - cubic->epoch_start + rtt - cubic->k_ms;
+
+    if(t > NETWORK_TCPV4_CUBIC_MAX_TIME_MS) {
+        t = NETWORK_TCPV4_CUBIC_MAX_TIME_MS;
+    } else if(t < -NETWORK_TCPV4_CUBIC_MAX_TIME_MS) {
+        t = -NETWORK_TCPV4_CUBIC_MAX_TIME_MS;
+    }
+
+    int64_t target = cubic->origin + (t * t * t * mss * 2) / 5000000000LL;
+
+    if(target < mss) {
+        target = mss;
+    }
+
+    // window growth is limited to half of window per rtt
+    if(target > connection->cwnd + connection->cwnd / 2) {
+        target = connection->cwnd + connection->cwnd / 2;
+    }
+
+    cubic->w_est += (uint64_t)NETWORK_TCPV4_CUBIC_ALPHA * acked * mss / 1000 / connection->cwnd;
+
+    if(cubic->w_est > target) {
+        target = cubic->w_est;
+    }
+
+    uint64_t growth = mss / 100;
+
+    if(target > connection->cwnd) {
+        growth = target - connection->cwnd;
+    }
+
+    // acked bytes are accumulated until they produce at least one byte of growth
+    connection->ca_acked += acked;
+
+    uint64_t inc = growth * connection->ca_acked / connection->cwnd;
+
+    if(inc) {
+        connection->cwnd += inc;
+        connection->ca_acked = 0;
+    }
+}
+
+void network_tcpv4_congestion_on_ack(network_tcpv4_connection_t* connection, uint32_t acked, uint64_t now) {
+    if(connection->cwnd < connection->ssthresh) {
+        // slow start with abc limit of two segments per ack (rfc 3465)
+        uint32_t inc = acked;
+
+        if(inc > 2U * connection->mss) {
+            inc = 2U * connection->mss;
+        }
+
+        connection->cwnd += inc;
+
+        return;
+    }
+
+    if(connection->congestion_control == NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC) {
+        network_tcpv4_cubic_on_ack(connection, acked, now);
+    } else {
+        network_tcpv4_newreno_on_ack(connection, acked);
+    }
+}
+
+static uint32_t network_tcpv4_congestion_reduce(network_tcpv4_connection_t* connection) {
+    uint32_t min_ssthresh = 2U * connection->mss;
+    uint32_t ssthresh;
+
+    if(connection->congestion_control == NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC) {
+        network_tcpv4_cubic_t* cubic = &connection->cubic;
+
+        // fast convergence releases bandwidth for new flows
+        if(connection->cwnd < cubic->w_last_max) {
+            cubic->w_last_max = connection->cwnd;
+            cubic->w_max = (uint64_t)connection->cwnd * (1000 + NETWORK_TCPV4_CUBIC_BETA) / 2000;
+        } else {
+            cubic->w_last_max = connection->cwnd;
+            cubic->w_max = connection->cwnd;
+        }
+
+        cubic->epoch_start = 0;
+
+        ssthresh = (uint64_t)connection->cwnd * NETWORK_TCPV4_CUBIC_BETA / 1000;
+    } else {
+        ssthresh = network_tcpv4_flight_size(connection) / 2;
+    }
+
+    if(ssthresh < min_ssthresh) {
+        ssthresh = min_ssthresh;
+    }
+
+    connection->ca_acked = 0;
+
+    return ssthresh;
+}
+
+void network_tcpv4_congestion_on_loss(network_tcpv4_connection_t* connection, uint64_t now) {
+    UNUSED(now);
+
+    connection->ssthresh = network_tcpv4_congestion_reduce(connection);
+    connection->cwnd = connection->ssthresh;
+
+    PRINTLOG(NETWORK, LOG_TRACE, "fast retransmit cwnd 0x%x", connection->cwnd);
+}
+
+void network_tcpv4_congestion_on_timeout(network_tcpv4_connection_t* connection, uint64_t now) {
+    UNUSED(now);
+
+    connection->ssthresh = network_tcpv4_congestion_reduce(connection);
+    connection->cwnd = connection->mss;
+
+    PRINTLOG(NETWORK, LOG_TRACE, "retransmission timeout ssthresh 0x%x", connection->ssthresh);
+}
@@ -0,0 +1,228 @@
+/**
+ * @file network_tx_queue.64.c
+ * @brief network transmit queue implementation.
+ *
+ * slot sequence equals its position when slot is free for that position and position + 1 when a packet
+ * is published there. consumer frees a slot by setting sequence to position + capacity before moving
+ * head, so a producer which saw head has its reserved slots free.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_tx_queue.h>
+#include <memory.h>
+#include <logging.h>
+#include <utils.h>
+
+MODULE("turnstone.lib.network");
+
+typedef struct network_tx_queue_slot_t {
+    volatile uint64_t sequence; ///< position which may use slot next, + 1 when published
+    network_packet_t* packet; ///< published packet
+} network_tx_queue_slot_t;
+
+struct network_tx_queue_t {
+    memory_heap_t*            heap; ///< heap of queue allocations
+    uint64_t                  capacity; ///< slot count, power of two
+    network_tx_queue_slot_t*  slots; ///< slots
+    network_tx_queue_waker_f  waker; ///< wakes consumer
+    uint64_t                  consumer_task_id; ///< consumer task
+    volatile uint64_t         head __attribute__((aligned(64))); ///< next position to pop, written by consumer
+    volatile boolean_t        consumer_waiting; ///< consumer sleeps until a push
+    volatile uint64_t         tail __attribute__((aligned(64))); ///< next position to reserve, written by producers
+} __attribute__((aligned(64)));
+
+network_tx_queue_t* network_tx_queue_create(memory_heap_t* heap, uint64_t capacity) {
+    if(capacity == 0 || capacity > (1ULL << 32)) {
+        return NULL;
+    }
+
+    uint64_t slot_count = 1;
+
+    while(slot_count < capacity) {
+        slot_count <<= 1;
+    }
+
+    network_tx_queue_t* queue = memory_malloc_ext(heap, sizeof(network_tx_queue_t), 64);
+
+    if(queue == NULL) {
+        return NULL;
+    }
+
+    queue->slots = memory_malloc_ext(heap, sizeof(network_tx_queue_slot_t) * slot_count, 64);
+
+    if(queue->slots == NULL) {
+        memory_free_ext(heap, queue);
+
+        return NULL;
+    }
+
+    queue->heap = heap;
+    queue->capacity = slot_count;
+    queue->waker = NULL;
+    queue->consumer_task_id = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->consumer_waiting = false;
+
+    for(uint64_t i = 0; i < slot_count; i++) {
+        queue->slots[i].sequence = i;
+        queue->slots[i].packet = NULL;
+    }
+
+    return queue;
+}
+
+int8_t network_tx_queue_destroy(network_tx_queue_t* queue) {
+    if(queue == NULL) {
+        return -1;
+    }
+
+    network_packet_t* packets[64];
+    uint64_t count = 0;
+
+    while((count = network_tx_queue_pop_batch(queue, packets, 64)) != 0) {
+        for(uint64_t i = 0; i < count; i++) {
+            network_packet_release(packets[i]);
+        }
+    }
+
+    memory_heap_t* heap = queue->heap;
+
+    memory_free_ext(heap, queue->slots);
+    memory_free_ext(heap, queue);
+
+    return 0;
+}
+
+int8_t network_tx_queue_set_consumer(network_tx_queue_t* queue, uint64_t task_id, network_tx_queue_waker_f waker) {
+    if(queue == NULL) {
+        return -1;
+    }
+
+    queue->consumer_task_id = task_id;
+    queue->waker = waker;
+
+    return 0;
+}
+
+int8_t network_tx_queue_push(network_tx_queue_t* queue, network_packet_t* packets) {
+    if(queue == NULL || packets == NULL) {
+        return -1;
+    }
+
+    uint64_t count = 0;
+
+    for(network_packet_t* packet = packets; packet; packet = packet->next) {
+        count++;
+    }
+
+    if(count > queue->capacity) {
+        return -1;
+    }
+
+    uint64_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+
+    do {
+        uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+        if(pos + count - head > queue->capacity) {
+            PRINTLOG(NETWORK, LOG_TRACE, "tx queue is full");
+
+            return -1;
+        }
+    } while(!__atomic_compare_exchange_n(&queue->tail, &pos, pos + count, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    uint64_t mask = queue->capacity - 1;
+
+    while(packets) {
+        network_packet_t* packet = packets;
+        packets = packet->next;
+        packet->next = NULL;
+
+        network_tx_queue_slot_t* slot = &queue->slots[pos & mask];
+
+        slot->packet = packet;
+        __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+        pos++;
+    }
+
+    // publish is ordered before waiting flag is read, pairs with fence of network_tx_queue_prepare_wait
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&queue->consumer_waiting, __ATOMIC_RELAXED) &&
+       __atomic_exchange_n(&queue->consumer_waiting, false, __ATOMIC_ACQ_REL) && queue->waker) {
+        queue->waker(queue->consumer_task_id);
+    }
+
+    return 0;
+}
+
+uint64_t network_tx_queue_pop_batch(network_tx_queue_t* queue, network_packet_t** packets, uint64_t max) {
+    if(queue == NULL || packets == NULL) {
+        return 0;
+    }
+
+    uint64_t mask = queue->capacity - 1;
+    uint64_t pos = queue->head;
+    uint64_t count = 0;
+
+    while(count < max) {
+        network_tx_queue_slot_t* slot = &queue->slots[pos & mask];
+
+        // a reserved slot which is not published yet stops batch, order is kept
+        if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1) {
+            break;
+        }
+
+        packets[count++] = slot->packet;
+        slot->packet = NULL;
+
+        __atomic_store_n(&slot->sequence, pos + queue->capacity, __ATOMIC_RELEASE);
+
+        pos++;
+    }
+
+    if(count) {
+        __atomic_store_n(&queue->head, pos, __ATOMIC_RELEASE);
+    }
+
+    return count;
+}
+
+boolean_t network_tx_queue_prepare_wait(network_tx_queue_t* queue) {
+    if(queue == NULL) {
+        return true;
+    }
+
+    __atomic_store_n(&queue->consumer_waiting, true, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t pos = queue->head;
+
+    if(__atomic_load_n(&queue->slots[pos & (queue->capacity - 1)].sequence, __ATOMIC_ACQUIRE) == pos + 1) {
+        __atomic_store_n(&queue->consumer_waiting, false, __ATOMIC_RELAXED);
+
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t network_tx_queue_size(network_tx_queue_t* queue) {
+    if(queue == NULL) {
+        return 0;
+    }
+
+    return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t network_tx_queue_get_free_count(network_tx_queue_t* queue) {
+    if(queue == NULL) {
+        return 0;
+    }
+
+    return queue->capacity - network_tx_queue_size(queue);
+}
@@ -9,6 +9,7 @@
 #include <network/network_udpv4.h>
 #include <network/network_ipv4.h>
 #include <network/network_dhcpv4.h>
+#include <network/network_checksum.h>
 #include <utils.h>
 #include <memory.h>
 #include <logging.h>
@@ -17,78 +18,100 @@
 
 MODULE("turnstone.lib.network");
 
-uint8_t* network_udpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_udpv4_header_t* recv_udpv4_packet, void* network_info, uint16_t* return_packet_len) {
-    UNUSED(network_info);
-    UNUSED(return_packet_len);
-    UNUSED(sip);
-    UNUSED(dip);
+static network_udpv4_receiver_f network_udpv4_receiver = NULL;
+
+void network_udpv4_set_receiver(network_udpv4_receiver_f receiver) {
+    network_udpv4_receiver = receiver;
+}
+
+network_packet_t* network_udpv4_process_packet(network_packet_t* packet, network_ipv4_address_t dip, network_ipv4_address_t sip) {
+    if(packet == NULL) {
+        return NULL;
+    }
+
+    const network_udpv4_header_t* recv_udpv4_packet = (network_udpv4_header_t*)network_packet_data(packet);
+
+    if(packet->length < sizeof(network_udpv4_header_t) ||
+       BYTE_SWAP16(recv_udpv4_packet->length) < sizeof(network_udpv4_header_t) ||
+       network_packet_trim(packet, BYTE_SWAP16(recv_udpv4_packet->length)) != 0) {
+        network_packet_release(packet);
 
-    if(recv_udpv4_packet == NULL) {
         return NULL;
     }
 
-    uint8_t* data = (uint8_t*)recv_udpv4_packet;
-    data += sizeof(network_udpv4_header_t);
-    uint16_t data_len = BYTE_SWAP16(recv_udpv4_packet->length) - sizeof(network_udpv4_header_t);
+    // zero means sender did not compute checksum
+    if(recv_udpv4_packet->checksum && !(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_VERIFIED)) {
+        uint16_t sum = network_checksum_pseudo_header(sip, dip, NETWORK_IPV4_PROTOCOL_UDPV4, packet->length);
+
+        if(network_checksum_partial(recv_udpv4_packet, packet->length, sum) != 0xFFFF) {
+            PRINTLOG(NETWORK, LOG_TRACE, "udpv4 packet checksum failed");
+            network_packet_release(packet);
+
+            return NULL;
+        }
+    }
 
     uint16_t dport = BYTE_SWAP16(recv_udpv4_packet->destination_port);
     uint16_t sport = BYTE_SWAP16(recv_udpv4_packet->source_port);
 
+    uint8_t* data = network_packet_pull(packet, sizeof(network_udpv4_header_t));
+    uint16_t data_len = packet->length;
+
 
     PRINTLOG(NETWORK, LOG_TRACE, "udpv4 packet dest port %i data len %i", dport, data_len);
 
+    // bound sockets take precedence over builtin responders
+    if(network_udpv4_receiver && network_udpv4_receiver(packet, dip, sip, dport, sport)) {
+        return NULL;
+    }
 
     if(dport == NETWORK_APPLICATION_PORT_ECHO_SERVER) {
-        return (uint8_t*)network_udpv4_create_packet_from_data(dport, sport, data_len, data);
+        // echoed data stays in place, only header is rewritten
+        if(network_udpv4_push_header(packet, dip, sip, dport, sport) == 0) {
+            return packet;
+        }
     } else if(dport == NETWORK_APPLICATION_PORT_DHCP_CLIENT) {
-        if(data_len < sizeof(network_dhcpv4_t)) {
-            return NULL;
+        if(data_len >= sizeof(network_dhcpv4_t)) {
+            network_dhcpv4_process_packet((network_dhcpv4_t*)data, packet->network_info, NULL);
         }
-
-        network_dhcpv4_process_packet((network_dhcpv4_t*)data, network_info, NULL);
     }
 
+    network_packet_release(packet);
+
     return NULL;
 }
 
-network_udpv4_header_t* network_udpv4_create_packet_from_data(uint16_t sp, uint16_t dp, uint16_t len, uint8_t* data) {
-    uint16_t packet_len = sizeof(network_udpv4_header_t) + len;
-
-    network_udpv4_header_t* res = memory_malloc(packet_len);
+int8_t network_udpv4_push_header(network_packet_t* packet, network_ipv4_address_t sip, network_ipv4_address_t dip, uint16_t sp, uint16_t dp) {
+    network_udpv4_header_t* res = (network_udpv4_header_t*)network_packet_push(packet, sizeof(network_udpv4_header_t));
 
     if(res == NULL) {
-        return NULL;
+        return -1;
     }
 
+    uint16_t packet_len = packet->length;
+
     res->source_port = BYTE_SWAP16(sp);
     res->destination_port = BYTE_SWAP16(dp);
     res->length = BYTE_SWAP16(packet_len);
 
-    uint32_t hcsum = res->source_port + res->destination_port + res->length * 2 + BYTE_SWAP16(NETWORK_IPV4_PROTOCOL_UDPV4);
-
-    boolean_t single_byte = len & 1;
-    uint16_t tmp_len = len - single_byte;
+    uint16_t sum = network_checksum_pseudo_header(sip, dip, NETWORK_IPV4_PROTOCOL_UDPV4, packet_len);
 
-    for(uint32_t i = 0; i < tmp_len; i += 2) {
-        hcsum += (data[i + 1] << 8) | data[i];
-    }
-
-    if(single_byte) {
-        hcsum += data[len - 1];
-    }
+    if(network_checksum_tx_offload_enabled(packet->network_info)) {
+        // nic sums datagram over pseudo header sum
+        res->checksum = sum;
+        packet->checksum_flags |= NETWORK_PACKET_CHECKSUM_L4_OFFLOAD;
+        packet->checksum_start = packet->offset;
+        packet->checksum_field = offsetof_field(network_udpv4_header_t, checksum);
 
-    while(hcsum >> 16) {
-        uint32_t carry = hcsum >> 16;
-        hcsum &= 0xFFFF;
-        hcsum += carry;
+        return 0;
     }
 
-    res->checksum = hcsum;
+    res->checksum = 0;
 
-    uint8_t* udp_buffer = (uint8_t*)res;
-    udp_buffer += sizeof(network_udpv4_header_t);
+    uint16_t csum = ~network_checksum_partial(res, packet_len, sum);
 
-    memory_memcopy(data, udp_buffer, len);
+    // zero means no checksum for udp
+    res->checksum = csum?csum:0xFFFF;
 
-    return res;
+    return 0;
 }
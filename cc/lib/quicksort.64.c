@@ -1,114 +1,689 @@
 /**
  * @file quicksort.64.c
- * @brief 64-bit quicksort implementation.
+ * @brief 64-bit sorting implementations: introsort, stable merge sort and lsd radix sort.
  *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
 
 #include <quicksort.h>
+#include <memory.h>
+#include <utils.h>
 
 MODULE("turnstone.lib");
 
-void quicksort_partial(void* array, uint64_t start, uint64_t end, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap) {
-    uint64_t i = start;
-    uint64_t j = end;
-    uint64_t pivot = start;
-    uint8_t* array_ptr = (uint8_t*)array;
+/*! ranges up to this length are finished with insertion sort */
+#define QUICKSORT_INSERTION_THRESHOLD 16
+
+/**
+ * @brief swaps two items, specialized for common item sizes unless a swap callback is given
+ * @param[in] a first item
+ * @param[in] b second item
+ * @param[in] item_size item size in bytes
+ * @param[in] swap optional user swap callback
+ */
+static inline void quicksort_swap_items(uint8_t* a, uint8_t* b, uint64_t item_size, quicksort_swap_f swap) {
+    if (swap) {
+        swap(a, b, item_size);
+
+        return;
+    }
+
+    switch (item_size) {
+    case 8: {
+        uint64_t tmp = *(uint64_t*)a;
+        *(uint64_t*)a = *(uint64_t*)b;
+        *(uint64_t*)b = tmp;
+    }
+    break;
+    case 4: {
+        uint32_t tmp = *(uint32_t*)a;
+        *(uint32_t*)a = *(uint32_t*)b;
+        *(uint32_t*)b = tmp;
+    }
+    break;
+    case 16: {
+        uint64_t tmp0 = ((uint64_t*)a)[0];
+        uint64_t tmp1 = ((uint64_t*)a)[1];
+        ((uint64_t*)a)[0] = ((uint64_t*)b)[0];
+        ((uint64_t*)a)[1] = ((uint64_t*)b)[1];
+        ((uint64_t*)b)[0] = tmp0;
+        ((uint64_t*)b)[1] = tmp1;
+    }
+    break;
+    default: {
+        uint64_t i = 0;
 
-    while (i <= j) {
-        while (comparator(array_ptr + (i * item_size), array_ptr + (pivot * item_size)) < 0) {
-            i++;
+        for (; i + 8 <= item_size; i += 8) {
+            uint64_t tmp = *(uint64_t*)(a + i);
+            *(uint64_t*)(a + i) = *(uint64_t*)(b + i);
+            *(uint64_t*)(b + i) = tmp;
         }
 
-        while (comparator(array_ptr + (j * item_size), array_ptr + (pivot * item_size)) > 0) {
-            if (j == 0) {
-                break;
-            }
+        for (; i < item_size; i++) {
+            uint8_t tmp = a[i];
+            a[i] = b[i];
+            b[i] = tmp;
+        }
+    }
+    break;
+    }
+}
 
-            j--;
+/**
+ * @brief copies one item, specialized for common item sizes
+ * @param[in] dst destination item
+ * @param[in] src source item
+ * @param[in] item_size item size in bytes
+ */
+static inline void quicksort_copy_item(uint8_t* dst, const uint8_t* src, uint64_t item_size) {
+    switch (item_size) {
+    case 8:
+        *(uint64_t*)dst = *(const uint64_t*)src;
+        break;
+    case 4:
+        *(uint32_t*)dst = *(const uint32_t*)src;
+        break;
+    default:
+        memory_memcopy(src, dst, item_size);
+        break;
+    }
+}
+
+/**
+ * @brief insertion sort for short ranges, stable
+ * @param[in] base first item
+ * @param[in] count item count
+ * @param[in] item_size item size in bytes
+ * @param[in] comparator item comparator
+ * @param[in] swap optional user swap callback
+ */
+static void quicksort_insertion(uint8_t* base, uint64_t count, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap) {
+    for (uint64_t i = 1; i < count; i++) {
+        uint8_t* cur = base + i * item_size;
+
+        while (cur > base && comparator(cur - item_size, cur) > 0) {
+            quicksort_swap_items(cur - item_size, cur, item_size, swap);
+            cur -= item_size;
         }
+    }
+}
 
-        if (i < j) {
-            swap(array_ptr + (i * item_size), array_ptr + (j * item_size), item_size);
-            i++;
+/**
+ * @brief sift down for heapsort
+ * @param[in] base heap
+ * @param[in] root starting node
+ * @param[in] end heap size
+ * @param[in] item_size item size in bytes
+ * @param[in] comparator item comparator
+ * @param[in] swap optional user swap callback
+ */
+static void quicksort_sift_down(uint8_t* base, uint64_t root, uint64_t end, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap) {
+    while (root * 2 + 1 < end) {
+        uint64_t child = root * 2 + 1;
 
-            if (j == 0) {
-                break;
+        if (child + 1 < end && comparator(base + child * item_size, base + (child + 1) * item_size) < 0) {
+            child++;
+        }
+
+        if (comparator(base + root * item_size, base + child * item_size) >= 0) {
+            break;
+        }
+
+        quicksort_swap_items(base + root * item_size, base + child * item_size, item_size, swap);
+        root = child;
+    }
+}
+
+/**
+ * @brief heapsort fallback when quicksort recursion gets too deep
+ * @param[in] base first item
+ * @param[in] count item count
+ * @param[in] item_size item size in bytes
+ * @param[in] comparator item comparator
+ * @param[in] swap optional user swap callback
+ */
+static void quicksort_heapsort(uint8_t* base, uint64_t count, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap) {
+    for (uint64_t i = count / 2; i-- > 0;) {
+        quicksort_sift_down(base, i, count, item_size, comparator, swap);
+    }
+
+    for (uint64_t end = count - 1; end > 0; end--) {
+        quicksort_swap_items(base, base + end * item_size, item_size, swap);
+        quicksort_sift_down(base, 0, end, item_size, comparator, swap);
+    }
+}
+
+/**
+ * @brief introsort loop: median of three quicksort, recursing into the smaller side only
+ * @param[in] base first item
+ * @param[in] count item count
+ * @param[in] item_size item size in bytes
+ * @param[in] comparator item comparator
+ * @param[in] swap optional user swap callback
+ * @param[in] depth remaining partition depth before falling back to heapsort
+ */
+static void quicksort_introsort(uint8_t* base, uint64_t count, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap, uint64_t depth) {
+    while (count > QUICKSORT_INSERTION_THRESHOLD) {
+        if (depth == 0) {
+            quicksort_heapsort(base, count, item_size, comparator, swap);
+
+            return;
+        }
+
+        depth--;
+
+        uint8_t* first = base;
+        uint8_t* mid = base + (count / 2) * item_size;
+        uint8_t* last = base + (count - 1) * item_size;
+
+        // order first, mid and last so they act as sentinels for the partition scans
+        if (comparator(mid, first) < 0) {
+            quicksort_swap_items(mid, first, item_size, swap);
+        }
+
+        if (comparator(last, mid) < 0) {
+            quicksort_swap_items(last, mid, item_size, swap);
+
+            if (comparator(mid, first) < 0) {
+                quicksort_swap_items(mid, first, item_size, swap);
             }
+        }
 
-            j--;
-        } else if (i == j) {
-            i++;
+        // park the pivot next to the end, it stays there while partitioning
+        uint8_t* pivot = last - item_size;
+
+        quicksort_swap_items(mid, pivot, item_size, swap);
+
+        uint8_t* i = first;
+        uint8_t* j = pivot;
+
+        while (true) {
+            do {
+                i += item_size;
+            } while (comparator(i, pivot) < 0);
+
+            do {
+                j -= item_size;
+            } while (comparator(j, pivot) > 0);
 
-            if (j == 0) {
+            if (i >= j) {
                 break;
             }
 
-            j--;
+            quicksort_swap_items(i, j, item_size, swap);
+        }
 
-            break;
+        quicksort_swap_items(i, pivot, item_size, swap);
+
+        uint64_t left = (i - base) / item_size;
+        uint64_t right = count - left - 1;
+
+        if (left < right) {
+            quicksort_introsort(base, left, item_size, comparator, swap, depth);
+            base = i + item_size;
+            count = right;
+        } else {
+            quicksort_introsort(i + item_size, right, item_size, comparator, swap, depth);
+            count = left;
         }
     }
 
-    if (start < j) {
-        quicksort_partial(array, start, j, item_size, comparator, swap);
+    quicksort_insertion(base, count, item_size, comparator, swap);
+}
+
+/**
+ * @brief recursion budget for introsort, two times log2 of the item count
+ * @param[in] count item count
+ * @return depth limit
+ */
+static uint64_t quicksort_depth_limit(uint64_t count) {
+    uint64_t depth = 0;
+
+    while (count > 1) {
+        depth += 2;
+        count >>= 1;
+    }
+
+    return depth;
+}
+
+void quicksort_partial(void* array, uint64_t start, uint64_t end, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap) {
+    if (!array || !comparator || !item_size || start >= end) {
+        return;
     }
 
-    if (i < end) {
-        quicksort_partial(array, i, end, item_size, comparator, swap);
+    uint64_t count = end - start + 1;
+
+    quicksort_introsort((uint8_t*)array + start * item_size, count, item_size, comparator, swap, quicksort_depth_limit(count));
+}
+
+/**
+ * @brief insertion sort of pointer arrays for short ranges, stable
+ * @param[in] array first pointer
+ * @param[in] count pointer count
+ * @param[in] comparator comparator taking the pointers themselves
+ */
+static void quicksort2_insertion(void** array, uint64_t count, quicksort_comparator_f comparator) {
+    for (uint64_t i = 1; i < count; i++) {
+        void* cur = array[i];
+        uint64_t j = i;
+
+        while (j > 0 && comparator(array[j - 1], cur) > 0) {
+            array[j] = array[j - 1];
+            j--;
+        }
+
+        array[j] = cur;
     }
 }
 
-#include <stdbufs.h>
+/**
+ * @brief sift down for pointer heapsort
+ * @param[in] array heap
+ * @param[in] root starting node
+ * @param[in] end heap size
+ * @param[in] comparator comparator taking the pointers themselves
+ */
+static void quicksort2_sift_down(void** array, uint64_t root, uint64_t end, quicksort_comparator_f comparator) {
+    void* item = array[root];
 
-void quicksort2_partial(void** array, uint64_t start, uint64_t end, quicksort_comparator_f comparator) {
-    uint64_t i = start;
-    uint64_t j = end;
-    uint64_t pivot = start;
+    while (root * 2 + 1 < end) {
+        uint64_t child = root * 2 + 1;
 
-    while (i <= j) {
-        while (comparator(array[i], array[pivot]) < 0) {
-            i++;
+        if (child + 1 < end && comparator(array[child], array[child + 1]) < 0) {
+            child++;
         }
 
-        while (comparator(array[j], array[pivot]) > 0) {
-            if (j == 0) {
-                break;
+        if (comparator(item, array[child]) >= 0) {
+            break;
+        }
+
+        array[root] = array[child];
+        root = child;
+    }
+
+    array[root] = item;
+}
+
+/**
+ * @brief introsort loop for pointer arrays
+ * @param[in] array first pointer
+ * @param[in] count pointer count
+ * @param[in] comparator comparator taking the pointers themselves
+ * @param[in] depth remaining partition depth before falling back to heapsort
+ */
+static void quicksort2_introsort(void** array, uint64_t count, quicksort_comparator_f comparator, uint64_t depth) {
+    while (count > QUICKSORT_INSERTION_THRESHOLD) {
+        if (depth == 0) {
+            for (uint64_t i = count / 2; i-- > 0;) {
+                quicksort2_sift_down(array, i, count, comparator);
             }
 
-            j--;
+            for (uint64_t end = count - 1; end > 0; end--) {
+                void* tmp = array[0];
+                array[0] = array[end];
+                array[end] = tmp;
+
+                quicksort2_sift_down(array, 0, end, comparator);
+            }
+
+            return;
+        }
+
+        depth--;
+
+        uint64_t mid = count / 2;
+        uint64_t last = count - 1;
+        void* tmp;
+
+        if (comparator(array[mid], array[0]) < 0) {
+            tmp = array[mid];
+            array[mid] = array[0];
+            array[0] = tmp;
         }
 
-        if (i < j) {
-            void* tmp = array[i];
+        if (comparator(array[last], array[mid]) < 0) {
+            tmp = array[last];
+            array[last] = array[mid];
+            array[mid] = tmp;
+
+            if (comparator(array[mid], array[0]) < 0) {
+                tmp = array[mid];
+                array[mid] = array[0];
+                array[0] = tmp;
+            }
+        }
+
+        void* pivot = array[mid];
+
+        array[mid] = array[last - 1];
+        array[last - 1] = pivot;
+
+        uint64_t i = 0;
+        uint64_t j = last - 1;
+
+        while (true) {
+            while (comparator(array[++i], pivot) < 0) {
+            }
+
+            while (comparator(array[--j], pivot) > 0) {
+            }
+
+            if (i >= j) {
+                break;
+            }
+
+            tmp = array[i];
             array[i] = array[j];
             array[j] = tmp;
-            i++;
+        }
 
-            if (j == 0) {
-                break;
+        array[last - 1] = array[i];
+        array[i] = pivot;
+
+        uint64_t right = count - i - 1;
+
+        if (i < right) {
+            quicksort2_introsort(array, i, comparator, depth);
+            array += i + 1;
+            count = right;
+        } else {
+            quicksort2_introsort(array + i + 1, right, comparator, depth);
+            count = i;
+        }
+    }
+
+    quicksort2_insertion(array, count, comparator);
+}
+
+void quicksort2_partial(void** array, uint64_t start, uint64_t end, quicksort_comparator_f comparator) {
+    if (!array || !comparator || start >= end) {
+        return;
+    }
+
+    uint64_t count = end - start + 1;
+
+    quicksort2_introsort(array + start, count, comparator, quicksort_depth_limit(count));
+}
+
+int8_t mergesort(void* array, uint64_t size, uint64_t item_size, quicksort_comparator_f comparator) {
+    if (!array || !comparator || !item_size) {
+        return -1;
+    }
+
+    if (size < 2) {
+        return 0;
+    }
+
+    uint8_t* base = (uint8_t*)array;
+
+    // sorted runs of insertion threshold length, insertion sort keeps them stable
+    for (uint64_t i = 0; i < size; i += QUICKSORT_INSERTION_THRESHOLD) {
+        quicksort_insertion(base + i * item_size, MIN(QUICKSORT_INSERTION_THRESHOLD, size - i), item_size, comparator, NULL);
+    }
+
+    if (size <= QUICKSORT_INSERTION_THRESHOLD) {
+        return 0;
+    }
+
+    uint8_t* buffer = memory_malloc(size * item_size);
+
+    if (!buffer) {
+        return -1;
+    }
+
+    uint8_t* src = base;
+    uint8_t* dst = buffer;
+
+    for (uint64_t width = QUICKSORT_INSERTION_THRESHOLD; width < size; width *= 2) {
+        for (uint64_t left = 0; left < size; left += 2 * width) {
+            uint64_t mid = MIN(left + width, size);
+            uint64_t right = MIN(left + 2 * width, size);
+            uint64_t i = left;
+            uint64_t j = mid;
+            uint64_t k = left;
+
+            // already ordered pair of runs, copy in one go
+            if (mid == right || comparator(src + (mid - 1) * item_size, src + mid * item_size) <= 0) {
+                memory_memcopy(src + left * item_size, dst + left * item_size, (right - left) * item_size);
+
+                continue;
             }
 
-            j--;
-        } else if (i == j) {
-            i++;
+            while (i < mid && j < right) {
+                // take from the left run on ties to stay stable
+                if (comparator(src + j * item_size, src + i * item_size) < 0) {
+                    quicksort_copy_item(dst + k * item_size, src + j * item_size, item_size);
+                    j++;
+                } else {
+                    quicksort_copy_item(dst + k * item_size, src + i * item_size, item_size);
+                    i++;
+                }
 
-            if (j == 0) {
-                break;
+                k++;
             }
 
-            j--;
+            if (i < mid) {
+                memory_memcopy(src + i * item_size, dst + k * item_size, (mid - i) * item_size);
+            } else if (j < right) {
+                memory_memcopy(src + j * item_size, dst + k * item_size, (right - j) * item_size);
+            }
+        }
 
-            break;
+        uint8_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != base) {
+        memory_memcopy(src, base, size * item_size);
+    }
+
+    memory_free(buffer);
+
+    return 0;
+}
+
+int8_t mergesort2(void** array, uint64_t size, quicksort_comparator_f comparator) {
+    if (!array || !comparator) {
+        return -1;
+    }
+
+    if (size < 2) {
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < size; i += QUICKSORT_INSERTION_THRESHOLD) {
+        quicksort2_insertion(array + i, MIN(QUICKSORT_INSERTION_THRESHOLD, size - i), comparator);
+    }
+
+    if (size <= QUICKSORT_INSERTION_THRESHOLD) {
+        return 0;
+    }
+
+    void** buffer = memory_malloc(size * sizeof(void*));
+
+    if (!buffer) {
+        return -1;
+    }
+
+    void** src = array;
+    void** dst = buffer;
+
+    for (uint64_t width = QUICKSORT_INSERTION_THRESHOLD; width < size; width *= 2) {
+        for (uint64_t left = 0; left < size; left += 2 * width) {
+            uint64_t mid = MIN(left + width, size);
+            uint64_t right = MIN(left + 2 * width, size);
+            uint64_t i = left;
+            uint64_t j = mid;
+            uint64_t k = left;
+
+            if (mid == right || comparator(src[mid - 1], src[mid]) <= 0) {
+                memory_memcopy(src + left, dst + left, (right - left) * sizeof(void*));
+
+                continue;
+            }
+
+            while (i < mid && j < right) {
+                if (comparator(src[j], src[i]) < 0) {
+                    dst[k++] = src[j++];
+                } else {
+                    dst[k++] = src[i++];
+                }
+            }
+
+            while (i < mid) {
+                dst[k++] = src[i++];
+            }
+
+            while (j < right) {
+                dst[k++] = src[j++];
+            }
+        }
+
+        void** tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != array) {
+        memory_memcopy(src, array, size * sizeof(void*));
+    }
+
+    memory_free(buffer);
+
+    return 0;
+}
+
+int8_t radixsort_uint64(uint64_t* array, uint64_t size) {
+    if (!array) {
+        return -1;
+    }
+
+    if (size < 2) {
+        return 0;
+    }
+
+    uint64_t* buffer = memory_malloc(size * sizeof(uint64_t));
+    uint64_t* counts = memory_malloc(8 * 256 * sizeof(uint64_t));
+
+    if (!buffer || !counts) {
+        memory_free(buffer);
+        memory_free(counts);
+
+        return -1;
+    }
+
+    // all byte histograms in one pass
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t value = array[i];
+
+        for (uint64_t b = 0; b < 8; b++) {
+            counts[b * 256 + ((value >> (b * 8)) & 0xFF)]++;
+        }
+    }
+
+    uint64_t* src = array;
+    uint64_t* dst = buffer;
+
+    for (uint64_t b = 0; b < 8; b++) {
+        uint64_t* count = counts + b * 256;
+
+        // every key shares this byte, the pass would not move anything
+        if (count[(src[0] >> (b * 8)) & 0xFF] == size) {
+            continue;
+        }
+
+        uint64_t offset = 0;
+
+        for (uint64_t i = 0; i < 256; i++) {
+            uint64_t c = count[i];
+            count[i] = offset;
+            offset += c;
+        }
+
+        for (uint64_t i = 0; i < size; i++) {
+            uint64_t value = src[i];
+            dst[count[(value >> (b * 8)) & 0xFF]++] = value;
+        }
+
+        uint64_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != array) {
+        memory_memcopy(src, array, size * sizeof(uint64_t));
+    }
+
+    memory_free(buffer);
+    memory_free(counts);
+
+    return 0;
+}
+
+int8_t radixsort_uint32(uint32_t* array, uint64_t size) {
+    if (!array) {
+        return -1;
+    }
+
+    if (size < 2) {
+        return 0;
+    }
+
+    uint32_t* buffer = memory_malloc(size * sizeof(uint32_t));
+    uint64_t* counts = memory_malloc(4 * 256 * sizeof(uint64_t));
+
+    if (!buffer || !counts) {
+        memory_free(buffer);
+        memory_free(counts);
+
+        return -1;
+    }
+
+    for (uint64_t i = 0; i < size; i++) {
+        uint32_t value = array[i];
+
+        for (uint64_t b = 0; b < 4; b++) {
+            counts[b * 256 + ((value >> (b * 8)) & 0xFF)]++;
         }
     }
 
-    if (start < j) {
-        quicksort2_partial(array, start, j, comparator);
+    uint32_t* src = array;
+    uint32_t* dst = buffer;
+
+    for (uint64_t b = 0; b < 4; b++) {
+        uint64_t* count = counts + b * 256;
+
+        if (count[(src[0] >> (b * 8)) & 0xFF] == size) {
+            continue;
+        }
+
+        uint64_t offset = 0;
+
+        for (uint64_t i = 0; i < 256; i++) {
+            uint64_t c = count[i];
+            count[i] = offset;
+            offset += c;
+        }
+
+        for (uint64_t i = 0; i < size; i++) {
+            uint32_t value = src[i];
+            dst[count[(value >> (b * 8)) & 0xFF]++] = value;
+        }
+
+        uint32_t* tmp = src;
+        src = dst;
+        dst = tmp;
     }
 
-    if (i < end) {
-        quicksort2_partial(array, i, end, comparator);
+    if (src != array) {
+        memory_memcopy(src, array, size * sizeof(uint32_t));
     }
+
+    memory_free(buffer);
+    memory_free(counts);
+
+    return 0;
 }
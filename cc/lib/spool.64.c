@@ -2,6 +2,13 @@
  * @file spool.64.c
  * @brief Spool implementation
  *
+ * spool keeps named task buffers and a fixed size record ring carved from the spool area. ring
+ * positions are monotonic byte offsets, producers reserve space by advancing head with cas and
+ * publish a record by storing its position with the committed bit. a record never wraps, the end
+ * of ring is filled with a padding record instead. overwriting producers evict only committed
+ * records by advancing tail. readers copy a record then check tail again, so a record evicted
+ * during the copy is detected and skipped.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
@@ -11,19 +18,58 @@
 #include <strings.h>
 #include <logging.h>
 #include <memory.h>
+#include <utils.h>
 
 MODULE("turnstone.lib.spool");
 
+/*! committed bit at record position */
+#define SPOOL_RING_RECORD_COMMITTED 1ULL
+/*! record only fills the end of ring */
+#define SPOOL_RING_RECORD_FLAG_PAD  1
+/*! record alignment, ring capacity and positions are multiples of it */
+#define SPOOL_RING_RECORD_ALIGN     16ULL
+/*! system ring takes 1/(1 << shift) of spool area */
+#define SPOOL_RING_AREA_SHIFT       2
+
 struct spool_item_t {
     char_t* name;
     list_t* buffers;
 };
 
+/**
+ * @struct spool_ring_record_header_t
+ * @brief header before record name and data
+ */
+typedef struct spool_ring_record_header_t {
+    volatile uint64_t position; ///< stream position ored with committed bit when record is complete
+    uint32_t          length; ///< name and data length
+    uint16_t          name_length; ///< name length
+    uint16_t          flags; ///< SPOOL_RING_RECORD_FLAG_*
+} spool_ring_record_header_t;
+
+_Static_assert(sizeof(spool_ring_record_header_t) == SPOOL_RING_RECORD_ALIGN, "spool ring record header should be one alignment unit");
+
+struct spool_ring_t {
+    uint64_t            capacity; ///< data capacity
+    spool_ring_policy_t policy; ///< full ring policy
+    uint8_t*            data; ///< record area
+    volatile uint64_t   dropped_count; ///< dropped record count
+    volatile uint64_t   head __attribute__((aligned(64))); ///< next reservation position
+    volatile uint64_t   tail __attribute__((aligned(64))); ///< oldest record position
+} __attribute__((aligned(64)));
+
 
 list_t* spool_list = NULL;
 memory_heap_t* spool_heap = NULL;
+spool_ring_t* spool_ring = NULL;
 
 int8_t spool_init(size_t spool_size, uint64_t spool_start) {
+    uint64_t ring_size = (spool_size >> SPOOL_RING_AREA_SHIFT) & ~0xFFFULL; // keeps heap end page aligned
+
+    spool_size -= ring_size;
+
+    spool_ring = spool_ring_create((void*)(spool_start + spool_size), ring_size, SPOOL_RING_POLICY_OVERWRITE_OLDEST);
+
     spool_heap = memory_create_heap_hash(spool_start, spool_start + spool_size);
 
     if(spool_heap == NULL) {
@@ -136,3 +182,259 @@ const buffer_t* spool_get_buffer(const spool_item_t* item, size_t buf_idx) {
 
     return list_get_data_at_position(item->buffers, buf_idx);
 }
+
+static inline uint64_t spool_ring_record_size(uint64_t length) {
+    return (sizeof(spool_ring_record_header_t) + length + SPOOL_RING_RECORD_ALIGN - 1) & ~(SPOOL_RING_RECORD_ALIGN - 1);
+}
+
+static inline spool_ring_record_header_t* spool_ring_header_at(spool_ring_t* ring, uint64_t position) {
+    return (spool_ring_record_header_t*)(ring->data + position % ring->capacity);
+}
+
+spool_ring_t* spool_ring_create(void* area, uint64_t area_size, spool_ring_policy_t policy) {
+    if(area == NULL || ((uint64_t)area & 63) || area_size < sizeof(spool_ring_t) + 4 * SPOOL_RING_RECORD_ALIGN) {
+        return NULL;
+    }
+
+    spool_ring_t* ring = area;
+
+    memory_memclean(ring, sizeof(spool_ring_t));
+
+    ring->data = (uint8_t*)area + sizeof(spool_ring_t);
+    ring->capacity = (area_size - sizeof(spool_ring_t)) & ~(SPOOL_RING_RECORD_ALIGN - 1);
+    ring->policy = policy;
+
+    // stale headers must not look committed at their first lap
+    memory_memclean(ring->data, ring->capacity);
+
+    return ring;
+}
+
+/**
+ * @brief evicts committed records from tail until reservation fits
+ * @param[in] ring ring
+ * @param[in] end reservation end
+ * @return 0 if reservation fits, -1 if oldest record is still being written or policy does not allow eviction
+ */
+static int8_t spool_ring_make_room(spool_ring_t* ring, uint64_t end) {
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    while(end - tail > ring->capacity) {
+        if(ring->policy == SPOOL_RING_POLICY_DROP_NEWEST) {
+            return -1;
+        }
+
+        spool_ring_record_header_t* header = spool_ring_header_at(ring, tail);
+
+        if(__atomic_load_n(&header->position, __ATOMIC_ACQUIRE) != (tail | SPOOL_RING_RECORD_COMMITTED)) {
+            return -1;
+        }
+
+        uint64_t next = tail + spool_ring_record_size(header->length);
+
+        // on failure tail is reloaded, size read from a header evicted meanwhile is not used
+        __atomic_compare_exchange_n(&ring->tail, &tail, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+
+    return 0;
+}
+
+int8_t spool_ring_write(spool_ring_t* ring, const char_t* name, const void* data, uint64_t length) {
+    if(ring == NULL || (data == NULL && length)) {
+        return -1;
+    }
+
+    uint64_t name_length = name ? strlen(name) : 0;
+
+    if(name_length > 0xFFFF) {
+        name_length = 0xFFFF;
+    }
+
+    uint64_t size = spool_ring_record_size(name_length + length);
+
+    // also bounds padding plus record by capacity
+    if(size > ring->capacity / 2) {
+        __atomic_add_fetch(&ring->dropped_count, 1, __ATOMIC_RELAXED);
+
+        return -1;
+    }
+
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t pad = 0;
+
+    while(true) {
+        uint64_t offset = head % ring->capacity;
+
+        pad = offset + size > ring->capacity ? ring->capacity - offset : 0;
+
+        if(spool_ring_make_room(ring, head + pad + size) != 0) {
+            __atomic_add_fetch(&ring->dropped_count, 1, __ATOMIC_RELAXED);
+
+            return -1;
+        }
+
+        if(__atomic_compare_exchange_n(&ring->head, &head, head + pad + size, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    if(pad) {
+        spool_ring_record_header_t* pad_header = spool_ring_header_at(ring, head);
+
+        pad_header->length = pad - sizeof(spool_ring_record_header_t);
+        pad_header->name_length = 0;
+        pad_header->flags = SPOOL_RING_RECORD_FLAG_PAD;
+        __atomic_store_n(&pad_header->position, head | SPOOL_RING_RECORD_COMMITTED, __ATOMIC_RELEASE);
+
+        head += pad;
+    }
+
+    spool_ring_record_header_t* header = spool_ring_header_at(ring, head);
+
+    __atomic_store_n(&header->position, head, __ATOMIC_RELAXED);
+    header->length = name_length + length;
+    header->name_length = name_length;
+    header->flags = 0;
+
+    uint8_t* payload = (uint8_t*)(header + 1);
+
+    memory_memcopy(name, payload, name_length);
+    memory_memcopy(data, payload + name_length, length);
+
+    __atomic_store_n(&header->position, head | SPOOL_RING_RECORD_COMMITTED, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+int8_t spool_ring_cursor_init(spool_ring_t* ring, spool_ring_cursor_t* cursor) {
+    if(ring == NULL || cursor == NULL) {
+        return -1;
+    }
+
+    cursor->position = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    cursor->lost_bytes = 0;
+
+    return 0;
+}
+
+int8_t spool_ring_read(spool_ring_t* ring, spool_ring_cursor_t* cursor, spool_ring_record_t* record, uint8_t* buffer, uint64_t buffer_size) {
+    if(ring == NULL || cursor == NULL || record == NULL || (buffer == NULL && buffer_size)) {
+        return -1;
+    }
+
+    while(true) {
+        uint64_t position = cursor->position;
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        if(position < tail) {
+            cursor->lost_bytes += tail - position;
+            cursor->position = tail;
+
+            continue;
+        }
+
+        if(position >= __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+            return -1;
+        }
+
+        spool_ring_record_header_t* header = spool_ring_header_at(ring, position);
+
+        if(__atomic_load_n(&header->position, __ATOMIC_ACQUIRE) != (position | SPOOL_RING_RECORD_COMMITTED)) {
+            if(position < __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+
+            // records after an uncommitted one are not visible yet
+            return -1;
+        }
+
+        uint64_t length = header->length;
+        uint64_t name_length = header->name_length;
+        boolean_t is_pad = (header->flags & SPOOL_RING_RECORD_FLAG_PAD) != 0;
+        uint64_t size = spool_ring_record_size(length);
+
+        if(name_length > length || position % ring->capacity + size > ring->capacity) {
+            // header changed under us
+            if(position < __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        uint64_t name_copy = 0;
+        uint64_t data_copy = 0;
+
+        if(!is_pad) {
+            const uint8_t* payload = (const uint8_t*)(header + 1);
+
+            name_copy = MIN(name_length, buffer_size);
+            data_copy = MIN(length - name_length, buffer_size - name_copy);
+
+            memory_memcopy(payload, buffer, name_copy);
+            memory_memcopy(payload + name_length, buffer + name_copy, data_copy);
+        }
+
+        // copied bytes are valid only if no producer evicted the record meanwhile
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if(position < __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        cursor->position = position + size;
+
+        if(is_pad) {
+            continue;
+        }
+
+        record->position = position;
+        record->name = (const char_t*)buffer;
+        record->name_length = name_copy;
+        record->data = buffer + name_copy;
+        record->data_length = data_copy;
+        record->total_data_length = length - name_length;
+
+        return 0;
+    }
+}
+
+int8_t spool_ring_release(spool_ring_t* ring, const spool_ring_cursor_t* cursor) {
+    if(ring == NULL || cursor == NULL) {
+        return -1;
+    }
+
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    while(tail < cursor->position) {
+        if(__atomic_compare_exchange_n(&ring->tail, &tail, cursor->position, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+uint64_t spool_ring_get_capacity(spool_ring_t* ring) {
+    if(ring == NULL) {
+        return 0;
+    }
+
+    return ring->capacity;
+}
+
+uint64_t spool_ring_get_dropped_count(spool_ring_t* ring) {
+    if(ring == NULL) {
+        return 0;
+    }
+
+    return __atomic_load_n(&ring->dropped_count, __ATOMIC_RELAXED);
+}
+
+spool_ring_t* spool_get_ring(void) {
+    return spool_ring;
+}
+
+int8_t spool_write(const char_t* name, const void* data, uint64_t length) {
+    return spool_ring_write(spool_ring, name, data, length);
+}
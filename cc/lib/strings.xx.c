@@ -237,15 +237,13 @@ char_t* strrchr(const char_t* s, int32_t c) {
 }
 
 char_t* strstr(const char_t* haystack, const char_t* needle) {
-    size_t needle_length = strlen(needle);
+    int64_t pos = byte_search((const uint8_t*)haystack, strlen(haystack), (const uint8_t*)needle, strlen(needle));
 
-    for (size_t i = 0; haystack[i] != '\0'; i++) {
-        if (strncmp(haystack + i, needle, needle_length) == 0) {
-            return (char_t*)(haystack + i);
-        }
+    if(pos == -1) {
+        return NULL;
     }
 
-    return NULL;
+    return (char_t*)(haystack + pos);
 }
 
 char_t* strcat_at_heap(memory_heap_t* heap, const char_t* string1, const char_t* string2) {
@@ -39,6 +39,11 @@ int64_t sunday_match(const uint8_t* data, const int64_t data_len, const uint8_t*
             }
         }
 
+        // byte after the window does not exist at the last window
+        if (pos + pattern_len == data_len) {
+            break;
+        }
+
         pos += skip[data[pos + pattern_len]];
     }
 
@@ -2,6 +2,10 @@
  * @file varint.64.c
  * @brief variable length integer encoding/decoding implementation.
  *
+ * single integers are stored most significant group first, every byte except the last one has the
+ * continuation bit. integer arrays can be stored as group varint: a tag byte holds four two bit
+ * lengths and four little endian integers of one to four bytes follow it.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
@@ -13,39 +17,106 @@
 
 MODULE("turnstone.lib");
 
+/*! unaligned 32-bit store type for group encoder */
+typedef uint32_t varint_unaligned_uint32_t __attribute__((aligned(1)));
+
+/*! length of lane i at group tag t */
+#define VARINT_GROUP_LEN(t, i) ((((t) >> (2 * (i))) & 3) + 1)
+/*! start offset of lane 0 at group data */
+#define VARINT_GROUP_START0(t) 0
+/*! start offset of lane 1 at group data */
+#define VARINT_GROUP_START1(t) (VARINT_GROUP_LEN(t, 0))
+/*! start offset of lane 2 at group data */
+#define VARINT_GROUP_START2(t) (VARINT_GROUP_START1(t) + VARINT_GROUP_LEN(t, 1))
+/*! start offset of lane 3 at group data */
+#define VARINT_GROUP_START3(t) (VARINT_GROUP_START2(t) + VARINT_GROUP_LEN(t, 2))
+/*! total data length of group tag t */
+#define VARINT_GROUP_DATA_LEN(t) (VARINT_GROUP_START3(t) + VARINT_GROUP_LEN(t, 3))
+
+#if defined(__SSSE3__)
+/*! shuffle mask byte for lane i byte b, 0x80 zeroes the byte */
+#define VARINT_GROUP_SHUFFLE_BYTE(t, i, b) ((b) < VARINT_GROUP_LEN(t, i) ? VARINT_GROUP_START ## i(t) + (b) : 0x80)
+/*! shuffle mask bytes of lane i */
+#define VARINT_GROUP_SHUFFLE_LANE(t, i) \
+        VARINT_GROUP_SHUFFLE_BYTE(t, i, 0), VARINT_GROUP_SHUFFLE_BYTE(t, i, 1), \
+        VARINT_GROUP_SHUFFLE_BYTE(t, i, 2), VARINT_GROUP_SHUFFLE_BYTE(t, i, 3)
+/*! shuffle mask of tag */
+#define VARINT_GROUP_SHUFFLE(t) { \
+            VARINT_GROUP_SHUFFLE_LANE(t, 0), VARINT_GROUP_SHUFFLE_LANE(t, 1), \
+            VARINT_GROUP_SHUFFLE_LANE(t, 2), VARINT_GROUP_SHUFFLE_LANE(t, 3) }
+/*! four shuffle masks */
+#define VARINT_GROUP_SHUFFLE4(t) \
+        VARINT_GROUP_SHUFFLE(t), VARINT_GROUP_SHUFFLE(t + 1), VARINT_GROUP_SHUFFLE(t + 2), VARINT_GROUP_SHUFFLE(t + 3)
+/*! sixteen shuffle masks */
+#define VARINT_GROUP_SHUFFLE16(t) \
+        VARINT_GROUP_SHUFFLE4(t), VARINT_GROUP_SHUFFLE4(t + 4), VARINT_GROUP_SHUFFLE4(t + 8), VARINT_GROUP_SHUFFLE4(t + 12)
+/*! sixtyfour shuffle masks */
+#define VARINT_GROUP_SHUFFLE64(t) \
+        VARINT_GROUP_SHUFFLE16(t), VARINT_GROUP_SHUFFLE16(t + 16), VARINT_GROUP_SHUFFLE16(t + 32), VARINT_GROUP_SHUFFLE16(t + 48)
+
+/*! byte vector for pshufb */
+typedef int8_t varint_vector_t __attribute__((vector_size(16)));
+/*! unaligned byte vector for loads and stores */
+typedef int8_t varint_unaligned_vector_t __attribute__((vector_size(16), aligned(1)));
+
+/*! pshufb masks moving group data bytes into four 32-bit lanes, indexed by tag */
+static const uint8_t varint_group_shuffle[256][16] __attribute__((aligned(16))) = {
+    VARINT_GROUP_SHUFFLE64(0), VARINT_GROUP_SHUFFLE64(64), VARINT_GROUP_SHUFFLE64(128), VARINT_GROUP_SHUFFLE64(192),
+};
+#endif
+
+int8_t varint_size(uint64_t num) {
+    int8_t bits = 64 - __builtin_clzll(num | 1);
+
+    return (bits + 6) / 7;
+}
 
-uint8_t* varint_encode(uint64_t num, int8_t* size) {
-    const uint64_t max = 128;
-    uint8_t* tmp_data = memory_malloc(sizeof(uint8_t) * 10);
-    uint8_t* tmp_start_data = tmp_data;
-    int8_t tmp_size = 0;
+int8_t varint_encode_to(uint64_t num, uint8_t* out) {
+    if(!out) {
+        return -1;
+    }
 
-    tmp_data += 9;
+    int8_t size = varint_size(num);
 
-    while(1) {
-        tmp_size++;
+    out[size - 1] = num & 0x7F;
+    num >>= 7;
 
-        if(num < max) {
-            *tmp_data = num | (tmp_size > 1?0x80:0x0);
-            break;
-        } else {
-            *tmp_data = (num & 0x7F) | (tmp_size > 1?0x80:0x0);
-            num >>= 7;
-            tmp_data--;
-        }
+    for(int64_t i = size - 2; i >= 0; i--) {
+        out[i] = (num & 0x7F) | 0x80;
+        num >>= 7;
     }
 
-    (*size) = tmp_size;
+    return size;
+}
+
+uint8_t* varint_encode(uint64_t num, int8_t* size) {
+    uint8_t tmp[VARINT_MAX_SIZE];
+    int8_t tmp_size = varint_encode_to(num, tmp);
 
     uint8_t* res = memory_malloc(sizeof(uint8_t) * tmp_size);
 
-    memory_memcopy(tmp_data, res, tmp_size);
+    if(!res) {
+        return NULL;
+    }
+
+    memory_memcopy(tmp, res, tmp_size);
 
-    memory_free(tmp_start_data);
+    (*size) = tmp_size;
 
     return res;
 }
 
+int8_t varint_encode_to_buffer(buffer_t* buffer, uint64_t num) {
+    uint8_t tmp[VARINT_MAX_SIZE];
+    int8_t tmp_size = varint_encode_to(num, tmp);
+
+    if(!buffer_append_bytes(buffer, tmp, tmp_size)) {
+        return -1;
+    }
+
+    return tmp_size;
+}
+
 uint64_t varint_decode(uint8_t* data, int8_t* size) {
     uint64_t res = 0;
 
@@ -62,3 +133,107 @@ uint64_t varint_decode(uint8_t* data, int8_t* size) {
 
     return res;
 }
+
+uint64_t varint_decode_from_buffer(buffer_t* buffer, int8_t* size) {
+    uint64_t res = 0;
+    int8_t tmp_size = 0;
+
+    while(buffer_remaining(buffer)) {
+        uint8_t b = buffer_get_byte(buffer);
+        tmp_size++;
+
+        res <<= 7;
+        res |= b & 0x7F;
+
+        if(!(b & 0x80)) {
+            break;
+        }
+    }
+
+    if(size) {
+        (*size) = tmp_size;
+    }
+
+    return res;
+}
+
+uint64_t varint_group_encode_uint32(const uint32_t* src, uint64_t count, uint8_t* out) {
+    if(!src || !out) {
+        return 0;
+    }
+
+    uint64_t pos = 0;
+
+    for(uint64_t i = 0; i < count; i += 4) {
+        uint64_t lanes = MIN(count - i, 4ULL);
+        uint8_t tag = 0;
+        uint64_t tag_pos = pos++;
+
+        for(uint64_t j = 0; j < lanes; j++) {
+            uint32_t v = src[i + j];
+            uint8_t len = (39 - __builtin_clz(v | 1)) >> 3;
+
+            // group max size leaves room for a full store at every lane
+            *(varint_unaligned_uint32_t*)(out + pos) = v;
+            pos += len;
+            tag |= (len - 1) << (2 * j);
+        }
+
+        out[tag_pos] = tag;
+    }
+
+    return pos;
+}
+
+uint64_t varint_group_decode_uint32(const uint8_t* src, uint64_t src_length, uint32_t* out, uint64_t count) {
+    if(!src || !out) {
+        return -1ULL;
+    }
+
+    uint64_t pos = 0;
+    uint64_t i = 0;
+
+#if defined(__SSSE3__)
+    // full groups whose 16 byte load stays inside the source
+    while(count - i >= 4 && pos + 17 <= src_length) {
+        uint8_t tag = src[pos];
+        varint_vector_t data = *(const varint_unaligned_vector_t*)(src + pos + 1);
+        varint_vector_t mask = *(const varint_vector_t*)varint_group_shuffle[tag];
+
+        *(varint_unaligned_vector_t*)(out + i) = __builtin_ia32_pshufb128(data, mask);
+
+        pos += 1 + VARINT_GROUP_DATA_LEN(tag);
+        i += 4;
+    }
+#endif
+
+    while(i < count) {
+        if(pos >= src_length) {
+            return -1ULL;
+        }
+
+        uint8_t tag = src[pos++];
+        uint64_t lanes = MIN(count - i, 4ULL);
+
+        for(uint64_t j = 0; j < lanes; j++) {
+            uint8_t len = VARINT_GROUP_LEN(tag, j);
+
+            if(pos + len > src_length) {
+                return -1ULL;
+            }
+
+            uint32_t v = 0;
+
+            for(uint8_t b = 0; b < len; b++) {
+                v |= (uint32_t)src[pos + b] << (8 * b);
+            }
+
+            out[i + j] = v;
+            pos += len;
+        }
+
+        i += lanes;
+    }
+
+    return pos;
+}
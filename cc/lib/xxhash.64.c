@@ -77,33 +77,36 @@ static inline xxhash64_context_t* xxhhash64_init_without_malloc(xxhash64_context
     return ctx;
 }
 
-static uint64_t xxhash64_final_without_free(xxhash64_context_t* ctx) {
-
-    if(ctx == NULL) {
-        return 0;
-    }
-
-    uint64_t result;
-
-    if (ctx->total_length >= XXHASH64_MAXBUFFERSIZE) {
-        result = ROTLEFT64(ctx->state[0],  1) +
-                 ROTLEFT64(ctx->state[1],  7) +
-                 ROTLEFT64(ctx->state[2], 12) +
-                 ROTLEFT64(ctx->state[3], 18);
-
-        result = (result ^ xxhash64_process_single(0, ctx->state[0])) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
-        result = (result ^ xxhash64_process_single(0, ctx->state[1])) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
-        result = (result ^ xxhash64_process_single(0, ctx->state[2])) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
-        result = (result ^ xxhash64_process_single(0, ctx->state[3])) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
-    } else {
-        result = ctx->state[2] + XXHASH64_PRIME5;
-    }
+/**
+ * @brief merge xxhash64 lanes into single value
+ * @param[in] s0 state 0
+ * @param[in] s1 state 1
+ * @param[in] s2 state 2
+ * @param[in] s3 state 3
+ * @return merged value
+ */
+static inline uint64_t xxhash64_merge_state(uint64_t s0, uint64_t s1, uint64_t s2, uint64_t s3) {
+    uint64_t result = ROTLEFT64(s0,  1) +
+                      ROTLEFT64(s1,  7) +
+                      ROTLEFT64(s2, 12) +
+                      ROTLEFT64(s3, 18);
 
-    result += ctx->total_length;
+    result = (result ^ xxhash64_process_single(0, s0)) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
+    result = (result ^ xxhash64_process_single(0, s1)) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
+    result = (result ^ xxhash64_process_single(0, s2)) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
+    result = (result ^ xxhash64_process_single(0, s3)) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
 
-    const uint8_t* data = ctx->buffer;
-    const uint8_t* stop = data + ctx->buffer_size;
+    return result;
+}
 
+/**
+ * @brief consume remaining bytes (less than one block) and avalanche result
+ * @param[in] result current result
+ * @param[in] data remaining data start
+ * @param[in] stop remaining data end
+ * @return final hash value
+ */
+static inline uint64_t xxhash64_finalize(uint64_t result, const uint8_t* data, const uint8_t* stop) {
     for (; data + 8 <= stop; data += 8) {
         result = ROTLEFT64(result ^ xxhash64_process_single(0, *(uint64_t*)data), 27) * XXHASH64_PRIME1 + XXHASH64_PRIME4;
     }
@@ -127,13 +130,52 @@ static uint64_t xxhash64_final_without_free(xxhash64_context_t* ctx) {
     return result;
 }
 
+static uint64_t xxhash64_final_without_free(xxhash64_context_t* ctx) {
+
+    if(ctx == NULL) {
+        return 0;
+    }
+
+    uint64_t result;
+
+    if (ctx->total_length >= XXHASH64_MAXBUFFERSIZE) {
+        result = xxhash64_merge_state(ctx->state[0], ctx->state[1], ctx->state[2], ctx->state[3]);
+    } else {
+        result = ctx->state[2] + XXHASH64_PRIME5;
+    }
+
+    result += ctx->total_length;
+
+    return xxhash64_finalize(result, ctx->buffer, ctx->buffer + ctx->buffer_size);
+}
+
 uint64_t xxhash64_hash_with_seed(const void* input, uint64_t length, uint64_t seed) {
-    xxhash64_context_t ctx = {0};
+    const uint8_t* data = (const uint8_t*)input;
+    const uint8_t* stop = data + length;
+
+    uint64_t result;
+
+    if (length >= XXHASH64_MAXBUFFERSIZE) {
+        uint64_t s0 = seed + XXHASH64_PRIME1 + XXHASH64_PRIME2;
+        uint64_t s1 = seed + XXHASH64_PRIME2;
+        uint64_t s2 = seed;
+        uint64_t s3 = seed - XXHASH64_PRIME1;
+
+        const uint8_t* limit = stop - XXHASH64_MAXBUFFERSIZE;
+
+        do {
+            xxhash64_process(data, &s0, &s1, &s2, &s3);
+            data += XXHASH64_MAXBUFFERSIZE;
+        } while (data <= limit);
+
+        result = xxhash64_merge_state(s0, s1, s2, s3);
+    } else {
+        result = seed + XXHASH64_PRIME5;
+    }
 
-    xxhhash64_init_without_malloc(&ctx, seed);
-    xxhash64_update(&ctx, input, length);
+    result += length;
 
-    return xxhash64_final_without_free(&ctx);
+    return xxhash64_finalize(result, data, stop);
 }
 
 xxhash64_context_t* xxhash64_init(uint64_t seed) {
@@ -268,11 +310,60 @@ static inline void xxhash32_process(const void* data, uint32_t* state0, uint32_t
     *state3 = xxhash32_process_single(*state3, block[3]);
 }
 
+/**
+ * @brief consume remaining bytes (less than one block) and avalanche result
+ * @param[in] result current result
+ * @param[in] data remaining data start
+ * @param[in] stop remaining data end
+ * @return final hash value
+ */
+static inline uint32_t xxhash32_finalize(uint32_t result, const uint8_t* data, const uint8_t* stop) {
+    for (; data + 4 <= stop; data += 4) {
+        result = ROTLEFT32(result + *(uint32_t*)data * XXHASH32_PRIME3, 17) * XXHASH32_PRIME4;
+    }
+
+    while (data != stop) {
+        result = ROTLEFT32(result + *data * XXHASH32_PRIME5, 11) * XXHASH32_PRIME1;
+        data++;
+    }
+
+    result ^= result >> 15;
+    result *= XXHASH32_PRIME2;
+    result ^= result >> 13;
+    result *= XXHASH32_PRIME3;
+    result ^= result >> 16;
+
+    return result;
+}
+
 uint32_t xxhash32_hash_with_seed(const void* input, uint64_t length, uint32_t seed) {
-    xxhash32_context_t* ctx = xxhash32_init(seed);
-    xxhash32_update(ctx, input, length);
+    const uint8_t* data = (const uint8_t*)input;
+    const uint8_t* stop = data + length;
+
+    uint32_t result = (uint32_t)length;
+
+    if (length >= XXHASH32_MAXBUFFERSIZE) {
+        uint32_t s0 = seed + XXHASH32_PRIME1 + XXHASH32_PRIME2;
+        uint32_t s1 = seed + XXHASH32_PRIME2;
+        uint32_t s2 = seed;
+        uint32_t s3 = seed - XXHASH32_PRIME1;
+
+        const uint8_t* limit = stop - XXHASH32_MAXBUFFERSIZE;
+
+        do {
+            xxhash32_process(data, &s0, &s1, &s2, &s3);
+            data += XXHASH32_MAXBUFFERSIZE;
+        } while (data <= limit);
+
+        result += ROTLEFT32(s0,  1) +
+                  ROTLEFT32(s1,  7) +
+                  ROTLEFT32(s2, 12) +
+                  ROTLEFT32(s3, 18);
+    } else {
+        result += seed + XXHASH32_PRIME5;
+    }
 
-    return xxhash32_final(ctx);
+    return xxhash32_finalize(result, data, stop);
 }
 
 xxhash32_context_t* xxhash32_init(uint32_t seed) {
@@ -309,23 +400,7 @@ uint32_t xxhash32_final(xxhash32_context_t* ctx) {
         result += ctx->state[2] + XXHASH32_PRIME5;
     }
 
-    const uint8_t* data = ctx->buffer;
-    const uint8_t* stop = data + ctx->buffer_size;
-
-    for (; data + 4 <= stop; data += 4) {
-        result = ROTLEFT32(result + *(uint32_t*)data * XXHASH32_PRIME3, 17) * XXHASH32_PRIME4;
-    }
-
-    while (data != stop) {
-        result = ROTLEFT32(result + *data * XXHASH32_PRIME5, 11) * XXHASH32_PRIME1;
-        data++;
-    }
-
-    result ^= result >> 15;
-    result *= XXHASH32_PRIME2;
-    result ^= result >> 13;
-    result *= XXHASH32_PRIME3;
-    result ^= result >> 16;
+    result = xxhash32_finalize(result, ctx->buffer, ctx->buffer + ctx->buffer_size);
 
     memory_free(ctx);
 
@@ -347,7 +422,7 @@ int8_t xxhash32_update(xxhash32_context_t* ctx, const void* input, uint64_t leng
 
     const uint8_t* data = (const uint8_t*)input;
 
-    if (ctx->buffer_size + ctx->total_length < XXHASH32_MAXBUFFERSIZE) {
+    if (ctx->buffer_size + length < XXHASH32_MAXBUFFERSIZE) {
         while (length-- > 0) {
             ctx->buffer[ctx->buffer_size++] = *data++;
         }
@@ -388,3 +463,651 @@ int8_t xxhash32_update(xxhash32_context_t* ctx, const void* input, uint64_t leng
 
     return 0;
 }
+
+/*! XXH3 stripe length, one accumulate round consumes that much input */
+#define XXHASH3_STRIPE_LEN            64
+/*! XXH3 secret bytes consumed per stripe */
+#define XXHASH3_SECRET_CONSUME_RATE   8
+/*! XXH3 accumulator count */
+#define XXHASH3_ACC_NB                (XXHASH3_STRIPE_LEN / sizeof(uint64_t))
+/*! XXH3 default secret size */
+#define XXHASH3_SECRET_SIZE           192
+/*! XXH3 minimum secret size */
+#define XXHASH3_SECRET_SIZE_MIN       136
+/*! XXH3 secret offset for merging accumulators */
+#define XXHASH3_SECRET_MERGEACCS_START 11
+/*! XXH3 secret offset for last stripe */
+#define XXHASH3_SECRET_LASTACC_START  7
+/*! XXH3 max input size for mid size path */
+#define XXHASH3_MIDSIZE_MAX           240
+/*! XXH3 mid size secret start offset */
+#define XXHASH3_MIDSIZE_STARTOFFSET   3
+/*! XXH3 mid size secret last offset */
+#define XXHASH3_MIDSIZE_LASTOFFSET    17
+/*! XXH3 stripes per block */
+#define XXHASH3_STRIPES_PER_BLOCK     ((XXHASH3_SECRET_SIZE - XXHASH3_STRIPE_LEN) / XXHASH3_SECRET_CONSUME_RATE)
+
+/*! unaligned 64-bit load type */
+typedef uint64_t xxhash_unaligned_u64_t __attribute__((aligned(1)));
+/*! unaligned 32-bit load type */
+typedef uint32_t xxhash_unaligned_u32_t __attribute__((aligned(1)));
+
+/*! XXH3 default secret */
+static const uint8_t xxhash3_default_secret[XXHASH3_SECRET_SIZE] __attribute__((aligned(64))) = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+/**
+ * @brief unaligned little endian 64-bit read
+ * @param[in] ptr source
+ * @return value
+ */
+static inline uint64_t xxhash3_read64(const uint8_t* ptr) {
+    return *(const xxhash_unaligned_u64_t*)ptr;
+}
+
+/**
+ * @brief unaligned little endian 32-bit read
+ * @param[in] ptr source
+ * @return value
+ */
+static inline uint32_t xxhash3_read32(const uint8_t* ptr) {
+    return *(const xxhash_unaligned_u32_t*)ptr;
+}
+
+/**
+ * @brief unaligned little endian 64-bit write
+ * @param[out] ptr destination
+ * @param[in] value value
+ */
+static inline void xxhash3_write64(uint8_t* ptr, uint64_t value) {
+    *(xxhash_unaligned_u64_t*)ptr = value;
+}
+
+/**
+ * @brief multiply two 64-bit values and fold 128-bit result into 64-bit with xor
+ * @param[in] lhs left operand
+ * @param[in] rhs right operand
+ * @return folded value
+ */
+static inline uint64_t xxhash3_mul128_fold64(uint64_t lhs, uint64_t rhs) {
+    uint128_t product = (uint128_t)lhs * rhs;
+
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/**
+ * @brief xxhash64 final mix
+ * @param[in] h value
+ * @return mixed value
+ */
+static inline uint64_t xxhash64_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= XXHASH64_PRIME2;
+    h ^= h >> 29;
+    h *= XXHASH64_PRIME3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+/**
+ * @brief XXH3 final mix
+ * @param[in] h value
+ * @return mixed value
+ */
+static inline uint64_t xxhash3_avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+
+    return h;
+}
+
+/**
+ * @brief XXH3 strong mix for 4-8 byte inputs
+ * @param[in] h value
+ * @param[in] len input length
+ * @return mixed value
+ */
+static inline uint64_t xxhash3_rrmxmx(uint64_t h, uint64_t len) {
+    h ^= ROTLEFT64(h, 49) ^ ROTLEFT64(h, 24);
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= h >> 28;
+
+    return h;
+}
+
+/**
+ * @brief mix 16 bytes of input with 16 bytes of secret
+ * @param[in] input input
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return mixed value
+ */
+static inline uint64_t xxhash3_mix16(const uint8_t* input, const uint8_t* secret, uint64_t seed) {
+    uint64_t lo = xxhash3_read64(input);
+    uint64_t hi = xxhash3_read64(input + 8);
+
+    return xxhash3_mul128_fold64(lo ^ (xxhash3_read64(secret) + seed),
+                                 hi ^ (xxhash3_read64(secret + 8) - seed));
+}
+
+/**
+ * @brief mix two 16 byte inputs into 128-bit accumulator
+ * @param[in,out] acc_lo low accumulator
+ * @param[in,out] acc_hi high accumulator
+ * @param[in] input1 first input
+ * @param[in] input2 second input
+ * @param[in] secret secret
+ * @param[in] seed seed
+ */
+static inline void xxhash3_mix32(uint64_t* acc_lo, uint64_t* acc_hi, const uint8_t* input1, const uint8_t* input2, const uint8_t* secret, uint64_t seed) {
+    *acc_lo += xxhash3_mix16(input1, secret, seed);
+    *acc_lo ^= xxhash3_read64(input2) + xxhash3_read64(input2 + 8);
+    *acc_hi += xxhash3_mix16(input2, secret + 16, seed);
+    *acc_hi ^= xxhash3_read64(input1) + xxhash3_read64(input1 + 8);
+}
+
+/*
+ * Long input accumulators. We build with -nostdinc so intrinsic headers are not available,
+ * vector extensions and the pmuludq builtins behind _mm_mul_epu32/_mm256_mul_epu32 are used instead.
+ * Without any vector unit the scalar loop is used.
+ */
+#if defined(__AVX2__)
+/*! XXH3 accumulator vector width in bytes */
+#define XXHASH3_VECTOR_SIZE 32
+/*! 32x32->64 lane multiply (vpmuludq) */
+#define XXHASH3_MUL32TO64(a, b) (xxhash3_vector_t)__builtin_ia32_pmuludq256((xxhash3_vector32_t)(a), (xxhash3_vector32_t)(b))
+#elif defined(__SSE2__)
+/*! XXH3 accumulator vector width in bytes */
+#define XXHASH3_VECTOR_SIZE 16
+/*! 32x32->64 lane multiply (pmuludq) */
+#define XXHASH3_MUL32TO64(a, b) (xxhash3_vector_t)__builtin_ia32_pmuludq128((xxhash3_vector32_t)(a), (xxhash3_vector32_t)(b))
+#endif
+
+#ifdef XXHASH3_VECTOR_SIZE
+/*! accumulator vector type */
+typedef uint64_t xxhash3_vector_t __attribute__((vector_size(XXHASH3_VECTOR_SIZE)));
+/*! accumulator vector as 32-bit lanes */
+typedef int32_t xxhash3_vector32_t __attribute__((vector_size(XXHASH3_VECTOR_SIZE)));
+/*! unaligned input vector type */
+typedef uint64_t xxhash3_unaligned_vector_t __attribute__((vector_size(XXHASH3_VECTOR_SIZE), aligned(1)));
+/*! vectors per stripe */
+#define XXHASH3_VECTOR_COUNT (XXHASH3_STRIPE_LEN / XXHASH3_VECTOR_SIZE)
+
+/**
+ * @brief accumulate one stripe into accumulators
+ * @param[in,out] acc accumulators, 64 byte aligned
+ * @param[in] input stripe
+ * @param[in] secret secret at stripe offset
+ */
+static inline void xxhash3_accumulate_512(uint64_t* acc, const uint8_t* input, const uint8_t* secret) {
+    xxhash3_vector_t* xacc = (xxhash3_vector_t*)acc;
+    const xxhash3_unaligned_vector_t* xinput = (const xxhash3_unaligned_vector_t*)input;
+    const xxhash3_unaligned_vector_t* xsecret = (const xxhash3_unaligned_vector_t*)secret;
+#if XXHASH3_VECTOR_SIZE == 32
+    const xxhash3_vector_t swap_mask = {1, 0, 3, 2};
+#else
+    const xxhash3_vector_t swap_mask = {1, 0};
+#endif
+
+    for(uint64_t i = 0; i < XXHASH3_VECTOR_COUNT; i++) {
+        xxhash3_vector_t data_vec = xinput[i];
+        xxhash3_vector_t data_key = data_vec ^ xsecret[i];
+        xxhash3_vector_t product = XXHASH3_MUL32TO64(data_key, data_key >> 32);
+
+        xacc[i] += product + __builtin_shuffle(data_vec, swap_mask);
+    }
+}
+
+/**
+ * @brief scramble accumulators at the end of each block
+ * @param[in,out] acc accumulators, 64 byte aligned
+ * @param[in] secret last stripe of secret
+ */
+static inline void xxhash3_scramble_acc(uint64_t* acc, const uint8_t* secret) {
+    xxhash3_vector_t* xacc = (xxhash3_vector_t*)acc;
+    const xxhash3_unaligned_vector_t* xsecret = (const xxhash3_unaligned_vector_t*)secret;
+    const xxhash3_vector_t prime = (xxhash3_vector_t){} + (uint64_t)XXHASH32_PRIME1;
+
+    for(uint64_t i = 0; i < XXHASH3_VECTOR_COUNT; i++) {
+        xxhash3_vector_t acc_vec = xacc[i];
+
+        acc_vec ^= acc_vec >> 47;
+        acc_vec ^= xsecret[i];
+
+        xxhash3_vector_t prod_lo = XXHASH3_MUL32TO64(acc_vec, prime);
+        xxhash3_vector_t prod_hi = XXHASH3_MUL32TO64(acc_vec >> 32, prime);
+
+        xacc[i] = prod_lo + (prod_hi << 32);
+    }
+}
+#else
+static inline void xxhash3_accumulate_512(uint64_t* acc, const uint8_t* input, const uint8_t* secret) {
+    for(uint64_t i = 0; i < XXHASH3_ACC_NB; i++) {
+        uint64_t data_val = xxhash3_read64(input + 8 * i);
+        uint64_t data_key = data_val ^ xxhash3_read64(secret + 8 * i);
+
+        acc[i ^ 1] += data_val;
+        acc[i] += (data_key & 0xFFFFFFFFULL) * (data_key >> 32);
+    }
+}
+
+static inline void xxhash3_scramble_acc(uint64_t* acc, const uint8_t* secret) {
+    for(uint64_t i = 0; i < XXHASH3_ACC_NB; i++) {
+        uint64_t acc_val = acc[i];
+
+        acc_val ^= acc_val >> 47;
+        acc_val ^= xxhash3_read64(secret + 8 * i);
+
+        acc[i] = acc_val * XXHASH32_PRIME1;
+    }
+}
+#endif
+
+/**
+ * @brief accumulate consecutive stripes
+ * @param[in,out] acc accumulators
+ * @param[in] input input
+ * @param[in] secret secret
+ * @param[in] nb_stripes stripe count
+ */
+static inline void xxhash3_accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, uint64_t nb_stripes) {
+    for(uint64_t n = 0; n < nb_stripes; n++) {
+        xxhash3_accumulate_512(acc, input + n * XXHASH3_STRIPE_LEN, secret + n * XXHASH3_SECRET_CONSUME_RATE);
+    }
+}
+
+/**
+ * @brief merge accumulators into 64-bit value
+ * @param[in] acc accumulators
+ * @param[in] secret secret at merge offset
+ * @param[in] start start value
+ * @return merged value
+ */
+static inline uint64_t xxhash3_merge_accs(const uint64_t* acc, const uint8_t* secret, uint64_t start) {
+    uint64_t result = start;
+
+    for(uint64_t i = 0; i < 4; i++) {
+        result += xxhash3_mul128_fold64(acc[2 * i] ^ xxhash3_read64(secret + 16 * i),
+                                        acc[2 * i + 1] ^ xxhash3_read64(secret + 16 * i + 8));
+    }
+
+    return xxhash3_avalanche(result);
+}
+
+/**
+ * @brief process long (> 240 bytes) input into accumulators
+ * @param[out] acc accumulators, 64 byte aligned
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret with XXHASH3_SECRET_SIZE bytes
+ */
+static void xxhash3_hash_long(uint64_t* acc, const uint8_t* input, uint64_t length, const uint8_t* secret) {
+    acc[0] = XXHASH32_PRIME3;
+    acc[1] = XXHASH64_PRIME1;
+    acc[2] = XXHASH64_PRIME2;
+    acc[3] = XXHASH64_PRIME3;
+    acc[4] = XXHASH64_PRIME4;
+    acc[5] = XXHASH32_PRIME2;
+    acc[6] = XXHASH64_PRIME5;
+    acc[7] = XXHASH32_PRIME1;
+
+    const uint64_t block_len = XXHASH3_STRIPE_LEN * XXHASH3_STRIPES_PER_BLOCK;
+    uint64_t nb_blocks = (length - 1) / block_len;
+
+    for(uint64_t n = 0; n < nb_blocks; n++) {
+        xxhash3_accumulate(acc, input + n * block_len, secret, XXHASH3_STRIPES_PER_BLOCK);
+        xxhash3_scramble_acc(acc, secret + XXHASH3_SECRET_SIZE - XXHASH3_STRIPE_LEN);
+    }
+
+    uint64_t nb_stripes = ((length - 1) - (block_len * nb_blocks)) / XXHASH3_STRIPE_LEN;
+    xxhash3_accumulate(acc, input + nb_blocks * block_len, secret, nb_stripes);
+
+    xxhash3_accumulate_512(acc, input + length - XXHASH3_STRIPE_LEN,
+                           secret + XXHASH3_SECRET_SIZE - XXHASH3_STRIPE_LEN - XXHASH3_SECRET_LASTACC_START);
+}
+
+/**
+ * @brief derive secret from seed, secret buffer should be XXHASH3_SECRET_SIZE bytes
+ * @param[out] secret derived secret
+ * @param[in] seed seed
+ */
+static inline void xxhash3_init_custom_secret(uint8_t* secret, uint64_t seed) {
+    for(uint64_t i = 0; i < XXHASH3_SECRET_SIZE / 16; i++) {
+        xxhash3_write64(secret + 16 * i,     xxhash3_read64(xxhash3_default_secret + 16 * i) + seed);
+        xxhash3_write64(secret + 16 * i + 8, xxhash3_read64(xxhash3_default_secret + 16 * i + 8) - seed);
+    }
+}
+
+/**
+ * @brief XXH3 64-bit for inputs up to 16 bytes
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return hash
+ */
+static inline uint64_t xxhash3_64_0to16(const uint8_t* input, uint64_t length, const uint8_t* secret, uint64_t seed) {
+    if(length > 8) {
+        uint64_t flip1 = (xxhash3_read64(secret + 24) ^ xxhash3_read64(secret + 32)) + seed;
+        uint64_t flip2 = (xxhash3_read64(secret + 40) ^ xxhash3_read64(secret + 48)) - seed;
+        uint64_t input_lo = xxhash3_read64(input) ^ flip1;
+        uint64_t input_hi = xxhash3_read64(input + length - 8) ^ flip2;
+        uint64_t acc = length + BYTE_SWAP64(input_lo) + input_hi + xxhash3_mul128_fold64(input_lo, input_hi);
+
+        return xxhash3_avalanche(acc);
+    }
+
+    if(length >= 4) {
+        seed ^= (uint64_t)BYTE_SWAP32((uint32_t)seed) << 32;
+
+        uint64_t input1 = xxhash3_read32(input);
+        uint64_t input2 = xxhash3_read32(input + length - 4);
+        uint64_t flip = (xxhash3_read64(secret + 8) ^ xxhash3_read64(secret + 16)) - seed;
+
+        return xxhash3_rrmxmx((input2 + (input1 << 32)) ^ flip, length);
+    }
+
+    if(length) {
+        uint32_t combined = ((uint32_t)input[0] << 16) | ((uint32_t)input[length >> 1] << 24) |
+                            ((uint32_t)input[length - 1]) | ((uint32_t)length << 8);
+        uint64_t flip = (uint64_t)(xxhash3_read32(secret) ^ xxhash3_read32(secret + 4)) + seed;
+
+        return xxhash64_avalanche((uint64_t)combined ^ flip);
+    }
+
+    return xxhash64_avalanche(seed ^ (xxhash3_read64(secret + 56) ^ xxhash3_read64(secret + 64)));
+}
+
+/**
+ * @brief XXH3 64-bit for inputs between 17 and 128 bytes
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return hash
+ */
+static inline uint64_t xxhash3_64_17to128(const uint8_t* input, uint64_t length, const uint8_t* secret, uint64_t seed) {
+    uint64_t acc = length * XXHASH64_PRIME1;
+
+    if(length > 32) {
+        if(length > 64) {
+            if(length > 96) {
+                acc += xxhash3_mix16(input + 48, secret + 96, seed);
+                acc += xxhash3_mix16(input + length - 64, secret + 112, seed);
+            }
+
+            acc += xxhash3_mix16(input + 32, secret + 64, seed);
+            acc += xxhash3_mix16(input + length - 48, secret + 80, seed);
+        }
+
+        acc += xxhash3_mix16(input + 16, secret + 32, seed);
+        acc += xxhash3_mix16(input + length - 32, secret + 48, seed);
+    }
+
+    acc += xxhash3_mix16(input, secret, seed);
+    acc += xxhash3_mix16(input + length - 16, secret + 16, seed);
+
+    return xxhash3_avalanche(acc);
+}
+
+/**
+ * @brief XXH3 64-bit for inputs between 129 and 240 bytes
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return hash
+ */
+static uint64_t xxhash3_64_129to240(const uint8_t* input, uint64_t length, const uint8_t* secret, uint64_t seed) {
+    uint64_t acc = length * XXHASH64_PRIME1;
+    uint64_t nb_rounds = length / 16;
+    uint64_t i;
+
+    for(i = 0; i < 8; i++) {
+        acc += xxhash3_mix16(input + 16 * i, secret + 16 * i, seed);
+    }
+
+    acc = xxhash3_avalanche(acc);
+
+    for(; i < nb_rounds; i++) {
+        acc += xxhash3_mix16(input + 16 * i, secret + 16 * (i - 8) + XXHASH3_MIDSIZE_STARTOFFSET, seed);
+    }
+
+    acc += xxhash3_mix16(input + length - 16, secret + XXHASH3_SECRET_SIZE_MIN - XXHASH3_MIDSIZE_LASTOFFSET, seed);
+
+    return xxhash3_avalanche(acc);
+}
+
+uint64_t xxhash3_64_hash_with_seed(const void* input, uint64_t length, uint64_t seed) {
+    const uint8_t* data = (const uint8_t*)input;
+
+    if(length <= 16) {
+        return xxhash3_64_0to16(data, length, xxhash3_default_secret, seed);
+    }
+
+    if(length <= 128) {
+        return xxhash3_64_17to128(data, length, xxhash3_default_secret, seed);
+    }
+
+    if(length <= XXHASH3_MIDSIZE_MAX) {
+        return xxhash3_64_129to240(data, length, xxhash3_default_secret, seed);
+    }
+
+    uint64_t acc[XXHASH3_ACC_NB] __attribute__((aligned(64)));
+    uint8_t custom_secret[XXHASH3_SECRET_SIZE] __attribute__((aligned(64)));
+    const uint8_t* secret = xxhash3_default_secret;
+
+    if(seed) {
+        xxhash3_init_custom_secret(custom_secret, seed);
+        secret = custom_secret;
+    }
+
+    xxhash3_hash_long(acc, data, length, secret);
+
+    return xxhash3_merge_accs(acc, secret + XXHASH3_SECRET_MERGEACCS_START, length * XXHASH64_PRIME1);
+}
+
+/**
+ * @brief build 128-bit value from halves
+ * @param[in] low low half
+ * @param[in] high high half
+ * @return 128-bit value
+ */
+static inline uint128_t xxhash3_128_make(uint64_t low, uint64_t high) {
+    return ((uint128_t)high << 64) | low;
+}
+
+/**
+ * @brief XXH3 128-bit for inputs up to 16 bytes
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return hash
+ */
+static inline uint128_t xxhash3_128_0to16(const uint8_t* input, uint64_t length, const uint8_t* secret, uint64_t seed) {
+    if(length > 8) {
+        uint64_t flip_lo = (xxhash3_read64(secret + 32) ^ xxhash3_read64(secret + 40)) - seed;
+        uint64_t flip_hi = (xxhash3_read64(secret + 48) ^ xxhash3_read64(secret + 56)) + seed;
+        uint64_t input_lo = xxhash3_read64(input);
+        uint64_t input_hi = xxhash3_read64(input + length - 8);
+
+        uint128_t m128 = (uint128_t)(input_lo ^ input_hi ^ flip_lo) * XXHASH64_PRIME1;
+        uint64_t m_lo = (uint64_t)m128;
+        uint64_t m_hi = (uint64_t)(m128 >> 64);
+
+        m_lo += (length - 1) << 54;
+        input_hi ^= flip_hi;
+        m_hi += input_hi + (uint64_t)(uint32_t)input_hi * (XXHASH32_PRIME2 - 1);
+        m_lo ^= BYTE_SWAP64(m_hi);
+
+        uint128_t h128 = (uint128_t)m_lo * XXHASH64_PRIME2;
+        uint64_t h_lo = (uint64_t)h128;
+        uint64_t h_hi = (uint64_t)(h128 >> 64) + m_hi * XXHASH64_PRIME2;
+
+        return xxhash3_128_make(xxhash3_avalanche(h_lo), xxhash3_avalanche(h_hi));
+    }
+
+    if(length >= 4) {
+        seed ^= (uint64_t)BYTE_SWAP32((uint32_t)seed) << 32;
+
+        uint64_t input_lo = xxhash3_read32(input);
+        uint64_t input_hi = xxhash3_read32(input + length - 4);
+        uint64_t flip = (xxhash3_read64(secret + 16) ^ xxhash3_read64(secret + 24)) + seed;
+        uint64_t keyed = (input_lo + (input_hi << 32)) ^ flip;
+
+        uint128_t m128 = (uint128_t)keyed * (XXHASH64_PRIME1 + (length << 2));
+        uint64_t m_lo = (uint64_t)m128;
+        uint64_t m_hi = (uint64_t)(m128 >> 64);
+
+        m_hi += m_lo << 1;
+        m_lo ^= m_hi >> 3;
+
+        m_lo ^= m_lo >> 35;
+        m_lo *= 0x9FB21C651E98DF25ULL;
+        m_lo ^= m_lo >> 28;
+
+        return xxhash3_128_make(m_lo, xxhash3_avalanche(m_hi));
+    }
+
+    if(length) {
+        uint32_t combined_lo = ((uint32_t)input[0] << 16) | ((uint32_t)input[length >> 1] << 24) |
+                               ((uint32_t)input[length - 1]) | ((uint32_t)length << 8);
+        uint32_t combined_hi = ROTLEFT32(BYTE_SWAP32(combined_lo), 13);
+        uint64_t flip_lo = (uint64_t)(xxhash3_read32(secret) ^ xxhash3_read32(secret + 4)) + seed;
+        uint64_t flip_hi = (uint64_t)(xxhash3_read32(secret + 8) ^ xxhash3_read32(secret + 12)) - seed;
+
+        return xxhash3_128_make(xxhash64_avalanche((uint64_t)combined_lo ^ flip_lo),
+                                xxhash64_avalanche((uint64_t)combined_hi ^ flip_hi));
+    }
+
+    uint64_t flip_lo = xxhash3_read64(secret + 64) ^ xxhash3_read64(secret + 72);
+    uint64_t flip_hi = xxhash3_read64(secret + 80) ^ xxhash3_read64(secret + 88);
+
+    return xxhash3_128_make(xxhash64_avalanche(seed ^ flip_lo), xxhash64_avalanche(seed ^ flip_hi));
+}
+
+/**
+ * @brief XXH3 128-bit final mix of mid size accumulators
+ * @param[in] acc_lo low accumulator
+ * @param[in] acc_hi high accumulator
+ * @param[in] length input length
+ * @param[in] seed seed
+ * @return hash
+ */
+static inline uint128_t xxhash3_128_mix_final(uint64_t acc_lo, uint64_t acc_hi, uint64_t length, uint64_t seed) {
+    uint64_t h_lo = acc_lo + acc_hi;
+    uint64_t h_hi = (acc_lo * XXHASH64_PRIME1) + (acc_hi * XXHASH64_PRIME4) + ((length - seed) * XXHASH64_PRIME2);
+
+    return xxhash3_128_make(xxhash3_avalanche(h_lo), 0ULL - xxhash3_avalanche(h_hi));
+}
+
+/**
+ * @brief XXH3 128-bit for inputs between 17 and 128 bytes
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return hash
+ */
+static inline uint128_t xxhash3_128_17to128(const uint8_t* input, uint64_t length, const uint8_t* secret, uint64_t seed) {
+    uint64_t acc_lo = length * XXHASH64_PRIME1;
+    uint64_t acc_hi = 0;
+
+    if(length > 32) {
+        if(length > 64) {
+            if(length > 96) {
+                xxhash3_mix32(&acc_lo, &acc_hi, input + 48, input + length - 64, secret + 96, seed);
+            }
+
+            xxhash3_mix32(&acc_lo, &acc_hi, input + 32, input + length - 48, secret + 64, seed);
+        }
+
+        xxhash3_mix32(&acc_lo, &acc_hi, input + 16, input + length - 32, secret + 32, seed);
+    }
+
+    xxhash3_mix32(&acc_lo, &acc_hi, input, input + length - 16, secret, seed);
+
+    return xxhash3_128_mix_final(acc_lo, acc_hi, length, seed);
+}
+
+/**
+ * @brief XXH3 128-bit for inputs between 129 and 240 bytes
+ * @param[in] input input
+ * @param[in] length input length
+ * @param[in] secret secret
+ * @param[in] seed seed
+ * @return hash
+ */
+static uint128_t xxhash3_128_129to240(const uint8_t* input, uint64_t length, const uint8_t* secret, uint64_t seed) {
+    uint64_t acc_lo = length * XXHASH64_PRIME1;
+    uint64_t acc_hi = 0;
+    uint64_t nb_rounds = length / 32;
+    uint64_t i;
+
+    for(i = 0; i < 4; i++) {
+        xxhash3_mix32(&acc_lo, &acc_hi, input + 32 * i, input + 32 * i + 16, secret + 32 * i, seed);
+    }
+
+    acc_lo = xxhash3_avalanche(acc_lo);
+    acc_hi = xxhash3_avalanche(acc_hi);
+
+    for(; i < nb_rounds; i++) {
+        xxhash3_mix32(&acc_lo, &acc_hi, input + 32 * i, input + 32 * i + 16,
+                      secret + XXHASH3_MIDSIZE_STARTOFFSET + 32 * (i - 4), seed);
+    }
+
+    xxhash3_mix32(&acc_lo, &acc_hi, input + length - 16, input + length - 32,
+                  secret + XXHASH3_SECRET_SIZE_MIN - XXHASH3_MIDSIZE_LASTOFFSET - 16, 0ULL - seed);
+
+    return xxhash3_128_mix_final(acc_lo, acc_hi, length, seed);
+}
+
+uint128_t xxhash3_128_hash_with_seed(const void* input, uint64_t length, uint64_t seed) {
+    const uint8_t* data = (const uint8_t*)input;
+
+    if(length <= 16) {
+        return xxhash3_128_0to16(data, length, xxhash3_default_secret, seed);
+    }
+
+    if(length <= 128) {
+        return xxhash3_128_17to128(data, length, xxhash3_default_secret, seed);
+    }
+
+    if(length <= XXHASH3_MIDSIZE_MAX) {
+        return xxhash3_128_129to240(data, length, xxhash3_default_secret, seed);
+    }
+
+    uint64_t acc[XXHASH3_ACC_NB] __attribute__((aligned(64)));
+    uint8_t custom_secret[XXHASH3_SECRET_SIZE] __attribute__((aligned(64)));
+    const uint8_t* secret = xxhash3_default_secret;
+
+    if(seed) {
+        xxhash3_init_custom_secret(custom_secret, seed);
+        secret = custom_secret;
+    }
+
+    xxhash3_hash_long(acc, data, length, secret);
+
+    uint64_t low = xxhash3_merge_accs(acc, secret + XXHASH3_SECRET_MERGEACCS_START, length * XXHASH64_PRIME1);
+    uint64_t high = xxhash3_merge_accs(acc, secret + XXHASH3_SECRET_SIZE - sizeof(acc) - XXHASH3_SECRET_MERGEACCS_START,
+                                       ~(length * XXHASH64_PRIME2));
+
+    return xxhash3_128_make(low, high);
+}
@@ -15,12 +15,19 @@
 #include <cpu/task.h>
 #include <cpu.h>
 #include <time/timer.h>
+#include <time.h>
 #include <network/network_protocols.h>
 #include <network/network_info.h>
+#include <network/network_ethernet.h>
+#include <network/network_packet.h>
+#include <network/network_ipv4_fragment.h>
+#include <network/network_tcpv4.h>
+#include <network/network_socket.h>
 
 MODULE("turnstone.user.programs.network");
 
 int8_t   network_process_rx(void);
+int8_t   network_tcp_timer(void);
 uint64_t network_info_mke(const void* key);
 
 list_t* network_received_packets = NULL;
@@ -34,80 +41,52 @@ uint64_t network_info_mke(const void* key) {
     return x;
 }
 
-int8_t network_transmit_packet_destroyer(memory_heap_t* heap, void* data) {
-    UNUSED(heap);
-
-    network_transmit_packet_t* t_pckt = data;
-
-    memory_free(t_pckt->packet_data);
-    memory_free(t_pckt);
-
-    return 0;
-}
-
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-static int8_t network_set_return_queue(const network_mac_address_t* mac, list_t* return_queue) {
+static network_info_t* network_info_get_or_create(const network_mac_address_t* mac) {
     network_info_t* ni = (network_info_t*)map_get(network_info_map, mac);
 
     if(!ni) {
         ni = memory_malloc(sizeof(network_info_t));
 
         if(!ni) {
-            return -1;
+            return NULL;
         }
 
         memory_memcopy(mac, ni->mac, sizeof(network_mac_address_t));
         map_insert(network_info_map, ni->mac, ni);
     }
 
-    if(!ni->return_queue) {
-        ni->return_queue = return_queue;
-    }
-
-    return 0;
+    return ni;
 }
 
-static int8_t network_send_packet_to_nic(network_transmit_packet_t* orginal_packet, list_t* return_queue) {
-    network_transmit_packet_t* tx_packet = memory_malloc_ext(list_get_heap(return_queue), sizeof(network_transmit_packet_t), 0);
-
-    if(tx_packet == NULL) {
-        network_transmit_packet_destroyer(NULL, orginal_packet);
-
-        task_yield();
+static int8_t network_set_return_queue(const network_mac_address_t* mac, network_tx_queue_t* return_queue) {
+    network_info_t* ni = network_info_get_or_create(mac);
 
+    if(!ni) {
         return -1;
     }
 
-    uint8_t* tx_packet_data = memory_malloc_ext(list_get_heap(return_queue), orginal_packet->packet_len, 0);
-
-    if(tx_packet_data == NULL) {
-        network_transmit_packet_destroyer(NULL, orginal_packet);
-        memory_free_ext(list_get_heap(return_queue), tx_packet);
+    if(!ni->return_queue) {
+        ni->return_queue = return_queue;
+    }
 
-        task_yield();
+    return 0;
+}
 
+int8_t network_info_set_tx_checksum_offload(const network_mac_address_t* mac, boolean_t enabled) {
+    if(!network_info_map) {
         return -1;
     }
 
-    memory_memcopy(orginal_packet->packet_data, tx_packet_data, orginal_packet->packet_len);
-
-    tx_packet->packet_len = orginal_packet->packet_len;
-    tx_packet->packet_data = tx_packet_data;
-
-    network_transmit_packet_destroyer(NULL, orginal_packet);
-
-    if(list_queue_push(return_queue, tx_packet) == -1ULL) {
-        memory_free_ext(list_get_heap(return_queue), tx_packet_data);
-        memory_free_ext(list_get_heap(return_queue), tx_packet);
-
-        task_yield();
+    network_info_t* ni = network_info_get_or_create(mac);
 
+    if(!ni) {
         return -1;
-    } else {
-        PRINTLOG(NETWORK, LOG_TRACE, "packet pushed to return queue");
     }
 
+    ni->tx_checksum_offload = enabled;
+
     return 0;
 }
 #pragma GCC diagnostic pop
@@ -124,51 +103,45 @@ int8_t network_process_rx(void){
             task_yield();
         }
 
+        // timer task wakes us
+        network_tcpv4_process_timers();
+        network_ipv4_fragment_process_timers(time_ns(NULL) / 1000000ULL);
+
         while(list_size(network_received_packets)) {
-            const network_received_packet_t* packet = list_queue_pop(network_received_packets);
+            network_packet_t* packet = (network_packet_t*)list_queue_pop(network_received_packets);
 
             if(packet) {
-                PRINTLOG(NETWORK, LOG_TRACE, "network packet received with length 0x%llx", packet->packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "network packet received with length 0x%x", packet->length);
 
-                list_t* return_list = NULL;
+                network_packet_t* responses = NULL;
+                network_tx_queue_t* return_queue = packet->return_queue;
 
                 if(packet->network_type == NETWORK_TYPE_ETHERNET) {
 
-                    network_set_return_queue(packet->network_info, packet->return_queue);
+                    network_set_return_queue(packet->network_info, return_queue);
 
-                    return_list = network_ethernet_process_packet((network_ethernet_t*)packet->packet_data, packet->network_info);
+                    responses = network_ethernet_process_packet(packet);
+                } else {
+                    network_packet_release(packet);
                 }
 
-                list_t* return_queue = packet->return_queue;
-
-                memory_free(packet->packet_data);
-                memory_free((void*)packet);
-
-                if(return_list) {
+                if(responses) {
                     if(return_queue) {
-                        boolean_t notify_tx_proc = list_size(return_list) > 0;
-
-                        while(list_size(return_list)) {
-                            network_transmit_packet_t* tx_packet = (network_transmit_packet_t*)list_queue_pop(return_list);
-
-                            if(tx_packet) {
-                                if(network_send_packet_to_nic(tx_packet, return_queue) == -1) {
-                                    break;
-                                }
+                        // responses are handed to nic at once, tx task releases them. a full queue gives tx task a chance to drain
+                        if(network_tx_queue_push(return_queue, responses) != 0) {
+                            task_yield();
 
-                                if(notify_tx_proc) {
-                                    // task_set_message_received(network_vnet_tx_task_id); //FIXME: notify task of return queue
-                                    notify_tx_proc = false;
-                                }
+                            if(network_tx_queue_push(return_queue, responses) != 0) {
+                                PRINTLOG(NETWORK, LOG_TRACE, "tx queue is full, responses are dropped");
+                                network_packet_release_chain(responses);
                             }
+                        } else {
+                            PRINTLOG(NETWORK, LOG_TRACE, "packets pushed to return queue");
                         }
-
-                        list_destroy_with_type(return_list, LIST_DESTROY_WITH_DATA, &network_transmit_packet_destroyer);
-
                     } else {
                         PRINTLOG(NETWORK, LOG_TRACE, "there is no return queue");
 
-                        list_destroy_with_type(return_list, LIST_DESTROY_WITH_DATA, &network_transmit_packet_destroyer);
+                        network_packet_release_chain(responses);
                     }
 
                 } else {
@@ -187,12 +160,30 @@ int8_t network_process_rx(void){
 
 uint64_t network_rx_task_id = 0;
 
+int8_t network_tcp_timer(void) {
+    while(1) {
+        time_timer_msleep(NETWORK_TCPV4_TIMER_INTERVAL_MS);
+
+        if(network_rx_task_id) {
+            task_set_message_received(network_rx_task_id);
+        }
+    }
+
+    return 0;
+}
+
 int8_t network_init(void) {
     PRINTLOG(NETWORK, LOG_INFO, "network devices starting");
     int8_t errors = 0;
 
     network_info_map = map_new(&network_info_mke);
 
+    if(network_socket_init() != 0) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot initialize sockets");
+
+        return -1;
+    }
+
     iterator_t* iter = list_iterator_create(pci_get_context()->network_controllers);
 
     while(iter->end_of_iterator(iter) != 0) {
@@ -213,6 +204,8 @@ int8_t network_init(void) {
     iter->destroy(iter);
 
     network_rx_task_id = task_create_task(NULL, 2 << 20, 64 << 10, &network_process_rx, 0, NULL, "network rx task");
+    task_create_task(NULL, 64 << 10, 16 << 10, &network_tcp_timer, 0, NULL, "network tcp timer task");
+    task_create_task(NULL, 1 << 20, 64 << 10, &network_services_task, 0, NULL, "network services task");
 
     PRINTLOG(NETWORK, LOG_INFO, "network devices started");
 
@@ -0,0 +1,204 @@
+/**
+ * @file network_services.64.c
+ * @brief Builtin tcp echo and http services over sockets.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network.h>
+#include <network/network_socket.h>
+#include <memory.h>
+#include <logging.h>
+#include <strings.h>
+#include <utils.h>
+
+MODULE("turnstone.user.programs.network");
+
+#define NETWORK_SERVICES_ECHO_PORT   7
+#define NETWORK_SERVICES_HTTP_PORT   80
+#define NETWORK_SERVICES_MAX_CLIENTS 64
+#define NETWORK_SERVICES_BUFFER_SIZE 2048
+
+typedef enum network_services_type_t {
+    NETWORK_SERVICES_TYPE_ECHO,
+    NETWORK_SERVICES_TYPE_HTTP,
+} network_services_type_t;
+
+typedef struct network_services_client_t {
+    network_socket_t*       socket;
+    network_services_type_t type;
+    uint32_t                pending_start; ///< first echo byte not sent yet
+    uint32_t                pending_length; ///< echo bytes waiting for send buffer room
+    uint8_t                 buffer[NETWORK_SERVICES_BUFFER_SIZE];
+} network_services_client_t;
+
+static const char_t network_services_http_response[] = "HTTP/1.1 200 OK\r\n" \
+                                                       "Content-Type: text/plain\r\n" \
+                                                       "Content-Length: 13\r\n" \
+                                                       "Connection: close\r\n" \
+                                                       "X-Operating-System: Turnstone OS\r\n" \
+                                                       "\r\n" \
+                                                       "Hello World!\n";
+
+static network_socket_t* network_services_listen(uint16_t port) {
+    network_socket_t* socket = network_socket_create(NETWORK_SOCKET_TYPE_STREAM);
+    network_ipv4_address_t any = {0};
+
+    if(socket == NULL) {
+        return NULL;
+    }
+
+    if(network_socket_bind(socket, any, port) != 0 || network_socket_listen(socket, 0) != 0) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot listen port %i", port);
+        network_socket_close(socket);
+
+        return NULL;
+    }
+
+    return socket;
+}
+
+static void network_services_accept(network_socket_t* listener, network_services_type_t type, network_services_client_t** clients) {
+    network_socket_t* socket = NULL;
+
+    while((socket = network_socket_accept(listener)) != NULL) {
+        uint32_t slot = 0;
+
+        while(slot < NETWORK_SERVICES_MAX_CLIENTS && clients[slot]) {
+            slot++;
+        }
+
+        network_services_client_t* client = NULL;
+
+        if(slot < NETWORK_SERVICES_MAX_CLIENTS) {
+            client = memory_malloc(sizeof(network_services_client_t));
+        }
+
+        if(client == NULL) {
+            network_socket_close(socket);
+
+            continue;
+        }
+
+        client->socket = socket;
+        client->type = type;
+        clients[slot] = client;
+    }
+}
+
+/*! serves a ready client, returns false when client is done */
+static boolean_t network_services_serve(network_services_client_t* client) {
+    if(client->type == NETWORK_SERVICES_TYPE_HTTP) {
+        int64_t len = network_socket_recv(client->socket, client->buffer, sizeof(client->buffer));
+
+        if(len == 0) {
+            return true;
+        }
+
+        if(len > 0) {
+            network_socket_send(client->socket, network_services_http_response, strlen(network_services_http_response));
+        }
+
+        return false;
+    }
+
+    while(true) {
+        if(client->pending_length) {
+            int64_t sent = network_socket_send(client->socket, client->buffer + client->pending_start, client->pending_length);
+
+            if(sent < 0) {
+                return false;
+            }
+
+            client->pending_start += sent;
+            client->pending_length -= sent;
+
+            if(client->pending_length) {
+                // send buffer is full, socket is polled for writability
+                return true;
+            }
+        }
+
+        int64_t len = network_socket_recv(client->socket, client->buffer, sizeof(client->buffer));
+
+        if(len == 0) {
+            return true;
+        }
+
+        if(len < 0) {
+            return false;
+        }
+
+        client->pending_start = 0;
+        client->pending_length = len;
+    }
+}
+
+int8_t network_services_task(void) {
+    network_socket_t* echo = network_services_listen(NETWORK_SERVICES_ECHO_PORT);
+    network_socket_t* http = network_services_listen(NETWORK_SERVICES_HTTP_PORT);
+
+    network_services_client_t** clients = memory_malloc(sizeof(network_services_client_t*) * NETWORK_SERVICES_MAX_CLIENTS);
+    network_socket_poll_t* fds = memory_malloc(sizeof(network_socket_poll_t) * (NETWORK_SERVICES_MAX_CLIENTS + 2));
+    uint32_t* fd_slots = memory_malloc(sizeof(uint32_t) * NETWORK_SERVICES_MAX_CLIENTS);
+
+    if(echo == NULL || http == NULL || clients == NULL || fds == NULL || fd_slots == NULL) {
+        PRINTLOG(NETWORK, LOG_ERROR, "network services cannot be started");
+
+        network_socket_close(echo);
+        network_socket_close(http);
+        memory_free(clients);
+        memory_free(fds);
+        memory_free(fd_slots);
+
+        return -1;
+    }
+
+    PRINTLOG(NETWORK, LOG_INFO, "echo and http services started");
+
+    while(true) {
+        uint64_t count = 0;
+
+        fds[count].socket = echo;
+        fds[count++].events = NETWORK_SOCKET_EVENT_READABLE;
+        fds[count].socket = http;
+        fds[count++].events = NETWORK_SOCKET_EVENT_READABLE;
+
+        for(uint32_t i = 0; i < NETWORK_SERVICES_MAX_CLIENTS; i++) {
+            if(clients[i]) {
+                fd_slots[count - 2] = i;
+                fds[count].socket = clients[i]->socket;
+                fds[count++].events = clients[i]->pending_length ? NETWORK_SOCKET_EVENT_WRITABLE : NETWORK_SOCKET_EVENT_READABLE;
+            }
+        }
+
+        if(network_socket_poll(fds, count, NETWORK_SOCKET_POLL_FOREVER) <= 0) {
+            continue;
+        }
+
+        if(fds[0].revents) {
+            network_services_accept(echo, NETWORK_SERVICES_TYPE_ECHO, clients);
+        }
+
+        if(fds[1].revents) {
+            network_services_accept(http, NETWORK_SERVICES_TYPE_HTTP, clients);
+        }
+
+        for(uint64_t i = 2; i < count; i++) {
+            if(fds[i].revents == 0) {
+                continue;
+            }
+
+            uint32_t slot = fd_slots[i - 2];
+
+            if(!network_services_serve(clients[slot])) {
+                network_socket_close(clients[slot]->socket);
+                memory_free(clients[slot]);
+                clients[slot] = NULL;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -31,7 +31,7 @@ struct tosdb_cache_t {
 /**
  * @brief tosdb cache key generator
  * @param item item to create key
- * @return key which is generated from item with xxhash64 algorithm
+ * @return key which is generated from item with xxh3 64-bit algorithm
  */
 uint64_t tosdb_cache_key_generator(const void* item);
 
@@ -56,15 +56,9 @@ boolean_t tosdb_cache_item_key_destroyer(const void* key, const void* item);
 uint64_t tosdb_cache_key_generator(const void* item) {
     const tosdb_cache_key_t* key = item;
 
-    xxhash64_context_t* hctx = xxhash64_init(0);
+    uint64_t hkey[5] = {key->database_id, key->table_id, key->index_id, key->level, key->sstable_id};
 
-    xxhash64_update(hctx, &key->database_id, 8);
-    xxhash64_update(hctx, &key->table_id, 8);
-    xxhash64_update(hctx, &key->index_id, 8);
-    xxhash64_update(hctx, &key->level, 8);
-    xxhash64_update(hctx, &key->sstable_id, 8);
-
-    return xxhash64_final(hctx);
+    return xxhash3_64_hash(hkey, sizeof(hkey));
 }
 
 int8_t tosdb_cache_key_comparator(const void* item1, const void* item2) {
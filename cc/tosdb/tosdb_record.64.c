@@ -914,11 +914,9 @@ tosdb_record_t* tosdb_table_create_record(tosdb_table_t* tbl) {
     rec_id <<= 64;
     rec_id |= rand64();
 
-    xxhash64_context_t* hash_ctx = xxhash64_init(0);
-    xxhash64_update(hash_ctx, ctx->table->db->name, strlen(ctx->table->db->name));
-    xxhash64_update(hash_ctx, ctx->table->name, strlen(ctx->table->name));
-    xxhash64_update(hash_ctx, &rec_id, sizeof(uint128_t));
-    uint64_t hash = xxhash64_final(hash_ctx);
+    uint64_t hash = xxhash3_64_hash(ctx->table->db->name, strlen(ctx->table->db->name));
+    hash = xxhash3_64_hash_with_seed(ctx->table->name, strlen(ctx->table->name), hash);
+    hash = xxhash3_64_hash_with_seed(&rec_id, sizeof(uint128_t), hash);
 
     rec_id |= hash;
 
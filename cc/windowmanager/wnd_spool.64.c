@@ -251,6 +251,67 @@ static int8_t windowmanager_create_and_show_spool_item_window(spool_item_t* spoo
     return 0;
 }
 
+/*! spool ring snapshot text, allocated once and refilled so open viewers never see freed memory */
+static char_t* wndmgr_spool_records_text = NULL;
+/*! copy buffer for one spool ring record */
+static uint8_t* wndmgr_spool_records_scratch = NULL;
+
+static const char_t* wndmgr_spool_records_snapshot(void) {
+    spool_ring_t* ring = spool_get_ring();
+
+    if(!ring) {
+        return NULL;
+    }
+
+    uint64_t capacity = spool_ring_get_capacity(ring);
+    // every record spends at least a header at ring, more than its separators
+    uint64_t text_capacity = capacity + 128;
+    uint64_t scratch_size = capacity / 2;
+
+    if(!wndmgr_spool_records_text) {
+        wndmgr_spool_records_text = memory_malloc(text_capacity);
+        wndmgr_spool_records_scratch = memory_malloc(scratch_size);
+
+        if(!wndmgr_spool_records_text || !wndmgr_spool_records_scratch) {
+            memory_free(wndmgr_spool_records_text);
+            memory_free(wndmgr_spool_records_scratch);
+            wndmgr_spool_records_text = NULL;
+            wndmgr_spool_records_scratch = NULL;
+
+            return NULL;
+        }
+    }
+
+    char_t* text = wndmgr_spool_records_text;
+    uint64_t text_length = 0;
+
+    spool_ring_cursor_t cursor = {0};
+    spool_ring_record_t record = {0};
+
+    spool_ring_cursor_init(ring, &cursor);
+
+    while(spool_ring_read(ring, &cursor, &record, wndmgr_spool_records_scratch, scratch_size) == 0) {
+        if(text_length + record.name_length + record.data_length + 3 >= text_capacity) {
+            break;
+        }
+
+        memory_memcopy(record.name, text + text_length, record.name_length);
+        text_length += record.name_length;
+        text[text_length++] = ':';
+        text[text_length++] = ' ';
+        memory_memcopy(record.data, text + text_length, record.data_length);
+        text_length += record.data_length;
+
+        if(record.data_length == 0 || record.data[record.data_length - 1] != '\n') {
+            text[text_length++] = '\n';
+        }
+    }
+
+    text[text_length] = '\0';
+
+    return text;
+}
+
 static int8_t wndmgr_spool_browser_on_enter(const window_event_t* event) {
     if(!event) {
         return -1;
@@ -280,6 +341,18 @@ static int8_t wndmgr_spool_browser_on_enter(const window_event_t* event) {
             continue;
         }
 
+        if(strcmp(input->id, "records") == 0) {
+            if(input->value && strcmp(input->value, "s") == 0) {
+                const char_t* records_text = wndmgr_spool_records_snapshot();
+
+                if(records_text) {
+                    windowmanager_create_and_show_editor_window("Spool Records", records_text, true);
+                }
+
+                break;
+            }
+        }
+
         if(strcmp(input->id, "spool") == 0) {
             const spool_item_t* spool = (const spool_item_t*)input->extra_data;
 
@@ -418,6 +491,43 @@ int8_t windowmanager_create_and_show_spool_browser_window(void) {
     int32_t left = font_width + 5 * font_width;
     int32_t top = wnd_header->rect.y + wnd_header->rect.height;
 
+    spool_ring_t* ring = spool_get_ring();
+
+    if(ring) {
+        window_t* wnd_records_input = windowmanager_create_window(window,
+                                                                  strdup("_"),
+                                                                  (rect_t){font_width*2, top, font_width, font_height},
+                                                                  (color_t){.color = 0x00000000},
+                                                                  (color_t){.color = 0xFFF0000});
+
+        if(!wnd_records_input) {
+            windowmanager_destroy_window(window);
+            return -1;
+        }
+
+        wnd_records_input->is_writable = true;
+        wnd_records_input->input_length = 1;
+        wnd_records_input->input_id = "records";
+
+        char_t* records_text = strprintf("%- 30s% 15lli% 20lli",
+                                         "records",
+                                         1ULL,
+                                         spool_ring_get_capacity(ring));
+
+        window_t* wnd_records = windowmanager_create_window(window,
+                                                            records_text,
+                                                            (rect_t){left, top, screen_info.width - left, font_height},
+                                                            (color_t){.color = 0x00000000},
+                                                            (color_t){.color = 0xFF00FF00});
+
+        if(!wnd_records) {
+            windowmanager_destroy_window(window);
+            return -1;
+        }
+
+        top += font_height;
+    }
+
     list_t* spool_list = spool_get_all();
 
     for(size_t i = 0; i < list_size(spool_list); i++) {
@@ -0,0 +1,75 @@
+/**
+ * @file aho_corasick.h
+ * @brief aho-corasick multi pattern matcher interface
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+#ifndef ___AHO_CORASICK_H
+/*! prevent duplicate header error macro */
+#define ___AHO_CORASICK_H 0
+
+#include <types.h>
+#include <memory.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! compiled pattern set */
+typedef struct aho_corasick_t aho_corasick_t;
+
+/**
+ * @brief match callback
+ * @param[in] pattern_id index of matched pattern at pattern array
+ * @param[in] start match start at data
+ * @param[in] end match end at data, exclusive
+ * @param[in] arg callback argument
+ * @return 0 to continue, any other value stops search
+ */
+typedef int8_t (*aho_corasick_match_f)(uint64_t pattern_id, uint64_t start, uint64_t end, void* arg);
+
+/**
+ * @brief compiles patterns into a deterministic automaton, one byte of data is one table lookup
+ * @param[in] heap heap for automaton
+ * @param[in] patterns patterns
+ * @param[in] pattern_lens pattern lengths, empty patterns are not allowed
+ * @param[in] pattern_count pattern count
+ * @return automaton, NULL on error. duplicate patterns are reported with their first index.
+ */
+aho_corasick_t* aho_corasick_create_with_heap(memory_heap_t* heap, const uint8_t* const* patterns, const uint64_t* pattern_lens, uint64_t pattern_count);
+#define aho_corasick_create(p, l, c) aho_corasick_create_with_heap(NULL, p, l, c)
+
+/**
+ * @brief reports every occurrence of every pattern, overlapping ones included, in order of match end
+ * @param[in] ac automaton
+ * @param[in] data data to search
+ * @param[in] data_len data length
+ * @param[in] callback match callback
+ * @param[in] arg callback argument
+ * @return reported match count, -1 on error
+ */
+int64_t aho_corasick_search(const aho_corasick_t* ac, const uint8_t* data, uint64_t data_len, aho_corasick_match_f callback, void* arg);
+
+/**
+ * @brief finds match with the smallest end, the longest pattern wins at the same end
+ * @param[in] ac automaton
+ * @param[in] data data to search
+ * @param[in] data_len data length
+ * @param[out] pattern_id matched pattern index, can be NULL
+ * @return match start, -1 if nothing matches
+ */
+int64_t aho_corasick_find_first(const aho_corasick_t* ac, const uint8_t* data, uint64_t data_len, uint64_t* pattern_id);
+
+/**
+ * @brief destroys automaton
+ * @param[in] ac automaton
+ * @return 0 on success
+ */
+int8_t aho_corasick_destroy(aho_corasick_t* ac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
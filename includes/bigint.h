@@ -15,6 +15,12 @@ extern "C" {
 #endif
 
 typedef struct bigint_t bigint_t;
+typedef struct bigint_montgomery_t bigint_montgomery_t;
+
+typedef enum bigint_montgomery_pow_mode_t {
+    BIGINT_MONTGOMERY_POW_MODE_SLIDING_WINDOW, ///< variable time, for public exponents
+    BIGINT_MONTGOMERY_POW_MODE_FIXED_WINDOW, ///< constant time window walk and table scan, for secret exponents
+} bigint_montgomery_pow_mode_t;
 
 
 bigint_t* bigint_create(void);
@@ -58,6 +64,12 @@ int8_t bigint_isqrt(bigint_t* result, const bigint_t* a, const bigint_t* b);
 int8_t bigint_mul_mod(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c);
 int8_t bigint_pow_mod(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c);
 
+bigint_montgomery_t* bigint_montgomery_create(const bigint_t* modulus);
+void                 bigint_montgomery_destroy(bigint_montgomery_t* ctx);
+
+int8_t bigint_montgomery_mul_mod(bigint_montgomery_t* ctx, bigint_t* result, const bigint_t* a, const bigint_t* b);
+int8_t bigint_montgomery_pow(bigint_montgomery_t* ctx, bigint_t* result, const bigint_t* base, const bigint_t* exponent, bigint_montgomery_pow_mode_t mode);
+
 int8_t bigint_and(bigint_t* result, const bigint_t* a, const bigint_t* b);
 int8_t bigint_or(bigint_t* result, const bigint_t* a, const bigint_t* b);
 int8_t bigint_xor(bigint_t* result, const bigint_t* a, const bigint_t* b);
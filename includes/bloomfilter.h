@@ -54,6 +54,7 @@ boolean_t bloomfilter_add(bloomfilter_t* bf, data_t* data);
 
 /**
  * @brief serialize given bloom filter
+ * @details first field of serialized data is the filter layout version, legacy filters are not serialized.
  * @param[in] bf bloom filter to serialize
  * @return serialized data
  */
@@ -61,6 +62,7 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf);
 
 /**
  * @brief deserialize given bloom filter
+ * @details both split block and legacy double hashing layouts are accepted.
  * @param[in] data data that holds serialized bloom filter
  * @return bloom filter
  */
@@ -92,6 +92,38 @@ typedef int8_t (*bplustree_key_cloner_f)(memory_heap_t* heap, const void* key, v
  */
 int8_t bplustree_set_key_cloner(index_t* idx, bplustree_key_cloner_f cloner);
 
+/**
+ * @brief order preserving key prefix function
+ * @details if prefix(a) < prefix(b) then a < b must hold. equal prefixes fall back to comparator.
+ * typically first 8 bytes of the key as big endian integer.
+ */
+typedef uint64_t (*bplustree_key_prefix_f)(const void* key);
+
+/**
+ * @brief sets key prefix function for index
+ * @param[in]  idx        index
+ * @param[in]  key_prefix prefix function
+ * @return     0 if successed, -1 if tree is not empty.
+ *
+ * nodes keep prefixes inline beside key pointers, so node searches touch keys only on prefix ties.
+ */
+int8_t bplustree_set_key_prefix(index_t* idx, bplustree_key_prefix_f key_prefix);
+
+/**
+ * @brief builds tree bottom up from sorted keys
+ * @param[in]  idx   empty index
+ * @param[in]  keys  keys at ascending order, strictly ascending for unique index
+ * @param[in]  datas datas of keys
+ * @param[in]  count key count
+ * @return     0 if successed, -1 if tree is not empty, keys are not sorted or allocation failed.
+ *
+ * keys are spread evenly over the fewest leafs that can hold them, ceil(count / max key count), and childs are
+ * spread over parents the same way. sizes of nodes at a level differ by at most one, so every non root node holds
+ * at least half of max key count and building costs O(n) without any split or rebalance.
+ * equal keys of non unique index are collected at the same bucket.
+ */
+int8_t bplustree_bulk_load(index_t* idx, const void* const* keys, const void* const* datas, uint64_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,50 @@
+/**
+ * @file byte_search.h
+ * @brief vectorized byte and substring search interface
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+#ifndef ___BYTE_SEARCH_H
+/*! prevent duplicate header error macro */
+#define ___BYTE_SEARCH_H 0
+
+#include <types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief finds first occurrence of a byte, memchr like
+ * @param[in] data data to search
+ * @param[in] data_len data length
+ * @param[in] value byte to find
+ * @return index of byte, -1 if not found
+ */
+int64_t byte_search_first(const uint8_t* data, const int64_t data_len, uint8_t value);
+
+/**
+ * @brief finds last occurrence of a byte, memrchr like
+ * @param[in] data data to search
+ * @param[in] data_len data length
+ * @param[in] value byte to find
+ * @return index of byte, -1 if not found
+ */
+int64_t byte_search_last(const uint8_t* data, const int64_t data_len, uint8_t value);
+
+/**
+ * @brief finds first occurrence of pattern, candidates are filtered by pattern's first and last bytes a vector at a time
+ * @param[in] data data to search
+ * @param[in] data_len data length
+ * @param[in] pattern pattern to find
+ * @param[in] pattern_len pattern length
+ * @return index of pattern, -1 if not found, 0 for empty pattern
+ */
+int64_t byte_search(const uint8_t* data, const int64_t data_len, const uint8_t* pattern, const int64_t pattern_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -58,6 +58,19 @@ typedef struct asm_instruction_param_t {
     char_t*                      label;
 } asm_instruction_param_t;
 
+/**
+ * @struct asm_instruction_ir_t
+ * @brief in memory instruction, made by parsing source tokens or directly by a code generator
+ *
+ * labels of parameters are heap strings, encoding moves them to section relocations.
+ */
+typedef struct asm_instruction_ir_t {
+    const char_t*           mnemonic; ///< mnemonic without operand size suffix (add, sub, ...)
+    uint8_t                 operand_size; ///< operand size in bits as suffix gives, 0 to infer from operands
+    uint8_t                 param_count; ///< parameter count
+    asm_instruction_param_t params[4]; ///< parameters in at&t order, source first
+} asm_instruction_ir_t;
+
 typedef struct asm_symbol_t {
     char_t*               name;
     linker_symbol_type_t  type;
@@ -87,6 +100,7 @@ typedef struct asm_encoder_ctx_t {
     hashmap_t*     sections;
     asm_section_t* current_section;
     asm_symbol_t*  current_symbol;
+    buffer_t*      listing;
 } asm_encoder_ctx_t;
 
 boolean_t asm_encode_instructions(asm_encoder_ctx_t* ctx);
@@ -95,6 +109,20 @@ void      asm_encoder_destroy_relocs(list_t* relocs);
 int8_t    asm_encoder_destroy_context(asm_encoder_ctx_t* ctx);
 int8_t    asm_encoder_dump(asm_encoder_ctx_t* ctx, buffer_t* outbuf);
 
+/*
+ * direct emission: code generators switch sections, define labels and encode instructions without
+ * printing and parsing source text. if ctx->listing is set, instructions are also printed to it.
+ */
+asm_section_t* asm_encoder_switch_section(asm_encoder_ctx_t* ctx, const char_t* name);
+boolean_t      asm_encoder_define_label(asm_encoder_ctx_t* ctx, const char_t* name);
+boolean_t      asm_instruction_ir_set_register(asm_instruction_param_t* param, const char_t* reg_name);
+boolean_t      asm_instruction_ir_set_immediate(asm_instruction_param_t* param, uint64_t immediate, const char_t* label);
+boolean_t      asm_instruction_ir_set_memory(asm_instruction_param_t* param, const char_t* base_reg, const char_t* index_reg,
+                                             uint8_t scale, int64_t displacement, const char_t* label);
+int8_t         asm_instruction_ir_print(const asm_instruction_ir_t* ir, buffer_t* outbuf);
+boolean_t      asm_encode_ir_instruction(const asm_instruction_ir_t* ir, buffer_t* outbuf, list_t* relocs);
+boolean_t      asm_encode_ir(asm_encoder_ctx_t* ctx, const asm_instruction_ir_t* ir);
+
 #ifdef __cplusplus
 }
 #endif
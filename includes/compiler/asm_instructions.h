@@ -326,6 +326,7 @@ typedef enum asm_instruction_mnemonic_t {
 
     ASM_INSTRUCTION_MNEMONIC_XOR,
 
+    ASM_INSTRUCTION_MNEMONIC_COUNT, ///< number of mnemonics, not an instruction
 } asm_instruction_mnemonic_t;
 
 typedef struct asm_instruction_mnemonic_map_t {
@@ -393,7 +394,7 @@ typedef struct asm_instruction_t {
     asm_operand_encode_t       operand_encode;
 } asm_instruction_t;
 
-asm_instruction_mnemonic_t            asm_instruction_mnemonic_get_by_param(asm_instruction_param_t* param, uint8_t operand_size, uint8_t mem_operand_size);
+asm_instruction_mnemonic_t            asm_instruction_mnemonic_get_by_param(const asm_instruction_param_t* param, uint8_t operand_size, uint8_t mem_operand_size);
 const asm_instruction_mnemonic_map_t* asm_instruction_mnemonic_get(const char_t* mnemonic_string);
 const asm_instruction_t*              asm_instruction_get(const asm_instruction_mnemonic_map_t* map, uint8_t instruction_length, asm_instruction_mnemonic_t mnemonics[5]);
 uint8_t                               asm_instruction_get_imm_size(const asm_instruction_t* instr);
@@ -97,6 +97,7 @@ typedef struct compiler_token_t {
     uint64_t              size;
     boolean_t             is_unsigned;
     boolean_t             is_array;
+    int64_t               identifier_id;
 } compiler_token_t;
 
 typedef enum compiler_ast_node_type_t {
@@ -149,6 +150,7 @@ typedef struct compiler_symbol_t {
     boolean_t              is_local;
     boolean_t              is_array;
     uint64_t               array_size;
+    int64_t                identifier_id;
 } compiler_symbol_t;
 
 typedef struct compiler_type_field_t compiler_type_field_t;
@@ -198,18 +200,29 @@ struct compiler_ast_node_t {
     boolean_t                is_at_reg;
 };
 
+typedef struct compiler_identifier_pool_t {
+    hashmap_t* ids; ///< identifier name to id
+    char_t**   names; ///< identifier names by id, id 0 is not used
+    int64_t    count; ///< next id
+    int64_t    capacity; ///< capacity of names
+} compiler_identifier_pool_t;
+
 typedef struct compiler_ast_t {
-    compiler_ast_node_t * root;
+    compiler_ast_node_t *        root;
+    compiler_identifier_pool_t * identifiers; ///< identifiers interned by lexer
 } compiler_ast_t;
 
 #define COMPILER_VM_REG_COUNT 13
 
-typedef struct compiler_symbol_table_t compiler_symbol_table_t;
+typedef struct compiler_scopes_t compiler_scopes_t;
 
-struct compiler_symbol_table_t {
-    compiler_symbol_table_t* parent;
-    hashmap_t*               symbols;
-};
+typedef struct compiler_regalloc_t compiler_regalloc_t;
+
+typedef enum compiler_optimization_level_t {
+    COMPILER_OPTIMIZATION_LEVEL_NONE = 0, ///< code as written, variables at memory
+    COMPILER_OPTIMIZATION_LEVEL_BASIC, ///< constant folding, dead code elimination, register allocation
+    COMPILER_OPTIMIZATION_LEVEL_FULL, ///< also strength reduction and peephole
+} compiler_optimization_level_t;
 
 typedef struct compiler_t {
     compiler_ast_t *         ast;
@@ -221,8 +234,8 @@ typedef struct compiler_t {
     buffer_t*                bss_buffer;
     hashmap_t*               types_by_name;
     hashmap_t*               types_by_id;
-    compiler_symbol_table_t* main_symbol_table;
-    compiler_symbol_table_t* current_symbol_table;
+    compiler_identifier_pool_t* identifiers; ///< identifiers of ast
+    compiler_scopes_t*       scopes; ///< visible symbols by identifier id
     hashmap_t*               external_symbols;
     uint16_t                 stack_size;
     uint16_t                 next_stack_offset;
@@ -233,6 +246,8 @@ typedef struct compiler_t {
     list_t*                  loop_label_stack;
     int64_t                  loop_depth;
     boolean_t                is_cond_eval;
+    compiler_optimization_level_t optimization_level; ///< enabled optimizations
+    compiler_regalloc_t*     regalloc; ///< register allocation of program body
 } compiler_t;
 
 
@@ -246,6 +261,12 @@ int8_t compiler_ast_node_destroyer(memory_heap_t* heap, void* node);
 int8_t compiler_ast_init(compiler_ast_t * ast);
 int8_t compiler_ast_destroy(compiler_ast_t * ast);
 
+compiler_identifier_pool_t* compiler_identifier_pool_create(void);
+int8_t                      compiler_identifier_pool_destroy(compiler_identifier_pool_t* pool);
+int64_t                     compiler_identifier_pool_intern(compiler_identifier_pool_t* pool, const char_t* name);
+int64_t                     compiler_identifier_pool_find(const compiler_identifier_pool_t* pool, const char_t* name);
+const char_t*               compiler_identifier_pool_get_name(const compiler_identifier_pool_t* pool, int64_t id);
+
 
 typedef enum compiler_reg_ids_t {
     COMPILER_VM_REG_RAX = 0,
@@ -283,11 +304,18 @@ int8_t                   compiler_execute_relational_op(compiler_t* compiler, co
 int8_t                   compiler_execute_block(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result);
 int8_t                   compiler_execute_compound(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result);
 int8_t                   compiler_execute(compiler_t * compiler, int64_t* result);
+int8_t                   compiler_init_symbol_table(compiler_t * compiler);
 int8_t                   compiler_print_symbol_table(compiler_t * compiler);
 int8_t                   compiler_destroy_symbol_table(compiler_t * compiler);
+int8_t                   compiler_enter_scope(compiler_t* compiler);
+int8_t                   compiler_leave_scope(compiler_t* compiler);
+int8_t                   compiler_bind_symbol(compiler_t* compiler, compiler_symbol_t* symbol, boolean_t at_main_scope);
+const compiler_symbol_t* compiler_find_symbol_at_current_scope(compiler_t* compiler, compiler_symbol_t* symbol);
 int8_t                   compiler_build_stack(compiler_t* compiler);
 int8_t                   compiler_find_free_reg(compiler_t* compiler);
 const compiler_symbol_t* compiler_find_symbol(compiler_t* compiler, const char_t* name);
+const compiler_symbol_t* compiler_find_symbol_by_id(compiler_t* compiler, int64_t identifier_id);
+const compiler_symbol_t* compiler_find_symbol_by_token(compiler_t* compiler, const compiler_token_t* token);
 int8_t                   compiler_execute_function_call(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result);
 int8_t                   compiler_execute_string_const(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result);
 int8_t                   compiler_execute_if(compiler_t* compiler, compiler_ast_node_t* node, int64_t* result);
@@ -302,6 +330,13 @@ char_t                   compiler_get_reg_suffix(uint8_t size);
 int8_t                   compiler_define_symbol(compiler_t* compiler, compiler_symbol_t* symbol, size_t symbol_size);
 int8_t                   compiler_destroy_external_symbols(compiler_t* compiler);
 int8_t                   compiler_add_external_symbol(compiler_t* compiler, const char_t* name, compiler_symbol_type_t type, int64_t size, boolean_t is_const);
+int8_t                   compiler_regalloc_build(compiler_t* compiler, compiler_ast_node_t* body);
+int8_t                   compiler_regalloc_destroy(compiler_t* compiler);
+int8_t                   compiler_regalloc_begin_statement(compiler_t* compiler, compiler_ast_node_t* body, int64_t statement);
+int8_t                   compiler_regalloc_end_statement(compiler_t* compiler, compiler_ast_node_t* body, int64_t statement);
+int16_t                  compiler_regalloc_get_register(compiler_t* compiler, const compiler_symbol_t* symbol);
+int8_t                   compiler_optimize_ast(compiler_t* compiler);
+buffer_t*                compiler_peephole(compiler_t* compiler, buffer_t* text);
 
 
 #define SYS_exit 60ULL
@@ -20,8 +20,9 @@ extern "C" {
 #endif
 
 typedef struct pascal_lexer_t {
-    buffer_t * buffer;
-    char_t     current_char;
+    buffer_t *                   buffer;
+    char_t                       current_char;
+    compiler_identifier_pool_t * identifiers;
 } pascal_lexer_t;
 
 
@@ -169,9 +169,10 @@ typedef struct task_t {
     void*                        vm; ///< vm
     int32_t                      exit_code; ///< task exit code
     task_registers_t*            registers; ///< task registers
+    volatile boolean_t           future_wake_pending; ///< a future waker fired since last wait, scheduler resumes future waiting task
 } task_t; ///< short hand for struct
 
-_Static_assert(sizeof(task_t) == 0xc0, "task_t size must be 0xb8"); // why this assert? where we hardcoded task_t size?
+_Static_assert(sizeof(task_t) == 0xc8, "task_t size must be 0xc8"); // why this assert? where we hardcoded task_t size?
 
 /**
  * @brief inits kernel tasking, configures tss and kernel task
@@ -326,7 +327,23 @@ void task_remove_task_after_fault(uint64_t task_id);
 
 int8_t task_set_current_and_idle_task(void* entry_point, uint64_t stack_base, uint64_t stack_size);
 
-void task_toggle_wait_for_future(uint64_t task_id);
+/**
+ * @brief marks current task as waiting for a future, task is not scheduled until woken or timed out
+ * @details a wake which fires before this call or before task yields is not lost, it stays pending at task and
+ * scheduler resumes task at once. so caller can be preempted between marking and checking its condition.
+ * @param[in] timeout_ms timeout in milliseconds, 0 for no timeout
+ */
+void task_set_future_waiting(uint64_t timeout_ms);
+
+/*! marks current task as running after it saw future completion by itself */
+void task_clear_future_waiting(void);
+
+/**
+ * @brief makes a task waiting for a future schedulable again, safe at interrupt context
+ * @details wake is recorded as pending even if task is not waiting yet, its next wait returns at once.
+ * @param[in] task_id task id
+ */
+void task_wake_future_waiter(uint64_t task_id);
 
 uint64_t task_get_task_xsave_mask(void);
 uint32_t task_get_task_mxcsr_mask(void);
@@ -43,13 +43,193 @@ typedef struct data_t {
     void*          value;
 }data_t;
 
+/**
+ * @brief maximum nesting of json objects and arrays, deeper documents are rejected
+ * @details parser recurses once per level with about 200 bytes of stack, 64 levels take 12 KB and fit the
+ * smallest task stack of 16 KB.
+ */
+#define DATA_JSON_MAX_DEPTH 64
+
 data_t* data_bson_serialize(data_t* data);
 data_t* data_bson_deserialize(data_t* data);
 data_t* data_json_serialize(data_t* data);
 data_t* data_json_deserialize(data_t* data);
 
+/**
+ * @brief deserializes json without copying strings
+ * @details input is modified: strings are unescaped in place and terminated with null over their closing quotes.
+ * names and string values of the result point into input, so input must outlive the result which is freed
+ * with data_free_ext(result, false).
+ * @param[in] data json as DATA_TYPE_INT8_ARRAY
+ * @return deserialized data, NULL on error
+ */
+data_t* data_json_deserialize_in_situ(data_t* data);
+
+/*! incremental json parser for concatenated documents */
+typedef struct data_json_stream_t data_json_stream_t;
+
+/**
+ * @brief creates incremental json parser
+ * @details input is a sequence of json objects or arrays, separated with optional whitespace such as ndjson.
+ * @return parser
+ */
+data_json_stream_t* data_json_stream_new(void);
+
+/**
+ * @brief appends input chunk to the parser
+ * @param[in] stream parser
+ * @param[in] chunk input bytes, copied
+ * @param[in] length chunk length
+ * @return 0 on success
+ */
+int8_t data_json_stream_feed(data_json_stream_t* stream, const uint8_t* chunk, uint64_t length);
+
+/**
+ * @brief returns next complete document
+ * @param[in] stream parser
+ * @return document or NULL if no complete document is available yet or input is malformed
+ */
+data_t* data_json_stream_next(data_json_stream_t* stream);
+
+/**
+ * @brief checks if parser met malformed input
+ * @param[in] stream parser
+ * @return true if input is malformed
+ */
+boolean_t data_json_stream_has_error(data_json_stream_t* stream);
+
+/**
+ * @brief destroys incremental json parser
+ * @param[in] stream parser
+ * @return 0 on success
+ */
+int8_t data_json_stream_destroy(data_json_stream_t* stream);
+
+/**
+ * @struct data_bson_view_t
+ * @brief read only view of a serialized bson node, fields are read from serialized bytes on demand
+ */
+typedef struct data_bson_view_t {
+    const uint8_t* node; ///< node start
+    uint64_t       node_size; ///< node size with header
+    data_type_t    type; ///< node type
+    uint64_t       length; ///< element count for strings, data lists and arrays, byte width for scalars
+    const uint8_t* name; ///< name node, NULL if node has no name
+    const uint8_t* value; ///< value bytes, not aligned and strings are not null terminated
+    uint64_t       value_size; ///< value byte count
+} data_bson_view_t; ///< short hand for struct
+
+/**
+ * @brief creates view of serialized bson root node without deserializing it
+ * @param[out] view view, serialized data must outlive it
+ * @param[in] bson output of data_bson_serialize
+ * @return 0 on success
+ */
+int8_t data_bson_view_init(data_bson_view_t* view, const data_t* bson);
+
+/**
+ * @brief returns view of node's name
+ * @param[in] view view
+ * @param[out] name name view
+ * @return 0 on success, -1 if node has no name
+ */
+int8_t data_bson_view_get_name(const data_bson_view_t* view, data_bson_view_t* name);
+
+/**
+ * @brief returns first item of a data list
+ * @param[in] parent data list view
+ * @param[out] child item view
+ * @return 0 on success, -1 if list is empty or malformed
+ */
+int8_t data_bson_view_first_child(const data_bson_view_t* parent, data_bson_view_t* child);
+
+/**
+ * @brief advances child view to next item of the data list
+ * @param[in] parent data list view
+ * @param[in,out] child item view
+ * @return 0 on success, -1 at end of list
+ */
+int8_t data_bson_view_next_child(const data_bson_view_t* parent, data_bson_view_t* child);
+
+/**
+ * @brief returns item of a data list at index, items are skipped with their sizes
+ * @param[in] parent data list view
+ * @param[in] index item index
+ * @param[out] child item view
+ * @return 0 on success
+ */
+int8_t data_bson_view_get_child(const data_bson_view_t* parent, uint64_t index, data_bson_view_t* child);
+
+/**
+ * @brief finds data list item with string name
+ * @param[in] parent data list view
+ * @param[in] name item name
+ * @param[out] child item view
+ * @return 0 if found
+ */
+int8_t data_bson_view_find(const data_bson_view_t* parent, const char_t* name, data_bson_view_t* child);
+
+/**
+ * @brief finds data list item with integer name such as tosdb column ids
+ * @param[in] parent data list view
+ * @param[in] id item name
+ * @param[out] child item view
+ * @return 0 if found
+ */
+int8_t data_bson_view_find_by_id(const data_bson_view_t* parent, uint64_t id, data_bson_view_t* child);
+
+/**
+ * @brief finds nested item with dot separated string names such as "a.b.c"
+ * @param[in] root data list view
+ * @param[in] path names
+ * @param[out] out item view
+ * @return 0 if found
+ */
+int8_t data_bson_view_get_path(const data_bson_view_t* root, const char_t* path, data_bson_view_t* out);
+
+/**
+ * @brief reads boolean, char and integer values, zero extended as data_bson_deserialize does
+ * @param[in] view view
+ * @param[out] out value
+ * @return 0 on success, -1 if type does not match
+ */
+int8_t data_bson_view_get_integer(const data_bson_view_t* view, uint64_t* out);
+
+/**
+ * @brief reads float values
+ * @param[in] view view
+ * @param[out] out value
+ * @return 0 on success, -1 if type does not match
+ */
+int8_t data_bson_view_get_float(const data_bson_view_t* view, float64_t* out);
+
+/**
+ * @brief returns string bytes inside serialized data
+ * @param[in] view view
+ * @param[out] str string, not null terminated
+ * @param[out] length string length, can be NULL
+ * @return 0 on success, -1 if type does not match
+ */
+int8_t data_bson_view_get_string(const data_bson_view_t* view, const char_t** str, uint64_t* length);
+
+/**
+ * @brief returns array items inside serialized data
+ * @param[in] view view
+ * @param[out] items items, not aligned
+ * @param[out] count item count, can be NULL
+ * @return 0 on success, -1 if type does not match
+ */
+int8_t data_bson_view_get_array(const data_bson_view_t* view, const void** items, uint64_t* count);
+
 void data_free(data_t* data);
 
+/**
+ * @brief frees data recursively
+ * @param[in] data data to free
+ * @param[in] free_strings if false string values and names are treated as borrowed and not freed
+ */
+void data_free_ext(data_t* data, boolean_t free_strings);
+
 #ifdef __cplusplus
 }
 #endif
@@ -684,7 +684,7 @@ typedef struct ahci_sata_disk_s {
     lock_t*            disk_lock;
     uint32_t           acquired_slots;
     uint32_t           current_commands;
-    lock_t*            future_locks[32];
+    future_t*          futures[32];
     boolean_t          inserted;
     uint64_t           physical_sector_size;
     uint64_t           logical_sector_size;
@@ -13,6 +13,10 @@
 #include <pci.h>
 #include <network/network_protocols.h>
 #include <network/network_ethernet.h>
+#include <network/network_packet.h>
+#include <network/network_rss.h>
+#include <network/network_tx_queue.h>
+#include <list.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +42,7 @@ extern "C" {
 #define NETWORK_IGB_REG_RCTL      0x0100
 #define NETWORK_IGB_REG_TCTL      0x0400
 
+#define NETWORK_IGB_REG_EITR      0x1680
 #define NETWORK_IGB_REG_GPIE      0x1514
 #define NETWORK_IGB_REG_EIMS      0x1524
 #define NETWORK_IGB_REG_EIMC      0x1528
@@ -61,6 +66,14 @@ extern "C" {
 #define NETWORK_IGB_REG_TDT       0xE018
 #define NETWORK_IGB_REG_TXDCTL    0xE028
 
+/*! queue n register of queue 0 register */
+#define NETWORK_IGB_REG_QUEUE(reg, n) ((reg) + (n) * 0x40)
+
+#define NETWORK_IGB_REG_RXCSUM    0x5000
+#define NETWORK_IGB_REG_MRQC      0x5818
+#define NETWORK_IGB_REG_RETA      0x5C00
+#define NETWORK_IGB_REG_RSSRK     0x5C80
+
 #define NETWORK_IGB_REG_MTA       0x5200
 
 #define NETWORK_IGB_REG_RAL       0x5400
@@ -77,12 +90,29 @@ extern "C" {
 #define NETWORK_IGB_PHYREG_PSTATUS   1
 #define NETWORK_IGB_PHYREG_PSSTAT   17
 
+/*! rx descriptors of all queues, queues split them equally */
 #define NETWORK_IGB_NUM_RX_DESCRIPTORS  1024
 #define NETWORK_IGB_NUM_TX_DESCRIPTORS  1024
 
+/*! rx queues, each queue has its msix vector and task. count is rounded down to a power of two */
+#define NETWORK_IGB_MAX_RX_QUEUES 4
+/*! descriptors cleaned by one poll, tail is written once per poll */
+#define NETWORK_IGB_RX_BUDGET     64
+
 #define NETWORK_IGB_RX_BUFFER_SIZE (10 * 1024)
 #define NETWORK_IGB_RX_HEADER_SIZE 256
 
+#define NETWORK_IGB_RX_POOL_SIZE NETWORK_IGB_NUM_RX_DESCRIPTORS
+
+/*! descriptors filled by one pass of tx task, tail is written once per pass */
+#define NETWORK_IGB_TX_BUDGET      64
+/*! tx buffer of each descriptor, packets are copied into it */
+#define NETWORK_IGB_TX_BUFFER_SIZE (8192 + 16)
+/*! slots of tx queue which protocol tasks push into */
+#define NETWORK_IGB_TX_QUEUE_SIZE  NETWORK_IGB_NUM_TX_DESCRIPTORS
+/*! tx task sleep while descriptors are full, completions are reaped after it */
+#define NETWORK_IGB_TX_REAP_WAIT_MS 1
+
 #define NETWORK_IGB_CTRL_FD       (1 << 0)
 #define NETWORK_IGB_CTRL_ASDE     (1 << 5)
 #define NETWORK_IGB_CTRL_SLU      (1 << 6)
@@ -113,6 +143,40 @@ extern "C" {
 #define NETWORK_IGB_TCTL_PSP      (1 << 3)
 #define NETWORK_IGB_TXDCTL_ENABLE (1 << 25)
 
+#define NETWORK_IGB_RXCSUM_IPOFLD (1 << 8)
+#define NETWORK_IGB_RXCSUM_TUOFLD (1 << 9)
+#define NETWORK_IGB_RXCSUM_PCSD   (1 << 13)
+
+#define NETWORK_IGB_MRQC_ENABLE_RSS         0x2
+#define NETWORK_IGB_MRQC_RSS_FIELD_IPV4_TCP (1 << 16)
+#define NETWORK_IGB_MRQC_RSS_FIELD_IPV4     (1 << 17)
+#define NETWORK_IGB_MRQC_RSS_FIELD_IPV4_UDP (1 << 22)
+
+#define NETWORK_IGB_IVAR_VALID    0x80
+#define NETWORK_IGB_EITR_INTERVAL_MASK 0x7FFC
+
+/*! interrupt throttle intervals of adaptive moderation in microseconds */
+#define NETWORK_IGB_ITR_LOWEST_LATENCY 10
+#define NETWORK_IGB_ITR_LOW_LATENCY    50
+#define NETWORK_IGB_ITR_BULK           250
+/*! light polls before a queue leaves poll mode */
+#define NETWORK_IGB_POLL_EXIT_POLLS    4
+
+#define NETWORK_IGB_RXD_STATUS_DD    (1 << 0)
+#define NETWORK_IGB_RXD_STATUS_UDPCS (1 << 4)
+#define NETWORK_IGB_RXD_STATUS_L4I   (1 << 5)
+#define NETWORK_IGB_RXD_STATUS_IPCS  (1 << 6)
+
+#define NETWORK_IGB_TXD_CMD_EOP   (1 << 0)
+#define NETWORK_IGB_TXD_CMD_IFCS  (1 << 1)
+#define NETWORK_IGB_TXD_CMD_IC    (1 << 2)
+#define NETWORK_IGB_TXD_CMD_RS    (1 << 3)
+
+#define NETWORK_IGB_TXD_STATUS_DD (1 << 0)
+
+/*! tcp and udp checksum insertion with legacy descriptors, emulated igb only inserts with advanced ones */
+#define NETWORK_IGB_TX_CHECKSUM_OFFLOAD 0
+
 typedef union network_igb_rx_desc_t {
     struct {
         uint64_t pkt_addr; /* Packet buffer address */
@@ -152,37 +216,139 @@ typedef struct network_igb_tx_desc_t {
     volatile uint16_t vlan;
 } __attribute__((packed)) network_igb_tx_desc_t;
 
-typedef struct {
+/*! adaptive interrupt moderation state of a queue */
+typedef struct network_igb_moderation_t {
+    boolean_t polling; ///< queue interrupt is masked, task polls ring
+    uint32_t  light_polls; ///< consecutive polls below a quarter of budget at poll mode
+    uint32_t  itr; ///< interrupt throttle interval in microseconds
+} network_igb_moderation_t;
+
+#define NETWORK_IGB_MODERATION_MASK   0x1 ///< mask queue interrupt and poll
+#define NETWORK_IGB_MODERATION_UNMASK 0x2 ///< unmask queue interrupt and wait
+#define NETWORK_IGB_MODERATION_ITR    0x4 ///< write new throttle interval
+
+/*! rx descriptor ring, logic is hardware independent so host tests drive it with a simulated ring */
+typedef struct network_igb_rx_ring_t {
+    volatile network_igb_rx_desc_t* desc; ///< descriptors
+    uint64_t                        packet_buffer_fa; ///< dma address of packet buffers
+    uint64_t                        packet_buffer_va; ///< packet buffers
+    uint64_t                        header_buffer_fa; ///< dma address of header buffers
+    uint32_t                        buffer_size; ///< packet buffer size of a descriptor
+    uint32_t                        count; ///< descriptor count, power of two
+    uint32_t                        next; ///< next descriptor to clean, descriptor before it is held back from nic
+    network_packet_pool_t*          pool; ///< pool of received packets
+    void*                           network_info; ///< mac address of nic
+    network_tx_queue_t*             return_queue; ///< tx queue of nic
+    uint64_t                        packets; ///< delivered frames
+    uint64_t                        dropped; ///< frames dropped for short length or empty pool
+    uint64_t                        errors; ///< frames dropped for nic errors
+    uint64_t                        polls; ///< polls which cleaned descriptors, each writes tail once
+} network_igb_rx_ring_t;
+
+/*! tx descriptor ring, logic is hardware independent so host tests drive it with a simulated ring */
+typedef struct network_igb_tx_ring_t {
+    volatile network_igb_tx_desc_t* desc; ///< descriptors
+    uint64_t                        buffer_va; ///< packet buffers
+    uint32_t                        buffer_size; ///< packet buffer size of a descriptor
+    uint32_t                        count; ///< descriptor count, power of two
+    uint32_t                        tail; ///< next descriptor to fill, TDT value
+    uint32_t                        clean; ///< oldest descriptor not reaped
+    uint64_t                        packets; ///< frames given to nic
+    uint64_t                        dropped; ///< frames longer than buffers
+    uint64_t                        batches; ///< fills which gave descriptors, each writes tail once
+    uint64_t                        reaped; ///< completed descriptors
+} network_igb_tx_ring_t;
+
+struct network_igb_dev_t;
+
+typedef struct network_igb_queue_t {
+    struct network_igb_dev_t* dev;
+    network_igb_rx_ring_t     rx;
+    network_igb_moderation_t  moderation;
+    uint16_t                  index;
+    uint16_t                  msix_vector;
+    uint8_t                   isr;
+    uint64_t                  task_id;
+} network_igb_queue_t;
+
+typedef struct network_igb_dev_t {
     const pci_dev_t*       pci_netdev;
     pci_capability_msix_t* msix_cap;
     network_mac_address_t  mac;
-    list_t*                return_queue;
-    uint8_t                rx_isr;
+    network_tx_queue_t*    return_queue;
+    network_packet_pool_t* rx_pool;
     uint8_t                tx_isr;
     uint8_t                other_isr;
 
-    uint64_t rx_task_id;
+    uint64_t mmio_va;
 
-    uint64_t rx_count;
-    uint64_t tx_count;
-    uint64_t packets_dropped;
+    uint32_t            rx_queue_count;
+    network_igb_queue_t rx_queues[NETWORK_IGB_MAX_RX_QUEUES];
+    uint8_t             reta[NETWORK_RSS_RETA_SIZE];
 
-    uint64_t mmio_va;
+    network_igb_tx_ring_t tx;
+}network_igb_dev_t;
+
+/*! msix vector of tx, rx queues take vectors before it */
+#define NETWORK_IGB_TX_VECTOR(dev)    ((dev)->rx_queue_count)
+/*! msix vector of link and other causes */
+#define NETWORK_IGB_OTHER_VECTOR(dev) ((dev)->rx_queue_count + 1)
 
-    uint64_t rx_packet_buffer_fa;
-    uint64_t rx_packet_buffer_va;
-    uint64_t rx_header_buffer_fa;
-    uint64_t rx_header_buffer_va;
+int8_t network_igb_init(const pci_dev_t* pci_netdev);
 
+/**
+ * @brief cleans completed descriptors of a ring and gives them back
+ * @details frames are copied into pool packets, descriptors are refilled. caller writes
+ * network_igb_rx_ring_tail to RDT once after poll.
+ * @param[in] ring rx ring
+ * @param[in] budget maximum descriptors to clean
+ * @param[out] packets received packets chained in order
+ * @return cleaned descriptor count
+ */
+uint32_t network_igb_rx_ring_poll(network_igb_rx_ring_t* ring, uint32_t budget, network_packet_t** packets);
 
-    volatile network_igb_rx_desc_t* rx_desc; // receive descriptor buffer
-    volatile int32_t                rx_tail;
+/**
+ * @brief tail value which gives cleaned descriptors to nic
+ * @param[in] ring rx ring
+ * @return RDT value
+ */
+uint32_t network_igb_rx_ring_tail(const network_igb_rx_ring_t* ring);
 
-    volatile network_igb_tx_desc_t* tx_desc; // transmit descriptor buffer
-    volatile int32_t                tx_tail;
-}network_igb_dev_t;
+/**
+ * @brief updates adaptive moderation with result of a poll
+ * @details full polls switch queue to poll mode, consecutive light polls switch back to interrupts.
+ * throttle interval follows work of polls at interrupt mode.
+ * @param[in] moderation state of queue
+ * @param[in] cleaned descriptors cleaned by poll
+ * @param[in] budget budget of poll
+ * @return NETWORK_IGB_MODERATION_* actions
+ */
+uint8_t network_igb_moderation_update(network_igb_moderation_t* moderation, uint32_t cleaned, uint32_t budget);
 
-int8_t network_igb_init(const pci_dev_t* pci_netdev);
+/**
+ * @brief reclaims descriptors which nic has sent
+ * @param[in] ring tx ring
+ * @return reclaimed descriptor count
+ */
+uint32_t network_igb_tx_ring_reap(network_igb_tx_ring_t* ring);
+
+/**
+ * @brief descriptors which can be filled, one descriptor is kept empty so full and empty rings differ
+ * @param[in] ring tx ring
+ * @return free descriptor count
+ */
+uint32_t network_igb_tx_ring_free(const network_igb_tx_ring_t* ring);
+
+/**
+ * @brief copies packets into free descriptors
+ * @details filled packets are released, caller writes ring tail to TDT once after fill. packets which do
+ * not fit into free descriptors are left to caller.
+ * @param[in] ring tx ring
+ * @param[in] packets packets to send
+ * @param[in] count packet count
+ * @return consumed packet count, filled and dropped ones
+ */
+uint32_t network_igb_tx_ring_fill(network_igb_tx_ring_t* ring, network_packet_t** packets, uint32_t count);
 
 #ifdef __cplusplus
 }
@@ -546,7 +546,7 @@ typedef struct nvme_disk_t {
     uint16_t                       io_sq_count; ///< io submission queue count
     uint16_t                       io_cq_count; ///< io completion queue count
     uint64_t                       io_queue_isr; ///< io queue isr
-    hashmap_t*                     command_lock_map; ///< command lock map
+    hashmap_t*                     command_future_map; ///< command id to future map
     uint64_t                       prp_frame_fa; ///< prp frame fa
     uint64_t                       prp_frame_va; ///< prp frame va
     uint64_t                       max_prp_entries; ///< max prp entries
@@ -449,7 +449,7 @@ typedef struct usb_ehci_qh_t {
     usb_ehci_qtd_t*   qtd_head;
     usb_ehci_qtd_t*   qtd_tail;
     usb_transfer_t*   transfer;
-    lock_t*           transfer_lock;
+    future_t*         transfer_future;
 } __attribute__((packed)) usb_ehci_qh_t;
 
 _Static_assert((sizeof(usb_ehci_qh_t) % 32) == 0, "usb_ehci_qh_t is not 32 bytes aligned");
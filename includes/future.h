@@ -2,6 +2,10 @@
  * @file future.h
  * @brief Future header.
  *
+ * A future is a one shot completion event. The producer (usually an interrupt handler) signals it once,
+ * the consumer waits for it and takes its data. Waiting tasks are parked at the scheduler and woken by the
+ * signal, they do not spin.
+ *
  * This work is licensed under TURNSTONE OS Public License.
  * Please read and understand latest version of Licence.
  */
@@ -11,18 +15,110 @@
 
 #include <types.h>
 #include <memory.h>
-#include <cpu/sync.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*! timeout value for waiting without a deadline */
+#define FUTURE_WAIT_FOREVER 0
+
 typedef struct future_t future_t;
 
-future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data);
-#define future_create(l) future_create_with_heap_and_data(NULL, l, NULL)
-#define future_create_with_data(l, d) future_create_with_heap_and_data(NULL, l, d)
+/*! returns current task id */
+typedef uint64_t (*future_task_id_getter_f)(void);
+/*! marks current task as waiting until woken or timeout passes, 0 is no timeout */
+typedef void (*future_task_wait_begin_f)(uint64_t timeout_ms);
+/*! clears waiting mark of current task */
+typedef void (*future_task_wait_end_f)(void);
+/*! wakes a waiting task, wake is kept pending if task is not waiting yet so next wait of task does not park */
+typedef void (*future_task_waker_f)(uint64_t task_id);
+/*! yields current task */
+typedef void (*future_task_yielder_f)(void);
+
+/*
+ * task wait hooks, set by tasking initialization. futures and other waiters such as socket poll park tasks with
+ * them, waiters spin when they are missing.
+ */
+extern future_task_id_getter_f future_task_id_getter_func;
+extern future_task_wait_begin_f future_task_wait_begin_func;
+extern future_task_wait_end_f future_task_wait_end_func;
+extern future_task_waker_f future_task_waker_func;
+extern future_task_yielder_f future_task_yielder_func;
+
+/**
+ * @brief continuation called once when future completes
+ * @details it runs at the signaling context, which can be an interrupt handler, so it should be short.
+ * @param[in] data future data
+ * @param[in] arg callback argument
+ */
+typedef void (*future_callback_f)(void* data, void* arg);
+
+/**
+ * @brief creates a future
+ * @param[in] heap heap for future
+ * @param[in] data data returned to consumer
+ * @return future, it is owned by both producer and consumer until both future_signal and future_get_data_and_destroy are called
+ */
+future_t* future_create_with_heap_and_data(memory_heap_t* heap, void* data);
+#define future_create() future_create_with_heap_and_data(NULL, NULL)
+#define future_create_with_data(d) future_create_with_heap_and_data(NULL, d)
+
+/**
+ * @brief completes future, runs its callback and wakes its waiter, safe at interrupt context
+ * @details producer's reference is dropped, future must not be used by producer afterwards.
+ * @param[in] future future
+ * @return 0 on success, -1 if future is already signaled
+ */
+int8_t future_signal(future_t* future);
+
+/**
+ * @brief checks completion without waiting
+ * @param[in] future future
+ * @return true if signaled
+ */
+boolean_t future_is_completed(future_t* future);
+
+/**
+ * @brief sets continuation, runs it immediately if future is already completed
+ * @param[in] future future
+ * @param[in] callback continuation
+ * @param[in] arg continuation argument
+ * @return 0 on success, -1 if a callback is already set
+ */
+int8_t future_set_callback(future_t* future, future_callback_f callback, void* arg);
+
+/**
+ * @brief waits future completion
+ * @param[in] future future
+ * @param[in] timeout_ms timeout in milliseconds or FUTURE_WAIT_FOREVER
+ * @return 0 if completed, -1 on timeout
+ */
+int8_t future_wait(future_t* future, uint64_t timeout_ms);
 
+/**
+ * @brief waits until one of the futures completes
+ * @param[in] futures future set
+ * @param[in] count future count
+ * @param[in] timeout_ms timeout in milliseconds or FUTURE_WAIT_FOREVER
+ * @return index of first completed future, -1 on timeout
+ */
+int64_t future_wait_any(future_t** futures, uint64_t count, uint64_t timeout_ms);
+
+/**
+ * @brief waits until all of the futures complete
+ * @param[in] futures future set
+ * @param[in] count future count
+ * @param[in] timeout_ms timeout in milliseconds or FUTURE_WAIT_FOREVER
+ * @return 0 if all completed, -1 on timeout
+ */
+int8_t future_wait_all(future_t** futures, uint64_t count, uint64_t timeout_ms);
+
+/**
+ * @brief waits future completion, drops consumer's reference and returns data
+ * @param[in] future future
+ * @return future data
+ */
 void* future_get_data_and_destroy(future_t* future);
 
 #ifdef __cplusplus
@@ -194,6 +194,56 @@ list_data_comparator_f list_set_comparator(list_t* list, list_data_comparator_f
  */
 #define list_create_stack() list_create_with_type(memory_get_heap(NULL), LIST_TYPE_STACK, NULL, NULL)
 
+/**
+ * @brief creates a normal array list at heap
+ * @param[in] h @ref memory_heap_t the heap of array list.
+ * @return @ref list_t
+ */
+#define list_create_array_list_with_heap(h) list_create_with_type(memory_get_heap(h), LIST_TYPE_LIST | LIST_TYPE_ARRAY, NULL, NULL)
+/**
+ * @brief creates a normal array list at default heap
+ * @return @ref list_t
+ */
+#define list_create_array_list() list_create_with_type(memory_get_heap(NULL), LIST_TYPE_LIST | LIST_TYPE_ARRAY, NULL, NULL)
+
+/**
+ * @brief creates a sorted array list at heap
+ * @param[in] h @ref memory_heap_t the heap of array list.
+ * @param[in] c @ref list_data_comparator_f comparator used sorting list.
+ * @return @ref list_t
+ */
+#define list_create_array_sortedlist_with_heap(h, c) list_create_with_type(memory_get_heap(h), LIST_TYPE_SORTEDLIST | LIST_TYPE_ARRAY, c, NULL)
+/**
+ * @brief creates a sorted array list at default heap
+ * @param[in] c @ref list_data_comparator_f comparator used sorting list.
+ * @return @ref list_t
+ */
+#define list_create_array_sortedlist(c) list_create_with_type(memory_get_heap(NULL), LIST_TYPE_SORTEDLIST | LIST_TYPE_ARRAY, c, NULL)
+
+/**
+ * @brief creates a ring buffer backed queue at heap
+ * @param[in] h @ref memory_heap_t the heap of queue.
+ * @return @ref list_t
+ */
+#define list_create_array_queue_with_heap(h) list_create_with_type(memory_get_heap(h), LIST_TYPE_QUEUE | LIST_TYPE_ARRAY, NULL, NULL)
+/**
+ * @brief creates a ring buffer backed queue at default heap
+ * @return @ref list_t
+ */
+#define list_create_array_queue() list_create_with_type(memory_get_heap(NULL), LIST_TYPE_QUEUE | LIST_TYPE_ARRAY, NULL, NULL)
+
+/**
+ * @brief creates a array backed stack at heap
+ * @param[in] h @ref memory_heap_t the heap of stack.
+ * @return @ref list_t
+ */
+#define list_create_array_stack_with_heap(h) list_create_with_type(memory_get_heap(h), LIST_TYPE_STACK | LIST_TYPE_ARRAY, NULL, NULL)
+/**
+ * @brief creates a array backed stack at default heap
+ * @return @ref list_t
+ */
+#define list_create_array_stack() list_create_with_type(memory_get_heap(NULL), LIST_TYPE_STACK | LIST_TYPE_ARRAY, NULL, NULL)
+
 typedef int8_t (*list_item_destroyer_callback_f)(memory_heap_t* heap, void* data);
 
 /**
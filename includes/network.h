@@ -27,24 +27,10 @@ typedef enum network_type_t {
     NETWORK_TYPE_ETHERNET=0
 } network_type_t;
 
-typedef struct network_received_packet_t {
-    uint64_t       packet_len;
-    uint8_t*       packet_data;
-    list_t*        return_queue;
-    network_type_t network_type;
-    void*          network_info;
-} network_received_packet_t;
-
-typedef struct network_transmit_packet_t {
-    uint64_t packet_len;
-    uint8_t* packet_data;
-} network_transmit_packet_t;
-
 extern list_t* network_received_packets;
 
-int8_t network_transmit_packet_destroyer(memory_heap_t* heap, void* data);
-
 int8_t network_init(void);
+int8_t network_services_task(void);
 
 #ifdef __cplusplus
 }
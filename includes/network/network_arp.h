@@ -40,7 +40,7 @@ typedef struct network_arp_t {
     network_ipv4_address_t target_ip;
 }__attribute__((packed)) network_arp_t;
 
-uint8_t* network_arp_process_packet(network_arp_t* recv_arp_packet, void* network_info, uint16_t* return_packet_len);
+network_packet_t* network_arp_process_packet(network_packet_t* packet);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,113 @@
+/**
+ * @file network_checksum.h
+ * @brief Internet checksum header.
+ *
+ * Ones complement sums of RFC 1071 shared by ipv4, icmp, udp and tcp. Sums are kept folded to 16 bits and
+ * not complemented, words are summed in memory order so a complemented sum is stored to a header as is.
+ * Data is accumulated 64 bits at a time, AVX2 builds sum large buffers with vectors.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_CHECKSUM_H
+#define ___NETWORK_CHECKSUM_H 0
+
+#include <types.h>
+#include <network/network_protocols.h>
+#include <network/network_packet.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief folds a wide ones complement sum to 16 bits
+ * @param[in] sum wide sum
+ * @return folded sum
+ */
+uint16_t network_checksum_fold(uint64_t sum);
+
+/**
+ * @brief adds bytes to a partial sum
+ * @param[in] data bytes, an odd length is only allowed at end of summed range
+ * @param[in] len byte count
+ * @param[in] sum partial sum of previous bytes, 0 at start
+ * @return partial sum
+ */
+uint16_t network_checksum_partial(const void* data, uint64_t len, uint16_t sum);
+
+/**
+ * @brief copies bytes and adds them to a partial sum in one pass
+ * @param[in] src source
+ * @param[out] dst destination
+ * @param[in] len byte count
+ * @param[in] sum partial sum of previous bytes, 0 at start
+ * @return partial sum
+ */
+uint16_t network_checksum_copy(const void* src, void* dst, uint64_t len, uint16_t sum);
+
+/**
+ * @brief adds partial sum of a block to sum of bytes before it
+ * @param[in] sum partial sum of bytes before block
+ * @param[in] block_sum partial sum of block
+ * @param[in] offset offset of block, odd offsets swap bytes of block sum
+ * @return partial sum
+ */
+uint16_t network_checksum_combine(uint16_t sum, uint16_t block_sum, uint64_t offset);
+
+/**
+ * @brief checksum of a buffer, header checksums are computed or verified with it
+ * @param[in] data bytes, verified headers include their checksum field
+ * @param[in] len byte count
+ * @return complemented sum, 0 when a header with checksum verifies
+ */
+uint16_t network_checksum(const void* data, uint64_t len);
+
+/**
+ * @brief partial sum of ipv4 pseudo header of tcp and udp
+ * @param[in] sip source ip
+ * @param[in] dip destination ip
+ * @param[in] protocol ipv4 protocol
+ * @param[in] len tcp or udp length
+ * @return partial sum
+ */
+uint16_t network_checksum_pseudo_header(network_ipv4_address_t sip, network_ipv4_address_t dip, uint8_t protocol, uint16_t len);
+
+/**
+ * @brief updates checksum after a 16 bit field of header changes, RFC 1624
+ * @param[in] checksum stored checksum
+ * @param[in] old_value old field in memory order
+ * @param[in] new_value new field in memory order
+ * @return new checksum
+ */
+uint16_t network_checksum_update16(uint16_t checksum, uint16_t old_value, uint16_t new_value);
+
+/**
+ * @brief updates checksum after a 32 bit field of header changes, RFC 1624
+ * @param[in] checksum stored checksum
+ * @param[in] old_value old field in memory order
+ * @param[in] new_value new field in memory order
+ * @return new checksum
+ */
+uint16_t network_checksum_update32(uint16_t checksum, uint32_t old_value, uint32_t new_value);
+
+/**
+ * @brief completes l4 checksum of a packet marked for offload in software
+ * @details used when nic cannot take it, for example when packet is fragmented.
+ * @param[in] packet packet with NETWORK_PACKET_CHECKSUM_L4_OFFLOAD, flag is cleared
+ */
+void network_checksum_complete_offload(network_packet_t* packet);
+
+/**
+ * @brief checks nic of a packet can complete l4 checksums
+ * @param[in] network_info mac of nic
+ * @return true if nic offloads tx checksums
+ */
+boolean_t network_checksum_tx_offload_enabled(const void* network_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
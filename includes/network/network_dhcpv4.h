@@ -94,6 +94,7 @@ int32_t           network_dhcpv4_send_discover(uint64_t args_cnt, void** args);
 uint8_t*          network_dhcpv4_process_packet(network_dhcpv4_t* recv_dhcpv4_packet, void* network_info, uint16_t* return_packet_len);
 network_dhcpv4_t* network_dhcpv4_create_discover_packet(network_mac_address_t mac, uint32_t xid, uint16_t * return_packet_len);
 network_dhcpv4_t* network_dhcpv4_create_request_packet(network_info_t* ni, uint32_t xid, uint16_t * return_packet_len);
+int8_t            network_dhcpv4_send_packet(network_info_t* ni, network_ipv4_address_t sip, const network_dhcpv4_t* dhcp_packet, uint16_t dhcp_packet_len);
 
 #ifdef __cplusplus
 }
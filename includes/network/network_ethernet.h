@@ -12,6 +12,7 @@
 #include <types.h>
 #include <network.h>
 #include <network/network_protocols.h>
+#include <network/network_packet.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,10 +31,9 @@ typedef struct network_ethernet_t {
 
 extern network_mac_address_t BROADCAST_MAC;
 
-boolean_t network_ethernet_is_mac_address_eq(network_mac_address_t mac1, network_mac_address_t mac2);
-list_t*   network_ethernet_process_packet(network_ethernet_t* recv_eth_packet, void* network_info);
-
-uint8_t* network_ethernet_create_packet(network_mac_address_t dest, network_mac_address_t src, network_ethernet_type_t type, uint16_t data_len, uint8_t* data);
+boolean_t         network_ethernet_is_mac_address_eq(network_mac_address_t mac1, network_mac_address_t mac2);
+network_packet_t* network_ethernet_process_packet(network_packet_t* packet);
+int8_t            network_ethernet_push_header(network_packet_t* packet, network_mac_address_t dst, network_mac_address_t src, network_ethernet_type_t type);
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,7 @@
 #include <types.h>
 #include <network.h>
 #include <network/network_protocols.h>
+#include <network/network_packet.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,7 +41,7 @@ typedef struct network_icmpv4_ping_header_t {
     uint32_t                timestamp_usec;
 }__attribute__((packed)) network_icmpv4_ping_header_t;
 
-uint8_t* network_icmpv4_process_packet(network_icmpv4_header_t* recv_icmpv4_packet, void* network_info, uint16_t* return_packet_len);
+network_packet_t* network_icmpv4_process_packet(network_packet_t* packet);
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,7 @@
 #define ___NETWORK_INFO_H 0
 
 #include <network/network_protocols.h>
+#include <network/network_tx_queue.h>
 #include <list.h>
 #include <map.h>
 
@@ -19,7 +20,7 @@ extern "C" {
 
 typedef struct network_info_t {
     network_mac_address_t  mac;
-    list_t*                return_queue;
+    network_tx_queue_t*    return_queue;
     network_ipv4_address_t ipv4_address;
     network_ipv4_address_t ipv4_subnetmask;
     network_ipv4_address_t ipv4_broadcast;
@@ -32,10 +33,19 @@ typedef struct network_info_t {
     boolean_t              is_ipv4_address_set;
     boolean_t              is_ipv4_address_requested;
     uint32_t               ipv4_address_next_request_time;
+    boolean_t              tx_checksum_offload; ///< nic completes tcp and udp checksums
 } network_info_t;
 
 extern map_t* network_info_map;
 
+/**
+ * @brief records tx checksum offload capability of a nic
+ * @param[in] mac mac address of nic
+ * @param[in] enabled true if nic completes tcp and udp checksums
+ * @return 0 on success
+ */
+int8_t network_info_set_tx_checksum_offload(const network_mac_address_t* mac, boolean_t enabled);
+
 #ifdef __cplusplus
 }
 #endif
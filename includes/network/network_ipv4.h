@@ -12,6 +12,7 @@
 #include <types.h>
 #include <network.h>
 #include <network/network_protocols.h>
+#include <network/network_packet.h>
 #include <network/network_icmpv4.h>
 #include <network/network_udpv4.h>
 #include <network/network_tcpv4.h>
@@ -57,11 +58,9 @@ typedef struct network_ipv4_header_t {
 extern network_ipv4_address_t NETWORK_IPV4_GLOBAL_BROADCAST_IP;
 extern network_ipv4_address_t NETWORK_IPV4_ZERO_IP;
 
-boolean_t network_ipv4_is_address_eq(const network_ipv4_address_t ipv4_addr1, const network_ipv4_address_t ipv4_addr2);
-list_t*   network_ipv4_process_packet(network_ipv4_header_t* recv_ipv4_packet, void* network_info);
-list_t*   network_ipv4_create_packet_from_icmp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_icmpv4_header_t* icmp_hdr, uint16_t icmp_packet_len);
-list_t*   network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_udpv4_header_t* udp_hdr);
-list_t*   network_ipv4_create_packet_from_tcp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_tcpv4_header_t* tcp_hdr, uint16_t packet_len);
+boolean_t         network_ipv4_is_address_eq(const network_ipv4_address_t ipv4_addr1, const network_ipv4_address_t ipv4_addr2);
+network_packet_t* network_ipv4_process_packet(network_packet_t* packet);
+network_packet_t* network_ipv4_output(network_packet_t* packet, const network_ipv4_address_t sip, network_ipv4_address_t dip, network_ipv4_protocol_t protocol);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,101 @@
+/**
+ * @file network_ipv4_fragment.h
+ * @brief IPv4 fragment reassembly header.
+ *
+ * Reassembly keeps received fragment packets without copying them until the datagram is complete. Datagrams in
+ * progress live in a fixed size table, missing ranges are tracked with hole descriptors of RFC 815. A timer wheel
+ * expires incomplete datagrams and a memory budget bounds buffers held by fragments, oldest datagrams are evicted
+ * when table or budget is full. Reassembly runs at network task, it is not thread safe.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_IPV4_FRAGMENT_H
+#define ___NETWORK_IPV4_FRAGMENT_H 0
+
+#include <types.h>
+#include <network/network_packet.h>
+#include <network/network_ipv4.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! datagrams reassembled at the same time */
+#define NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS 64
+/*! fragments of a datagram, 1500 mtu needs 45 for the largest datagram */
+#define NETWORK_IPV4_FRAGMENT_MAX_FRAGMENTS 64
+/*! holes of a datagram, more holes means a hostile fragment pattern */
+#define NETWORK_IPV4_FRAGMENT_MAX_HOLES 16
+/*! default reassembly timeout */
+#define NETWORK_IPV4_FRAGMENT_TIMEOUT_MS 30000
+/*! default bytes held by fragments, about an eighth of an igb rx pool */
+#define NETWORK_IPV4_FRAGMENT_MEMORY_BUDGET (256ULL << 10)
+/*! timer wheel slots, wheel spans 32 seconds */
+#define NETWORK_IPV4_FRAGMENT_WHEEL_SLOTS 64
+/*! timer wheel tick */
+#define NETWORK_IPV4_FRAGMENT_WHEEL_TICK_MS 512
+
+typedef enum network_ipv4_fragment_overlap_policy_t {
+    NETWORK_IPV4_FRAGMENT_OVERLAP_DROP, ///< datagram with overlapping fragments is discarded
+    NETWORK_IPV4_FRAGMENT_OVERLAP_FIRST, ///< bytes received first are kept
+    NETWORK_IPV4_FRAGMENT_OVERLAP_LAST, ///< bytes received last are kept
+} network_ipv4_fragment_overlap_policy_t;
+
+typedef struct network_ipv4_fragment_config_t {
+    uint64_t                               timeout_ms; ///< incomplete datagram lifetime, starts at first fragment
+    uint64_t                               memory_budget; ///< bytes held by fragment packets
+    network_ipv4_fragment_overlap_policy_t overlap_policy;
+} network_ipv4_fragment_config_t;
+
+typedef struct network_ipv4_fragment_stats_t {
+    uint64_t fragments; ///< received fragments
+    uint64_t reassembled; ///< completed datagrams
+    uint64_t timed_out; ///< datagrams expired by timer
+    uint64_t evicted; ///< datagrams discarded for table or memory budget
+    uint64_t overlaps; ///< fragments overlapping received data
+    uint64_t duplicates; ///< fragments received twice
+    uint64_t malformed; ///< fragments with wrong offset or length, or datagrams with too many holes or fragments
+    uint64_t datagrams; ///< datagrams in progress
+    uint64_t memory_used; ///< bytes held now
+} network_ipv4_fragment_stats_t;
+
+/**
+ * @brief configures reassembly, discards datagrams in progress
+ * @param[in] config configuration, NULL for defaults
+ * @return 0 on success
+ */
+int8_t network_ipv4_fragment_init(const network_ipv4_fragment_config_t* config);
+
+/**
+ * @brief releases all fragments and restores default configuration
+ */
+void network_ipv4_fragment_destroy(void);
+
+/**
+ * @brief adds a fragment to its datagram
+ * @param[in] packet fragment, data starts after ipv4 header. packet is owned by reassembly after call
+ * @param[in] header ipv4 header of fragment, flags and offset are host order
+ * @param[in] now millisecond time
+ * @return reassembled payload when fragment completes datagram, NULL otherwise
+ */
+network_packet_t* network_ipv4_fragment_input(network_packet_t* packet, const network_ipv4_header_t* header, uint64_t now);
+
+/**
+ * @brief expires incomplete datagrams
+ * @param[in] now millisecond time
+ */
+void network_ipv4_fragment_process_timers(uint64_t now);
+
+/**
+ * @brief copies reassembly counters
+ * @param[out] stats counters
+ */
+void network_ipv4_fragment_get_stats(network_ipv4_fragment_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * @file network_packet.h
+ * @brief network packet buffer header.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_PACKET_H
+#define ___NETWORK_PACKET_H 0
+
+#include <types.h>
+#include <memory.h>
+#include <list.h>
+#include <network.h>
+#include <network/network_protocols.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! headroom reserved before packet data, enough for ethernet, ipv4 and tcp headers with options */
+#define NETWORK_PACKET_HEADROOM 128
+/*! default pool buffer size, an ethernet frame with headroom fits */
+#define NETWORK_PACKET_DEFAULT_BUFFER_SIZE 2048
+
+#define NETWORK_PACKET_CHECKSUM_IPV4_VERIFIED 0x1 ///< rx, nic verified ipv4 header checksum
+#define NETWORK_PACKET_CHECKSUM_L4_VERIFIED   0x2 ///< rx, nic verified tcp or udp checksum
+#define NETWORK_PACKET_CHECKSUM_L4_OFFLOAD    0x4 ///< tx, l4 checksum field holds pseudo header sum, nic completes it
+
+/*! fixed size packet pool, packets are preallocated and recycled without heap calls */
+typedef struct network_packet_pool_t network_packet_pool_t;
+/*! bounded multi producer tx queue of a nic, see network_tx_queue.h */
+typedef struct network_tx_queue_t network_tx_queue_t;
+
+/**
+ * @struct network_packet_t
+ * @brief packet buffer with headroom and tailroom, layers parse and prepend headers in place
+ *
+ * buffer layout is headroom | data | tailroom. data starts at offset and spans length bytes. receive
+ * path pulls headers while parsing, transmit path pushes headers into headroom, so a packet crosses
+ * the stack without copies.
+ */
+typedef struct network_packet_t {
+    struct network_packet_t* next; ///< next packet of a chain, responses and fragments are chained
+    network_packet_pool_t*   pool; ///< owner pool, NULL if packet is allocated from heap
+    uint8_t*                 buffer; ///< buffer start
+    uint32_t                 capacity; ///< buffer size
+    uint32_t                 offset; ///< data start at buffer, bytes before it are headroom
+    uint32_t                 length; ///< data length
+    volatile int32_t         ref_count; ///< references, packet is recycled when it drops to zero
+    network_type_t           network_type; ///< link layer type of received packet
+    void*                    network_info; ///< mac address of receiving nic
+    network_tx_queue_t*      return_queue; ///< tx queue of receiving nic
+    network_mac_address_t    source_mac; ///< link layer source of received packet
+    uint8_t                  checksum_flags; ///< NETWORK_PACKET_CHECKSUM_* flags
+    uint8_t                  checksum_field; ///< offset of checksum field at l4 header, for l4 offload
+    uint16_t                 checksum_start; ///< buffer offset of l4 header, for l4 offload
+} network_packet_t; ///< short hand for struct
+
+/**
+ * @brief creates a packet pool
+ * @param[in] heap heap of pool, NULL for default heap
+ * @param[in] count packet count
+ * @param[in] buffer_size buffer size of each packet including headroom
+ * @return pool or NULL on error
+ */
+network_packet_pool_t* network_packet_pool_create(memory_heap_t* heap, uint64_t count, uint32_t buffer_size);
+
+/**
+ * @brief destroys a packet pool, all packets should be released before
+ * @param[in] pool pool
+ * @return 0 on success
+ */
+int8_t network_packet_pool_destroy(network_packet_pool_t* pool);
+
+/**
+ * @brief returns count of packets not in use
+ * @param[in] pool pool
+ * @return free packet count
+ */
+uint64_t network_packet_pool_get_free_count(network_packet_pool_t* pool);
+
+/**
+ * @brief allocates an empty packet with default headroom
+ * @details packets of a pool are taken from its lock free free list, pool packets can be released at
+ * any task. if pool is NULL or its buffers are too small, packet is allocated from heap. an exhausted
+ * pool returns NULL, callers drop the packet.
+ * @param[in] pool pool, can be NULL
+ * @param[in] size data size after headroom
+ * @return packet with reference count one or NULL
+ */
+network_packet_t* network_packet_alloc(network_packet_pool_t* pool, uint32_t size);
+
+/**
+ * @brief takes a reference of packet
+ * @param[in] packet packet
+ * @return packet
+ */
+network_packet_t* network_packet_ref(network_packet_t* packet);
+
+/**
+ * @brief drops a reference, last reference returns packet to its pool or frees it
+ * @param[in] packet packet
+ * @return 0 on success
+ */
+int8_t network_packet_release(network_packet_t* packet);
+
+/**
+ * @brief releases every packet of a chain
+ * @param[in] packet chain head
+ * @return 0 on success
+ */
+int8_t network_packet_release_chain(network_packet_t* packet);
+
+/**
+ * @brief prepends bytes into headroom
+ * @param[in] packet packet
+ * @param[in] len byte count
+ * @return new data start or NULL if headroom is small
+ */
+uint8_t* network_packet_push(network_packet_t* packet, uint32_t len);
+
+/**
+ * @brief strips bytes from data start
+ * @param[in] packet packet
+ * @param[in] len byte count
+ * @return new data start or NULL if packet is short
+ */
+uint8_t* network_packet_pull(network_packet_t* packet, uint32_t len);
+
+/**
+ * @brief appends bytes into tailroom
+ * @param[in] packet packet
+ * @param[in] len byte count
+ * @return start of appended area or NULL if tailroom is small
+ */
+uint8_t* network_packet_put(network_packet_t* packet, uint32_t len);
+
+/**
+ * @brief shortens data, link layer padding is removed with it
+ * @param[in] packet packet
+ * @param[in] len new length
+ * @return 0 on success, -1 if packet is shorter than len
+ */
+int8_t network_packet_trim(network_packet_t* packet, uint32_t len);
+
+static inline uint8_t* network_packet_data(const network_packet_t* packet) {
+    return packet->buffer + packet->offset;
+}
+
+static inline uint32_t network_packet_headroom(const network_packet_t* packet) {
+    return packet->offset;
+}
+
+static inline uint32_t network_packet_tailroom(const network_packet_t* packet) {
+    return packet->capacity - packet->offset - packet->length;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
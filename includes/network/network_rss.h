@@ -0,0 +1,83 @@
+/**
+ * @file network_rss.h
+ * @brief Receive side scaling header.
+ *
+ * Toeplitz hash of Microsoft RSS specification, nics compute it over addresses and ports of a frame and
+ * pick a receive queue with low bits of hash through a redirection table. Software computes same hash to
+ * program nics and to check flow to queue mapping.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_RSS_H
+#define ___NETWORK_RSS_H 0
+
+#include <types.h>
+#include <network/network_protocols.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! hash key length, enough for ipv6 addresses and ports */
+#define NETWORK_RSS_KEY_SIZE 40
+/*! redirection table entries, low 7 bits of hash select an entry */
+#define NETWORK_RSS_RETA_SIZE 128
+
+/*! key of RSS specification, its verification vectors are computed with it */
+extern const uint8_t network_rss_default_key[NETWORK_RSS_KEY_SIZE];
+
+/**
+ * @brief toeplitz hash of input
+ * @param[in] key hash key, at least len + 4 bytes
+ * @param[in] input bytes in network order
+ * @param[in] len input length
+ * @return hash
+ */
+uint32_t network_rss_toeplitz(const uint8_t* key, const uint8_t* input, uint32_t len);
+
+/**
+ * @brief hash of an ipv4 flow
+ * @param[in] key hash key
+ * @param[in] sip source ip
+ * @param[in] dip destination ip
+ * @param[in] sport source port, host order
+ * @param[in] dport destination port, host order
+ * @param[in] with_ports ports are hashed for tcp and udp, not for fragments and other protocols
+ * @return hash
+ */
+uint32_t network_rss_hash_ipv4(const uint8_t* key, network_ipv4_address_t sip, network_ipv4_address_t dip,
+                               uint16_t sport, uint16_t dport, boolean_t with_ports);
+
+/**
+ * @brief hash of an ethernet frame as a nic computes it
+ * @param[in] key hash key
+ * @param[in] frame ethernet frame
+ * @param[in] len frame length
+ * @return hash, 0 for frames other than ipv4
+ */
+uint32_t network_rss_hash_frame(const uint8_t* key, const uint8_t* frame, uint32_t len);
+
+/**
+ * @brief spreads queues over redirection table round robin
+ * @param[out] reta redirection table
+ * @param[in] reta_size entry count
+ * @param[in] queue_count receive queues
+ */
+void network_rss_fill_reta(uint8_t* reta, uint32_t reta_size, uint32_t queue_count);
+
+/**
+ * @brief receive queue of a hash
+ * @param[in] reta redirection table
+ * @param[in] reta_size entry count, power of two
+ * @param[in] hash flow hash
+ * @return queue index
+ */
+uint8_t network_rss_queue(const uint8_t* reta, uint32_t reta_size, uint32_t hash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * @file network_socket.h
+ * @brief Network socket header.
+ *
+ * Sockets are the application interface of tcp and udp. All calls are non blocking, a task waits for
+ * readiness of several sockets with network_socket_poll, which parks it at the scheduler until the network
+ * task notifies one of them or timeout expires.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_SOCKET_H
+#define ___NETWORK_SOCKET_H 0
+
+#include <types.h>
+#include <network.h>
+#include <network/network_protocols.h>
+#include <network/network_packet.h>
+#include <network/network_tx_queue.h>
+#include <network/network_tcpv4.h>
+#include <future.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! largest datagram sent without fragmentation, ethernet mtu minus ipv4 and udp headers */
+#define NETWORK_SOCKET_UDP_MAX_PAYLOAD 1472
+/*! received datagrams kept by a socket, later ones are dropped */
+#define NETWORK_SOCKET_UDP_QUEUE_LIMIT 256
+/*! first port given to sockets connecting or sending without bind */
+#define NETWORK_SOCKET_EPHEMERAL_PORT_START 49152
+/*! poll timeout for waiting without a deadline */
+#define NETWORK_SOCKET_POLL_FOREVER 0xFFFFFFFFFFFFFFFFULL
+
+#define NETWORK_SOCKET_EVENT_READABLE 0x1 ///< data, eof or a connection to accept is available
+#define NETWORK_SOCKET_EVENT_WRITABLE 0x2 ///< send buffer has room
+#define NETWORK_SOCKET_EVENT_HUP      0x4 ///< peer closed or connection is gone, always reported
+#define NETWORK_SOCKET_EVENT_ERROR    0x8 ///< connection is reset or timed out, always reported
+
+typedef enum network_socket_type_t {
+    NETWORK_SOCKET_TYPE_STREAM, ///< tcp
+    NETWORK_SOCKET_TYPE_DATAGRAM, ///< udp
+} network_socket_type_t;
+
+typedef struct network_socket_t network_socket_t;
+
+/*! next hop of outgoing packets, there is no arp cache or routing table yet */
+typedef struct network_socket_route_t {
+    void*                  network_info; ///< mac of nic
+    network_tx_queue_t*    return_queue; ///< tx queue of nic
+    network_mac_address_t  next_hop_mac;
+    network_packet_pool_t* pool; ///< pool of outgoing packets, NULL for heap
+} network_socket_route_t;
+
+/*! peer address, received datagrams fill route with the path they came from so replies can use it */
+typedef struct network_socket_address_t {
+    network_ipv4_address_t ip;
+    uint16_t               port;
+    network_socket_route_t route;
+} network_socket_address_t;
+
+typedef struct network_socket_poll_t {
+    network_socket_t* socket;
+    uint32_t          events; ///< requested events
+    uint32_t          revents; ///< ready events, filled by poll
+} network_socket_poll_t;
+
+/**
+ * @brief initializes socket layer, connects it to tcp and udp notifications
+ * @return 0 on success
+ */
+int8_t network_socket_init(void);
+
+/**
+ * @brief frees socket layer state, all sockets should be closed before
+ */
+void network_socket_destroy(void);
+
+/**
+ * @brief creates a socket
+ * @param[in] type stream or datagram
+ * @return socket or NULL
+ */
+network_socket_t* network_socket_create(network_socket_type_t type);
+
+/**
+ * @brief binds local address
+ * @param[in] socket socket
+ * @param[in] ip local ip, zero address for all addresses
+ * @param[in] port local port, 0 selects an ephemeral port
+ * @return 0 on success, -1 if socket is bound or port is in use
+ */
+int8_t network_socket_bind(network_socket_t* socket, network_ipv4_address_t ip, uint16_t port);
+
+/**
+ * @brief starts accepting connections at bound address
+ * @param[in] socket bound stream socket
+ * @param[in] backlog unaccepted connection limit, 0 for default
+ * @return 0 on success
+ */
+int8_t network_socket_listen(network_socket_t* socket, uint32_t backlog);
+
+/**
+ * @brief takes an established connection
+ * @param[in] socket listening socket
+ * @return connected socket or NULL if there is none
+ */
+network_socket_t* network_socket_accept(network_socket_t* socket);
+
+/**
+ * @brief connects stream socket or sets default peer of datagram socket
+ * @details stream connect returns at once, socket becomes writable when handshake completes. socket without
+ * a local ip takes ip of route's nic.
+ * @param[in] socket socket
+ * @param[in] address peer address and route
+ * @return 0 on success
+ */
+int8_t network_socket_connect(network_socket_t* socket, const network_socket_address_t* address);
+
+/**
+ * @brief sends bytes to connected peer
+ * @param[in] socket socket
+ * @param[in] data bytes
+ * @param[in] len byte count
+ * @return sent or queued byte count, 0 if buffer is full, -1 on error
+ */
+int64_t network_socket_send(network_socket_t* socket, const void* data, uint64_t len);
+
+/**
+ * @brief receives bytes from connected peer
+ * @param[in] socket socket
+ * @param[out] data destination
+ * @param[in] len destination size
+ * @return byte count, 0 if nothing is available, -1 at end of stream or on error
+ */
+int64_t network_socket_recv(network_socket_t* socket, void* data, uint64_t len);
+
+/**
+ * @brief sends a datagram
+ * @param[in] socket datagram socket, it is bound to an ephemeral port if needed
+ * @param[in] data payload
+ * @param[in] len payload length, at most NETWORK_SOCKET_UDP_MAX_PAYLOAD
+ * @param[in] address destination
+ * @return len on success, -1 on error
+ */
+int64_t network_socket_sendto(network_socket_t* socket, const void* data, uint64_t len, const network_socket_address_t* address);
+
+/**
+ * @brief receives a datagram, excess bytes of it are discarded
+ * @param[in] socket datagram socket
+ * @param[out] data destination
+ * @param[in] len destination size
+ * @param[out] address source of datagram, can be NULL
+ * @return copied byte count, -1 if there is no datagram
+ */
+int64_t network_socket_recvfrom(network_socket_t* socket, void* data, uint64_t len, network_socket_address_t* address);
+
+/**
+ * @brief closes socket and frees it, connection finishes close handshake in background
+ * @param[in] socket socket
+ * @return 0 on success
+ */
+int8_t network_socket_close(network_socket_t* socket);
+
+/**
+ * @brief waits readiness of sockets
+ * @details a socket can be waited by one task at a time.
+ * @param[in,out] fds sockets with requested events, revents are filled
+ * @param[in] count socket count
+ * @param[in] timeout_ms 0 checks without waiting, NETWORK_SOCKET_POLL_FOREVER waits without deadline
+ * @return ready socket count, 0 on timeout, -1 on error
+ */
+int64_t network_socket_poll(network_socket_poll_t* fds, uint64_t count, uint64_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
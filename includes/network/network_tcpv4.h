@@ -12,12 +12,45 @@
 #include <types.h>
 #include <network.h>
 #include <network/network_protocols.h>
+#include <network/network_packet.h>
+#include <network/network_tx_queue.h>
 #include <hashmap.h>
+#include <list.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*! mss advertised by us, ethernet mtu minus ipv4 and tcp headers */
+#define NETWORK_TCPV4_MSS                      1460
+/*! mss assumed when peer does not send mss option */
+#define NETWORK_TCPV4_DEFAULT_MSS              536
+/*! send and receive buffer size of each connection, power of two */
+#define NETWORK_TCPV4_BUFFER_SIZE              (128 << 10)
+/*! our window scale shift, buffer size shifted by it fits into 16 bits */
+#define NETWORK_TCPV4_WINDOW_SCALE             2
+/*! initial congestion window in segments (rfc 6928) */
+#define NETWORK_TCPV4_INITIAL_WINDOW_SEGMENTS  10
+/*! duplicate ack count starting fast retransmit */
+#define NETWORK_TCPV4_DUPACK_THRESHOLD         3
+/*! sack scoreboard size of sender */
+#define NETWORK_TCPV4_SACK_SCOREBOARD_SIZE     8
+/*! retransmission timeout before first rtt sample */
+#define NETWORK_TCPV4_INITIAL_RTO_MS           1000
+/*! lower bound of retransmission timeout */
+#define NETWORK_TCPV4_MIN_RTO_MS               200
+/*! upper bound of retransmission timeout */
+#define NETWORK_TCPV4_MAX_RTO_MS               60000
+/*! consecutive timeouts aborting a connection */
+#define NETWORK_TCPV4_MAX_RETRIES              12
+/*! delayed ack timeout */
+#define NETWORK_TCPV4_DELAYED_ACK_MS           40
+/*! time wait duration, two maximum segment lifetimes */
+#define NETWORK_TCPV4_TIME_WAIT_MS             60000
+/*! timer granularity of network task */
+#define NETWORK_TCPV4_TIMER_INTERVAL_MS        10
+/*! accept queue length when listen is called without a backlog */
+#define NETWORK_TCPV4_DEFAULT_BACKLOG          128
 
 typedef struct network_tcpv4_header_t {
     uint16_t source_port;
@@ -54,26 +87,312 @@ typedef enum network_tcp_connection_state_t {
     NETWORK_TCP_CONNECTION_STATE_TIME_WAIT
 } network_tcp_connection_state_t;
 
+typedef enum network_tcpv4_congestion_control_t {
+    NETWORK_TCPV4_CONGESTION_CONTROL_NEWRENO,
+    NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC,
+} network_tcpv4_congestion_control_t;
+
+/**
+ * @struct network_tcpv4_buffer_t
+ * @brief byte ring of a connection, send ring starts at first unacknowledged byte, receive ring at first
+ * byte not read by application
+ */
+typedef struct network_tcpv4_buffer_t {
+    uint8_t* data; ///< ring memory
+    uint32_t capacity; ///< ring size, power of two
+    uint32_t start; ///< position of first byte
+    uint32_t length; ///< byte count at ring
+} network_tcpv4_buffer_t;
+
+/*! sequence range [start, end) */
+typedef struct network_tcpv4_sack_block_t {
+    uint32_t start; ///< first sequence
+    uint32_t end; ///< sequence after last byte
+} network_tcpv4_sack_block_t;
+
+/*! out of order segment waiting for a hole before it */
+typedef struct network_tcpv4_segment_t {
+    struct network_tcpv4_segment_t* next; ///< next segment with higher sequence
+    uint32_t                        sequence; ///< sequence of first payload byte
+    uint32_t                        length; ///< payload length
+    boolean_t                       fin; ///< segment carries fin
+    network_packet_t*               packet; ///< packet whose data is payload
+} network_tcpv4_segment_t;
+
+/*! cubic state (rfc 9438), windows are in bytes */
+typedef struct network_tcpv4_cubic_t {
+    uint64_t epoch_start; ///< start of current congestion avoidance epoch, 0 if not started
+    uint32_t w_max; ///< window before last reduction
+    uint32_t w_last_max; ///< previous w_max for fast convergence
+    uint32_t w_est; ///< reno friendly window estimation
+    uint32_t origin; ///< window at plateau of cubic function
+    uint32_t k_ms; ///< time to reach origin
+} network_tcpv4_cubic_t;
+
 typedef struct network_tcpv4_connection_t {
-    network_ipv4_address_t         local_ip;
-    network_ipv4_address_t         remote_ip;
-    uint16_t                       local_port;
-    uint16_t                       remote_port;
-    uint32_t                       local_sequence_number;
-    uint32_t                       remote_sequence_number;
-    uint32_t                       local_acknowledgement_number;
-    uint32_t                       remote_acknowledgement_number;
-    uint16_t                       window_size;
-    network_tcp_connection_state_t state;
+    network_ipv4_address_t             local_ip;
+    network_ipv4_address_t             remote_ip;
+    uint16_t                           local_port;
+    uint16_t                           remote_port;
+    network_tcp_connection_state_t     state;
+    void*                              owner; ///< socket of connection, notified at state changes
+    boolean_t                          unaccepted; ///< passive connection is not taken by accept yet
+    struct network_tcpv4_connection_t* accept_next; ///< next connection at accept queue of listener
+    void*                              network_info; ///< mac of nic, segments not answering a packet leave from it
+    network_tx_queue_t*                return_queue; ///< tx queue of nic
+    network_mac_address_t              remote_mac; ///< next hop mac
+    network_packet_pool_t*             pool; ///< pool of new segments, NULL for heap
+    uint32_t                           iss; ///< initial send sequence
+    uint32_t                           snd_una; ///< oldest unacknowledged sequence
+    uint32_t                           snd_nxt; ///< next sequence to send
+    uint32_t                           snd_wnd; ///< peer window, scaled
+    uint32_t                           snd_wl1; ///< sequence of last window update
+    uint32_t                           snd_wl2; ///< ack of last window update
+    uint32_t                           fin_sequence; ///< sequence of our fin if it is sent
+    uint16_t                           mss; ///< payload size of a segment
+    uint8_t                            snd_wscale; ///< peer window shift
+    uint8_t                            rcv_wscale; ///< our window shift
+    boolean_t                          sack_permitted; ///< both sides negotiated sack
+    boolean_t                          fin_queued; ///< application closed send side
+    boolean_t                          fin_sent; ///< fin occupies fin_sequence
+    boolean_t                          fin_received; ///< peer fin is consumed
+    network_tcpv4_buffer_t             send_buffer; ///< unacknowledged and unsent bytes starting at snd_una
+    uint32_t                           irs; ///< initial receive sequence
+    uint32_t                           rcv_nxt; ///< next expected sequence
+    uint32_t                           rcv_adv; ///< right edge of advertised window
+    network_tcpv4_buffer_t             recv_buffer; ///< received in order bytes
+    network_tcpv4_segment_t*           ooo_segments; ///< out of order segments sorted by sequence
+    uint32_t                           ooo_last_sequence; ///< latest out of order segment, first sack block covers it
+    uint32_t                           ack_pending; ///< in order segments not acknowledged yet
+    boolean_t                          ack_now; ///< next output sends an ack even without data
+    uint64_t                           delack_deadline; ///< delayed ack time, 0 if not armed
+    uint64_t                           rto_deadline; ///< retransmission or persist time, 0 if not armed
+    uint64_t                           close_deadline; ///< time wait end
+    uint32_t                           srtt_x8; ///< smoothed rtt scaled by 8, 0 before first sample
+    uint32_t                           rttvar_x4; ///< rtt variance scaled by 4
+    uint32_t                           rto; ///< retransmission timeout
+    boolean_t                          rtt_active; ///< a segment is timed
+    uint32_t                           rtt_sequence; ///< sequence of timed segment
+    uint64_t                           rtt_start; ///< send time of timed segment
+    uint32_t                           retries; ///< consecutive timeouts
+    network_tcpv4_congestion_control_t congestion_control;
+    uint32_t                           cwnd; ///< congestion window
+    uint32_t                           ssthresh; ///< slow start threshold
+    uint32_t                           ca_acked; ///< bytes acked at congestion avoidance since last increase
+    uint32_t                           dupacks; ///< consecutive duplicate acks
+    boolean_t                          in_recovery; ///< fast recovery or timeout recovery
+    boolean_t                          timeout_recovery; ///< recovery is started by timeout
+    uint32_t                           recover; ///< snd_nxt when recovery started
+    uint32_t                           rexmit_high; ///< bytes before it are retransmitted at recovery
+    uint32_t                           lost_high; ///< unsacked bytes before it are lost
+    uint32_t                           sack_count; ///< valid scoreboard blocks
+    network_tcpv4_sack_block_t         sack_scoreboard[NETWORK_TCPV4_SACK_SCOREBOARD_SIZE]; ///< sacked ranges sorted by sequence
+    network_tcpv4_cubic_t              cubic;
+    uint64_t                           stat_bytes_sent; ///< new payload bytes sent
+    uint64_t                           stat_bytes_received; ///< in order payload bytes received
+    uint64_t                           stat_retransmits; ///< retransmitted segments
+    uint64_t                           stat_fast_recoveries; ///< fast recovery entries
+    uint64_t                           stat_timeouts; ///< retransmission timeouts
 } network_tcpv4_connection_t;
 
 typedef struct network_tcpv4_listener_t {
-    network_ipv4_address_t local_ip;
-    uint16_t               local_port;
-    hashmap_t*             connections;
+    network_ipv4_address_t      local_ip; ///< zero address listens on all addresses
+    uint16_t                    local_port;
+    boolean_t                   listening; ///< false if entry only holds active opened connections
+    hashmap_t*                  connections;
+    void*                       owner; ///< socket of listener, notified when a connection is queued
+    uint32_t                    backlog; ///< limit of unaccepted connections
+    uint32_t                    unaccepted_count; ///< half open and queued connections
+    network_tcpv4_connection_t* accept_head; ///< established connections waiting for accept
+    network_tcpv4_connection_t* accept_tail; ///< last queued connection
 } network_tcpv4_listener_t;
 
-uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_tcpv4_header_t* recv_tcpv4_packet, void* network_info, uint16_t packet_len, uint16_t* return_packet_len);
+/*! millisecond clock of tcp timers */
+typedef uint64_t (* network_tcpv4_clock_f)(void);
+
+/**
+ * @brief owner notification, called with tcp lock held
+ * @param[in] owner owner of connection or listener
+ * @param[in] detached connection is freed by stack, owner must forget it
+ */
+typedef void (* network_tcpv4_notify_f)(void* owner, boolean_t detached);
+
+/**
+ * @brief creates tcp lock, network task and application tasks share tcp state through it
+ * @return 0 on success
+ */
+int8_t network_tcpv4_init(void);
+
+/*! acquires tcp lock, it is recursive for the owner task and counts nesting */
+void network_tcpv4_lock(void);
+
+/*! releases tcp lock, lock is freed when outermost acquire is released */
+void network_tcpv4_unlock(void);
+
+/**
+ * @brief sets owner notification of sockets
+ * @param[in] notify callback, NULL disables notifications
+ */
+void network_tcpv4_set_notify(network_tcpv4_notify_f notify);
+
+/**
+ * @brief processes a received segment
+ * @details packet is consumed. segments answering it are returned for ipv4 layer, segments sent later by
+ * timers or application leave from return queue of connection's nic.
+ * @param[in] packet segment, data starts at tcp header
+ * @param[in] dip destination (our) ip
+ * @param[in] sip source (peer) ip
+ * @return response segment chain or NULL
+ */
+network_packet_t* network_tcpv4_process_packet(network_packet_t* packet, network_ipv4_address_t dip, network_ipv4_address_t sip);
+
+/**
+ * @brief runs expired retransmission, delayed ack, persist and time wait timers of all connections
+ * @details network task calls it at each NETWORK_TCPV4_TIMER_INTERVAL_MS.
+ */
+void network_tcpv4_process_timers(void);
+
+/**
+ * @brief replaces tcp clock, host tests drive timers with a simulated clock
+ * @param[in] clock clock, NULL restores time_ns based clock
+ */
+void network_tcpv4_set_clock(network_tcpv4_clock_f clock);
+
+/**
+ * @brief starts accepting connections
+ * @details syns are dropped while backlog connections are half open or waiting for accept, peers retry them.
+ * @param[in] ip local ip, zero address for all addresses
+ * @param[in] port local port
+ * @param[in] backlog unaccepted connection limit, 0 for NETWORK_TCPV4_DEFAULT_BACKLOG
+ * @return listener or NULL
+ */
+network_tcpv4_listener_t* network_tcpv4_listen(network_ipv4_address_t ip, uint16_t port, uint32_t backlog);
+
+/**
+ * @brief finds listener of a local address, listener of zero address matches all addresses
+ * @details entries of active opened connections are listeners which are not listening.
+ * @param[in] ip local ip
+ * @param[in] port local port
+ * @return listener or NULL
+ */
+network_tcpv4_listener_t* network_tcpv4_listener_get(network_ipv4_address_t ip, uint16_t port);
+
+/**
+ * @brief takes an established connection from accept queue
+ * @param[in] listener listener
+ * @return connection or NULL if queue is empty
+ */
+network_tcpv4_connection_t* network_tcpv4_accept(network_tcpv4_listener_t* listener);
+
+/**
+ * @brief stops accepting connections, unaccepted connections are reset
+ * @details accepted connections keep running, listener is freed after them.
+ * @param[in] listener listener
+ */
+void network_tcpv4_unlisten(network_tcpv4_listener_t* listener);
+
+/**
+ * @brief opens a connection, syn is sent immediately
+ * @details there is no arp cache yet, caller gives next hop mac and nic.
+ * @param[in] network_info mac of nic
+ * @param[in] return_queue tx queue of nic
+ * @param[in] remote_mac next hop mac
+ * @param[in] pool pool of segments, NULL for heap
+ * @param[in] local_ip local ip
+ * @param[in] local_port local port
+ * @param[in] remote_ip remote ip
+ * @param[in] remote_port remote port
+ * @return connection at syn sent state or NULL
+ */
+network_tcpv4_connection_t* network_tcpv4_connect(void*                  network_info,
+                                                  network_tx_queue_t*    return_queue,
+                                                  network_mac_address_t  remote_mac,
+                                                  network_packet_pool_t* pool,
+                                                  network_ipv4_address_t local_ip,
+                                                  uint16_t               local_port,
+                                                  network_ipv4_address_t remote_ip,
+                                                  uint16_t               remote_port);
+
+/**
+ * @brief finds a connection
+ * @param[in] local_ip local ip
+ * @param[in] local_port local port
+ * @param[in] remote_ip remote ip
+ * @param[in] remote_port remote port
+ * @return connection or NULL
+ */
+network_tcpv4_connection_t* network_tcpv4_connection_get(network_ipv4_address_t local_ip, uint16_t local_port, network_ipv4_address_t remote_ip, uint16_t remote_port);
+
+/**
+ * @brief queues bytes into send buffer and sends what windows allow
+ * @param[in] connection connection
+ * @param[in] data bytes
+ * @param[in] len byte count
+ * @return queued byte count, less than len if buffer is full, -1 if send side is closed
+ */
+int64_t network_tcpv4_send(network_tcpv4_connection_t* connection, const uint8_t* data, uint64_t len);
+
+/**
+ * @brief reads received in order bytes, window update is sent if window opens enough
+ * @param[in] connection connection
+ * @param[out] data destination
+ * @param[in] len destination size
+ * @return read byte count, 0 if nothing is received, -1 if peer closed and everything is read
+ */
+int64_t network_tcpv4_recv(network_tcpv4_connection_t* connection, uint8_t* data, uint64_t len);
+
+/**
+ * @brief closes send side, fin follows queued bytes. connection is freed after close handshake
+ * @param[in] connection connection
+ * @return 0 on success
+ */
+int8_t network_tcpv4_close(network_tcpv4_connection_t* connection);
+
+/**
+ * @brief resets and frees a connection, owner is not notified
+ * @param[in] connection connection
+ */
+void network_tcpv4_abort(network_tcpv4_connection_t* connection);
+
+/**
+ * @brief selects congestion control of connection
+ * @param[in] connection connection
+ * @param[in] congestion_control algorithm
+ */
+void network_tcpv4_set_congestion_control(network_tcpv4_connection_t* connection, network_tcpv4_congestion_control_t congestion_control);
+
+/**
+ * @brief frees all listeners and connections without sending anything
+ */
+void network_tcpv4_destroy_all(void);
+
+/**
+ * @brief initializes congestion window of a connection after handshake
+ * @param[in] connection connection
+ */
+void network_tcpv4_congestion_init(network_tcpv4_connection_t* connection);
+
+/**
+ * @brief grows congestion window for newly acknowledged bytes, not called during fast recovery
+ * @param[in] connection connection
+ * @param[in] acked acknowledged byte count
+ * @param[in] now current time
+ */
+void network_tcpv4_congestion_on_ack(network_tcpv4_connection_t* connection, uint32_t acked, uint64_t now);
+
+/**
+ * @brief reduces window when fast retransmit detects a loss
+ * @param[in] connection connection
+ * @param[in] now current time
+ */
+void network_tcpv4_congestion_on_loss(network_tcpv4_connection_t* connection, uint64_t now);
+
+/**
+ * @brief collapses window to one segment after retransmission timeout
+ * @param[in] connection connection
+ * @param[in] now current time
+ */
+void network_tcpv4_congestion_on_timeout(network_tcpv4_connection_t* connection, uint64_t now);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,101 @@
+/**
+ * @file network_tx_queue.h
+ * @brief network transmit queue header.
+ *
+ * Bounded ring between protocol layers and a nic. Any task may push, only tx task of nic pops. Producers
+ * reserve slots with one compare and swap and publish them with per slot sequence numbers, consumer takes
+ * published slots in order without atomic read modify write. A push is a whole packet chain, so fragments
+ * and segments of a call cost one reservation and at most one wake up of consumer.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_TX_QUEUE_H
+#define ___NETWORK_TX_QUEUE_H 0
+
+#include <types.h>
+#include <memory.h>
+#include <network/network_packet.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! default capacity of a nic tx queue */
+#define NETWORK_TX_QUEUE_DEFAULT_CAPACITY 1024
+
+/*! wakes consumer task of a queue */
+typedef void (*network_tx_queue_waker_f)(uint64_t task_id);
+
+/**
+ * @brief creates a tx queue
+ * @param[in] heap heap of queue, NULL for default heap
+ * @param[in] capacity slot count, rounded up to power of two
+ * @return queue or NULL on error
+ */
+network_tx_queue_t* network_tx_queue_create(memory_heap_t* heap, uint64_t capacity);
+
+/**
+ * @brief destroys a tx queue, queued packets are released
+ * @param[in] queue tx queue
+ * @return 0 on success
+ */
+int8_t network_tx_queue_destroy(network_tx_queue_t* queue);
+
+/**
+ * @brief sets consumer of queue, producers wake it when it waits
+ * @param[in] queue tx queue
+ * @param[in] task_id consumer task
+ * @param[in] waker wake function, NULL for no wake up
+ * @return 0 on success
+ */
+int8_t network_tx_queue_set_consumer(network_tx_queue_t* queue, uint64_t task_id, network_tx_queue_waker_f waker);
+
+/**
+ * @brief queues a packet chain, all packets or none
+ * @details on success queue owns packets and their next links are cleared. on failure caller still owns
+ * chain, so it may drop it, keep it for retransmission or retry later.
+ * @param[in] queue tx queue
+ * @param[in] packets packet chain
+ * @return 0 on success, -1 when queue has not enough free slots
+ */
+int8_t network_tx_queue_push(network_tx_queue_t* queue, network_packet_t* packets);
+
+/**
+ * @brief takes queued packets in order, only consumer calls it
+ * @param[in] queue tx queue
+ * @param[out] packets taken packets
+ * @param[in] max maximum packet count
+ * @return taken packet count
+ */
+uint64_t network_tx_queue_pop_batch(network_tx_queue_t* queue, network_packet_t** packets, uint64_t max);
+
+/**
+ * @brief prepares consumer to wait
+ * @details consumer calls it before sleeping, a push after it wakes consumer. if packets are already
+ * queued consumer should not sleep.
+ * @param[in] queue tx queue
+ * @return true if queue is empty and consumer may sleep
+ */
+boolean_t network_tx_queue_prepare_wait(network_tx_queue_t* queue);
+
+/**
+ * @brief queued packet count, reserved but unpublished slots are counted
+ * @param[in] queue tx queue
+ * @return packet count
+ */
+uint64_t network_tx_queue_size(network_tx_queue_t* queue);
+
+/**
+ * @brief free slot count
+ * @param[in] queue tx queue
+ * @return free slots
+ */
+uint64_t network_tx_queue_get_free_count(network_tx_queue_t* queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,6 +12,7 @@
 #include <types.h>
 #include <network.h>
 #include <network/network_protocols.h>
+#include <network/network_packet.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,8 +29,20 @@ typedef struct network_udpv4_header_t {
 }__attribute__((packed)) network_udpv4_header_t;
 
 
-uint8_t*                network_udpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_udpv4_header_t* recv_udpv4_packet, void* network_info, uint16_t* return_packet_len);
-network_udpv4_header_t* network_udpv4_create_packet_from_data(uint16_t sp, uint16_t dp, uint16_t len, uint8_t* data);
+/**
+ * @brief receiver of datagrams, socket layer registers it
+ * @param[in] packet datagram whose data is payload, receiver consumes it only if it returns true
+ * @param[in] dip destination (our) ip
+ * @param[in] sip source ip
+ * @param[in] dport destination port
+ * @param[in] sport source port
+ * @return true if a socket took datagram
+ */
+typedef boolean_t (* network_udpv4_receiver_f)(network_packet_t* packet, network_ipv4_address_t dip, network_ipv4_address_t sip, uint16_t dport, uint16_t sport);
+
+network_packet_t* network_udpv4_process_packet(network_packet_t* packet, network_ipv4_address_t dip, network_ipv4_address_t sip);
+int8_t            network_udpv4_push_header(network_packet_t* packet, network_ipv4_address_t sip, network_ipv4_address_t dip, uint16_t sp, uint16_t dp);
+void              network_udpv4_set_receiver(network_udpv4_receiver_f receiver);
 
 #ifdef __cplusplus
 }
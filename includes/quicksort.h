@@ -19,20 +19,85 @@ extern "C" {
 typedef int8_t (*quicksort_comparator_f)(const void* a, const void* b);
 typedef void   (*quicksort_swap_f)(void* a, void* b, uint64_t item_size);
 
+/**
+ * @brief sorts items between start and end (inclusive) in place, not stable
+ * @details introsort: median of three quicksort, insertion sort for short ranges and heapsort
+ * when partitioning degrades, so worst case is O(n log n) and stack depth is O(log n).
+ * swap may be NULL, then items are swapped inline with size specialized copies.
+ * @param[in] array item array
+ * @param[in] start first item index
+ * @param[in] end last item index
+ * @param[in] item_size item size in bytes
+ * @param[in] comparator comparator taking pointers to items
+ * @param[in] swap optional swap callback
+ */
 void quicksort_partial(void* array, uint64_t start, uint64_t end, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap);
 
 static inline void quicksort(void* array, uint64_t size, uint64_t item_size, quicksort_comparator_f comparator, quicksort_swap_f swap)
 {
+    if (size < 2) {
+        return;
+    }
+
     quicksort_partial(array, 0, size - 1, item_size, comparator, swap);
 }
 
+/**
+ * @brief sorts pointer array between start and end (inclusive) in place, not stable
+ * @details same introsort as quicksort_partial, comparator takes the pointers themselves.
+ * @param[in] array pointer array
+ * @param[in] start first index
+ * @param[in] end last index
+ * @param[in] comparator comparator
+ */
 void quicksort2_partial(void** array, uint64_t start, uint64_t end, quicksort_comparator_f comparator);
 
 static inline void quicksort2(void** array, uint64_t size, quicksort_comparator_f comparator)
 {
+    if (size < 2) {
+        return;
+    }
+
     quicksort2_partial(array, 0, size - 1, comparator);
 }
 
+/**
+ * @brief stable bottom up merge sort
+ * @details allocates a buffer of size * item_size bytes.
+ * @param[in] array item array
+ * @param[in] size item count
+ * @param[in] item_size item size in bytes
+ * @param[in] comparator comparator taking pointers to items
+ * @return 0 if success, -1 if error
+ */
+int8_t mergesort(void* array, uint64_t size, uint64_t item_size, quicksort_comparator_f comparator);
+
+/**
+ * @brief stable bottom up merge sort of pointer array
+ * @param[in] array pointer array
+ * @param[in] size pointer count
+ * @param[in] comparator comparator taking the pointers themselves
+ * @return 0 if success, -1 if error
+ */
+int8_t mergesort2(void** array, uint64_t size, quicksort_comparator_f comparator);
+
+/**
+ * @brief lsd radix sort of unsigned 64-bit keys, 8 bits per pass
+ * @details passes where all keys share the same byte are skipped.
+ * @param[in] array key array
+ * @param[in] size key count
+ * @return 0 if success, -1 if error
+ */
+int8_t radixsort_uint64(uint64_t* array, uint64_t size);
+
+/**
+ * @brief lsd radix sort of unsigned 32-bit keys, 8 bits per pass
+ * @param[in] array key array
+ * @param[in] size key count
+ * @return 0 if success, -1 if error
+ */
+int8_t radixsort_uint32(uint32_t* array, uint64_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,116 @@ size_t          spool_get_buffer_count(const spool_item_t* item);
 size_t          spool_get_total_buffer_size(const spool_item_t* item);
 const buffer_t* spool_get_buffer(const spool_item_t* item, size_t buf_idx);
 
+/**
+ * @enum spool_ring_policy_t
+ * @brief what a full spool ring does with a new record
+ */
+typedef enum spool_ring_policy_t {
+    SPOOL_RING_POLICY_OVERWRITE_OLDEST, ///< oldest records are evicted
+    SPOOL_RING_POLICY_DROP_NEWEST, ///< new record is dropped until readers release space
+} spool_ring_policy_t; ///< short hand for enum
+
+/*! fixed size multi producer ring of named variable length records */
+typedef struct spool_ring_t spool_ring_t;
+
+/**
+ * @struct spool_ring_cursor_t
+ * @brief reader position at a spool ring, readers do not consume records
+ */
+typedef struct spool_ring_cursor_t {
+    uint64_t position; ///< stream position of next record
+    uint64_t lost_bytes; ///< bytes overwritten before this cursor read them
+} spool_ring_cursor_t; ///< short hand for struct
+
+/**
+ * @struct spool_ring_record_t
+ * @brief record read from a spool ring, name and data point into reader's buffer
+ */
+typedef struct spool_ring_record_t {
+    uint64_t       position; ///< stream position of record
+    const char_t*  name; ///< record name, not null terminated
+    uint64_t       name_length; ///< copied name length
+    const uint8_t* data; ///< record data
+    uint64_t       data_length; ///< copied data length
+    uint64_t       total_data_length; ///< data length at ring, larger than data_length if buffer was small
+} spool_ring_record_t; ///< short hand for struct
+
+/**
+ * @brief builds a spool ring inside a preallocated area, nothing is allocated afterwards
+ * @param[in] area memory area, 64 byte aligned
+ * @param[in] area_size area size
+ * @param[in] policy full ring policy
+ * @return ring at start of area or NULL if area is too small
+ */
+spool_ring_t* spool_ring_create(void* area, uint64_t area_size, spool_ring_policy_t policy);
+
+/**
+ * @brief appends a record, lock free and safe for concurrent producers
+ * @param[in] ring ring
+ * @param[in] name record name
+ * @param[in] data record data
+ * @param[in] length data length
+ * @return 0 on success, -1 if record is dropped
+ */
+int8_t spool_ring_write(spool_ring_t* ring, const char_t* name, const void* data, uint64_t length);
+
+/**
+ * @brief positions cursor at oldest record
+ * @param[in] ring ring
+ * @param[out] cursor cursor
+ * @return 0 on success
+ */
+int8_t spool_ring_cursor_init(spool_ring_t* ring, spool_ring_cursor_t* cursor);
+
+/**
+ * @brief reads next committed record and advances cursor
+ * @details records overwritten while the cursor lags are skipped and counted at cursor's lost_bytes.
+ * @param[in] ring ring
+ * @param[in,out] cursor cursor
+ * @param[out] record record, name and data are copied into buffer
+ * @param[in] buffer copy buffer, data is truncated if it does not fit
+ * @param[in] buffer_size buffer size
+ * @return 0 on success, -1 if there is no record to read
+ */
+int8_t spool_ring_read(spool_ring_t* ring, spool_ring_cursor_t* cursor, spool_ring_record_t* record, uint8_t* buffer, uint64_t buffer_size);
+
+/**
+ * @brief frees space up to cursor for drop newest rings
+ * @param[in] ring ring
+ * @param[in] cursor cursor of consuming reader
+ * @return 0 on success
+ */
+int8_t spool_ring_release(spool_ring_t* ring, const spool_ring_cursor_t* cursor);
+
+/**
+ * @brief returns ring data capacity
+ * @param[in] ring ring
+ * @return capacity in bytes
+ */
+uint64_t spool_ring_get_capacity(spool_ring_t* ring);
+
+/**
+ * @brief returns dropped record count
+ * @param[in] ring ring
+ * @return dropped record count
+ */
+uint64_t spool_ring_get_dropped_count(spool_ring_t* ring);
+
+/**
+ * @brief returns system spool ring carved from spool area at spool_init
+ * @return ring, NULL before spool_init
+ */
+spool_ring_t* spool_get_ring(void);
+
+/**
+ * @brief appends a record to system spool ring without allocating
+ * @param[in] name record name
+ * @param[in] data record data
+ * @param[in] length data length
+ * @return 0 on success
+ */
+int8_t spool_write(const char_t* name, const void* data, uint64_t length);
+
 #ifdef __cplusplus
 }
 #endif
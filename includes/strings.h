@@ -12,6 +12,7 @@
 #include <types.h>
 #include <memory.h>
 #include <sunday_match.h>
+#include <byte_search.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,14 +10,71 @@
 #define ___VARINT_H 0
 
 #include <types.h>
+#include <buffer.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*! maximum encoded size of an uint64_t varint */
+#define VARINT_MAX_SIZE 10
+
+/*! maximum encoded size of count integers with group varint, includes store slack */
+#define varint_group_max_size(count) ((((count) + 3) / 4) * 17)
+
 uint8_t* varint_encode(uint64_t num, int8_t* size);
 uint64_t varint_decode(uint8_t* data, int8_t* size);
 
+/**
+ * @brief returns encoded size of number
+ * @param[in] num number
+ * @return byte count between 1 and @ref VARINT_MAX_SIZE
+ */
+int8_t varint_size(uint64_t num);
+
+/**
+ * @brief encodes number into caller's memory without any allocation
+ * @param[in] num number to encode
+ * @param[out] out destination, at least @ref VARINT_MAX_SIZE bytes or @ref varint_size
+ * @return written byte count
+ */
+int8_t varint_encode_to(uint64_t num, uint8_t* out);
+
+/**
+ * @brief appends encoded number to the buffer
+ * @param[in] buffer destination buffer
+ * @param[in] num number to encode
+ * @return written byte count, -1 on error
+ */
+int8_t varint_encode_to_buffer(buffer_t* buffer, uint64_t num);
+
+/**
+ * @brief reads one encoded number from buffer's current position
+ * @param[in] buffer source buffer
+ * @param[out] size consumed byte count, can be NULL
+ * @return decoded number
+ */
+uint64_t varint_decode_from_buffer(buffer_t* buffer, int8_t* size);
+
+/**
+ * @brief encodes uint32 array with group varint, one tag byte per four integers
+ * @param[in] src integers
+ * @param[in] count integer count
+ * @param[out] out destination, at least @ref varint_group_max_size bytes
+ * @return written byte count
+ */
+uint64_t varint_group_encode_uint32(const uint32_t* src, uint64_t count, uint8_t* out);
+
+/**
+ * @brief decodes group varint encoded uint32 array
+ * @param[in] src encoded data
+ * @param[in] src_length encoded data length, decoding never reads past it
+ * @param[out] out destination integers
+ * @param[in] count integer count
+ * @return consumed byte count, -1ULL if data is short
+ */
+uint64_t varint_group_decode_uint32(const uint8_t* src, uint64_t src_length, uint32_t* out, uint64_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -48,6 +48,7 @@ uint64_t xxhash64_final(xxhash64_context_t* ctx);
 
 /**
  * @brief calculate xxhash64 value
+ * @details one-shot, does not allocate and reads input in place.
  * @param[in] input input data
  * @param[in] length input data length
  * @param[in] seed seed value
@@ -63,6 +64,42 @@ uint64_t xxhash64_hash_with_seed(const void* input, uint64_t length, uint64_t se
  */
 #define xxhash64_hash(i, l) xxhash64_hash_with_seed(i, l, 0)
 
+/**
+ * @brief calculate XXH3 64-bit value
+ * @details one-shot, does not allocate. long inputs use SSE2/AVX2 accumulators when available.
+ * @param[in] input input data
+ * @param[in] length input data length
+ * @param[in] seed seed value
+ * @return XXH3 64-bit value
+ */
+uint64_t xxhash3_64_hash_with_seed(const void* input, uint64_t length, uint64_t seed);
+
+/**
+ * @brief calculate XXH3 64-bit value with seed 0
+ * @param[in] i input data
+ * @param[in] l input data length
+ * @return XXH3 64-bit value
+ */
+#define xxhash3_64_hash(i, l) xxhash3_64_hash_with_seed(i, l, 0)
+
+/**
+ * @brief calculate XXH3 128-bit value
+ * @details one-shot, does not allocate. low 64 bits are the low half of canonical XXH3-128.
+ * @param[in] input input data
+ * @param[in] length input data length
+ * @param[in] seed seed value
+ * @return XXH3 128-bit value
+ */
+uint128_t xxhash3_128_hash_with_seed(const void* input, uint64_t length, uint64_t seed);
+
+/**
+ * @brief calculate XXH3 128-bit value with seed 0
+ * @param[in] i input data
+ * @param[in] l input data length
+ * @return XXH3 128-bit value
+ */
+#define xxhash3_128_hash(i, l) xxhash3_128_hash_with_seed(i, l, 0)
+
 /**
  * @typedef xxhash32_context_t
  * @brief opaque xxhash32 context structure
@@ -0,0 +1,74 @@
+#!/usr/bin/env bash
+
+# This work is licensed under TURNSTONE OS Public License.
+# Please read and understand latest version of Licence.
+
+# Generates a synthetic assembly source and measures tosasm throughput.
+# usage: bench-tosasm.sh [function count] (run after building utils)
+
+BASEDIR="$(dirname "$0")/.."
+TOSASM="${BASEDIR}/build/tosasm.bin"
+FUNCS=${1:-500}
+TMPDIR=$(mktemp -d)
+SRC="${TMPDIR}/bench.s"
+
+if [[ ! -x ${TOSASM} ]]; then
+    echo "${TOSASM} not found, build utils first"
+    exit 1
+fi
+
+regs64=(rax rcx rdx rbx rsi rdi r8 r9 r10 r11 r12 r13 r14 r15)
+regs32=(eax ecx edx ebx esi edi r8d r9d r10d r11d r12d r13d r14d r15d)
+
+{
+    echo ".section .text"
+
+    for ((f = 0; f < FUNCS; f++)); do
+        echo ".globl func_${f}"
+        echo ".type func_${f}, @function"
+        echo "func_${f}:"
+        echo "    pushq %rbp"
+
+        for ((i = 0; i < 40; i++)); do
+            a=${regs64[$(( (f + i) % 14 ))]}
+            b=${regs64[$(( (f * 3 + i * 5) % 14 ))]}
+            c=${regs32[$(( (f + i * 7) % 14 ))]}
+            d=${regs32[$(( (f * 5 + i) % 14 ))]}
+
+            case $(( i % 8 )) in
+                0) echo "    addq %${a}, %${b}" ;;
+                1) echo "    subl \$$(( i * 13 )), %${c}" ;;
+                2) echo "    xorl %${c}, %${d}" ;;
+                3) echo "    cmpq \$$(( f % 100 )), %${a}" ;;
+                4) echo "    leaq $(( (i % 16) * 8 ))(%rbp,%${b},8), %${a}" ;;
+                5) echo "    andq \$0xff, %${b}" ;;
+                6) echo "    addl $(( (i % 16) * 4 ))(%rbp), %${d}" ;;
+                7) echo "    orq %${a}, %${b}" ;;
+            esac
+        done
+
+        echo "    popq %rbp"
+        echo "    ret"
+        echo ".size func_${f}, .-func_${f}"
+    done
+} > "${SRC}"
+
+lines=$(wc -l < "${SRC}")
+bytes=$(wc -c < "${SRC}")
+
+start=$(date +%s%N)
+"${TOSASM}" "${SRC}" "${TMPDIR}/bench.o" > /dev/null 2>&1
+rc=$?
+end=$(date +%s%N)
+
+elapsed_ms=$(( (end - start) / 1000000 ))
+
+if [[ ${rc} -ne 0 ]]; then
+    echo "tosasm failed with ${rc}"
+else
+    echo "tosasm: ${lines} lines ${bytes} bytes in ${elapsed_ms} ms, $(( lines * 1000 / (elapsed_ms + 1) )) lines/s"
+fi
+
+rm -rf "${TMPDIR}"
+
+exit ${rc}
@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+
+# This work is licensed under TURNSTONE OS Public License.
+# Please read and understand latest version of Licence.
+
+# Generates a synthetic pascal source with many variables and nested scopes and measures tospascal throughput.
+# usage: bench-tospascal.sh [block count] [optimization level] (run after building utils)
+
+BASEDIR="$(dirname "$0")/.."
+TOSPASCAL="${TOSPASCAL:-${BASEDIR}/build/tospascal.bin}"
+BLOCKS=${1:-200}
+OPTLEVEL=${2:--O1}
+GLOBALS=64
+TMPDIR=$(mktemp -d)
+SRC="${TMPDIR}/bench.pas"
+
+if [[ ! -x ${TOSPASCAL} ]]; then
+    echo "${TOSPASCAL} not found, build utils first"
+    exit 1
+fi
+
+{
+    echo "program bench;"
+    echo "var"
+
+    for ((g = 0; g < GLOBALS; g++)); do
+        echo "  global_variable_${g} : int64;"
+    done
+
+    echo "begin"
+
+    for ((b = 0; b < BLOCKS; b++)); do
+        echo "  begin"
+        echo "    var"
+
+        locals=""
+
+        for ((l = 0; l < 8; l++)); do
+            locals="${locals}block_${b}_local_${l}, "
+        done
+
+        # shadows a global inside block
+        echo "      ${locals}global_variable_$(( b % GLOBALS )) : int64;"
+        echo "    block_${b}_local_0 := global_variable_$(( (b + 1) % GLOBALS )) + ${b};"
+
+        for ((l = 1; l < 8; l++)); do
+            echo "    block_${b}_local_${l} := block_${b}_local_$(( l - 1 )) + global_variable_$(( (b + l) % GLOBALS ));"
+        done
+
+        echo "    begin"
+        echo "      var"
+        echo "        block_${b}_inner : int64;"
+        echo "      block_${b}_inner := block_${b}_local_7 + global_variable_$(( b % GLOBALS ));"
+        echo "      global_variable_$(( (b + 1) % GLOBALS )) := block_${b}_inner and 255;"
+        echo "    end;"
+        echo "  end;"
+    done
+
+    echo "  bench := global_variable_1 and 255;"
+    echo "end."
+} > "${SRC}"
+
+lines=$(wc -l < "${SRC}")
+bytes=$(wc -c < "${SRC}")
+
+start=$(date +%s%N)
+"${TOSPASCAL}" "${OPTLEVEL}" "${SRC}" "${TMPDIR}/bench.s" > /dev/null 2>&1
+rc=$?
+end=$(date +%s%N)
+
+elapsed_ms=$(( (end - start) / 1000000 ))
+
+if [[ ${rc} -ne 0 ]]; then
+    echo "tospascal failed with ${rc}"
+else
+    echo "tospascal: ${lines} lines ${bytes} bytes in ${elapsed_ms} ms, $(( lines * 1000 / (elapsed_ms + 1) )) lines/s"
+fi
+
+rm -rf "${TMPDIR}"
+
+exit ${rc}
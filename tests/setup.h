@@ -196,7 +196,6 @@ void* KERNEL_FRAME_ALLOCATOR = NULL;
 typedef void            * frame_t;
 typedef int8_t          memory_paging_page_type_t;
 typedef void            * memory_page_table_t;
-typedef struct future_t future_t;
 
 int8_t    memory_paging_add_va_for_frame_ext(memory_page_table_t* p4, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type);
 void      dump_ram(char_t* fname);
@@ -206,8 +205,6 @@ int8_t    lock_destroy(lock_t* lock);
 void      lock_acquire(lock_t* lock);
 void      lock_release(lock_t* lock);
 lock_t*   lock_create_with_heap_for_future(memory_heap_t* heap, boolean_t for_future);
-future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data);
-void*     future_get_data_and_destroy(future_t* fut);
 
 int8_t memory_paging_add_va_for_frame_ext(memory_page_table_t* p4, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type){
     UNUSED(p4);
@@ -245,29 +242,6 @@ void lock_release(lock_t* lock){
     UNUSED(lock);
 }
 
-future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data) {
-    UNUSED(heap);
-    UNUSED(lock);
-
-    if(data) {
-        return data;
-    }
-
-    return (void*)0xdeadbeaf;
-}
-
-void* future_get_data_and_destroy(future_t* fut) {
-    if(!fut) {
-        return NULL;
-    }
-
-    if(((uint64_t)fut) == 0xdeadbeaf) {
-        return NULL;
-    }
-
-    return fut;
-}
-
 struct timespec {
     int64_t tv_sec;
     int64_t tv_nsec;
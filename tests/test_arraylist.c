@@ -0,0 +1,326 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x2000000
+#include "setup.h"
+#include <list.h>
+#include <random.h>
+
+#define TEST_VALUE_COUNT 4096ULL
+#define TEST_OP_COUNT    100000ULL
+#define TEST_BENCH_COUNT 100000ULL
+
+int32_t main(uint32_t argc, char_t** argv);
+
+static uint64_t test_values[TEST_VALUE_COUNT];
+
+static const void* test_model[TEST_OP_COUNT];
+static size_t      test_model_count;
+
+static void test_model_insert(size_t position, const void* data) {
+    for(size_t i = test_model_count; i > position; i--) {
+        test_model[i] = test_model[i - 1];
+    }
+
+    test_model[position] = data;
+    test_model_count++;
+}
+
+static const void* test_model_delete(size_t position) {
+    if(position >= test_model_count) {
+        return NULL;
+    }
+
+    const void* res = test_model[position];
+
+    for(size_t i = position + 1; i < test_model_count; i++) {
+        test_model[i - 1] = test_model[i];
+    }
+
+    test_model_count--;
+
+    return res;
+}
+
+static size_t test_model_find(const void* data) {
+    for(size_t i = 0; i < test_model_count; i++) {
+        if(*(const uint64_t*)test_model[i] == *(const uint64_t*)data) {
+            return i;
+        }
+    }
+
+    return -1ULL;
+}
+
+static size_t test_model_lower_bound(const void* data) {
+    size_t i = 0;
+
+    while(i < test_model_count && *(const uint64_t*)test_model[i] < *(const uint64_t*)data) {
+        i++;
+    }
+
+    return i;
+}
+
+static int8_t test_compare_list(list_t* list) {
+    if(list_size(list) != test_model_count) {
+        print_error("size mismatch");
+        return -1;
+    }
+
+    for(size_t i = 0; i < test_model_count; i++) {
+        if(list_get_data_at_position(list, i) != test_model[i]) {
+            printf("position %lli mismatch\n", i);
+            print_error("data mismatch");
+            return -1;
+        }
+    }
+
+    iterator_t* iter = list_iterator_create(list);
+    size_t pos = 0;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        if(pos >= test_model_count || iter->get_item(iter) != test_model[pos]) {
+            iter->destroy(iter);
+            print_error("iteration mismatch");
+            return -1;
+        }
+
+        pos++;
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(pos != test_model_count) {
+        print_error("iteration ended early");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int8_t test_random_ops(list_type_t type) {
+    list_t* list = list_create_with_type(NULL, type | LIST_TYPE_ARRAY, NULL, NULL);
+
+    if(list == NULL) {
+        print_error("cannot create list");
+        return -1;
+    }
+
+    test_model_count = 0;
+
+    for(size_t i = 0; i < TEST_OP_COUNT; i++) {
+        const void* value = &test_values[rand() % TEST_VALUE_COUNT];
+        uint32_t op = rand() % 8;
+        size_t position = rand() % (test_model_count + 1);
+        size_t expected_pos = 0, pos = 0;
+        const void* expected = NULL;
+        const void* res = NULL;
+
+        if(type & LIST_TYPE_SORTEDLIST) {
+            if(op < 4) {
+                expected_pos = test_model_lower_bound(value);
+                test_model_insert(expected_pos, value);
+                pos = list_sortedlist_insert(list, value);
+            } else if(op < 6) {
+                expected_pos = test_model_find(value);
+
+                if(expected_pos != -1ULL) {
+                    expected = test_model_delete(expected_pos);
+                }
+
+                expected_pos = 0;
+                res = list_sortedlist_delete(list, value);
+            } else {
+                expected_pos = test_model_find(value);
+
+                if(list_get_position(list, value, &pos) != 0) {
+                    pos = -1ULL;
+                }
+            }
+        } else {
+            switch(op) {
+            case 0:
+                expected_pos = test_model_count;
+                test_model_insert(expected_pos, value);
+                pos = list_queue_push(list, value);
+                break;
+            case 1:
+                test_model_insert(0, value);
+                pos = list_stack_push(list, value);
+                break;
+            case 2:
+                expected_pos = position;
+                test_model_insert(expected_pos, value);
+                pos = list_insert_at_position(list, value, position);
+                break;
+            case 3:
+                expected = test_model_delete(0);
+                res = list_queue_pop(list);
+                break;
+            case 4:
+                expected = test_model_count ? test_model_delete(test_model_count - 1) : NULL;
+                res = list_delete_at_tail(list);
+                break;
+            case 5:
+                expected = test_model_delete(position);
+                res = list_delete_at_position(list, position);
+                break;
+            case 6:
+                expected_pos = test_model_find(value);
+
+                if(expected_pos != -1ULL) {
+                    expected = test_model_delete(expected_pos);
+                }
+
+                expected_pos = 0;
+                res = list_list_delete(list, value);
+                break;
+            default:
+                expected_pos = test_model_find(value) == -1ULL ? -1ULL : 0;
+                pos = list_contains(list, value) == 0 ? 0 : -1ULL;
+                break;
+            }
+        }
+
+        if(pos != expected_pos || res != expected) {
+            printf("op %lli at %lli: %lli %lli\n", (int64_t)op, i, pos, expected_pos);
+            print_error("operation result mismatch");
+            return -1;
+        }
+
+        if((i % 997) == 0 && test_compare_list(list) != 0) {
+            return -1;
+        }
+    }
+
+    if(test_compare_list(list) != 0) {
+        return -1;
+    }
+
+    // delete every odd value with iterator from both list and model
+    iterator_t* iter = list_iterator_create(list);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        if(*(const uint64_t*)iter->get_item(iter) & 1) {
+            iter->delete_item(iter);
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    size_t model_pos = 0;
+
+    while(model_pos < test_model_count) {
+        if(*(const uint64_t*)test_model[model_pos] & 1) {
+            test_model_delete(model_pos);
+        } else {
+            model_pos++;
+        }
+    }
+
+    if(test_compare_list(list) != 0) {
+        return -1;
+    }
+
+    list_t* dup = list_duplicate_list(list);
+
+    if(dup == NULL || test_compare_list(dup) != 0) {
+        print_error("duplicate mismatch");
+        return -1;
+    }
+
+    list_destroy(dup);
+    list_destroy(list);
+
+    return 0;
+}
+
+static void test_benchmark(list_type_t type) {
+    const char_t* name = (type & LIST_TYPE_ARRAY) ? "array" : "linked";
+    list_t* list = list_create_with_type(NULL, LIST_TYPE_QUEUE | type, NULL, NULL);
+
+    uint64_t start = time_ns(NULL);
+
+    for(size_t i = 0; i < TEST_BENCH_COUNT; i++) {
+        list_queue_push(list, &test_values[i % TEST_VALUE_COUNT]);
+    }
+
+    while(list_size(list)) {
+        list_queue_pop(list);
+    }
+
+    uint64_t end = time_ns(NULL);
+
+    printf("%s queue push/pop %lli items: %lli ms\n", name, TEST_BENCH_COUNT, (end - start) / 1000000);
+
+    for(size_t i = 0; i < TEST_VALUE_COUNT; i++) {
+        list_queue_push(list, &test_values[i]);
+    }
+
+    uint64_t sum = 0;
+
+    start = time_ns(NULL);
+
+    for(size_t i = 0; i < TEST_VALUE_COUNT; i++) {
+        sum += *(uint64_t*)list_get_data_at_position(list, (i * 7919) % TEST_VALUE_COUNT);
+    }
+
+    end = time_ns(NULL);
+
+    printf("%s indexed access %lli items: %lli ms (%lli)\n", name, TEST_VALUE_COUNT, (end - start) / 1000000, sum);
+
+    list_destroy(list);
+
+    list = list_create_with_type(NULL, LIST_TYPE_SORTEDLIST | type, NULL, NULL);
+
+    start = time_ns(NULL);
+
+    for(size_t i = 0; i < TEST_VALUE_COUNT * 4; i++) {
+        list_sortedlist_insert(list, &test_values[rand() % TEST_VALUE_COUNT]);
+    }
+
+    end = time_ns(NULL);
+
+    printf("%s sorted insert %lli items: %lli ms\n", name, TEST_VALUE_COUNT * 4, (end - start) / 1000000);
+
+    list_destroy(list);
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    for(uint64_t i = 0; i < TEST_VALUE_COUNT; i++) {
+        test_values[i] = i;
+    }
+
+    if(list_create_with_type(NULL, LIST_TYPE_INDEXEDLIST | LIST_TYPE_ARRAY, NULL, NULL) != NULL) {
+        print_error("indexed array list should not be created");
+        return -1;
+    }
+
+    if(test_random_ops(LIST_TYPE_LIST) != 0) {
+        return -1;
+    }
+
+    print_success("list ops OK");
+
+    if(test_random_ops(LIST_TYPE_SORTEDLIST) != 0) {
+        return -1;
+    }
+
+    print_success("sorted list ops OK");
+
+    test_benchmark(LIST_TYPE_ARRAY);
+    test_benchmark(LIST_TYPE_LINKED);
+
+    print_success("TESTS PASSED");
+
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x10000000
+#include "setup.h"
+#include <memory.h>
+#include <buffer.h>
+#include <compiler/asm_parser.h>
+#include <compiler/asm_encoder.h>
+#include <compiler/asm_instructions.h>
+#include <xxhash.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_FUNC_COUNT   500ULL
+#define TEST_FUNC_LENGTH  40ULL
+
+int32_t main(uint32_t argc, char_t** argv);
+
+static const char_t* test_regs64[] = {"rax", "rcx", "rdx", "rbx", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+static const char_t* test_regs32[] = {"eax", "ecx", "edx", "ebx", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+
+static boolean_t test_emit(asm_encoder_ctx_t* ctx, const char_t* mnemonic, uint8_t operand_size, asm_instruction_ir_t* ir) {
+    ir->mnemonic = mnemonic;
+    ir->operand_size = operand_size;
+
+    boolean_t res = asm_encode_ir(ctx, ir);
+
+    memory_memclean(ir, sizeof(asm_instruction_ir_t));
+
+    return res;
+}
+
+/**
+ * @brief generates the same code as scripts/bench-tosasm.sh without source text
+ * @param[in] ctx encoder context
+ * @return true on success
+ */
+static boolean_t test_generate(asm_encoder_ctx_t* ctx) {
+    boolean_t ok = asm_encoder_switch_section(ctx, ".text") != NULL;
+    asm_instruction_ir_t ir = {0};
+
+    for(uint64_t f = 0; f < TEST_FUNC_COUNT && ok; f++) {
+        char_t* num = utoa(f);
+        char_t* func_name = strcat("func_", num);
+
+        ok &= asm_encoder_define_label(ctx, func_name);
+        memory_free(func_name);
+        memory_free(num);
+
+        ir.param_count = 1;
+        ok &= asm_instruction_ir_set_register(&ir.params[0], "rbp");
+        ok &= test_emit(ctx, "push", 64, &ir);
+
+        for(uint64_t i = 0; i < TEST_FUNC_LENGTH && ok; i++) {
+            const char_t* a = test_regs64[(f + i) % 14];
+            const char_t* b = test_regs64[(f * 3 + i * 5) % 14];
+            const char_t* c = test_regs32[(f + i * 7) % 14];
+            const char_t* d = test_regs32[(f * 5 + i) % 14];
+
+            ir.param_count = 2;
+
+            switch(i % 8) {
+            case 0:
+                ok &= asm_instruction_ir_set_register(&ir.params[0], a);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], b);
+                ok &= test_emit(ctx, "add", 64, &ir);
+                break;
+            case 1:
+                ok &= asm_instruction_ir_set_immediate(&ir.params[0], i * 13, NULL);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], c);
+                ok &= test_emit(ctx, "sub", 32, &ir);
+                break;
+            case 2:
+                ok &= asm_instruction_ir_set_register(&ir.params[0], c);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], d);
+                ok &= test_emit(ctx, "xor", 32, &ir);
+                break;
+            case 3:
+                ok &= asm_instruction_ir_set_immediate(&ir.params[0], f % 100, NULL);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], a);
+                ok &= test_emit(ctx, "cmp", 64, &ir);
+                break;
+            case 4:
+                ok &= asm_instruction_ir_set_memory(&ir.params[0], "rbp", b, 8, (i % 16) * 8, NULL);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], a);
+                ok &= test_emit(ctx, "lea", 64, &ir);
+                break;
+            case 5:
+                ok &= asm_instruction_ir_set_immediate(&ir.params[0], 0xff, NULL);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], b);
+                ok &= test_emit(ctx, "and", 64, &ir);
+                break;
+            case 6:
+                ok &= asm_instruction_ir_set_memory(&ir.params[0], "rbp", NULL, 0, (i % 16) * 4, NULL);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], d);
+                ok &= test_emit(ctx, "add", 32, &ir);
+                break;
+            case 7:
+                ok &= asm_instruction_ir_set_register(&ir.params[0], a);
+                ok &= asm_instruction_ir_set_register(&ir.params[1], b);
+                ok &= test_emit(ctx, "or", 64, &ir);
+                break;
+            }
+        }
+
+        ir.param_count = 1;
+        ok &= asm_instruction_ir_set_register(&ir.params[0], "rbp");
+        ok &= test_emit(ctx, "pop", 64, &ir);
+
+        ok &= test_emit(ctx, "ret", 0, &ir);
+    }
+
+    return ok;
+}
+
+static uint8_t* test_get_text(asm_encoder_ctx_t* ctx, uint64_t* length) {
+    asm_section_t* section = (asm_section_t*)hashmap_get(ctx->sections, ".text");
+
+    if(!section) {
+        *length = 0;
+
+        return NULL;
+    }
+
+    return buffer_get_all_bytes(section->data, length);
+}
+
+static boolean_t test_direct_vs_text(void) {
+    boolean_t pass = true;
+
+    // direct emission with listing
+    asm_encoder_ctx_t* ctx = memory_malloc(sizeof(asm_encoder_ctx_t));
+    ctx->listing = buffer_new();
+
+    if(!test_generate(ctx)) {
+        print_error("cannot generate code with listing");
+        pass = false;
+    }
+
+    uint64_t listed_len = 0;
+    uint8_t* listed_code = test_get_text(ctx, &listed_len);
+
+    // listing through parser and encoder, as code generators emitting text do
+    uint64_t listing_len = 0;
+    uint8_t* listing = buffer_get_all_bytes(ctx->listing, &listing_len);
+
+    buffer_destroy(ctx->listing);
+    asm_encoder_destroy_context(ctx);
+
+    uint64_t start = time_ns(NULL);
+
+    buffer_t* inbuf = buffer_encapsulate(listing, listing_len);
+    list_t* tokens = asm_parser_parse(inbuf);
+    buffer_destroy(inbuf);
+
+    ctx = memory_malloc(sizeof(asm_encoder_ctx_t));
+    ctx->tokens = tokens;
+
+    if(!asm_encode_instructions(ctx)) {
+        print_error("cannot encode listing");
+        pass = false;
+    }
+
+    uint64_t text_elapsed = time_ns(NULL) - start;
+
+    asm_parser_destroy_tokens(tokens);
+
+    uint64_t text_len = 0;
+    uint8_t* text_code = test_get_text(ctx, &text_len);
+
+    asm_encoder_destroy_context(ctx);
+
+    // direct emission only
+    memory_heap_stat_t stat_before = {0};
+    memory_get_heap_stat(&stat_before);
+
+    start = time_ns(NULL);
+
+    ctx = memory_malloc(sizeof(asm_encoder_ctx_t));
+
+    if(!test_generate(ctx)) {
+        print_error("cannot generate code");
+        pass = false;
+    }
+
+    uint64_t direct_elapsed = time_ns(NULL) - start;
+
+    memory_heap_stat_t stat_after = {0};
+    memory_get_heap_stat(&stat_after);
+
+    uint64_t direct_len = 0;
+    uint8_t* direct_code = test_get_text(ctx, &direct_len);
+
+    asm_encoder_destroy_context(ctx);
+
+    if(!listed_code || !text_code || !direct_code ||
+       listed_len != direct_len || text_len != direct_len ||
+       memory_memcompare(listed_code, direct_code, direct_len) != 0 ||
+       memory_memcompare(text_code, direct_code, direct_len) != 0) {
+        printf("direct %lli listed %lli text %lli bytes\n", direct_len, listed_len, text_len);
+        print_error("direct and text encodings differ");
+        pass = false;
+    }
+
+    printf("%lli instructions, %lli bytes of code, %lli bytes of listing\n",
+           TEST_FUNC_COUNT * (TEST_FUNC_LENGTH + 3), direct_len, listing_len);
+    printf("text parse and encode %lli ms, direct encode %lli ms, direct encode mallocs %lli\n",
+           text_elapsed / 1000000, direct_elapsed / 1000000, stat_after.malloc_count - stat_before.malloc_count);
+
+    memory_free(listing);
+    memory_free(listed_code);
+    memory_free(text_code);
+    memory_free(direct_code);
+
+    return pass;
+}
+
+static boolean_t test_print(void) {
+    boolean_t pass = true;
+    asm_instruction_ir_t ir = {.mnemonic = "lea", .operand_size = 64, .param_count = 2};
+
+    asm_instruction_ir_set_memory(&ir.params[0], "rbp", "rcx", 8, 16, NULL);
+    asm_instruction_ir_set_register(&ir.params[1], "r10");
+
+    buffer_t* buf = buffer_new();
+    asm_instruction_ir_print(&ir, buf);
+
+    ir.mnemonic = "sub";
+    ir.operand_size = 32;
+    asm_instruction_ir_set_immediate(&ir.params[0], 0x2a, NULL);
+    asm_instruction_ir_set_register(&ir.params[1], "r8d");
+    asm_instruction_ir_print(&ir, buf);
+
+    buffer_append_byte(buf, 0);
+
+    uint64_t len = 0;
+    char_t* out = (char_t*)buffer_get_all_bytes(buf, &len);
+
+    buffer_destroy(buf);
+
+    if(strcmp(out, "\tleaq 16(%rbp,%rcx,8), %r10\n\tsubl $0x2A, %r8d\n") != 0) {
+        printf("%s", out);
+        print_error("listing mismatch");
+        pass = false;
+    }
+
+    memory_free(out);
+
+    if(asm_instruction_ir_set_register(&ir.params[0], "xyz")) {
+        print_error("unknown register accepted");
+        pass = false;
+    }
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    // first error log allocates error buffer, so leaks are counted after it
+    pass &= test_print();
+
+    memory_heap_stat_t stat_before = {0};
+    memory_get_heap_stat(&stat_before);
+
+    pass &= test_direct_vs_text();
+
+    memory_heap_stat_t stat_after = {0};
+    memory_get_heap_stat(&stat_after);
+
+    if(stat_after.malloc_count - stat_before.malloc_count != stat_after.free_count - stat_before.free_count) {
+        printf("malloc %lli free %lli\n", stat_after.malloc_count - stat_before.malloc_count,
+               stat_after.free_count - stat_before.free_count);
+        print_error("memory leak");
+        pass = false;
+    }
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
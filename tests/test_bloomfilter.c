@@ -3,6 +3,7 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE 0x1000000
 #include "setup.h"
 #include <math.h>
 #include <xxhash.h>
@@ -13,8 +14,152 @@
 #include <strings.h>
 #include <buffer.h>
 
+#define TEST_ENTRY_COUNT 100000ULL
+
 int32_t main(uint32_t argc, char_t** argv);
 
+static boolean_t test_rate(float64_t error) {
+    bloomfilter_t* bf = bloomfilter_new(TEST_ENTRY_COUNT, error);
+
+    if(!bf) {
+        print_error("cannot create bloom filter");
+        return false;
+    }
+
+    data_t d = {0};
+    d.type = DATA_TYPE_INT8_ARRAY;
+    d.length = sizeof(uint64_t);
+
+    uint64_t key = 0;
+    d.value = &key;
+
+    uint64_t start = time_ns(NULL);
+
+    for(key = 0; key < TEST_ENTRY_COUNT; key++) {
+        bloomfilter_add(bf, &d);
+    }
+
+    uint64_t add_end = time_ns(NULL);
+
+    for(key = 0; key < TEST_ENTRY_COUNT; key++) {
+        if(!bloomfilter_check(bf, &d)) {
+            print_error("added key not found");
+            bloomfilter_destroy(bf);
+            return false;
+        }
+    }
+
+    uint64_t positive_end = time_ns(NULL);
+
+    uint64_t false_positives = 0;
+
+    for(key = TEST_ENTRY_COUNT; key < TEST_ENTRY_COUNT * 2; key++) {
+        if(bloomfilter_check(bf, &d)) {
+            false_positives++;
+        }
+    }
+
+    uint64_t negative_end = time_ns(NULL);
+
+    float64_t fpr = (float64_t)false_positives / (float64_t)TEST_ENTRY_COUNT;
+
+    printf("error 1/%lli: false positives %lli/%lli add %lli ns/op positive %lli ns/op negative %lli ns/op\n",
+           (uint64_t)(1.0 / error), false_positives, TEST_ENTRY_COUNT,
+           (add_end - start) / TEST_ENTRY_COUNT,
+           (positive_end - add_end) / TEST_ENTRY_COUNT,
+           (negative_end - positive_end) / TEST_ENTRY_COUNT);
+
+    bloomfilter_destroy(bf);
+
+    // sizing meets error analytically, slack only covers sampling noise of measured rate
+    if(fpr > error * 1.05 + 0.001) {
+        print_error("false positive rate is too high");
+        return false;
+    }
+
+    return true;
+}
+
+static boolean_t test_legacy(void) {
+    uint64_t bit_count = 1024;
+    uint64_t hash_count = 4;
+    uint64_t seed = 0x1234;
+    uint64_t bits[16] = {0};
+
+    const char_t* keys[] = {"first", "second", "third"};
+
+    for(uint64_t k = 0; k < 3; k++) {
+        uint64_t a = xxhash64_hash_with_seed(keys[k], strlen(keys[k]), seed);
+        uint64_t b = xxhash64_hash_with_seed(keys[k], strlen(keys[k]), a);
+
+        for(uint64_t i = 0; i < hash_count; i++) {
+            uint64_t x = (a + b * i) % bit_count;
+            bits[x / 64] |= 1ULL << (x % 64);
+        }
+    }
+
+    data_t fields[7] = {0};
+
+    fields[0].type = DATA_TYPE_INT64;
+    fields[0].value = (void*)3;
+    fields[1].type = DATA_TYPE_FLOAT64;
+    fields[2].type = DATA_TYPE_FLOAT64;
+    fields[3].type = DATA_TYPE_INT64;
+    fields[3].value = (void*)hash_count;
+    fields[4].type = DATA_TYPE_INT64;
+    fields[4].value = (void*)seed;
+    fields[5].type = DATA_TYPE_INT64;
+    fields[5].value = (void*)bit_count;
+    fields[6].type = DATA_TYPE_INT64_ARRAY;
+    fields[6].value = bits;
+    fields[6].length = 16;
+
+    data_t d = {0};
+    d.type = DATA_TYPE_DATA;
+    d.length = 7;
+    d.value = fields;
+
+    data_t* sbf = data_bson_serialize(&d);
+
+    if(!sbf) {
+        print_error("cannot serialize legacy bloom filter");
+        return false;
+    }
+
+    bloomfilter_t* bf = bloomfilter_deserialize(sbf);
+
+    memory_free(sbf->value);
+    memory_free(sbf);
+
+    if(!bf) {
+        print_error("cannot deserialize legacy bloom filter");
+        return false;
+    }
+
+    boolean_t pass = true;
+
+    for(uint64_t k = 0; k < 3; k++) {
+        data_t key = {0};
+        key.type = DATA_TYPE_INT8_ARRAY;
+        key.value = (void*)keys[k];
+        key.length = strlen(keys[k]);
+
+        if(!bloomfilter_check(bf, &key)) {
+            print_error("cannot find value at legacy bf");
+            pass = false;
+        }
+    }
+
+    if(bloomfilter_serialize(bf) != NULL) {
+        print_error("legacy bf should not be serialized");
+        pass = false;
+    }
+
+    bloomfilter_destroy(bf);
+
+    return pass;
+}
+
 int32_t main(uint32_t argc, char_t** argv) {
     UNUSED(argc);
     UNUSED(argv);
@@ -75,6 +220,14 @@ int32_t main(uint32_t argc, char_t** argv) {
 
     bloomfilter_destroy(bf);
 
+    if(!test_legacy()) {
+        pass = false;
+    }
+
+    if(!test_rate(0.1) || !test_rate(0.01) || !test_rate(0.001)) {
+        pass = false;
+    }
+
     if(pass) {
         print_success("TESTS PASSED");
     } else {
@@ -0,0 +1,514 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+#define RAMSIZE (256 << 20)
+#include "setup.h"
+#include <bplustree.h>
+#include <random.h>
+#include <strings.h>
+
+int32_t main(uint32_t argc, char_t** argv);
+int8_t  key_comparator(const void* i, const void* j);
+int8_t  string_comparator(const void* i, const void* j);
+
+int8_t key_comparator(const void* i, const void* j){
+    int64_t t_i = (int64_t)i;
+    int64_t t_j = (int64_t)j;
+
+    if(t_i < t_j) {
+        return -1;
+    }
+
+    if(t_i > t_j) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int8_t string_comparator(const void* i, const void* j){
+    int8_t res = strcmp(i, j);
+
+    if(res < 0) {
+        return -1;
+    }
+
+    if(res > 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint64_t string_key_prefix(const void* key) {
+    const uint8_t* s = key;
+    uint64_t prefix = 0;
+    uint64_t i = 0;
+
+    for(; i < 8 && s[i]; i++) {
+        prefix = (prefix << 8) | s[i];
+    }
+
+    return prefix << ((8 - i) * 8);
+}
+
+#define TEST_KEY_SPACE 512
+
+static int8_t test_check_model(index_t* idx, const boolean_t* model, uint64_t model_size) {
+    if(idx->size(idx) != model_size) {
+        print_error("size mismatch");
+
+        return -1;
+    }
+
+    iterator_t* iter = idx->create_iterator(idx);
+    int64_t expected = 0;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        int64_t key = (int64_t)iter->get_extra_data(iter);
+
+        while(expected < TEST_KEY_SPACE && !model[expected]) {
+            expected++;
+        }
+
+        if(key != expected || (int64_t)iter->get_item(iter) != key + 1) {
+            print_error("iteration mismatch");
+            iter->destroy(iter);
+
+            return -1;
+        }
+
+        expected++;
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    while(expected < TEST_KEY_SPACE && !model[expected]) {
+        expected++;
+    }
+
+    if(expected != TEST_KEY_SPACE) {
+        print_error("iteration ended early");
+
+        return -1;
+    }
+
+    for(int64_t k = 0; k < TEST_KEY_SPACE; k++) {
+        if(idx->contains(idx, (void*)k) != model[k]) {
+            print_error("contains mismatch");
+
+            return -1;
+        }
+
+        if((int64_t)idx->find(idx, (void*)k) != (model[k] ? k + 1 : 0)) {
+            print_error("find mismatch");
+
+            return -1;
+        }
+    }
+
+    for(index_key_search_criteria_t c = INDEXER_KEY_COMPARATOR_CRITERIA_LESS; c <= INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN; c++) {
+        int64_t key1 = rand() % TEST_KEY_SPACE;
+        int64_t key2 = key1 + rand() % 64;
+
+        iter = idx->search(idx, (void*)key1, (void*)key2, c);
+
+        for(int64_t k = 0; k < TEST_KEY_SPACE; k++) {
+            boolean_t match = false;
+
+            switch(c) {
+            case INDEXER_KEY_COMPARATOR_CRITERIA_LESS:
+                match = k < key1;
+                break;
+            case INDEXER_KEY_COMPARATOR_CRITERIA_LESSOREQUAL:
+                match = k <= key1;
+                break;
+            case INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL:
+                match = k == key1;
+                break;
+            case INDEXER_KEY_COMPARATOR_CRITERIA_EQUALORGREATER:
+                match = k >= key1;
+                break;
+            case INDEXER_KEY_COMPARATOR_CRITERIA_GREATER:
+                match = k > key1;
+                break;
+            case INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN:
+                match = k >= key1 && k <= key2;
+                break;
+            default:
+                break;
+            }
+
+            if(!match || !model[k]) {
+                continue;
+            }
+
+            if(iter->end_of_iterator(iter) == 0 || (int64_t)iter->get_extra_data(iter) != k) {
+                print_error("search mismatch");
+                iter->destroy(iter);
+
+                return -1;
+            }
+
+            iter = iter->next(iter);
+        }
+
+        if(iter->end_of_iterator(iter) != 0) {
+            print_error("search returned extra items");
+            iter->destroy(iter);
+
+            return -1;
+        }
+
+        iter->destroy(iter);
+    }
+
+    return 0;
+}
+
+static int8_t test_random_ops(uint64_t max_key_count) {
+    index_t* idx = bplustree_create_index_with_unique(max_key_count, key_comparator, true);
+
+    if(idx == NULL) {
+        print_error("b+ tree can not created");
+
+        return -1;
+    }
+
+    boolean_t* model = memory_malloc(sizeof(boolean_t) * TEST_KEY_SPACE);
+    uint64_t model_size = 0;
+    int8_t res = 0;
+
+    for(uint64_t i = 0; i < 20000 && res == 0; i++) {
+        int64_t key = rand() % TEST_KEY_SPACE;
+
+        if(rand() % 3) {
+            void* removed = NULL;
+
+            idx->insert(idx, (void*)key, (void*)(key + 1), &removed);
+
+            if(model[key] != (removed != NULL)) {
+                print_error("insert removed data mismatch");
+                res = -1;
+            }
+
+            if(!model[key]) {
+                model_size++;
+            }
+
+            model[key] = true;
+        } else {
+            void* deleted = NULL;
+            int8_t d_res = idx->delete(idx, (void*)key, &deleted);
+
+            if((d_res == 0) != model[key] || (model[key] && (int64_t)deleted != key + 1)) {
+                print_error("delete mismatch");
+                res = -1;
+            }
+
+            if(model[key]) {
+                model_size--;
+            }
+
+            model[key] = false;
+        }
+
+        if(i % 997 == 0 && res == 0) {
+            res = test_check_model(idx, model, model_size);
+        }
+    }
+
+    if(res == 0) {
+        res = test_check_model(idx, model, model_size);
+    }
+
+    // drain everything so root collapse paths run
+    for(int64_t k = 0; k < TEST_KEY_SPACE && res == 0; k++) {
+        if(model[k]) {
+            if(idx->delete(idx, (void*)k, NULL) != 0) {
+                print_error("drain delete failed");
+                res = -1;
+            }
+
+            model[k] = false;
+            model_size--;
+        }
+    }
+
+    if(res == 0) {
+        res = test_check_model(idx, model, model_size);
+    }
+
+    memory_free(model);
+    bplustree_destroy_index(idx);
+
+    return res;
+}
+
+static int8_t test_bulk_load(uint64_t max_key_count, uint64_t count) {
+    index_t* idx = bplustree_create_index_with_unique(max_key_count, key_comparator, true);
+
+    if(idx == NULL) {
+        print_error("b+ tree can not created");
+
+        return -1;
+    }
+
+    const void** keys = memory_malloc(sizeof(void*) * (count + 1));
+    const void** datas = memory_malloc(sizeof(void*) * (count + 1));
+
+    for(uint64_t i = 0; i < count; i++) {
+        keys[i] = (void*)(i * 2);
+        datas[i] = (void*)(i * 2 + 1);
+    }
+
+    int8_t res = 0;
+
+    if(count > 1) {
+        keys[count] = keys[0];
+
+        if(bplustree_bulk_load(idx, keys + 1, datas, count) != -1) {
+            print_error("unsorted bulk load accepted");
+            res = -1;
+        }
+    }
+
+    if(res == 0 && bplustree_bulk_load(idx, keys, datas, count) != 0) {
+        print_error("bulk load failed");
+        res = -1;
+    }
+
+    if(res == 0 && idx->size(idx) != count) {
+        print_error("bulk load size mismatch");
+        res = -1;
+    }
+
+    for(uint64_t i = 0; i < count && res == 0; i++) {
+        if((uint64_t)idx->find(idx, (void*)(i * 2)) != i * 2 + 1 || idx->contains(idx, (void*)(i * 2 + 1))) {
+            print_error("bulk load find mismatch");
+            res = -1;
+        }
+    }
+
+    // tree must stay a valid b+ tree for updates after bulk load
+    for(uint64_t i = 0; i < count && res == 0; i++) {
+        if(i % 2) {
+            res = idx->delete(idx, (void*)(i * 2), NULL);
+        } else {
+            res = idx->insert(idx, (void*)(i * 2 + 1), (void*)(i * 2 + 2), NULL);
+        }
+    }
+
+    if(res == 0) {
+        iterator_t* iter = idx->create_iterator(idx);
+        uint64_t item_count = 0;
+        int64_t prev = -1;
+
+        while(iter->end_of_iterator(iter) != 0) {
+            int64_t key = (int64_t)iter->get_extra_data(iter);
+
+            if(key <= prev || (int64_t)iter->get_item(iter) != key + 1) {
+                print_error("bulk load iteration mismatch");
+                res = -1;
+
+                break;
+            }
+
+            prev = key;
+            item_count++;
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+
+        if(res == 0 && item_count != idx->size(idx)) {
+            print_error("bulk load iteration count mismatch");
+            res = -1;
+        }
+    }
+
+    memory_free(keys);
+    memory_free(datas);
+    bplustree_destroy_index(idx);
+
+    return res;
+}
+
+static int8_t test_key_prefix(void) {
+    index_t* idx = bplustree_create_index_with_unique(16, string_comparator, true);
+
+    if(idx == NULL || bplustree_set_key_prefix(idx, string_key_prefix) != 0) {
+        print_error("b+ tree with key prefix can not created");
+
+        return -1;
+    }
+
+    const uint64_t count = 2000;
+    char_t** keys = memory_malloc(sizeof(char_t*) * count);
+    int8_t res = 0;
+
+    for(uint64_t i = 0; i < count; i++) {
+        // half of the keys share a prefix longer than 8 bytes to exercise comparator fallback
+        char_t* num = itoa(rand() % 100000);
+        keys[i] = strcat((i % 2) ? "common/prefix/" : "k", num);
+        memory_free(num);
+
+        void* removed = NULL;
+        idx->insert(idx, keys[i], keys[i], &removed);
+    }
+
+    for(uint64_t i = 0; i < count && res == 0; i++) {
+        const char_t* found = idx->find(idx, keys[i]);
+
+        if(found == NULL || strcmp(found, keys[i]) != 0) {
+            print_error("prefix find mismatch");
+            res = -1;
+        }
+    }
+
+    iterator_t* iter = idx->create_iterator(idx);
+    const char_t* prev = NULL;
+
+    while(res == 0 && iter->end_of_iterator(iter) != 0) {
+        const char_t* key = iter->get_extra_data(iter);
+
+        if(prev && strcmp(prev, key) >= 0) {
+            print_error("prefix iteration order mismatch");
+            res = -1;
+        }
+
+        prev = key;
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    bplustree_destroy_index(idx);
+
+    for(uint64_t i = 0; i < count; i++) {
+        memory_free(keys[i]);
+    }
+
+    memory_free(keys);
+
+    return res;
+}
+
+static int8_t test_benchmark(uint64_t count) {
+    int64_t* random_keys = memory_malloc(sizeof(int64_t) * count);
+    const void** sorted_keys = memory_malloc(sizeof(void*) * count);
+
+    for(uint64_t i = 0; i < count; i++) {
+        random_keys[i] = ((int64_t)rand() << 20) ^ rand();
+        sorted_keys[i] = (void*)i;
+    }
+
+    uint64_t start;
+    index_t* idx;
+
+    idx = bplustree_create_index_with_unique(32, key_comparator, true);
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < count; i++) {
+        idx->insert(idx, (void*)random_keys[i], (void*)random_keys[i], NULL);
+    }
+
+    uint64_t random_insert_time = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(idx->find(idx, (void*)random_keys[i]) != (void*)random_keys[i]) {
+            print_error("benchmark find mismatch");
+        }
+    }
+
+    uint64_t search_time = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    iterator_t* iter = idx->create_iterator(idx);
+    uint64_t item_count = 0;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        item_count++;
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    uint64_t iterate_time = time_ns(NULL) - start;
+
+    bplustree_destroy_index(idx);
+
+    idx = bplustree_create_index_with_unique(32, key_comparator, true);
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < count; i++) {
+        idx->insert(idx, sorted_keys[i], sorted_keys[i], NULL);
+    }
+
+    uint64_t sorted_insert_time = time_ns(NULL) - start;
+
+    bplustree_destroy_index(idx);
+
+    idx = bplustree_create_index_with_unique(32, key_comparator, true);
+    start = time_ns(NULL);
+    bplustree_bulk_load(idx, sorted_keys, sorted_keys, count);
+    uint64_t bulk_load_time = time_ns(NULL) - start;
+
+    if(idx->size(idx) != count) {
+        print_error("benchmark bulk load size mismatch");
+    }
+
+    bplustree_destroy_index(idx);
+
+    printf("%lli items (%lli unique): random insert %lli us search %lli us iterate %lli us sorted insert %lli us bulk load %lli us\n",
+           count, item_count, random_insert_time / 1000, search_time / 1000, iterate_time / 1000,
+           sorted_insert_time / 1000, bulk_load_time / 1000);
+
+    memory_free(random_keys);
+    memory_free(sorted_keys);
+
+    return 0;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    int8_t res = 0;
+    uint64_t max_key_counts[] = {2, 3, 4, 7, 32};
+
+    for(uint64_t i = 0; i < sizeof(max_key_counts) / sizeof(uint64_t) && res == 0; i++) {
+        res = test_random_ops(max_key_counts[i]);
+    }
+
+    uint64_t bulk_counts[] = {0, 1, 2, 3, 17, 100, 1000, 4099};
+
+    for(uint64_t i = 0; i < sizeof(bulk_counts) / sizeof(uint64_t) && res == 0; i++) {
+        for(uint64_t mkc = 2; mkc <= 9 && res == 0; mkc++) {
+            res = test_bulk_load(mkc, bulk_counts[i]);
+        }
+    }
+
+    if(res == 0) {
+        res = test_key_prefix();
+    }
+
+    if(res == 0) {
+        res = test_benchmark(100000);
+    }
+
+    if(res != 0) {
+        print_error("TESTS FAILED");
+
+        return -1;
+    }
+
+    print_success("TESTS PASSED");
+
+    return 0;
+}
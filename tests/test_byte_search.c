@@ -0,0 +1,356 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x4000000
+#include "setup.h"
+#include <memory.h>
+#include <strings.h>
+#include <byte_search.h>
+#include <sunday_match.h>
+#include <aho_corasick.h>
+#include <random.h>
+#include <utils.h>
+
+#define TEST_BENCH_SIZE          (16ULL << 20)
+#define TEST_BENCH_PATTERN_COUNT 64ULL
+#define TEST_RANDOM_ROUNDS       2000ULL
+
+int32_t main(uint32_t argc, char_t** argv);
+
+static int64_t test_naive_search(const uint8_t* data, int64_t data_len, const uint8_t* pattern, int64_t pattern_len) {
+    for(int64_t i = 0; i + pattern_len <= data_len; i++) {
+        if(memory_memcompare(data + i, pattern, pattern_len) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static boolean_t test_bytes(void) {
+    boolean_t pass = true;
+    uint8_t data[200] = {0};
+
+    for(int64_t len = 0; len < 200; len++) {
+        for(int64_t pos = 0; pos < len; pos += 7) {
+            memory_memclean(data, sizeof(data));
+            data[pos] = 'x';
+
+            if(byte_search_first(data, len, 'x') != pos || byte_search_last(data, len, 'x') != pos) {
+                printf("len %lli pos %lli\n", len, pos);
+                print_error("single byte position mismatch");
+
+                return false;
+            }
+
+            data[len - 1] = 'x';
+
+            if(byte_search_first(data, len, 'x') != pos || byte_search_last(data, len, 'x') != len - 1) {
+                print_error("first/last byte position mismatch");
+
+                return false;
+            }
+        }
+
+        // byte after data is not seen
+        data[len] = 'y';
+
+        if(byte_search_first(data, len, 'y') != -1 || byte_search_last(data, len, 'y') != -1) {
+            print_error("byte outside data found");
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+static boolean_t test_random_patterns(void) {
+    uint8_t data[300] = {0};
+    uint8_t pattern[40] = {0};
+
+    for(uint64_t r = 0; r < TEST_RANDOM_ROUNDS; r++) {
+        int64_t data_len = rand() % sizeof(data);
+        int64_t pattern_len = 1 + rand() % sizeof(pattern);
+
+        // small alphabet makes partial matches frequent
+        for(int64_t i = 0; i < data_len; i++) {
+            data[i] = 'a' + rand() % 3;
+        }
+
+        if(data_len > pattern_len && (rand() & 1)) {
+            memory_memcopy(data + rand() % (data_len - pattern_len), pattern, pattern_len);
+        } else {
+            for(int64_t i = 0; i < pattern_len; i++) {
+                pattern[i] = 'a' + rand() % 3;
+            }
+        }
+
+        int64_t expected = test_naive_search(data, data_len, pattern, pattern_len);
+
+        if(byte_search(data, data_len, pattern, pattern_len) != expected ||
+           sunday_match(data, data_len, pattern, pattern_len) != expected) {
+            printf("data len %lli pattern len %lli expected %lli\n", data_len, pattern_len, expected);
+            print_error("substring search mismatch");
+
+            return false;
+        }
+    }
+
+    if(strstr("hello world", "o w") == NULL || strstr("hello world", "xyz") != NULL || strstr("abc", "") == NULL) {
+        print_error("strstr mismatch");
+
+        return false;
+    }
+
+    return true;
+}
+
+typedef struct test_ac_matches_t {
+    uint64_t count;
+    uint64_t starts[16];
+    uint64_t ids[16];
+} test_ac_matches_t;
+
+static int8_t test_ac_collect(uint64_t pattern_id, uint64_t start, uint64_t end, void* arg) {
+    UNUSED(end);
+    test_ac_matches_t* matches = arg;
+
+    if(matches->count < 16) {
+        matches->starts[matches->count] = start;
+        matches->ids[matches->count] = pattern_id;
+    }
+
+    matches->count++;
+
+    return 0;
+}
+
+static boolean_t test_aho_corasick(void) {
+    boolean_t pass = true;
+
+    const uint8_t* patterns[] = {(const uint8_t*)"he", (const uint8_t*)"she", (const uint8_t*)"his", (const uint8_t*)"hers"};
+    uint64_t lens[] = {2, 3, 3, 4};
+
+    aho_corasick_t* ac = aho_corasick_create(patterns, lens, 4);
+
+    if(!ac) {
+        print_error("cannot create automaton");
+
+        return false;
+    }
+
+    // classic example: she, he, hers overlap
+    test_ac_matches_t matches = {0};
+    const char_t* text = "ushers";
+
+    if(aho_corasick_search(ac, (const uint8_t*)text, strlen(text), test_ac_collect, &matches) != 3 ||
+       matches.ids[0] != 1 || matches.starts[0] != 1 ||
+       matches.ids[1] != 0 || matches.starts[1] != 2 ||
+       matches.ids[2] != 3 || matches.starts[2] != 2) {
+        print_error("overlapping matches mismatch");
+        pass = false;
+    }
+
+    uint64_t id = 0;
+
+    if(aho_corasick_find_first(ac, (const uint8_t*)"xxhisx", 6, &id) != 2 || id != 2 ||
+       aho_corasick_find_first(ac, (const uint8_t*)"xyz", 3, &id) != -1) {
+        print_error("find first mismatch");
+        pass = false;
+    }
+
+    aho_corasick_destroy(ac);
+
+    // random pattern sets against single pattern search
+    uint8_t data[400] = {0};
+    uint8_t pattern_data[8][6] = {0};
+    const uint8_t* rnd_patterns[8] = {0};
+    uint64_t rnd_lens[8] = {0};
+
+    for(uint64_t r = 0; r < TEST_RANDOM_ROUNDS && pass; r++) {
+        for(uint64_t p = 0; p < 8; p++) {
+            rnd_lens[p] = 1 + rand() % 6;
+
+            for(uint64_t i = 0; i < rnd_lens[p]; i++) {
+                pattern_data[p][i] = 'a' + rand() % 4;
+            }
+
+            rnd_patterns[p] = pattern_data[p];
+        }
+
+        for(uint64_t i = 0; i < sizeof(data); i++) {
+            data[i] = 'a' + rand() % 4;
+        }
+
+        ac = aho_corasick_create(rnd_patterns, rnd_lens, 8);
+
+        uint64_t expected_count = 0;
+        int64_t expected_first = -1;
+
+        for(uint64_t p = 0; p < 8; p++) {
+            boolean_t duplicate = false;
+
+            for(uint64_t q = 0; q < p; q++) {
+                if(rnd_lens[q] == rnd_lens[p] && memory_memcompare(rnd_patterns[q], rnd_patterns[p], rnd_lens[p]) == 0) {
+                    duplicate = true;
+                }
+            }
+
+            if(duplicate) {
+                continue;
+            }
+
+            for(uint64_t i = 0; i + rnd_lens[p] <= sizeof(data); i++) {
+                if(memory_memcompare(data + i, rnd_patterns[p], rnd_lens[p]) == 0) {
+                    expected_count++;
+
+                    int64_t end = i + rnd_lens[p];
+                    int64_t first_end = expected_first == -1 ? -1 : expected_first;
+
+                    if(first_end == -1 || end < first_end) {
+                        expected_first = end;
+                    }
+                }
+            }
+        }
+
+        int64_t count = aho_corasick_search(ac, data, sizeof(data), NULL, NULL);
+        int64_t first = aho_corasick_find_first(ac, data, sizeof(data), &id);
+
+        if(count != (int64_t)expected_count || (expected_first == -1 ? first != -1 : first + (int64_t)rnd_lens[id] != expected_first)) {
+            printf("count %lli expected %lli first %lli\n", count, expected_count, first);
+            print_error("random automaton mismatch");
+            pass = false;
+        }
+
+        aho_corasick_destroy(ac);
+    }
+
+    return pass;
+}
+
+static boolean_t test_benchmark(void) {
+    uint8_t* data = memory_malloc(TEST_BENCH_SIZE);
+
+    if(!data) {
+        print_error("cannot allocate benchmark data");
+
+        return false;
+    }
+
+    // english like text, patterns are not in it so every search scans everything
+    const char_t* words[] = {"the ", "kernel ", "task ", "memory ", "of ", "and ", "buffer ", "interrupt ", "is ", "a "};
+
+    for(uint64_t i = 0; i < TEST_BENCH_SIZE; ) {
+        const char_t* w = words[rand() % 10];
+        uint64_t l = MIN(strlen(w), TEST_BENCH_SIZE - i);
+
+        memory_memcopy(w, data + i, l);
+        i += l;
+    }
+
+    const char_t* needles[] = {"kernel panic", "ab", "interrupt handler failed"};
+    float64_t mb = (float64_t)TEST_BENCH_SIZE / (1 << 20);
+
+    for(uint64_t n = 0; n < 3; n++) {
+        uint64_t len = strlen(needles[n]);
+
+        uint64_t start = time_ns(NULL);
+        int64_t r1 = sunday_match(data, TEST_BENCH_SIZE, (const uint8_t*)needles[n], len);
+        uint64_t mid = time_ns(NULL);
+        int64_t r2 = byte_search(data, TEST_BENCH_SIZE, (const uint8_t*)needles[n], len);
+        uint64_t end = time_ns(NULL);
+
+        if(r1 != r2) {
+            print_error("benchmark result mismatch");
+            memory_free(data);
+
+            return false;
+        }
+
+        printf("pattern len %lli: sunday_match %lli MB/s byte_search %lli MB/s\n", len,
+               (uint64_t)(mb * 1e9 / (mid - start + 1)), (uint64_t)(mb * 1e9 / (end - mid + 1)));
+    }
+
+    uint64_t start = time_ns(NULL);
+    int64_t scalar_pos = -1;
+
+    for(uint64_t i = 0; i < TEST_BENCH_SIZE; i++) {
+        if(data[i] == 'z') {
+            scalar_pos = i;
+            break;
+        }
+    }
+
+    uint64_t mid = time_ns(NULL);
+    int64_t vector_pos = byte_search_first(data, TEST_BENCH_SIZE, 'z');
+    uint64_t end = time_ns(NULL);
+
+    printf("byte scan: scalar %lli MB/s byte_search_first %lli MB/s\n",
+           (uint64_t)(mb * 1e9 / (mid - start + 1)), (uint64_t)(mb * 1e9 / (end - mid + 1)));
+
+    if(scalar_pos != vector_pos || byte_search_last(data, TEST_BENCH_SIZE, 'z') != -1) {
+        print_error("byte scan mismatch");
+        memory_free(data);
+
+        return false;
+    }
+
+    // many symbols at once: one automaton pass against one sunday pass per symbol
+    uint8_t symbol_data[TEST_BENCH_PATTERN_COUNT][12] = {0};
+    const uint8_t* symbols[TEST_BENCH_PATTERN_COUNT] = {0};
+    uint64_t symbol_lens[TEST_BENCH_PATTERN_COUNT] = {0};
+
+    for(uint64_t p = 0; p < TEST_BENCH_PATTERN_COUNT; p++) {
+        symbol_lens[p] = 6 + p % 6;
+
+        for(uint64_t i = 0; i < symbol_lens[p]; i++) {
+            symbol_data[p][i] = 'a' + rand() % 26;
+        }
+
+        symbols[p] = symbol_data[p];
+    }
+
+    aho_corasick_t* ac = aho_corasick_create(symbols, symbol_lens, TEST_BENCH_PATTERN_COUNT);
+
+    start = time_ns(NULL);
+    int64_t sunday_found = 0;
+
+    for(uint64_t p = 0; p < TEST_BENCH_PATTERN_COUNT; p++) {
+        sunday_found += sunday_match(data, TEST_BENCH_SIZE, symbols[p], symbol_lens[p]) != -1;
+    }
+
+    mid = time_ns(NULL);
+    int64_t ac_found = aho_corasick_search(ac, data, TEST_BENCH_SIZE, NULL, NULL);
+    end = time_ns(NULL);
+
+    printf("%lli symbols: sunday_match per symbol %lli ms aho_corasick %lli ms, found %lli/%lli\n",
+           TEST_BENCH_PATTERN_COUNT, (mid - start) / 1000000, (end - mid) / 1000000, sunday_found, ac_found);
+
+    aho_corasick_destroy(ac);
+    memory_free(data);
+
+    return true;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    pass &= test_bytes();
+    pass &= test_random_patterns();
+    pass &= test_aho_corasick();
+    pass &= test_benchmark();
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
@@ -0,0 +1,521 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x4000000
+#include "setup.h"
+#include <compiler/pascal.h>
+#include <buffer.h>
+#include <xxhash.h>
+#include <strings.h>
+#include <utils.h>
+#include "test_compiler_runner.h"
+
+int32_t main(uint32_t argc, char_t** argv);
+
+// shr of a negative constant, both levels fold it, -O0 at code generation and -O1 at optimizer
+static const char_t* test_const_source =
+    "program t;\n"
+    "begin\n"
+    "  t := (0 - 100) shr 28;\n"
+    "end.\n";
+
+// -O0 keeps a shr instruction, -O1 propagates a and folds result
+static const char_t* test_var_source =
+    "program t;\n"
+    "var\n"
+    "  a : int64;\n"
+    "begin\n"
+    "  a := 0 - 100;\n"
+    "  t := a shr 60;\n"
+    "end.\n";
+
+// 64 and 32 bit divisions by constants with negative dividends, -O2 uses shifts and magic numbers
+static const char_t* test_div_source =
+    "program t;\n"
+    "var\n"
+    "  x, i, a, b, c, d, e : int64;\n"
+    "  y, p, q, r, s, u : int32;\n"
+    "begin\n"
+    "  for i := 0 to 40 do\n"
+    "  begin\n"
+    "    x := i * 37 - 700;\n"
+    "    y := i * 1000 - 20000;\n"
+    "    a := x div 2;\n"
+    "    b := x div 3;\n"
+    "    c := x div 4;\n"
+    "    d := x div 7;\n"
+    "    e := x div 8;\n"
+    "    printf('%lli %lli %lli %lli %lli', a, b, c, d, e);\n"
+    "    a := x div 10;\n"
+    "    b := x div 16;\n"
+    "    c := x div 1000;\n"
+    "    d := x div (0 - 7);\n"
+    "    e := x div (0 - 8);\n"
+    "    printf('%lli %lli %lli %lli %lli', a, b, c, d, e);\n"
+    "    p := y div 2;\n"
+    "    q := y div 3;\n"
+    "    r := y div 4;\n"
+    "    s := y div 7;\n"
+    "    u := y div 8;\n"
+    "    printf('%lli %lli %lli %lli %lli', p, q, r, s, u);\n"
+    "    p := y div 10;\n"
+    "    q := y div 16;\n"
+    "    r := y div 1000;\n"
+    "    s := y div (0 - 7);\n"
+    "    u := y div (0 - 8);\n"
+    "    printf('%lli %lli %lli %lli %lli', p, q, r, s, u);\n"
+    "  end;\n"
+    "  t := 0;\n"
+    "end.\n";
+
+// branches of every relational operator, nested loops and repeat, -O2 fuses their set, bt and jnc
+static const char_t* test_branch_source =
+    "program t;\n"
+    "var\n"
+    "  i, j, a, b, c, z : int64;\n"
+    "  k : int32;\n"
+    "begin\n"
+    "  a := 0;\n"
+    "  b := 0;\n"
+    "  c := 0;\n"
+    "  z := 0;\n"
+    "  i := 0;\n"
+    "  while i < 30 do\n"
+    "  begin\n"
+    "    if i <= 10 then\n"
+    "      a := a + i\n"
+    "    else\n"
+    "      b := b + i;\n"
+    "    if i > 20 then\n"
+    "      c := c + 1;\n"
+    "    if i >= 25 then\n"
+    "      c := c + 2;\n"
+    "    if i = 15 then\n"
+    "      a := a * 2;\n"
+    "    if i <> 3 then\n"
+    "      b := b + 1;\n"
+    "    j := i;\n"
+    "    while j > 0 do\n"
+    "    begin\n"
+    "      c := c + j div 3;\n"
+    "      j := j - 4;\n"
+    "    end;\n"
+    "    k := i;\n"
+    "    a := a + k * (a div 5);\n"
+    "    b := b - 1;\n"
+    "    b := b + 6;\n"
+    "    printf('%lli %lli %lli %lli', i, a, b, c);\n"
+    "    i := i + 1;\n"
+    "  end;\n"
+    "  repeat\n"
+    "  begin\n"
+    "    z := z + 1;\n"
+    "    c := c + z * 3;\n"
+    "  end\n"
+    "  until z >= 10;\n"
+    "  for i := 1 to 5 do\n"
+    "    c := c + i;\n"
+    "  printf('%lli %lli', c, z);\n"
+    "  t := (a + b + c) and 127;\n"
+    "end.\n";
+
+// dead is never read and its stores go at -O1, stores of read variables and of function results stay
+static const char_t* test_dse_source =
+    "program t;\n"
+    "var\n"
+    "  i, dead, keep, used, last, s : int64;\n"
+    "begin\n"
+    "  dead := 5;\n"
+    "  s := 0;\n"
+    "  for i := 1 to 10 do\n"
+    "  begin\n"
+    "    dead := i * 3;\n"
+    "    used := i * 2;\n"
+    "    s := s + used;\n"
+    "    last := i;\n"
+    "  end;\n"
+    "  keep := printf('%lli %lli', s, last);\n"
+    "  t := s and 127;\n"
+    "end.\n";
+
+// known values flow into first printf, loops and disagreeing branches stop them, int16 wraps
+static const char_t* test_propagation_source =
+    "program t;\n"
+    "var\n"
+    "  a, b, c, i, s : int64;\n"
+    "  w : int16;\n"
+    "begin\n"
+    "  a := 6;\n"
+    "  b := a * 7;\n"
+    "  if b > 40 then\n"
+    "    c := b - 2\n"
+    "  else\n"
+    "    c := 0;\n"
+    "  s := 0;\n"
+    "  for i := 1 to 4 do\n"
+    "    s := s + a;\n"
+    "  printf('%lli %lli %lli', b, c, s);\n"
+    "  a := a + s;\n"
+    "  w := 30000;\n"
+    "  w := w + 30000;\n"
+    "  printf('%lli %lli', a, w);\n"
+    "  if s > 10 then\n"
+    "    b := 1\n"
+    "  else\n"
+    "    b := 2;\n"
+    "  printf('%lli', b + c);\n"
+    "  t := (b + c) and 127;\n"
+    "end.\n";
+
+typedef struct test_peephole_case_t {
+    const char_t* title;
+    const char_t* body; ///< program body, result is at rax
+    boolean_t     must_change; ///< peephole must drop or rewrite a line
+} test_peephole_case_t;
+
+static const test_peephole_case_t test_peephole_cases[] = {
+    {"self mov", "\tmov $5, %rax\n\tmov %rax, %rax\n\taddq $1, %rax\n", true},
+    {"mov back", "\tmov $7, %rcx\n\tmov %rcx, %rax\n\tmov %rax, %rcx\n\taddq %rcx, %rax\n", true},
+    {"overwritten mov", "\tmov $3, %rax\n\tmov $9, %rax\n", true},
+    {"overwritten movl", "\tmov $3, %rax\n\tmovl $9, %eax\n", true},
+    {"mov read by next", "\tmov $0x100000002, %rax\n\tmovl %eax, %eax\n", false},
+    {"push pop", "\tmov $11, %rcx\n\tpush %rcx\n\tpop %rax\n", true},
+    {"push pop same", "\tmov $12, %rax\n\tpush %rax\n\tpop %rax\n", true},
+    {"jmp next", "\tmov $1, %rax\n\tjmp .L9\n# comment\n.L9:\n\taddq $2, %rax\n", true},
+    {"jmp over", "\tmov $1, %rax\n\tjmp .L9\n\taddq $4, %rax\n.L9:\n\taddq $2, %rax\n", false},
+};
+
+/*! set instructions fuse_branch knows, each is tried with a value below, at and above compared constant */
+static const char_t*const test_peephole_sets[] = {"sete", "seteb", "setne", "setnz", "setl", "setle", "setg", "setge"};
+
+/**
+ * @brief finds immediate of last byte store of a constant, which is the store to program result
+ * @param[in] code generated assembly
+ * @param[out] value immediate
+ * @return true if found
+ */
+static boolean_t test_last_store(const char_t* code, int64_t* value) {
+    const char_t* pattern = "\tmovb $";
+    const char_t* last = NULL;
+
+    for(const char_t* at = strstr(code, pattern); at; at = strstr(at + 1, pattern)) {
+        last = at;
+    }
+
+    if(last == NULL) {
+        return false;
+    }
+
+    last += strlen(pattern);
+
+    boolean_t negative = *last == '-';
+
+    if(negative) {
+        last++;
+    }
+
+    int64_t v = 0;
+
+    while(*last >= '0' && *last <= '9') {
+        v = v * 10 + (*last - '0');
+        last++;
+    }
+
+    *value = negative ? -v : v;
+
+    return true;
+}
+
+static boolean_t test_const_shr(void) {
+    char_t* code_o0 = test_compile(test_const_source, COMPILER_OPTIMIZATION_LEVEL_NONE);
+    char_t* code_o1 = test_compile(test_const_source, COMPILER_OPTIMIZATION_LEVEL_BASIC);
+    boolean_t pass = false;
+    int64_t value_o0 = 0;
+    int64_t value_o1 = 0;
+
+    if(code_o0 && code_o1 && test_last_store(code_o0, &value_o0) && test_last_store(code_o1, &value_o1)) {
+        // constants are 32 bit, shrl of 0xffffff9c by 28
+        int64_t expected = (int64_t)((uint32_t)-100 >> 28);
+
+        printf("constant shr: -O0 %lli -O1 %lli expected %lli\n", value_o0, value_o1, expected);
+
+        pass = value_o0 == expected && value_o1 == expected;
+    } else {
+        print_error("cannot find store of constant shr");
+    }
+
+    memory_free(code_o0);
+    memory_free(code_o1);
+
+    return pass;
+}
+
+static boolean_t test_var_shr(void) {
+    char_t* code_o0 = test_compile(test_var_source, COMPILER_OPTIMIZATION_LEVEL_NONE);
+    char_t* code_o1 = test_compile(test_var_source, COMPILER_OPTIMIZATION_LEVEL_BASIC);
+    boolean_t pass = false;
+    int64_t value_o1 = 0;
+
+    if(code_o0 && code_o1 && test_last_store(code_o1, &value_o1)) {
+        // -O0 result is what its shrq computes, a logical shift of 64 bit a
+        int64_t expected = (int64_t)((uint64_t)-100 >> 60);
+        boolean_t o0_shifts = strstr(code_o0, "\tshrq $0x3C,") != NULL;
+
+        printf("variable shr: -O0 %s -O1 %lli expected %lli\n", o0_shifts ? "shrq" : "no shrq", value_o1, expected);
+
+        pass = o0_shifts && value_o1 == expected;
+    } else {
+        print_error("cannot find store of variable shr");
+    }
+
+    memory_free(code_o0);
+    memory_free(code_o1);
+
+    return pass;
+}
+
+static uint64_t test_count(const char_t* code, const char_t* pattern) {
+    uint64_t count = 0;
+
+    for(const char_t* at = strstr(code, pattern); at; at = strstr(at + 1, pattern)) {
+        count++;
+    }
+
+    return count;
+}
+
+static boolean_t test_division(void) {
+    int64_t* expected = memory_malloc(sizeof(int64_t) * 41 * 20);
+    const int64_t divisors[] = {2, 3, 4, 7, 8, 10, 16, 1000, -7, -8};
+    uint64_t count = 0;
+
+    if(expected == NULL) {
+        return false;
+    }
+
+    for(int64_t i = 0; i <= 40; i++) {
+        int64_t x = i * 37 - 700;
+        int32_t y = i * 1000 - 20000;
+
+        for(uint64_t d = 0; d < 10; d++) {
+            expected[count++] = x / divisors[d];
+        }
+
+        for(uint64_t d = 0; d < 10; d++) {
+            expected[count++] = y / divisors[d];
+        }
+    }
+
+    boolean_t pass = test_run_levels("division", test_div_source, expected, count, NULL);
+
+    memory_free(expected);
+
+    return pass;
+}
+
+static boolean_t test_branches(void) {
+    char_t* codes[3] = {0};
+    boolean_t pass = test_run_levels("branches", test_branch_source, NULL, 0, codes);
+
+    // -O2 fuses set, bt and jnc of conditions, only negated repeat condition keeps them
+    if(codes[1] == NULL || codes[2] == NULL || test_count(codes[2], "\tbt $0,") != 1 || test_count(codes[1], "\tbt $0,") < 8) {
+        print_error("branches are not fused");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 3; i++) {
+        memory_free(codes[i]);
+    }
+
+    return pass;
+}
+
+static boolean_t test_dead_stores(void) {
+    char_t* codes[3] = {0};
+    const int64_t expected[] = {110, 10};
+    boolean_t pass = test_run_levels("dead stores", test_dse_source, expected, 2, codes);
+
+    if(codes[0] == NULL || codes[1] == NULL ||
+       strstr(codes[0], "$dead@GOT") == NULL || strstr(codes[1], "$dead@GOT") != NULL) {
+        print_error("stores of unread variable are not eliminated");
+        pass = false;
+    }
+
+    if(codes[1] == NULL || strstr(codes[1], "$keep@GOT") == NULL || strstr(codes[1], "$used@GOT") == NULL ||
+       strstr(codes[1], "$last@GOT") == NULL) {
+        print_error("needed stores are eliminated");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 3; i++) {
+        memory_free(codes[i]);
+    }
+
+    return pass;
+}
+
+static boolean_t test_propagation(void) {
+    char_t* codes[3] = {0};
+    const int64_t expected[] = {42, 40, 24, 30, -5536, 41};
+    boolean_t pass = test_run_levels("propagation", test_propagation_source, expected, 6, codes);
+
+    // first printf gets b and c as immediates
+    if(codes[0] == NULL || codes[1] == NULL ||
+       strstr(codes[0], "\tmov $42, %rsi") != NULL || strstr(codes[1], "\tmov $42, %rsi") == NULL ||
+       strstr(codes[1], "\tmov $40, %rdx") == NULL) {
+        print_error("constants are not propagated");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 3; i++) {
+        memory_free(codes[i]);
+    }
+
+    return pass;
+}
+
+/**
+ * @brief runs a program body before and after peephole and compares rax
+ * @param[in] title case title
+ * @param[in] body program body
+ * @param[in] must_change peephole must change body
+ * @return true if results are same
+ */
+static boolean_t test_peephole_case(const char_t* title, const char_t* body, boolean_t must_change) {
+    buffer_t* text = buffer_new();
+
+    if(text == NULL) {
+        return false;
+    }
+
+    buffer_printf(text, "%s", body);
+
+    buffer_t* optimized = compiler_peephole(NULL, text);
+    uint64_t optimized_size = 0;
+    uint8_t* optimized_bytes = optimized ? buffer_get_all_bytes(optimized, &optimized_size) : NULL;
+    char_t* optimized_body = optimized_bytes ? memory_malloc(optimized_size + 1) : NULL;
+
+    if(optimized_body) {
+        memory_memcopy(optimized_bytes, optimized_body, optimized_size);
+    }
+
+    memory_free(optimized_bytes);
+    buffer_destroy(optimized);
+    buffer_destroy(text);
+
+    if(optimized_body == NULL) {
+        printf("peephole %s: cannot optimize\n", title);
+
+        return false;
+    }
+
+    const char_t* format = ".section .text.t\nt:\n\tenter $16, $0\n%s\tleave\n\tret\n";
+    char_t* code = strprintf(format, body);
+    char_t* optimized_code = strprintf(format, optimized_body);
+    test_vm_t* vm = code ? test_vm_run(code, "t") : NULL;
+    test_vm_t* optimized_vm = optimized_code ? test_vm_run(optimized_code, "t") : NULL;
+    boolean_t changed = strlen(optimized_body) != strlen(body) || strcmp(optimized_body, body) != 0;
+    boolean_t pass = vm && optimized_vm && vm->regs[0] == optimized_vm->regs[0] && changed == must_change;
+
+    if(!pass) {
+        printf("peephole %s: rax %llx/%llx changed %i\n", title, vm ? vm->regs[0] : 0, optimized_vm ? optimized_vm->regs[0] : 0, changed);
+    }
+
+    if(vm) {
+        test_vm_destroy(vm);
+    }
+
+    if(optimized_vm) {
+        test_vm_destroy(optimized_vm);
+    }
+
+    memory_free(code);
+    memory_free(optimized_code);
+    memory_free(optimized_body);
+
+    return pass;
+}
+
+static boolean_t test_peephole(void) {
+    boolean_t pass = true;
+
+    for(uint64_t i = 0; i < sizeof(test_peephole_cases) / sizeof(test_peephole_cases[0]); i++) {
+        const test_peephole_case_t* tc = &test_peephole_cases[i];
+
+        pass &= test_peephole_case(tc->title, tc->body, tc->must_change);
+    }
+
+    // condition of if, copied to condition register and compared, and one compare reading the register
+    for(uint64_t i = 0; i < sizeof(test_peephole_sets) / sizeof(test_peephole_sets[0]); i++) {
+        for(int64_t value = 4; value <= 6; value++) {
+            char_t* body = strprintf("\tmov $%lli, %%rcx\n\tmov $0, %%rax\n\tmov %%rcx, %%r11\n\tcmpq $0x5, %%r11\n"
+                                     "\t%s %%r11b\n\tbt $0, %%r11\n\tjnc .L1\n\tmov $1, %%rax\n.L1:\n",
+                                     value, test_peephole_sets[i]);
+            char_t* self_body = strprintf("\tmov $%lli, %%r11\n\tmov $0, %%rax\n\tcmpq %%r11, %%r11\n"
+                                          "\t%s %%r11b\n\tbt $0, %%r11\n\tjnc .L1\n\tmov $1, %%rax\n.L1:\n",
+                                          value, test_peephole_sets[i]);
+
+            pass &= body && test_peephole_case(test_peephole_sets[i], body, true);
+            pass &= self_body && test_peephole_case(test_peephole_sets[i], self_body, true);
+
+            memory_free(body);
+            memory_free(self_body);
+        }
+    }
+
+    printf("peephole cases: %s\n", pass ? "same" : "differ");
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    if(!test_const_shr()) {
+        print_error("constant shr differs between optimization levels");
+        pass = false;
+    }
+
+    if(!test_var_shr()) {
+        print_error("variable shr differs between optimization levels");
+        pass = false;
+    }
+
+    if(!test_division()) {
+        print_error("division by constants differs between optimization levels");
+        pass = false;
+    }
+
+    if(!test_branches()) {
+        print_error("branches differ between optimization levels");
+        pass = false;
+    }
+
+    if(!test_peephole()) {
+        print_error("peephole changes results");
+        pass = false;
+    }
+
+    if(!test_dead_stores()) {
+        print_error("dead store elimination changes results");
+        pass = false;
+    }
+
+    if(!test_propagation()) {
+        print_error("constant propagation changes results");
+        pass = false;
+    }
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return 0;
+}
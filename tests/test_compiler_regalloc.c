@@ -0,0 +1,171 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x4000000
+#include "setup.h"
+#include <compiler/pascal.h>
+#include <buffer.h>
+#include <xxhash.h>
+#include <strings.h>
+#include <utils.h>
+#include "test_compiler_runner.h"
+
+int32_t main(uint32_t argc, char_t** argv);
+
+// nine variables live across two calls at each iteration, more than callee saved registers
+static const char_t* test_calls_source =
+    "program t;\n"
+    "var\n"
+    "  i, a, b, c, d, e, f, g, h : int64;\n"
+    "begin\n"
+    "  a := 1;\n"
+    "  b := 2;\n"
+    "  c := 3;\n"
+    "  d := 4;\n"
+    "  e := 5;\n"
+    "  f := 6;\n"
+    "  g := 7;\n"
+    "  h := 8;\n"
+    "  for i := 1 to 12 do\n"
+    "  begin\n"
+    "    a := a + i;\n"
+    "    b := b * 3 - a;\n"
+    "    c := c + b div 5;\n"
+    "    d := d - c + i * 2;\n"
+    "    printf('%lli %lli %lli %lli %lli', i, a, b, c, d);\n"
+    "    e := e + a - d;\n"
+    "    f := f * 2 + e div 3;\n"
+    "    g := g + f - b;\n"
+    "    h := h + a + b + c + d + e + f + g;\n"
+    "    printf('%lli %lli %lli %lli', e, f, g, h);\n"
+    "    a := a + h div 7;\n"
+    "  end;\n"
+    "  printf('%lli %lli %lli %lli', a, b, c, d);\n"
+    "  printf('%lli %lli %lli %lli', e, f, g, h);\n"
+    "  t := (a + h) and 127;\n"
+    "end.\n";
+
+// 8, 16 and 32 bit variables wrap at registers as at memory, divisions use rax and rdx around them
+static const char_t* test_sizes_source =
+    "program t;\n"
+    "var\n"
+    "  i, q, r : int64;\n"
+    "  s : int8;\n"
+    "  w : int16;\n"
+    "  d : int32;\n"
+    "begin\n"
+    "  s := 1;\n"
+    "  w := 1;\n"
+    "  d := 1;\n"
+    "  q := 0;\n"
+    "  r := 0;\n"
+    "  i := 0;\n"
+    "  while i < 40 do\n"
+    "  begin\n"
+    "    s := s + 37;\n"
+    "    w := w * 3 + 1;\n"
+    "    d := d * 7 - w;\n"
+    "    q := q + d + s;\n"
+    "    r := r + q div 9 - w div 4;\n"
+    "    if s < 0 then\n"
+    "      printf('%lli %lli %lli', s, w, d)\n"
+    "    else\n"
+    "      printf('%lli %lli', q, r);\n"
+    "    i := i + 1;\n"
+    "  end;\n"
+    "  printf('%lli %lli %lli %lli %lli', s, w, d, q, r);\n"
+    "  t := (q + r) and 127;\n"
+    "end.\n";
+
+// nested loops and branches, m and n live from first statement to last, k is read after its loop
+static const char_t* test_loops_source =
+    "program t;\n"
+    "var\n"
+    "  i, j, k, a, b, c, m, n, last : int64;\n"
+    "begin\n"
+    "  m := 1000;\n"
+    "  n := 0 - 3;\n"
+    "  a := 0;\n"
+    "  b := 1;\n"
+    "  c := 0;\n"
+    "  for i := 1 to 6 do\n"
+    "  begin\n"
+    "    j := 0;\n"
+    "    while j < 4 do\n"
+    "    begin\n"
+    "      k := i * j;\n"
+    "      if k > 6 then\n"
+    "        a := a + k\n"
+    "      else\n"
+    "        b := b * 2 + k;\n"
+    "      j := j + 1;\n"
+    "    end;\n"
+    "    c := c + a - b div 3;\n"
+    "    last := k + i;\n"
+    "    printf('%lli %lli %lli %lli', i, a, b, c);\n"
+    "  end;\n"
+    "  printf('%lli %lli %lli %lli', m + n + c, last, a, b);\n"
+    "  t := (c + m) and 127;\n"
+    "end.\n";
+
+/**
+ * @brief runs a source without allocation at -O0 and with it at -O1 and -O2, results must be same
+ * @param[in] title test title
+ * @param[in] source pascal source
+ * @param[in] expected expected printf arguments, NULL to only compare levels
+ * @param[in] expected_count expected argument count
+ * @return true if levels agree and -O1 keeps variables at registers
+ */
+static boolean_t test_regalloc(const char_t* title, const char_t* source, const int64_t* expected, uint64_t expected_count) {
+    char_t* codes[3] = {0};
+    boolean_t pass = test_run_levels(title, source, expected, expected_count, codes);
+
+    // allocation is reported with a comment for each promoted variable
+    if(codes[0] == NULL || codes[1] == NULL || strstr(codes[0], "at register") != NULL || strstr(codes[1], "at register") == NULL) {
+        printf("%s: variables are not allocated only at -O1\n", title);
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 3; i++) {
+        memory_free(codes[i]);
+    }
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    if(!test_regalloc("calls", test_calls_source, NULL, 0)) {
+        print_error("variables live across calls differ with allocation");
+        pass = false;
+    }
+
+    if(!test_regalloc("sizes", test_sizes_source, NULL, 0)) {
+        print_error("narrow variables differ with allocation");
+        pass = false;
+    }
+
+    const int64_t loops_expected[] = {
+        1, 0, 27, -9, 2, 0, 454, -160, 3, 9, 3644, -1365, 4, 29, 14580, -6196, 5, 54, 58325, -25583,
+        6, 84, 233306, -103267, -102270, 24, 84, 233306,
+    };
+
+    if(!test_regalloc("loops", test_loops_source, loops_expected, sizeof(loops_expected) / sizeof(loops_expected[0]))) {
+        print_error("variables live across loops differ with allocation");
+        pass = false;
+    }
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return 0;
+}
@@ -0,0 +1,1173 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___TEST_COMPILER_RUNNER_H
+#define ___TEST_COMPILER_RUNNER_H 0
+
+/*
+ * compiles pascal sources and runs generated assembly at a small x86-64 interpreter. interpreter knows only the
+ * instructions code generation emits. globals are reached through a got as generated code expects, printf is the
+ * only external function and it records its integer arguments as output. tests run a source at several
+ * optimization levels and compare outputs and program results.
+ */
+
+#include <types.h>
+#include <memory.h>
+#include <buffer.h>
+#include <strings.h>
+#include <utils.h>
+#include <compiler/pascal.h>
+
+/*! interpreter memory start, got, data and stack are inside */
+#define TEST_VM_MEMORY_BASE 0x100000ULL
+/*! interpreter memory size */
+#define TEST_VM_MEMORY_SIZE 0x40000ULL
+/*! code addresses are instruction indexes over this base */
+#define TEST_VM_CODE_BASE   0x10000000ULL
+/*! external function addresses are extern indexes over this base */
+#define TEST_VM_EXTERN_BASE 0x20000000ULL
+/*! return address of program function, run stops when it is popped */
+#define TEST_VM_RETURN      0x2FFFFFF0ULL
+/*! caller saved registers get this value after an external call */
+#define TEST_VM_POISON      0x5A5A5A5A5A5A5A5AULL
+#define TEST_VM_MAX_SYMBOLS 256
+#define TEST_VM_MAX_OUTPUT  8192
+#define TEST_VM_MAX_STEPS   8000000ULL
+#define TEST_VM_OPERAND_MAX 64
+
+typedef struct test_vm_line_t {
+    const char_t* text; ///< line at source, for error messages
+    uint64_t      length; ///< line length
+    char_t        mnemonic[16]; ///< instruction mnemonic
+    int16_t       operand_count; ///< operand count
+    char_t        operands[3][TEST_VM_OPERAND_MAX]; ///< operands as written
+} test_vm_line_t;
+
+typedef struct test_vm_symbol_t {
+    char_t   name[TEST_VM_OPERAND_MAX]; ///< symbol name
+    uint64_t address; ///< code, data or extern address
+} test_vm_symbol_t;
+
+typedef enum test_vm_operand_type_t {
+    TEST_VM_OPERAND_TYPE_REGISTER,
+    TEST_VM_OPERAND_TYPE_IMMEDIATE,
+    TEST_VM_OPERAND_TYPE_MEMORY,
+    TEST_VM_OPERAND_TYPE_LABEL,
+} test_vm_operand_type_t;
+
+typedef struct test_vm_operand_t {
+    test_vm_operand_type_t type; ///< operand type
+    int16_t                reg; ///< register index
+    int8_t                 size; ///< register size in bytes
+    uint64_t               value; ///< immediate, memory address or label address
+} test_vm_operand_t;
+
+typedef struct test_vm_t {
+    test_vm_line_t*  lines; ///< instructions of text sections
+    uint64_t         line_count; ///< instruction count
+    test_vm_symbol_t symbols[TEST_VM_MAX_SYMBOLS]; ///< symbols, index is got slot
+    uint64_t         symbol_count; ///< symbol count
+    uint64_t         extern_count; ///< undefined symbols
+    uint8_t*         memory; ///< interpreter memory
+    uint64_t         data_top; ///< next free data address
+    uint64_t         regs[16]; ///< registers, rax rcx rdx rbx rsp rbp rsi rdi r8-r15
+    boolean_t        zf; ///< zero flag
+    boolean_t        sf; ///< sign flag
+    boolean_t        cf; ///< carry flag
+    boolean_t        of; ///< overflow flag
+    uint64_t         steps; ///< executed instructions
+    int64_t          output[TEST_VM_MAX_OUTPUT]; ///< printf arguments
+    uint64_t         output_count; ///< recorded printf arguments
+    int64_t          result; ///< program result, low byte of rax sign extended
+} test_vm_t;
+
+static const char_t*const test_vm_regs[4][16] = {
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"},
+    {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+};
+
+/*! mnemonics that take b w l q suffixes, others take size from their register operands */
+static const char_t*const test_vm_sized_mnemonics[] = {
+    "mov", "add", "sub", "and", "or", "xor", "cmp", "test", "imul", "idiv", "neg", "not", "shl", "shr", "sar", "lea",
+    "push", "pop", "xchg", "bt",
+};
+
+static const char_t*const test_vm_conditions[][2] = {
+    {"e", "e"}, {"eb", "e"}, {"z", "e"}, {"ne", "ne"}, {"nz", "ne"}, {"l", "l"}, {"le", "le"}, {"g", "g"}, {"ge", "ge"},
+    {"c", "c"}, {"b", "c"}, {"nc", "nc"}, {"ae", "nc"}, {"a", "a"}, {"be", "be"},
+};
+
+static void test_vm_error(const test_vm_t* vm, const test_vm_line_t* line, const char_t* message) {
+    char_t* text = line ? strndup(line->text, line->length) : NULL;
+
+    printf("vm error: %s at step %lli: %s\n", message, vm->steps, text ? text : "");
+
+    memory_free(text);
+}
+
+static uint64_t test_vm_mask(uint64_t value, int8_t size) {
+    return size >= 8 ? value : value & ((1ULL << (size * 8)) - 1);
+}
+
+static int64_t test_vm_sign_extend(uint64_t value, int8_t size) {
+    int64_t shift = 64 - size * 8;
+
+    return (int64_t)(value << shift) >> shift;
+}
+
+static boolean_t test_vm_is_space(char_t c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * @brief parses a decimal or 0x prefixed hex number with optional minus sign
+ * @param[in,out] text text, moved after number
+ * @param[out] value number
+ * @return true if a number is found
+ */
+static boolean_t test_vm_parse_number(const char_t** text, int64_t* value) {
+    const char_t* at = *text;
+    boolean_t negative = *at == '-';
+
+    if(negative) {
+        at++;
+    }
+
+    uint64_t v = 0;
+    const char_t* digits = at;
+
+    if(at[0] == '0' && (at[1] == 'x' || at[1] == 'X')) {
+        at += 2;
+        digits = at;
+
+        for(;; at++) {
+            if(*at >= '0' && *at <= '9') {
+                v = v * 16 + (*at - '0');
+            } else if(*at >= 'a' && *at <= 'f') {
+                v = v * 16 + (*at - 'a' + 10);
+            } else if(*at >= 'A' && *at <= 'F') {
+                v = v * 16 + (*at - 'A' + 10);
+            } else {
+                break;
+            }
+        }
+    } else {
+        while(*at >= '0' && *at <= '9') {
+            v = v * 10 + (*at - '0');
+            at++;
+        }
+    }
+
+    if(at == digits) {
+        return false;
+    }
+
+    *value = negative ? -(int64_t)v : (int64_t)v;
+    *text = at;
+
+    return true;
+}
+
+static int16_t test_vm_find_register(const char_t* name, uint64_t length, int8_t* size) {
+    for(int32_t s = 0; s < 4; s++) {
+        for(int32_t r = 0; r < 16; r++) {
+            if(strlen(test_vm_regs[s][r]) == length && strncmp(test_vm_regs[s][r], name, length) == 0) {
+                *size = 8 >> s;
+
+                return r;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static int64_t test_vm_find_symbol(const test_vm_t* vm, const char_t* name, uint64_t length) {
+    for(uint64_t i = 0; i < vm->symbol_count; i++) {
+        if(strlen(vm->symbols[i].name) == length && strncmp(vm->symbols[i].name, name, length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static boolean_t test_vm_store(test_vm_t* vm, uint64_t address, int8_t size, uint64_t value) {
+    if(address < TEST_VM_MEMORY_BASE || address + size > TEST_VM_MEMORY_BASE + TEST_VM_MEMORY_SIZE) {
+        return false;
+    }
+
+    for(int8_t i = 0; i < size; i++) {
+        vm->memory[address - TEST_VM_MEMORY_BASE + i] = (value >> (i * 8)) & 0xFF;
+    }
+
+    return true;
+}
+
+static boolean_t test_vm_load(const test_vm_t* vm, uint64_t address, int8_t size, uint64_t* value) {
+    if(address < TEST_VM_MEMORY_BASE || address + size > TEST_VM_MEMORY_BASE + TEST_VM_MEMORY_SIZE) {
+        return false;
+    }
+
+    uint64_t v = 0;
+
+    for(int8_t i = size - 1; i >= 0; i--) {
+        v = (v << 8) | vm->memory[address - TEST_VM_MEMORY_BASE + i];
+    }
+
+    *value = v;
+
+    return true;
+}
+
+/**
+ * @brief adds a symbol and its got slot
+ * @param[in] vm interpreter
+ * @param[in] name symbol name
+ * @param[in] length name length
+ * @param[in] address symbol address
+ * @return symbol index, -1 if table is full
+ */
+static int64_t test_vm_add_symbol(test_vm_t* vm, const char_t* name, uint64_t length, uint64_t address) {
+    if(vm->symbol_count == TEST_VM_MAX_SYMBOLS || length >= TEST_VM_OPERAND_MAX) {
+        return -1;
+    }
+
+    int64_t idx = vm->symbol_count++;
+
+    memory_memcopy(name, vm->symbols[idx].name, length);
+    vm->symbols[idx].name[length] = '\0';
+    vm->symbols[idx].address = address;
+
+    test_vm_store(vm, TEST_VM_MEMORY_BASE + idx * 8, 8, address);
+
+    return idx;
+}
+
+/**
+ * @brief splits an instruction line into mnemonic and operands, commas inside parentheses do not split
+ * @param[in] text line after leading tab
+ * @param[in] length text length
+ * @param[out] line decoded line
+ * @return true if line fits
+ */
+static boolean_t test_vm_split_line(const char_t* text, uint64_t length, test_vm_line_t* line) {
+    uint64_t i = 0;
+    uint64_t m = 0;
+
+    while(i < length && !test_vm_is_space(text[i])) {
+        if(m == sizeof(line->mnemonic) - 1) {
+            return false;
+        }
+
+        line->mnemonic[m++] = text[i++];
+    }
+
+    line->mnemonic[m] = '\0';
+    line->operand_count = 0;
+
+    while(i < length) {
+        while(i < length && test_vm_is_space(text[i])) {
+            i++;
+        }
+
+        if(i == length) {
+            break;
+        }
+
+        if(line->operand_count == 3) {
+            return false;
+        }
+
+        char_t* operand = line->operands[line->operand_count++];
+        uint64_t o = 0;
+        int32_t depth = 0;
+
+        while(i < length && (depth || text[i] != ',')) {
+            if(text[i] == '(') {
+                depth++;
+            } else if(text[i] == ')') {
+                depth--;
+            }
+
+            // spaces inside memory operands are dropped
+            if(!test_vm_is_space(text[i])) {
+                if(o == TEST_VM_OPERAND_MAX - 1) {
+                    return false;
+                }
+
+                operand[o++] = text[i];
+            }
+
+            i++;
+        }
+
+        operand[o] = '\0';
+
+        if(i < length) {
+            i++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief loads generated assembly, text sections become instructions, data sections are placed at memory
+ * @param[in] vm interpreter
+ * @param[in] code generated assembly
+ * @return true on success
+ */
+static boolean_t test_vm_load_code(test_vm_t* vm, const char_t* code) {
+    uint64_t max_lines = 1;
+
+    for(const char_t* at = code; *at; at++) {
+        if(*at == '\n') {
+            max_lines++;
+        }
+    }
+
+    vm->lines = memory_malloc(sizeof(test_vm_line_t) * max_lines);
+    vm->memory = memory_malloc(TEST_VM_MEMORY_SIZE);
+
+    if(vm->lines == NULL || vm->memory == NULL) {
+        return false;
+    }
+
+    memory_memclean(vm->memory, TEST_VM_MEMORY_SIZE);
+
+    // got is at memory start, data follows it
+    vm->data_top = TEST_VM_MEMORY_BASE + TEST_VM_MAX_SYMBOLS * 8;
+
+    boolean_t in_text = false;
+    const char_t* size_name = NULL;
+    uint64_t size_name_length = 0;
+    int64_t size = 0;
+    uint64_t data_at = 0;
+
+    for(const char_t* at = code; *at;) {
+        const char_t* end = strchr(at, '\n');
+        uint64_t length = end ? (uint64_t)(end - at) : strlen(at);
+        const char_t* next = end ? end + 1 : at + length;
+
+        if(length == 0 || at[0] == '#') {
+            at = next;
+            continue;
+        }
+
+        if(strncmp(at, ".section ", 9) == 0) {
+            in_text = strncmp(at + 9, ".text", 5) == 0;
+        } else if(strncmp(at, ".size ", 6) == 0) {
+            const char_t* comma = strchr(at, ',');
+            const char_t* value = comma ? comma + 1 : NULL;
+
+            while(value && test_vm_is_space(*value)) {
+                value++;
+            }
+
+            if(value && test_vm_parse_number(&value, &size)) {
+                size_name = at + 6;
+                size_name_length = comma - size_name;
+            }
+        } else if(at[0] != '\t' && at[length - 1] == ':') {
+            uint64_t address = TEST_VM_CODE_BASE + vm->line_count;
+
+            if(!in_text) {
+                // data labels take size of their .size directive
+                int64_t data_size = size_name && size_name_length == length - 1 && strncmp(size_name, at, length - 1) == 0 ? size : 0;
+
+                address = vm->data_top;
+                data_at = address;
+                vm->data_top += (data_size + 7) & ~7ULL;
+
+                if(vm->data_top > TEST_VM_MEMORY_BASE + TEST_VM_MEMORY_SIZE / 2) {
+                    return false;
+                }
+            }
+
+            if(test_vm_add_symbol(vm, at, length - 1, address) == -1) {
+                return false;
+            }
+        } else if(at[0] == '\t' && in_text) {
+            test_vm_line_t* line = &vm->lines[vm->line_count];
+
+            line->text = at + 1;
+            line->length = length - 1;
+
+            if(!test_vm_split_line(at + 1, length - 1, line)) {
+                return false;
+            }
+
+            vm->line_count++;
+        } else if(at[0] == '\t' && data_at) {
+            const char_t* value = at + 1;
+
+            if(strncmp(value, ".string \"", 9) == 0) {
+                for(value += 9; value < at + length && *value != '"'; value++) {
+                    test_vm_store(vm, data_at++, 1, *value);
+                }
+
+                test_vm_store(vm, data_at++, 1, 0);
+            } else {
+                const char_t* directives[] = {".byte ", ".word ", ".long ", ".quad "};
+
+                for(int32_t d = 0; d < 4; d++) {
+                    uint64_t d_len = strlen(directives[d]);
+                    int64_t v = 0;
+
+                    if(strncmp(value, directives[d], d_len) == 0) {
+                        value += d_len;
+
+                        if(test_vm_parse_number(&value, &v)) {
+                            test_vm_store(vm, data_at, 1 << d, v);
+                            data_at += 1 << d;
+                        }
+                    }
+                }
+            }
+        }
+
+        at = next;
+    }
+
+    return true;
+}
+
+/**
+ * @brief decodes an operand, unknown got symbols become externs
+ * @param[in] vm interpreter
+ * @param[in] text operand text
+ * @param[out] op decoded operand
+ * @return true on success
+ */
+static boolean_t test_vm_decode(test_vm_t* vm, const char_t* text, test_vm_operand_t* op) {
+    memory_memclean(op, sizeof(test_vm_operand_t));
+
+    if(*text == '*') {
+        text++;
+    }
+
+    if(*text == '%') {
+        op->type = TEST_VM_OPERAND_TYPE_REGISTER;
+        op->reg = test_vm_find_register(text + 1, strlen(text + 1), &op->size);
+
+        return op->reg != -1;
+    }
+
+    if(*text == '$') {
+        text++;
+        op->type = TEST_VM_OPERAND_TYPE_IMMEDIATE;
+
+        const char_t* got = strstr(text, "@GOT");
+
+        if(got) {
+            int64_t idx = test_vm_find_symbol(vm, text, got - text);
+
+            if(idx == -1) {
+                idx = test_vm_add_symbol(vm, text, got - text, TEST_VM_EXTERN_BASE + vm->extern_count++);
+            }
+
+            op->value = idx * 8;
+
+            return idx != -1;
+        }
+
+        int64_t v = 0;
+
+        if(!test_vm_parse_number(&text, &v) || *text) {
+            return false;
+        }
+
+        op->value = v;
+
+        return true;
+    }
+
+    const char_t* paren = strchr(text, '(');
+
+    if(paren == NULL) {
+        int64_t idx = test_vm_find_symbol(vm, text, strlen(text));
+
+        op->type = TEST_VM_OPERAND_TYPE_LABEL;
+        op->value = idx == -1 ? 0 : vm->symbols[idx].address;
+
+        return idx != -1;
+    }
+
+    op->type = TEST_VM_OPERAND_TYPE_MEMORY;
+
+    int64_t disp = 0;
+
+    if(paren != text && (!test_vm_parse_number(&text, &disp) || text != paren)) {
+        return false;
+    }
+
+    // base, optional index and scale
+    const char_t* at = paren + 1;
+    uint64_t address = disp;
+
+    for(int8_t part = 0; *at && *at != ')'; part++) {
+        const char_t* part_end = at;
+
+        while(*part_end && *part_end != ',' && *part_end != ')') {
+            part_end++;
+        }
+
+        if(part < 2) {
+            int8_t reg_size = 0;
+            int16_t reg = at[0] == '%' ? test_vm_find_register(at + 1, part_end - at - 1, &reg_size) : -1;
+
+            if(reg == -1 || reg_size != 8) {
+                return false;
+            }
+
+            if(part == 0) {
+                address += vm->regs[reg];
+            } else {
+                int64_t scale = 1;
+                const char_t* scale_at = part_end + 1;
+
+                if(*part_end == ',' && !test_vm_parse_number(&scale_at, &scale)) {
+                    return false;
+                }
+
+                address += vm->regs[reg] * scale;
+            }
+        } else if(part > 2) {
+            return false;
+        }
+
+        at = *part_end == ',' ? part_end + 1 : part_end;
+    }
+
+    op->value = address;
+
+    return true;
+}
+
+static boolean_t test_vm_read(const test_vm_t* vm, const test_vm_operand_t* op, int8_t size, uint64_t* value) {
+    switch(op->type) {
+    case TEST_VM_OPERAND_TYPE_REGISTER:
+        *value = test_vm_mask(vm->regs[op->reg], size);
+
+        return true;
+    case TEST_VM_OPERAND_TYPE_MEMORY:
+        return test_vm_load(vm, op->value, size, value);
+    default:
+        *value = test_vm_mask(op->value, size);
+
+        return true;
+    }
+}
+
+static boolean_t test_vm_write(test_vm_t* vm, const test_vm_operand_t* op, int8_t size, uint64_t value) {
+    if(op->type == TEST_VM_OPERAND_TYPE_MEMORY) {
+        return test_vm_store(vm, op->value, size, value);
+    }
+
+    if(op->type != TEST_VM_OPERAND_TYPE_REGISTER) {
+        return false;
+    }
+
+    // 32 bit writes clear upper half, 16 and 8 bit writes keep upper bits
+    if(size == 8 || size == 4) {
+        vm->regs[op->reg] = test_vm_mask(value, size);
+    } else {
+        uint64_t mask = (1ULL << (size * 8)) - 1;
+        vm->regs[op->reg] = (vm->regs[op->reg] & ~mask) | (value & mask);
+    }
+
+    return true;
+}
+
+static void test_vm_set_result_flags(test_vm_t* vm, uint64_t result, int8_t size) {
+    vm->zf = test_vm_mask(result, size) == 0;
+    vm->sf = test_vm_sign_extend(result, size) < 0;
+}
+
+static boolean_t test_vm_condition(const test_vm_t* vm, const char_t* cc) {
+    for(uint64_t i = 0; i < sizeof(test_vm_conditions) / sizeof(test_vm_conditions[0]); i++) {
+        if(strcmp(test_vm_conditions[i][0], cc) != 0) {
+            continue;
+        }
+
+        const char_t* c = test_vm_conditions[i][1];
+
+        if(strcmp(c, "e") == 0) {
+            return vm->zf;
+        } else if(strcmp(c, "ne") == 0) {
+            return !vm->zf;
+        } else if(strcmp(c, "l") == 0) {
+            return vm->sf != vm->of;
+        } else if(strcmp(c, "le") == 0) {
+            return vm->zf || vm->sf != vm->of;
+        } else if(strcmp(c, "g") == 0) {
+            return !vm->zf && vm->sf == vm->of;
+        } else if(strcmp(c, "ge") == 0) {
+            return vm->sf == vm->of;
+        } else if(strcmp(c, "c") == 0) {
+            return vm->cf;
+        } else if(strcmp(c, "nc") == 0) {
+            return !vm->cf;
+        } else if(strcmp(c, "a") == 0) {
+            return !vm->cf && !vm->zf;
+        } else {
+            return vm->cf || vm->zf;
+        }
+    }
+
+    return false;
+}
+
+static boolean_t test_vm_is_condition(const char_t* cc) {
+    for(uint64_t i = 0; i < sizeof(test_vm_conditions) / sizeof(test_vm_conditions[0]); i++) {
+        if(strcmp(test_vm_conditions[i][0], cc) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief finds base mnemonic and operation size, suffix wins, then register operands, then 64 bit
+ * @param[in] line instruction
+ * @param[in] ops decoded operands
+ * @param[out] base base mnemonic
+ * @return operation size in bytes
+ */
+static int8_t test_vm_operation_size(const test_vm_line_t* line, const test_vm_operand_t* ops, char_t* base) {
+    uint64_t m_len = strlen(line->mnemonic);
+
+    strcopy(line->mnemonic, base);
+
+    for(uint64_t i = 0; i < sizeof(test_vm_sized_mnemonics) / sizeof(test_vm_sized_mnemonics[0]); i++) {
+        uint64_t b_len = strlen(test_vm_sized_mnemonics[i]);
+
+        if(m_len == b_len + 1 && strncmp(line->mnemonic, test_vm_sized_mnemonics[i], b_len) == 0) {
+            const char_t* suffixes = "bwlq";
+            const char_t* suffix = strchr(suffixes, line->mnemonic[b_len]);
+
+            if(suffix) {
+                base[b_len] = '\0';
+
+                return 1 << (suffix - suffixes);
+            }
+        }
+    }
+
+    for(int32_t i = line->operand_count - 1; i >= 0; i--) {
+        if(ops[i].type == TEST_VM_OPERAND_TYPE_REGISTER) {
+            return ops[i].size;
+        }
+    }
+
+    return 8;
+}
+
+static boolean_t test_vm_push(test_vm_t* vm, uint64_t value) {
+    vm->regs[4] -= 8;
+
+    return test_vm_store(vm, vm->regs[4], 8, value);
+}
+
+static boolean_t test_vm_pop(test_vm_t* vm, uint64_t* value) {
+    boolean_t res = test_vm_load(vm, vm->regs[4], 8, value);
+
+    vm->regs[4] += 8;
+
+    return res;
+}
+
+/**
+ * @brief runs printf, records one integer argument per conversion and poisons caller saved registers
+ * @param[in] vm interpreter
+ * @param[in] extern_id extern index
+ * @return true on success
+ */
+static boolean_t test_vm_call_extern(test_vm_t* vm, uint64_t extern_id) {
+    const test_vm_symbol_t* symbol = NULL;
+
+    for(uint64_t i = 0; i < vm->symbol_count; i++) {
+        if(vm->symbols[i].address == TEST_VM_EXTERN_BASE + extern_id) {
+            symbol = &vm->symbols[i];
+        }
+    }
+
+    if(symbol == NULL || strcmp(symbol->name, "printf") != 0) {
+        return false;
+    }
+
+    const uint8_t arg_regs[] = {6, 2, 1, 8, 9};
+    uint64_t arg = 0;
+    uint64_t c = 0;
+
+    for(uint64_t at = vm->regs[7]; test_vm_load(vm, at, 1, &c) && c; at++) {
+        if(c != '%') {
+            continue;
+        }
+
+        if(!test_vm_load(vm, at + 1, 1, &c) || c == '%') {
+            at++;
+            continue;
+        }
+
+        if(arg == sizeof(arg_regs) || vm->output_count == TEST_VM_MAX_OUTPUT) {
+            return false;
+        }
+
+        vm->output[vm->output_count++] = vm->regs[arg_regs[arg++]];
+    }
+
+    const uint8_t caller_saved[] = {0, 1, 2, 6, 7, 8, 9, 10, 11};
+
+    for(uint64_t i = 0; i < sizeof(caller_saved); i++) {
+        vm->regs[caller_saved[i]] = TEST_VM_POISON;
+    }
+
+    return true;
+}
+
+/**
+ * @brief executes one instruction
+ * @param[in] vm interpreter
+ * @param[in,out] pc instruction index
+ * @param[out] stop true when program function returns
+ * @return true on success
+ */
+static boolean_t test_vm_step(test_vm_t* vm, uint64_t* pc, boolean_t* stop) {
+    const test_vm_line_t* line = &vm->lines[*pc];
+    test_vm_operand_t ops[3] = {0};
+    char_t base[16] = {0};
+
+    for(int32_t i = 0; i < line->operand_count; i++) {
+        if(!test_vm_decode(vm, line->operands[i], &ops[i])) {
+            test_vm_error(vm, line, "cannot decode operand");
+
+            return false;
+        }
+    }
+
+    int8_t size = test_vm_operation_size(line, ops, base);
+    test_vm_operand_t* src = &ops[0];
+    test_vm_operand_t* dst = line->operand_count ? &ops[line->operand_count - 1] : &ops[0];
+    uint64_t a = 0;
+    uint64_t b = 0;
+    uint64_t r = 0;
+    boolean_t ok = true;
+
+    (*pc)++;
+
+    if(strcmp(base, "mov") == 0) {
+        ok = test_vm_read(vm, src, size, &a) && test_vm_write(vm, dst, size, a);
+    } else if(strcmp(base, "movsx") == 0 || strcmp(base, "movzx") == 0) {
+        ok = src->type == TEST_VM_OPERAND_TYPE_REGISTER && test_vm_read(vm, src, src->size, &a);
+        a = base[3] == 's' ? (uint64_t)test_vm_sign_extend(a, src->size) : a;
+        ok = ok && test_vm_write(vm, dst, dst->size, a);
+    } else if(strcmp(base, "lea") == 0) {
+        ok = src->type == TEST_VM_OPERAND_TYPE_MEMORY && test_vm_write(vm, dst, size, src->value);
+    } else if(strcmp(base, "xchg") == 0) {
+        ok = test_vm_read(vm, src, size, &a) && test_vm_read(vm, dst, size, &b) &&
+             test_vm_write(vm, src, size, b) && test_vm_write(vm, dst, size, a);
+    } else if(strcmp(base, "add") == 0 || strcmp(base, "sub") == 0 || strcmp(base, "cmp") == 0) {
+        ok = test_vm_read(vm, src, size, &b) && test_vm_read(vm, dst, size, &a);
+
+        if(base[0] == 'a') {
+            r = a + b;
+            vm->cf = test_vm_mask(r, size) < a;
+            vm->of = test_vm_sign_extend(~(a ^ b) & (a ^ r), size) < 0;
+        } else {
+            r = a - b;
+            vm->cf = a < b;
+            vm->of = test_vm_sign_extend((a ^ b) & (a ^ r), size) < 0;
+        }
+
+        test_vm_set_result_flags(vm, r, size);
+        ok = ok && (base[0] == 'c' || test_vm_write(vm, dst, size, r));
+    } else if(strcmp(base, "and") == 0 || strcmp(base, "or") == 0 || strcmp(base, "xor") == 0 || strcmp(base, "test") == 0) {
+        ok = test_vm_read(vm, src, size, &b) && test_vm_read(vm, dst, size, &a);
+        r = base[0] == 'o' ? a | b : base[0] == 'x' ? a ^ b : a & b;
+        vm->cf = false;
+        vm->of = false;
+        test_vm_set_result_flags(vm, r, size);
+        ok = ok && (base[0] == 't' || test_vm_write(vm, dst, size, r));
+    } else if(strcmp(base, "neg") == 0 || strcmp(base, "not") == 0) {
+        ok = test_vm_read(vm, dst, size, &a);
+        r = base[1] == 'e' ? -a : ~a;
+
+        if(base[1] == 'e') {
+            vm->cf = test_vm_mask(a, size) != 0;
+            test_vm_set_result_flags(vm, r, size);
+        }
+
+        ok = ok && test_vm_write(vm, dst, size, r);
+    } else if(strcmp(base, "shl") == 0 || strcmp(base, "shr") == 0 || strcmp(base, "sar") == 0) {
+        ok = test_vm_read(vm, src, 1, &b) && test_vm_read(vm, dst, size, &a);
+        b &= size == 8 ? 63 : 31;
+
+        if(base[2] == 'l') {
+            r = a << b;
+        } else if(base[1] == 'h') {
+            r = b < 64 ? a >> b : 0;
+        } else {
+            r = test_vm_sign_extend(a, size) >> b;
+        }
+
+        if(b) {
+            test_vm_set_result_flags(vm, r, size);
+        }
+
+        ok = ok && test_vm_write(vm, dst, size, r);
+    } else if(strcmp(base, "imul") == 0) {
+        if(line->operand_count == 1) {
+            // rdx:rax = rax * operand at operation size
+            ok = test_vm_read(vm, src, size, &b);
+            int128_t p = (int128_t)test_vm_sign_extend(vm->regs[0], size) * test_vm_sign_extend(b, size);
+            test_vm_operand_t rax = {.type = TEST_VM_OPERAND_TYPE_REGISTER, .reg = 0};
+            test_vm_operand_t rdx = {.type = TEST_VM_OPERAND_TYPE_REGISTER, .reg = 2};
+
+            ok = ok && test_vm_write(vm, &rax, size, (uint64_t)p) &&
+                 test_vm_write(vm, &rdx, size, size == 8 ? (uint64_t)(p >> 64) : (uint64_t)(p >> (size * 8)));
+        } else {
+            test_vm_operand_t* factor = line->operand_count == 3 ? &ops[1] : dst;
+
+            ok = test_vm_read(vm, src, size, &a) && test_vm_read(vm, factor, size, &b);
+            r = (uint64_t)(test_vm_sign_extend(a, size) * test_vm_sign_extend(b, size));
+            ok = ok && test_vm_write(vm, dst, size, r);
+        }
+    } else if(strcmp(base, "idiv") == 0) {
+        // dividend is rdx:rax at operation size, ax for bytes, it must fit 64 bits
+        ok = test_vm_read(vm, src, size, &b);
+        int64_t divisor = test_vm_sign_extend(b, size);
+        int64_t low = test_vm_sign_extend(vm->regs[0], size);
+        int64_t high = test_vm_sign_extend(vm->regs[2], size);
+        int64_t dividend = size == 8 ? low : (int64_t)((uint64_t)high << (size * 8)) | (int64_t)test_vm_mask(low, size);
+
+        if(size == 1) {
+            dividend = test_vm_sign_extend(vm->regs[0], 2);
+        }
+
+        if(!ok || divisor == 0 || (size == 8 && high != (low < 0 ? -1 : 0)) || ((uint64_t)dividend == 1ULL << 63 && divisor == -1)) {
+            test_vm_error(vm, line, "division fault");
+
+            return false;
+        }
+
+        int64_t quotient = dividend / divisor;
+
+        if(test_vm_sign_extend(quotient, size) != quotient) {
+            test_vm_error(vm, line, "division overflow");
+
+            return false;
+        }
+
+        test_vm_operand_t rax = {.type = TEST_VM_OPERAND_TYPE_REGISTER, .reg = 0};
+        test_vm_operand_t rdx = {.type = TEST_VM_OPERAND_TYPE_REGISTER, .reg = 2};
+
+        if(size == 1) {
+            // quotient at al, remainder at ah
+            rax.reg = 0;
+            ok = test_vm_write(vm, &rax, 2, (quotient & 0xFF) | (((dividend % divisor) & 0xFF) << 8));
+        } else {
+            ok = test_vm_write(vm, &rax, size, quotient) && test_vm_write(vm, &rdx, size, dividend % divisor);
+        }
+    } else if(strcmp(base, "cqo") == 0) {
+        vm->regs[2] = (int64_t)vm->regs[0] < 0 ? -1ULL : 0;
+    } else if(strcmp(base, "cdq") == 0) {
+        vm->regs[2] = (int32_t)vm->regs[0] < 0 ? 0xFFFFFFFFULL : 0;
+    } else if(strcmp(base, "cwd") == 0) {
+        vm->regs[2] = (vm->regs[2] & ~0xFFFFULL) | ((int16_t)vm->regs[0] < 0 ? 0xFFFF : 0);
+    } else if(strcmp(base, "bt") == 0) {
+        ok = test_vm_read(vm, src, 1, &b) && test_vm_read(vm, dst, size, &a);
+        vm->cf = (a >> (b & (size * 8 - 1))) & 1;
+    } else if(strncmp(base, "set", 3) == 0 && test_vm_is_condition(base + 3)) {
+        ok = test_vm_write(vm, dst, 1, test_vm_condition(vm, base + 3));
+    } else if(strcmp(base, "jmp") == 0 || (base[0] == 'j' && test_vm_is_condition(base + 1))) {
+        if(base[1] == 'm' || test_vm_condition(vm, base + 1)) {
+            ok = src->type == TEST_VM_OPERAND_TYPE_LABEL && src->value >= TEST_VM_CODE_BASE;
+            *pc = src->value - TEST_VM_CODE_BASE;
+        }
+    } else if(strcmp(base, "push") == 0) {
+        ok = test_vm_read(vm, src, 8, &a) && test_vm_push(vm, a);
+    } else if(strcmp(base, "pop") == 0) {
+        ok = test_vm_pop(vm, &a) && test_vm_write(vm, dst, 8, a);
+    } else if(strcmp(base, "enter") == 0) {
+        ok = test_vm_push(vm, vm->regs[5]);
+        vm->regs[5] = vm->regs[4];
+        vm->regs[4] -= src->value;
+    } else if(strcmp(base, "leave") == 0) {
+        vm->regs[4] = vm->regs[5];
+        ok = test_vm_pop(vm, &vm->regs[5]);
+    } else if(strcmp(base, "ret") == 0) {
+        ok = test_vm_pop(vm, &a);
+
+        if(a == TEST_VM_RETURN) {
+            *stop = true;
+        } else {
+            ok = ok && a >= TEST_VM_CODE_BASE && a - TEST_VM_CODE_BASE < vm->line_count;
+            *pc = a - TEST_VM_CODE_BASE;
+        }
+    } else if(strcmp(base, "call") == 0) {
+        // call *%reg holds target at register, call *(mem) at memory
+        if(src->type == TEST_VM_OPERAND_TYPE_LABEL) {
+            a = src->value;
+        } else {
+            ok = test_vm_read(vm, src, 8, &a);
+        }
+
+        if(ok && a >= TEST_VM_EXTERN_BASE && a < TEST_VM_EXTERN_BASE + vm->extern_count) {
+            ok = test_vm_call_extern(vm, a - TEST_VM_EXTERN_BASE);
+        } else if(ok && a >= TEST_VM_CODE_BASE && a - TEST_VM_CODE_BASE < vm->line_count) {
+            ok = test_vm_push(vm, TEST_VM_CODE_BASE + *pc);
+            *pc = a - TEST_VM_CODE_BASE;
+        } else {
+            ok = false;
+        }
+    } else {
+        test_vm_error(vm, line, "unknown instruction");
+
+        return false;
+    }
+
+    if(!ok) {
+        test_vm_error(vm, line, "cannot execute instruction");
+    }
+
+    return ok;
+}
+
+static void test_vm_destroy(test_vm_t* vm) {
+    memory_free(vm->lines);
+    memory_free(vm->memory);
+    memory_free(vm);
+}
+
+/**
+ * @brief runs program function of generated assembly, _start is skipped as it only calls program and exits
+ * @param[in] code generated assembly
+ * @param[in] name program name
+ * @return interpreter with output and result, NULL on error
+ */
+static test_vm_t* test_vm_run(const char_t* code, const char_t* name) {
+    test_vm_t* vm = memory_malloc(sizeof(test_vm_t));
+
+    if(vm == NULL) {
+        return NULL;
+    }
+
+    memory_memclean(vm, sizeof(test_vm_t));
+
+    if(!test_vm_load_code(vm, code)) {
+        print_error("cannot load generated code");
+        test_vm_destroy(vm);
+
+        return NULL;
+    }
+
+    int64_t idx = test_vm_find_symbol(vm, name, strlen(name));
+
+    if(idx == -1 || vm->symbols[idx].address < TEST_VM_CODE_BASE || vm->symbols[idx].address >= TEST_VM_EXTERN_BASE) {
+        print_error("cannot find program function");
+        test_vm_destroy(vm);
+
+        return NULL;
+    }
+
+    vm->regs[15] = TEST_VM_MEMORY_BASE;
+    vm->regs[4] = TEST_VM_MEMORY_BASE + TEST_VM_MEMORY_SIZE - 64;
+    vm->regs[5] = vm->regs[4];
+
+    uint64_t pc = vm->symbols[idx].address - TEST_VM_CODE_BASE;
+    boolean_t stop = false;
+
+    if(!test_vm_push(vm, TEST_VM_RETURN)) {
+        test_vm_destroy(vm);
+
+        return NULL;
+    }
+
+    while(!stop) {
+        if(pc >= vm->line_count || vm->steps++ == TEST_VM_MAX_STEPS || vm->regs[4] < vm->data_top) {
+            test_vm_error(vm, NULL, "program runs out of code, steps or stack");
+            test_vm_destroy(vm);
+
+            return NULL;
+        }
+
+        if(!test_vm_step(vm, &pc, &stop)) {
+            test_vm_destroy(vm);
+
+            return NULL;
+        }
+    }
+
+    // program result is a byte, upper bytes of returned slot are not written
+    vm->result = (int8_t)vm->regs[0];
+
+    return vm;
+}
+
+/**
+ * @brief compiles a pascal source
+ * @param[in] source pascal source
+ * @param[in] level optimization level
+ * @return generated assembly, NULL on error
+ */
+static char_t* test_compile(const char_t* source, compiler_optimization_level_t level) {
+    uint64_t size = strlen(source);
+    char_t* text = memory_malloc(size + 1);
+
+    if(text == NULL) {
+        return NULL;
+    }
+
+    memory_memcopy(source, text, size);
+
+    buffer_t* buffer = buffer_encapsulate((uint8_t*)text, size + 1);
+    pascal_lexer_t lexer = {0};
+    pascal_lexer_init(&lexer, buffer);
+
+    compiler_ast_t ast = {0};
+    compiler_ast_init(&ast);
+
+    pascal_parser_t parser = {0};
+    int8_t res = pascal_parser_init(&parser, &lexer);
+
+    if(res == 0) {
+        res = pascal_parser_parse(&parser, &ast);
+    }
+
+    pascal_parser_destroy(&parser);
+    buffer_destroy(buffer);
+    memory_free(text);
+
+    if(res != 0) {
+        print_error("cannot parse source");
+        compiler_ast_destroy(&ast);
+
+        return NULL;
+    }
+
+    compiler_t compiler = {0};
+
+    if(compiler_init(&compiler, &ast) != 0) {
+        print_error("cannot init compiler");
+        compiler_ast_destroy(&ast);
+
+        return NULL;
+    }
+
+    compiler.optimization_level = level;
+
+    int64_t result = 0;
+    char_t* out = NULL;
+
+    if(compiler_execute(&compiler, &result) == 0) {
+        uint64_t out_size = 0;
+        uint8_t* out_bytes = buffer_get_all_bytes(compiler.text_buffer, &out_size);
+
+        out = memory_malloc(out_size + 1);
+
+        if(out && out_bytes) {
+            memory_memcopy(out_bytes, out, out_size);
+        }
+
+        memory_free(out_bytes);
+    } else {
+        print_error("cannot compile source");
+    }
+
+    compiler_destroy(&compiler);
+
+    return out;
+}
+
+static const compiler_optimization_level_t test_levels[] = {
+    COMPILER_OPTIMIZATION_LEVEL_NONE,
+    COMPILER_OPTIMIZATION_LEVEL_BASIC,
+    COMPILER_OPTIMIZATION_LEVEL_FULL,
+};
+
+/**
+ * @brief compiles and runs a source at every optimization level, outputs and results must be same
+ * @param[in] title test title
+ * @param[in] source pascal source, program name must be t
+ * @param[in] expected expected printf arguments, NULL to only compare levels
+ * @param[in] expected_count expected argument count
+ * @param[out] codes generated assembly of each level if not NULL, caller frees
+ * @return true if all levels agree with each other and expected output
+ */
+static boolean_t test_run_levels(const char_t* title, const char_t* source, const int64_t* expected, uint64_t expected_count, char_t** codes) {
+    test_vm_t* first = NULL;
+    boolean_t pass = true;
+
+    for(uint64_t l = 0; l < sizeof(test_levels) / sizeof(test_levels[0]); l++) {
+        char_t* code = test_compile(source, test_levels[l]);
+        test_vm_t* vm = code ? test_vm_run(code, "t") : NULL;
+
+        if(codes) {
+            codes[l] = code;
+        } else {
+            memory_free(code);
+        }
+
+        if(vm == NULL) {
+            printf("%s: cannot run at level %lli\n", title, (int64_t)test_levels[l]);
+            pass = false;
+
+            continue;
+        }
+
+        if(first == NULL) {
+            first = vm;
+
+            continue;
+        }
+
+        boolean_t same = vm->result == first->result && vm->output_count == first->output_count;
+
+        for(uint64_t i = 0; same && i < vm->output_count; i++) {
+            same = vm->output[i] == first->output[i];
+        }
+
+        if(!same) {
+            printf("%s: level %lli differs, result %lli/%lli output count %lli/%lli\n", title, (int64_t)test_levels[l],
+                   vm->result, first->result, vm->output_count, first->output_count);
+            pass = false;
+        }
+
+        test_vm_destroy(vm);
+    }
+
+    if(first && expected) {
+        boolean_t same = first->output_count == expected_count;
+
+        for(uint64_t i = 0; same && i < expected_count; i++) {
+            if(first->output[i] != expected[i]) {
+                printf("%s: output %lli is %lli expected %lli\n", title, i, first->output[i], expected[i]);
+                same = false;
+            }
+        }
+
+        if(first->output_count != expected_count) {
+            printf("%s: output count %lli expected %lli\n", title, first->output_count, expected_count);
+        }
+
+        pass = pass && same;
+    }
+
+    if(first) {
+        printf("%s: %lli steps, %lli outputs, result %lli\n", title, first->steps, first->output_count, first->result);
+        test_vm_destroy(first);
+    } else {
+        pass = false;
+    }
+
+    return pass;
+}
+
+#endif
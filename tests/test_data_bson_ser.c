@@ -10,10 +10,15 @@
 #include <strings.h>
 #include <xxhash.h>
 
+#define TEST_BENCH_COUNT 20000ULL
+#define TEST_RECORD_COLUMN_COUNT 8
+
 uint32_t main(uint32_t argc, char_t** argv);
 int8_t   test_ser_deser_primitive(char_t* name, data_type_t dt, uint64_t datalen, void* data);
 int8_t   test_ser_deser_datalist(void);
 int8_t   test_ser_deser_recursive(void);
+int8_t   test_view(void);
+int8_t   test_benchmark_record(void);
 
 void print_hex(uint8_t* data, uint64_t len);
 void print_hex(uint8_t* data, uint64_t len) {
@@ -229,6 +234,224 @@ int8_t test_ser_deser_recursive(void) {
     return 0;
 }
 
+int8_t test_view(void) {
+    uint64_t numbers[] = {1, 2, 3, 0x1234567890ULL};
+    float64_t f = 2.5;
+    uint64_t fbits = 0;
+    memory_memcopy(&f, &fbits, sizeof(uint64_t));
+
+    data_t names[] = {
+        {DATA_TYPE_STRING, 0, NULL, (void*)"root"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"user"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"name"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"score"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"numbers"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"age"},
+    };
+    data_t user[] = {
+        {DATA_TYPE_STRING, 0, &names[2], (void*)"alice"},
+        {DATA_TYPE_FLOAT64, 0, &names[3], (void*)fbits},
+        {DATA_TYPE_INT16, 0, &names[5], (void*)0xBEEF},
+    };
+    data_t items[] = {
+        {DATA_TYPE_DATA, 3, &names[1], user},
+        {DATA_TYPE_INT64_ARRAY, 4, &names[4], numbers},
+        {DATA_TYPE_NULL, 0, NULL, NULL},
+    };
+    data_t root = {DATA_TYPE_DATA, 3, &names[0], items};
+
+    data_t* ser = data_bson_serialize(&root);
+
+    if(ser == NULL) {
+        print_error("TESTS FAILED cannot ser");
+
+        return -1;
+    }
+
+    data_bson_view_t v_root, v_item, v_name;
+    const char_t* str = NULL;
+    uint64_t len = 0, ival = 0;
+    float64_t fval = 0;
+    const uint64_t* arr = NULL;
+    int8_t res = 0;
+
+    if(data_bson_view_init(&v_root, ser) != 0 || v_root.type != DATA_TYPE_DATA || v_root.length != 3 ||
+       data_bson_view_get_name(&v_root, &v_name) != 0 || data_bson_view_get_string(&v_name, &str, &len) != 0 ||
+       len != 4 || memory_memcompare(str, "root", 4) != 0) {
+        print_error("TESTS FAILED view root mismatch");
+        res = -1;
+    }
+
+    if(data_bson_view_get_path(&v_root, "user.name", &v_item) != 0 || data_bson_view_get_string(&v_item, &str, &len) != 0 ||
+       len != 5 || memory_memcompare(str, "alice", 5) != 0) {
+        print_error("TESTS FAILED view string mismatch");
+        res = -1;
+    }
+
+    if(data_bson_view_get_path(&v_root, "user.score", &v_item) != 0 || data_bson_view_get_float(&v_item, &fval) != 0 || fval != 2.5) {
+        print_error("TESTS FAILED view float mismatch");
+        res = -1;
+    }
+
+    if(data_bson_view_get_path(&v_root, "user.age", &v_item) != 0 || data_bson_view_get_integer(&v_item, &ival) != 0 || ival != 0xBEEF) {
+        print_error("TESTS FAILED view integer mismatch");
+        res = -1;
+    }
+
+    if(data_bson_view_find(&v_root, "numbers", &v_item) != 0 || data_bson_view_get_array(&v_item, (const void**)&arr, &len) != 0 ||
+       len != 4 || arr[3] != 0x1234567890ULL) {
+        print_error("TESTS FAILED view array mismatch");
+        res = -1;
+    }
+
+    if(data_bson_view_get_child(&v_root, 2, &v_item) != 0 || v_item.type != DATA_TYPE_NULL ||
+       data_bson_view_get_name(&v_item, &v_name) == 0) {
+        print_error("TESTS FAILED view index mismatch");
+        res = -1;
+    }
+
+    if(data_bson_view_get_path(&v_root, "user.missing", &v_item) == 0 || data_bson_view_get_child(&v_root, 3, &v_item) == 0) {
+        print_error("TESTS FAILED view found missing item");
+        res = -1;
+    }
+
+    // every truncation must be rejected or stay inside the buffer
+    for(uint64_t cut = 0; cut < ser->length; cut++) {
+        data_t truncated = {DATA_TYPE_INT8_ARRAY, cut, NULL, ser->value};
+
+        if(data_bson_view_init(&v_root, &truncated) == 0) {
+            print_error("TESTS FAILED view accepted truncated data");
+            res = -1;
+            break;
+        }
+    }
+
+    data_t* dser = data_bson_deserialize(ser);
+    data_t* reser = data_bson_serialize(dser);
+
+    if(reser == NULL || reser->length != ser->length || memory_memcompare(reser->value, ser->value, ser->length) != 0) {
+        print_error("TESTS FAILED round trip mismatch");
+        res = -1;
+    }
+
+    data_free(reser);
+    data_free(dser);
+    data_free(ser);
+
+    return res;
+}
+
+static const char_t test_record_text[] = "the quick brown fox jumps over the lazy dog, twice";
+static uint8_t test_record_blob[128];
+
+static data_t test_record_names[TEST_RECORD_COLUMN_COUNT];
+static data_t test_record_columns[TEST_RECORD_COLUMN_COUNT];
+
+/* tosdb records are DATA lists whose items are named with INT64 column ids */
+static void test_build_record(data_t* record, uint64_t id) {
+    float64_t f = id * 0.5;
+    uint64_t fbits = 0;
+    memory_memcopy(&f, &fbits, sizeof(uint64_t));
+
+    data_t columns[TEST_RECORD_COLUMN_COUNT] = {
+        {DATA_TYPE_INT64, 0, NULL, (void*)id},
+        {DATA_TYPE_INT32, 0, NULL, (void*)(id * 3)},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"customer name"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)test_record_text},
+        {DATA_TYPE_FLOAT64, 0, NULL, (void*)fbits},
+        {DATA_TYPE_BOOLEAN, 0, NULL, (void*)(id & 1)},
+        {DATA_TYPE_INT8_ARRAY, sizeof(test_record_blob), NULL, test_record_blob},
+        {DATA_TYPE_INT64, 0, NULL, (void*)(id * 1000003)},
+    };
+
+    for(uint64_t i = 0; i < TEST_RECORD_COLUMN_COUNT; i++) {
+        test_record_names[i].type = DATA_TYPE_INT64;
+        test_record_names[i].value = (void*)(i + 1);
+        test_record_columns[i] = columns[i];
+        test_record_columns[i].name = &test_record_names[i];
+    }
+
+    record->type = DATA_TYPE_DATA;
+    record->length = TEST_RECORD_COLUMN_COUNT;
+    record->name = NULL;
+    record->value = test_record_columns;
+}
+
+int8_t test_benchmark_record(void) {
+    data_t record = {0};
+    uint64_t sum = 0;
+
+    test_build_record(&record, 42);
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_COUNT; i++) {
+        test_record_columns[0].value = (void*)i;
+
+        data_t* ser = data_bson_serialize(&record);
+
+        if(ser == NULL) {
+            print_error("TESTS FAILED cannot serialize record");
+
+            return -1;
+        }
+
+        sum += ser->length;
+
+        data_free(ser);
+    }
+
+    uint64_t end = time_ns(NULL);
+
+    printf("record serialize: %lli ns/op (%lli bytes)\n", (end - start) / TEST_BENCH_COUNT, sum / TEST_BENCH_COUNT);
+
+    data_t* ser = data_bson_serialize(&record);
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_COUNT; i++) {
+        data_t* dser = data_bson_deserialize(ser);
+
+        if(dser == NULL) {
+            print_error("TESTS FAILED cannot deserialize record");
+
+            return -1;
+        }
+
+        sum += (uint64_t)((data_t*)dser->value)[7].value;
+
+        data_free(dser);
+    }
+
+    end = time_ns(NULL);
+
+    printf("record deserialize and get column: %lli ns/op\n", (end - start) / TEST_BENCH_COUNT);
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_COUNT; i++) {
+        data_bson_view_t root, column;
+        uint64_t value = 0;
+
+        if(data_bson_view_init(&root, ser) != 0 || data_bson_view_find_by_id(&root, 8, &column) != 0 ||
+           data_bson_view_get_integer(&column, &value) != 0) {
+            print_error("TESTS FAILED cannot view record");
+
+            return -1;
+        }
+
+        sum += value;
+    }
+
+    end = time_ns(NULL);
+
+    printf("record view get column: %lli ns/op (%lli)\n", (end - start) / TEST_BENCH_COUNT, sum);
+
+    data_free(ser);
+
+    return 0;
+}
+
 uint32_t main(uint32_t argc, char_t** argv) {
 
     UNUSED(argc);
@@ -247,6 +470,10 @@ uint32_t main(uint32_t argc, char_t** argv) {
 
     res += test_ser_deser_recursive();
 
+    res += test_view();
+
+    res += test_benchmark_record();
+
     if(res == 0) {
         print_success("TESTS PASSED");
     }
@@ -3,6 +3,7 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE 0x4000000
 #include "setup.h"
 #include <data.h>
 #include <buffer.h>
@@ -10,29 +11,455 @@
 #include <strings.h>
 #include <xxhash.h>
 
+#define TEST_STREAM_DOC_COUNT 200ULL
+#define TEST_BENCH_RECORD_COUNT 20000ULL
+#define TEST_BENCH_NUMBER_COUNT 200000ULL
+
 uint32_t main(uint32_t argc, char_t** argv);
 
+static data_t* test_json_from_string(const char_t* json) {
+    data_t tmp = {DATA_TYPE_INT8_ARRAY, strlen(json), NULL, (void*)json};
+
+    return data_json_deserialize(&tmp);
+}
+
+static int8_t test_round_trip(data_t* data) {
+    data_t* ser_data = data_json_serialize(data);
+
+    if(ser_data == NULL) {
+        print_error("TESTS FAILED, cannot serialize");
+
+        return -1;
+    }
+
+    printf("Serialized data: %s\n", (char_t*)ser_data->value);
+
+    data_t* deser_data = data_json_deserialize(ser_data);
+
+    if(deser_data == NULL) {
+        data_free(ser_data);
+        print_error("TESTS FAILED, cannot deserialize");
+
+        return -1;
+    }
+
+    data_t* reser_data = data_json_serialize(deser_data);
+
+    int8_t res = 0;
+
+    if(reser_data == NULL || reser_data->length != ser_data->length ||
+       memory_memcompare(reser_data->value, ser_data->value, ser_data->length) != 0) {
+        print_error("TESTS FAILED, round trip mismatch");
+
+        res = -1;
+    }
+
+    data_free(reser_data);
+    data_free(deser_data);
+    data_free(ser_data);
+
+    return res;
+}
+
 static int8_t test_ser_deser_primitive(const char_t* name, data_type_t dt, uint64_t datalen, const void* data) {
     data_t tmp_name = {DATA_TYPE_STRING, 0, NULL, (void*)name};
     data_t tmp_data = {dt, datalen, &tmp_name, (void*)data};
 
+    return test_round_trip(&tmp_data);
+}
+
+static int8_t test_float(void) {
+    float64_t pi = 3.14159265359;
+    uint64_t picast = 0;
+    memory_memcopy(&pi, &picast, sizeof(uint64_t));
+
+    data_t tmp_name = {DATA_TYPE_STRING, 0, NULL, (void*)"pi"};
+    data_t tmp_data = {DATA_TYPE_FLOAT64, 0, &tmp_name, (void*)picast};
+
     data_t* ser_data = data_json_serialize(&tmp_data);
+    data_t* deser_data = data_json_deserialize(ser_data);
 
-    if(ser_data == NULL) {
-        print_error("TESTS FAILED, cannot serialize");
+    if(deser_data == NULL || deser_data->type != DATA_TYPE_FLOAT64) {
+        print_error("TESTS FAILED, cannot deserialize float");
 
         return -1;
     }
 
-    printf("Serialized data: %s\n", (char_t*)ser_data->value);
+    uint64_t val = (uint64_t)deser_data->value;
+    float64_t res = 0;
+    memory_memcopy(&val, &res, sizeof(uint64_t));
 
+    data_free(deser_data);
     data_free(ser_data);
 
+    if(res - pi > 1e-9 || pi - res > 1e-9) {
+        print_error("TESTS FAILED, float mismatch");
+
+        return -1;
+    }
 
     return 0;
 }
 
+static int8_t test_nested(void) {
+    uint64_t numbers[] = {1, 2, 3, 1234567890123ULL};
+    data_t names[] = {
+        {DATA_TYPE_STRING, 0, NULL, (void*)"str"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"num"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"arr"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"flag"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"nothing"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"inner"},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"escaped \"name\""},
+        {DATA_TYPE_STRING, 0, NULL, (void*)"root"},
+    };
+    data_t inner = {DATA_TYPE_STRING, 0, &names[6], (void*)"quote \" back \\ tab \t ctrl \x01 utf8 \xc4\x9f\xc3\xbc"};
+    data_t items[] = {
+        {DATA_TYPE_STRING, 0, &names[0], (void*)"hello"},
+        {DATA_TYPE_INT64, 0, &names[1], (void*)-5LL},
+        {DATA_TYPE_INT64_ARRAY, 4, &names[2], numbers},
+        {DATA_TYPE_BOOLEAN, 0, &names[3], (void*)true},
+        {DATA_TYPE_NULL, 0, &names[4], NULL},
+        {DATA_TYPE_DATA, 1, &names[5], &inner},
+    };
+    data_t root = {DATA_TYPE_DATA, 6, &names[7], items};
+
+    return test_round_trip(&root);
+}
+
+/**
+ * @brief builds an array nested depth times around a number
+ * @param[in] depth nesting
+ * @return json string
+ */
+static char_t* test_nested_json(uint64_t depth) {
+    char_t* json = memory_malloc(depth * 2 + 2);
+
+    if(json == NULL) {
+        return NULL;
+    }
+
+    for(uint64_t i = 0; i < depth; i++) {
+        json[i] = '[';
+        json[depth + 1 + i] = ']';
+    }
+
+    json[depth] = '1';
+
+    return json;
+}
+
+static int8_t test_depth(void) {
+    int8_t res = 0;
+    uint64_t depths[] = {DATA_JSON_MAX_DEPTH, DATA_JSON_MAX_DEPTH + 1, 100000};
+
+    for(uint64_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        char_t* json = test_nested_json(depths[i]);
+
+        if(json == NULL) {
+            print_error("TESTS FAILED, cannot build nested json");
+
+            return -1;
+        }
+
+        data_t* d = test_json_from_string(json);
+        boolean_t accepted = d != NULL;
+
+        data_free(d);
+
+        data_json_stream_t* stream = data_json_stream_new();
+
+        data_json_stream_feed(stream, (uint8_t*)json, strlen(json));
+        d = data_json_stream_next(stream);
+
+        boolean_t stream_accepted = d != NULL && !data_json_stream_has_error(stream);
+
+        data_free(d);
+        data_json_stream_destroy(stream);
+        memory_free(json);
+
+        // only nesting up to cap is parsed, deeper documents are errors before stack runs out
+        boolean_t expected = depths[i] <= DATA_JSON_MAX_DEPTH;
+
+        if(accepted != expected || stream_accepted != expected) {
+            printf("depth %lli accepted %i stream accepted %i\n", depths[i], accepted, stream_accepted);
+            print_error("TESTS FAILED, nesting cap mismatch");
+            res = -1;
+        }
+    }
+
+    return res;
+}
+
+static int8_t test_handwritten(void) {
+    const char_t* json = " { \"a\" : \"\\u00e7\\ud83d\\ude00\\/\" ,\n\t\"b\":[1, 2.5e1,-3 ], \"c\":true,\"d\":null,\"e\":[\"x\",{}] } ";
+    data_t* d = test_json_from_string(json);
+
+    if(d == NULL || d->type != DATA_TYPE_DATA || d->length != 5) {
+        print_error("TESTS FAILED, cannot parse handwritten json");
+
+        return -1;
+    }
+
+    data_t* items = d->value;
+    int8_t res = 0;
+
+    if(strcmp(items[0].name->value, "a") != 0 || strcmp(items[0].value, "\xc3\xa7\xf0\x9f\x98\x80/") != 0) {
+        print_error("TESTS FAILED, unicode escape mismatch");
+        res = -1;
+    }
+
+    if(items[1].type != DATA_TYPE_FLOAT64_ARRAY || items[1].length != 3 ||
+       ((float64_t*)items[1].value)[1] != 25.0 || ((float64_t*)items[1].value)[2] != -3.0) {
+        print_error("TESTS FAILED, number array mismatch");
+        res = -1;
+    }
+
+    if(items[2].type != DATA_TYPE_BOOLEAN || items[2].value != (void*)1 || items[3].type != DATA_TYPE_NULL) {
+        print_error("TESTS FAILED, literal mismatch");
+        res = -1;
+    }
+
+    if(items[4].type != DATA_TYPE_DATA || items[4].length != 2 || ((data_t*)items[4].value)[1].length != 0) {
+        print_error("TESTS FAILED, mixed array mismatch");
+        res = -1;
+    }
+
+    data_free(d);
+
+    const char_t* bad[] = {
+        "{\"a\":}", "{\"a\":1", "[1,2", "{\"a\":tru}", "{\"a\":truex}", "\"abc", "{\"a\":1}}",
+        "{\"a\" 1}", "{\"a\":\"\\q\"}", "{\"a\":\"\\u0000\"}", "{\"a\":\"\\ud83d\"}", "{\"a\":-}", "{\"a\":1.}", "",
+    };
+
+    for(uint64_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        data_t* b = test_json_from_string(bad[i]);
+
+        if(b != NULL) {
+            printf("accepted: %s\n", bad[i]);
+            print_error("TESTS FAILED, malformed json accepted");
+            data_free(b);
+            res = -1;
+        }
+    }
+
+    return res;
+}
+
+static int8_t test_in_situ(void) {
+    char_t json[] = "{\"key\":[{\"plain\":\"borrowed\"},{\"esc\":\"a\\nb\"}]}";
+    data_t tmp = {DATA_TYPE_INT8_ARRAY, strlen(json), NULL, json};
+
+    data_t* d = data_json_deserialize_in_situ(&tmp);
+
+    if(d == NULL || d->type != DATA_TYPE_DATA || d->length != 2) {
+        print_error("TESTS FAILED, cannot parse in situ");
+
+        return -1;
+    }
+
+    data_t* items = d->value;
+    char_t* plain = items[0].value;
+    char_t* esc = items[1].value;
+    int8_t res = 0;
+
+    if(plain < json || plain >= json + sizeof(json) || esc < json || esc >= json + sizeof(json) ||
+       strcmp(plain, "borrowed") != 0 || strcmp(esc, "a\nb") != 0 || strcmp(d->name->value, "key") != 0) {
+        print_error("TESTS FAILED, strings are not borrowed");
+        res = -1;
+    }
+
+    data_free_ext(d, false);
+
+    return res;
+}
+
+static data_t* test_name(const char_t* name) {
+    data_t* res = memory_malloc(sizeof(data_t));
+    res->type = DATA_TYPE_STRING;
+    res->value = strdup(name);
+
+    return res;
+}
+
+static data_t* test_build_record(uint64_t i) {
+    data_t* rec = memory_malloc(sizeof(data_t) * 3);
+    uint64_t* arr = memory_malloc(sizeof(uint64_t) * 4);
+    char_t* text = memory_malloc(32);
+
+    for(uint64_t j = 0; j < 4; j++) {
+        arr[j] = i * 4 + j;
+    }
+
+    char_t* num = utoa(i);
+    strcopy("line \"", text);
+    strcopy(num, text + 6);
+    memory_free(num);
+
+    rec[0] = (data_t){DATA_TYPE_INT64, 0, test_name("id"), (void*)i};
+    rec[1] = (data_t){DATA_TYPE_STRING, 0, test_name("text"), text};
+    rec[2] = (data_t){DATA_TYPE_INT64_ARRAY, 4, test_name("values"), arr};
+
+    data_t* res = memory_malloc(sizeof(data_t));
+    *res = (data_t){DATA_TYPE_DATA, 3, test_name("record"), rec};
+
+    return res;
+}
+
+static int8_t test_stream(void) {
+    buffer_t* buf = buffer_new();
+    data_t* docs[TEST_STREAM_DOC_COUNT];
+
+    for(uint64_t i = 0; i < TEST_STREAM_DOC_COUNT; i++) {
+        data_t* rec = test_build_record(i);
+        docs[i] = data_json_serialize(rec);
+        data_free(rec);
+
+        buffer_append_bytes(buf, docs[i]->value, docs[i]->length);
+        buffer_append_bytes(buf, (uint8_t*)"\n", 1);
+    }
+
+    uint64_t ndjson_len = 0;
+    uint8_t* ndjson = buffer_get_all_bytes_and_destroy(buf, &ndjson_len);
+
+    data_json_stream_t* stream = data_json_stream_new();
+    uint64_t doc_count = 0;
+    int8_t res = 0;
+
+    for(uint64_t pos = 0; pos < ndjson_len && res == 0; pos += 7) {
+        data_json_stream_feed(stream, ndjson + pos, MIN(7ULL, ndjson_len - pos));
+
+        data_t* d = NULL;
+
+        while(res == 0 && (d = data_json_stream_next(stream)) != NULL) {
+            data_t* reser = data_json_serialize(d);
+
+            if(doc_count >= TEST_STREAM_DOC_COUNT || reser == NULL || reser->length != docs[doc_count]->length ||
+               memory_memcompare(reser->value, docs[doc_count]->value, reser->length) != 0) {
+                print_error("TESTS FAILED, stream document mismatch");
+                res = -1;
+            }
+
+            doc_count++;
+
+            data_free(reser);
+            data_free(d);
+        }
+
+        if(data_json_stream_has_error(stream)) {
+            print_error("TESTS FAILED, stream error");
+            res = -1;
+        }
+    }
+
+    if(res == 0 && doc_count != TEST_STREAM_DOC_COUNT) {
+        printf("stream documents: %lli\n", doc_count);
+        print_error("TESTS FAILED, stream document count mismatch");
+        res = -1;
+    }
+
+    data_json_stream_destroy(stream);
+
+    stream = data_json_stream_new();
+    data_json_stream_feed(stream, (uint8_t*)"{\"a\":1}]", 8);
+    data_t* d = data_json_stream_next(stream);
+    data_free(d);
+
+    if(data_json_stream_next(stream) != NULL || !data_json_stream_has_error(stream)) {
+        print_error("TESTS FAILED, stream error not detected");
+        res = -1;
+    }
+
+    data_json_stream_destroy(stream);
+
+    for(uint64_t i = 0; i < TEST_STREAM_DOC_COUNT; i++) {
+        data_free(docs[i]);
+    }
+
+    memory_free(ndjson);
+
+    return res;
+}
+
+static int8_t test_benchmark(void) {
+    data_t* recs = memory_malloc(sizeof(data_t) * TEST_BENCH_RECORD_COUNT);
 
+    for(uint64_t i = 0; i < TEST_BENCH_RECORD_COUNT; i++) {
+        data_t* rec = test_build_record(i);
+        recs[i] = *rec;
+        memory_free(rec);
+    }
+
+    data_t* root = memory_malloc(sizeof(data_t));
+    *root = (data_t){DATA_TYPE_DATA, TEST_BENCH_RECORD_COUNT, test_name("records"), recs};
+
+    uint64_t start = time_ns(NULL);
+    data_t* ser = data_json_serialize(root);
+    uint64_t end = time_ns(NULL);
+
+    printf("serialize %lli bytes: %lli ms\n", ser->length, (end - start) / 1000000);
+
+    start = time_ns(NULL);
+    data_t* deser = data_json_deserialize(ser);
+    end = time_ns(NULL);
+
+    if(deser == NULL || deser->length != TEST_BENCH_RECORD_COUNT) {
+        print_error("TESTS FAILED, cannot deserialize benchmark data");
+
+        return -1;
+    }
+
+    printf("deserialize: %lli ms %lli MB/s\n", (end - start) / 1000000, ser->length / ((end - start) / 1000 + 1));
+
+    data_free(deser);
+
+    start = time_ns(NULL);
+    deser = data_json_deserialize_in_situ(ser);
+    end = time_ns(NULL);
+
+    if(deser == NULL || deser->length != TEST_BENCH_RECORD_COUNT) {
+        print_error("TESTS FAILED, cannot deserialize benchmark data in situ");
+
+        return -1;
+    }
+
+    printf("deserialize in situ: %lli ms %lli MB/s\n", (end - start) / 1000000, ser->length / ((end - start) / 1000 + 1));
+
+    data_free_ext(deser, false);
+    data_free(ser);
+    data_free(root);
+
+    // a single number array needs one allocation, shows parsing speed without allocator cost
+    uint64_t* numbers = memory_malloc(sizeof(uint64_t) * TEST_BENCH_NUMBER_COUNT);
+
+    for(uint64_t i = 0; i < TEST_BENCH_NUMBER_COUNT; i++) {
+        numbers[i] = i * 7919;
+    }
+
+    root = memory_malloc(sizeof(data_t));
+    *root = (data_t){DATA_TYPE_INT64_ARRAY, TEST_BENCH_NUMBER_COUNT, test_name("numbers"), numbers};
+    ser = data_json_serialize(root);
+
+    start = time_ns(NULL);
+    deser = data_json_deserialize(ser);
+    end = time_ns(NULL);
+
+    if(deser == NULL || deser->length != TEST_BENCH_NUMBER_COUNT ||
+       memory_memcompare(deser->value, numbers, sizeof(uint64_t) * TEST_BENCH_NUMBER_COUNT) != 0) {
+        print_error("TESTS FAILED, benchmark numbers mismatch");
+
+        return -1;
+    }
+
+    printf("deserialize %lli numbers %lli bytes: %lli ms %lli MB/s\n", TEST_BENCH_NUMBER_COUNT, ser->length,
+           (end - start) / 1000000, ser->length / ((end - start) / 1000 + 1));
+
+    data_free(deser);
+    data_free(ser);
+    data_free(root);
+
+    return 0;
+}
 
 uint32_t main(uint32_t argc, char_t** argv) {
     UNUSED(argc);
@@ -67,16 +494,26 @@ uint32_t main(uint32_t argc, char_t** argv) {
         return -1;
     }
 
-    float64_t pi = 3.14159265359;
-    float64_t* piptr = &pi;
-    uint64_t piptradr = (uint64_t)piptr;
-    uint64_t picast = *((uint64_t*)piptradr);
-    ret = test_ser_deser_primitive("test", DATA_TYPE_FLOAT64, 0, (void*)picast);
-    if(ret != 0) {
+    if(test_float() != 0 || test_nested() != 0 || test_handwritten() != 0 || test_in_situ() != 0 ||
+       test_depth() != 0) {
         print_error("TESTS FAILED");
 
         return -1;
     }
 
+    if(test_stream() != 0) {
+        print_error("TESTS FAILED");
+
+        return -1;
+    }
+
+    if(test_benchmark() != 0) {
+        print_error("TESTS FAILED");
+
+        return -1;
+    }
+
+    print_success("TESTS PASSED");
+
     return 0;
 }
@@ -0,0 +1,285 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x1000000
+#include "setup.h"
+#include <memory.h>
+#include <future.h>
+#include <utils.h>
+
+#define TEST_OUTSTANDING_COUNT 32ULL
+#define TEST_BENCH_ROUNDS      10000ULL
+#define TEST_TASK_ID           0x42ULL
+
+int32_t main(uint32_t argc, char_t** argv);
+
+/*! fake scheduler and device state, each yield completes one pending io as an interrupt would */
+static struct {
+    boolean_t  waiting;
+    uint64_t   wake_count;
+    uint64_t   yield_count;
+    uint64_t   bad_wake_count;
+    future_t** pending;
+    uint64_t   pending_count;
+    uint64_t   next_completion;
+    uint64_t   completion_stride;
+} test_sched;
+
+static uint64_t test_task_id_getter(void) {
+    return TEST_TASK_ID;
+}
+
+static void test_wait_begin(uint64_t timeout_ms) {
+    UNUSED(timeout_ms);
+    test_sched.waiting = true;
+}
+
+static void test_wait_end(void) {
+    test_sched.waiting = false;
+}
+
+static void test_waker(uint64_t task_id) {
+    if(task_id != TEST_TASK_ID) {
+        test_sched.bad_wake_count++;
+    }
+
+    if(test_sched.waiting) {
+        test_sched.waiting = false;
+        test_sched.wake_count++;
+    }
+}
+
+static void test_yielder(void) {
+    test_sched.yield_count++;
+
+    if(test_sched.next_completion < test_sched.pending_count) {
+        // completion order differs from submission order like a queued device
+        uint64_t idx = (test_sched.next_completion * test_sched.completion_stride) % test_sched.pending_count;
+        test_sched.next_completion++;
+        future_signal(test_sched.pending[idx]);
+    }
+
+    // a parked task is not scheduled until woken
+    if(test_sched.waiting && test_sched.next_completion >= test_sched.pending_count) {
+        test_sched.bad_wake_count++;
+        test_sched.waiting = false;
+    }
+}
+
+static void test_install_hooks(boolean_t install) {
+    future_task_id_getter_func = install ? &test_task_id_getter : NULL;
+    future_task_wait_begin_func = install ? &test_wait_begin : NULL;
+    future_task_wait_end_func = install ? &test_wait_end : NULL;
+    future_task_waker_func = install ? &test_waker : NULL;
+    future_task_yielder_func = install ? &test_yielder : NULL;
+}
+
+static void test_callback(void* data, void* arg) {
+    uint64_t* sum = arg;
+
+    *sum += (uint64_t)data;
+}
+
+static boolean_t test_basic(void) {
+    boolean_t pass = true;
+    uint64_t sum = 0;
+
+    future_t* fut = future_create_with_data((void*)0x10);
+
+    if(!fut) {
+        print_error("cannot create future");
+
+        return false;
+    }
+
+    if(future_is_completed(fut)) {
+        print_error("new future is completed");
+        pass = false;
+    }
+
+    if(future_set_callback(fut, &test_callback, &sum) != 0 || future_set_callback(fut, &test_callback, &sum) != -1) {
+        print_error("callback set mismatch");
+        pass = false;
+    }
+
+    if(future_wait(fut, 5) != -1) {
+        print_error("wait did not time out");
+        pass = false;
+    }
+
+    if(future_signal(fut) != 0 || sum != 0x10) {
+        print_error("signal did not run callback");
+        pass = false;
+    }
+
+    if(future_get_data_and_destroy(fut) != (void*)0x10) {
+        print_error("future data mismatch");
+        pass = false;
+    }
+
+    // callback set after completion runs immediately, consumer reference keeps future alive
+    fut = future_create_with_data((void*)0x20);
+    future_signal(fut);
+
+    if(future_signal(fut) != -1) {
+        print_error("double signal accepted");
+        pass = false;
+    }
+
+    if(future_set_callback(fut, &test_callback, &sum) != 0 || sum != 0x30) {
+        print_error("late callback did not run");
+        pass = false;
+    }
+
+    if(future_wait(fut, FUTURE_WAIT_FOREVER) != 0) {
+        print_error("wait on completed future failed");
+        pass = false;
+    }
+
+    future_get_data_and_destroy(fut);
+
+    return pass;
+}
+
+static boolean_t test_sets(void) {
+    boolean_t pass = true;
+    future_t* futs[4] = {0};
+
+    for(uint64_t i = 0; i < 4; i++) {
+        futs[i] = future_create_with_data((void*)(i + 1));
+    }
+
+    if(future_wait_any(futs, 4, 2) != -1 || future_wait_all(futs, 4, 2) != -1) {
+        print_error("set wait did not time out");
+        pass = false;
+    }
+
+    future_signal(futs[2]);
+
+    if(future_wait_any(futs, 4, FUTURE_WAIT_FOREVER) != 2) {
+        print_error("wait any index mismatch");
+        pass = false;
+    }
+
+    if(future_wait_all(futs, 4, 2) != -1) {
+        print_error("wait all returned early");
+        pass = false;
+    }
+
+    future_signal(futs[0]);
+    future_signal(futs[1]);
+    future_signal(futs[3]);
+
+    if(future_wait_all(futs, 4, FUTURE_WAIT_FOREVER) != 0) {
+        print_error("wait all failed");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 4; i++) {
+        future_get_data_and_destroy(futs[i]);
+    }
+
+    if(future_wait_any(NULL, 4, 1) != -1 || future_wait_all(futs, 0, 1) != -1) {
+        print_error("invalid set accepted");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_outstanding(boolean_t bench) {
+    boolean_t pass = true;
+    future_t* futs[TEST_OUTSTANDING_COUNT] = {0};
+    uint64_t rounds = bench ? TEST_BENCH_ROUNDS : 1;
+
+    test_install_hooks(true);
+    memory_memclean(&test_sched, sizeof(test_sched));
+    test_sched.pending = futs;
+    test_sched.pending_count = TEST_OUTSTANDING_COUNT;
+    test_sched.completion_stride = 7;
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t r = 0; r < rounds && pass; r++) {
+        for(uint64_t i = 0; i < TEST_OUTSTANDING_COUNT; i++) {
+            futs[i] = future_create();
+        }
+
+        test_sched.next_completion = 0;
+
+        // wait for first completion, then the rest
+        int64_t first = future_wait_any(futs, TEST_OUTSTANDING_COUNT, FUTURE_WAIT_FOREVER);
+
+        if(first != 0) {
+            print_error("first completion index mismatch");
+            pass = false;
+        }
+
+        if(future_wait_all(futs, TEST_OUTSTANDING_COUNT, FUTURE_WAIT_FOREVER) != 0) {
+            print_error("wait all failed");
+            pass = false;
+        }
+
+        for(uint64_t i = 0; i < TEST_OUTSTANDING_COUNT; i++) {
+            future_get_data_and_destroy(futs[i]);
+        }
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    if(test_sched.bad_wake_count) {
+        print_error("waiter was not woken by its futures");
+        pass = false;
+    }
+
+    // every completion but the ones seen before parking wakes the waiter exactly once
+    if(test_sched.yield_count != rounds * TEST_OUTSTANDING_COUNT || test_sched.wake_count != test_sched.yield_count) {
+        printf("yields %lli wakes %lli\n", test_sched.yield_count, test_sched.wake_count);
+        print_error("wake count mismatch");
+        pass = false;
+    }
+
+    if(bench) {
+        uint64_t completions = rounds * TEST_OUTSTANDING_COUNT;
+
+        printf("%lli outstanding futures: %lli ns per completion (create, signal, wake, destroy)\n",
+               TEST_OUTSTANDING_COUNT, elapsed / completions);
+    }
+
+    test_install_hooks(false);
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    memory_heap_stat_t stat_before = {0};
+    memory_get_heap_stat(&stat_before);
+
+    pass &= test_basic();
+    pass &= test_sets();
+    pass &= test_outstanding(false);
+    pass &= test_outstanding(true);
+
+    memory_heap_stat_t stat_after = {0};
+    memory_get_heap_stat(&stat_after);
+
+    if(stat_after.malloc_count - stat_before.malloc_count != stat_after.free_count - stat_before.free_count) {
+        print_error("memory leak");
+        pass = false;
+    }
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
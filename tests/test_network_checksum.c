@@ -0,0 +1,327 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x8000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_checksum.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_ipv4.h>
+#include <network/network_udpv4.h>
+#include <bplustree.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_BUFFER_SIZE      ((2ULL << 20) + 77)
+#define TEST_BENCH_SIZE       (64ULL << 10)
+#define TEST_BENCH_ITERATIONS 2048ULL
+#define TEST_PACKET_SIZE      1480ULL
+#define TEST_PACKET_ITERATIONS 200000ULL
+
+int32_t  main(uint32_t argc, char_t** argv);
+uint64_t test_network_info_mke(const void* key);
+
+map_t* network_info_map = NULL;
+
+static network_mac_address_t test_our_mac = {0x52, 0x54, 0x00, 0x12, 0x34, 0x56};
+static network_ipv4_address_t test_our_ip = { .as_bytes = {10, 0, 2, 15} };
+static network_ipv4_address_t test_peer_ip = { .as_bytes = {10, 0, 2, 2} };
+
+static uint64_t test_seed = 0x2545F4914F6CDD1DULL;
+
+uint64_t test_network_info_mke(const void* key) {
+    uint64_t x = 0;
+    memory_memcopy(key, &x, sizeof(network_mac_address_t));
+
+    return x;
+}
+
+static uint32_t test_random(void) {
+    test_seed = test_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return test_seed >> 33;
+}
+
+// reference sum, a word at a time as rfc 1071 describes
+static uint16_t test_reference_sum(const uint8_t* data, uint64_t len, uint32_t sum) {
+    for(uint64_t i = 0; i + 1 < len; i += 2) {
+        sum += (data[i + 1] << 8) | data[i];
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    if(len & 1) {
+        sum += data[len - 1];
+    }
+
+    while(sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return sum;
+}
+
+static boolean_t test_sums(uint8_t* buffer) {
+    boolean_t pass = true;
+
+    for(uint64_t i = 0; i < TEST_BUFFER_SIZE; i++) {
+        buffer[i] = test_random();
+    }
+
+    // every length and alignment around scalar, tail and vector boundaries
+    for(uint64_t offset = 0; offset < 8 && pass; offset++) {
+        for(uint64_t len = 0; len < 1100 && pass; len++) {
+            if(network_checksum_partial(buffer + offset, len, 0) != test_reference_sum(buffer + offset, len, 0)) {
+                printf("offset %lli len %lli\n", offset, len);
+                print_error("partial sum differs from reference");
+                pass = false;
+            }
+        }
+    }
+
+    // lanes of vector path are flushed for long buffers, all ones is the largest sum
+    memory_memset(buffer + TEST_BUFFER_SIZE / 2, 0xFF, TEST_BUFFER_SIZE / 2);
+
+    for(uint64_t len = TEST_BUFFER_SIZE - 3; len <= TEST_BUFFER_SIZE && pass; len++) {
+        if(network_checksum_partial(buffer, len, 0) != test_reference_sum(buffer, len, 0) ||
+           network_checksum_partial(buffer + TEST_BUFFER_SIZE - len, len, 0) != test_reference_sum(buffer + TEST_BUFFER_SIZE - len, len, 0)) {
+            printf("len %lli\n", len);
+            print_error("large partial sum differs from reference");
+            pass = false;
+        }
+    }
+
+    if(network_checksum_partial(buffer, 100, 0x1234) != test_reference_sum(buffer, 100, 0x1234)) {
+        print_error("initial sum is not added");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_combine_and_copy(uint8_t* buffer) {
+    boolean_t pass = true;
+    uint8_t* copy = buffer + TEST_BUFFER_SIZE / 2;
+
+    for(uint32_t i = 0; i < 2000 && pass; i++) {
+        uint64_t len = test_random() % 9000;
+        uint64_t split = len ? test_random() % len : 0;
+        uint64_t offset = test_random() % 64;
+
+        uint16_t expected = test_reference_sum(buffer + offset, len, 0);
+        uint16_t first = network_checksum_partial(buffer + offset, split, 0);
+        uint16_t second = network_checksum_partial(buffer + offset + split, len - split, 0);
+
+        if(network_checksum_combine(first, second, split) != expected) {
+            printf("len %lli split %lli\n", len, split);
+            print_error("combined sum differs from reference");
+            pass = false;
+        }
+
+        memory_memset(copy, 0, len + 64);
+
+        uint16_t copied = network_checksum_copy(buffer + offset, copy + (offset ^ 7), len, 0);
+
+        if(copied != expected || memory_memcompare(buffer + offset, copy + (offset ^ 7), len) != 0 || copy[(offset ^ 7) + len] != 0) {
+            printf("len %lli\n", len);
+            print_error("copy and checksum is wrong");
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+static boolean_t test_update(uint8_t* buffer) {
+    boolean_t pass = true;
+
+    for(uint32_t i = 0; i < 10000 && pass; i++) {
+        uint64_t len = 20 + (test_random() % 64) * 2;
+        uint64_t field = (test_random() % (len / 2 - 2)) * 2;
+        uint8_t* header = buffer + (test_random() % 1024);
+
+        for(uint64_t j = 0; j < len; j++) {
+            header[j] = test_random();
+        }
+
+        uint16_t checksum = network_checksum(header, len);
+        uint32_t old_value = 0;
+        uint32_t new_value = test_random();
+
+        memory_memcopy(header + field, &old_value, sizeof(uint32_t));
+
+        if(i & 1) {
+            memory_memcopy(&new_value, header + field, sizeof(uint16_t));
+            checksum = network_checksum_update16(checksum, old_value & 0xFFFF, new_value & 0xFFFF);
+        } else {
+            memory_memcopy(&new_value, header + field, sizeof(uint32_t));
+            checksum = network_checksum_update32(checksum, old_value, new_value);
+        }
+
+        if(checksum != network_checksum(header, len)) {
+            printf("len %lli field %lli\n", len, field);
+            print_error("incremental update differs from full checksum");
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+static boolean_t test_pseudo_header_and_offload(void) {
+    boolean_t pass = true;
+    uint32_t pseudo = test_peer_ip.as_words[0] + test_peer_ip.as_words[1] + test_our_ip.as_words[0] + test_our_ip.as_words[1] +
+                      BYTE_SWAP16(NETWORK_IPV4_PROTOCOL_UDPV4) + BYTE_SWAP16(1001);
+
+    if(network_checksum_pseudo_header(test_peer_ip, test_our_ip, NETWORK_IPV4_PROTOCOL_UDPV4, 1001) != test_reference_sum(NULL, 0, pseudo)) {
+        print_error("pseudo header sum is wrong");
+        pass = false;
+    }
+
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, 4, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    for(int32_t offload = 0; offload < 2; offload++) {
+        network_info_set_tx_checksum_offload(&test_our_mac, offload);
+
+        network_packet_t* packet = network_packet_alloc(pool, 1001);
+        uint8_t* data = network_packet_put(packet, 1001 - sizeof(network_udpv4_header_t));
+
+        for(uint32_t i = 0; i < 1001 - sizeof(network_udpv4_header_t); i++) {
+            data[i] = test_random();
+        }
+
+        packet->network_info = test_our_mac;
+
+        network_udpv4_push_header(packet, test_our_ip, test_peer_ip, 7, 40000);
+
+        if(!!(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_OFFLOAD) != offload) {
+            print_error("offload flag does not follow nic capability");
+            pass = false;
+        }
+
+        // nic completes checksum, done in software here
+        network_checksum_complete_offload(packet);
+
+        uint16_t sum = network_checksum_pseudo_header(test_our_ip, test_peer_ip, NETWORK_IPV4_PROTOCOL_UDPV4, packet->length);
+
+        if(network_checksum_partial(network_packet_data(packet), packet->length, sum) != 0xFFFF ||
+           (packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_OFFLOAD)) {
+            printf("offload %i\n", offload);
+            print_error("udp checksum does not verify");
+            pass = false;
+        }
+
+        network_packet_release(packet);
+    }
+
+    network_info_set_tx_checksum_offload(&test_our_mac, false);
+    network_packet_pool_destroy(pool);
+
+    return pass;
+}
+
+static uint64_t test_rate(uint64_t bytes, uint64_t elapsed) {
+    if(elapsed == 0) {
+        elapsed = 1;
+    }
+
+    return bytes * 1000ULL / elapsed;
+}
+
+static boolean_t test_throughput(uint8_t* buffer) {
+    uint8_t* copy = buffer + TEST_BUFFER_SIZE / 2;
+    uint64_t bytes = TEST_BENCH_SIZE * TEST_BENCH_ITERATIONS;
+    volatile uint16_t sink = 0;
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_ITERATIONS; i++) {
+        sink += test_reference_sum(buffer, TEST_BENCH_SIZE, 0);
+    }
+
+    uint64_t reference = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_ITERATIONS; i++) {
+        sink += network_checksum_partial(buffer, TEST_BENCH_SIZE, 0);
+    }
+
+    uint64_t sum = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_ITERATIONS; i++) {
+        memory_memcopy(buffer, copy, TEST_BENCH_SIZE);
+        sink += network_checksum_partial(copy, TEST_BENCH_SIZE, 0);
+    }
+
+    uint64_t copy_then_sum = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_ITERATIONS; i++) {
+        sink += network_checksum_copy(buffer, copy, TEST_BENCH_SIZE, 0);
+    }
+
+    uint64_t copy_and_sum = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_PACKET_ITERATIONS; i++) {
+        sink += network_checksum_partial(buffer + (i & 63), TEST_PACKET_SIZE, 0);
+    }
+
+    uint64_t packets = time_ns(NULL) - start;
+
+    UNUSED(sink);
+
+    printf("%lli KB buffers: reference %lli MB/s, checksum %lli MB/s, copy then checksum %lli MB/s, copy and checksum %lli MB/s\n",
+           TEST_BENCH_SIZE >> 10, test_rate(bytes, reference), test_rate(bytes, sum),
+           test_rate(bytes, copy_then_sum), test_rate(bytes, copy_and_sum));
+    printf("%lli byte payloads: %lli MB/s, %lli packets/s\n", TEST_PACKET_SIZE,
+           test_rate(TEST_PACKET_SIZE * TEST_PACKET_ITERATIONS, packets), TEST_PACKET_ITERATIONS * 1000000000ULL / (packets ? packets : 1));
+
+    return true;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    network_info_map = map_new(&test_network_info_mke);
+
+    uint8_t* buffer = memory_malloc(TEST_BUFFER_SIZE);
+
+    if(buffer == NULL) {
+        print_error("cannot allocate buffer");
+
+        return -1;
+    }
+
+    pass &= test_sums(buffer);
+    pass &= test_combine_and_copy(buffer);
+    pass &= test_update(buffer);
+    pass &= test_pseudo_header_and_offload();
+    pass &= test_throughput(buffer);
+
+    memory_free(buffer);
+
+    // set offload creates network info of nic
+    network_info_t* ni = (network_info_t*)map_get(network_info_map, test_our_mac);
+
+    map_destroy(network_info_map);
+    memory_free(ni);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
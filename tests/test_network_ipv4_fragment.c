@@ -0,0 +1,665 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x8000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_ethernet.h>
+#include <network/network_ipv4.h>
+#include <network/network_ipv4_fragment.h>
+#include <network/network_udpv4.h>
+#include <network/network_tcpv4.h>
+#include <bplustree.h>
+#include <random.h>
+#include <utils.h>
+
+#define TEST_POOL_SIZE           1024ULL
+#define TEST_FRAGMENT_SIZE       1480
+#define TEST_DATAGRAM_SIZE       4000
+#define TEST_FLOOD_FRAGMENTS     200000ULL
+#define TEST_FLOOD_LEGIT_EVERY   100
+#define TEST_ECHO_PAYLOAD_SIZE   3000
+
+int32_t  main(uint32_t argc, char_t** argv);
+uint64_t test_network_info_mke(const void* key);
+
+map_t* network_info_map = NULL;
+
+static network_mac_address_t test_our_mac = {0x52, 0x54, 0x00, 0x12, 0x34, 0x56};
+static network_mac_address_t test_peer_mac = {0x52, 0x54, 0x00, 0xAB, 0xCD, 0xEF};
+static network_ipv4_address_t test_our_ip = { .as_bytes = {10, 0, 2, 15} };
+static network_ipv4_address_t test_peer_ip = { .as_bytes = {10, 0, 2, 2} };
+static network_ipv4_address_t test_attacker_ip = { .as_bytes = {10, 0, 2, 66} };
+
+uint64_t test_network_info_mke(const void* key) {
+    uint64_t x = 0;
+    memory_memcopy(key, &x, sizeof(network_mac_address_t));
+
+    return x;
+}
+
+static uint8_t test_pattern(uint16_t id, uint32_t offset) {
+    return (uint8_t)(offset * 7 + id);
+}
+
+/*! builds a fragment as ipv4 leaves it, header at headroom and data at payload */
+static network_packet_t* test_fragment(network_packet_pool_t* pool, network_ipv4_address_t sip, uint16_t id,
+                                       uint32_t offset, uint32_t len, boolean_t more, int16_t fill,
+                                       network_ipv4_header_t** header) {
+    network_packet_t* packet = network_packet_alloc(pool, sizeof(network_ipv4_header_t) + len);
+    uint8_t* data = network_packet_put(packet, sizeof(network_ipv4_header_t) + len);
+
+    if(data == NULL) {
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    network_ipv4_header_t* ip = (network_ipv4_header_t*)data;
+
+    memory_memclean(ip, sizeof(network_ipv4_header_t));
+
+    ip->version = NETWORK_IPV4_VERSION;
+    ip->header_length = 5;
+    ip->total_length = BYTE_SWAP16(sizeof(network_ipv4_header_t) + len);
+    ip->identification = id;
+    ip->protocol = NETWORK_IPV4_PROTOCOL_UDPV4;
+    ip->source_ip = sip;
+    ip->destination_ip = test_our_ip;
+    ip->flags_fragment_offset.fields.fragment_offset = offset >> 3;
+    ip->flags_fragment_offset.fields.flags = more ? NETWORK_IPV4_FLAG_MORE_FRAGMENTS : 0;
+
+    for(uint32_t i = 0; i < len; i++) {
+        data[sizeof(network_ipv4_header_t) + i] = fill < 0 ? test_pattern(id, offset + i) : (uint8_t)fill;
+    }
+
+    network_packet_pull(packet, sizeof(network_ipv4_header_t));
+
+    *header = ip;
+
+    return packet;
+}
+
+static network_packet_t* test_input(network_packet_pool_t* pool, network_ipv4_address_t sip, uint16_t id,
+                                    uint32_t offset, uint32_t len, boolean_t more, int16_t fill, uint64_t now) {
+    network_ipv4_header_t* header = NULL;
+    network_packet_t* packet = test_fragment(pool, sip, id, offset, len, more, fill, &header);
+
+    if(packet == NULL) {
+        return NULL;
+    }
+
+    return network_ipv4_fragment_input(packet, header, now);
+}
+
+static boolean_t test_check_datagram(network_packet_t* packet, uint16_t id, uint32_t len) {
+    if(packet == NULL || packet->length != len) {
+        return false;
+    }
+
+    const uint8_t* data = network_packet_data(packet);
+
+    for(uint32_t i = 0; i < len; i++) {
+        if(data[i] != test_pattern(id, i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static boolean_t test_check_idle(network_packet_pool_t* pool, const char_t* name) {
+    network_ipv4_fragment_stats_t stats = {0};
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.datagrams != 0 || stats.memory_used != 0 || network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE) {
+        printf("%s: datagrams %lli memory %lli free packets %lli\n", name, stats.datagrams, stats.memory_used,
+               network_packet_pool_get_free_count(pool));
+        print_error("fragments are left");
+
+        return false;
+    }
+
+    return true;
+}
+
+static boolean_t test_orders(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    const uint8_t orders[3][3] = {{0, 1, 2}, {2, 1, 0}, {1, 2, 0}};
+
+    network_ipv4_fragment_init(NULL);
+
+    for(uint16_t o = 0; o < 3; o++) {
+        uint16_t id = 100 + o;
+        network_packet_t* result = NULL;
+
+        for(uint8_t i = 0; i < 3; i++) {
+            uint32_t offset = orders[o][i] * TEST_FRAGMENT_SIZE;
+            uint32_t len = MIN((uint32_t)TEST_FRAGMENT_SIZE, TEST_DATAGRAM_SIZE - offset);
+            boolean_t more = offset + len < TEST_DATAGRAM_SIZE;
+
+            if(result) {
+                print_error("datagram completed early");
+                pass = false;
+            }
+
+            result = test_input(pool, test_peer_ip, id, offset, len, more, -1, 0);
+        }
+
+        if(!test_check_datagram(result, id, TEST_DATAGRAM_SIZE)) {
+            printf("order %i\n", o);
+            print_error("reassembled datagram is wrong");
+            pass = false;
+        }
+
+        network_packet_release(result);
+    }
+
+    network_ipv4_fragment_stats_t stats = {0};
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.reassembled != 3 || stats.fragments != 9) {
+        print_error("reassembly stats are wrong");
+        pass = false;
+    }
+
+    pass &= test_check_idle(pool, "orders");
+
+    return pass;
+}
+
+static boolean_t test_duplicates_and_overlaps(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_ipv4_fragment_stats_t stats = {0};
+
+    // exact duplicate is ignored, datagram completes
+    network_ipv4_fragment_init(NULL);
+
+    test_input(pool, test_peer_ip, 1, 0, 16, true, -1, 0);
+    test_input(pool, test_peer_ip, 1, 0, 16, true, -1, 0);
+
+    network_packet_t* result = test_input(pool, test_peer_ip, 1, 16, 10, false, -1, 0);
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(!test_check_datagram(result, 1, 26) || stats.duplicates != 1 || stats.overlaps != 0) {
+        print_error("duplicate fragment is not ignored");
+        pass = false;
+    }
+
+    network_packet_release(result);
+
+    // default policy drops datagram
+    test_input(pool, test_peer_ip, 2, 0, 16, true, 'A', 0);
+    test_input(pool, test_peer_ip, 2, 8, 16, true, 'B', 0);
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.overlaps != 1 || stats.datagrams != 0) {
+        print_error("overlapping datagram is not dropped");
+        pass = false;
+    }
+
+    pass &= test_check_idle(pool, "drop policy");
+
+    // first and last policies
+    for(uint8_t p = 0; p < 2; p++) {
+        network_ipv4_fragment_config_t config = {
+            .overlap_policy = p == 0 ? NETWORK_IPV4_FRAGMENT_OVERLAP_FIRST : NETWORK_IPV4_FRAGMENT_OVERLAP_LAST,
+        };
+
+        network_ipv4_fragment_init(&config);
+
+        test_input(pool, test_peer_ip, 3, 0, 16, true, 'A', 0);
+        result = test_input(pool, test_peer_ip, 3, 8, 16, false, 'B', 0);
+
+        const uint8_t* data = result ? network_packet_data(result) : NULL;
+        uint32_t split = p == 0 ? 16 : 8;
+
+        if(data == NULL || result->length != 24) {
+            print_error("overlapping datagram is not reassembled");
+            pass = false;
+        } else {
+            for(uint32_t i = 0; i < 24; i++) {
+                if(data[i] != (i < split ? 'A' : 'B')) {
+                    printf("policy %i byte %i is %c\n", p, i, data[i]);
+                    print_error("overlap policy is not applied");
+                    pass = false;
+
+                    break;
+                }
+            }
+        }
+
+        network_packet_release(result);
+
+        // last fragment ending at received end brings no byte, it still closes trailing hole
+        test_input(pool, test_peer_ip, 4, 0, 16, true, 'A', 0);
+        test_input(pool, test_peer_ip, 4, 16, 8, true, 'A', 0);
+        result = test_input(pool, test_peer_ip, 4, 8, 16, false, 'B', 0);
+        data = result ? network_packet_data(result) : NULL;
+        split = p == 0 ? 24 : 8;
+
+        if(data == NULL || result->length != 24) {
+            print_error("covered last fragment does not complete datagram");
+            pass = false;
+        } else {
+            for(uint32_t i = 0; i < 24; i++) {
+                if(data[i] != (i < split ? 'A' : 'B')) {
+                    printf("policy %i byte %i is %c\n", p, i, data[i]);
+                    print_error("overlap policy is not applied to covered last fragment");
+                    pass = false;
+
+                    break;
+                }
+            }
+        }
+
+        network_packet_release(result);
+
+        // same range as a received fragment is not a duplicate when it is the last one
+        test_input(pool, test_peer_ip, 5, 0, 16, true, -1, 0);
+        test_input(pool, test_peer_ip, 5, 16, 8, true, -1, 0);
+        result = test_input(pool, test_peer_ip, 5, 16, 8, false, -1, 0);
+
+        if(!test_check_datagram(result, 5, 24)) {
+            print_error("repeated range as last fragment does not complete datagram");
+            pass = false;
+        }
+
+        network_packet_release(result);
+
+        pass &= test_check_idle(pool, "overlap policy");
+    }
+
+    return pass;
+}
+
+static boolean_t test_timeout(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_ipv4_fragment_stats_t stats = {0};
+    uint64_t now = 100000;
+
+    network_ipv4_fragment_init(NULL);
+
+    test_input(pool, test_peer_ip, 5, 0, TEST_FRAGMENT_SIZE, true, -1, now);
+    test_input(pool, test_peer_ip, 6, TEST_FRAGMENT_SIZE, TEST_FRAGMENT_SIZE, false, -1, now + 1000);
+
+    network_ipv4_fragment_process_timers(now + NETWORK_IPV4_FRAGMENT_TIMEOUT_MS - 1);
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.datagrams != 2 || stats.timed_out != 0) {
+        print_error("datagram expired early");
+        pass = false;
+    }
+
+    network_ipv4_fragment_process_timers(now + NETWORK_IPV4_FRAGMENT_TIMEOUT_MS);
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.datagrams != 1 || stats.timed_out != 1) {
+        print_error("datagram is not expired");
+        pass = false;
+    }
+
+    // clock jumps over whole wheel
+    network_ipv4_fragment_process_timers(now + NETWORK_IPV4_FRAGMENT_TIMEOUT_MS * 10);
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.timed_out != 2) {
+        print_error("datagram is not expired after clock jump");
+        pass = false;
+    }
+
+    pass &= test_check_idle(pool, "timeout");
+
+    return pass;
+}
+
+static boolean_t test_malformed(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_ipv4_fragment_stats_t stats = {0};
+
+    network_ipv4_fragment_init(NULL);
+
+    // middle fragment length is not multiple of 8
+    test_input(pool, test_peer_ip, 7, 0, 10, true, -1, 0);
+
+    // fragment after last byte
+    test_input(pool, test_peer_ip, 8, 16, 16, false, -1, 0);
+    test_input(pool, test_peer_ip, 8, 32, 8, true, -1, 0);
+
+    // end of datagram before received bytes
+    test_input(pool, test_peer_ip, 9, 64, 16, true, -1, 0);
+    test_input(pool, test_peer_ip, 9, 0, 16, false, -1, 0);
+
+    // larger than ipv4 allows
+    test_input(pool, test_peer_ip, 10, 0xFFF8, 16, false, -1, 0);
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.malformed != 4 || stats.datagrams != 0) {
+        printf("malformed %lli datagrams %lli\n", stats.malformed, stats.datagrams);
+        print_error("malformed fragments are accepted");
+        pass = false;
+    }
+
+    // every other 8 bytes, holes exceed limit
+    for(uint32_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_HOLES; i++) {
+        test_input(pool, test_peer_ip, 11, 16 + i * 16, 8, true, -1, 0);
+    }
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.malformed != 5 || stats.datagrams != 0) {
+        print_error("hole limit is not applied");
+        pass = false;
+    }
+
+    pass &= test_check_idle(pool, "malformed");
+
+    return pass;
+}
+
+static boolean_t test_limits(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_ipv4_fragment_stats_t stats = {0};
+
+    // table capacity
+    network_ipv4_fragment_init(NULL);
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS + 8; i++) {
+        test_input(pool, test_peer_ip, 1000 + i, 0, 64, true, -1, i);
+    }
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.datagrams != NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS || stats.evicted != 8) {
+        print_error("table capacity is not applied");
+        pass = false;
+    }
+
+    // oldest ones are evicted, newest completes
+    network_packet_t* result = test_input(pool, test_peer_ip, 1000, 64, 8, false, -1, 100);
+
+    if(result != NULL) {
+        print_error("evicted datagram is completed");
+        pass = false;
+    }
+
+    network_ipv4_fragment_init(NULL);
+
+    uint16_t newest = 1000 + NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS - 1;
+
+    for(uint16_t i = 0; i < NETWORK_IPV4_FRAGMENT_MAX_DATAGRAMS; i++) {
+        test_input(pool, test_peer_ip, 1000 + i, 0, 64, true, -1, i);
+    }
+
+    result = test_input(pool, test_peer_ip, newest, 64, 8, false, -1, 100);
+
+    if(!test_check_datagram(result, newest, 72)) {
+        print_error("datagram in full table is not completed");
+        pass = false;
+    }
+
+    network_packet_release(result);
+
+    // memory budget, 16 pool packets
+    network_ipv4_fragment_config_t config = {.memory_budget = 16 * (NETWORK_PACKET_DEFAULT_BUFFER_SIZE + sizeof(network_packet_t))};
+
+    network_ipv4_fragment_init(&config);
+
+    for(uint16_t i = 0; i < 48; i++) {
+        test_input(pool, test_peer_ip, 2000 + i, 0, TEST_FRAGMENT_SIZE, true, -1, i);
+
+        network_ipv4_fragment_get_stats(&stats);
+
+        if(stats.memory_used > config.memory_budget) {
+            print_error("memory budget is exceeded");
+            pass = false;
+
+            break;
+        }
+    }
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.datagrams != 16 || stats.evicted != 32) {
+        print_error("memory budget does not evict oldest datagrams");
+        pass = false;
+    }
+
+    // a datagram larger than budget is dropped alone
+    network_ipv4_fragment_init(&config);
+
+    for(uint32_t i = 0; i < 20; i++) {
+        test_input(pool, test_peer_ip, 3000, i * TEST_FRAGMENT_SIZE, TEST_FRAGMENT_SIZE, true, -1, 0);
+    }
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(stats.memory_used > config.memory_budget || stats.evicted != 1) {
+        print_error("datagram over budget is kept");
+        pass = false;
+    }
+
+    network_ipv4_fragment_init(NULL);
+
+    pass &= test_check_idle(pool, "limits");
+
+    return pass;
+}
+
+static boolean_t test_flood(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_ipv4_fragment_stats_t stats = {0};
+    uint64_t legit_sent = 0;
+    uint64_t legit_done = 0;
+    uint64_t max_memory = 0;
+    uint64_t max_held = 0;
+
+    network_ipv4_fragment_init(NULL);
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_FLOOD_FRAGMENTS && pass; i++) {
+        // a fragment of a datagram which never completes, clock runs 250 us per fragment
+        uint32_t offset = (rand() % 40) * TEST_FRAGMENT_SIZE;
+        network_packet_t* result = test_input(pool, test_attacker_ip, rand(), offset, TEST_FRAGMENT_SIZE, true, 0, i / 4);
+
+        if(result) {
+            print_error("flood datagram is completed");
+            network_packet_release(result);
+            pass = false;
+        }
+
+        if(i % TEST_FLOOD_LEGIT_EVERY == 0) {
+            uint16_t id = legit_sent++;
+
+            test_input(pool, test_peer_ip, id, TEST_FRAGMENT_SIZE, TEST_FRAGMENT_SIZE, true, -1, i / 4);
+            test_input(pool, test_peer_ip, id, 2 * TEST_FRAGMENT_SIZE, TEST_DATAGRAM_SIZE - 2 * TEST_FRAGMENT_SIZE, false, -1, i / 4);
+            result = test_input(pool, test_peer_ip, id, 0, TEST_FRAGMENT_SIZE, true, -1, i / 4);
+
+            legit_done += test_check_datagram(result, id, TEST_DATAGRAM_SIZE);
+
+            network_packet_release(result);
+        }
+
+        network_ipv4_fragment_get_stats(&stats);
+
+        max_memory = MAX(max_memory, stats.memory_used);
+        max_held = MAX(max_held, TEST_POOL_SIZE - network_packet_pool_get_free_count(pool));
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    if(elapsed == 0) {
+        elapsed = 1;
+    }
+
+    network_ipv4_fragment_get_stats(&stats);
+
+    if(max_memory > NETWORK_IPV4_FRAGMENT_MEMORY_BUDGET || max_held == TEST_POOL_SIZE) {
+        print_error("flood is not bounded");
+        pass = false;
+    }
+
+    if(legit_done != legit_sent) {
+        printf("%lli of %lli datagrams reassembled under flood\n", legit_done, legit_sent);
+        print_error("flood blocks reassembly");
+        pass = false;
+    }
+
+    printf("%lli flood fragments in %lli us, %lli fragments/s, %lli evicted, %lli timed out, peak %lli bytes %lli packets, %lli of %lli datagrams reassembled\n",
+           stats.fragments, elapsed / 1000, stats.fragments * 1000000000ULL / elapsed, stats.evicted, stats.timed_out,
+           max_memory, max_held, legit_done, legit_sent);
+
+    network_ipv4_fragment_init(NULL);
+
+    pass &= test_check_idle(pool, "flood");
+
+    return pass;
+}
+
+static boolean_t test_udp_echo(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    uint8_t datagram[sizeof(network_udpv4_header_t) + TEST_ECHO_PAYLOAD_SIZE] = {0};
+    network_udpv4_header_t* udp = (network_udpv4_header_t*)datagram;
+
+    udp->source_port = BYTE_SWAP16(40000);
+    udp->destination_port = BYTE_SWAP16(NETWORK_APPLICATION_PORT_ECHO_SERVER);
+    udp->length = BYTE_SWAP16(sizeof(datagram));
+
+    for(uint32_t i = 0; i < TEST_ECHO_PAYLOAD_SIZE; i++) {
+        datagram[sizeof(network_udpv4_header_t) + i] = 'a' + (i % 26);
+    }
+
+    network_ipv4_fragment_init(NULL);
+
+    network_packet_t* responses = NULL;
+
+    // last fragment first
+    for(int32_t offset = (sizeof(datagram) - 1) / TEST_FRAGMENT_SIZE * TEST_FRAGMENT_SIZE; offset >= 0; offset -= TEST_FRAGMENT_SIZE) {
+        uint32_t len = MIN((uint32_t)TEST_FRAGMENT_SIZE, sizeof(datagram) - offset);
+        uint32_t frame_len = sizeof(network_ethernet_t) + sizeof(network_ipv4_header_t) + len;
+        network_packet_t* packet = network_packet_alloc(pool, frame_len);
+        uint8_t* frame = network_packet_put(packet, frame_len);
+
+        network_ethernet_t* eth = (network_ethernet_t*)frame;
+        network_ipv4_header_t* ip = (network_ipv4_header_t*)(eth + 1);
+
+        memory_memclean(frame, sizeof(network_ethernet_t) + sizeof(network_ipv4_header_t));
+        memory_memcopy(test_our_mac, eth->destination, sizeof(network_mac_address_t));
+        memory_memcopy(test_peer_mac, eth->source, sizeof(network_mac_address_t));
+        eth->type = BYTE_SWAP16(NETWORK_ETHERNET_TYPE_IPV4);
+
+        ip->version = NETWORK_IPV4_VERSION;
+        ip->header_length = 5;
+        ip->total_length = BYTE_SWAP16(sizeof(network_ipv4_header_t) + len);
+        ip->identification = BYTE_SWAP16(0x4242);
+        ip->ttl = 64;
+        ip->protocol = NETWORK_IPV4_PROTOCOL_UDPV4;
+        ip->source_ip = test_peer_ip;
+        ip->destination_ip = test_our_ip;
+        ip->flags_fragment_offset.fields.fragment_offset = offset >> 3;
+        ip->flags_fragment_offset.fields.flags = offset + len < sizeof(datagram) ? NETWORK_IPV4_FLAG_MORE_FRAGMENTS : 0;
+        ip->flags_fragment_offset.bits = BYTE_SWAP16(ip->flags_fragment_offset.bits);
+
+        uint32_t csum = 0;
+
+        for(uint32_t i = 0; i < sizeof(network_ipv4_header_t); i += 2) {
+            csum += *(uint16_t*)((uint8_t*)ip + i);
+        }
+
+        while(csum >> 16) {
+            csum = (csum & 0xFFFF) + (csum >> 16);
+        }
+
+        ip->header_checksum = ~csum;
+
+        memory_memcopy(datagram + offset, (uint8_t*)(ip + 1), len);
+
+        packet->network_info = test_our_mac;
+        packet->network_type = NETWORK_TYPE_ETHERNET;
+
+        network_packet_t* response = network_ethernet_process_packet(packet);
+
+        if(response && responses) {
+            print_error("echo is sent before datagram completes");
+            pass = false;
+        }
+
+        if(response) {
+            responses = response;
+        }
+    }
+
+    uint32_t echoed = 0;
+    uint32_t count = 0;
+
+    for(network_packet_t* response = responses; response; response = response->next) {
+        echoed += response->length - sizeof(network_ethernet_t) - sizeof(network_ipv4_header_t);
+        count++;
+    }
+
+    if(count != 3 || echoed != sizeof(datagram)) {
+        printf("%i response fragments with %i bytes\n", count, echoed);
+        print_error("fragmented udp echo is wrong");
+        pass = false;
+    }
+
+    network_packet_release_chain(responses);
+
+    pass &= test_check_idle(pool, "udp echo");
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    network_info_map = map_new(&test_network_info_mke);
+
+    network_info_t* ni = memory_malloc(sizeof(network_info_t));
+
+    memory_memcopy(test_our_mac, ni->mac, sizeof(network_mac_address_t));
+    ni->ipv4_address = test_our_ip;
+    ni->is_ipv4_address_set = true;
+
+    map_insert(network_info_map, ni->mac, ni);
+
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    if(pool == NULL) {
+        print_error("cannot create pool");
+
+        return -1;
+    }
+
+    pass &= test_orders(pool);
+    pass &= test_duplicates_and_overlaps(pool);
+    pass &= test_timeout(pool);
+    pass &= test_malformed(pool);
+    pass &= test_limits(pool);
+    pass &= test_flood(pool);
+    pass &= test_udp_echo(pool);
+
+    network_ipv4_fragment_destroy();
+    network_tcpv4_destroy_all();
+    network_packet_pool_destroy(pool);
+    map_destroy(network_info_map);
+    memory_free(ni);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
@@ -0,0 +1,507 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x4000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_ethernet.h>
+#include <network/network_arp.h>
+#include <network/network_ipv4.h>
+#include <network/network_ipv4_fragment.h>
+#include <network/network_icmpv4.h>
+#include <network/network_udpv4.h>
+#include <network/network_tcpv4.h>
+#include <network/network_dhcpv4.h>
+#include <bplustree.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_POOL_SIZE        64ULL
+#define TEST_BENCH_ITERATIONS 200000ULL
+#define TEST_PAYLOAD_SIZE     56
+
+int32_t  main(uint32_t argc, char_t** argv);
+uint64_t test_network_info_mke(const void* key);
+
+map_t* network_info_map = NULL;
+
+
+static network_mac_address_t test_our_mac = {0x52, 0x54, 0x00, 0x12, 0x34, 0x56};
+static network_mac_address_t test_peer_mac = {0x52, 0x54, 0x00, 0xAB, 0xCD, 0xEF};
+static network_ipv4_address_t test_our_ip = { .as_bytes = {10, 0, 2, 15} };
+static network_ipv4_address_t test_peer_ip = { .as_bytes = {10, 0, 2, 2} };
+
+uint64_t test_network_info_mke(const void* key) {
+    uint64_t x = 0;
+    memory_memcopy(key, &x, sizeof(network_mac_address_t));
+
+    return x;
+}
+
+static uint16_t test_checksum(const uint8_t* data, uint32_t len, uint32_t sum) {
+    for(uint32_t i = 0; i + 1 < len; i += 2) {
+        sum += (data[i + 1] << 8) | data[i];
+    }
+
+    if(len & 1) {
+        sum += data[len - 1];
+    }
+
+    while(sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return ~sum;
+}
+
+static uint32_t test_pseudo_header_sum(const network_ipv4_header_t* ip, uint16_t len) {
+    return ip->source_ip.as_words[0] + ip->source_ip.as_words[1] +
+           ip->destination_ip.as_words[0] + ip->destination_ip.as_words[1] +
+           BYTE_SWAP16((uint16_t)ip->protocol) + BYTE_SWAP16(len);
+}
+
+static uint32_t test_build_ethernet(uint8_t* frame, network_ethernet_type_t type) {
+    network_ethernet_t* eth = (network_ethernet_t*)frame;
+
+    memory_memcopy(test_our_mac, eth->destination, sizeof(network_mac_address_t));
+    memory_memcopy(test_peer_mac, eth->source, sizeof(network_mac_address_t));
+    eth->type = BYTE_SWAP16(type);
+
+    return sizeof(network_ethernet_t);
+}
+
+static uint32_t test_build_ipv4(uint8_t* frame, network_ipv4_protocol_t protocol, uint16_t payload_len) {
+    uint32_t len = test_build_ethernet(frame, NETWORK_ETHERNET_TYPE_IPV4);
+    network_ipv4_header_t* ip = (network_ipv4_header_t*)(frame + len);
+
+    ip->version = NETWORK_IPV4_VERSION;
+    ip->header_length = 5;
+    ip->total_length = BYTE_SWAP16(sizeof(network_ipv4_header_t) + payload_len);
+    ip->ttl = 64;
+    ip->protocol = protocol;
+    ip->source_ip = test_peer_ip;
+    ip->destination_ip = test_our_ip;
+    ip->header_checksum = test_checksum((uint8_t*)ip, sizeof(network_ipv4_header_t), 0);
+
+    return len + sizeof(network_ipv4_header_t);
+}
+
+static uint32_t test_build_arp_request(uint8_t* frame) {
+    uint32_t len = test_build_ethernet(frame, NETWORK_ETHERNET_TYPE_ARP);
+    network_arp_t* arp = (network_arp_t*)(frame + len);
+
+    memory_memcopy(BROADCAST_MAC, frame, sizeof(network_mac_address_t));
+
+    arp->hardware_type = BYTE_SWAP16(NETWORK_ARP_HARDWARE_TYPE_ETHERNET);
+    arp->protocol_type = BYTE_SWAP16(NETWORK_ARP_PROTOCOL_TYPE_IP);
+    arp->hardware_address_length = NETWORK_ARP_HARDWARE_ADDRESS_LENGTH;
+    arp->protocol_address_length = NETWORK_ARP_PROTOCOL_ADDRESS_LENGTH;
+    arp->operation_code = BYTE_SWAP16(NETWORK_ARP_OPERATION_CODE_REQUEST);
+    memory_memcopy(test_peer_mac, arp->source_mac, sizeof(network_mac_address_t));
+    arp->source_ip = test_peer_ip;
+    arp->target_ip = test_our_ip;
+
+    return 60; // padded to minimum frame size
+}
+
+static uint32_t test_build_icmp_echo(uint8_t* frame) {
+    uint16_t icmp_len = sizeof(network_icmpv4_header_t) + TEST_PAYLOAD_SIZE;
+    uint32_t len = test_build_ipv4(frame, NETWORK_IPV4_PROTOCOL_ICMPV4, icmp_len);
+    network_icmpv4_header_t* icmp = (network_icmpv4_header_t*)(frame + len);
+
+    icmp->type = NETWORK_ICMP_ECHO_REQUEST;
+    icmp->code = NETWORK_ICMP_ECHO_CODE;
+    icmp->identifier = BYTE_SWAP16(0x1234);
+    icmp->sequence = BYTE_SWAP16(1);
+
+    for(uint16_t i = 0; i < TEST_PAYLOAD_SIZE; i++) {
+        frame[len + sizeof(network_icmpv4_header_t) + i] = i;
+    }
+
+    icmp->checksum = test_checksum((uint8_t*)icmp, icmp_len, 0);
+
+    return len + icmp_len;
+}
+
+static uint32_t test_build_udp_echo(uint8_t* frame) {
+    uint16_t udp_len = sizeof(network_udpv4_header_t) + TEST_PAYLOAD_SIZE - 1; // odd length
+    uint32_t len = test_build_ipv4(frame, NETWORK_IPV4_PROTOCOL_UDPV4, udp_len);
+    network_udpv4_header_t* udp = (network_udpv4_header_t*)(frame + len);
+
+    udp->source_port = BYTE_SWAP16(40000);
+    udp->destination_port = BYTE_SWAP16(NETWORK_APPLICATION_PORT_ECHO_SERVER);
+    udp->length = BYTE_SWAP16(udp_len);
+
+    for(uint16_t i = 0; i < TEST_PAYLOAD_SIZE - 1; i++) {
+        frame[len + sizeof(network_udpv4_header_t) + i] = 'a' + (i % 26);
+    }
+
+    return len + udp_len;
+}
+
+static uint32_t test_build_tcp_syn(uint8_t* frame) {
+    uint32_t len = test_build_ipv4(frame, NETWORK_IPV4_PROTOCOL_TCPV4, sizeof(network_tcpv4_header_t));
+    network_tcpv4_header_t* tcp = (network_tcpv4_header_t*)(frame + len);
+
+    tcp->source_port = BYTE_SWAP16(40001);
+    tcp->destination_port = BYTE_SWAP16(80);
+    tcp->sequence_number = BYTE_SWAP32(1000);
+    tcp->header_length = 5;
+    tcp->syn = 1;
+    tcp->window_size = BYTE_SWAP16(8192);
+    tcp->checksum = test_checksum((uint8_t*)tcp, sizeof(network_tcpv4_header_t),
+                                  test_pseudo_header_sum((network_ipv4_header_t*)(frame + len - sizeof(network_ipv4_header_t)), sizeof(network_tcpv4_header_t)));
+
+    return len + sizeof(network_tcpv4_header_t);
+}
+
+static network_packet_t* test_receive(network_packet_pool_t* pool, const uint8_t* frame, uint32_t frame_len) {
+    network_packet_t* packet = network_packet_alloc(pool, frame_len);
+    uint8_t* data = network_packet_put(packet, frame_len);
+
+    if(data == NULL) {
+        network_packet_release(packet);
+
+        return NULL;
+    }
+
+    memory_memcopy(frame, data, frame_len);
+
+    packet->network_info = test_our_mac;
+    packet->network_type = NETWORK_TYPE_ETHERNET;
+
+    return network_ethernet_process_packet(packet);
+}
+
+static network_ipv4_header_t* test_check_ipv4_response(network_packet_t* response, network_ipv4_protocol_t protocol) {
+    if(response == NULL || response->next != NULL) {
+        print_error("expected single response");
+
+        return NULL;
+    }
+
+    network_ethernet_t* eth = (network_ethernet_t*)network_packet_data(response);
+    network_ipv4_header_t* ip = (network_ipv4_header_t*)(eth + 1);
+
+    if(!network_ethernet_is_mac_address_eq(eth->destination, test_peer_mac) ||
+       !network_ethernet_is_mac_address_eq(eth->source, test_our_mac) ||
+       BYTE_SWAP16(eth->type) != NETWORK_ETHERNET_TYPE_IPV4) {
+        print_error("ethernet header of response is wrong");
+
+        return NULL;
+    }
+
+    if(ip->protocol != protocol ||
+       !network_ipv4_is_address_eq(ip->source_ip, test_our_ip) ||
+       !network_ipv4_is_address_eq(ip->destination_ip, test_peer_ip) ||
+       BYTE_SWAP16(ip->total_length) + sizeof(network_ethernet_t) != response->length ||
+       test_checksum((uint8_t*)ip, sizeof(network_ipv4_header_t), 0) != 0) {
+        print_error("ipv4 header of response is wrong");
+
+        return NULL;
+    }
+
+    return ip;
+}
+
+static boolean_t test_buffer_ops(void) {
+    boolean_t pass = true;
+
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    if(pool == NULL) {
+        print_error("cannot create pool");
+
+        return false;
+    }
+
+    network_packet_t* packets[TEST_POOL_SIZE] = {0};
+
+    for(uint64_t i = 0; i < TEST_POOL_SIZE; i++) {
+        packets[i] = network_packet_alloc(pool, 1500);
+
+        if(packets[i] == NULL) {
+            print_error("pool exhausted early");
+            pass = false;
+        }
+    }
+
+    if(network_packet_alloc(pool, 1500) != NULL || network_packet_pool_get_free_count(pool) != 0) {
+        print_error("exhausted pool returns packet");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < TEST_POOL_SIZE; i++) {
+        network_packet_release(packets[i]);
+    }
+
+    network_packet_t* packet = network_packet_alloc(pool, 100);
+
+    if(network_packet_headroom(packet) != NETWORK_PACKET_HEADROOM || packet->length != 0 ||
+       network_packet_tailroom(packet) != NETWORK_PACKET_DEFAULT_BUFFER_SIZE - NETWORK_PACKET_HEADROOM) {
+        print_error("new packet layout is wrong");
+        pass = false;
+    }
+
+    uint8_t* tail = network_packet_put(packet, 10);
+    uint8_t* head = network_packet_push(packet, 4);
+
+    if(tail == NULL || head + 4 != tail || packet->length != 14 ||
+       network_packet_pull(packet, 20) != NULL ||
+       network_packet_pull(packet, 4) != tail ||
+       network_packet_push(packet, NETWORK_PACKET_HEADROOM + 1) != NULL ||
+       network_packet_put(packet, NETWORK_PACKET_DEFAULT_BUFFER_SIZE) != NULL ||
+       network_packet_trim(packet, 11) == 0 ||
+       network_packet_trim(packet, 6) != 0 || packet->length != 6) {
+        print_error("push/pull/put/trim are wrong");
+        pass = false;
+    }
+
+    network_packet_ref(packet);
+    network_packet_release(packet);
+
+    if(network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE - 1) {
+        print_error("referenced packet is recycled");
+        pass = false;
+    }
+
+    network_packet_release(packet);
+
+    // larger than pool buffers, comes from heap
+    packet = network_packet_alloc(pool, 9000);
+
+    if(packet == NULL || packet->pool != NULL || network_packet_put(packet, 9000) == NULL) {
+        print_error("large packet is not allocated from heap");
+        pass = false;
+    }
+
+    network_packet_release(packet);
+
+    if(network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE) {
+        print_error("pool leaks packets");
+        pass = false;
+    }
+
+    network_packet_pool_destroy(pool);
+
+    return pass;
+}
+
+static boolean_t test_pipeline(void) {
+    boolean_t pass = true;
+    uint8_t frame[256] = {0};
+    uint32_t frame_len = 0;
+
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    // arp
+    frame_len = test_build_arp_request(frame);
+    network_packet_t* response = test_receive(pool, frame, frame_len);
+
+    if(response == NULL || response->length != sizeof(network_ethernet_t) + sizeof(network_arp_t)) {
+        print_error("arp reply is wrong");
+        pass = false;
+    } else {
+        network_arp_t* arp = (network_arp_t*)(network_packet_data(response) + sizeof(network_ethernet_t));
+
+        if(BYTE_SWAP16(arp->operation_code) != NETWORK_ARP_OPERATION_CODE_ANSWER ||
+           !network_ethernet_is_mac_address_eq(arp->source_mac, test_our_mac) ||
+           !network_ethernet_is_mac_address_eq(arp->target_mac, test_peer_mac) ||
+           !network_ipv4_is_address_eq(arp->source_ip, test_our_ip) ||
+           !network_ipv4_is_address_eq(arp->target_ip, test_peer_ip)) {
+            print_error("arp reply fields are wrong");
+            pass = false;
+        }
+    }
+
+    network_packet_release_chain(response);
+
+    // icmp echo
+    memory_memclean(frame, sizeof(frame));
+    frame_len = test_build_icmp_echo(frame);
+    response = test_receive(pool, frame, frame_len);
+
+    network_ipv4_header_t* ip = test_check_ipv4_response(response, NETWORK_IPV4_PROTOCOL_ICMPV4);
+
+    if(ip == NULL) {
+        pass = false;
+    } else {
+        network_icmpv4_header_t* icmp = (network_icmpv4_header_t*)(ip + 1);
+        uint16_t icmp_len = BYTE_SWAP16(ip->total_length) - sizeof(network_ipv4_header_t);
+
+        if(icmp->type != NETWORK_ICMP_ECHO_REPLY || BYTE_SWAP16(icmp->identifier) != 0x1234 ||
+           icmp_len != sizeof(network_icmpv4_header_t) + TEST_PAYLOAD_SIZE ||
+           test_checksum((uint8_t*)icmp, icmp_len, 0) != 0 ||
+           memory_memcompare((uint8_t*)(icmp + 1), frame + frame_len - TEST_PAYLOAD_SIZE, TEST_PAYLOAD_SIZE) != 0) {
+            print_error("icmp echo reply is wrong");
+            pass = false;
+        }
+    }
+
+    network_packet_release_chain(response);
+
+    // udp echo
+    memory_memclean(frame, sizeof(frame));
+    frame_len = test_build_udp_echo(frame);
+    response = test_receive(pool, frame, frame_len);
+
+    ip = test_check_ipv4_response(response, NETWORK_IPV4_PROTOCOL_UDPV4);
+
+    if(ip == NULL) {
+        pass = false;
+    } else {
+        network_udpv4_header_t* udp = (network_udpv4_header_t*)(ip + 1);
+        uint16_t udp_len = BYTE_SWAP16(udp->length);
+
+        if(BYTE_SWAP16(udp->source_port) != NETWORK_APPLICATION_PORT_ECHO_SERVER || BYTE_SWAP16(udp->destination_port) != 40000 ||
+           udp_len != sizeof(network_udpv4_header_t) + TEST_PAYLOAD_SIZE - 1 ||
+           test_checksum((uint8_t*)udp, udp_len, test_pseudo_header_sum(ip, udp_len)) != 0 ||
+           memory_memcompare((uint8_t*)(udp + 1), frame + frame_len - (TEST_PAYLOAD_SIZE - 1), TEST_PAYLOAD_SIZE - 1) != 0) {
+            print_error("udp echo reply is wrong");
+            pass = false;
+        }
+    }
+
+    network_packet_release_chain(response);
+
+    // tcp syn, stack has no builtin listeners
+    if(network_tcpv4_listen(test_our_ip, 80, 0) == NULL) {
+        print_error("cannot listen");
+        pass = false;
+    }
+
+    memory_memclean(frame, sizeof(frame));
+    frame_len = test_build_tcp_syn(frame);
+    response = test_receive(pool, frame, frame_len);
+
+    ip = test_check_ipv4_response(response, NETWORK_IPV4_PROTOCOL_TCPV4);
+
+    if(ip == NULL) {
+        pass = false;
+    } else {
+        network_tcpv4_header_t* tcp = (network_tcpv4_header_t*)(ip + 1);
+        uint16_t tcp_len = BYTE_SWAP16(ip->total_length) - sizeof(network_ipv4_header_t);
+
+        if(!tcp->syn || !tcp->ack || BYTE_SWAP32(tcp->acknowledgement_number) != 1001 ||
+           test_checksum((uint8_t*)tcp, tcp_len, test_pseudo_header_sum(ip, tcp_len)) != 0) {
+            print_error("tcp syn ack is wrong");
+            pass = false;
+        }
+    }
+
+    network_packet_release_chain(response);
+
+    if(network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE) {
+        print_error("pipeline leaks packets");
+        pass = false;
+    }
+
+    network_packet_pool_destroy(pool);
+
+    return pass;
+}
+
+static boolean_t test_throughput(void) {
+    boolean_t pass = true;
+    uint8_t icmp_frame[256] = {0};
+    uint8_t udp_frame[256] = {0};
+
+    uint32_t icmp_frame_len = test_build_icmp_echo(icmp_frame);
+    uint32_t udp_frame_len = test_build_udp_echo(udp_frame);
+
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    memory_heap_stat_t stat_before = {0};
+    memory_get_heap_stat(&stat_before);
+
+    uint64_t response_bytes = 0;
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_ITERATIONS && pass; i++) {
+        boolean_t is_icmp = i & 1;
+        network_packet_t* response = is_icmp?test_receive(pool, icmp_frame, icmp_frame_len):test_receive(pool, udp_frame, udp_frame_len);
+
+        if(response == NULL) {
+            print_error("no response at iteration");
+            pass = false;
+
+            break;
+        }
+
+        response_bytes += response->length;
+
+        network_packet_release_chain(response);
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    memory_heap_stat_t stat_after = {0};
+    memory_get_heap_stat(&stat_after);
+
+    if(stat_after.malloc_count != stat_before.malloc_count) {
+        printf("heap allocations at steady state %lli\n", stat_after.malloc_count - stat_before.malloc_count);
+        print_error("echo path allocates from heap");
+        pass = false;
+    }
+
+    if(network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE) {
+        print_error("echo path leaks packets");
+        pass = false;
+    }
+
+    network_packet_pool_destroy(pool);
+
+    if(elapsed == 0) {
+        elapsed = 1;
+    }
+
+    printf("%lli icmp/udp echo packets in %lli us, %lli packets/s, %lli response bytes\n",
+           TEST_BENCH_ITERATIONS, elapsed / 1000, TEST_BENCH_ITERATIONS * 1000000000ULL / elapsed, response_bytes);
+
+    return pass;
+}
+
+static void test_cleanup(network_info_t* ni) {
+    // tcp keeps listeners and the connection opened by syn test
+    network_tcpv4_destroy_all();
+    network_ipv4_fragment_destroy();
+    map_destroy(network_info_map);
+    memory_free(ni);
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    network_info_map = map_new(&test_network_info_mke);
+
+    network_info_t* ni = memory_malloc(sizeof(network_info_t));
+
+    memory_memcopy(test_our_mac, ni->mac, sizeof(network_mac_address_t));
+    ni->ipv4_address = test_our_ip;
+    ni->ipv4_broadcast.as_bytes[0] = 10;
+    ni->ipv4_broadcast.as_bytes[3] = 255;
+    ni->is_ipv4_address_set = true;
+
+    map_insert(network_info_map, ni->mac, ni);
+
+    pass &= test_buffer_ops();
+    pass &= test_pipeline();
+    pass &= test_throughput();
+
+    test_cleanup(ni);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
@@ -0,0 +1,577 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x8000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_rss.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_ethernet.h>
+#include <network/network_ipv4.h>
+#include <driver/network_igb.h>
+#include <bplustree.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_RING_SIZE         256
+#define TEST_BUFFER_SIZE       2048
+#define TEST_HEADER_FA         0x100000ULL
+#define TEST_FRAME_SIZE        64
+#define TEST_BENCH_RING_SIZE   1024
+#define TEST_BENCH_PACKETS     1000000ULL
+
+int32_t  main(uint32_t argc, char_t** argv);
+uint64_t test_network_info_mke(const void* key);
+
+map_t* network_info_map = NULL;
+
+static network_mac_address_t test_our_mac = {0x52, 0x54, 0x00, 0x12, 0x34, 0x56};
+
+static uint64_t test_seed = 0x2545F4914F6CDD1DULL;
+
+uint64_t test_network_info_mke(const void* key) {
+    uint64_t x = 0;
+    memory_memcopy(key, &x, sizeof(network_mac_address_t));
+
+    return x;
+}
+
+static uint32_t test_random(void) {
+    test_seed = test_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return test_seed >> 33;
+}
+
+/*! a flow and its hashes from verification suite of rss specification */
+typedef struct test_rss_vector_t {
+    uint8_t  sip[4];
+    uint8_t  dip[4];
+    uint16_t sport;
+    uint16_t dport;
+    uint32_t ipv4_hash;
+    uint32_t tcp_hash;
+} test_rss_vector_t;
+
+static const test_rss_vector_t test_rss_vectors[] = {
+    {{66, 9, 149, 187}, {161, 142, 100, 80}, 2794, 1766, 0x323e8fc2, 0x51ccc178},
+    {{199, 92, 111, 2}, {65, 69, 140, 83}, 14230, 4739, 0xd718262a, 0xc626b0ea},
+    {{24, 19, 198, 95}, {12, 22, 207, 184}, 12898, 38024, 0xd2d0a5de, 0x5c2b394a},
+    {{38, 27, 205, 30}, {209, 142, 163, 6}, 48228, 2217, 0x82989176, 0xafc7327f},
+    {{153, 39, 163, 191}, {202, 188, 127, 2}, 44251, 1303, 0x5d1809c5, 0x10e828a2},
+};
+
+/*! simulated nic, it owns descriptors from head up to tail */
+typedef struct test_nic_t {
+    network_igb_rx_ring_t ring;
+    uint32_t              head;
+    uint32_t              tail;
+    uint64_t              tail_writes;
+    uint8_t*              buffers;
+} test_nic_t;
+
+static boolean_t test_nic_create(test_nic_t* nic, uint32_t count, network_packet_pool_t* pool) {
+    memory_memclean(nic, sizeof(test_nic_t));
+
+    network_igb_rx_desc_t* desc = memory_malloc(sizeof(network_igb_rx_desc_t) * count);
+    nic->buffers = memory_malloc((uint64_t)TEST_BUFFER_SIZE * count);
+
+    if(desc == NULL || nic->buffers == NULL) {
+        memory_free(desc);
+        memory_free(nic->buffers);
+
+        return false;
+    }
+
+    // dma addresses are virtual addresses at host
+    nic->ring.desc = desc;
+    nic->ring.packet_buffer_fa = (uint64_t)nic->buffers;
+    nic->ring.packet_buffer_va = (uint64_t)nic->buffers;
+    nic->ring.header_buffer_fa = TEST_HEADER_FA;
+    nic->ring.buffer_size = TEST_BUFFER_SIZE;
+    nic->ring.count = count;
+    nic->ring.pool = pool;
+    nic->ring.network_info = test_our_mac;
+
+    for(uint32_t i = 0; i < count; i++) {
+        desc[i].read.pkt_addr = nic->ring.packet_buffer_fa + (uint64_t)i * TEST_BUFFER_SIZE;
+        desc[i].read.hdr_addr = TEST_HEADER_FA + (uint64_t)i * NETWORK_IGB_RX_HEADER_SIZE;
+    }
+
+    nic->tail = count - 1;
+
+    return true;
+}
+
+static void test_nic_destroy(test_nic_t* nic) {
+    memory_free((void*)nic->ring.desc);
+    memory_free(nic->buffers);
+}
+
+/*! nic writes a frame into next owned descriptor, false when ring is full */
+static boolean_t test_nic_receive(test_nic_t* nic, const uint8_t* frame, uint16_t len, uint32_t status, uint32_t error) {
+    if(nic->head == nic->tail) {
+        return false;
+    }
+
+    volatile network_igb_rx_desc_t* desc = &nic->ring.desc[nic->head];
+    uint8_t* buffer = (uint8_t*)desc->read.pkt_addr;
+
+    memory_memcopy(frame, buffer, len);
+
+    desc->wb.lower.lo_dword.pkt_info = 0;
+    desc->wb.lower.lo_dword.hdr_info = 0;
+    desc->wb.lower.hi_dword.rss = 0;
+    desc->wb.upper.length = len;
+    desc->wb.upper.vlan = 0;
+    desc->wb.upper.status_error = NETWORK_IGB_RXD_STATUS_DD | status | (error << 20);
+
+    nic->head = (nic->head + 1) & (nic->ring.count - 1);
+
+    return true;
+}
+
+/*! driver side of a poll, tail is written once */
+static uint32_t test_nic_poll(test_nic_t* nic, uint32_t budget, network_packet_t** packets) {
+    uint32_t cleaned = network_igb_rx_ring_poll(&nic->ring, budget, packets);
+
+    if(cleaned) {
+        nic->tail = network_igb_rx_ring_tail(&nic->ring);
+        nic->tail_writes++;
+    }
+
+    return cleaned;
+}
+
+static uint16_t test_build_frame(uint8_t* frame, const uint8_t* sip, const uint8_t* dip, uint8_t protocol,
+                                 uint16_t sport, uint16_t dport, uint16_t fragment) {
+    memory_memclean(frame, 128);
+
+    frame[12] = NETWORK_ETHERNET_TYPE_IPV4 >> 8;
+    frame[13] = NETWORK_ETHERNET_TYPE_IPV4 & 0xFF;
+
+    uint8_t* ip = frame + sizeof(network_ethernet_t);
+
+    ip[0] = 0x45;
+    ip[6] = fragment >> 8;
+    ip[7] = fragment & 0xFF;
+    ip[8] = 64;
+    ip[9] = protocol;
+    memory_memcopy(sip, ip + 12, 4);
+    memory_memcopy(dip, ip + 16, 4);
+
+    uint8_t* l4 = ip + sizeof(network_ipv4_header_t);
+
+    l4[0] = sport >> 8;
+    l4[1] = sport & 0xFF;
+    l4[2] = dport >> 8;
+    l4[3] = dport & 0xFF;
+
+    return sizeof(network_ethernet_t) + sizeof(network_ipv4_header_t) + 20;
+}
+
+static boolean_t test_toeplitz(void) {
+    boolean_t pass = true;
+
+    for(uint32_t i = 0; i < sizeof(test_rss_vectors) / sizeof(test_rss_vector_t); i++) {
+        const test_rss_vector_t* v = &test_rss_vectors[i];
+        network_ipv4_address_t sip;
+        network_ipv4_address_t dip;
+
+        memory_memcopy(v->sip, sip.as_bytes, 4);
+        memory_memcopy(v->dip, dip.as_bytes, 4);
+
+        uint32_t ipv4_hash = network_rss_hash_ipv4(network_rss_default_key, sip, dip, v->sport, v->dport, false);
+        uint32_t tcp_hash = network_rss_hash_ipv4(network_rss_default_key, sip, dip, v->sport, v->dport, true);
+
+        if(ipv4_hash != v->ipv4_hash || tcp_hash != v->tcp_hash) {
+            printf("vector %i ipv4 0x%x tcp 0x%x\n", i, ipv4_hash, tcp_hash);
+            print_error("toeplitz hash differs from specification");
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+static boolean_t test_hash_frame(void) {
+    boolean_t pass = true;
+    uint8_t frame[128];
+    const test_rss_vector_t* v = &test_rss_vectors[0];
+
+    uint16_t len = test_build_frame(frame, v->sip, v->dip, NETWORK_IPV4_PROTOCOL_TCPV4, v->sport, v->dport, 0);
+
+    if(network_rss_hash_frame(network_rss_default_key, frame, len) != v->tcp_hash) {
+        print_error("tcp frame hash is wrong");
+        pass = false;
+    }
+
+    len = test_build_frame(frame, v->sip, v->dip, NETWORK_IPV4_PROTOCOL_UDPV4, v->sport, v->dport, 0);
+
+    if(network_rss_hash_frame(network_rss_default_key, frame, len) != v->tcp_hash) {
+        print_error("udp frame hash is wrong");
+        pass = false;
+    }
+
+    // every fragment of a datagram lands on same queue, first one has ports but is hashed like others
+    len = test_build_frame(frame, v->sip, v->dip, NETWORK_IPV4_PROTOCOL_UDPV4, v->sport, v->dport, 0x2000);
+
+    if(network_rss_hash_frame(network_rss_default_key, frame, len) != v->ipv4_hash) {
+        print_error("first fragment is hashed with ports");
+        pass = false;
+    }
+
+    len = test_build_frame(frame, v->sip, v->dip, NETWORK_IPV4_PROTOCOL_UDPV4, v->sport, v->dport, 0x00B9);
+
+    if(network_rss_hash_frame(network_rss_default_key, frame, len) != v->ipv4_hash) {
+        print_error("fragment is hashed with ports");
+        pass = false;
+    }
+
+    len = test_build_frame(frame, v->sip, v->dip, NETWORK_IPV4_PROTOCOL_ICMPV4, v->sport, v->dport, 0);
+
+    if(network_rss_hash_frame(network_rss_default_key, frame, len) != v->ipv4_hash) {
+        print_error("icmp frame is hashed with ports");
+        pass = false;
+    }
+
+    frame[12] = NETWORK_ETHERNET_TYPE_ARP >> 8;
+    frame[13] = NETWORK_ETHERNET_TYPE_ARP & 0xFF;
+
+    if(network_rss_hash_frame(network_rss_default_key, frame, len) != 0 ||
+       network_rss_hash_frame(network_rss_default_key, frame, 20) != 0) {
+        print_error("non ipv4 frame has a hash");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_reta(void) {
+    boolean_t pass = true;
+    uint8_t reta[NETWORK_RSS_RETA_SIZE];
+
+    for(uint32_t queues = 1; queues <= NETWORK_IGB_MAX_RX_QUEUES && pass; queues *= 2) {
+        uint32_t entries[NETWORK_IGB_MAX_RX_QUEUES] = {0};
+        uint32_t flows[NETWORK_IGB_MAX_RX_QUEUES] = {0};
+
+        network_rss_fill_reta(reta, NETWORK_RSS_RETA_SIZE, queues);
+
+        for(uint32_t i = 0; i < NETWORK_RSS_RETA_SIZE; i++) {
+            if(reta[i] >= queues) {
+                print_error("redirection entry points to a missing queue");
+                pass = false;
+
+                break;
+            }
+
+            entries[reta[i]]++;
+        }
+
+        for(uint32_t i = 0; i < 4096 && pass; i++) {
+            network_ipv4_address_t sip = {.as_dword = test_random()};
+            network_ipv4_address_t dip = {.as_dword = test_random()};
+            uint16_t sport = test_random();
+            uint16_t dport = test_random();
+
+            uint32_t hash = network_rss_hash_ipv4(network_rss_default_key, sip, dip, sport, dport, true);
+            uint8_t queue = network_rss_queue(reta, NETWORK_RSS_RETA_SIZE, hash);
+
+            // segments of a flow always hash to the same queue
+            if(network_rss_queue(reta, NETWORK_RSS_RETA_SIZE, network_rss_hash_ipv4(network_rss_default_key, sip, dip, sport, dport, true)) != queue) {
+                print_error("flow moves between queues");
+                pass = false;
+            }
+
+            flows[queue]++;
+        }
+
+        for(uint32_t q = 0; q < queues && pass; q++) {
+            if(entries[q] != NETWORK_RSS_RETA_SIZE / queues || flows[q] < 4096 / queues * 3 / 4) {
+                printf("queues %i queue %i entries %i flows %i\n", queues, q, entries[q], flows[q]);
+                print_error("flows are not spread over queues");
+                pass = false;
+            }
+        }
+    }
+
+    return pass;
+}
+
+static boolean_t test_ring_batch(void) {
+    boolean_t pass = true;
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_RING_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+    test_nic_t nic;
+
+    if(pool == NULL || !test_nic_create(&nic, TEST_RING_SIZE, pool)) {
+        print_error("cannot create simulated ring");
+        network_packet_pool_destroy(pool);
+
+        return false;
+    }
+
+    uint8_t frame[TEST_FRAME_SIZE] = {0};
+    uint32_t sent = 0;
+    uint32_t received = 0;
+
+    // several laps around ring, nic never passes tail and frames arrive in order
+    for(uint32_t round = 0; round < 20 && pass; round++) {
+        uint32_t burst = test_random() % (TEST_RING_SIZE + 64);
+
+        for(uint32_t i = 0; i < burst; i++) {
+            memory_memcopy(&sent, frame, sizeof(uint32_t));
+
+            if(!test_nic_receive(&nic, frame, TEST_FRAME_SIZE, NETWORK_IGB_RXD_STATUS_IPCS | NETWORK_IGB_RXD_STATUS_L4I, 0)) {
+                break;
+            }
+
+            sent++;
+        }
+
+        while(pass) {
+            network_packet_t* packets = NULL;
+            uint32_t first = nic.ring.next;
+            uint32_t cleaned = test_nic_poll(&nic, NETWORK_IGB_RX_BUDGET, &packets);
+
+            if(cleaned > NETWORK_IGB_RX_BUDGET) {
+                print_error("poll exceeds budget");
+                pass = false;
+            }
+
+            if(cleaned == 0) {
+                break;
+            }
+
+            for(uint32_t i = 0; i < cleaned; i++) {
+                uint32_t idx = (first + i) & (TEST_RING_SIZE - 1);
+                volatile network_igb_rx_desc_t* desc = &nic.ring.desc[idx];
+
+                if(desc->read.pkt_addr != nic.ring.packet_buffer_fa + (uint64_t)idx * TEST_BUFFER_SIZE ||
+                   desc->read.hdr_addr != TEST_HEADER_FA + (uint64_t)idx * NETWORK_IGB_RX_HEADER_SIZE ||
+                   (desc->wb.upper.status_error & NETWORK_IGB_RXD_STATUS_DD)) {
+                    printf("descriptor %i\n", idx);
+                    print_error("descriptor is not refilled");
+                    pass = false;
+                }
+            }
+
+            for(network_packet_t* packet = packets; packet && pass; packet = packet->next) {
+                uint32_t seq = 0;
+
+                memory_memcopy(network_packet_data(packet), &seq, sizeof(uint32_t));
+
+                if(seq != received || packet->length != TEST_FRAME_SIZE || packet->network_info != (void*)test_our_mac ||
+                   packet->checksum_flags != (NETWORK_PACKET_CHECKSUM_IPV4_VERIFIED | NETWORK_PACKET_CHECKSUM_L4_VERIFIED)) {
+                    printf("expected %i got %i\n", received, seq);
+                    print_error("received packet is wrong");
+                    pass = false;
+                }
+
+                received++;
+            }
+
+            network_packet_release_chain(packets);
+        }
+    }
+
+    if(pass && (received != sent || nic.ring.packets != sent || nic.head != nic.ring.next)) {
+        printf("sent %i received %i\n", sent, received);
+        print_error("frames are lost");
+        pass = false;
+    }
+
+    if(pass && nic.tail_writes != nic.ring.polls) {
+        print_error("tail is written more than once per poll");
+        pass = false;
+    }
+
+    // errored and short frames are dropped, their descriptors are given back
+    uint64_t packets_before = nic.ring.packets;
+
+    test_nic_receive(&nic, frame, TEST_FRAME_SIZE, 0, 0x80);
+    test_nic_receive(&nic, frame, 20, 0, 0);
+    test_nic_receive(&nic, frame, TEST_FRAME_SIZE, 0, 0);
+
+    network_packet_t* packets = NULL;
+
+    if(test_nic_poll(&nic, NETWORK_IGB_RX_BUDGET, &packets) != 3 || nic.ring.errors != 1 || nic.ring.dropped != 1 ||
+       nic.ring.packets != packets_before + 1 || packets == NULL || packets->next != NULL || packets->checksum_flags != 0) {
+        print_error("bad frames are not dropped");
+        pass = false;
+    }
+
+    network_packet_release_chain(packets);
+
+    test_nic_destroy(&nic);
+    network_packet_pool_destroy(pool);
+
+    return pass;
+}
+
+static boolean_t test_ring_pool_exhausted(void) {
+    boolean_t pass = true;
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, 4, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+    test_nic_t nic;
+
+    if(pool == NULL || !test_nic_create(&nic, 16, pool)) {
+        print_error("cannot create simulated ring");
+        network_packet_pool_destroy(pool);
+
+        return false;
+    }
+
+    uint8_t frame[TEST_FRAME_SIZE] = {0};
+
+    for(uint32_t i = 0; i < 8; i++) {
+        test_nic_receive(&nic, frame, TEST_FRAME_SIZE, 0, 0);
+    }
+
+    network_packet_t* packets = NULL;
+
+    // ring keeps running while stack holds packets, frames are dropped instead of stalling nic
+    if(test_nic_poll(&nic, NETWORK_IGB_RX_BUDGET, &packets) != 8 || nic.ring.packets != 4 || nic.ring.dropped != 4 ||
+       nic.tail != 7) {
+        print_error("empty pool stalls ring");
+        pass = false;
+    }
+
+    network_packet_release_chain(packets);
+
+    test_nic_destroy(&nic);
+    network_packet_pool_destroy(pool);
+
+    return pass;
+}
+
+static boolean_t test_moderation(void) {
+    boolean_t pass = true;
+    network_igb_moderation_t moderation = {0};
+    const uint32_t budget = NETWORK_IGB_RX_BUDGET;
+
+    if(network_igb_moderation_update(&moderation, 2, budget) != NETWORK_IGB_MODERATION_ITR ||
+       moderation.itr != NETWORK_IGB_ITR_LOWEST_LATENCY ||
+       network_igb_moderation_update(&moderation, 1, budget) != 0) {
+        print_error("light load does not select lowest latency");
+        pass = false;
+    }
+
+    if(network_igb_moderation_update(&moderation, budget / 2, budget) != NETWORK_IGB_MODERATION_ITR ||
+       moderation.itr != NETWORK_IGB_ITR_LOW_LATENCY ||
+       network_igb_moderation_update(&moderation, budget - 1, budget) != NETWORK_IGB_MODERATION_ITR ||
+       moderation.itr != NETWORK_IGB_ITR_BULK) {
+        print_error("throttle does not follow load");
+        pass = false;
+    }
+
+    if(network_igb_moderation_update(&moderation, budget, budget) != NETWORK_IGB_MODERATION_MASK || !moderation.polling) {
+        print_error("full poll does not switch to poll mode");
+        pass = false;
+    }
+
+    // a heavy poll between light ones restarts count
+    for(uint32_t i = 0; i < NETWORK_IGB_POLL_EXIT_POLLS - 1 && pass; i++) {
+        if(network_igb_moderation_update(&moderation, 0, budget) != 0) {
+            print_error("poll mode exits early");
+            pass = false;
+        }
+    }
+
+    if(network_igb_moderation_update(&moderation, budget / 2, budget) != 0 || moderation.light_polls != 0) {
+        print_error("heavy poll does not reset light polls");
+        pass = false;
+    }
+
+    for(uint32_t i = 0; i < NETWORK_IGB_POLL_EXIT_POLLS - 1 && pass; i++) {
+        network_igb_moderation_update(&moderation, budget / 8, budget);
+    }
+
+    uint8_t actions = network_igb_moderation_update(&moderation, budget / 8, budget);
+
+    if(!(actions & NETWORK_IGB_MODERATION_UNMASK) || moderation.polling) {
+        print_error("light polls do not switch to interrupt mode");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_throughput(void) {
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_BENCH_RING_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+    uint8_t frame[TEST_FRAME_SIZE] = {0};
+    uint32_t budgets[] = {1, NETWORK_IGB_RX_BUDGET};
+
+    if(pool == NULL) {
+        return false;
+    }
+
+    for(uint32_t b = 0; b < sizeof(budgets) / sizeof(uint32_t); b++) {
+        test_nic_t nic;
+
+        if(!test_nic_create(&nic, TEST_BENCH_RING_SIZE, pool)) {
+            network_packet_pool_destroy(pool);
+
+            return false;
+        }
+
+        uint64_t received = 0;
+        uint64_t elapsed = 0;
+
+        while(received < TEST_BENCH_PACKETS) {
+            // nic fills ring, timing covers driver side only
+            while(test_nic_receive(&nic, frame, TEST_FRAME_SIZE, 0, 0)) {
+            }
+
+            uint64_t start = time_ns(NULL);
+            uint32_t cleaned = 0;
+
+            do {
+                network_packet_t* packets = NULL;
+
+                cleaned = test_nic_poll(&nic, budgets[b], &packets);
+                received += cleaned;
+
+                network_packet_release_chain(packets);
+            } while(cleaned);
+
+            elapsed += time_ns(NULL) - start;
+        }
+
+        printf("budget %i: %lli packets/s, %lli tail writes for %lli packets\n", budgets[b],
+               received * 1000000000ULL / (elapsed ? elapsed : 1), nic.tail_writes, received);
+
+        test_nic_destroy(&nic);
+    }
+
+    network_packet_pool_destroy(pool);
+
+    return true;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    network_info_map = map_new(&test_network_info_mke);
+
+    pass &= test_toeplitz();
+    pass &= test_hash_frame();
+    pass &= test_reta();
+    pass &= test_ring_batch();
+    pass &= test_ring_pool_exhausted();
+    pass &= test_moderation();
+    pass &= test_throughput();
+
+    map_destroy(network_info_map);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
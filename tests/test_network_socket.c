@@ -0,0 +1,593 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x10000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_ethernet.h>
+#include <network/network_ipv4.h>
+#include <network/network_ipv4_fragment.h>
+#include <network/network_tcpv4.h>
+#include <network/network_tx_queue.h>
+#include <network/network_socket.h>
+#include <bplustree.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_POOL_SIZE         4096ULL
+#define TEST_CONNECTIONS       128
+#define TEST_BACKLOG           16
+#define TEST_TRANSFER_SIZE     (32ULL << 10)
+#define TEST_CHUNK_SIZE        (4 << 10)
+#define TEST_DATAGRAMS         256
+#define TEST_STEP_MS           1ULL
+#define TEST_TIME_LIMIT_MS     (60ULL * 1000ULL)
+#define TEST_TCP_PORT          7000
+#define TEST_UDP_PORT          7001
+
+#include "test_network_stack.h"
+
+int32_t  main(uint32_t argc, char_t** argv);
+
+typedef struct test_client_t {
+    network_socket_t* socket;
+    uint64_t          sent;
+    uint64_t          received;
+    boolean_t         done;
+} test_client_t;
+
+typedef struct test_server_client_t {
+    network_socket_t* socket;
+    uint32_t          pending_start;
+    uint32_t          pending_length;
+    uint8_t           buffer[TEST_CHUNK_SIZE];
+} test_server_client_t;
+
+static uint64_t test_now_ms = 1000;
+static uint64_t test_frames = 0;
+
+static uint64_t test_clock(void) {
+    return test_now_ms;
+}
+
+static uint8_t test_pattern(uint64_t index, uint64_t offset) {
+    return (uint8_t)(offset * 131 + index * 7 + (offset >> 9));
+}
+
+/*! in memory link without delay, frames cross until both sides are quiet */
+static void test_link_run(test_stack_t* a, test_stack_t* b) {
+    network_packet_t* packets[64];
+
+    while(network_tx_queue_size(a->tx_queue) || network_tx_queue_size(b->tx_queue)) {
+        for(uint32_t side = 0; side < 2; side++) {
+            test_stack_t* from = side ? b : a;
+            test_stack_t* to = side ? a : b;
+            uint64_t count = network_tx_queue_pop_batch(from->tx_queue, packets, 64);
+
+            for(uint64_t i = 0; i < count; i++) {
+                network_packet_t* packet = packets[i];
+
+                packet->network_type = NETWORK_TYPE_ETHERNET;
+                packet->network_info = to->ni->mac;
+                packet->return_queue = to->tx_queue;
+
+                test_frames++;
+
+                network_packet_t* responses = network_ethernet_process_packet(packet);
+
+                // a full queue drops responses as a nic would
+                if(responses && network_tx_queue_push(to->tx_queue, responses) != 0) {
+                    network_packet_release_chain(responses);
+                }
+            }
+        }
+    }
+}
+
+static void test_step(test_stack_t* a, test_stack_t* b) {
+    test_link_run(a, b);
+
+    test_now_ms += TEST_STEP_MS;
+
+    network_tcpv4_process_timers();
+}
+
+static boolean_t test_server_serve(test_server_client_t* client) {
+    while(true) {
+        if(client->pending_length) {
+            int64_t sent = network_socket_send(client->socket, client->buffer + client->pending_start, client->pending_length);
+
+            if(sent < 0) {
+                return false;
+            }
+
+            client->pending_start += sent;
+            client->pending_length -= sent;
+
+            if(client->pending_length) {
+                return true;
+            }
+        }
+
+        int64_t len = network_socket_recv(client->socket, client->buffer, sizeof(client->buffer));
+
+        if(len == 0) {
+            return true;
+        }
+
+        if(len < 0) {
+            return false;
+        }
+
+        client->pending_start = 0;
+        client->pending_length = len;
+    }
+}
+
+/*! echo server over poll, returns number of accepted connections */
+static uint64_t test_server_run(network_socket_t* listener, test_server_client_t** clients, network_socket_poll_t* fds, uint32_t* slots) {
+    uint64_t accepted = 0;
+    uint64_t count = 0;
+
+    fds[count].socket = listener;
+    fds[count++].events = NETWORK_SOCKET_EVENT_READABLE;
+
+    for(uint32_t i = 0; i < TEST_CONNECTIONS; i++) {
+        if(clients[i]) {
+            slots[count] = i;
+            fds[count].socket = clients[i]->socket;
+            fds[count++].events = clients[i]->pending_length ? NETWORK_SOCKET_EVENT_WRITABLE : NETWORK_SOCKET_EVENT_READABLE;
+        }
+    }
+
+    if(network_socket_poll(fds, count, 0) <= 0) {
+        return 0;
+    }
+
+    if(fds[0].revents & NETWORK_SOCKET_EVENT_READABLE) {
+        network_socket_t* socket = NULL;
+
+        while((socket = network_socket_accept(listener)) != NULL) {
+            uint32_t slot = 0;
+
+            while(slot < TEST_CONNECTIONS && clients[slot]) {
+                slot++;
+            }
+
+            if(slot == TEST_CONNECTIONS) {
+                network_socket_close(socket);
+
+                continue;
+            }
+
+            clients[slot] = memory_malloc(sizeof(test_server_client_t));
+            clients[slot]->socket = socket;
+
+            accepted++;
+        }
+    }
+
+    for(uint64_t i = 1; i < count; i++) {
+        if(fds[i].revents && !test_server_serve(clients[slots[i]])) {
+            network_socket_close(clients[slots[i]]->socket);
+            memory_free(clients[slots[i]]);
+            clients[slots[i]] = NULL;
+        }
+    }
+
+    return accepted;
+}
+
+static boolean_t test_client_run(test_client_t* clients, uint64_t index, network_socket_poll_t* fd, uint8_t* chunk) {
+    test_client_t* client = &clients[index];
+
+    fd->socket = client->socket;
+    fd->events = NETWORK_SOCKET_EVENT_READABLE | (client->sent < TEST_TRANSFER_SIZE ? NETWORK_SOCKET_EVENT_WRITABLE : 0);
+
+    if(network_socket_poll(fd, 1, 0) <= 0) {
+        return true;
+    }
+
+    if(fd->revents & NETWORK_SOCKET_EVENT_ERROR) {
+        print_error("connection is reset");
+
+        return false;
+    }
+
+    if(fd->revents & NETWORK_SOCKET_EVENT_WRITABLE) {
+        uint64_t len = MIN(TEST_TRANSFER_SIZE - client->sent, (uint64_t)TEST_CHUNK_SIZE);
+
+        for(uint64_t i = 0; i < len; i++) {
+            chunk[i] = test_pattern(index, client->sent + i);
+        }
+
+        int64_t res = network_socket_send(client->socket, chunk, len);
+
+        if(res > 0) {
+            client->sent += res;
+        }
+    }
+
+    if(fd->revents & NETWORK_SOCKET_EVENT_READABLE) {
+        int64_t res = 0;
+
+        while((res = network_socket_recv(client->socket, chunk, TEST_CHUNK_SIZE)) > 0) {
+            for(int64_t i = 0; i < res; i++) {
+                if(chunk[i] != test_pattern(index, client->received + i)) {
+                    print_error("echoed data is corrupted");
+
+                    return false;
+                }
+            }
+
+            client->received += res;
+        }
+    }
+
+    if(client->received == TEST_TRANSFER_SIZE) {
+        // client closes first, server closes after eof
+        network_socket_close(client->socket);
+        client->socket = NULL;
+        client->done = true;
+    }
+
+    return true;
+}
+
+static boolean_t test_tcp_echo(test_stack_t* a, test_stack_t* b) {
+    boolean_t pass = true;
+    network_socket_route_t route_ab = {.network_info = a->ni->mac, .return_queue = a->tx_queue, .pool = a->pool};
+
+    memory_memcopy(test_mac_b, route_ab.next_hop_mac, sizeof(network_mac_address_t));
+
+    network_socket_t* listener = network_socket_create(NETWORK_SOCKET_TYPE_STREAM);
+
+    if(listener == NULL || network_socket_bind(listener, test_ip_b, TEST_TCP_PORT) != 0 || network_socket_listen(listener, TEST_BACKLOG) != 0) {
+        print_error("cannot listen");
+
+        return false;
+    }
+
+    network_socket_t* duplicate = network_socket_create(NETWORK_SOCKET_TYPE_STREAM);
+
+    if(network_socket_bind(duplicate, test_ip_b, TEST_TCP_PORT) == 0) {
+        print_error("port is bound twice");
+        pass = false;
+    }
+
+    network_socket_close(duplicate);
+
+    test_client_t* clients = memory_malloc(sizeof(test_client_t) * TEST_CONNECTIONS);
+    test_server_client_t** server_clients = memory_malloc(sizeof(test_server_client_t*) * TEST_CONNECTIONS);
+    network_socket_poll_t* fds = memory_malloc(sizeof(network_socket_poll_t) * (TEST_CONNECTIONS + 1));
+    uint32_t* slots = memory_malloc(sizeof(uint32_t) * (TEST_CONNECTIONS + 1));
+    uint8_t* chunk = memory_malloc(TEST_CHUNK_SIZE);
+    network_socket_address_t server_address = {.ip = test_ip_b, .port = TEST_TCP_PORT, .route = route_ab};
+
+    uint64_t wall_start = time_ns(NULL);
+    uint64_t sim_start = test_now_ms;
+    uint64_t frames_start = test_frames;
+
+    uint64_t accepted = 0;
+    uint64_t done = 0;
+    uint64_t started = 0;
+    uint64_t deadline = test_now_ms + TEST_TIME_LIMIT_MS;
+
+    while(pass && done < TEST_CONNECTIONS && test_now_ms < deadline) {
+        // a backlog of connections starts at each step, syns over backlog would wait seconds for retransmit
+        for(uint64_t i = 0; i < TEST_BACKLOG && started < TEST_CONNECTIONS; i++, started++) {
+            clients[started].socket = network_socket_create(NETWORK_SOCKET_TYPE_STREAM);
+
+            if(clients[started].socket == NULL || network_socket_bind(clients[started].socket, test_ip_a, 0) != 0 ||
+               network_socket_connect(clients[started].socket, &server_address) != 0) {
+                print_error("cannot connect");
+                pass = false;
+
+                break;
+            }
+        }
+
+        accepted += test_server_run(listener, server_clients, fds, slots);
+
+        done = 0;
+
+        for(uint64_t i = 0; i < started && pass; i++) {
+            if(!clients[i].done) {
+                pass &= test_client_run(clients, i, &fds[0], chunk);
+            }
+
+            done += clients[i].done;
+        }
+
+        test_step(a, b);
+    }
+
+    // server sees eofs and closes remaining sockets
+    for(uint64_t i = 0; i < 16; i++) {
+        test_server_run(listener, server_clients, fds, slots);
+        test_step(a, b);
+    }
+
+    uint64_t wall_elapsed = time_ns(NULL) - wall_start;
+    uint64_t sim_elapsed = test_now_ms - sim_start;
+
+    if(done != TEST_CONNECTIONS || accepted != TEST_CONNECTIONS) {
+        print_error("echo is not completed");
+        printf("%lli connections done, %lli accepted\n", done, accepted);
+        pass = false;
+    } else {
+        uint64_t bytes = TEST_CONNECTIONS * TEST_TRANSFER_SIZE * 2;
+
+        printf("%i connections with backlog %i: %lli ms simulated, %lli frames, wall %lli us, %lli connections/s, %lli MB/s echoed\n",
+               TEST_CONNECTIONS, TEST_BACKLOG, sim_elapsed, test_frames - frames_start, wall_elapsed / 1000,
+               TEST_CONNECTIONS * 1000000000ULL / wall_elapsed, bytes * 1000ULL / wall_elapsed);
+    }
+
+    for(uint64_t i = 0; i < TEST_CONNECTIONS; i++) {
+        if(server_clients[i]) {
+            print_error("server socket is not closed");
+            network_socket_close(server_clients[i]->socket);
+            memory_free(server_clients[i]);
+            pass = false;
+        }
+
+        if(clients[i].socket) {
+            network_socket_close(clients[i].socket);
+        }
+    }
+
+    network_socket_close(listener);
+
+    // time wait of clients ends without traffic
+    test_now_ms += NETWORK_TCPV4_TIME_WAIT_MS;
+    test_step(a, b);
+
+    if(network_tcpv4_listener_get(test_ip_b, TEST_TCP_PORT) != NULL || network_tcpv4_listener_get(test_ip_a, NETWORK_SOCKET_EPHEMERAL_PORT_START) != NULL) {
+        print_error("connections are not freed");
+        pass = false;
+    }
+
+    memory_free(chunk);
+    memory_free(slots);
+    memory_free(fds);
+    memory_free(server_clients);
+    memory_free(clients);
+
+    return pass;
+}
+
+static boolean_t test_udp_echo(test_stack_t* a, test_stack_t* b) {
+    boolean_t pass = true;
+    network_socket_address_t server_address = {.ip = test_ip_b, .port = TEST_UDP_PORT,
+                                               .route = {.network_info = a->ni->mac, .return_queue = a->tx_queue, .pool = a->pool}};
+
+    memory_memcopy(test_mac_b, server_address.route.next_hop_mac, sizeof(network_mac_address_t));
+
+    network_socket_t* server = network_socket_create(NETWORK_SOCKET_TYPE_DATAGRAM);
+    network_socket_t* client = network_socket_create(NETWORK_SOCKET_TYPE_DATAGRAM);
+
+    if(server == NULL || client == NULL || network_socket_bind(server, test_ip_b, TEST_UDP_PORT) != 0 ||
+       network_socket_bind(client, test_ip_a, 0) != 0) {
+        print_error("cannot bind datagram sockets");
+
+        return false;
+    }
+
+    uint8_t data[256] = {0};
+    uint64_t received = 0;
+
+    for(uint64_t i = 0; i < TEST_DATAGRAMS; i++) {
+        uint64_t len = 1 + i % sizeof(data);
+
+        for(uint64_t j = 0; j < len; j++) {
+            data[j] = test_pattern(i, j);
+        }
+
+        if(network_socket_sendto(client, data, len, &server_address) != (int64_t)len) {
+            print_error("cannot send datagram");
+            pass = false;
+
+            break;
+        }
+
+        test_link_run(a, b);
+
+        network_socket_address_t from = {0};
+        int64_t res = network_socket_recvfrom(server, data, sizeof(data), &from);
+
+        if(res != (int64_t)len || from.port == 0 || !network_ipv4_is_address_eq(from.ip, test_ip_a)) {
+            print_error("datagram is not received");
+            pass = false;
+
+            break;
+        }
+
+        // reply leaves from the path request came
+        network_socket_sendto(server, data, res, &from);
+
+        test_link_run(a, b);
+
+        network_socket_poll_t fd = {.socket = client, .events = NETWORK_SOCKET_EVENT_READABLE};
+
+        if(network_socket_poll(&fd, 1, 0) != 1 || network_socket_recvfrom(client, data, sizeof(data), NULL) != (int64_t)len) {
+            print_error("datagram echo is not received");
+            pass = false;
+
+            break;
+        }
+
+        for(uint64_t j = 0; j < len; j++) {
+            if(data[j] != test_pattern(i, j)) {
+                print_error("datagram is corrupted");
+                pass = false;
+            }
+        }
+
+        received++;
+    }
+
+    printf("%lli of %i datagrams echoed\n", received, TEST_DATAGRAMS);
+
+    network_socket_close(server);
+    network_socket_close(client);
+
+    return pass;
+}
+
+/*! fake scheduler with pending wakes like task scheduler, link delivers frames at wait begin or at yield */
+static struct {
+    test_stack_t* a;
+    test_stack_t* b;
+    boolean_t     deliver_at_begin;
+    boolean_t     waiting;
+    boolean_t     wake_pending;
+    uint64_t      yield_count;
+    uint64_t      lost_wake_count;
+} test_sched;
+
+static uint64_t test_sched_task_id(void) {
+    return 0x42;
+}
+
+static void test_sched_wait_begin(uint64_t timeout_ms) {
+    UNUSED(timeout_ms);
+
+    // notification arrives after poll checked sockets and before task is parked
+    if(test_sched.deliver_at_begin) {
+        test_link_run(test_sched.a, test_sched.b);
+    }
+
+    test_sched.waiting = true;
+}
+
+static void test_sched_wait_end(void) {
+    test_sched.waiting = false;
+    test_sched.wake_pending = false;
+}
+
+static void test_sched_waker(uint64_t task_id) {
+    UNUSED(task_id);
+
+    test_sched.wake_pending = true;
+}
+
+static void test_sched_yielder(void) {
+    test_sched.yield_count++;
+
+    if(!test_sched.deliver_at_begin) {
+        test_link_run(test_sched.a, test_sched.b);
+    }
+
+    // a parked task without pending wake is never scheduled again
+    if(test_sched.waiting && !test_sched.wake_pending) {
+        test_sched.lost_wake_count++;
+    }
+
+    test_sched.waiting = false;
+    test_sched.wake_pending = false;
+}
+
+static void test_sched_install(boolean_t install) {
+    future_task_id_getter_func = install ? &test_sched_task_id : NULL;
+    future_task_wait_begin_func = install ? &test_sched_wait_begin : NULL;
+    future_task_wait_end_func = install ? &test_sched_wait_end : NULL;
+    future_task_waker_func = install ? &test_sched_waker : NULL;
+    future_task_yielder_func = install ? &test_sched_yielder : NULL;
+}
+
+static boolean_t test_poll_park(test_stack_t* a, test_stack_t* b) {
+    boolean_t pass = true;
+    network_socket_address_t client_address = {.ip = test_ip_a, .port = TEST_UDP_PORT,
+                                               .route = {.network_info = b->ni->mac, .return_queue = b->tx_queue, .pool = b->pool}};
+
+    memory_memcopy(test_mac_a, client_address.route.next_hop_mac, sizeof(network_mac_address_t));
+
+    network_socket_t* server = network_socket_create(NETWORK_SOCKET_TYPE_DATAGRAM);
+    network_socket_t* client = network_socket_create(NETWORK_SOCKET_TYPE_DATAGRAM);
+
+    if(server == NULL || client == NULL || network_socket_bind(server, test_ip_b, 0) != 0 ||
+       network_socket_bind(client, test_ip_a, TEST_UDP_PORT) != 0) {
+        print_error("cannot bind datagram sockets");
+
+        return false;
+    }
+
+    test_sched.a = a;
+    test_sched.b = b;
+    test_sched_install(true);
+
+    uint8_t data[16] = {0};
+
+    for(uint32_t at_begin = 0; at_begin < 2; at_begin++) {
+        test_sched.deliver_at_begin = at_begin;
+        test_sched.yield_count = 0;
+
+        network_socket_sendto(server, data, sizeof(data), &client_address);
+
+        network_socket_poll_t fd = {.socket = client, .events = NETWORK_SOCKET_EVENT_READABLE};
+
+        if(network_socket_poll(&fd, 1, NETWORK_SOCKET_POLL_FOREVER) != 1 || test_sched.yield_count != 1 ||
+           network_socket_recvfrom(client, data, sizeof(data), NULL) != sizeof(data)) {
+            printf("delivery at %s yields %lli\n", at_begin ? "wait begin" : "yield", test_sched.yield_count);
+            print_error("parked poll did not see datagram");
+            pass = false;
+        }
+    }
+
+    if(test_sched.lost_wake_count) {
+        print_error("poll parked without a pending wake");
+        pass = false;
+    }
+
+    test_sched_install(false);
+
+    network_socket_close(server);
+    network_socket_close(client);
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    network_info_map = map_new(&test_network_info_mke);
+    network_tcpv4_set_clock(&test_clock);
+
+    test_stack_t a = {0};
+    test_stack_t b = {0};
+
+    if(!test_stack_init(&a, test_mac_a, test_ip_a) || !test_stack_init(&b, test_mac_b, test_ip_b) || network_socket_init() != 0) {
+        print_error("cannot create stacks");
+
+        return -1;
+    }
+
+    pass &= test_tcp_echo(&a, &b);
+    pass &= test_udp_echo(&a, &b);
+    pass &= test_poll_park(&a, &b);
+
+    network_socket_destroy();
+    network_tcpv4_destroy_all();
+    network_tcpv4_set_clock(NULL);
+
+    pass &= test_stack_destroy(&a);
+    pass &= test_stack_destroy(&b);
+
+    network_ipv4_fragment_destroy();
+    map_destroy(network_info_map);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass?0:-1;
+}
@@ -0,0 +1,83 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___TEST_NETWORK_STACK_H
+#define ___TEST_NETWORK_STACK_H 0
+
+/*
+ * two network stacks at one process, a and b. each stack has a network info, a tx queue which test links
+ * drain and a packet pool. tests move frames between tx queues with their own link model.
+ */
+
+#include <types.h>
+#include <memory.h>
+#include <map.h>
+#include <network/network_info.h>
+#include <network/network_packet.h>
+#include <network/network_tx_queue.h>
+
+#ifndef TEST_POOL_SIZE
+#define TEST_POOL_SIZE 2048ULL
+#endif
+
+uint64_t test_network_info_mke(const void* key);
+
+map_t* network_info_map = NULL;
+
+typedef struct test_stack_t {
+    network_info_t*        ni;
+    network_tx_queue_t*    tx_queue;
+    network_packet_pool_t* pool;
+} test_stack_t;
+
+static network_mac_address_t test_mac_a = {0x52, 0x54, 0x00, 0x00, 0x00, 0x0A};
+static network_mac_address_t test_mac_b = {0x52, 0x54, 0x00, 0x00, 0x00, 0x0B};
+static network_ipv4_address_t test_ip_a = { .as_bytes = {10, 0, 0, 1} };
+static network_ipv4_address_t test_ip_b = { .as_bytes = {10, 0, 0, 2} };
+
+uint64_t test_network_info_mke(const void* key) {
+    uint64_t x = 0;
+    memory_memcopy(key, &x, sizeof(network_mac_address_t));
+
+    return x;
+}
+
+static boolean_t test_stack_init(test_stack_t* stack, network_mac_address_t mac, network_ipv4_address_t ip) {
+    stack->ni = memory_malloc(sizeof(network_info_t));
+    stack->tx_queue = network_tx_queue_create(NULL, TEST_POOL_SIZE);
+    stack->pool = network_packet_pool_create(NULL, TEST_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    if(stack->ni == NULL || stack->tx_queue == NULL || stack->pool == NULL) {
+        return false;
+    }
+
+    memory_memcopy(mac, stack->ni->mac, sizeof(network_mac_address_t));
+    stack->ni->ipv4_address = ip;
+    stack->ni->is_ipv4_address_set = true;
+    stack->ni->return_queue = stack->tx_queue;
+
+    map_insert(network_info_map, stack->ni->mac, stack->ni);
+
+    return true;
+}
+
+static boolean_t test_stack_destroy(test_stack_t* stack) {
+    boolean_t pass = true;
+
+    // queued packets are released with queue
+    network_tx_queue_destroy(stack->tx_queue);
+
+    if(network_packet_pool_get_free_count(stack->pool) != TEST_POOL_SIZE) {
+        print_error("packets are leaked");
+        pass = false;
+    }
+
+    network_packet_pool_destroy(stack->pool);
+    memory_free(stack->ni);
+
+    return pass;
+}
+
+#endif
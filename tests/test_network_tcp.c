@@ -0,0 +1,431 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x10000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_ethernet.h>
+#include <network/network_ipv4.h>
+#include <network/network_ipv4_fragment.h>
+#include <network/network_tcpv4.h>
+#include <network/network_checksum.h>
+#include <network/network_tx_queue.h>
+#include <bplustree.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_POOL_SIZE         2048ULL
+#define TEST_LINK_RING_SIZE    4096
+#define TEST_LINK_RATE_BPS     20000000ULL
+#define TEST_LINK_DELAY_US     10000ULL
+#define TEST_LINK_BUFFER_US    30000ULL
+#define TEST_STEP_US           100ULL
+#define TEST_TRANSFER_SIZE     (4ULL << 20)
+#define TEST_CHUNK_SIZE        (16 << 10)
+#define TEST_TIME_LIMIT_US     (120ULL * 1000000ULL)
+#define TEST_SERVER_PORT       5001
+#define TEST_CLIENT_PORT_BASE  40000
+
+#include "test_network_stack.h"
+
+int32_t  main(uint32_t argc, char_t** argv);
+
+typedef struct test_link_frame_t {
+    network_packet_t* packet;
+    uint64_t          deliver_at;
+} test_link_frame_t;
+
+/*! one direction of simulated link: serialization at rate, propagation delay, tail drop and random loss */
+typedef struct test_link_t {
+    test_link_frame_t frames[TEST_LINK_RING_SIZE];
+    uint64_t          head;
+    uint64_t          tail;
+    uint64_t          busy_until;
+    uint32_t          loss_per_mille;
+    uint64_t          dropped;
+    uint64_t          delivered;
+} test_link_t;
+
+typedef struct test_scenario_t {
+    const char_t*                      name;
+    network_tcpv4_congestion_control_t congestion_control;
+    uint32_t                           loss_per_mille;
+    uint32_t                           read_bytes_per_ms; ///< 0 reads everything at once
+} test_scenario_t;
+
+static uint64_t test_now_us = 1000000;
+static uint64_t test_random_state = 0x9E3779B97F4A7C15ULL;
+
+static test_link_t test_link_ab;
+static test_link_t test_link_ba;
+
+static uint64_t test_clock(void) {
+    return test_now_us / 1000;
+}
+
+static uint32_t test_random(void) {
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 7;
+    test_random_state ^= test_random_state << 17;
+
+    return test_random_state;
+}
+
+static uint8_t test_pattern(uint64_t offset) {
+    return (uint8_t)(offset * 131 + (offset >> 11));
+}
+
+static void test_link_send(test_link_t* link, network_packet_t* packet) {
+    uint64_t start = MAX(link->busy_until, test_now_us);
+
+    if(start - test_now_us > TEST_LINK_BUFFER_US || link->tail - link->head == TEST_LINK_RING_SIZE ||
+       test_random() % 1000 < link->loss_per_mille) {
+        link->dropped++;
+        network_packet_release(packet);
+
+        return;
+    }
+
+    link->busy_until = start + (packet->length * 8ULL * 1000000ULL) / TEST_LINK_RATE_BPS;
+
+    test_link_frame_t* frame = &link->frames[link->tail % TEST_LINK_RING_SIZE];
+
+    frame->packet = packet;
+    frame->deliver_at = link->busy_until + TEST_LINK_DELAY_US;
+
+    link->tail++;
+}
+
+static void test_link_deliver(test_link_t* link, test_stack_t* to) {
+    while(link->head != link->tail && link->frames[link->head % TEST_LINK_RING_SIZE].deliver_at <= test_now_us) {
+        network_packet_t* packet = link->frames[link->head % TEST_LINK_RING_SIZE].packet;
+
+        link->head++;
+        link->delivered++;
+
+        // frame crosses without copy, receiving stack sees it as its nic's packet
+        packet->network_type = NETWORK_TYPE_ETHERNET;
+        packet->network_info = to->ni->mac;
+        packet->return_queue = to->tx_queue;
+
+        network_packet_t* responses = network_ethernet_process_packet(packet);
+
+        // a full queue drops responses as a nic would
+        if(responses && network_tx_queue_push(to->tx_queue, responses) != 0) {
+            network_packet_release_chain(responses);
+        }
+    }
+}
+
+static void test_link_flush(test_link_t* link) {
+    while(link->head != link->tail) {
+        network_packet_release(link->frames[link->head % TEST_LINK_RING_SIZE].packet);
+        link->head++;
+    }
+}
+
+static void test_step(test_stack_t* a, test_stack_t* b) {
+    network_packet_t* packets[64];
+    uint64_t count = 0;
+
+    while((count = network_tx_queue_pop_batch(a->tx_queue, packets, 64)) != 0) {
+        for(uint64_t i = 0; i < count; i++) {
+            test_link_send(&test_link_ab, packets[i]);
+        }
+    }
+
+    while((count = network_tx_queue_pop_batch(b->tx_queue, packets, 64)) != 0) {
+        for(uint64_t i = 0; i < count; i++) {
+            test_link_send(&test_link_ba, packets[i]);
+        }
+    }
+
+    test_link_deliver(&test_link_ab, b);
+    test_link_deliver(&test_link_ba, a);
+
+    network_tcpv4_process_timers();
+
+    test_now_us += TEST_STEP_US;
+}
+
+static boolean_t test_transfer(test_stack_t* a, test_stack_t* b, const test_scenario_t* scenario, uint16_t client_port) {
+    uint8_t* chunk = memory_malloc(TEST_CHUNK_SIZE);
+
+    memory_memclean(&test_link_ab, sizeof(test_link_t));
+    memory_memclean(&test_link_ba, sizeof(test_link_t));
+    test_link_ab.loss_per_mille = scenario->loss_per_mille;
+    test_link_ba.loss_per_mille = scenario->loss_per_mille;
+
+    network_tcpv4_connection_t* client = network_tcpv4_connect(a->ni->mac, a->tx_queue, test_mac_b, a->pool,
+                                                               test_ip_a, client_port, test_ip_b, TEST_SERVER_PORT);
+
+    if(client == NULL) {
+        print_error("cannot connect");
+        memory_free(chunk);
+
+        return false;
+    }
+
+    network_tcpv4_set_congestion_control(client, scenario->congestion_control);
+
+    network_tcpv4_connection_t* server = NULL;
+    boolean_t pass = true;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t start_us = test_now_us;
+    uint64_t deadline = test_now_us + TEST_TIME_LIMIT_US;
+    uint64_t wall_start = time_ns(NULL);
+    uint64_t read_budget = 0;
+
+    while(received < TEST_TRANSFER_SIZE && test_now_us < deadline) {
+        if(server == NULL) {
+            server = network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port);
+        }
+
+        if(client->state == NETWORK_TCP_CONNECTION_STATE_ESTABLISHED && sent < TEST_TRANSFER_SIZE) {
+            uint64_t len = MIN(TEST_TRANSFER_SIZE - sent, (uint64_t)TEST_CHUNK_SIZE);
+
+            for(uint64_t i = 0; i < len; i++) {
+                chunk[i] = test_pattern(sent + i);
+            }
+
+            int64_t res = network_tcpv4_send(client, chunk, len);
+
+            if(res > 0) {
+                sent += res;
+            }
+        }
+
+        if(server) {
+            if(scenario->read_bytes_per_ms) {
+                read_budget += scenario->read_bytes_per_ms * TEST_STEP_US / 1000;
+            } else {
+                read_budget = TEST_CHUNK_SIZE;
+            }
+
+            while(read_budget) {
+                int64_t res = network_tcpv4_recv(server, chunk, MIN(read_budget, (uint64_t)TEST_CHUNK_SIZE));
+
+                if(res <= 0) {
+                    break;
+                }
+
+                for(int64_t i = 0; i < res; i++) {
+                    if(chunk[i] != test_pattern(received + i)) {
+                        pass = false;
+                    }
+                }
+
+                received += res;
+
+                if(scenario->read_bytes_per_ms) {
+                    read_budget -= res;
+                }
+            }
+
+            if(!scenario->read_bytes_per_ms) {
+                read_budget = 0;
+            }
+        }
+
+        test_step(a, b);
+    }
+
+    uint64_t wall_elapsed = time_ns(NULL) - wall_start;
+    uint64_t sim_elapsed = test_now_us - start_us;
+
+    if(received != TEST_TRANSFER_SIZE || !pass) {
+        print_error("transfer failed");
+        printf("%s: 0x%llx of 0x%llx bytes received, content %s\n", scenario->name, received, TEST_TRANSFER_SIZE, pass?"ok":"corrupted");
+
+        pass = false;
+    } else {
+        printf("%s: goodput %lli.%lli%lli Mbit/s (%lli ms simulated, link %lli Mbit/s), retransmits %lli, fast recoveries %lli, timeouts %lli, "
+               "drops %lli/%lli, srtt %i ms, wall %lli us\n",
+               scenario->name,
+               received * 8 / sim_elapsed, (received * 80 / sim_elapsed) % 10, (received * 800 / sim_elapsed) % 10, sim_elapsed / 1000, TEST_LINK_RATE_BPS / 1000000,
+               client->stat_retransmits, client->stat_fast_recoveries, client->stat_timeouts,
+               test_link_ab.dropped, test_link_ba.dropped, client->srtt_x8 >> 3, wall_elapsed / 1000);
+
+        if(scenario->loss_per_mille && client->stat_retransmits == 0) {
+            print_error("lossy link without retransmission");
+            pass = false;
+        }
+    }
+
+    // client closes first, server closes after reading fin
+    network_tcpv4_close(client);
+
+    deadline = test_now_us + TEST_TIME_LIMIT_US;
+
+    while(test_now_us < deadline) {
+        server = network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port);
+
+        if(server && server->state == NETWORK_TCP_CONNECTION_STATE_CLOSE_WAIT && network_tcpv4_recv(server, chunk, TEST_CHUNK_SIZE) == -1) {
+            network_tcpv4_close(server);
+        }
+
+        client = network_tcpv4_connection_get(test_ip_a, client_port, test_ip_b, TEST_SERVER_PORT);
+
+        if(server == NULL && client && client->state == NETWORK_TCP_CONNECTION_STATE_TIME_WAIT) {
+            // time wait ends without traffic
+            test_now_us += NETWORK_TCPV4_TIME_WAIT_MS * 1000ULL;
+        }
+
+        if(server == NULL && client == NULL) {
+            break;
+        }
+
+        test_step(a, b);
+    }
+
+    if(network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port) != NULL ||
+       network_tcpv4_connection_get(test_ip_a, client_port, test_ip_b, TEST_SERVER_PORT) != NULL) {
+        print_error("connections are not closed");
+        pass = false;
+    }
+
+    test_link_flush(&test_link_ab);
+    test_link_flush(&test_link_ba);
+
+    memory_free(chunk);
+
+    return pass;
+}
+
+/*! an in window reset with inexact sequence gets a challenge ack, peer's answer to it resets connection */
+static boolean_t test_blind_reset(test_stack_t* a, test_stack_t* b, uint16_t client_port) {
+    memory_memclean(&test_link_ab, sizeof(test_link_t));
+    memory_memclean(&test_link_ba, sizeof(test_link_t));
+
+    network_tcpv4_connection_t* client = network_tcpv4_connect(a->ni->mac, a->tx_queue, test_mac_b, a->pool,
+                                                               test_ip_a, client_port, test_ip_b, TEST_SERVER_PORT);
+    network_tcpv4_connection_t* server = NULL;
+    uint64_t deadline = test_now_us + TEST_TIME_LIMIT_US;
+
+    while(client && test_now_us < deadline && (server == NULL || server->state != NETWORK_TCP_CONNECTION_STATE_ESTABLISHED)) {
+        test_step(a, b);
+
+        server = network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port);
+    }
+
+    if(server == NULL) {
+        print_error("cannot connect");
+
+        return false;
+    }
+
+    boolean_t pass = true;
+    network_packet_t* packet = NULL;
+
+    network_tcpv4_abort(client);
+
+    if(network_tx_queue_pop_batch(a->tx_queue, &packet, 1) != 1) {
+        print_error("abort did not send reset");
+
+        return false;
+    }
+
+    // forged reset lands one byte after rcv_nxt of server
+    network_ipv4_header_t* ipv4 = (network_ipv4_header_t*)(network_packet_data(packet) + sizeof(network_ethernet_t));
+    network_tcpv4_header_t* tcp = (network_tcpv4_header_t*)((uint8_t*)ipv4 + ipv4->header_length * 4);
+    uint32_t old_seq = tcp->sequence_number;
+
+    tcp->sequence_number = BYTE_SWAP32(BYTE_SWAP32(old_seq) + 1);
+
+    if(!(packet->checksum_flags & NETWORK_PACKET_CHECKSUM_L4_OFFLOAD)) {
+        tcp->checksum = network_checksum_update32(tcp->checksum, old_seq, tcp->sequence_number);
+    }
+
+    packet->network_type = NETWORK_TYPE_ETHERNET;
+    packet->network_info = b->ni->mac;
+    packet->return_queue = b->tx_queue;
+
+    network_packet_t* responses = network_ethernet_process_packet(packet);
+
+    if(network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port) != server || responses == NULL) {
+        print_error("inexact reset is accepted or not challenged");
+        pass = false;
+    }
+
+    if(responses && network_tx_queue_push(b->tx_queue, responses) != 0) {
+        network_packet_release_chain(responses);
+    }
+
+    deadline = test_now_us + TEST_TIME_LIMIT_US;
+
+    while(test_now_us < deadline && network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port)) {
+        test_step(a, b);
+    }
+
+    if(network_tcpv4_connection_get(test_ip_b, TEST_SERVER_PORT, test_ip_a, client_port) != NULL) {
+        print_error("exact reset after challenge ack is not accepted");
+        pass = false;
+    }
+
+    test_link_flush(&test_link_ab);
+    test_link_flush(&test_link_ba);
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    const test_scenario_t scenarios[] = {
+        {"clean cubic", NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC, 0, 0},
+        {"clean newreno", NETWORK_TCPV4_CONGESTION_CONTROL_NEWRENO, 0, 0},
+        {"1% loss newreno", NETWORK_TCPV4_CONGESTION_CONTROL_NEWRENO, 10, 0},
+        {"1% loss cubic", NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC, 10, 0},
+        {"5% loss cubic", NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC, 50, 0},
+        {"slow reader", NETWORK_TCPV4_CONGESTION_CONTROL_CUBIC, 0, 1000},
+    };
+
+    network_info_map = map_new(&test_network_info_mke);
+    network_tcpv4_set_clock(&test_clock);
+
+    test_stack_t a = {0};
+    test_stack_t b = {0};
+
+    if(!test_stack_init(&a, test_mac_a, test_ip_a) || !test_stack_init(&b, test_mac_b, test_ip_b)) {
+        print_error("cannot create stacks");
+
+        return -1;
+    }
+
+    if(network_tcpv4_listen(test_ip_b, TEST_SERVER_PORT, 0) == NULL) {
+        print_error("cannot listen");
+
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        pass &= test_transfer(&a, &b, &scenarios[i], TEST_CLIENT_PORT_BASE + i);
+    }
+
+    pass &= test_blind_reset(&a, &b, TEST_CLIENT_PORT_BASE + sizeof(scenarios) / sizeof(scenarios[0]));
+
+    network_tcpv4_destroy_all();
+    network_tcpv4_set_clock(NULL);
+
+    pass &= test_stack_destroy(&a);
+    pass &= test_stack_destroy(&b);
+
+    network_ipv4_fragment_destroy();
+    map_destroy(network_info_map);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass?0:-1;
+}
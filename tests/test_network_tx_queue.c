@@ -0,0 +1,531 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x8000000
+#include "setup.h"
+#include <network.h>
+#include <network/network_packet.h>
+#include <network/network_info.h>
+#include <network/network_tx_queue.h>
+#include <driver/network_igb.h>
+#include <bplustree.h>
+#include <strings.h>
+#include <list.h>
+#include <utils.h>
+
+#define TEST_POOL_SIZE         4096
+#define TEST_QUEUE_SIZE        256
+#define TEST_RING_SIZE         128
+#define TEST_BUFFER_SIZE       2048
+#define TEST_FRAME_SIZE        64
+#define TEST_BENCH_PACKETS     2000000ULL
+#define TEST_BENCH_CHAIN       16
+
+int32_t  main(uint32_t argc, char_t** argv);
+uint64_t test_network_info_mke(const void* key);
+
+map_t* network_info_map = NULL;
+
+static uint64_t test_seed = 0x2545F4914F6CDD1DULL;
+static uint64_t test_wakes = 0;
+static uint64_t test_woken_task = 0;
+
+uint64_t test_network_info_mke(const void* key) {
+    uint64_t x = 0;
+    memory_memcopy(key, &x, sizeof(network_mac_address_t));
+
+    return x;
+}
+
+static uint32_t test_random(void) {
+    test_seed = test_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return test_seed >> 33;
+}
+
+static void test_waker(uint64_t task_id) {
+    test_wakes++;
+    test_woken_task = task_id;
+}
+
+/*! chain of packets, each carries its sequence number */
+static network_packet_t* test_chain(network_packet_pool_t* pool, uint32_t count, uint32_t* seq) {
+    network_packet_t* head = NULL;
+    network_packet_t** tail = &head;
+
+    for(uint32_t i = 0; i < count; i++) {
+        network_packet_t* packet = network_packet_alloc(pool, TEST_FRAME_SIZE);
+        uint8_t* data = network_packet_put(packet, TEST_FRAME_SIZE);
+
+        if(data == NULL) {
+            network_packet_release(packet);
+
+            break;
+        }
+
+        memory_memcopy(seq, data, sizeof(uint32_t));
+        (*seq)++;
+
+        *tail = packet;
+        tail = &packet->next;
+    }
+
+    return head;
+}
+
+static uint32_t test_seq(const network_packet_t* packet) {
+    uint32_t seq = 0;
+
+    memory_memcopy(network_packet_data(packet), &seq, sizeof(uint32_t));
+
+    return seq;
+}
+
+static boolean_t test_push_pop(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_tx_queue_t* queue = network_tx_queue_create(NULL, TEST_QUEUE_SIZE - 10);
+    network_packet_t* packets[TEST_QUEUE_SIZE];
+    uint32_t sent = 0;
+    uint32_t received = 0;
+
+    if(queue == NULL || network_tx_queue_get_free_count(queue) != TEST_QUEUE_SIZE) {
+        print_error("capacity is not rounded to power of two");
+        network_tx_queue_destroy(queue);
+
+        return false;
+    }
+
+    // several laps around slots with chains of random length
+    for(uint32_t round = 0; round < 1000 && pass; round++) {
+        uint32_t pushes = test_random() % 8;
+
+        for(uint32_t i = 0; i < pushes; i++) {
+            uint32_t first = sent;
+            network_packet_t* chain = test_chain(pool, 1 + test_random() % 16, &sent);
+
+            if(network_tx_queue_push(queue, chain) != 0) {
+                network_packet_release_chain(chain);
+                sent = first;
+
+                break;
+            }
+        }
+
+        uint64_t count = network_tx_queue_pop_batch(queue, packets, test_random() % 64);
+
+        for(uint64_t i = 0; i < count && pass; i++) {
+            if(test_seq(packets[i]) != received || packets[i]->next != NULL) {
+                printf("expected %i got %i\n", received, test_seq(packets[i]));
+                print_error("packets are out of order");
+                pass = false;
+            }
+
+            received++;
+            network_packet_release(packets[i]);
+        }
+    }
+
+    if(pass && network_tx_queue_size(queue) != sent - received) {
+        print_error("queue size is wrong");
+        pass = false;
+    }
+
+    network_tx_queue_destroy(queue);
+
+    if(network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE) {
+        print_error("destroy does not release queued packets");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_back_pressure(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_tx_queue_t* queue = network_tx_queue_create(NULL, 16);
+    uint32_t seq = 0;
+
+    network_packet_t* chain = test_chain(pool, 14, &seq);
+
+    if(network_tx_queue_push(queue, chain) != 0 || network_tx_queue_get_free_count(queue) != 2) {
+        print_error("chain is not queued");
+        pass = false;
+    }
+
+    // whole chain or nothing, caller keeps a rejected chain intact
+    chain = test_chain(pool, 3, &seq);
+
+    if(network_tx_queue_push(queue, chain) != -1 || network_tx_queue_size(queue) != 14 ||
+       chain->next == NULL || chain->next->next == NULL || test_seq(chain->next->next) != 16) {
+        print_error("full queue does not reject chain");
+        pass = false;
+    }
+
+    network_packet_t* packets[4];
+
+    if(network_tx_queue_pop_batch(queue, packets, 4) != 4) {
+        print_error("cannot pop");
+        pass = false;
+    }
+
+    for(uint32_t i = 0; i < 4; i++) {
+        network_packet_release(packets[i]);
+    }
+
+    if(network_tx_queue_push(queue, chain) != 0 || network_tx_queue_size(queue) != 13) {
+        print_error("chain is not queued after consumer drains");
+        pass = false;
+    }
+
+    chain = test_chain(pool, 17, &seq);
+
+    if(network_tx_queue_push(queue, chain) != -1) {
+        print_error("chain longer than queue is accepted");
+        pass = false;
+    }
+
+    network_packet_release_chain(chain);
+    network_tx_queue_destroy(queue);
+
+    return pass;
+}
+
+static boolean_t test_wake(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_tx_queue_t* queue = network_tx_queue_create(NULL, 64);
+    network_packet_t* packets[64];
+    uint32_t seq = 0;
+
+    network_tx_queue_set_consumer(queue, 42, &test_waker);
+    test_wakes = 0;
+
+    // consumer is running, producers do not wake it
+    network_tx_queue_push(queue, test_chain(pool, 4, &seq));
+
+    if(test_wakes != 0) {
+        print_error("running consumer is woken");
+        pass = false;
+    }
+
+    if(network_tx_queue_prepare_wait(queue)) {
+        print_error("consumer sleeps with queued packets");
+        pass = false;
+    }
+
+    network_tx_queue_push(queue, test_chain(pool, 4, &seq));
+
+    if(test_wakes != 0) {
+        print_error("consumer is woken after cancelled wait");
+        pass = false;
+    }
+
+    for(uint64_t count = network_tx_queue_pop_batch(queue, packets, 64), i = 0; i < count; i++) {
+        network_packet_release(packets[i]);
+    }
+
+    // a batch wakes sleeping consumer once
+    if(!network_tx_queue_prepare_wait(queue)) {
+        print_error("consumer cannot sleep on empty queue");
+        pass = false;
+    }
+
+    network_tx_queue_push(queue, test_chain(pool, 10, &seq));
+    network_tx_queue_push(queue, test_chain(pool, 10, &seq));
+
+    if(test_wakes != 1 || test_woken_task != 42) {
+        printf("wakes %lli\n", test_wakes);
+        print_error("sleeping consumer is not woken once");
+        pass = false;
+    }
+
+    network_tx_queue_destroy(queue);
+
+    return pass;
+}
+
+/*! simulated nic, it sends descriptors from head up to tail */
+typedef struct test_nic_t {
+    network_igb_tx_ring_t ring;
+    uint32_t              head;
+    uint64_t              tail_writes;
+} test_nic_t;
+
+static boolean_t test_nic_create(test_nic_t* nic, uint32_t count) {
+    memory_memclean(nic, sizeof(test_nic_t));
+
+    nic->ring.desc = memory_malloc(sizeof(network_igb_tx_desc_t) * count);
+    nic->ring.buffer_va = (uint64_t)memory_malloc((uint64_t)TEST_BUFFER_SIZE * count);
+    nic->ring.buffer_size = TEST_BUFFER_SIZE;
+    nic->ring.count = count;
+
+    return nic->ring.desc != NULL && nic->ring.buffer_va != 0;
+}
+
+static void test_nic_destroy(test_nic_t* nic) {
+    memory_free((void*)nic->ring.desc);
+    memory_free((void*)nic->ring.buffer_va);
+}
+
+/*! nic sends at most count descriptors and reports them done */
+static uint32_t test_nic_send(test_nic_t* nic, uint32_t count, uint32_t* seq) {
+    uint32_t sent = 0;
+
+    while(sent < count && nic->head != nic->ring.tail) {
+        volatile network_igb_tx_desc_t* desc = &nic->ring.desc[nic->head];
+
+        if(seq) {
+            uint32_t frame_seq = 0;
+
+            memory_memcopy((uint8_t*)(nic->ring.buffer_va + (uint64_t)nic->head * TEST_BUFFER_SIZE), &frame_seq, sizeof(uint32_t));
+
+            if(frame_seq != *seq || desc->length != TEST_FRAME_SIZE ||
+               desc->cmd != (NETWORK_IGB_TXD_CMD_EOP | NETWORK_IGB_TXD_CMD_IFCS | NETWORK_IGB_TXD_CMD_RS)) {
+                return -1;
+            }
+
+            (*seq)++;
+        }
+
+        desc->status |= NETWORK_IGB_TXD_STATUS_DD;
+        nic->head = (nic->head + 1) & (nic->ring.count - 1);
+        sent++;
+    }
+
+    return sent;
+}
+
+/*! tx task side of a pass, tail is written once */
+static uint32_t test_nic_fill(test_nic_t* nic, network_tx_queue_t* queue, uint32_t budget) {
+    network_packet_t* packets[NETWORK_IGB_TX_BUDGET];
+
+    network_igb_tx_ring_reap(&nic->ring);
+
+    uint32_t available = MIN(network_igb_tx_ring_free(&nic->ring), MIN(budget, NETWORK_IGB_TX_BUDGET));
+    uint64_t count = network_tx_queue_pop_batch(queue, packets, available);
+
+    if(count == 0) {
+        return 0;
+    }
+
+    uint32_t consumed = network_igb_tx_ring_fill(&nic->ring, packets, count);
+
+    nic->tail_writes++;
+
+    return consumed;
+}
+
+static boolean_t test_tx_ring(network_packet_pool_t* pool) {
+    boolean_t pass = true;
+    network_tx_queue_t* queue = network_tx_queue_create(NULL, TEST_QUEUE_SIZE);
+    test_nic_t nic;
+    uint32_t seq = 0;
+    uint32_t checked = 0;
+
+    if(queue == NULL || !test_nic_create(&nic, TEST_RING_SIZE)) {
+        print_error("cannot create simulated ring");
+        network_tx_queue_destroy(queue);
+
+        return false;
+    }
+
+    if(network_igb_tx_ring_free(&nic.ring) != TEST_RING_SIZE - 1) {
+        print_error("empty ring has wrong free count");
+        pass = false;
+    }
+
+    // producers outrun nic, ring fills and queue holds rest
+    for(uint32_t round = 0; round < 200 && pass; round++) {
+        uint32_t first = seq;
+        network_packet_t* chain = test_chain(pool, 1 + test_random() % 32, &seq);
+
+        if(network_tx_queue_push(queue, chain) != 0) {
+            network_packet_release_chain(chain);
+            seq = first;
+        }
+
+        while(test_nic_fill(&nic, queue, NETWORK_IGB_TX_BUDGET)) {
+        }
+
+        // queue keeps packets only while descriptors are full
+        if(network_tx_queue_size(queue) && network_igb_tx_ring_free(&nic.ring) != 0) {
+            print_error("ring is not filled");
+            pass = false;
+        }
+
+        if(test_nic_send(&nic, test_random() % 48, &checked) == (uint32_t)-1) {
+            printf("expected %i\n", checked);
+            print_error("nic sends wrong frame");
+            pass = false;
+        }
+    }
+
+    // drain everything
+    while(pass && (network_tx_queue_size(queue) || nic.head != nic.ring.tail)) {
+        test_nic_fill(&nic, queue, NETWORK_IGB_TX_BUDGET);
+
+        if(test_nic_send(&nic, TEST_RING_SIZE, &checked) == (uint32_t)-1) {
+            print_error("nic sends wrong frame");
+            pass = false;
+        }
+    }
+
+    network_igb_tx_ring_reap(&nic.ring);
+
+    if(pass && (checked != seq || nic.ring.packets != seq || nic.ring.reaped != seq ||
+                network_igb_tx_ring_free(&nic.ring) != TEST_RING_SIZE - 1)) {
+        printf("queued %i sent %i reaped %lli\n", seq, checked, nic.ring.reaped);
+        print_error("frames are lost");
+        pass = false;
+    }
+
+    if(pass && nic.tail_writes != nic.ring.batches) {
+        print_error("tail is written more than once per batch");
+        pass = false;
+    }
+
+    // oversized frame is dropped without a descriptor
+    network_packet_t* big = network_packet_alloc(NULL, TEST_BUFFER_SIZE + 1);
+    network_packet_put(big, TEST_BUFFER_SIZE + 1);
+
+    uint32_t tail = nic.ring.tail;
+
+    if(network_igb_tx_ring_fill(&nic.ring, &big, 1) != 1 || nic.ring.dropped != 1 || nic.ring.tail != tail) {
+        print_error("oversized frame is not dropped");
+        pass = false;
+    }
+
+    test_nic_destroy(&nic);
+    network_tx_queue_destroy(queue);
+
+    if(network_packet_pool_get_free_count(pool) != TEST_POOL_SIZE) {
+        print_error("packets are leaked");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static uint64_t test_rate(uint64_t count, uint64_t elapsed) {
+    return count * 1000000000ULL / (elapsed ? elapsed : 1);
+}
+
+static boolean_t test_throughput(network_packet_pool_t* pool) {
+    network_packet_t* packets[NETWORK_IGB_TX_BUDGET];
+    uint32_t seq = 0;
+
+    // locked list one packet at a time, as before
+    list_t* list = list_create_queue();
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t done = 0; done < TEST_BENCH_PACKETS; done += TEST_BENCH_CHAIN) {
+        network_packet_t* chain = test_chain(pool, TEST_BENCH_CHAIN, &seq);
+
+        while(chain) {
+            network_packet_t* packet = chain;
+            chain = packet->next;
+            packet->next = NULL;
+
+            list_queue_push(list, packet);
+        }
+
+        while(list_size(list)) {
+            network_packet_release((network_packet_t*)list_queue_pop(list));
+        }
+    }
+
+    uint64_t list_elapsed = time_ns(NULL) - start;
+
+    list_destroy(list);
+
+    network_tx_queue_t* queue = network_tx_queue_create(NULL, TEST_QUEUE_SIZE);
+
+    start = time_ns(NULL);
+
+    for(uint64_t done = 0; done < TEST_BENCH_PACKETS; done += TEST_BENCH_CHAIN) {
+        network_tx_queue_push(queue, test_chain(pool, TEST_BENCH_CHAIN, &seq));
+
+        uint64_t count = network_tx_queue_pop_batch(queue, packets, NETWORK_IGB_TX_BUDGET);
+
+        for(uint64_t i = 0; i < count; i++) {
+            network_packet_release(packets[i]);
+        }
+    }
+
+    uint64_t queue_elapsed = time_ns(NULL) - start;
+
+    printf("chains of %i: list %lli packets/s, tx queue %lli packets/s\n", TEST_BENCH_CHAIN,
+           test_rate(TEST_BENCH_PACKETS, list_elapsed), test_rate(TEST_BENCH_PACKETS, queue_elapsed));
+
+    // doorbells of per packet and batched fill
+    uint32_t budgets[] = {1, NETWORK_IGB_TX_BUDGET};
+
+    for(uint32_t b = 0; b < sizeof(budgets) / sizeof(uint32_t); b++) {
+        test_nic_t nic;
+
+        if(!test_nic_create(&nic, NETWORK_IGB_NUM_TX_DESCRIPTORS)) {
+            network_tx_queue_destroy(queue);
+
+            return false;
+        }
+
+        uint64_t sent = 0;
+
+        start = time_ns(NULL);
+
+        while(sent < TEST_BENCH_PACKETS / 4) {
+            network_tx_queue_push(queue, test_chain(pool, NETWORK_IGB_TX_BUDGET, &seq));
+
+            while(test_nic_fill(&nic, queue, budgets[b])) {
+            }
+
+            sent += test_nic_send(&nic, NETWORK_IGB_NUM_TX_DESCRIPTORS, NULL);
+        }
+
+        uint64_t elapsed = time_ns(NULL) - start;
+
+        printf("tx budget %i: %lli packets/s, %lli tail writes for %lli packets\n", budgets[b],
+               test_rate(sent, elapsed), nic.tail_writes, sent);
+
+        test_nic_destroy(&nic);
+    }
+
+    network_tx_queue_destroy(queue);
+
+    return true;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    network_info_map = map_new(&test_network_info_mke);
+
+    network_packet_pool_t* pool = network_packet_pool_create(NULL, TEST_POOL_SIZE, NETWORK_PACKET_DEFAULT_BUFFER_SIZE);
+
+    if(pool == NULL) {
+        print_error("cannot create pool");
+
+        return -1;
+    }
+
+    pass &= test_push_pop(pool);
+    pass &= test_back_pressure(pool);
+    pass &= test_wake(pool);
+    pass &= test_tx_ring(pool);
+    pass &= test_throughput(pool);
+
+    network_packet_pool_destroy(pool);
+    map_destroy(network_info_map);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
@@ -3,12 +3,220 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE 0x1000000
 #include "setup.h"
 #include <quicksort.h>
 #include <random.h>
 
 int32_t main(uint32_t argc, char_t** argv, char_t** en);
 
+typedef struct test_pair_t {
+    uint64_t key;
+    uint64_t index;
+} test_pair_t;
+
+static int8_t uint64_comparator(const void* a, const void* b) {
+    uint64_t a_val = *(uint64_t*)a;
+    uint64_t b_val = *(uint64_t*)b;
+
+    if (a_val < b_val) {
+        return -1;
+    } else if (a_val > b_val) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+static int8_t pair_comparator(const void* a, const void* b) {
+    return uint64_comparator(&((test_pair_t*)a)->key, &((test_pair_t*)b)->key);
+}
+
+static uint64_t test_swap_count = 0;
+
+static void pair_swap(void* a, void* b, uint64_t item_size) {
+    UNUSED(item_size);
+
+    test_pair_t tmp = *(test_pair_t*)a;
+    *(test_pair_t*)a = *(test_pair_t*)b;
+    *(test_pair_t*)b = tmp;
+
+    test_swap_count++;
+}
+
+static boolean_t uint64_is_sorted(const uint64_t* array, uint64_t size) {
+    for (uint64_t i = 1; i < size; i++) {
+        if (array[i - 1] > array[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+typedef enum test_input_t {
+    TEST_INPUT_RANDOM,
+    TEST_INPUT_SORTED,
+    TEST_INPUT_REVERSE,
+    TEST_INPUT_FEW_UNIQUE,
+} test_input_t;
+
+static const char_t* test_input_names[] = {"random", "sorted", "reverse", "few unique"};
+
+static void test_fill(uint64_t* array, uint64_t size, test_input_t input) {
+    for (uint64_t i = 0; i < size; i++) {
+        switch (input) {
+        case TEST_INPUT_RANDOM:
+            array[i] = ((uint64_t)rand() << 32) ^ rand();
+            break;
+        case TEST_INPUT_SORTED:
+            array[i] = i;
+            break;
+        case TEST_INPUT_REVERSE:
+            array[i] = size - i;
+            break;
+        case TEST_INPUT_FEW_UNIQUE:
+            array[i] = rand() % 4;
+            break;
+        }
+    }
+}
+
+static int8_t test_sorts(void) {
+    const uint64_t size = 100000;
+    uint64_t* array = memory_malloc(size * sizeof(uint64_t));
+
+    if (array == NULL) {
+        print_error("Could not allocate memory for array\n");
+
+        return -1;
+    }
+
+    int8_t res = 0;
+
+    for (test_input_t input = TEST_INPUT_RANDOM; input <= TEST_INPUT_FEW_UNIQUE; input++) {
+        uint64_t start, quick_time, merge_time, radix_time;
+
+        test_fill(array, size, input);
+        start = time_ns(NULL);
+        quicksort(array, size, sizeof(uint64_t), uint64_comparator, NULL);
+        quick_time = time_ns(NULL) - start;
+
+        if (!uint64_is_sorted(array, size)) {
+            print_error("introsort failed on %s input\n", test_input_names[input]);
+            res = -1;
+
+            break;
+        }
+
+        test_fill(array, size, input);
+        start = time_ns(NULL);
+        res = mergesort(array, size, sizeof(uint64_t), uint64_comparator);
+        merge_time = time_ns(NULL) - start;
+
+        if (res != 0 || !uint64_is_sorted(array, size)) {
+            print_error("mergesort failed on %s input\n", test_input_names[input]);
+            res = -1;
+
+            break;
+        }
+
+        test_fill(array, size, input);
+        start = time_ns(NULL);
+        res = radixsort_uint64(array, size);
+        radix_time = time_ns(NULL) - start;
+
+        if (res != 0 || !uint64_is_sorted(array, size)) {
+            print_error("radixsort failed on %s input\n", test_input_names[input]);
+            res = -1;
+
+            break;
+        }
+
+        printf("%s %lli items: introsort %lli us mergesort %lli us radixsort %lli us\n",
+               test_input_names[input], size, quick_time / 1000, merge_time / 1000, radix_time / 1000);
+    }
+
+    memory_free(array);
+
+    return res;
+}
+
+static int8_t test_stability_and_sizes(void) {
+    int8_t res = 0;
+
+    for (uint64_t size = 0; size < 300 && res == 0; size += 7) {
+        test_pair_t* pairs = memory_malloc((size + 1) * sizeof(test_pair_t));
+        uint32_t* keys = memory_malloc((size + 1) * sizeof(uint32_t));
+
+        if (pairs == NULL || keys == NULL) {
+            print_error("Could not allocate memory for pairs\n");
+            memory_free(pairs);
+            memory_free(keys);
+
+            return -1;
+        }
+
+        for (uint64_t i = 0; i < size; i++) {
+            pairs[i].key = rand() % 8;
+            pairs[i].index = i;
+            keys[i] = rand();
+        }
+
+        if (mergesort(pairs, size, sizeof(test_pair_t), pair_comparator) != 0) {
+            print_error("mergesort of pairs failed\n");
+            res = -1;
+        }
+
+        for (uint64_t i = 1; i < size && res == 0; i++) {
+            if (pairs[i - 1].key > pairs[i].key ||
+                (pairs[i - 1].key == pairs[i].key && pairs[i - 1].index > pairs[i].index)) {
+                print_error("mergesort not stable at size %lli\n", size);
+                res = -1;
+            }
+        }
+
+        // user swap callback must still be honoured
+        test_swap_count = 0;
+        quicksort(pairs, size, sizeof(test_pair_t), pair_comparator, pair_swap);
+
+        for (uint64_t i = 0; i < size; i++) {
+            pairs[i].key = size - i;
+        }
+
+        quicksort(pairs, size, sizeof(test_pair_t), pair_comparator, pair_swap);
+
+        for (uint64_t i = 1; i < size && res == 0; i++) {
+            if (pairs[i - 1].key > pairs[i].key) {
+                print_error("introsort of pairs failed at size %lli\n", size);
+                res = -1;
+            }
+        }
+
+        if (size > 1 && test_swap_count == 0) {
+            print_error("swap callback not used\n");
+            res = -1;
+        }
+
+        if (radixsort_uint32(keys, size) != 0) {
+            print_error("radixsort of uint32 failed\n");
+            res = -1;
+        }
+
+        for (uint64_t i = 1; i < size && res == 0; i++) {
+            if (keys[i - 1] > keys[i]) {
+                print_error("radixsort of uint32 not sorted at size %lli\n", size);
+                res = -1;
+            }
+        }
+
+        memory_free(pairs);
+        memory_free(keys);
+    }
+
+    return res;
+}
+
 static int8_t int32_comparator(const void* a, const void* b) {
     int32_t a_val = *(int32_t*)a;
     int32_t b_val = *(int32_t*)b;
@@ -46,6 +254,7 @@ int32_t main(uint32_t argc, char_t** argv, char_t** env) {
     }
 
     int32_t try = 10000;
+    int8_t res = 0;
 
     while(try--) {
         for (uint32_t i = 0; i < 10; i++) {
@@ -64,6 +273,7 @@ int32_t main(uint32_t argc, char_t** argv, char_t** env) {
 
             if (*array[i] < last) {
                 print_error("Array not sorted\n");
+                res = -1;
 
                 goto exit;
             }
@@ -81,6 +291,20 @@ exit:
 
     memory_free(array);
 
+    if (res == 0) {
+        res = test_stability_and_sizes();
+    }
+
+    if (res == 0) {
+        res = test_sorts();
+    }
+
+    if (res != 0) {
+        print_error("TESTS FAILED");
+
+        return -1;
+    }
+
     print_success("TESTS PASSED");
 
     return 0;
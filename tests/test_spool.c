@@ -0,0 +1,250 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x1000000
+#include "setup.h"
+#include <memory.h>
+#include <spool.h>
+#include <strings.h>
+#include <utils.h>
+
+#define TEST_RING_SIZE    0x1000ULL
+#define TEST_BENCH_COUNT  1000000ULL
+#define TEST_BENCH_RING   0x100000ULL
+
+int32_t main(uint32_t argc, char_t** argv);
+
+static uint8_t test_area[TEST_RING_SIZE] __attribute__((aligned(64)));
+
+static boolean_t test_record_equals(const spool_ring_record_t* record, const char_t* name, uint64_t value) {
+    return record->name_length == strlen(name) &&
+           memory_memcompare(record->name, name, record->name_length) == 0 &&
+           record->data_length == sizeof(uint64_t) &&
+           *(const uint64_t*)record->data == value;
+}
+
+static boolean_t test_basic(void) {
+    boolean_t pass = true;
+    uint8_t buf[256] = {0};
+    spool_ring_record_t record = {0};
+    spool_ring_cursor_t cursor = {0};
+
+    spool_ring_t* ring = spool_ring_create(test_area, sizeof(test_area), SPOOL_RING_POLICY_OVERWRITE_OLDEST);
+
+    if(!ring) {
+        print_error("cannot create ring");
+
+        return false;
+    }
+
+    spool_ring_cursor_init(ring, &cursor);
+
+    if(spool_ring_read(ring, &cursor, &record, buf, sizeof(buf)) != -1) {
+        print_error("empty ring returned a record");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 3; i++) {
+        if(spool_ring_write(ring, "log", &i, sizeof(i)) != 0) {
+            print_error("cannot write record");
+            pass = false;
+        }
+    }
+
+    for(uint64_t i = 0; i < 3; i++) {
+        if(spool_ring_read(ring, &cursor, &record, buf, sizeof(buf)) != 0 || !test_record_equals(&record, "log", i)) {
+            print_error("record mismatch");
+            pass = false;
+        }
+    }
+
+    if(spool_ring_read(ring, &cursor, &record, buf, sizeof(buf)) != -1) {
+        print_error("cursor read past head");
+        pass = false;
+    }
+
+    // data is truncated to buffer, full length is reported
+    const char_t* line = "a long line which does not fit";
+
+    spool_ring_write(ring, "n", line, strlen(line));
+
+    if(spool_ring_read(ring, &cursor, &record, buf, 8) != 0 ||
+       record.name_length != 1 || record.data_length != 7 || record.total_data_length != strlen(line) ||
+       memory_memcompare(record.data, line, 7) != 0) {
+        print_error("truncated read mismatch");
+        pass = false;
+    }
+
+    if(spool_ring_write(ring, "big", test_area, sizeof(test_area)) != -1 || spool_ring_get_dropped_count(ring) != 1) {
+        print_error("oversized record accepted");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_overwrite(void) {
+    boolean_t pass = true;
+    uint8_t buf[256] = {0};
+    spool_ring_record_t record = {0};
+    spool_ring_cursor_t cursor = {0};
+
+    spool_ring_t* ring = spool_ring_create(test_area, sizeof(test_area), SPOOL_RING_POLICY_OVERWRITE_OLDEST);
+
+    spool_ring_cursor_init(ring, &cursor);
+
+    // odd sized names make records hit the end of ring at varying offsets
+    uint64_t written = 1000;
+
+    for(uint64_t i = 0; i < written; i++) {
+        const char_t* name = (i % 3) == 0 ? "a" : ((i % 3) == 1 ? "module" : "some longer record name");
+
+        if(spool_ring_write(ring, name, &i, sizeof(i)) != 0) {
+            print_error("overwriting ring dropped a record");
+            pass = false;
+
+            break;
+        }
+    }
+
+    // slow cursor lost the oldest records, the rest are contiguous and end at last write
+    uint64_t expected = -1ULL;
+    uint64_t read_count = 0;
+
+    while(spool_ring_read(ring, &cursor, &record, buf, sizeof(buf)) == 0) {
+        uint64_t value = *(const uint64_t*)record.data;
+
+        if(expected != -1ULL && value != expected) {
+            print_error("records are not contiguous");
+            pass = false;
+
+            break;
+        }
+
+        expected = value + 1;
+        read_count++;
+    }
+
+    if(expected != written || cursor.lost_bytes == 0 || read_count < 50) {
+        printf("expected %lli read %lli lost %lli\n", expected, read_count, cursor.lost_bytes);
+        print_error("overwrite mismatch");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_drop_newest(void) {
+    boolean_t pass = true;
+    uint8_t buf[256] = {0};
+    spool_ring_record_t record = {0};
+    spool_ring_cursor_t cursor = {0};
+
+    spool_ring_t* ring = spool_ring_create(test_area, sizeof(test_area), SPOOL_RING_POLICY_DROP_NEWEST);
+
+    spool_ring_cursor_init(ring, &cursor);
+
+    uint64_t accepted = 0;
+
+    for(uint64_t i = 0; i < 1000; i++) {
+        if(spool_ring_write(ring, "crash", &i, sizeof(i)) == 0) {
+            accepted++;
+        }
+    }
+
+    if(accepted == 0 || accepted == 1000 || spool_ring_get_dropped_count(ring) != 1000 - accepted) {
+        print_error("drop newest count mismatch");
+        pass = false;
+    }
+
+    // first records are kept
+    for(uint64_t i = 0; i < accepted / 2; i++) {
+        if(spool_ring_read(ring, &cursor, &record, buf, sizeof(buf)) != 0 || !test_record_equals(&record, "crash", i)) {
+            print_error("kept record mismatch");
+            pass = false;
+
+            break;
+        }
+    }
+
+    spool_ring_release(ring, &cursor);
+
+    // released space takes new records, including wrap padding
+    uint64_t next = 5000;
+
+    for(uint64_t i = 0; i < accepted / 2; i++) {
+        if(spool_ring_write(ring, "crash", &next, sizeof(next)) != 0) {
+            print_error("released space is not reused");
+            pass = false;
+
+            break;
+        }
+
+        next++;
+    }
+
+    uint64_t read_count = 0;
+
+    while(spool_ring_read(ring, &cursor, &record, buf, sizeof(buf)) == 0) {
+        read_count++;
+    }
+
+    if(read_count != accepted || cursor.lost_bytes != 0) {
+        printf("read %lli accepted %lli\n", read_count, accepted);
+        print_error("drop newest read mismatch");
+        pass = false;
+    }
+
+    return pass;
+}
+
+static boolean_t test_benchmark(void) {
+    uint8_t* area = memory_malloc_ext(NULL, TEST_BENCH_RING, 64);
+
+    if(!area) {
+        print_error("cannot allocate benchmark ring");
+
+        return false;
+    }
+
+    spool_ring_t* ring = spool_ring_create(area, TEST_BENCH_RING, SPOOL_RING_POLICY_OVERWRITE_OLDEST);
+    const char_t* line = "KERNEL:INFO:some log line with a few words in it\n";
+    uint64_t line_length = strlen(line);
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_BENCH_COUNT; i++) {
+        spool_ring_write(ring, "KERNEL", line, line_length);
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    printf("spool ring: %lli ns per %lli byte record, %lli dropped\n",
+           elapsed / TEST_BENCH_COUNT, line_length, spool_ring_get_dropped_count(ring));
+
+    memory_free(area);
+
+    return true;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    pass &= test_basic();
+    pass &= test_overwrite();
+    pass &= test_drop_newest();
+    pass &= test_benchmark();
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
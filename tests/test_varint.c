@@ -3,12 +3,135 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE 0x1000000
 #include "setup.h"
 #include <utils.h>
 #include <varint.h>
+#include <random.h>
+
+#define TEST_COUNT 65536ULL
 
 int32_t main(uint32_t argc, char_t** argv);
 
+static boolean_t test_single(void) {
+    const uint64_t nums[] = {0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x123FC67ULL, 0xFFFFFFFFULL, 0x7FFFFFFFFFFFFFFFULL, -1ULL};
+    uint8_t out[VARINT_MAX_SIZE];
+    boolean_t pass = true;
+
+    buffer_t* buf = buffer_new_with_capacity(NULL, 128);
+
+    for(uint64_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        int8_t s1 = varint_encode_to(nums[i], out);
+        int8_t s2 = 0;
+        uint64_t n = varint_decode(out, &s2);
+
+        if(n != nums[i] || s1 != s2 || s1 != varint_size(nums[i])) {
+            printf("0x%llx 0x%llx %i %i\n", nums[i], n, s1, s2);
+            print_error("single varint mismatch");
+            pass = false;
+        }
+
+        if(varint_encode_to_buffer(buf, nums[i]) != s1) {
+            print_error("buffer varint size mismatch");
+            pass = false;
+        }
+    }
+
+    buffer_seek(buf, 0, BUFFER_SEEK_DIRECTION_START);
+
+    for(uint64_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        int8_t s = 0;
+
+        if(varint_decode_from_buffer(buf, &s) != nums[i] || s != varint_size(nums[i])) {
+            print_error("buffer varint mismatch");
+            pass = false;
+        }
+    }
+
+    buffer_destroy(buf);
+
+    return pass;
+}
+
+static boolean_t test_group(uint32_t* src, uint32_t* dst, uint8_t* enc) {
+    boolean_t pass = true;
+
+    for(uint64_t i = 0; i < TEST_COUNT; i++) {
+        // mix of one to four byte values
+        src[i] = rand() >> (8 * (rand() % 4));
+    }
+
+    for(uint64_t count = 0; count < 9; count++) {
+        uint64_t len = varint_group_encode_uint32(src, count, enc);
+
+        if(varint_group_decode_uint32(enc, len, dst, count) != len || memory_memcompare(src, dst, count * sizeof(uint32_t)) != 0) {
+            printf("count %lli\n", count);
+            print_error("small group varint mismatch");
+            pass = false;
+        }
+
+        if(count && varint_group_decode_uint32(enc, len - 1, dst, count) != -1ULL) {
+            print_error("short group varint should fail");
+            pass = false;
+        }
+    }
+
+    uint64_t start = time_ns(NULL);
+    uint64_t len = varint_group_encode_uint32(src, TEST_COUNT, enc);
+    uint64_t mid = time_ns(NULL);
+    uint64_t dec_len = varint_group_decode_uint32(enc, len, dst, TEST_COUNT);
+    uint64_t end = time_ns(NULL);
+
+    if(dec_len != len || memory_memcompare(src, dst, TEST_COUNT * sizeof(uint32_t)) != 0) {
+        print_error("group varint mismatch");
+        pass = false;
+    }
+
+    printf("group varint %lli integers %lli bytes: encode %lli ps/int decode %lli ps/int\n",
+           TEST_COUNT, len, (mid - start) * 1000 / TEST_COUNT, (end - mid) * 1000 / TEST_COUNT);
+
+    start = time_ns(NULL);
+
+    uint64_t pos = 0;
+
+    for(uint64_t i = 0; i < TEST_COUNT; i++) {
+        pos += varint_encode_to(src[i], enc + pos);
+    }
+
+    mid = time_ns(NULL);
+
+    uint64_t dpos = 0;
+
+    for(uint64_t i = 0; i < TEST_COUNT; i++) {
+        int8_t s = 0;
+        dst[i] = varint_decode(enc + dpos, &s);
+        dpos += s;
+    }
+
+    end = time_ns(NULL);
+
+    if(dpos != pos || memory_memcompare(src, dst, TEST_COUNT * sizeof(uint32_t)) != 0) {
+        print_error("varint array mismatch");
+        pass = false;
+    }
+
+    printf("varint %lli integers %lli bytes: encode %lli ps/int decode %lli ps/int\n",
+           TEST_COUNT, pos, (mid - start) * 1000 / TEST_COUNT, (end - mid) * 1000 / TEST_COUNT);
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_COUNT; i++) {
+        int8_t s = 0;
+        memory_free(varint_encode(src[i], &s));
+    }
+
+    end = time_ns(NULL);
+
+    printf("allocating varint encode %lli ps/int\n", (end - start) * 1000 / TEST_COUNT);
+
+    return pass;
+}
+
 int32_t main(uint32_t argc, char_t** argv) {
     UNUSED(argc);
     UNUSED(argv);
@@ -21,7 +144,21 @@ int32_t main(uint32_t argc, char_t** argv) {
 
     int64_t num2 = varint_decode(res1, &s2);
 
-    if( num1 == num2 && s1 == s2) {
+    boolean_t pass = test_single();
+
+    uint32_t* src = memory_malloc(TEST_COUNT * sizeof(uint32_t));
+    uint32_t* dst = memory_malloc(TEST_COUNT * sizeof(uint32_t));
+    uint8_t* enc = memory_malloc(varint_group_max_size(TEST_COUNT) + TEST_COUNT * VARINT_MAX_SIZE);
+
+    if(!test_group(src, dst, enc)) {
+        pass = false;
+    }
+
+    memory_free(src);
+    memory_free(dst);
+    memory_free(enc);
+
+    if(pass && num1 == num2 && s1 == s2) {
         print_success("TESTS PASSED");
     } else {
         printf("0x%llx 0x%llx %i %i ", num1, num2, s1, s2);
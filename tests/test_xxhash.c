@@ -0,0 +1,196 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE 0x1000000
+#include "setup.h"
+#include <xxhash.h>
+#include <memory.h>
+#include <utils.h>
+
+int32_t main(uint32_t argc, char_t** argv);
+
+typedef struct xxhash_test_vector_t {
+    uint64_t length;
+    uint64_t xxh64;
+    uint32_t xxh32;
+    uint64_t xxh3_64;
+    uint64_t xxh3_64_seeded;
+    uint64_t xxh3_128_low;
+    uint64_t xxh3_128_high;
+} xxhash_test_vector_t;
+
+#define TEST_SEED 0x9E3779B97F4A7C15ULL
+#define TEST_DATA_SIZE 10000
+
+// input byte i is (i * 31 + 7) & 0xff, seeded variants use TEST_SEED (xxh32 uses its low 32 bits)
+static const xxhash_test_vector_t xxhash_test_vectors[] = {
+    {     0, 0xc4349fc93c010000ULL, 0x872a8b86U, 0x2d06800538d394c2ULL, 0x602b0e2cd6662c8bULL, 0x4ca5176998171787ULL, 0xd142977a2cca554bULL },
+    {     1, 0x585882422a6165e7ULL, 0x5dde817bU, 0x4c5cca45d0f4811fULL, 0x2f3acd3805f81de3ULL, 0x2f3acd3805f81de3ULL, 0x00a711eb5a736b26ULL },
+    {     2, 0x641d1a59667ae544ULL, 0x2306ceb6U, 0xa7e250c97710ff27ULL, 0xae890deb5ef9a522ULL, 0xae890deb5ef9a522ULL, 0x954e5e6bd54ba0caULL },
+    {     3, 0x5acb303e78133c22ULL, 0x2c58433cU, 0x15f7093b173d005cULL, 0x079dd5d54d89480aULL, 0x079dd5d54d89480aULL, 0xbf6c84df5f76651dULL },
+    {     4, 0x7d51d5e2461732b3ULL, 0x9e6adc60U, 0xdca012f95811b6b9ULL, 0x1a246e2efb9c9b2eULL, 0x64e9e646b51d20e4ULL, 0xb51a3f0020dfa57eULL },
+    {     5, 0x7f8b72856a42bb63ULL, 0x39ae6940U, 0xb290cafc7b254345ULL, 0xf35f0dfbb65fe08fULL, 0x5e9d5339b098317eULL, 0x84a390e0ad91cedcULL },
+    {     7, 0x2ce9adec2b2c8104ULL, 0xdf53bc60U, 0x7561869c23da3c1bULL, 0x09e5bec831fa48c0ULL, 0xa8e902caedab477bULL, 0xb648d2b52890475eULL },
+    {     8, 0x758848f033fa76a2ULL, 0xa2982c8aU, 0xdec6a9a43575982eULL, 0x19ef7d3919108affULL, 0x3edb070ecf3a9343ULL, 0xc3612dc11470e721ULL },
+    {     9, 0xd4576cf554b7d929ULL, 0xe0406e85U, 0xcbe393399f17ffbdULL, 0x9c98d3e24dc54d34ULL, 0x2d1266ad8e2a983eULL, 0xd073a967e56faabbULL },
+    {    12, 0xeaa6d4d803d21fd7ULL, 0x41d06b30U, 0x46aaf92c7550afa4ULL, 0xfe2aa65fa753fc49ULL, 0x0c278dc54b37aed5ULL, 0x7f86e998f1ce90c4ULL },
+    {    15, 0xa18d5c90d722cee3ULL, 0x250fa344U, 0x545e19990471dc37ULL, 0x9a393060bce10286ULL, 0xb43f96dbdc7044f4ULL, 0xdeeff95ec796179aULL },
+    {    16, 0xe3594f9058b426e7ULL, 0x49b2e997U, 0x7e484c18d74895d0ULL, 0xa106510078b0a252ULL, 0x4e683254a04c377fULL, 0xbe0f27bac4d1f58fULL },
+    {    17, 0xa0c8a40ef8f3a9f7ULL, 0x1285594bU, 0x208bde5ee2bed407ULL, 0x0b2caf8bf9648effULL, 0xec6d60966729df8dULL, 0x81d87d7004dc4f98ULL },
+    {    31, 0x8137041f5af88413ULL, 0x2215cf2fU, 0xa937652b0119ca11ULL, 0xe425437c705fbca4ULL, 0x2c156a0d97bebb12ULL, 0x7f468a6408973ac4ULL },
+    {    32, 0x184ebcf3745cd46cULL, 0x78998eafU, 0x03df0ac5255d1446ULL, 0x3acbfdfb7e9f9668ULL, 0xec314f4c5eb3f3edULL, 0x2f9dc286862d200eULL },
+    {    33, 0x52fac3c981f3cc2eULL, 0xac662e80U, 0x199a362122d71f46ULL, 0x913b37d6b8df6d23ULL, 0x8fe6a0e9b9ce486bULL, 0xa7da9f4c0aa58376ULL },
+    {    63, 0x64ef99a2e94cc7bdULL, 0x4e1aa265U, 0x76d4eec1f092847fULL, 0x46497a4a99ad609fULL, 0xca6d81c633ebae4dULL, 0xf8a5598a724991caULL },
+    {    64, 0xf7f22435fe1ab128ULL, 0x90eeedabU, 0xdd30702ab46b3745ULL, 0x4490c19c7048a1a1ULL, 0x617a30ca442d6de3ULL, 0x6d4d5c56cd67f9f0ULL },
+    {    65, 0x7a0b76a812617c73ULL, 0x3ac477e7U, 0xfab36b851b94ce20ULL, 0xe6c2315ab5f5c409ULL, 0xdf39c73784fd230dULL, 0x2e9cfc23f941730aULL },
+    {    96, 0x8ca91b1316d13af8ULL, 0x96860b21U, 0xd245cd2541582982ULL, 0xb0d250df3fab2308ULL, 0x612bf585220b1288ULL, 0x0442aede343ab5f1ULL },
+    {    97, 0x4ec794aabaaa40f5ULL, 0xeeef9430U, 0x60e3e1d0d43785b3ULL, 0x9e127e846b5494c9ULL, 0xdeacc0186ad90436ULL, 0xb00709f5e31608ceULL },
+    {   127, 0x11d73a8219c8c4c5ULL, 0x693d61bdU, 0xa915ed6396db8cc0ULL, 0x30b3b03d7d3a07c1ULL, 0x605acd8cadc63975ULL, 0xe423119abfe77288ULL },
+    {   128, 0x766daa420b6c6d5dULL, 0x41f1ebcaU, 0xf92b70eaa21a6288ULL, 0x95425530beb89fe8ULL, 0x8dd13adf89d20a39ULL, 0xf1355c6816c0b724ULL },
+    {   129, 0x34c101f001255e7fULL, 0x7c5b017bU, 0xf8f76713f2bb60faULL, 0x29fa850b97ed9666ULL, 0xa1c74215b3db7ab4ULL, 0xb8c736db70349640ULL },
+    {   200, 0x1ea63f1abd71fb0bULL, 0x4ee68a2eU, 0x12fdb864685f344dULL, 0x49dff623641b01b4ULL, 0x2bd1eb5d960e73f4ULL, 0x8511e8a53f70bfbfULL },
+    {   239, 0xf2ae04df836ec067ULL, 0xd0dbb647U, 0xcaa9b7a588464745ULL, 0x49a8e9695ef4ab09ULL, 0xf3b69ecfee213a6bULL, 0xf0e291d20d40f5f1ULL },
+    {   240, 0x38d21e4b153c50c9ULL, 0x46355ac6U, 0xccc7375172c41f03ULL, 0x2d882e7899ff64ccULL, 0xde896b7f1ae3bc6fULL, 0x5b131678a4a9b8f4ULL },
+    {   241, 0x71acde7c1adbce38ULL, 0xcd71dc7dU, 0x0b3b630948ce4a00ULL, 0x422e82e8913e49e0ULL, 0x422e82e8913e49e0ULL, 0xc39cbfb460caf47eULL },
+    {   255, 0x76dc2ba578c894b9ULL, 0xc45a66a6U, 0x89932170686cdd9aULL, 0x8f2f859ce5068ddfULL, 0x8f2f859ce5068ddfULL, 0xa83ad8ee2d42c86fULL },
+    {   256, 0xaabaf17c38df7868ULL, 0xb904340dU, 0xec85b75bafe6ca74ULL, 0xb4dbe810e81c3d97ULL, 0xb4dbe810e81c3d97ULL, 0xba6635ddc89f0599ULL },
+    {   511, 0x71e85400cbbd8a0cULL, 0x0281ccc8U, 0x0fec8fb6eae1df8bULL, 0xb15a032408e79741ULL, 0xb15a032408e79741ULL, 0x655285fb79614244ULL },
+    {  1023, 0x125ae1ed3a7cf6b3ULL, 0x3444423fU, 0xf0d330ce2b3300fbULL, 0x642b8b12a22cac34ULL, 0x642b8b12a22cac34ULL, 0x83a044468819013aULL },
+    {  1024, 0x3ffe1c69f2d78178ULL, 0x253ece51U, 0x23bc880ebf0d29c6ULL, 0x7e249adc60e1f9b4ULL, 0x7e249adc60e1f9b4ULL, 0x927c8d2b50d33f53ULL },
+    {  1025, 0x11e09ec612e2aa1dULL, 0x39139c5bU, 0xc09fdfbc398c7d82ULL, 0x16cfe055154ff1ddULL, 0x16cfe055154ff1ddULL, 0x0d225711ec9bb344ULL },
+    {  2048, 0xcd3d4acfbaec2cd5ULL, 0x11049c8fU, 0x19f6f9c987331373ULL, 0x060600a6317839f9ULL, 0x060600a6317839f9ULL, 0x51a684c4afa32172ULL },
+    {  4095, 0x73258c416148b96eULL, 0xb5bfa155U, 0x931f2730a6e6e594ULL, 0x1c10d6d14e41a5a5ULL, 0x1c10d6d14e41a5a5ULL, 0x50c7f3727dccd2ffULL },
+    {  4096, 0xe4d8ced124df0294ULL, 0xb77c5fefU, 0xa3c19f8174cde0bbULL, 0x224e1aff9c0f0707ULL, 0x224e1aff9c0f0707ULL, 0x95fad31aabba45e1ULL },
+    {  4097, 0xebe857ec1b0f16c0ULL, 0xfa6c35b2U, 0xb319759b4671c221ULL, 0x52c95add56c13a9dULL, 0x52c95add56c13a9dULL, 0x0e55ff757f6c6a6dULL },
+    { 10000, 0x87b6f67e6aa5a117ULL, 0x1d81f88aU, 0x441f01d9711bebedULL, 0xd19cf166bc6207dfULL, 0xd19cf166bc6207dfULL, 0x0540bede911260ffULL },
+};
+
+static boolean_t test_vectors(const uint8_t* data) {
+    boolean_t pass = true;
+
+    for(uint64_t i = 0; i < sizeof(xxhash_test_vectors) / sizeof(xxhash_test_vectors[0]); i++) {
+        const xxhash_test_vector_t* tv = &xxhash_test_vectors[i];
+
+        uint64_t h64 = xxhash64_hash_with_seed(data, tv->length, TEST_SEED);
+        uint32_t h32 = xxhash32_hash_with_seed(data, tv->length, (uint32_t)TEST_SEED);
+        uint64_t h3 = xxhash3_64_hash(data, tv->length);
+        uint64_t h3s = xxhash3_64_hash_with_seed(data, tv->length, TEST_SEED);
+        uint128_t h128 = xxhash3_128_hash_with_seed(data, tv->length, TEST_SEED);
+
+        if(h64 != tv->xxh64 || h32 != tv->xxh32 || h3 != tv->xxh3_64 || h3s != tv->xxh3_64_seeded ||
+           (uint64_t)h128 != tv->xxh3_128_low || (uint64_t)(h128 >> 64) != tv->xxh3_128_high) {
+            print_error("hash mismatch for length %lli", tv->length);
+            printf("xxh64 0x%llx xxh32 0x%x xxh3 0x%llx xxh3s 0x%llx xxh3_128 0x%llx%016llx\n",
+                   h64, h32, h3, h3s, (uint64_t)(h128 >> 64), (uint64_t)h128);
+            pass = false;
+        }
+
+        if(tv->length == 0) {
+            continue;
+        }
+
+        // streaming api should match one-shot api regardless of chunking
+        xxhash64_context_t* ctx = xxhash64_init(TEST_SEED);
+        uint64_t chunk = 1 + tv->length / 7;
+
+        for(uint64_t off = 0; off < tv->length; off += chunk) {
+            xxhash64_update(ctx, data + off, MIN(chunk, tv->length - off));
+        }
+
+        if(xxhash64_final(ctx) != tv->xxh64) {
+            print_error("streaming xxh64 mismatch for length %lli", tv->length);
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+static void bench(const char_t* name, const uint8_t* data, uint64_t length, uint64_t rounds) {
+    uint64_t sink = 0;
+    uint64_t start, end;
+
+    start = time_ns(NULL);
+    for(uint64_t i = 0; i < rounds; i++) {
+        sink += xxhash64_hash_with_seed(data, length, i);
+    }
+    end = time_ns(NULL);
+    uint64_t t_xxh64 = end - start;
+
+    start = time_ns(NULL);
+    for(uint64_t i = 0; i < rounds; i++) {
+        xxhash64_context_t* ctx = xxhash64_init(i);
+        xxhash64_update(ctx, data, length);
+        sink += xxhash64_final(ctx);
+    }
+    end = time_ns(NULL);
+    uint64_t t_xxh64_ctx = end - start;
+
+    start = time_ns(NULL);
+    for(uint64_t i = 0; i < rounds; i++) {
+        sink += xxhash3_64_hash_with_seed(data, length, i);
+    }
+    end = time_ns(NULL);
+    uint64_t t_xxh3 = end - start;
+
+    start = time_ns(NULL);
+    for(uint64_t i = 0; i < rounds; i++) {
+        sink += (uint64_t)xxhash3_128_hash_with_seed(data, length, i);
+    }
+    end = time_ns(NULL);
+    uint64_t t_xxh3_128 = end - start;
+
+    printf("%s len %lli: xxh64 %lli.%lli ns/op (with ctx %lli.%lli) xxh3_64 %lli.%lli ns/op xxh3_128 %lli.%lli ns/op (sink %llx)\n",
+           name, length,
+           t_xxh64 / rounds, (t_xxh64 * 10 / rounds) % 10,
+           t_xxh64_ctx / rounds, (t_xxh64_ctx * 10 / rounds) % 10,
+           t_xxh3 / rounds, (t_xxh3 * 10 / rounds) % 10,
+           t_xxh3_128 / rounds, (t_xxh3_128 * 10 / rounds) % 10,
+           sink & 0xF);
+
+    if(length >= 1024) {
+        printf("       bulk throughput: xxh64 %lli MiB/s xxh3_64 %lli MiB/s\n",
+               (length * rounds * 1000000000ULL / t_xxh64) >> 20,
+               (length * rounds * 1000000000ULL / t_xxh3) >> 20);
+    }
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    uint8_t* data = memory_malloc(TEST_DATA_SIZE);
+
+    if(!data) {
+        print_error("cannot allocate test data");
+
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < TEST_DATA_SIZE; i++) {
+        data[i] = (i * 31 + 7) & 0xff;
+    }
+
+    boolean_t pass = test_vectors(data);
+
+    uint64_t short_lengths[] = {8, 16, 24, 32, 48, 64};
+
+    for(uint64_t i = 0; i < sizeof(short_lengths) / sizeof(short_lengths[0]); i++) {
+        bench("short", data, short_lengths[i], 1000000);
+    }
+
+    bench("bulk", data, 4096, 20000);
+    bench("bulk", data, TEST_DATA_SIZE, 10000);
+
+    memory_free(data);
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return 0;
+}
@@ -210,7 +210,7 @@ void      task_current_task_sleep(uint64_t when_tick);
 time_t    rtc_get_time(void);
 void*     task_get_current_task(void);
 void      task_switch_task(void);
-future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data);
+future_t* future_create_with_heap_and_data(memory_heap_t* heap, void* data);
 void*     future_get_data_and_destroy(future_t* fut);
 
 struct timespec {
@@ -280,9 +280,8 @@ void lock_release(lock_t* lock){
     UNUSED(lock);
 }
 
-future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data) {
+future_t* future_create_with_heap_and_data(memory_heap_t* heap, void* data) {
     UNUSED(heap);
-    UNUSED(lock);
 
     if(data) {
         return (future_t*)data;
@@ -3340,6 +3340,140 @@ static int32_t bigint_test_pow_mod(void){
     return 0;
 }
 
+static int8_t bigint_test_pow_mod_reference(bigint_t* result, const bigint_t* a, const bigint_t* b, const bigint_t* c) {
+    bigint_t* tmp = bigint_create();
+    int8_t res = bigint_set_int64(result, 1);
+
+    for(int64_t bit = bigint_bit_length(b) - 1; bit >= 0; bit--) {
+        boolean_t set = false;
+
+        res |= bigint_mul(tmp, result, result);
+        res |= bigint_mod(result, tmp, c);
+        res |= bigint_get_bit(b, bit, &set);
+
+        if(set) {
+            res |= bigint_mul(tmp, result, a);
+            res |= bigint_mod(result, tmp, c);
+        }
+    }
+
+    bigint_destroy(tmp);
+
+    return res;
+}
+
+static int32_t bigint_test_montgomery(void) {
+    bigint_t* bigint_1 = bigint_create();
+    bigint_t* bigint_2 = bigint_create();
+    bigint_t* bigint_3 = bigint_create();
+    bigint_t* bigint_4 = bigint_create();
+
+    bigint_set_str(bigint_1, "3");
+    bigint_set_str(bigint_2, "5");
+    bigint_set_str(bigint_3, "-7");
+
+    if(bigint_pow_mod(bigint_4, bigint_1, bigint_2, bigint_3) == -1) {
+        bigint_destroy(bigint_1);
+        bigint_destroy(bigint_2);
+        bigint_destroy(bigint_3);
+        bigint_destroy(bigint_4);
+        print_error("bigint_pow_mod failed");
+        return -1;
+    }
+
+    const char_t* str = bigint_to_str(bigint_4);
+
+    printf("bigint_pow_mod: %s\n", str);
+
+    if(strcmp(str, "-2") != 0) {
+        memory_free((void*)str);
+        bigint_destroy(bigint_1);
+        bigint_destroy(bigint_2);
+        bigint_destroy(bigint_3);
+        bigint_destroy(bigint_4);
+        print_error("bigint_pow_mod negative modulus failed");
+        return -1;
+    }
+
+    memory_free((void*)str);
+
+    bigint_destroy(bigint_1);
+    bigint_destroy(bigint_2);
+    bigint_destroy(bigint_3);
+    bigint_destroy(bigint_4);
+
+    print_success("bigint_pow_mod negative modulus passed");
+
+    uint64_t bit_count = 512;
+
+    while(bit_count <= 2048) {
+        bigint_1 = bigint_random(bit_count + 64);
+        bigint_2 = bigint_random(bit_count);
+        bigint_3 = bigint_random(bit_count);
+        bigint_4 = bigint_create();
+        bigint_t* bigint_5 = bigint_create();
+        bigint_t* bigint_6 = bigint_create();
+
+        bigint_set_bit(bigint_3, 0, true);
+
+        bigint_montgomery_t* ctx = bigint_montgomery_create(bigint_3);
+
+        if(!ctx) {
+            bigint_destroy(bigint_1);
+            bigint_destroy(bigint_2);
+            bigint_destroy(bigint_3);
+            bigint_destroy(bigint_4);
+            bigint_destroy(bigint_5);
+            bigint_destroy(bigint_6);
+            print_error("bigint_montgomery_create failed");
+            return -1;
+        }
+
+        int8_t res = 0;
+
+        time_t start = time_ns(NULL);
+        res |= bigint_test_pow_mod_reference(bigint_4, bigint_1, bigint_2, bigint_3);
+        time_t reference_time = time_ns(NULL) - start;
+
+        start = time_ns(NULL);
+        res |= bigint_pow_mod(bigint_5, bigint_1, bigint_2, bigint_3);
+        time_t sliding_time = time_ns(NULL) - start;
+
+        start = time_ns(NULL);
+        res |= bigint_montgomery_pow(ctx, bigint_6, bigint_1, bigint_2, BIGINT_MONTGOMERY_POW_MODE_FIXED_WINDOW);
+        time_t fixed_time = time_ns(NULL) - start;
+
+        boolean_t passed = res == 0 && bigint_cmp(bigint_4, bigint_5) == 0 && bigint_cmp(bigint_4, bigint_6) == 0;
+
+        res |= bigint_mul_mod(bigint_4, bigint_1, bigint_2, bigint_3);
+        res |= bigint_montgomery_mul_mod(ctx, bigint_5, bigint_1, bigint_2);
+
+        passed = passed && res == 0 && bigint_cmp(bigint_4, bigint_5) == 0;
+
+        bigint_montgomery_destroy(ctx);
+        bigint_destroy(bigint_1);
+        bigint_destroy(bigint_2);
+        bigint_destroy(bigint_3);
+        bigint_destroy(bigint_4);
+        bigint_destroy(bigint_5);
+        bigint_destroy(bigint_6);
+
+        if(!passed) {
+            print_error("bigint montgomery failed");
+            return -1;
+        }
+
+        printf("bigint %lli-bits pow_mod: reference %lli ns sliding %lli ns fixed %lli ns speedup %lli\n",
+               bit_count, reference_time, sliding_time, fixed_time, reference_time / sliding_time);
+
+        bit_count <<= 1;
+    }
+
+    print_success("montgomery tests passed");
+
+    return 0;
+}
+
 static int32_t bigint_test_prime(void) {
     bigint_t* bigint_1 = bigint_create();
 
@@ -3421,6 +3555,86 @@ static int32_t bigint_test_prime(void) {
     return 0;
 }
 
+static int32_t bigint_test_timing(void) {
+    const int32_t rounds = 32;
+    uint64_t bit_count = 1024;
+
+    while(bit_count <= 8192) {
+        bigint_t* bigint_1 = bigint_random(bit_count);
+        bigint_t* bigint_2 = bigint_random(bit_count);
+        bigint_t* bigint_3 = bigint_random(bit_count / 2);
+        bigint_t* bigint_4 = bigint_create();
+        bigint_t* bigint_5 = bigint_create();
+        bigint_t* bigint_6 = bigint_create();
+
+        if(!bigint_1 || !bigint_2 || !bigint_3 || !bigint_4 || !bigint_5 || !bigint_6) {
+            bigint_destroy(bigint_1);
+            bigint_destroy(bigint_2);
+            bigint_destroy(bigint_3);
+            bigint_destroy(bigint_4);
+            bigint_destroy(bigint_5);
+            bigint_destroy(bigint_6);
+            print_error("bigint timing setup failed");
+            return -1;
+        }
+
+        int8_t res = 0;
+
+        time_t start = time_ns(NULL);
+
+        for(int32_t i = 0; i < rounds; i++) {
+            res |= bigint_mul(bigint_4, bigint_1, bigint_2);
+        }
+
+        time_t mul_time = (time_ns(NULL) - start) / rounds;
+
+        start = time_ns(NULL);
+
+        for(int32_t i = 0; i < rounds; i++) {
+            res |= bigint_mul(bigint_5, bigint_1, bigint_1);
+        }
+
+        time_t sqr_time = (time_ns(NULL) - start) / rounds;
+
+        // (a * b + c) / b must give back a with remainder c
+        res |= bigint_add(bigint_4, bigint_4, bigint_3);
+
+        start = time_ns(NULL);
+
+        for(int32_t i = 0; i < rounds; i++) {
+            res |= bigint_div_with_remainder(bigint_5, bigint_6, bigint_4, bigint_2);
+        }
+
+        time_t div_time = (time_ns(NULL) - start) / rounds;
+
+        if(res != 0 || bigint_cmp(bigint_5, bigint_1) != 0 || bigint_cmp(bigint_6, bigint_3) != 0) {
+            bigint_destroy(bigint_1);
+            bigint_destroy(bigint_2);
+            bigint_destroy(bigint_3);
+            bigint_destroy(bigint_4);
+            bigint_destroy(bigint_5);
+            bigint_destroy(bigint_6);
+            print_error("bigint timing round trip failed");
+            return -1;
+        }
+
+        printf("bigint %lli-bits: mul %lli ns sqr %lli ns div %lli ns\n", bit_count, mul_time, sqr_time, div_time);
+
+        bigint_destroy(bigint_1);
+        bigint_destroy(bigint_2);
+        bigint_destroy(bigint_3);
+        bigint_destroy(bigint_4);
+        bigint_destroy(bigint_5);
+        bigint_destroy(bigint_6);
+
+        bit_count <<= 1;
+    }
+
+    print_success("timing tests passed");
+
+    return 0;
+}
+
 int32_t main(void) {
     int32_t result = 0;
 
@@ -3502,8 +3716,20 @@ int32_t main(void) {
         return result;
     }
 
+    result = bigint_test_montgomery();
+
+    if(result != 0) {
+        return result;
+    }
+
     result = bigint_test_prime();
 
+    if(result != 0) {
+        return result;
+    }
+
+    result = bigint_test_timing();
+
     if (result == 0) {
         print_success("bigint test passed");
     } else {
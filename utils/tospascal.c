@@ -18,8 +18,17 @@ int32_t main(int32_t argc, char * argv[]);
 
 
 int32_t main(int32_t argc, char * argv[]) {
+    compiler_optimization_level_t optimization_level = COMPILER_OPTIMIZATION_LEVEL_BASIC;
+
+    // -O0 keeps code as written, -O2 enables all optimizations
+    if (argc == 4 && strlen(argv[1]) == 3 && strncmp(argv[1], "-O", 2) == 0 && argv[1][2] >= '0' && argv[1][2] <= '2') {
+        optimization_level = argv[1][2] - '0';
+        argc--;
+        argv++;
+    }
+
     if (argc != 3) {
-        print_error("Usage: %s <in> <out>\n", argv[0]);
+        print_error("Usage: %s [-O0|-O1|-O2] <in> <out>\n", argv[0]);
         return -1;
     }
 
@@ -78,6 +87,8 @@ int32_t main(int32_t argc, char * argv[]) {
         return -1;
     }
 
+    compiler.optimization_level = optimization_level;
+
     int64_t result = 0;
 
     int8_t res = 0;